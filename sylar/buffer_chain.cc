@@ -0,0 +1,574 @@
+#include "buffer_chain.h"
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <new>
+#include <stdexcept>
+#include "config.h"
+#include "log.h"
+
+namespace sylar {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<uint32_t>::ptr g_buffer_block_size =
+    sylar::Config::Lookup("buffer.block_size", (uint32_t)4096, "buffer chain block size");
+
+static sylar::ConfigVar<uint32_t>::ptr g_buffer_pool_max_blocks =
+    sylar::Config::Lookup("buffer.pool_max_blocks", (uint32_t)1024
+            , "max cached buffer blocks per thread");
+
+static uint32_t s_block_size = 4096;
+static uint32_t s_pool_max_blocks = 1024;
+static std::atomic<int64_t> s_alive_blocks(0);
+
+namespace {
+
+struct _BufferPoolIniter {
+    _BufferPoolIniter() {
+        s_block_size = g_buffer_block_size->getValue();
+        s_pool_max_blocks = g_buffer_pool_max_blocks->getValue();
+
+        g_buffer_block_size->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            SYLAR_LOG_INFO(g_logger) << "buffer block size changed from "
+                                     << old_value << " to " << new_value;
+            s_block_size = new_value;
+        });
+        g_buffer_pool_max_blocks->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            s_pool_max_blocks = new_value;
+        });
+    }
+};
+
+static _BufferPoolIniter s_buffer_pool_initer;
+
+static BufferBlock* NewBlock(size_t capacity) {
+    void* mem = malloc(sizeof(BufferBlock) + capacity);
+    if(!mem) {
+        throw std::bad_alloc();
+    }
+    BufferBlock* b = new (mem) BufferBlock;
+    b->capacity = capacity;
+    b->data = (char*)(b + 1);
+    return b;
+}
+
+static void DeleteBlock(BufferBlock* b) {
+    b->~BufferBlock();
+    free(b);
+}
+
+/**
+ * @brief 线程本地的空闲块, 线程退出时释放
+ */
+struct LocalPool {
+    ~LocalPool() {
+        for(auto& i : blocks) {
+            DeleteBlock(i);
+        }
+        blocks.clear();
+        destroyed = true;
+    }
+
+    std::vector<BufferBlock*> blocks;
+    bool destroyed = false;
+};
+
+static thread_local LocalPool t_pool;
+
+}
+
+void BufferBlock::ref_dec() {
+    if(ref.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        BufferPool::Release(this);
+    }
+}
+
+bool BufferBlock::tryExtend(uint32_t end, uint32_t len) {
+    if((uint64_t)end + len > capacity) {
+        return false;
+    }
+    return used.compare_exchange_strong(end, end + len, std::memory_order_acq_rel);
+}
+
+BufferBlock* BufferPool::Alloc(size_t size) {
+    uint32_t block_size = s_block_size;
+    BufferBlock* b = nullptr;
+    if(size <= block_size) {
+        while(!t_pool.blocks.empty()) {
+            b = t_pool.blocks.back();
+            t_pool.blocks.pop_back();
+            if(b->capacity == block_size) {
+                break;
+            }
+            //块大小配置变更前的旧块
+            DeleteBlock(b);
+            b = nullptr;
+        }
+        if(!b) {
+            b = NewBlock(block_size);
+        }
+        b->pooled = true;
+    } else {
+        b = NewBlock(size);
+        b->pooled = false;
+    }
+    b->ref.store(1, std::memory_order_relaxed);
+    b->used.store(0, std::memory_order_relaxed);
+    ++s_alive_blocks;
+    return b;
+}
+
+BufferBlock* BufferPool::Wrap(void* data, size_t size, std::function<void(void*)> deleter) {
+    BufferBlock* b = new (malloc(sizeof(BufferBlock))) BufferBlock;
+    b->ref.store(1, std::memory_order_relaxed);
+    b->used.store(size, std::memory_order_relaxed);
+    b->capacity = size;
+    b->pooled = false;
+    b->data = (char*)data;
+    b->deleter = std::move(deleter);
+    ++s_alive_blocks;
+    return b;
+}
+
+void BufferPool::Release(BufferBlock* block) {
+    --s_alive_blocks;
+    if(block->deleter) {
+        block->deleter(block->data);
+        DeleteBlock(block);
+        return;
+    }
+    if(block->pooled && block->capacity == s_block_size
+            && !t_pool.destroyed && t_pool.blocks.size() < s_pool_max_blocks) {
+        t_pool.blocks.push_back(block);
+        return;
+    }
+    DeleteBlock(block);
+}
+
+size_t BufferPool::GetBlockSize() {
+    return s_block_size;
+}
+
+int64_t BufferPool::GetAliveCount() {
+    return s_alive_blocks;
+}
+
+size_t BufferPool::GetLocalCachedCount() {
+    return t_pool.blocks.size();
+}
+
+BufferChain::Slice::Slice(BufferBlock* block, uint32_t offset, uint32_t length)
+    :m_block(block)
+    ,m_offset(offset)
+    ,m_length(length) {
+}
+
+BufferChain::Slice::Slice(const Slice& o)
+    :m_block(o.m_block)
+    ,m_offset(o.m_offset)
+    ,m_length(o.m_length) {
+    if(m_block) {
+        m_block->ref_inc();
+    }
+}
+
+BufferChain::Slice::Slice(Slice&& o)
+    :m_block(o.m_block)
+    ,m_offset(o.m_offset)
+    ,m_length(o.m_length) {
+    o.m_block = nullptr;
+}
+
+BufferChain::Slice& BufferChain::Slice::operator=(const Slice& o) {
+    if(this != &o) {
+        if(o.m_block) {
+            o.m_block->ref_inc();
+        }
+        if(m_block) {
+            m_block->ref_dec();
+        }
+        m_block = o.m_block;
+        m_offset = o.m_offset;
+        m_length = o.m_length;
+    }
+    return *this;
+}
+
+BufferChain::Slice& BufferChain::Slice::operator=(Slice&& o) {
+    if(this != &o) {
+        if(m_block) {
+            m_block->ref_dec();
+        }
+        m_block = o.m_block;
+        m_offset = o.m_offset;
+        m_length = o.m_length;
+        o.m_block = nullptr;
+    }
+    return *this;
+}
+
+BufferChain::Slice::~Slice() {
+    if(m_block) {
+        m_block->ref_dec();
+    }
+}
+
+BufferChain::BufferChain()
+    :m_size(0) {
+}
+
+BufferChain::BufferChain(const void* data, size_t len)
+    :m_size(0) {
+    append(data, len);
+}
+
+BufferChain::BufferChain(const BufferChain& o)
+    :m_slices(o.m_slices)
+    ,m_size(o.m_size) {
+}
+
+BufferChain::BufferChain(BufferChain&& o)
+    :m_slices(std::move(o.m_slices))
+    ,m_size(o.m_size)
+    ,m_pending(std::move(o.m_pending)) {
+    o.m_slices.clear();
+    o.m_size = 0;
+    o.m_pending.clear();
+}
+
+BufferChain& BufferChain::operator=(const BufferChain& o) {
+    if(this != &o) {
+        m_slices = o.m_slices;
+        m_size = o.m_size;
+    }
+    return *this;
+}
+
+BufferChain& BufferChain::operator=(BufferChain&& o) {
+    if(this != &o) {
+        commitWrite(0);
+        m_slices = std::move(o.m_slices);
+        m_size = o.m_size;
+        m_pending = std::move(o.m_pending);
+        o.m_slices.clear();
+        o.m_size = 0;
+        o.m_pending.clear();
+    }
+    return *this;
+}
+
+void BufferChain::clear() {
+    m_slices.clear();
+    m_size = 0;
+}
+
+void BufferChain::pushBack(Slice&& s) {
+    if(s.length() == 0) {
+        return;
+    }
+    m_size += s.length();
+    if(!m_slices.empty()) {
+        Slice& t = m_slices.back();
+        if(t.block() == s.block() && t.end() == s.offset()) {
+            t.extend(s.length());
+            return;
+        }
+    }
+    m_slices.push_back(std::move(s));
+}
+
+void BufferChain::append(const void* data, size_t len) {
+    const char* ptr = (const char*)data;
+    if(len && !m_slices.empty()) {
+        Slice& t = m_slices.back();
+        BufferBlock* b = t.block();
+        uint32_t n = std::min((size_t)(b->capacity - t.end()), len);
+        if(n && b->tryExtend(t.end(), n)) {
+            memcpy(b->data + t.end(), ptr, n);
+            t.extend(n);
+            m_size += n;
+            ptr += n;
+            len -= n;
+        }
+    }
+    while(len > 0) {
+        BufferBlock* b = BufferPool::Alloc();
+        uint32_t n = std::min((size_t)b->capacity, len);
+        memcpy(b->data, ptr, n);
+        b->used.store(n, std::memory_order_relaxed);
+        pushBack(Slice(b, 0, n));
+        ptr += n;
+        len -= n;
+    }
+}
+
+void BufferChain::append(const BufferChain& o) {
+    if(this == &o) {
+        BufferChain tmp(o);
+        append(std::move(tmp));
+        return;
+    }
+    for(auto& i : o.m_slices) {
+        pushBack(Slice(i));
+    }
+}
+
+void BufferChain::append(BufferChain&& o) {
+    if(m_slices.empty()) {
+        m_slices.swap(o.m_slices);
+        m_size = o.m_size;
+    } else {
+        for(auto& i : o.m_slices) {
+            pushBack(std::move(i));
+        }
+    }
+    o.m_slices.clear();
+    o.m_size = 0;
+}
+
+void BufferChain::appendExternal(void* data, size_t len, std::function<void(void*)> deleter) {
+    pushBack(Slice(BufferPool::Wrap(data, len, std::move(deleter)), 0, len));
+}
+
+void BufferChain::prepend(const void* data, size_t len) {
+    prepend(BufferChain(data, len));
+}
+
+void BufferChain::prepend(const BufferChain& o) {
+    if(o.empty()) {
+        return;
+    }
+    BufferChain tmp(o);
+    tmp.append(std::move(*this));
+    m_slices.swap(tmp.m_slices);
+    m_size = tmp.m_size;
+}
+
+BufferChain BufferChain::slice(size_t offset, size_t len) const {
+    BufferChain rt;
+    for(auto& i : m_slices) {
+        if(len == 0) {
+            break;
+        }
+        if(offset >= i.length()) {
+            offset -= i.length();
+            continue;
+        }
+        Slice s(i);
+        s.trimFront(offset);
+        offset = 0;
+        if(s.length() > len) {
+            s.trimBack(s.length() - len);
+        }
+        len -= s.length();
+        rt.pushBack(std::move(s));
+    }
+    return rt;
+}
+
+BufferChain BufferChain::cut(size_t len) {
+    BufferChain rt;
+    while(len > 0 && !m_slices.empty()) {
+        Slice& f = m_slices.front();
+        if(f.length() <= len) {
+            len -= f.length();
+            m_size -= f.length();
+            rt.pushBack(std::move(f));
+            m_slices.pop_front();
+        } else {
+            Slice s(f);
+            s.trimBack(s.length() - len);
+            f.trimFront(len);
+            m_size -= len;
+            len = 0;
+            rt.pushBack(std::move(s));
+        }
+    }
+    return rt;
+}
+
+void BufferChain::consume(size_t len) {
+    while(len > 0 && !m_slices.empty()) {
+        Slice& f = m_slices.front();
+        if(f.length() <= len) {
+            len -= f.length();
+            m_size -= f.length();
+            m_slices.pop_front();
+        } else {
+            f.trimFront(len);
+            m_size -= len;
+            len = 0;
+        }
+    }
+}
+
+void BufferChain::truncate(size_t len) {
+    while(m_size > len) {
+        Slice& t = m_slices.back();
+        size_t diff = m_size - len;
+        if(t.length() <= diff) {
+            m_size -= t.length();
+            m_slices.pop_back();
+        } else {
+            t.trimBack(diff);
+            m_size = len;
+        }
+    }
+}
+
+size_t BufferChain::copyTo(void* buf, size_t len, size_t offset) const {
+    size_t copied = 0;
+    for(auto& i : m_slices) {
+        if(copied == len) {
+            break;
+        }
+        if(offset >= i.length()) {
+            offset -= i.length();
+            continue;
+        }
+        size_t n = std::min((size_t)i.length() - offset, len - copied);
+        memcpy((char*)buf + copied, i.data() + offset, n);
+        copied += n;
+        offset = 0;
+    }
+    return copied;
+}
+
+void BufferChain::read(void* buf, size_t len) {
+    if(len > m_size) {
+        throw std::out_of_range("not enough len");
+    }
+    copyTo(buf, len);
+    consume(len);
+}
+
+const char* BufferChain::linearize(size_t len) {
+    if(len > m_size) {
+        return nullptr;
+    }
+    if(len == 0 || m_slices.front().length() >= len) {
+        return m_slices.empty() ? "" : m_slices.front().data();
+    }
+    BufferBlock* b = BufferPool::Alloc(len);
+    copyTo(b->data, len);
+    b->used.store(len, std::memory_order_relaxed);
+    consume(len);
+    m_slices.push_front(Slice(b, 0, len));
+    m_size += len;
+    return b->data;
+}
+
+std::string BufferChain::toString() const {
+    std::string rt;
+    rt.resize(m_size);
+    if(m_size) {
+        copyTo(&rt[0], m_size);
+    }
+    return rt;
+}
+
+uint64_t BufferChain::getReadBuffers(std::vector<iovec>& buffers, uint64_t len) const {
+    return getReadBuffers(buffers, len, 0);
+}
+
+uint64_t BufferChain::getReadBuffers(std::vector<iovec>& buffers
+                                ,uint64_t len, uint64_t position) const {
+    if(position >= m_size) {
+        return 0;
+    }
+    len = std::min(len, (uint64_t)(m_size - position));
+    uint64_t size = len;
+    for(auto& i : m_slices) {
+        if(len == 0) {
+            break;
+        }
+        if(position >= i.length()) {
+            position -= i.length();
+            continue;
+        }
+        iovec iov;
+        iov.iov_base = i.data() + position;
+        iov.iov_len = std::min((uint64_t)i.length() - position, len);
+        buffers.push_back(iov);
+        len -= iov.iov_len;
+        position = 0;
+    }
+    return size;
+}
+
+uint64_t BufferChain::getWriteBuffers(std::vector<iovec>& buffers, uint64_t len) {
+    commitWrite(0);
+    if(len == 0) {
+        return 0;
+    }
+    uint64_t size = len;
+    //先占用尾部块的剩余空间
+    if(!m_slices.empty()) {
+        Slice& t = m_slices.back();
+        BufferBlock* b = t.block();
+        uint32_t n = std::min((uint64_t)(b->capacity - t.end()), len);
+        if(n && b->tryExtend(t.end(), n)) {
+            b->ref_inc();
+            m_pending.push_back(Slice(b, t.end(), n));
+            len -= n;
+        }
+    }
+    while(len > 0) {
+        BufferBlock* b = BufferPool::Alloc();
+        uint32_t n = std::min((uint64_t)b->capacity, len);
+        b->used.store(n, std::memory_order_relaxed);
+        m_pending.push_back(Slice(b, 0, n));
+        len -= n;
+    }
+    for(auto& i : m_pending) {
+        iovec iov;
+        iov.iov_base = i.data();
+        iov.iov_len = i.length();
+        buffers.push_back(iov);
+    }
+    return size;
+}
+
+void BufferChain::commitWrite(size_t len) {
+    for(auto& i : m_pending) {
+        uint32_t n = std::min((size_t)i.length(), len);
+        len -= n;
+        //归还未写入的部分, 之后的append可以继续使用
+        uint32_t expect = i.end();
+        i.block()->used.compare_exchange_strong(expect, i.offset() + n
+                , std::memory_order_acq_rel);
+        i.trimBack(i.length() - n);
+        pushBack(std::move(i));
+    }
+    m_pending.clear();
+}
+
+void BufferChain::append(ByteArray::ptr ba, size_t len) {
+    std::vector<iovec> iovs;
+    ba->getReadBuffers(iovs, len);
+    for(auto& i : iovs) {
+        append(i.iov_base, i.iov_len);
+    }
+}
+
+void BufferChain::writeTo(ByteArray::ptr ba, size_t len) const {
+    len = std::min(len, m_size);
+    for(auto& i : m_slices) {
+        if(len == 0) {
+            break;
+        }
+        size_t n = std::min((size_t)i.length(), len);
+        ba->write(i.data(), n);
+        len -= n;
+    }
+}
+
+ByteArray::ptr BufferChain::toByteArray() const {
+    ByteArray::ptr ba(new ByteArray);
+    writeTo(ba);
+    ba->setPosition(0);
+    return ba;
+}
+
+}
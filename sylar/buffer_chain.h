@@ -0,0 +1,245 @@
+/**
+ * @file buffer_chain.h
+ * @brief 引用计数的分片缓存链
+ * @details BufferChain由若干指向BufferBlock的分片组成, 拷贝/拼接/切片只增加引用计数,
+ *          不复制数据. BufferBlock由线程本地的内存池分配和回收,
+ *          可以在线程间传递, 在哪个线程释放就回收到哪个线程的池中.
+ */
+#ifndef __SYLAR_BUFFER_CHAIN_H__
+#define __SYLAR_BUFFER_CHAIN_H__
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/uio.h>
+#include "bytearray.h"
+
+namespace sylar {
+
+/**
+ * @brief 引用计数的内存块
+ * @details used是已写入数据的高水位, 只有末尾恰好等于used的分片才能原地追加,
+ *          多个链共享同一块时通过CAS竞争, 失败的一方另外分配新块, 已写入的数据不会被修改
+ */
+struct BufferBlock {
+    /// 引用计数
+    std::atomic<int32_t> ref;
+    /// 已写入的高水位
+    std::atomic<uint32_t> used;
+    /// 容量
+    uint32_t capacity;
+    /// 是否来自内存池(容量为标准块大小)
+    bool pooled;
+    /// 数据地址
+    char* data;
+    /// 外部内存的释放函数
+    std::function<void(void*)> deleter;
+
+    void ref_inc() { ref.fetch_add(1, std::memory_order_relaxed);}
+    void ref_dec();
+
+    /**
+     * @brief 尝试把高水位从end移动到end + len
+     */
+    bool tryExtend(uint32_t end, uint32_t len);
+};
+
+/**
+ * @brief 线程本地的BufferBlock池
+ * @details 标准大小(配置buffer.block_size)的块释放后进入当前线程的池,
+ *          池中数量超过buffer.pool_max_blocks时直接释放; 大于标准大小的块不入池
+ */
+class BufferPool {
+public:
+    /**
+     * @brief 分配容量至少为size的块, size为0时分配标准块, 引用计数为1
+     */
+    static BufferBlock* Alloc(size_t size = 0);
+    /**
+     * @brief 接管外部内存, 引用归零时调用deleter(data)
+     */
+    static BufferBlock* Wrap(void* data, size_t size, std::function<void(void*)> deleter);
+    /**
+     * @brief 引用归零后回收
+     */
+    static void Release(BufferBlock* block);
+
+    /**
+     * @brief 标准块大小
+     */
+    static size_t GetBlockSize();
+    /**
+     * @brief 当前存活(未回收到池)的块数
+     */
+    static int64_t GetAliveCount();
+    /**
+     * @brief 当前线程池中缓存的块数
+     */
+    static size_t GetLocalCachedCount();
+};
+
+/**
+ * @brief 分片缓存链
+ * @details 非线程安全, 与ByteArray一致; 共享的数据块可以被多个线程中的链同时持有
+ */
+class BufferChain {
+public:
+    typedef std::shared_ptr<BufferChain> ptr;
+
+    /**
+     * @brief 分片, 引用[block->data + offset, block->data + offset + length)
+     * @details 用裸指针构造时接管调用方持有的一个引用, 拷贝时增加引用
+     */
+    class Slice {
+    public:
+        Slice(BufferBlock* block = nullptr, uint32_t offset = 0, uint32_t length = 0);
+        Slice(const Slice& o);
+        Slice(Slice&& o);
+        Slice& operator=(const Slice& o);
+        Slice& operator=(Slice&& o);
+        ~Slice();
+
+        BufferBlock* block() const { return m_block;}
+        char* data() const { return m_block->data + m_offset;}
+        uint32_t offset() const { return m_offset;}
+        uint32_t length() const { return m_length;}
+        uint32_t end() const { return m_offset + m_length;}
+
+        void trimFront(uint32_t n) { m_offset += n; m_length -= n;}
+        void trimBack(uint32_t n) { m_length -= n;}
+        void extend(uint32_t n) { m_length += n;}
+    private:
+        BufferBlock* m_block;
+        uint32_t m_offset;
+        uint32_t m_length;
+    };
+
+    BufferChain();
+    BufferChain(const void* data, size_t len);
+    /**
+     * @brief 共享o的数据块, 不复制数据; 未提交的写缓存不会被拷贝
+     */
+    BufferChain(const BufferChain& o);
+    BufferChain(BufferChain&& o);
+    BufferChain& operator=(const BufferChain& o);
+    BufferChain& operator=(BufferChain&& o);
+
+    /**
+     * @brief 数据总长度
+     */
+    size_t size() const { return m_size;}
+    bool empty() const { return m_size == 0;}
+    /**
+     * @brief 分片数量
+     */
+    size_t getSliceCount() const { return m_slices.size();}
+    const std::deque<Slice>& getSlices() const { return m_slices;}
+
+    void clear();
+
+    /**
+     * @brief 复制数据到链尾, 尾部块有空间且未被其它分片占用时原地写入
+     */
+    void append(const void* data, size_t len);
+    void append(const std::string& data) { append(data.c_str(), data.size());}
+    /**
+     * @brief 零拷贝追加, 只增加引用计数
+     */
+    void append(const BufferChain& o);
+    void append(BufferChain&& o);
+    /**
+     * @brief 零拷贝接管外部内存, 引用归零时调用deleter(data)
+     */
+    void appendExternal(void* data, size_t len, std::function<void(void*)> deleter);
+
+    /**
+     * @brief 复制数据到链头
+     */
+    void prepend(const void* data, size_t len);
+    /**
+     * @brief 零拷贝插入到链头
+     */
+    void prepend(const BufferChain& o);
+
+    /**
+     * @brief 零拷贝切片[offset, offset + len), 超出部分截断
+     */
+    BufferChain slice(size_t offset, size_t len = ~0ull) const;
+    /**
+     * @brief 零拷贝取出前len个字节, 本链中移除这部分
+     */
+    BufferChain cut(size_t len);
+    /**
+     * @brief 丢弃前len个字节
+     */
+    void consume(size_t len);
+    /**
+     * @brief 只保留前len个字节
+     */
+    void truncate(size_t len);
+
+    /**
+     * @brief 从offset开始复制最多len个字节到buf
+     * @return 实际复制的长度
+     */
+    size_t copyTo(void* buf, size_t len, size_t offset = 0) const;
+    /**
+     * @brief 复制并丢弃前len个字节
+     * @exception 如果size() < len 则抛出 std::out_of_range
+     */
+    void read(void* buf, size_t len);
+    /**
+     * @brief 使前len个字节位于同一块中并返回其地址, 已连续时不复制
+     * @return size() < len时返回nullptr
+     */
+    const char* linearize(size_t len);
+
+    std::string toString() const;
+
+    /**
+     * @brief 获取可读取的缓存, 与ByteArray::getReadBuffers一致
+     * @param[in] len 读取长度, 大于size()时为size()
+     * @return 实际长度
+     */
+    uint64_t getReadBuffers(std::vector<iovec>& buffers, uint64_t len = ~0ull) const;
+    uint64_t getReadBuffers(std::vector<iovec>& buffers, uint64_t len, uint64_t position) const;
+
+    /**
+     * @brief 获取可写入的缓存, 用于readv/recvmsg直接写入
+     * @details 写入完成后调用commitWrite提交实际写入的长度, 再次调用前未提交的缓存作废;
+     *          提交前不要修改本链
+     */
+    uint64_t getWriteBuffers(std::vector<iovec>& buffers, uint64_t len);
+    /**
+     * @brief 把getWriteBuffers中前len个字节追加到链尾
+     */
+    void commitWrite(size_t len);
+
+    /**
+     * @brief 复制ByteArray中[position, position + len)的数据, 不改变ba的position
+     */
+    void append(ByteArray::ptr ba, size_t len = ~0ull);
+    /**
+     * @brief 复制前len个字节写入ba, 不改变本链
+     */
+    void writeTo(ByteArray::ptr ba, size_t len = ~0ull) const;
+    /**
+     * @brief 转成ByteArray, position为0
+     */
+    ByteArray::ptr toByteArray() const;
+private:
+    void pushBack(Slice&& s);
+private:
+    std::deque<Slice> m_slices;
+    size_t m_size;
+    /// getWriteBuffers分配的待提交块
+    std::vector<Slice> m_pending;
+};
+
+}
+
+#endif
@@ -3,10 +3,15 @@
 #include <sstream>
 #include <string.h>
 #include <iomanip>
+#include <algorithm>
 
 #include "endian.h"
 #include "log.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace sylar {
 
 static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
@@ -36,7 +41,8 @@ ByteArray::ByteArray(size_t base_size)
     ,m_size(0)
     ,m_endian(SYLAR_BIG_ENDIAN)
     ,m_root(new Node(base_size))
-    ,m_cur(m_root) {
+    ,m_cur(m_root)
+    ,m_offset(0) {
 }
 
 ByteArray::~ByteArray() {
@@ -61,52 +67,52 @@ void ByteArray::setIsLittleEndian(bool val) {
 }
 
 void ByteArray::writeFint8  (int8_t value) {
-    write(&value, sizeof(value));
+    writeFast(&value, sizeof(value));
 }
 
 void ByteArray::writeFuint8 (uint8_t value) {
-    write(&value, sizeof(value));
+    writeFast(&value, sizeof(value));
 }
 void ByteArray::writeFint16 (int16_t value) {
     if(m_endian != SYLAR_BYTE_ORDER) {
         value = byteswap(value);
     }
-    write(&value, sizeof(value));
+    writeFast(&value, sizeof(value));
 }
 
 void ByteArray::writeFuint16(uint16_t value) {
     if(m_endian != SYLAR_BYTE_ORDER) {
         value = byteswap(value);
     }
-    write(&value, sizeof(value));
+    writeFast(&value, sizeof(value));
 }
 
 void ByteArray::writeFint32 (int32_t value) {
     if(m_endian != SYLAR_BYTE_ORDER) {
         value = byteswap(value);
     }
-    write(&value, sizeof(value));
+    writeFast(&value, sizeof(value));
 }
 
 void ByteArray::writeFuint32(uint32_t value) {
     if(m_endian != SYLAR_BYTE_ORDER) {
         value = byteswap(value);
     }
-    write(&value, sizeof(value));
+    writeFast(&value, sizeof(value));
 }
 
 void ByteArray::writeFint64 (int64_t value) {
     if(m_endian != SYLAR_BYTE_ORDER) {
         value = byteswap(value);
     }
-    write(&value, sizeof(value));
+    writeFast(&value, sizeof(value));
 }
 
 void ByteArray::writeFuint64(uint64_t value) {
     if(m_endian != SYLAR_BYTE_ORDER) {
         value = byteswap(value);
     }
-    write(&value, sizeof(value));
+    writeFast(&value, sizeof(value));
 }
 
 static uint32_t EncodeZigzag32(const int32_t& v) {
@@ -133,20 +139,140 @@ static int64_t DecodeZigzag64(const uint64_t& v) {
     return (v >> 1) ^ -(v & 1);
 }
 
+static inline uint8_t* EncodeVarint32(uint8_t* p, uint32_t value) {
+    while(value >= 0x80) {
+        *p++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+static inline uint8_t* EncodeVarint64(uint8_t* p, uint64_t value) {
+    while(value >= 0x80) {
+        *p++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *p++ = value;
+    return p;
+}
+
+/**
+ * @brief 无分支编码, 小于2^56的值最多8个字节, 一次写入8个字节
+ * @pre p开始至少有8个字节可写
+ * @return 写入结束位置
+ */
+static inline uint8_t* EncodeVarintWord(uint8_t* p, uint64_t value) {
+    size_t bits = 63 - __builtin_clzll(value | 1);
+    size_t len = (bits * 9 + 73) / 64;
+    uint64_t w = (value & 0x7fULL)
+        | ((value << 1) & 0x7f00ULL)
+        | ((value << 2) & 0x7f0000ULL)
+        | ((value << 3) & 0x7f000000ULL)
+        | ((value << 4) & 0x7f00000000ULL)
+        | ((value << 5) & 0x7f0000000000ULL)
+        | ((value << 6) & 0x7f000000000000ULL)
+        | ((value << 7) & 0x7f00000000000000ULL);
+    w |= 0x8080808080808080ULL & ((1ULL << ((len - 1) * 8)) - 1);
+    w = byteswapOnBigEndian(w);
+    memcpy(p, &w, sizeof(w));
+    return p + len;
+}
+
+/**
+ * @brief EncodeVarintWord的写入版本: tail为true时(p之后没有有效数据)直接写8个字节,
+ *        否则在栈上编码后只复制编码长度, 不覆盖p之后的已有数据
+ */
+static inline uint8_t* EncodeVarintWord(uint8_t* p, uint64_t value, bool tail) {
+    if(tail) {
+        return EncodeVarintWord(p, value);
+    }
+    uint8_t tmp[8];
+    size_t len = EncodeVarintWord(tmp, value) - tmp;
+    memcpy(p, tmp, len);
+    return p + len;
+}
+
+static inline uint64_t LoadLE64(const uint8_t* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return byteswapOnBigEndian(v);
+}
+
+/**
+ * @brief 将8个字节的低7位依次拼接(等价于pext(v, 0x7f7f7f7f7f7f7f7f))
+ */
+static inline uint64_t CompactVarint(uint64_t v) {
+    return (v & 0x7fULL)
+        | ((v >> 1) & 0x3f80ULL)
+        | ((v >> 2) & 0x1fc000ULL)
+        | ((v >> 3) & 0xfe00000ULL)
+        | ((v >> 4) & 0x7f0000000ULL)
+        | ((v >> 5) & 0x3f800000000ULL)
+        | ((v >> 6) & 0x1fc0000000000ULL)
+        | ((v >> 7) & 0xfe000000000000ULL);
+}
+
+/**
+ * @brief 从p解码Varint32, 最多5个字节(与readUint32一致)
+ * @pre p开始至少有8个字节可读
+ * @return 消耗的字节数
+ */
+static inline size_t DecodeVarint32(const uint8_t* p, uint32_t& value) {
+    uint64_t v = LoadLE64(p);
+    uint64_t stop = ~v & 0x8080808080ULL;
+    size_t len = stop ? (__builtin_ctzll(stop) >> 3) + 1 : 5;
+    v &= ~0ULL >> (64 - len * 8);
+    value = (uint32_t)CompactVarint(v);
+    return len;
+}
+
+/**
+ * @brief 从p解码Varint64, 最多10个字节(与readUint64一致)
+ * @pre p开始至少有10个字节可读
+ * @return 消耗的字节数
+ */
+static inline size_t DecodeVarint64(const uint8_t* p, uint64_t& value) {
+    uint64_t v = LoadLE64(p);
+    uint64_t stop = ~v & 0x8080808080808080ULL;
+    if(stop) {
+        size_t len = (__builtin_ctzll(stop) >> 3) + 1;
+        if(len < 8) {
+            v &= ~0ULL >> (64 - len * 8);
+        }
+        value = CompactVarint(v);
+        return len;
+    }
+    value = CompactVarint(v);
+    if(p[8] < 0x80) {
+        value |= ((uint64_t)p[8]) << 56;
+        return 9;
+    }
+    value |= ((uint64_t)(p[8] & 0x7f)) << 56;
+    value |= ((uint64_t)(p[9] & 0x7f)) << 63;
+    return 10;
+}
+
+/**
+ * @brief 连续16个字节最高位都为0, 即16个单字节Varint
+ */
+static inline bool IsSingleByte16(const uint8_t* p) {
+    return ((LoadLE64(p) | LoadLE64(p + 8)) & 0x8080808080808080ULL) == 0;
+}
+
 
 void ByteArray::writeInt32  (int32_t value) {
     writeUint32(EncodeZigzag32(value));
 }
 
 void ByteArray::writeUint32 (uint32_t value) {
-    uint8_t tmp[5];
-    uint8_t i = 0;
-    while(value >= 0x80) {
-        tmp[i++] = (value & 0x7F) | 0x80;
-        value >>= 7;
+    if(nodeWritable() > 5) {
+        uint8_t* p = (uint8_t*)m_cur->ptr + m_offset;
+        skipInNode(EncodeVarint32(p, value) - p);
+        return;
     }
-    tmp[i++] = value;
-    write(tmp, i);
+    uint8_t tmp[5];
+    write(tmp, EncodeVarint32(tmp, value) - tmp);
 }
 
 void ByteArray::writeInt64  (int64_t value) {
@@ -154,14 +280,13 @@ void ByteArray::writeInt64  (int64_t value) {
 }
 
 void ByteArray::writeUint64 (uint64_t value) {
-    uint8_t tmp[10];
-    uint8_t i = 0;
-    while(value >= 0x80) {
-        tmp[i++] = (value & 0x7F) | 0x80;
-        value >>= 7;
+    if(nodeWritable() > 10) {
+        uint8_t* p = (uint8_t*)m_cur->ptr + m_offset;
+        skipInNode(EncodeVarint64(p, value) - p);
+        return;
     }
-    tmp[i++] = value;
-    write(tmp, i);
+    uint8_t tmp[10];
+    write(tmp, EncodeVarint64(tmp, value) - tmp);
 }
 
 void ByteArray::writeFloat  (float value) {
@@ -202,19 +327,19 @@ void ByteArray::writeStringWithoutLength(const std::string& value) {
 
 int8_t   ByteArray::readFint8() {
     int8_t v;
-    read(&v, sizeof(v));
+    readFast(&v, sizeof(v));
     return v;
 }
 
 uint8_t  ByteArray::readFuint8() {
     uint8_t v;
-    read(&v, sizeof(v));
+    readFast(&v, sizeof(v));
     return v;
 }
 
 #define XX(type) \
     type v; \
-    read(&v, sizeof(v)); \
+    readFast(&v, sizeof(v)); \
     if(m_endian == SYLAR_BYTE_ORDER) { \
         return v; \
     } else { \
@@ -251,6 +376,11 @@ int32_t  ByteArray::readInt32() {
 }
 
 uint32_t ByteArray::readUint32() {
+    if(nodeReadable() >= 8) {
+        uint32_t v;
+        skipInNode(DecodeVarint32((const uint8_t*)m_cur->ptr + m_offset, v));
+        return v;
+    }
     uint32_t result = 0;
     for(int i = 0; i < 32; i += 7) {
         uint8_t b = readFuint8();
@@ -269,6 +399,11 @@ int64_t  ByteArray::readInt64() {
 }
 
 uint64_t ByteArray::readUint64() {
+    if(nodeReadable() > 10) {
+        uint64_t v;
+        skipInNode(DecodeVarint64((const uint8_t*)m_cur->ptr + m_offset, v));
+        return v;
+    }
     uint64_t result = 0;
     for(int i = 0; i < 64; i += 7) {
         uint8_t b = readFuint8();
@@ -328,6 +463,225 @@ std::string ByteArray::readStringVint() {
     return buff;
 }
 
+void ByteArray::writeUint32Array(const uint32_t* values, size_t count) {
+    //每个值至少1个字节, 预先扩容不会多分配
+    addCapacity(count);
+    size_t i = 0;
+    while(i < count) {
+        size_t avail = nodeWritable();
+        if(avail <= 5) {
+            writeUint32(values[i++]);
+            continue;
+        }
+        uint8_t* begin = (uint8_t*)m_cur->ptr + m_offset;
+        uint8_t* limit = begin + avail;
+        uint8_t* p = begin;
+        //从begin开始tail个字节是已有数据, 按8字节写入时不能越过
+        size_t tail = m_size > m_position ? m_size - m_position : 0;
+        while(i < count && p + 5 < limit) {
+            if(i + 16 <= count && p + 16 < limit) {
+#if defined(__SSE2__)
+                const __m128i* src = (const __m128i*)(values + i);
+                __m128i v0 = _mm_loadu_si128(src);
+                __m128i v1 = _mm_loadu_si128(src + 1);
+                __m128i v2 = _mm_loadu_si128(src + 2);
+                __m128i v3 = _mm_loadu_si128(src + 3);
+                __m128i big = _mm_or_si128(_mm_or_si128(v0, v1), _mm_or_si128(v2, v3));
+                big = _mm_and_si128(big, _mm_set1_epi32(~0x7f));
+                if(_mm_movemask_epi8(_mm_cmpeq_epi32(big, _mm_setzero_si128())) == 0xffff) {
+                    //16个值都小于128, 压缩成16个单字节
+                    __m128i w0 = _mm_packs_epi32(v0, v1);
+                    __m128i w1 = _mm_packs_epi32(v2, v3);
+                    _mm_storeu_si128((__m128i*)p, _mm_packus_epi16(w0, w1));
+                    p += 16;
+                    i += 16;
+                    continue;
+                }
+#else
+                uint32_t big = 0;
+                for(int k = 0; k < 16; ++k) {
+                    big |= values[i + k];
+                }
+                if(big < 0x80) {
+                    for(int k = 0; k < 16; ++k) {
+                        p[k] = values[i + k];
+                    }
+                    p += 16;
+                    i += 16;
+                    continue;
+                }
+#endif
+                //含多字节值的块逐个编码, 避免每个值都重复检测
+                size_t end = i + 16;
+                while(i < end && p + 8 < limit) {
+                    p = EncodeVarintWord(p, values[i++], (size_t)(p - begin) >= tail);
+                }
+                continue;
+            }
+            p = EncodeVarint32(p, values[i++]);
+        }
+        skipInNode(p - begin);
+    }
+}
+
+void ByteArray::writeInt32Array(const int32_t* values, size_t count) {
+    uint32_t tmp[256];
+    for(size_t i = 0; i < count; i += 256) {
+        size_t n = std::min(count - i, (size_t)256);
+        for(size_t k = 0; k < n; ++k) {
+            tmp[k] = EncodeZigzag32(values[i + k]);
+        }
+        writeUint32Array(tmp, n);
+    }
+}
+
+void ByteArray::writeUint64Array(const uint64_t* values, size_t count) {
+    addCapacity(count);
+    size_t i = 0;
+    while(i < count) {
+        size_t avail = nodeWritable();
+        if(avail <= 10) {
+            writeUint64(values[i++]);
+            continue;
+        }
+        uint8_t* begin = (uint8_t*)m_cur->ptr + m_offset;
+        uint8_t* limit = begin + avail;
+        uint8_t* p = begin;
+        size_t tail = m_size > m_position ? m_size - m_position : 0;
+        while(i < count && p + 10 < limit) {
+            if(i + 16 <= count && p + 16 < limit) {
+                uint64_t big = 0;
+                for(int k = 0; k < 16; ++k) {
+                    big |= values[i + k];
+                }
+                if(big < 0x80) {
+                    for(int k = 0; k < 16; ++k) {
+                        p[k] = values[i + k];
+                    }
+                    p += 16;
+                    i += 16;
+                    continue;
+                }
+                size_t end = i + 16;
+                while(i < end && p + 10 < limit) {
+                    uint64_t v = values[i++];
+                    p = v < (1ULL << 56) ? EncodeVarintWord(p, v, (size_t)(p - begin) >= tail)
+                                         : EncodeVarint64(p, v);
+                }
+                continue;
+            }
+            p = EncodeVarint64(p, values[i++]);
+        }
+        skipInNode(p - begin);
+    }
+}
+
+void ByteArray::writeInt64Array(const int64_t* values, size_t count) {
+    uint64_t tmp[256];
+    for(size_t i = 0; i < count; i += 256) {
+        size_t n = std::min(count - i, (size_t)256);
+        for(size_t k = 0; k < n; ++k) {
+            tmp[k] = EncodeZigzag64(values[i + k]);
+        }
+        writeUint64Array(tmp, n);
+    }
+}
+
+void ByteArray::readUint32Array(uint32_t* values, size_t count) {
+    size_t i = 0;
+    while(i < count) {
+        size_t avail = nodeReadable();
+        if(avail < 8) {
+            //块尾或数据尾部, 逐字节读取(数据不足时抛出异常)
+            values[i++] = readUint32();
+            continue;
+        }
+        const uint8_t* begin = (const uint8_t*)m_cur->ptr + m_offset;
+        const uint8_t* limit = begin + avail;
+        const uint8_t* p = begin;
+        while(i < count && p + 8 <= limit) {
+            if(i + 16 <= count && p + 16 < limit) {
+                if(IsSingleByte16(p)) {
+#if defined(__SSE2__)
+                    __m128i zero = _mm_setzero_si128();
+                    __m128i b = _mm_loadu_si128((const __m128i*)p);
+                    __m128i lo = _mm_unpacklo_epi8(b, zero);
+                    __m128i hi = _mm_unpackhi_epi8(b, zero);
+                    __m128i* dst = (__m128i*)(values + i);
+                    _mm_storeu_si128(dst, _mm_unpacklo_epi16(lo, zero));
+                    _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo, zero));
+                    _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi, zero));
+                    _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi, zero));
+#else
+                    for(int k = 0; k < 16; ++k) {
+                        values[i + k] = p[k];
+                    }
+#endif
+                    p += 16;
+                    i += 16;
+                    continue;
+                }
+                size_t end = i + 16;
+                while(i < end && p + 8 <= limit) {
+                    p += DecodeVarint32(p, values[i++]);
+                }
+                continue;
+            }
+            p += DecodeVarint32(p, values[i++]);
+        }
+        skipInNode(p - begin);
+    }
+}
+
+void ByteArray::readInt32Array(int32_t* values, size_t count) {
+    uint32_t* uv = (uint32_t*)values;
+    readUint32Array(uv, count);
+    for(size_t i = 0; i < count; ++i) {
+        values[i] = DecodeZigzag32(uv[i]);
+    }
+}
+
+void ByteArray::readUint64Array(uint64_t* values, size_t count) {
+    size_t i = 0;
+    while(i < count) {
+        size_t avail = nodeReadable();
+        if(avail <= 10) {
+            values[i++] = readUint64();
+            continue;
+        }
+        const uint8_t* begin = (const uint8_t*)m_cur->ptr + m_offset;
+        const uint8_t* limit = begin + avail;
+        const uint8_t* p = begin;
+        while(i < count && p + 10 < limit) {
+            if(i + 16 <= count && p + 16 < limit) {
+                if(IsSingleByte16(p)) {
+                    for(int k = 0; k < 16; ++k) {
+                        values[i + k] = p[k];
+                    }
+                    p += 16;
+                    i += 16;
+                    continue;
+                }
+                size_t end = i + 16;
+                while(i < end && p + 10 < limit) {
+                    p += DecodeVarint64(p, values[i++]);
+                }
+                continue;
+            }
+            p += DecodeVarint64(p, values[i++]);
+        }
+        skipInNode(p - begin);
+    }
+}
+
+void ByteArray::readInt64Array(int64_t* values, size_t count) {
+    uint64_t* uv = (uint64_t*)values;
+    readUint64Array(uv, count);
+    for(size_t i = 0; i < count; ++i) {
+        values[i] = DecodeZigzag64(uv[i]);
+    }
+}
+
 void ByteArray::clear() {
     m_position = m_size = 0;
     m_capacity = m_baseSize;
@@ -338,6 +692,7 @@ void ByteArray::clear() {
         delete m_cur;
     }
     m_cur = m_root;
+    m_offset = 0;
     m_root->next = NULL;
 }
 
@@ -347,15 +702,17 @@ void ByteArray::write(const void* buf, size_t size) {
     }
     addCapacity(size);
 
-    size_t npos = m_position % m_baseSize;
+    size_t npos = m_offset;
     size_t ncap = m_cur->size - npos;
     size_t bpos = 0;
 
     while(size > 0) {
         if(ncap >= size) {
             memcpy(m_cur->ptr + npos, (const char*)buf + bpos, size);
-            if(m_cur->size == (npos + size)) {
+            m_offset = npos + size;
+            if(m_cur->size == m_offset) {
                 m_cur = m_cur->next;
+                m_offset = 0;
             }
             m_position += size;
             bpos += size;
@@ -381,14 +738,16 @@ void ByteArray::read(void* buf, size_t size) {
         throw std::out_of_range("not enough len");
     }
 
-    size_t npos = m_position % m_baseSize;
+    size_t npos = m_offset;
     size_t ncap = m_cur->size - npos;
     size_t bpos = 0;
     while(size > 0) {
         if(ncap >= size) {
             memcpy((char*)buf + bpos, m_cur->ptr + npos, size);
-            if(m_cur->size == (npos + size)) {
+            m_offset = npos + size;
+            if(m_cur->size == m_offset) {
                 m_cur = m_cur->next;
+                m_offset = 0;
             }
             m_position += size;
             bpos += size;
@@ -450,7 +809,9 @@ void ByteArray::setPosition(size_t v) {
     }
     if(v == m_cur->size) {
         m_cur = m_cur->next;
+        v = 0;
     }
+    m_offset = v;
 }
 
 bool ByteArray::writeToFile(const std::string& name) const {
@@ -12,6 +12,7 @@
 #include <memory>
 #include <string>
 #include <stdint.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <vector>
@@ -337,6 +338,56 @@ public:
      */
     std::string readStringVint();
 
+    /**
+     * @brief 批量写入无符号Varint32类型的数据, 编码结果与逐个writeUint32一致
+     * @param[in] values 数据数组
+     * @param[in] count 数据个数
+     * @post m_position += 实际占用内存(count ~ count * 5)
+     *       如果m_position > m_size 则 m_size = m_position
+     */
+    void writeUint32Array(const uint32_t* values, size_t count);
+
+    /**
+     * @brief 批量写入有符号Varint32类型的数据(Zigzag编码)
+     */
+    void writeInt32Array(const int32_t* values, size_t count);
+
+    /**
+     * @brief 批量写入无符号Varint64类型的数据, 编码结果与逐个writeUint64一致
+     * @post m_position += 实际占用内存(count ~ count * 10)
+     *       如果m_position > m_size 则 m_size = m_position
+     */
+    void writeUint64Array(const uint64_t* values, size_t count);
+
+    /**
+     * @brief 批量写入有符号Varint64类型的数据(Zigzag编码)
+     */
+    void writeInt64Array(const int64_t* values, size_t count);
+
+    /**
+     * @brief 批量读取无符号Varint32类型的数据
+     * @param[out] values 数据数组, 至少容纳count个
+     * @param[in] count 读取个数
+     * @exception 如果数据不足count个则抛出 std::out_of_range, 已解码的数据保留在values中
+     */
+    void readUint32Array(uint32_t* values, size_t count);
+
+    /**
+     * @brief 批量读取有符号Varint32类型的数据(Zigzag编码)
+     */
+    void readInt32Array(int32_t* values, size_t count);
+
+    /**
+     * @brief 批量读取无符号Varint64类型的数据
+     * @exception 如果数据不足count个则抛出 std::out_of_range
+     */
+    void readUint64Array(uint64_t* values, size_t count);
+
+    /**
+     * @brief 批量读取有符号Varint64类型的数据(Zigzag编码)
+     */
+    void readInt64Array(int64_t* values, size_t count);
+
     /**
      * @brief 清空ByteArray
      * @post m_position = 0, m_size = 0
@@ -464,6 +515,61 @@ private:
      * @brief 获取当前的可写入容量
      */
     size_t getCapacity() const { return m_capacity - m_position;}
+
+    /**
+     * @brief 数据完全落在当前内存块内时直接拷贝, 否则走通用的write
+     * @details 要求写入后不到达块尾, 块切换统一由write处理
+     */
+    void writeFast(const void* buf, size_t size) {
+        if(m_cur && m_offset + size < m_cur->size) {
+            memcpy(m_cur->ptr + m_offset, buf, size);
+            m_offset += size;
+            m_position += size;
+            if(m_position > m_size) {
+                m_size = m_position;
+            }
+        } else {
+            write(buf, size);
+        }
+    }
+
+    /**
+     * @brief 数据完全落在当前内存块内时直接拷贝, 否则走通用的read
+     */
+    void readFast(void* buf, size_t size) {
+        if(m_position + size <= m_size && m_cur
+                && m_offset + size < m_cur->size) {
+            memcpy(buf, m_cur->ptr + m_offset, size);
+            m_offset += size;
+            m_position += size;
+        } else {
+            read(buf, size);
+        }
+    }
+
+    /**
+     * @brief 当前内存块内可连续写入的字节数
+     */
+    size_t nodeWritable() const { return m_cur ? m_cur->size - m_offset : 0;}
+
+    /**
+     * @brief 当前内存块内可连续读取的字节数
+     */
+    size_t nodeReadable() const {
+        size_t n = nodeWritable();
+        return n < getReadSize() ? n : getReadSize();
+    }
+
+    /**
+     * @brief 在当前内存块内前进size个字节, 要求size < nodeWritable()
+     */
+    void skipInNode(size_t size) {
+        m_offset += size;
+        m_position += size;
+        if(m_position > m_size) {
+            m_size = m_position;
+        }
+    }
 private:
     /// 内存块的大小
     size_t m_baseSize;
@@ -479,6 +585,8 @@ private:
     Node* m_root;
     /// 当前操作的内存块指针
     Node* m_cur;
+    /// 当前操作位置在m_cur中的偏移, 即m_position % m_baseSize
+    size_t m_offset;
 };
 
 }
@@ -0,0 +1,193 @@
+#include "db.h"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace sylar {
+
+void SQLColumnBatch::Column::reset() {
+    ints.clear();
+    doubles.clear();
+    offsets.clear();
+    arena.clear();
+    nulls.clear();
+    if(type == STRING) {
+        offsets.push_back(0);
+    }
+}
+
+void SQLColumnBatch::Column::pushNull() {
+    nulls.push_back(1);
+    switch(type) {
+        case INT64:
+            ints.push_back(0);
+            break;
+        case DOUBLE:
+            doubles.push_back(0);
+            break;
+        default:
+            offsets.push_back(arena.size());
+            break;
+    }
+}
+
+void SQLColumnBatch::Column::promote(Type t) {
+    if(t <= type) {
+        return;
+    }
+    if(t == DOUBLE) {
+        doubles.assign(ints.begin(), ints.end());
+    } else {
+        offsets.assign(1, 0);
+        arena.clear();
+        for(size_t i = 0; i < nulls.size(); ++i) {
+            if(!nulls[i]) {
+                if(type == INT64) {
+                    arena.append(std::to_string(ints[i]));
+                } else {
+                    char buf[32];
+                    arena.append(buf, snprintf(buf, sizeof(buf), "%.17g", doubles[i]));
+                }
+            }
+            offsets.push_back(arena.size());
+        }
+        doubles.clear();
+    }
+    ints.clear();
+    type = t;
+}
+
+SQLColumnBatch::SQLColumnBatch()
+    :m_rows(0)
+    ,m_source(0) {
+}
+
+int SQLColumnBatch::getColumnIndex(const std::string& name) const {
+    for(size_t i = 0; i < m_columns.size(); ++i) {
+        if(m_columns[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int64_t SQLColumnBatch::getInt64(size_t row, size_t col) const {
+    auto& c = m_columns[col];
+    switch(c.type) {
+        case INT64:
+            return c.ints[row];
+        case DOUBLE:
+            return c.doubles[row];
+        default:
+            return strtoll(getString(row, col).c_str(), nullptr, 10);
+    }
+}
+
+double SQLColumnBatch::getDouble(size_t row, size_t col) const {
+    auto& c = m_columns[col];
+    switch(c.type) {
+        case INT64:
+            return c.ints[row];
+        case DOUBLE:
+            return c.doubles[row];
+        default:
+            return strtod(getString(row, col).c_str(), nullptr);
+    }
+}
+
+const char* SQLColumnBatch::getData(size_t row, size_t col, size_t* len) const {
+    auto& c = m_columns[col];
+    if(c.type != STRING) {
+        if(len) {
+            *len = 0;
+        }
+        return nullptr;
+    }
+    if(len) {
+        *len = c.offsets[row + 1] - c.offsets[row];
+    }
+    return c.arena.data() + c.offsets[row];
+}
+
+std::string SQLColumnBatch::getString(size_t row, size_t col) const {
+    auto& c = m_columns[col];
+    switch(c.type) {
+        case INT64:
+            return std::to_string(c.ints[row]);
+        case DOUBLE:
+            return std::to_string(c.doubles[row]);
+        default:
+            return std::string(c.arena.data() + c.offsets[row]
+                    ,c.offsets[row + 1] - c.offsets[row]);
+    }
+}
+
+void SQLColumnBatch::clear() {
+    m_rows = 0;
+    m_columns.clear();
+    m_source = 0;
+}
+
+void SQLColumnBatch::reset() {
+    m_rows = 0;
+    for(auto& i : m_columns) {
+        i.reset();
+    }
+}
+
+SQLColumnBatch::Column& SQLColumnBatch::addColumn(const std::string& name, Type type) {
+    m_columns.resize(m_columns.size() + 1);
+    Column& c = m_columns.back();
+    c.name = name;
+    c.type = type;
+    c.reset();
+    return c;
+}
+
+static std::atomic<uint64_t> s_batch_id(0);
+
+ISQLData::ISQLData()
+    :m_batchId(++s_batch_id) {
+}
+
+size_t ISQLData::fetchBatch(SQLColumnBatch& batch, size_t max_rows) {
+    batch.reset();
+    size_t n = 0;
+    while(n < max_rows && next()) {
+        int cols = getColumnCount();
+        if(batch.getSource() != m_batchId) {
+            batch.clear();
+            batch.setSource(m_batchId);
+            for(int i = 0; i < cols; ++i) {
+                batch.addColumn(getColumnName(i), SQLColumnBatch::STRING);
+            }
+        }
+        for(int i = 0; i < cols; ++i) {
+            auto& c = batch.getColumn(i);
+            if(isNull(i)) {
+                c.pushNull();
+            } else {
+                std::string v = getString(i);
+                c.push(v.data(), v.size());
+            }
+        }
+        batch.endRow();
+        ++n;
+    }
+    return n;
+}
+
+size_t ISQLData::foreachBatch(size_t chunk_rows, batch_cb cb) {
+    SQLColumnBatch batch;
+    size_t total = 0;
+    while(true) {
+        size_t n = fetchBatch(batch, chunk_rows);
+        total += n;
+        if(n == 0 || !cb(batch) || n < chunk_rows) {
+            break;
+        }
+    }
+    return total;
+}
+
+}
@@ -3,12 +3,114 @@
 
 #include <memory>
 #include <string>
+#include <vector>
+#include <functional>
+#include <stdint.h>
 
 namespace sylar {
 
+/**
+ * @brief 按列存放的一批查询结果
+ * @details 每列一个类型化数组, 字符串列的内容连续追加到该列的arena中, 按偏移读取,
+ *          读取一批结果不需要为每个单元分配内存. 同一个对象重复用于多次fetchBatch时保留容量
+ */
+class SQLColumnBatch {
+public:
+    typedef std::shared_ptr<SQLColumnBatch> ptr;
+    /**
+     * @brief 列类型, 按INT64 < DOUBLE < STRING由窄到宽
+     */
+    enum Type {
+        /// 整数和时间(time_t)
+        INT64 = 1,
+        /// 浮点
+        DOUBLE = 2,
+        /// 字符串和二进制
+        STRING = 3
+    };
+
+    struct Column {
+        std::string name;
+        Type type = STRING;
+        std::vector<int64_t> ints;
+        std::vector<double> doubles;
+        /// STRING列第i行为arena[offsets[i], offsets[i + 1])
+        std::vector<size_t> offsets;
+        std::string arena;
+        std::vector<uint8_t> nulls;
+
+        void reset();
+        void pushNull();
+        /**
+         * @brief 提升为更宽的类型, 已有的值转换为新类型, t不比当前类型宽时不变
+         */
+        void promote(Type t);
+        void push(int64_t v) {
+            nulls.push_back(0);
+            ints.push_back(v);
+        }
+        void push(double v) {
+            nulls.push_back(0);
+            doubles.push_back(v);
+        }
+        void push(const char* v, size_t len) {
+            nulls.push_back(0);
+            arena.append(v, len);
+            offsets.push_back(arena.size());
+        }
+    };
+
+    SQLColumnBatch();
+
+    size_t getRows() const { return m_rows;}
+    size_t getColumnCount() const { return m_columns.size();}
+    const Column& getColumn(size_t col) const { return m_columns[col];}
+    /**
+     * @brief 列名对应的下标, 不存在返回-1
+     */
+    int getColumnIndex(const std::string& name) const;
+
+    bool isNull(size_t row, size_t col) const { return m_columns[col].nulls[row];}
+    /**
+     * @brief 读取整数, DOUBLE列截断, STRING列按十进制解析
+     */
+    int64_t getInt64(size_t row, size_t col) const;
+    double getDouble(size_t row, size_t col) const;
+    /**
+     * @brief STRING列的内容, 指针在下一次fetchBatch前有效, 其他类型的列返回nullptr
+     */
+    const char* getData(size_t row, size_t col, size_t* len) const;
+    std::string getString(size_t row, size_t col) const;
+
+    /**
+     * @brief 清空所有列
+     */
+    void clear();
+    /**
+     * @brief 清空数据, 保留列定义和容量
+     */
+    void reset();
+    Column& addColumn(const std::string& name, Type type);
+    Column& getColumn(size_t col) { return m_columns[col];}
+    void endRow() { ++m_rows;}
+
+    /**
+     * @brief 最近一次填充本对象的结果集id(ISQLData::getBatchId), 0表示没有
+     * @details 结果集据此判断是否需要重建列定义
+     */
+    uint64_t getSource() const { return m_source;}
+    void setSource(uint64_t v) { m_source = v;}
+private:
+    size_t m_rows;
+    std::vector<Column> m_columns;
+    uint64_t m_source;
+};
+
 class ISQLData {
 public:
     typedef std::shared_ptr<ISQLData> ptr;
+    typedef std::function<bool(const SQLColumnBatch& batch)> batch_cb;
+    ISQLData();
     virtual ~ISQLData() {}
 
     virtual int getErrno() const = 0;
@@ -35,6 +137,29 @@ public:
     virtual std::string getBlob(int idx) = 0;
     virtual time_t getTime(int idx) = 0;
     virtual bool next() = 0;
+
+    /**
+     * @brief 从当前位置往后读取最多max_rows行到batch
+     * @details batch上次由其他结果集填充时重建列定义. 默认实现逐个单元读取为STRING列,
+     *          具体实现直接按列类型写入
+     * @return 读取的行数, 小于max_rows表示结果已读完
+     */
+    virtual size_t fetchBatch(SQLColumnBatch& batch, size_t max_rows);
+
+    /**
+     * @brief 以每批chunk_rows行流式处理剩余结果, 内存中只保留一批
+     * @param[in] cb 返回false时停止
+     * @return 处理的总行数
+     */
+    size_t foreachBatch(size_t chunk_rows, batch_cb cb);
+
+    /**
+     * @brief 结果集的id, 进程内递增不重复
+     * @details 用于SQLColumnBatch判断列定义属于哪个结果集, 对象地址释放后会被复用, 不能代替
+     */
+    uint64_t getBatchId() const { return m_batchId;}
+private:
+    uint64_t m_batchId;
 };
 
 class ISQLUpdate {
@@ -100,6 +225,14 @@ public:
     virtual int getErrno() = 0;
     virtual std::string getErrStr() = 0;
     virtual ITransaction::ptr openTransaction(bool auto_commit = false) = 0;
+
+    /**
+     * @brief 一条多行INSERT分配的自增id的规律, 需在执行INSERT之前调用
+     * @param[out] step 相邻两行id的差
+     * @param[out] first getLastInsertId()返回第一行(true)还是最后一行(false)的id
+     * @return 同一条语句分配的id不保证连续时返回false
+     */
+    virtual bool getBatchInsertIdMode(int64_t& step, bool& first) { return false;}
 };
 
 }
@@ -5,6 +5,7 @@
 #include "sylar/macro.h"
 #include "sylar/config.h"
 #include <iomanip>
+#include <sys/eventfd.h>
 
 namespace sylar {
 
@@ -19,77 +20,93 @@ static std::map<uint64_t, std::string> s_thread_names;
 
 thread_local FoxThread* s_thread = nullptr;
 
+//一次唤醒最多执行的回调数, 超过后重新唤醒, 让出给事件循环中的其他事件
+static const uint64_t s_max_batch = 4096;
+
 void FoxThread::read_cb(evutil_socket_t sock, short which, void* args) {
     FoxThread* thread = static_cast<FoxThread*>(args);
-    uint8_t cmd[4096];
-    if(recv(sock, cmd, sizeof(cmd), 0) > 0) {
-        std::list<callback> callbacks;
-        RWMutex::WriteLock lock(thread->m_mutex);
-        callbacks.swap(thread->m_callbacks);
-        lock.unlock();
-        thread->m_working = true;
-        for(auto it = callbacks.begin();
-                it != callbacks.end(); ++it) {
-            if(*it) {
-                //SYLAR_ASSERT(thread == GetThis());
-                try {
-                    (*it)();
-                } catch (std::exception& ex) {
-                    SYLAR_LOG_ERROR(g_logger) << "exception:" << ex.what();
-                } catch (const char* c) {
-                    SYLAR_LOG_ERROR(g_logger) << "exception:" << c;
-                } catch (...) {
-                    SYLAR_LOG_ERROR(g_logger) << "uncatch exception";
-                }
-            } else {
-                event_base_loopbreak(thread->m_base);
-                thread->m_start = false;
-                thread->unsetThis();
+    uint64_t v = 0;
+    if(read(sock, &v, sizeof(v)) < 0 && errno != EAGAIN) {
+        SYLAR_LOG_ERROR(g_logger) << "FoxThread read eventfd errno=" << errno
+            << " errstr=" << strerror(errno);
+    }
+    //先清标记再取队列, 之后的投递会重新唤醒
+    thread->m_notified.store(false);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    thread->m_working = true;
+    uint64_t count = 0;
+    bool stop = false;
+    while(count < s_max_batch) {
+        CallbackNode* node = thread->m_queue.pop();
+        if(!node) {
+            if(thread->m_queue.empty()) {
                 break;
             }
+            //生产者入队到一半
+            std::this_thread::yield();
+            continue;
+        }
+        callback cb;
+        cb.swap(node->cb);
+        delete node;
+        if(!cb) {
+            event_base_loopbreak(thread->m_base);
+            thread->m_start = false;
+            thread->unsetThis();
+            stop = true;
+            break;
+        }
+        ++count;
+        //SYLAR_ASSERT(thread == GetThis());
+        try {
+            cb();
+        } catch (std::exception& ex) {
+            SYLAR_LOG_ERROR(g_logger) << "exception:" << ex.what();
+        } catch (const char* c) {
+            SYLAR_LOG_ERROR(g_logger) << "exception:" << c;
+        } catch (...) {
+            SYLAR_LOG_ERROR(g_logger) << "uncatch exception";
         }
-        sylar::Atomic::addFetch(thread->m_total, callbacks.size());
-        thread->m_working = false;
+    }
+    sylar::Atomic::addFetch(thread->m_total, count);
+    thread->m_working = false;
+    if(!stop && count == s_max_batch) {
+        thread->notify();
     }
 }
 
 FoxThread::FoxThread(const std::string& name, struct event_base* base)
-    :m_read(0)
-    ,m_write(0)
+    :m_eventfd(-1)
     ,m_base(NULL)
     ,m_event(NULL)
     ,m_thread(NULL)
+    ,m_notified(false)
     ,m_name(name)
     ,m_working(false)
     ,m_start(false)
-    ,m_total(0) {
-    int fds[2];
-    if(evutil_socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+    ,m_total(0)
+    ,m_dispatched(0) {
+    m_eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(m_eventfd == -1) {
         //SYLAR_LOG_ERROR(g_logger) << "FoxThread init error";
         throw std::logic_error("thread init error");
     }
 
-    evutil_make_socket_nonblocking(fds[0]);
-    evutil_make_socket_nonblocking(fds[1]);
-
-    m_read = fds[0];
-    m_write = fds[1];
-
     if(base) {
         m_base = base;
         setThis();
     } else {
         m_base = event_base_new();
     }
-    m_event = event_new(m_base, m_read, EV_READ | EV_PERSIST, read_cb, this);
+    m_event = event_new(m_base, m_eventfd, EV_READ | EV_PERSIST, read_cb, this);
     event_add(m_event, NULL);
 }
 
 void FoxThread::dump(std::ostream& os) {
-    RWMutex::ReadLock lock(m_mutex);
     os << "[thread name=" << m_name
        << " working=" << m_working
-       << " tasks=" << m_callbacks.size()
+       << " tasks=" << (m_dispatched - m_total)
        << " total=" << m_total
        << "]" << std::endl;
 }
@@ -113,23 +130,26 @@ void  FoxThread::setData(const std::string& name, void* v) {
 }
 
 FoxThread::~FoxThread() {
-    if(m_read) {
-        close(m_read);
-    }
-    if(m_write) {
-        close(m_write);
-    }
     stop();
     join();
     if(m_thread) {
         delete m_thread;
     }
+    while(!m_queue.empty()) {
+        CallbackNode* node = m_queue.pop();
+        if(node) {
+            delete node;
+        }
+    }
     if(m_event) {
         event_free(m_event);
     }
     if(m_base) {
         event_base_free(m_base);
     }
+    if(m_eventfd != -1) {
+        close(m_eventfd);
+    }
 }
 
 void FoxThread::start() {
@@ -153,36 +173,48 @@ void FoxThread::thread_cb() {
     event_base_loop(m_base, 0);
 }
 
-bool FoxThread::dispatch(callback cb) {
-    RWMutex::WriteLock lock(m_mutex);
-    m_callbacks.push_back(cb);
-    //if(m_callbacks.size() > 1) {
-    //    std::cout << std::this_thread::get_id() << ":" << m_callbacks.size() << " " << m_name << std::endl;
-    //}
-    lock.unlock();
-    uint8_t cmd = 1;
-    //write(m_write, &cmd, sizeof(cmd));
-    if(send(m_write, &cmd, sizeof(cmd), 0) <= 0) {
+bool FoxThread::notify() {
+    if(m_notified.exchange(true)) {
+        return true;
+    }
+    uint64_t v = 1;
+    if(write(m_eventfd, &v, sizeof(v)) != sizeof(v) && errno != EAGAIN) {
         return false;
     }
     return true;
 }
 
+bool FoxThread::dispatch(callback cb) {
+    CallbackNode* node = new CallbackNode;
+    node->cb.swap(cb);
+    sylar::Atomic::addFetch(m_dispatched, (uint64_t)1);
+    m_queue.push(node);
+    return notify();
+}
+
 bool FoxThread::dispatch(uint32_t id, callback cb) {
     return dispatch(cb);
 }
 
 bool FoxThread::batchDispatch(const std::vector<callback>& cbs) {
-    RWMutex::WriteLock lock(m_mutex);
-    for(auto& i : cbs) {
-        m_callbacks.push_back(i);
+    if(cbs.empty()) {
+        return true;
     }
-    lock.unlock();
-    uint8_t cmd = 1;
-    if(send(m_write, &cmd, sizeof(cmd), 0) <= 0) {
-        return false;
+    CallbackNode* first = nullptr;
+    CallbackNode* last = nullptr;
+    for(auto& i : cbs) {
+        CallbackNode* node = new CallbackNode;
+        node->cb = i;
+        if(last) {
+            last->next.store(node, std::memory_order_relaxed);
+        } else {
+            first = node;
+        }
+        last = node;
     }
-    return true;
+    sylar::Atomic::addFetch(m_dispatched, (uint64_t)cbs.size());
+    m_queue.pushChain(first, last);
+    return notify();
 }
 
 void FoxThread::broadcast(callback cb) {
@@ -190,12 +222,9 @@ void FoxThread::broadcast(callback cb) {
 }
 
 void FoxThread::stop() {
-    RWMutex::WriteLock lock(m_mutex);
-    m_callbacks.push_back(nullptr);
+    m_queue.push(new CallbackNode);
     if(m_thread) {
-        uint8_t cmd = 0;
-        //write(m_write, &cmd, sizeof(cmd));
-        send(m_write, &cmd, sizeof(cmd), 0);
+        notify();
     }
     //if(m_data) {
     //    delete m_data;
@@ -266,12 +295,13 @@ void FoxThreadPool::releaseFoxThread(FoxThread* t) {
 }
 
 bool FoxThreadPool::dispatch(callback cb) {
+    sylar::Atomic::addFetch(m_total, (uint64_t)1);
+    if(!m_advance) {
+        uint32_t idx = sylar::Atomic::fetchAdd(m_cur, (uint32_t)1);
+        return m_threads[idx % m_size]->dispatch(cb);
+    }
     do {
-        sylar::Atomic::addFetch(m_total, (uint64_t)1);
         RWMutex::WriteLock lock(m_mutex);
-        if(!m_advance) {
-            return m_threads[m_cur++ % m_size]->dispatch(cb);
-        }
         m_callbacks.push_back(cb);
     } while(0);
     check();
@@ -280,13 +310,20 @@ bool FoxThreadPool::dispatch(callback cb) {
 
 bool FoxThreadPool::batchDispatch(const std::vector<callback>& cbs) {
     sylar::Atomic::addFetch(m_total, cbs.size());
-    RWMutex::WriteLock lock(m_mutex);
     if(!m_advance) {
-        for(auto cb : cbs) {
-            m_threads[m_cur++ % m_size]->dispatch(cb);
+        //按轮询顺序分到各线程, 每个线程只入队唤醒一次
+        uint32_t idx = sylar::Atomic::fetchAdd(m_cur, (uint32_t)cbs.size());
+        std::vector<std::vector<callback> > parts(std::min((size_t)m_size, cbs.size()));
+        for(size_t i = 0; i < cbs.size(); ++i) {
+            parts[i % parts.size()].push_back(cbs[i]);
         }
-        return true;
+        bool rt = true;
+        for(size_t i = 0; i < parts.size(); ++i) {
+            rt = m_threads[(idx + i) % m_size]->batchDispatch(parts[i]) && rt;
+        }
+        return rt;
     }
+    RWMutex::WriteLock lock(m_mutex);
     for(auto cb : cbs) {
         m_callbacks.push_back(cb);
     }
@@ -333,7 +370,7 @@ bool FoxThreadPool::dispatch(uint32_t id, callback cb) {
 }
 
 FoxThread* FoxThreadPool::getRandFoxThread() {
-    return m_threads[m_cur++ % m_size];
+    return m_threads[sylar::Atomic::fetchAdd(m_cur, (uint32_t)1) % m_size];
 }
 
 void FoxThreadPool::broadcast(callback cb) {
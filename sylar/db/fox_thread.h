@@ -11,6 +11,7 @@
 
 #include "sylar/singleton.h"
 #include "sylar/mutex.h"
+#include "sylar/ds/mpsc_queue.h"
 
 namespace sylar {
 
@@ -33,6 +34,11 @@ public:
     virtual uint64_t getTotal() = 0;
 };
 
+/**
+ * @brief 运行libevent事件循环的线程
+ * @details 投递的回调进入无锁MPSC队列, 用eventfd唤醒线程. 线程被唤醒后到清空队列前,
+ *          其他投递不再写eventfd; batchDispatch整批只入队一次、唤醒一次
+ */
 class FoxThread : public IFoxThread {
 public:
     typedef std::shared_ptr<FoxThread> ptr;
@@ -74,16 +80,22 @@ public:
     void dump(std::ostream& os);
     virtual uint64_t getTotal() { return m_total;}
 private:
+    struct CallbackNode {
+        std::atomic<CallbackNode*> next;
+        callback cb;
+    };
+
     void thread_cb();
+    bool notify();
     static void read_cb(evutil_socket_t sock, short which, void* args);
 private:
-    evutil_socket_t m_read;
-    evutil_socket_t m_write;
+    evutil_socket_t m_eventfd;
     struct event_base* m_base;
     struct event* m_event;
     std::thread* m_thread;
-    sylar::RWMutex m_mutex;
-    std::list<callback> m_callbacks;
+    sylar::ds::MpscQueue<CallbackNode> m_queue;
+    /// 已写eventfd且线程还未开始处理
+    std::atomic<bool> m_notified;
 
     std::string m_name;
     init_cb m_initCb;
@@ -93,6 +105,7 @@ private:
     bool m_working;
     bool m_start;
     uint64_t m_total;
+    uint64_t m_dispatched;
 };
 
 class FoxThreadPool : public IFoxThread {
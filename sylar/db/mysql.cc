@@ -90,7 +90,8 @@ MySQL::MySQL(const std::map<std::string, std::string>& args)
     :m_params(args)
     ,m_lastUsedTime(0)
     ,m_hasError(false)
-    ,m_poolSize(10) {
+    ,m_poolSize(10)
+    ,m_insertIdStep(0) {
 }
 
 bool MySQL::connect() {
@@ -500,6 +501,11 @@ ISQLData::ptr MySQLStmt::query() {
     return MySQLStmtRes::Create(shared_from_this());
 }
 
+ISQLData::ptr MySQLStmt::queryCursor(uint32_t prefetch_rows) {
+    mysql_stmt_bind_param(m_stmt, &m_binds[0]);
+    return MySQLStmtRes::Create(shared_from_this(), std::max(1u, prefetch_rows));
+}
+
 MySQLRes::MySQLRes(MYSQL_RES* res, int eno, const char* estr)
     :m_errno(eno)
     ,m_errstr(estr)
@@ -610,7 +616,7 @@ bool MySQLRes::next() {
     return m_cur;
 }
 
-MySQLStmtRes::ptr MySQLStmtRes::Create(std::shared_ptr<MySQLStmt> stmt) {
+MySQLStmtRes::ptr MySQLStmtRes::Create(std::shared_ptr<MySQLStmt> stmt, uint32_t prefetch_rows) {
     int eno = mysql_stmt_errno(stmt->getRaw());
     const char* errstr = mysql_stmt_error(stmt->getRaw());
     MySQLStmtRes::ptr rt(new MySQLStmtRes(stmt, eno, errstr));
@@ -666,9 +672,19 @@ MySQLStmtRes::ptr MySQLStmtRes::Create(std::shared_ptr<MySQLStmt> stmt) {
                                     , stmt->getErrStr()));
     }
 
+    if(prefetch_rows) {
+        unsigned long type = CURSOR_TYPE_READ_ONLY;
+        unsigned long rows = prefetch_rows;
+        if(mysql_stmt_attr_set(stmt->getRaw(), STMT_ATTR_CURSOR_TYPE, &type)
+                || mysql_stmt_attr_set(stmt->getRaw(), STMT_ATTR_PREFETCH_ROWS, &rows)) {
+            return MySQLStmtRes::ptr(new MySQLStmtRes(stmt, stmt->getErrno()
+                                        , stmt->getErrStr()));
+        }
+    }
+
     stmt->execute();
 
-    if(mysql_stmt_store_result(stmt->getRaw())) {
+    if(!prefetch_rows && mysql_stmt_store_result(stmt->getRaw())) {
         return MySQLStmtRes::ptr(new MySQLStmtRes(stmt, stmt->getErrno()
                                     , stmt->getErrStr()));
     }
@@ -762,6 +778,94 @@ bool MySQLStmtRes::next() {
     return !mysql_stmt_fetch(m_stmt->getRaw());
 }
 
+size_t MySQLStmtRes::fetchBatch(SQLColumnBatch& batch, size_t max_rows) {
+    batch.reset();
+    if(m_errno) {
+        return 0;
+    }
+    if(batch.getSource() != getBatchId()) {
+        batch.clear();
+        batch.setSource(getBatchId());
+        MYSQL_RES* res = mysql_stmt_result_metadata(m_stmt->getRaw());
+        MYSQL_FIELD* fields = res ? mysql_fetch_fields(res) : nullptr;
+        for(size_t i = 0; i < m_datas.size(); ++i) {
+            SQLColumnBatch::Type type = SQLColumnBatch::STRING;
+            switch(m_datas[i].type) {
+                case MYSQL_TYPE_TINY:
+                case MYSQL_TYPE_SHORT:
+                case MYSQL_TYPE_LONG:
+                case MYSQL_TYPE_LONGLONG:
+                case MYSQL_TYPE_TIMESTAMP:
+                case MYSQL_TYPE_DATETIME:
+                case MYSQL_TYPE_DATE:
+                case MYSQL_TYPE_TIME:
+                    type = SQLColumnBatch::INT64;
+                    break;
+                case MYSQL_TYPE_FLOAT:
+                case MYSQL_TYPE_DOUBLE:
+                    type = SQLColumnBatch::DOUBLE;
+                    break;
+                default:
+                    break;
+            }
+            batch.addColumn(fields ? fields[i].name : "", type);
+        }
+        if(res) {
+            mysql_free_result(res);
+        }
+    }
+
+    size_t n = 0;
+    while(n < max_rows) {
+        int rt = mysql_stmt_fetch(m_stmt->getRaw());
+        if(rt != 0 && rt != MYSQL_DATA_TRUNCATED) {
+            break;
+        }
+        for(size_t i = 0; i < m_datas.size(); ++i) {
+            auto& d = m_datas[i];
+            auto& c = batch.getColumn(i);
+            if(d.is_null) {
+                c.pushNull();
+                continue;
+            }
+            switch(d.type) {
+#define XX(m, t) \
+                case m: \
+                    c.push((int64_t)*(t*)d.data); \
+                    break;
+                XX(MYSQL_TYPE_TINY, int8_t);
+                XX(MYSQL_TYPE_SHORT, int16_t);
+                XX(MYSQL_TYPE_LONG, int32_t);
+                XX(MYSQL_TYPE_LONGLONG, int64_t);
+#undef XX
+                case MYSQL_TYPE_FLOAT:
+                    c.push((double)*(float*)d.data);
+                    break;
+                case MYSQL_TYPE_DOUBLE:
+                    c.push(*(double*)d.data);
+                    break;
+                case MYSQL_TYPE_TIMESTAMP:
+                case MYSQL_TYPE_DATETIME:
+                case MYSQL_TYPE_DATE:
+                case MYSQL_TYPE_TIME:
+                    {
+                        time_t ts = 0;
+                        mysql_time_to_time_t(*(MYSQL_TIME*)d.data, ts);
+                        c.push((int64_t)ts);
+                    }
+                    break;
+                default:
+                    //截断时length为实际长度, 只有data_length字节可用
+                    c.push(d.data, std::min((unsigned long)d.data_length, d.length));
+                    break;
+            }
+        }
+        batch.endRow();
+        ++n;
+    }
+    return n;
+}
+
 MySQLStmtRes::Data::Data()
     :is_null(0)
     ,error(0)
@@ -875,6 +979,20 @@ int MySQL::getErrno() {
     return mysql_errno(m_mysql.get());
 }
 
+bool MySQL::getBatchInsertIdMode(int64_t& step, bool& first) {
+    if(m_insertIdStep == 0) {
+        auto rt = query("select @@innodb_autoinc_lock_mode, @@auto_increment_increment");
+        if(!rt || !rt->next()) {
+            return false;
+        }
+        //interleaved(2)模式下并发插入的id可能交错
+        m_insertIdStep = rt->getInt64(0) < 2 ? rt->getInt64(1) : -1;
+    }
+    step = m_insertIdStep;
+    first = true;
+    return m_insertIdStep > 0;
+}
+
 uint64_t MySQL::getInsertId() {
     if(m_mysql) {
         return mysql_insert_id(m_mysql.get());
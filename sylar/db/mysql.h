@@ -82,7 +82,12 @@ class MySQLStmtRes : public ISQLData {
 friend class MySQLStmt;
 public:
     typedef std::shared_ptr<MySQLStmtRes> ptr;
-    static MySQLStmtRes::ptr Create(std::shared_ptr<MySQLStmt> stmt);
+    /**
+     * @brief 执行语句并绑定结果
+     * @param[in] prefetch_rows 0时把结果全部读到客户端(mysql_stmt_store_result),
+     *            否则打开服务端只读游标, 每次从服务端取prefetch_rows行, getDataCount不可用
+     */
+    static MySQLStmtRes::ptr Create(std::shared_ptr<MySQLStmt> stmt, uint32_t prefetch_rows = 0);
     ~MySQLStmtRes();
 
     int getErrno() const { return m_errno;}
@@ -109,6 +114,10 @@ public:
     std::string getBlob(int idx) override;
     time_t getTime(int idx) override;
     bool next() override;
+    /**
+     * @brief 从绑定的结果缓冲区直接按字段类型写入各列, 时间字段转为time_t写入INT64列
+     */
+    size_t fetchBatch(SQLColumnBatch& batch, size_t max_rows) override;
 private:
     MySQLStmtRes(std::shared_ptr<MySQLStmt> stmt, int eno, const std::string& estr);
     struct Data {
@@ -159,6 +168,10 @@ public:
 
     ITransaction::ptr openTransaction(bool auto_commit) override;
     sylar::IStmt::ptr prepare(const std::string& sql) override;
+    /**
+     * @brief innodb_autoinc_lock_mode < 2时一条语句的id连续, 步长为auto_increment_increment
+     */
+    bool getBatchInsertIdMode(int64_t& step, bool& first) override;
 
     template<typename... Args>
     int execStmt(const char* stmt, Args&&... args);
@@ -184,6 +197,8 @@ private:
     uint64_t m_lastUsedTime;
     bool m_hasError;
     int32_t m_poolSize;
+    /// 多行INSERT的id步长, 0未查询, -1不连续
+    int64_t m_insertIdStep;
 };
 
 class MySQLTransaction : public ITransaction {
@@ -263,6 +278,10 @@ public:
     int execute() override;
     int64_t getLastInsertId() override;
     ISQLData::ptr query() override;
+    /**
+     * @brief 使用服务端游标查询, 每次取prefetch_rows行, 适合配合foreachBatch处理大结果集
+     */
+    ISQLData::ptr queryCursor(uint32_t prefetch_rows = 1024);
 
     MYSQL_STMT* getRaw() const { return m_stmt;}
 private:
@@ -0,0 +1,312 @@
+#include "redis_client.h"
+#include "sylar/config.h"
+#include "sylar/log.h"
+#include "sylar/util.h"
+
+namespace sylar {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<uint32_t>::ptr g_redis_client_recv_buffer_size
+    = sylar::Config::Lookup("redis.client.recv_buffer_size"
+            ,(uint32_t) 16 * 1024, "redis client read size per recv");
+
+static std::string get_value(const std::map<std::string, std::string>& m
+                             ,const std::string& key
+                             ,const std::string& def = "") {
+    auto it = m.find(key);
+    return it == m.end() ? def : it->second;
+}
+
+std::string RedisResult::toString() const {
+    std::stringstream ss;
+    ss << "[RedisResult result=" << result
+       << " used=" << used
+       << " reply=" << (reply ? reply->toString() : "null")
+       << "]";
+    return ss.str();
+}
+
+RedisStream::RedisStream(Socket::ptr sock)
+    :AsyncSocketStream(sock, true)
+    ,m_db(0)
+    ,m_resp3(false)
+    ,m_cmds(0)
+    ,m_flushes(0) {
+    m_autoConnect = true;
+    SYLAR_LOG_DEBUG(g_logger) << "RedisStream::RedisStream " << this;
+}
+
+RedisStream::~RedisStream() {
+    SYLAR_LOG_DEBUG(g_logger) << "RedisStream::~RedisStream " << this;
+}
+
+bool RedisStream::connect(sylar::Address::ptr addr) {
+    m_socket = sylar::Socket::CreateTCP(addr);
+    return m_socket->connect(addr);
+}
+
+RedisStream::RedisCtx::ptr RedisStream::createCtx(const std::vector<std::string>& argv) {
+    RedisCtx::ptr ctx(new RedisCtx);
+    ctx->sn = sylar::Atomic::addFetch(m_sn, 1);
+    RespEncodeCommand(ctx->request, argv);
+    return ctx;
+}
+
+RedisResult::ptr RedisStream::cmd(const std::vector<std::string>& argv, uint32_t timeout_ms) {
+    if(!isConnected()) {
+        return std::make_shared<RedisResult>(AsyncSocketStream::NOT_CONNECT, 0, nullptr);
+    }
+    RedisCtx::ptr ctx = createCtx(argv);
+    ctx->timeout = timeout_ms;
+    ctx->scheduler = sylar::Scheduler::GetThis();
+    ctx->fiber = sylar::Fiber::GetThis();
+    addCtx(ctx);
+    uint64_t ts = sylar::GetCurrentMS();
+    ctx->timer = sylar::IOManager::GetThis()->addTimer(timeout_ms,
+            std::bind(&RedisStream::onTimeOut, shared_from_this(), ctx));
+    enqueue(ctx);
+    sylar::Fiber::YieldToHold();
+    return std::make_shared<RedisResult>(ctx->result, sylar::GetCurrentMS() - ts, ctx->reply);
+}
+
+bool RedisStream::RedisCtx::doSend(AsyncSocketStream::ptr stream) {
+    //已超时的命令不再发送
+    if(timed) {
+        return true;
+    }
+    auto rs = std::static_pointer_cast<RedisStream>(stream);
+    rs->m_sendBuffer.append(request);
+    ++rs->m_cmds;
+    RedisStream::MutexType::Lock lock(rs->m_pendingMutex);
+    rs->m_pending.push_back(sn);
+    return true;
+}
+
+bool RedisStream::doFlush() {
+    if(m_sendBuffer.empty()) {
+        return true;
+    }
+    ++m_flushes;
+    bool rt = writeFixSize(m_sendBuffer, m_sendBuffer.size()) > 0;
+    m_sendBuffer.clear();
+    return rt;
+}
+
+void RedisStream::startRead() {
+    //上一个连接的读写协程都已退出
+    m_parser.reset();
+    m_recvBuffer.clear();
+    m_sendBuffer.clear();
+    {
+        MutexType::Lock lock(m_pendingMutex);
+        m_pending.clear();
+    }
+
+    std::vector<std::vector<std::string> > cmds;
+    if(m_resp3) {
+        std::vector<std::string> hello = {"HELLO", "3"};
+        if(!m_passwd.empty()) {
+            hello.insert(hello.end(), {"AUTH", "default", m_passwd});
+        }
+        cmds.push_back(hello);
+    } else if(!m_passwd.empty()) {
+        cmds.push_back({"AUTH", m_passwd});
+    }
+    if(m_db) {
+        cmds.push_back({"SELECT", std::to_string(m_db)});
+    }
+    if(!cmds.empty()) {
+        //排在重连期间已入队的命令之前
+        RWMutexType::WriteLock lock(m_queueMutex);
+        bool empty = m_queue.empty();
+        for(auto it = cmds.rbegin(); it != cmds.rend(); ++it) {
+            auto ctx = createCtx(*it);
+            ctx->handshake = true;
+            addCtx(ctx);
+            m_queue.push_front(ctx);
+        }
+        lock.unlock();
+        if(empty) {
+            m_sem.notify();
+        }
+    }
+    AsyncSocketStream::startRead();
+}
+
+AsyncSocketStream::Ctx::ptr RedisStream::doRecv() {
+    RespReply::ptr reply;
+    while(true) {
+        int rt = m_parser.parse(m_recvBuffer, reply);
+        if(rt > 0) {
+            break;
+        }
+        if(rt < 0) {
+            SYLAR_LOG_ERROR(g_logger) << "RedisStream parse error: " << m_parser.getError()
+                << " " << (m_socket ? m_socket->toString() : "");
+            innerClose();
+            return nullptr;
+        }
+        if(read(m_recvBuffer, g_redis_client_recv_buffer_size->getValue()) <= 0) {
+            innerClose();
+            return nullptr;
+        }
+    }
+
+    if(reply->getType() == RespReply::PUSH) {
+        handlePush(reply);
+        return nullptr;
+    }
+
+    uint32_t sn = 0;
+    {
+        MutexType::Lock lock(m_pendingMutex);
+        if(m_pending.empty()) {
+            lock.unlock();
+            SYLAR_LOG_ERROR(g_logger) << "RedisStream unexpected reply: " << reply->toString();
+            innerClose();
+            return nullptr;
+        }
+        sn = m_pending.front();
+        m_pending.pop_front();
+    }
+    RedisCtx::ptr ctx = getAndDelCtxAs<RedisCtx>(sn);
+    if(!ctx) {
+        SYLAR_LOG_DEBUG(g_logger) << "RedisStream cmd timeout reply=" << reply->toString();
+        return nullptr;
+    }
+    ctx->reply = reply;
+    if(ctx->handshake) {
+        if(reply->isError()) {
+            SYLAR_LOG_ERROR(g_logger) << "RedisStream handshake error: " << reply->toString()
+                << " " << (m_socket ? m_socket->toString() : "");
+            innerClose();
+        }
+        return nullptr;
+    }
+    return ctx;
+}
+
+void RedisStream::handlePush(RespReply::ptr reply) {
+    if(m_pushHandler) {
+        m_worker->schedule(std::bind(m_pushHandler, reply,
+                    std::static_pointer_cast<RedisStream>(shared_from_this())));
+    } else {
+        SYLAR_LOG_DEBUG(g_logger) << "RedisStream unhandle push " << reply->toString();
+    }
+}
+
+RedisClient::RedisClient(const std::map<std::string, std::string>& conf) {
+    m_host = get_value(conf, "host");
+    m_passwd = get_value(conf, "passwd");
+    m_db = sylar::TypeUtil::Atoi(get_value(conf, "db", "0"));
+    m_resp3 = get_value(conf, "resp", "2") == "3";
+    m_pool = std::max(1, (int)sylar::TypeUtil::Atoi(get_value(conf, "pool", "1")));
+    auto tmp = get_value(conf, "timeout_com");
+    if(tmp.empty()) {
+        tmp = get_value(conf, "timeout", "1000");
+    }
+    m_timeout = sylar::TypeUtil::Atoi(tmp);
+}
+
+bool RedisClient::init() {
+    auto iom = sylar::IOManager::GetThis();
+    auto addr = sylar::Address::LookupAnyIPAddress(m_host);
+    if(!iom || !addr) {
+        SYLAR_LOG_ERROR(g_logger) << "RedisClient init fail name=" << m_name
+            << " host=" << m_host;
+        return false;
+    }
+    for(uint32_t i = 0; i < m_pool; ++i) {
+        RedisStream::ptr conn(new RedisStream(nullptr));
+        conn->setPasswd(m_passwd);
+        conn->setDb(m_db);
+        conn->setResp3(m_resp3);
+        m_conns.push_back(conn);
+        m_streams.add(conn);
+        iom->schedule([conn, addr](){
+            conn->connect(addr);
+            conn->start();
+        });
+    }
+    return true;
+}
+
+void RedisClient::close() {
+    m_streams.clear();
+}
+
+RedisResult::ptr RedisClient::cmd(const std::vector<std::string>& argv) {
+    return cmd(argv, m_timeout);
+}
+
+RedisResult::ptr RedisClient::cmd(const std::vector<std::string>& argv, uint32_t timeout_ms) {
+    auto conn = m_streams.getAs<RedisStream>();
+    if(!conn) {
+        return std::make_shared<RedisResult>(AsyncSocketStream::NOT_CONNECT, 0, nullptr);
+    }
+    return conn->cmd(argv, timeout_ms);
+}
+
+std::string RedisClient::toString() {
+    uint64_t cmds = 0;
+    uint64_t flushes = 0;
+    uint32_t connected = 0;
+    for(auto& i : m_conns) {
+        cmds += i->getCmdCount();
+        flushes += i->getFlushCount();
+        connected += i->isConnected();
+    }
+    std::stringstream ss;
+    ss << "[RedisClient name=" << m_name
+       << " host=" << m_host
+       << " db=" << m_db
+       << " resp=" << (m_resp3 ? 3 : 2)
+       << " pool=" << m_pool
+       << " connected=" << connected
+       << " cmds=" << cmds
+       << " flushes=" << flushes
+       << "]";
+    return ss.str();
+}
+
+RedisClient::ptr RedisClientManager::get(const std::string& name) {
+    {
+        sylar::RWMutex::ReadLock lock(m_mutex);
+        auto it = m_datas.find(name);
+        if(it != m_datas.end()) {
+            return it->second;
+        }
+    }
+    auto config = sylar::Config::Lookup("redis.config"
+            ,std::map<std::string, std::map<std::string, std::string> >(), "redis config");
+    auto conf = config->getValue();
+    auto it = conf.find(name);
+    if(it == conf.end() || get_value(it->second, "type") != "resp") {
+        return nullptr;
+    }
+
+    sylar::RWMutex::WriteLock lock(m_mutex);
+    auto& client = m_datas[name];
+    if(!client) {
+        RedisClient::ptr c(new RedisClient(it->second));
+        c->setName(name);
+        if(!c->init()) {
+            m_datas.erase(name);
+            return nullptr;
+        }
+        client = c;
+    }
+    return client;
+}
+
+std::ostream& RedisClientManager::dump(std::ostream& os) {
+    sylar::RWMutex::ReadLock lock(m_mutex);
+    os << "[RedisClientManager total=" << m_datas.size() << "]" << std::endl;
+    for(auto& i : m_datas) {
+        os << "    " << i.second->toString() << std::endl;
+    }
+    return os;
+}
+
+}
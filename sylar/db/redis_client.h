@@ -0,0 +1,172 @@
+/**
+ * @file redis_client.h
+ * @brief 基于协程的Redis客户端, 直接使用sylar Socket, 不依赖hiredis
+ */
+#ifndef __SYLAR_DB_REDIS_CLIENT_H__
+#define __SYLAR_DB_REDIS_CLIENT_H__
+
+#include "sylar/streams/async_socket_stream.h"
+#include "sylar/singleton.h"
+#include "resp.h"
+#include <deque>
+#include <map>
+
+namespace sylar {
+
+struct RedisResult {
+    typedef std::shared_ptr<RedisResult> ptr;
+    RedisResult(int32_t _result, int32_t _used, RespReply::ptr _reply)
+        :result(_result)
+        ,used(_used)
+        ,reply(_reply) {
+    }
+    /// AsyncSocketStream::Error, 服务端返回的错误在reply中
+    int32_t result;
+    /// 耗时(毫秒)
+    int32_t used;
+    RespReply::ptr reply;
+
+    std::string toString() const;
+};
+
+/**
+ * @brief 一个Redis连接, 多个协程可以并发调用cmd
+ * @details 命令进入发送队列后由写协程一次取出全部, 编码到同一个BufferChain后一次写出,
+ *          同一调度周期内发起的命令自然合并为pipeline. 回复按发送顺序匹配,
+ *          超时的命令的回复到达后丢弃. 读协程用recvmsg读入分片缓存,
+ *          回复中的字符串是缓存的零拷贝切片.
+ *          连接建立时按配置先发送HELLO 3(RESP3)/AUTH/SELECT, 失败时断开.
+ *          RESP3的推送消息(>)交给push_handler, RESP2下订阅消息无法与回复区分, 不支持
+ */
+class RedisStream : public AsyncSocketStream {
+public:
+    typedef std::shared_ptr<RedisStream> ptr;
+    typedef sylar::Mutex MutexType;
+    typedef std::function<void(RespReply::ptr, RedisStream::ptr)> push_handler;
+
+    RedisStream(Socket::ptr sock);
+    ~RedisStream();
+
+    /**
+     * @brief 发送命令并等待回复
+     */
+    RedisResult::ptr cmd(const std::vector<std::string>& argv, uint32_t timeout_ms);
+
+    /**
+     * @brief 连接服务端, 之后调用start, 断开后自动重连
+     */
+    bool connect(sylar::Address::ptr addr);
+
+    const std::string& getPasswd() const { return m_passwd;}
+    void setPasswd(const std::string& v) { m_passwd = v;}
+
+    int getDb() const { return m_db;}
+    void setDb(int v) { m_db = v;}
+
+    bool isResp3() const { return m_resp3;}
+    void setResp3(bool v) { m_resp3 = v;}
+
+    push_handler getPushHandler() const { return m_pushHandler;}
+    void setPushHandler(push_handler v) { m_pushHandler = v;}
+
+    /**
+     * @brief 已发送的命令数
+     */
+    uint64_t getCmdCount() const { return m_cmds;}
+    /**
+     * @brief 写出的批次数, 与getCmdCount的比值即平均pipeline深度
+     */
+    uint64_t getFlushCount() const { return m_flushes;}
+protected:
+    struct RedisCtx : public Ctx {
+        typedef std::shared_ptr<RedisCtx> ptr;
+        /// 编码后的命令
+        BufferChain request;
+        RespReply::ptr reply;
+        /// 连接建立时自动发送的命令, 没有等待的协程, 失败时断开
+        bool handshake = false;
+
+        virtual bool doSend(AsyncSocketStream::ptr stream) override;
+    };
+
+    virtual Ctx::ptr doRecv() override;
+    virtual bool doFlush() override;
+    virtual void startRead() override;
+private:
+    RedisCtx::ptr createCtx(const std::vector<std::string>& argv);
+    void handlePush(RespReply::ptr reply);
+private:
+    std::string m_passwd;
+    int m_db;
+    bool m_resp3;
+    RespParser m_parser;
+    /// 接收缓存
+    BufferChain m_recvBuffer;
+    /// 本批待写出的命令
+    BufferChain m_sendBuffer;
+    MutexType m_pendingMutex;
+    /// 已写出等待回复的sn
+    std::deque<uint32_t> m_pending;
+    push_handler m_pushHandler;
+    uint64_t m_cmds;
+    uint64_t m_flushes;
+};
+
+/**
+ * @brief Redis客户端, 命令轮询分配到多个RedisStream
+ */
+class RedisClient {
+public:
+    typedef std::shared_ptr<RedisClient> ptr;
+
+    /**
+     * @brief 构造
+     * @param[in] conf host(ip:port) passwd db resp(2或3) pool(连接数) timeout(毫秒)
+     */
+    RedisClient(const std::map<std::string, std::string>& conf);
+
+    /**
+     * @brief 在当前IOManager中建立连接
+     */
+    bool init();
+    /**
+     * @brief 关闭所有连接, 不再自动重连
+     */
+    void close();
+
+    RedisResult::ptr cmd(const std::vector<std::string>& argv);
+    RedisResult::ptr cmd(const std::vector<std::string>& argv, uint32_t timeout_ms);
+
+    const std::string& getName() const { return m_name;}
+    void setName(const std::string& v) { m_name = v;}
+
+    std::string toString();
+private:
+    std::string m_name;
+    std::string m_host;
+    std::string m_passwd;
+    int m_db;
+    bool m_resp3;
+    uint32_t m_pool;
+    uint32_t m_timeout;
+    std::vector<RedisStream::ptr> m_conns;
+    AsyncSocketStreamManager m_streams;
+};
+
+/**
+ * @brief 按名称获取RedisClient, 配置为redis.config中type为resp的项
+ */
+class RedisClientManager {
+public:
+    RedisClient::ptr get(const std::string& name);
+    std::ostream& dump(std::ostream& os);
+private:
+    sylar::RWMutex m_mutex;
+    std::map<std::string, RedisClient::ptr> m_datas;
+};
+
+typedef sylar::Singleton<RedisClientManager> RedisClientMgr;
+
+}
+
+#endif
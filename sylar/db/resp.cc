@@ -0,0 +1,471 @@
+#include "resp.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+
+namespace sylar {
+
+/// 单行(类型+长度/内容)最大长度
+static const size_t s_max_line = 64 * 1024;
+/// 单个字符串最大长度, 与redis的proto-max-bulk-len默认值一致
+static const int64_t s_max_bulk = 512ll * 1024 * 1024;
+/// 最大嵌套深度
+static const size_t s_max_depth = 64;
+
+RespReply::RespReply(Type type)
+    :m_type(type)
+    ,m_integer(0)
+    ,m_double(0) {
+}
+
+bool RespReply::isAggregate() const {
+    switch(m_type) {
+        case ARRAY:
+        case MAP:
+        case SET:
+        case ATTR:
+        case PUSH:
+            return true;
+        default:
+            return false;
+    }
+}
+
+RespReply::ptr RespReply::String(const std::string& v) {
+    RespReply::ptr rt(new RespReply(STRING));
+    rt->m_data.append(v);
+    return rt;
+}
+
+RespReply::ptr RespReply::Status(const std::string& v) {
+    RespReply::ptr rt(new RespReply(STATUS));
+    rt->m_data.append(v);
+    return rt;
+}
+
+RespReply::ptr RespReply::Error(const std::string& v) {
+    RespReply::ptr rt(new RespReply(ERROR));
+    rt->m_data.append(v);
+    return rt;
+}
+
+RespReply::ptr RespReply::Integer(int64_t v) {
+    RespReply::ptr rt(new RespReply(INTEGER));
+    rt->m_integer = v;
+    return rt;
+}
+
+RespReply::ptr RespReply::Double(double v) {
+    RespReply::ptr rt(new RespReply(DOUBLE));
+    rt->m_double = v;
+    return rt;
+}
+
+RespReply::ptr RespReply::Bool(bool v) {
+    RespReply::ptr rt(new RespReply(BOOL));
+    rt->m_integer = v;
+    return rt;
+}
+
+RespReply::ptr RespReply::Nil() {
+    return std::make_shared<RespReply>(NIL);
+}
+
+RespReply::ptr RespReply::Aggregate(Type type, const std::vector<RespReply::ptr>& elements) {
+    RespReply::ptr rt(new RespReply(type));
+    rt->m_elements = elements;
+    return rt;
+}
+
+static std::string DoubleToString(double v) {
+    if(isnan(v)) {
+        return "nan";
+    } else if(isinf(v)) {
+        return v > 0 ? "inf" : "-inf";
+    }
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.17g", v);
+    return buf;
+}
+
+static void AppendLine(BufferChain& out, char type, int64_t v) {
+    char buf[32];
+    int len = snprintf(buf, sizeof(buf), "%c%lld\r\n", type, (long long)v);
+    out.append(buf, len);
+}
+
+static void AppendLine(BufferChain& out, char type, const BufferChain& data) {
+    out.append(&type, 1);
+    out.append(data);
+    out.append("\r\n", 2);
+}
+
+static void AppendBulk(BufferChain& out, const BufferChain& data) {
+    AppendLine(out, '$', data.size());
+    out.append(data);
+    out.append("\r\n", 2);
+}
+
+static void AppendBulk(BufferChain& out, const std::string& data) {
+    AppendLine(out, '$', data.size());
+    out.append(data);
+    out.append("\r\n", 2);
+}
+
+void RespReply::encodeTo(BufferChain& out, bool resp3) const {
+    switch(m_type) {
+        case STRING:
+            AppendBulk(out, m_data);
+            break;
+        case STATUS:
+            AppendLine(out, '+', m_data);
+            break;
+        case ERROR:
+            AppendLine(out, '-', m_data);
+            break;
+        case INTEGER:
+            AppendLine(out, ':', m_integer);
+            break;
+        case NIL:
+            if(resp3) {
+                out.append("_\r\n", 3);
+            } else {
+                out.append("$-1\r\n", 5);
+            }
+            break;
+        case DOUBLE:
+            if(resp3) {
+                out.append(",", 1);
+                out.append(DoubleToString(m_double));
+                out.append("\r\n", 2);
+            } else {
+                AppendBulk(out, DoubleToString(m_double));
+            }
+            break;
+        case BOOL:
+            if(resp3) {
+                out.append(m_integer ? "#t\r\n" : "#f\r\n", 4);
+            } else {
+                AppendLine(out, ':', m_integer ? 1 : 0);
+            }
+            break;
+        case BIGNUM:
+            if(resp3) {
+                AppendLine(out, '(', m_data);
+            } else {
+                AppendBulk(out, m_data);
+            }
+            break;
+        case VERB:
+            if(resp3) {
+                AppendLine(out, '=', m_data.size() + 4);
+                out.append("txt:", 4);
+                out.append(m_data);
+                out.append("\r\n", 2);
+            } else {
+                AppendBulk(out, m_data);
+            }
+            break;
+        default:
+            if(m_type == ATTR && !resp3) {
+                break;
+            }
+            {
+                char type = '*';
+                size_t count = m_elements.size();
+                if(resp3) {
+                    switch(m_type) {
+                        case MAP:
+                            type = '%';
+                            count /= 2;
+                            break;
+                        case ATTR:
+                            type = '|';
+                            count /= 2;
+                            break;
+                        case SET:
+                            type = '~';
+                            break;
+                        case PUSH:
+                            type = '>';
+                            break;
+                        default:
+                            break;
+                    }
+                }
+                AppendLine(out, type, count);
+                for(auto& i : m_elements) {
+                    i->encodeTo(out, resp3);
+                }
+            }
+            break;
+    }
+}
+
+void RespReply::dump(std::ostream& os) const {
+    switch(m_type) {
+        case STRING:
+        case VERB:
+            os << '"' << m_data.toString() << '"';
+            break;
+        case STATUS:
+        case BIGNUM:
+            os << m_data.toString();
+            break;
+        case ERROR:
+            os << "(error) " << m_data.toString();
+            break;
+        case INTEGER:
+            os << m_integer;
+            break;
+        case NIL:
+            os << "(nil)";
+            break;
+        case DOUBLE:
+            os << DoubleToString(m_double);
+            break;
+        case BOOL:
+            os << (m_integer ? "true" : "false");
+            break;
+        default:
+            os << (m_type == MAP || m_type == ATTR ? "{" : "[");
+            for(size_t i = 0; i < m_elements.size(); ++i) {
+                if(i) {
+                    os << ((m_type == MAP || m_type == ATTR) && (i % 2) ? ": " : ", ");
+                }
+                m_elements[i]->dump(os);
+            }
+            os << (m_type == MAP || m_type == ATTR ? "}" : "]");
+            break;
+    }
+}
+
+std::string RespReply::toString() const {
+    std::stringstream ss;
+    dump(ss);
+    return ss.str();
+}
+
+/**
+ * @brief 查找buf中第一个'\n'的位置, 最多查找max个字节
+ * @return 未找到返回-1
+ */
+static int64_t FindNewline(const BufferChain& buf, size_t max) {
+    size_t offset = 0;
+    for(auto& i : buf.getSlices()) {
+        size_t len = std::min((size_t)i.length(), max - offset);
+        const char* p = (const char*)memchr(i.data(), '\n', len);
+        if(p) {
+            return offset + (p - i.data());
+        }
+        offset += len;
+        if(offset >= max) {
+            break;
+        }
+    }
+    return -1;
+}
+
+static bool ParseInt(const char* p, size_t n, int64_t& v) {
+    if(n == 0 || n > 20) {
+        return false;
+    }
+    bool neg = false;
+    size_t i = 0;
+    if(p[0] == '-' || p[0] == '+') {
+        neg = p[0] == '-';
+        if(++i == n) {
+            return false;
+        }
+    }
+    uint64_t rt = 0;
+    for(; i < n; ++i) {
+        if(p[i] < '0' || p[i] > '9') {
+            return false;
+        }
+        rt = rt * 10 + (p[i] - '0');
+    }
+    v = neg ? -(int64_t)rt : (int64_t)rt;
+    return true;
+}
+
+void RespParser::reset() {
+    m_stack.clear();
+    m_error.clear();
+}
+
+#define RESP_ERROR(msg) \
+    m_error = msg; \
+    return -1;
+
+int RespParser::parseOne(BufferChain& buf, RespReply::ptr& reply, int64_t& count) {
+    count = -1;
+    int64_t pos = FindNewline(buf, s_max_line);
+    if(pos < 0) {
+        if(buf.size() >= s_max_line) {
+            RESP_ERROR("line too long");
+        }
+        return 0;
+    }
+    if(pos < 2) {
+        RESP_ERROR("empty line");
+    }
+    const char* line = buf.linearize(pos + 1);
+    if(line[pos - 1] != '\r') {
+        RESP_ERROR("line not end with crlf");
+    }
+    char type = line[0];
+    const char* p = line + 1;
+    size_t n = pos - 2;
+    int64_t v = 0;
+    switch(type) {
+        case '+':
+        case '-':
+        case '(':
+            reply.reset(new RespReply(type == '+' ? RespReply::STATUS
+                        : type == '-' ? RespReply::ERROR : RespReply::BIGNUM));
+            reply->m_data.append(p, n);
+            break;
+        case ':':
+            if(!ParseInt(p, n, v)) {
+                RESP_ERROR("invalid integer");
+            }
+            reply.reset(new RespReply(RespReply::INTEGER));
+            reply->m_integer = v;
+            break;
+        case '_':
+            if(n) {
+                RESP_ERROR("invalid null");
+            }
+            reply.reset(new RespReply(RespReply::NIL));
+            break;
+        case ',':
+            {
+                std::string tmp(p, n);
+                char* end = nullptr;
+                double d = strtod(tmp.c_str(), &end);
+                if(tmp.empty() || *end) {
+                    RESP_ERROR("invalid double");
+                }
+                reply.reset(new RespReply(RespReply::DOUBLE));
+                reply->m_double = d;
+            }
+            break;
+        case '#':
+            if(n != 1 || (p[0] != 't' && p[0] != 'f')) {
+                RESP_ERROR("invalid boolean");
+            }
+            reply.reset(new RespReply(RespReply::BOOL));
+            reply->m_integer = p[0] == 't';
+            break;
+        case '$':
+        case '!':
+        case '=':
+            if(!ParseInt(p, n, v) || v < -1 || (v == -1 && type != '$')) {
+                RESP_ERROR("invalid bulk length");
+            }
+            if(v > s_max_bulk) {
+                RESP_ERROR("bulk too large");
+            }
+            if(v == -1) {
+                reply.reset(new RespReply(RespReply::NIL));
+                break;
+            }
+            if(buf.size() < (size_t)(pos + 1 + v + 2)) {
+                return 0;
+            }
+            buf.consume(pos + 1);
+            reply.reset(new RespReply(type == '$' ? RespReply::STRING
+                        : type == '!' ? RespReply::ERROR : RespReply::VERB));
+            reply->m_data = buf.cut(v);
+            {
+                char crlf[2];
+                buf.read(crlf, 2);
+                if(crlf[0] != '\r' || crlf[1] != '\n') {
+                    RESP_ERROR("bulk not end with crlf");
+                }
+            }
+            if(type == '=') {
+                if(v < 4) {
+                    RESP_ERROR("invalid verbatim string");
+                }
+                reply->m_data.consume(4);
+            }
+            return 1;
+        case '*':
+        case '%':
+        case '~':
+        case '>':
+        case '|':
+            if(!ParseInt(p, n, v) || v < -1 || (v == -1 && type != '*')) {
+                RESP_ERROR("invalid aggregate length");
+            }
+            if(v == -1) {
+                reply.reset(new RespReply(RespReply::NIL));
+                break;
+            }
+            reply.reset(new RespReply(type == '*' ? RespReply::ARRAY
+                        : type == '%' ? RespReply::MAP
+                        : type == '~' ? RespReply::SET
+                        : type == '>' ? RespReply::PUSH : RespReply::ATTR));
+            count = (type == '%' || type == '|') ? v * 2 : v;
+            reply->m_elements.reserve(std::min(count, (int64_t)1024));
+            break;
+        default:
+            RESP_ERROR(std::string("unknown type ") + type);
+    }
+    buf.consume(pos + 1);
+    return 1;
+}
+
+#undef RESP_ERROR
+
+int RespParser::parse(BufferChain& buf, RespReply::ptr& reply) {
+    while(true) {
+        RespReply::ptr r;
+        int64_t count = -1;
+        int rt = parseOne(buf, r, count);
+        if(rt <= 0) {
+            return rt;
+        }
+        if(count > 0) {
+            if(m_stack.size() >= s_max_depth) {
+                m_error = "nesting too deep";
+                return -1;
+            }
+            m_stack.push_back(Frame{r, count});
+            continue;
+        }
+        //完成的元素逐层归入父聚合, 属性不计入父聚合的元素数
+        while(true) {
+            if(m_stack.empty()) {
+                if(r->m_type == RespReply::ATTR) {
+                    break;
+                }
+                reply = r;
+                return 1;
+            }
+            auto& top = m_stack.back();
+            if(r->m_type != RespReply::ATTR) {
+                top.reply->m_elements.push_back(r);
+                --top.remain;
+            }
+            if(top.remain > 0) {
+                break;
+            }
+            r = top.reply;
+            m_stack.pop_back();
+        }
+    }
+}
+
+void RespEncodeCommand(BufferChain& out, const std::vector<std::string>& argv) {
+    AppendLine(out, '*', argv.size());
+    for(auto& i : argv) {
+        AppendBulk(out, i);
+    }
+}
+
+}
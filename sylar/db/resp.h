@@ -0,0 +1,157 @@
+/**
+ * @file resp.h
+ * @brief Redis RESP2/RESP3协议的回复结构, 增量解析与编码
+ */
+#ifndef __SYLAR_DB_RESP_H__
+#define __SYLAR_DB_RESP_H__
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "sylar/buffer_chain.h"
+
+namespace sylar {
+
+/**
+ * @brief RESP回复
+ * @details 字符串类型的数据是接收缓存的零拷贝切片; MAP/ATTR的元素按k1,v1,k2,v2展开.
+ *          类型取值与hiredis的REDIS_REPLY_*一致
+ */
+class RespReply {
+public:
+    typedef std::shared_ptr<RespReply> ptr;
+    enum Type {
+        /// $ 二进制安全字符串
+        STRING = 1,
+        /// * 数组
+        ARRAY = 2,
+        /// : 整数
+        INTEGER = 3,
+        /// _ 或 $-1 / *-1
+        NIL = 4,
+        /// + 状态
+        STATUS = 5,
+        /// - 或 ! 错误
+        ERROR = 6,
+        /// , 浮点数
+        DOUBLE = 7,
+        /// # 布尔
+        BOOL = 8,
+        /// % 字典
+        MAP = 9,
+        /// ~ 集合
+        SET = 10,
+        /// | 属性, 解析时丢弃
+        ATTR = 11,
+        /// > 服务端推送
+        PUSH = 12,
+        /// ( 大整数, 以字符串保存
+        BIGNUM = 13,
+        /// = 带格式的字符串, 数据不含格式前缀
+        VERB = 14
+    };
+
+    RespReply(Type type = NIL);
+
+    Type getType() const { return m_type;}
+    bool isError() const { return m_type == ERROR;}
+    bool isNil() const { return m_type == NIL;}
+    /**
+     * @brief 是否数组/字典/集合/推送等聚合类型
+     */
+    bool isAggregate() const;
+
+    int64_t getInteger() const { return m_integer;}
+    double getDouble() const { return m_double;}
+    bool getBool() const { return m_integer != 0;}
+
+    /**
+     * @brief 字符串/状态/错误/大整数的数据
+     */
+    const BufferChain& getData() const { return m_data;}
+    BufferChain& getData() { return m_data;}
+    /**
+     * @brief 复制数据为std::string
+     */
+    std::string getString() const { return m_data.toString();}
+
+    const std::vector<RespReply::ptr>& getElements() const { return m_elements;}
+    std::vector<RespReply::ptr>& getElements() { return m_elements;}
+    size_t size() const { return m_elements.size();}
+    RespReply::ptr at(size_t idx) const { return idx < m_elements.size() ? m_elements[idx] : nullptr;}
+
+    /**
+     * @brief 按RESP编码追加到out
+     * @param[in] resp3 为false时RESP3特有的类型降级为RESP2的表示
+     */
+    void encodeTo(BufferChain& out, bool resp3 = true) const;
+
+    std::string toString() const;
+
+    static RespReply::ptr String(const std::string& v);
+    static RespReply::ptr Status(const std::string& v);
+    static RespReply::ptr Error(const std::string& v);
+    static RespReply::ptr Integer(int64_t v);
+    static RespReply::ptr Double(double v);
+    static RespReply::ptr Bool(bool v);
+    static RespReply::ptr Nil();
+    static RespReply::ptr Aggregate(Type type, const std::vector<RespReply::ptr>& elements);
+
+    friend class RespParser;
+private:
+    void dump(std::ostream& os) const;
+private:
+    Type m_type;
+    int64_t m_integer;
+    double m_double;
+    BufferChain m_data;
+    std::vector<RespReply::ptr> m_elements;
+};
+
+/**
+ * @brief RESP增量解析器
+ * @details 数据不足时保留已解析的部分, 下次从中断的元素继续, 嵌套数组不会重复解析.
+ *          不支持RESP3的流式字符串/聚合(长度为?)
+ */
+class RespParser {
+public:
+    /**
+     * @brief 从buf头部解析一个完整的回复, 消费已解析的数据
+     * @param[out] reply 完整的回复
+     * @return 1 成功, 0 数据不足, -1 协议错误
+     */
+    int parse(BufferChain& buf, RespReply::ptr& reply);
+
+    /**
+     * @brief 丢弃解析中的状态
+     */
+    void reset();
+
+    /**
+     * @brief 协议错误的原因
+     */
+    const std::string& getError() const { return m_error;}
+private:
+    /**
+     * @brief 解析一个元素, 聚合类型只解析头部
+     */
+    int parseOne(BufferChain& buf, RespReply::ptr& reply, int64_t& count);
+private:
+    struct Frame {
+        RespReply::ptr reply;
+        int64_t remain;
+    };
+    std::vector<Frame> m_stack;
+    std::string m_error;
+};
+
+/**
+ * @brief 编码命令(bulk string数组)追加到out
+ */
+void RespEncodeCommand(BufferChain& out, const std::vector<std::string>& argv);
+
+}
+
+#endif
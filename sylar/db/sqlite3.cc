@@ -2,6 +2,8 @@
 #include "sylar/log.h"
 #include "sylar/config.h"
 #include "sylar/env.h"
+#include "sylar/scheduler.h"
+#include <sstream>
 
 namespace sylar {
 
@@ -11,8 +13,16 @@ static sylar::ConfigVar<std::map<std::string, std::map<std::string, std::string>
     = sylar::Config::Lookup("sqlite3.dbs", std::map<std::string, std::map<std::string, std::string> >()
             , "sqlite3 dbs");
 
+static sylar::ConfigVar<uint32_t>::ptr g_sqlite3_stmt_cache_size
+    = sylar::Config::Lookup("sqlite3.stmt_cache_size", (uint32_t)64
+            , "sqlite3 prepared statement cache size per connection, 0 disable");
+
 SQLite3::SQLite3(sqlite3* db)
-    :m_db(db) {
+    :m_db(db)
+    ,m_stmtCache(g_sqlite3_stmt_cache_size->getValue()) {
+    m_stmtCache.setPruneCallback([](const std::string&, sqlite3_stmt* const& stmt) {
+        sqlite3_finalize(stmt);
+    });
 }
 
 SQLite3::~SQLite3() {
@@ -50,6 +60,7 @@ std::string SQLite3::getErrStr() {
 
 int SQLite3::close() {
     int rc = SQLITE_OK;
+    clearStmtCache();
     if(m_db) {
         rc = sqlite3_close(m_db);
         if(rc == SQLITE_OK) {
@@ -60,7 +71,135 @@ int SQLite3::close() {
 }
 
 IStmt::ptr SQLite3::prepare(const std::string& stmt) {
-    return SQLite3Stmt::Create(shared_from_this(), stmt.c_str());
+    return prepareCached(stmt);
+}
+
+SQLite3Stmt::ptr SQLite3::prepareCached(const std::string& sql) {
+    if(getStmtCacheSize() == 0) {
+        return SQLite3Stmt::Create(shared_from_this(), sql.c_str());
+    }
+    SQLite3Stmt::ptr rt(new SQLite3Stmt(shared_from_this()));
+    rt->m_stmt = takeStmt(sql);
+    if(!rt->m_stmt) {
+        if(sqlite3_prepare_v2(m_db, sql.c_str(), sql.size(), &rt->m_stmt, nullptr) != SQLITE_OK) {
+            return nullptr;
+        }
+        //只有注释或空白的SQL没有语句
+        if(!rt->m_stmt) {
+            return rt;
+        }
+    }
+    rt->m_cacheKey = sql;
+    return rt;
+}
+
+void SQLite3::setStmtCacheSize(size_t v) {
+    if(v < m_stmtCache.size()) {
+        clearStmtCache();
+    }
+    m_stmtCache.setMaxSize(v);
+}
+
+sqlite3_stmt* SQLite3::takeStmt(const std::string& sql) {
+    sqlite3_stmt* stmt = nullptr;
+    if(m_stmtCache.get(sql, stmt)) {
+        m_stmtCache.del(sql);
+    }
+    return stmt;
+}
+
+void SQLite3::returnStmt(const std::string& sql, sqlite3_stmt* stmt) {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    if(getStmtCacheSize() == 0 || m_stmtCache.exists(sql)) {
+        sqlite3_finalize(stmt);
+        return;
+    }
+    m_stmtCache.set(sql, stmt);
+}
+
+void SQLite3::clearStmtCache() {
+    std::vector<sqlite3_stmt*> stmts;
+    auto cb = [&stmts](const std::pair<const std::string
+                    ,std::list<std::pair<std::string, sqlite3_stmt*> >::iterator>& i) {
+        stmts.push_back(i.second->second);
+    };
+    m_stmtCache.foreach(cb);
+    m_stmtCache.clear();
+    for(auto& i : stmts) {
+        sqlite3_finalize(i);
+    }
+}
+
+static std::string BuildInsertSql(const std::string& table
+                ,const std::vector<std::string>& columns, size_t rows) {
+    std::stringstream ss;
+    ss << "insert into " << table << "(";
+    for(size_t i = 0; i < columns.size(); ++i) {
+        ss << (i ? ", " : "") << columns[i];
+    }
+    ss << ") values";
+    for(size_t r = 0; r < rows; ++r) {
+        ss << (r ? ",(" : "(");
+        for(size_t i = 0; i < columns.size(); ++i) {
+            ss << (i ? ",?" : "?");
+        }
+        ss << ")";
+    }
+    return ss.str();
+}
+
+int SQLite3::insertBatch(const std::string& table, const std::vector<std::string>& columns
+                         ,size_t rows, batch_binder binder) {
+    if(columns.empty() || !binder) {
+        return SQLITE_MISUSE;
+    }
+    if(rows == 0) {
+        return SQLITE_OK;
+    }
+    size_t max_vars = sqlite3_limit(m_db, SQLITE_LIMIT_VARIABLE_NUMBER, -1);
+    //行数过多时语句编译和缓存的开销超过收益
+    size_t per_stmt = std::min((size_t)256, max_vars / columns.size());
+    per_stmt = std::max((size_t)1, per_stmt);
+
+    std::shared_ptr<SQLite3Transaction> trans;
+    if(sqlite3_get_autocommit(m_db)) {
+        trans.reset(new SQLite3Transaction(shared_from_this(), false
+                    ,SQLite3Transaction::IMMEDIATE));
+        if(!trans->begin()) {
+            return getErrno();
+        }
+    }
+
+    SQLite3Stmt::ptr stmt;
+    size_t stmt_rows = 0;
+    for(size_t row = 0; row < rows;) {
+        size_t n = std::min(per_stmt, rows - row);
+        if(n != stmt_rows) {
+            stmt = prepareCached(BuildInsertSql(table, columns, n));
+            if(!stmt) {
+                return getErrno();
+            }
+            stmt_rows = n;
+        } else {
+            stmt->reset();
+        }
+        for(size_t i = 0; i < n; ++i) {
+            int rt = binder(stmt, i * columns.size(), row + i);
+            if(rt != SQLITE_OK) {
+                return rt;
+            }
+        }
+        int rt = stmt->execute();
+        if(rt != SQLITE_OK) {
+            return rt;
+        }
+        row += n;
+    }
+    if(trans && !trans->commit()) {
+        return getErrno();
+    }
+    return SQLITE_OK;
 }
 
 int SQLite3::execute(const char* format, ...) {
@@ -104,6 +243,13 @@ int64_t SQLite3::getLastInsertId() {
     return sqlite3_last_insert_rowid(m_db);
 }
 
+bool SQLite3::getBatchInsertIdMode(int64_t& step, bool& first) {
+    //写操作串行, 一条语句插入的行rowid依次加1, last_insert_rowid为最后一行
+    step = 1;
+    first = false;
+    return true;
+}
+
 SQLite3Stmt::ptr SQLite3Stmt::Create(SQLite3::ptr db, const char* stmt) {
     SQLite3Stmt::ptr rt(new SQLite3Stmt(db));
     if(rt->prepare(stmt) != SQLITE_OK) {
@@ -291,7 +437,12 @@ int SQLite3Stmt::prepare(const char* stmt) {
 int SQLite3Stmt::finish() {
     auto rc = SQLITE_OK;
     if(m_stmt) {
-        rc = sqlite3_finalize(m_stmt);
+        if(m_cacheKey.empty()) {
+            rc = sqlite3_finalize(m_stmt);
+        } else {
+            m_db->returnStmt(m_cacheKey, m_stmt);
+            m_cacheKey.clear();
+        }
         m_stmt = nullptr;
     }
     return rc;
@@ -313,6 +464,8 @@ ISQLData::ptr SQLite3Stmt::query() {
 int SQLite3Stmt::execute() {
     int rt = step();
     if(rt == SQLITE_DONE) {
+        //与MySQLStmt一致, 执行完可以直接重新绑定再执行
+        sqlite3_reset(m_stmt);
         rt = SQLITE_OK;
     }
     return rt;
@@ -322,6 +475,7 @@ SQLite3Data::SQLite3Data(std::shared_ptr<SQLite3Stmt> stmt, int err
                          ,const char* errstr)
     :m_errno(err)
     ,m_first(true)
+    ,m_done(false)
     ,m_errstr(errstr)
     ,m_stmt(stmt){
 }
@@ -351,7 +505,7 @@ std::string SQLite3Data::getColumnName(int idx) {
 }
 
 bool SQLite3Data::isNull(int idx) {
-    return false;
+    return sqlite3_column_type(m_stmt->m_stmt, idx) == SQLITE_NULL;
 }
 
 int8_t SQLite3Data::getInt8(int idx) {
@@ -405,7 +559,7 @@ std::string SQLite3Data::getString(int idx) {
 std::string SQLite3Data::getBlob(int idx) {
     const char* v = (const char*)sqlite3_column_blob(m_stmt->m_stmt, idx);
     if(v) {
-        return std::string(v, getColumnType(idx));
+        return std::string(v, getColumnBytes(idx));
     }
     return "";
 }
@@ -416,13 +570,109 @@ time_t SQLite3Data::getTime(int idx) {
 }
 
 bool SQLite3Data::next() {
+    if(m_done) {
+        return false;
+    }
     int rt = m_stmt->step();
     if(m_first) {
-        m_errno = m_stmt->getErrno();
-        m_errstr = m_stmt->getErrStr();
+        //step成功时sqlite3_errcode的值未定义(WAL模式下常为SQLITE_ROW)
+        if(rt == SQLITE_ROW || rt == SQLITE_DONE) {
+            m_errno = SQLITE_OK;
+            m_errstr.clear();
+        } else {
+            m_errno = m_stmt->getErrno();
+            m_errstr = m_stmt->getErrStr();
+        }
         m_first = false;
     }
-    return rt == SQLITE_ROW;
+    if(rt != SQLITE_ROW) {
+        m_done = true;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief 单元值的存储类型对应的列类型
+ */
+static SQLColumnBatch::Type SQLite3ValueType(int type) {
+    switch(type) {
+        case SQLITE_INTEGER:
+            return SQLColumnBatch::INT64;
+        case SQLITE_FLOAT:
+            return SQLColumnBatch::DOUBLE;
+        default:
+            return SQLColumnBatch::STRING;
+    }
+}
+
+static SQLColumnBatch::Type SQLite3ColumnType(sqlite3_stmt* stmt, int idx) {
+    const char* decl = sqlite3_column_decltype(stmt, idx);
+    if(decl) {
+        //https://www.sqlite.org/datatype3.html 类型亲和性
+        std::string t = sylar::ToUpper(decl);
+        if(t.find("INT") != std::string::npos) {
+            return SQLColumnBatch::INT64;
+        }
+        if(t.find("CHAR") != std::string::npos
+                || t.find("CLOB") != std::string::npos
+                || t.find("TEXT") != std::string::npos
+                || t.find("BLOB") != std::string::npos) {
+            return SQLColumnBatch::STRING;
+        }
+        if(t.find("REAL") != std::string::npos
+                || t.find("FLOA") != std::string::npos
+                || t.find("DOUB") != std::string::npos) {
+            return SQLColumnBatch::DOUBLE;
+        }
+        return SQLColumnBatch::STRING;
+    }
+    return SQLite3ValueType(sqlite3_column_type(stmt, idx));
+}
+
+size_t SQLite3Data::fetchBatch(SQLColumnBatch& batch, size_t max_rows) {
+    batch.reset();
+    sqlite3_stmt* stmt = m_stmt->m_stmt;
+    int cols = sqlite3_column_count(stmt);
+    size_t n = 0;
+    while(n < max_rows && next()) {
+        if(batch.getSource() != getBatchId()) {
+            batch.clear();
+            batch.setSource(getBatchId());
+            for(int i = 0; i < cols; ++i) {
+                batch.addColumn(getColumnName(i), SQLite3ColumnType(stmt, i));
+            }
+        }
+        for(int i = 0; i < cols; ++i) {
+            auto& c = batch.getColumn(i);
+            int type = sqlite3_column_type(stmt, i);
+            if(type == SQLITE_NULL) {
+                c.pushNull();
+                continue;
+            }
+            //sqlite的列可以存放任意类型的值, 比列类型宽时提升, 避免截断
+            c.promote(SQLite3ValueType(type));
+            switch(c.type) {
+                case SQLColumnBatch::INT64:
+                    c.push((int64_t)sqlite3_column_int64(stmt, i));
+                    break;
+                case SQLColumnBatch::DOUBLE:
+                    c.push(sqlite3_column_double(stmt, i));
+                    break;
+                default:
+                    {
+                        const char* v = type == SQLITE_BLOB
+                            ? (const char*)sqlite3_column_blob(stmt, i)
+                            : (const char*)sqlite3_column_text(stmt, i);
+                        c.push(v ? v : "", sqlite3_column_bytes(stmt, i));
+                    }
+                    break;
+            }
+        }
+        batch.endRow();
+        ++n;
+    }
+    return n;
 }
 
 SQLite3Transaction::SQLite3Transaction(SQLite3::ptr db, bool auto_commit, Type type)
@@ -512,34 +762,31 @@ SQLite3Manager::~SQLite3Manager() {
             delete n;
         }
     }
-}
-
-SQLite3::ptr SQLite3Manager::get(const std::string& name) {
-    MutexType::Lock lock(m_mutex);
-    auto it = m_conns.find(name);
-    if(it != m_conns.end()) {
-        if(!it->second.empty()) {
-            SQLite3* rt = it->second.front();
-            it->second.pop_front();
-            lock.unlock();
-            return SQLite3::ptr(rt, std::bind(&SQLite3Manager::freeSQLite3,
-                        this, name, std::placeholders::_1));
+    for(auto& i : m_writers) {
+        if(i.second.conn) {
+            delete i.second.conn;
         }
     }
+}
+
+bool SQLite3Manager::getArgs(const std::string& name, std::map<std::string, std::string>& args) {
     auto config = g_sqlite3_dbs->getValue();
     auto sit = config.find(name);
-    std::map<std::string, std::string> args;
     if(sit != config.end()) {
         args = sit->second;
-    } else {
-        sit = m_dbDefines.find(name);
-        if(sit != m_dbDefines.end()) {
-            args = sit->second;
-        } else {
-            return nullptr;
-        }
+        return true;
     }
-    lock.unlock();
+    MutexType::Lock lock(m_mutex);
+    sit = m_dbDefines.find(name);
+    if(sit != m_dbDefines.end()) {
+        args = sit->second;
+        return true;
+    }
+    return false;
+}
+
+SQLite3* SQLite3Manager::open(const std::string& name
+            ,const std::map<std::string, std::string>& args, bool readonly) {
     std::string path = sylar::GetParamValue<std::string>(args, "path");
     if(path.empty()) {
         SYLAR_LOG_ERROR(g_logger) << "open db name=" << name << " path is null";
@@ -551,15 +798,29 @@ SQLite3::ptr SQLite3Manager::get(const std::string& name) {
     }
 
     sqlite3* db;
-    if(sqlite3_open_v2(path.c_str(), &db, SQLite3::CREATE | SQLite3::READWRITE, nullptr)) {
-        SYLAR_LOG_ERROR(g_logger) << "open db name=" << name << " path=" << path << " fail";
+    int flags = readonly ? SQLite3::READONLY : SQLite3::CREATE | SQLite3::READWRITE;
+    if(sqlite3_open_v2(path.c_str(), &db, flags, nullptr)) {
+        SYLAR_LOG_ERROR(g_logger) << "open db name=" << name << " path=" << path
+            << " readonly=" << readonly << " fail";
+        sqlite3_close(db);
         return nullptr;
     }
 
     SQLite3* rt = new SQLite3(db);
-    std::string sql = sylar::GetParamValue<std::string>(args, "sql");
-    if(!sql.empty()) {
-        if(rt->execute(sql)) {
+    rt->setStmtCacheSize(sylar::GetParamValue<uint32_t>(args, "stmt_cache"
+                , g_sqlite3_stmt_cache_size->getValue()));
+    bool wal = sylar::GetParamValue<int>(args, "wal", 0);
+    int busy_timeout = sylar::GetParamValue<int>(args, "busy_timeout", wal ? 5000 : 0);
+    if(busy_timeout > 0) {
+        sqlite3_busy_timeout(db, busy_timeout);
+    }
+    if(!readonly) {
+        std::string sql;
+        if(wal) {
+            sql = "PRAGMA journal_mode=WAL;PRAGMA synchronous=NORMAL;";
+        }
+        sql += sylar::GetParamValue<std::string>(args, "sql");
+        if(!sql.empty() && rt->execute(sql)) {
             SYLAR_LOG_ERROR(g_logger) << "execute sql=" << sql
                 << " errno=" << rt->getErrno() << " errstr=" << rt->getErrStr();
             delete rt;
@@ -567,6 +828,131 @@ SQLite3::ptr SQLite3Manager::get(const std::string& name) {
         }
     }
     rt->m_lastUsedTime = time(0);
+    return rt;
+}
+
+SQLite3::ptr SQLite3Manager::popConn(const std::string& name) {
+    MutexType::Lock lock(m_mutex);
+    auto it = m_conns.find(name);
+    if(it == m_conns.end() || it->second.empty()) {
+        return nullptr;
+    }
+    SQLite3* rt = it->second.front();
+    it->second.pop_front();
+    lock.unlock();
+    return SQLite3::ptr(rt, std::bind(&SQLite3Manager::freeSQLite3,
+                this, name, std::placeholders::_1));
+}
+
+SQLite3::ptr SQLite3Manager::get(const std::string& name) {
+    std::map<std::string, std::string> args;
+    if(!getArgs(name, args)) {
+        return nullptr;
+    }
+    if(sylar::GetParamValue<int>(args, "wal", 0)) {
+        return getWriter(name);
+    }
+    auto conn = popConn(name);
+    if(conn) {
+        return conn;
+    }
+    SQLite3* rt = open(name, args, false);
+    if(!rt) {
+        return nullptr;
+    }
+    return SQLite3::ptr(rt, std::bind(&SQLite3Manager::freeSQLite3,
+                    this, name, std::placeholders::_1));
+}
+
+SQLite3::ptr SQLite3Manager::getWriter(const std::string& name) {
+    std::map<std::string, std::string> args;
+    if(!getArgs(name, args)) {
+        return nullptr;
+    }
+    if(!sylar::GetParamValue<int>(args, "wal", 0)) {
+        return get(name);
+    }
+
+    uint64_t fiber_id = sylar::Scheduler::GetThis() ? sylar::GetFiberId() : 0;
+    pid_t thread_id = fiber_id ? 0 : sylar::GetThreadId();
+
+    MutexType::Lock lock(m_mutex);
+    //map中的元素地址不变
+    Writer& w = m_writers[name];
+    if(w.busy && w.conn && w.owner_fiber == fiber_id && w.owner_thread == thread_id) {
+        //持有者再次获取(如持有时调用execute/openTransaction), 等待自己会死锁
+        ++w.depth;
+        SQLite3* rt = w.conn;
+        lock.unlock();
+        return SQLite3::ptr(rt, std::bind(&SQLite3Manager::freeWriter,
+                    this, name, std::placeholders::_1));
+    }
+    if(!w.busy) {
+        w.busy = true;
+    } else if(fiber_id) {
+        w.waiters.push_back(std::make_pair(sylar::Scheduler::GetThis()
+                    ,sylar::Fiber::GetThis()));
+        lock.unlock();
+        //被唤醒时写连接已经移交给当前协程
+        sylar::Fiber::YieldToHold();
+        lock.lock();
+    } else {
+        while(w.busy) {
+            lock.unlock();
+            usleep(100);
+            lock.lock();
+        }
+        w.busy = true;
+    }
+    w.depth = 1;
+    w.owner_fiber = fiber_id;
+    w.owner_thread = thread_id;
+    SQLite3* rt = w.conn;
+    lock.unlock();
+    if(!rt) {
+        //持有写连接, 不会有其他人同时创建
+        rt = open(name, args, false);
+        if(!rt) {
+            freeWriter(name, nullptr);
+            return nullptr;
+        }
+        lock.lock();
+        w.conn = rt;
+        lock.unlock();
+    }
+    rt->m_lastUsedTime = time(0);
+    return SQLite3::ptr(rt, std::bind(&SQLite3Manager::freeWriter,
+                this, name, std::placeholders::_1));
+}
+
+SQLite3::ptr SQLite3Manager::getReader(const std::string& name) {
+    std::map<std::string, std::string> args;
+    if(!getArgs(name, args)) {
+        return nullptr;
+    }
+    if(!sylar::GetParamValue<int>(args, "wal", 0)) {
+        return get(name);
+    }
+    auto conn = popConn(name);
+    if(conn) {
+        return conn;
+    }
+
+    bool inited = false;
+    {
+        MutexType::Lock lock(m_mutex);
+        m_maxReaders[name] = sylar::GetParamValue<uint32_t>(args, "readers", m_maxConn);
+        auto it = m_writers.find(name);
+        inited = it != m_writers.end() && it->second.conn;
+    }
+    //只读连接不能建库, 先由写连接建库并执行初始化语句
+    if(!inited && !getWriter(name)) {
+        return nullptr;
+    }
+    SQLite3* rt = open(name, args, true);
+    if(!rt) {
+        return nullptr;
+    }
     return SQLite3::ptr(rt, std::bind(&SQLite3Manager::freeSQLite3,
                     this, name, std::placeholders::_1));
 }
@@ -607,7 +993,7 @@ int SQLite3Manager::execute(const std::string& name, const char* format, ...) {
 }
 
 int SQLite3Manager::execute(const std::string& name, const char* format, va_list ap) {
-    auto conn = get(name);
+    auto conn = getWriter(name);
     if(!conn) {
         SYLAR_LOG_ERROR(g_logger) << "SQLite3Manager::execute, get(" << name
             << ") fail, format=" << format;
@@ -617,7 +1003,7 @@ int SQLite3Manager::execute(const std::string& name, const char* format, va_list
 }
 
 int SQLite3Manager::execute(const std::string& name, const std::string& sql) {
-    auto conn = get(name);
+    auto conn = getWriter(name);
     if(!conn) {
         SYLAR_LOG_ERROR(g_logger) << "SQLite3Manager::execute, get(" << name
             << ") fail, sql=" << sql;
@@ -635,7 +1021,7 @@ ISQLData::ptr SQLite3Manager::query(const std::string& name, const char* format,
 }
 
 ISQLData::ptr SQLite3Manager::query(const std::string& name, const char* format, va_list ap) {
-    auto conn = get(name);
+    auto conn = getReader(name);
     if(!conn) {
         SYLAR_LOG_ERROR(g_logger) << "SQLite3Manager::query, get(" << name
             << ") fail, format=" << format;
@@ -645,7 +1031,7 @@ ISQLData::ptr SQLite3Manager::query(const std::string& name, const char* format,
 }
 
 ISQLData::ptr SQLite3Manager::query(const std::string& name, const std::string& sql) {
-    auto conn = get(name);
+    auto conn = getReader(name);
     if(!conn) {
         SYLAR_LOG_ERROR(g_logger) << "SQLite3Manager::query, get(" << name
             << ") fail, sql=" << sql;
@@ -656,7 +1042,7 @@ ISQLData::ptr SQLite3Manager::query(const std::string& name, const std::string&
 }
 
 SQLite3Transaction::ptr SQLite3Manager::openTransaction(const std::string& name, bool auto_commit) {
-    auto conn = get(name);
+    auto conn = getWriter(name);
     if(!conn) {
         SYLAR_LOG_ERROR(g_logger) << "SQLite3Manager::openTransaction, get(" << name
             << ") fail";
@@ -669,7 +1055,8 @@ SQLite3Transaction::ptr SQLite3Manager::openTransaction(const std::string& name,
 void SQLite3Manager::freeSQLite3(const std::string& name, SQLite3* m) {
     if(m->m_db) {
         MutexType::Lock lock(m_mutex);
-        if(m_conns[name].size() < m_maxConn) {
+        auto it = m_maxReaders.find(name);
+        if(m_conns[name].size() < (it == m_maxReaders.end() ? m_maxConn : it->second)) {
             m_conns[name].push_back(m);
             return;
         }
@@ -677,4 +1064,30 @@ void SQLite3Manager::freeSQLite3(const std::string& name, SQLite3* m) {
     delete m;
 }
 
+void SQLite3Manager::freeWriter(const std::string& name, SQLite3* m) {
+    MutexType::Lock lock(m_mutex);
+    auto& w = m_writers[name];
+    if(w.depth > 1) {
+        //外层持有者释放时再归还
+        --w.depth;
+        return;
+    }
+    w.depth = 0;
+    w.owner_fiber = 0;
+    w.owner_thread = 0;
+    if(m && !m->m_db) {
+        //使用者关闭了连接, 下次重新打开
+        w.conn = nullptr;
+        delete m;
+    }
+    if(w.waiters.empty()) {
+        w.busy = false;
+        return;
+    }
+    auto next = w.waiters.front();
+    w.waiters.pop_front();
+    lock.unlock();
+    next.first->schedule(next.second);
+}
+
 }
@@ -14,10 +14,12 @@
 #include <string>
 #include <list>
 #include <map>
+#include <functional>
 #include "sylar/noncopyable.h"
 #include "db.h"
 #include "sylar/mutex.h"
 #include "sylar/singleton.h"
+#include "sylar/ds/lru_cache.h"
 
 namespace sylar {
 
@@ -33,6 +35,7 @@ class SQLite3Manager;
 class SQLite3 : public IDB
               , public std::enable_shared_from_this<SQLite3> {
 friend class SQLite3Manager;
+friend class SQLite3Stmt;
 public:
     enum Flags {
         READONLY = SQLITE_OPEN_READONLY,
@@ -40,14 +43,57 @@ public:
         CREATE = SQLITE_OPEN_CREATE
     };
     typedef std::shared_ptr<SQLite3> ptr;
+    /**
+     * @brief 批量插入时绑定一行的回调
+     * @param[in] stmt 多行INSERT语句
+     * @param[in] offset 本行第一列的参数下标为offset + 1
+     * @param[in] row 行号
+     * @return SQLITE_OK继续, 其他值中止并回滚
+     */
+    typedef std::function<int(std::shared_ptr<SQLite3Stmt> stmt, int offset, size_t row)> batch_binder;
+
     static SQLite3::ptr Create(sqlite3* db);
     static SQLite3::ptr Create(const std::string& dbname
             ,int flags = READWRITE | CREATE);
     ~SQLite3();
 
 
+    /**
+     * @brief 预编译语句, 使用语句缓存
+     */
     IStmt::ptr prepare(const std::string& stmt) override;
 
+    /**
+     * @brief 从语句缓存中取出预编译语句, 没有时编译
+     * @details 返回的语句析构时reset并清空绑定后放回缓存, 缓存按SQL文本LRU淘汰.
+     *          同一条SQL正在被使用时会另外编译一条, 用完后若缓存中已有则直接释放.
+     *          缓存大小为0时等同SQLite3Stmt::Create
+     */
+    std::shared_ptr<SQLite3Stmt> prepareCached(const std::string& sql);
+
+    size_t getStmtCacheSize() const { return m_stmtCache.getMaxSize();}
+    /**
+     * @brief 设置语句缓存大小, 默认为配置sqlite3.stmt_cache_size
+     */
+    void setStmtCacheSize(size_t v);
+    /**
+     * @brief 语句缓存的命中统计
+     */
+    std::string getStmtCacheStatus() { return m_stmtCache.toStatusString();}
+
+    /**
+     * @brief 用多行INSERT批量插入rows行
+     * @details 每条语句插入的行数受SQLITE_LIMIT_VARIABLE_NUMBER限制, 同样行数的语句走语句缓存.
+     *          当前不在事务中时在一个IMMEDIATE事务内完成, 失败回滚; 已在事务中时由调用方提交
+     * @param[in] table 表名
+     * @param[in] columns 列名
+     * @param[in] rows 行数
+     * @param[in] binder 绑定一行
+     * @return SQLITE_OK成功
+     */
+    int insertBatch(const std::string& table, const std::vector<std::string>& columns
+                    ,size_t rows, batch_binder binder);
+
     int getErrno() override;
     std::string getErrStr() override;
 
@@ -59,6 +105,7 @@ public:
     ISQLData::ptr query(const std::string& sql) override;
 
     ITransaction::ptr openTransaction(bool auto_commit = false) override;
+    bool getBatchInsertIdMode(int64_t& step, bool& first) override;
 
     template<typename... Args>
     int execStmt(const char* stmt, Args&&... args);
@@ -71,9 +118,15 @@ public:
     sqlite3* getDB() const { return m_db;}
 private:
     SQLite3(sqlite3* db);
+
+    sqlite3_stmt* takeStmt(const std::string& sql);
+    void returnStmt(const std::string& sql, sqlite3_stmt* stmt);
+    void clearStmtCache();
 private:
     sqlite3* m_db;
     uint64_t m_lastUsedTime = 0;
+    /// SQL文本 -> 空闲的预编译语句
+    sylar::ds::LruCache<std::string, sqlite3_stmt*> m_stmtCache;
 };
 
 class SQLite3Stmt;
@@ -108,9 +161,16 @@ public:
     time_t getTime(int idx) override;
 
     bool next();
+    /**
+     * @brief 直接用sqlite3_column_*写入各列, 列类型按声明类型的亲和性确定,
+     *        表达式列按第一行的值确定; 之后的值比列类型宽时(如整数列遇到浮点)提升列类型
+     */
+    size_t fetchBatch(SQLColumnBatch& batch, size_t max_rows) override;
 private:
     int m_errno;
     bool m_first;
+    /// 已读到结尾, 再step会重新执行语句
+    bool m_done;
     std::string m_errstr;
     std::shared_ptr<SQLite3Stmt> m_stmt;
 };
@@ -118,6 +178,7 @@ private:
 class SQLite3Stmt : public IStmt
                     ,public std::enable_shared_from_this<SQLite3Stmt> {
 friend class SQLite3Data;
+friend class SQLite3;
 public:
     typedef std::shared_ptr<SQLite3Stmt> ptr;
     enum Type {
@@ -128,6 +189,9 @@ public:
 
     int prepare(const char* stmt);
     ~SQLite3Stmt();
+    /**
+     * @brief 释放语句, 来自语句缓存的放回缓存
+     */
     int finish();
 
     int bind(int idx, int32_t value);
@@ -183,6 +247,8 @@ protected:
 protected:
     SQLite3::ptr m_db;
     sqlite3_stmt* m_stmt;
+    /// 来自语句缓存时为缓存的key
+    std::string m_cacheKey;
 };
 
 class SQLite3Transaction : public ITransaction {
@@ -210,13 +276,32 @@ private:
     bool m_autoCommit;
 };
 
+/**
+ * @brief SQLite3连接管理
+ * @details 库的参数: path, sql(新连接执行的初始化语句), stmt_cache(语句缓存大小), busy_timeout(毫秒),
+ *          wal, readers. 配置wal=1时库切换为WAL模式, 只有一个写连接, 同一时间只借给一个使用者;
+ *          读请求使用只读连接池(最多readers个空闲连接, 默认同getMaxConn), 与写并发执行
+ */
 class SQLite3Manager {
 public:
     typedef sylar::Mutex MutexType;
     SQLite3Manager();
     ~SQLite3Manager();
 
+    /**
+     * @brief 获取连接, WAL模式下同getWriter
+     */
     SQLite3::ptr get(const std::string& name);
+    /**
+     * @brief 获取写连接
+     * @details WAL模式下写连接被占用时等待, 协程中挂起当前协程, 否则轮询. 非WAL模式同get.
+     *          持有写连接的协程(线程)再次获取时直接返回同一个连接, 全部释放后才归还
+     */
+    SQLite3::ptr getWriter(const std::string& name);
+    /**
+     * @brief 获取只读连接, 非WAL模式同get
+     */
+    SQLite3::ptr getReader(const std::string& name);
     void registerSQLite3(const std::string& name, const std::map<std::string, std::string>& params);
 
     void checkConnection(int sec = 30);
@@ -224,21 +309,48 @@ public:
     uint32_t getMaxConn() const { return m_maxConn;}
     void setMaxConn(uint32_t v) { m_maxConn = v;}
 
+    /**
+     * @brief 使用写连接执行
+     */
     int execute(const std::string& name, const char* format, ...);
     int execute(const std::string& name, const char* format, va_list ap);
     int execute(const std::string& name, const std::string& sql);
 
+    /**
+     * @brief 使用只读连接查询
+     */
     ISQLData::ptr query(const std::string& name, const char* format, ...);
     ISQLData::ptr query(const std::string& name, const char* format, va_list ap); 
     ISQLData::ptr query(const std::string& name, const std::string& sql);
 
     SQLite3Transaction::ptr openTransaction(const std::string& name, bool auto_commit);
 private:
+    struct Writer {
+        SQLite3* conn = nullptr;
+        /// 写连接被借出
+        bool busy = false;
+        /// 持有者重入的次数
+        uint32_t depth = 0;
+        /// 持有者: 协程中为协程id, 否则为线程id(owner_fiber为0)
+        uint64_t owner_fiber = 0;
+        pid_t owner_thread = 0;
+        /// 等待写连接的协程, 归还时直接移交
+        std::list<std::pair<Scheduler*, Fiber::ptr> > waiters;
+    };
+
+    bool getArgs(const std::string& name, std::map<std::string, std::string>& args);
+    SQLite3* open(const std::string& name, const std::map<std::string, std::string>& args
+                  ,bool readonly);
+    SQLite3::ptr popConn(const std::string& name);
     void freeSQLite3(const std::string& name, SQLite3* m);
+    void freeWriter(const std::string& name, SQLite3* m);
 private:
     uint32_t m_maxConn;
     MutexType m_mutex;
     std::map<std::string, std::list<SQLite3*> > m_conns;
+    std::map<std::string, Writer> m_writers;
+    /// WAL模式下只读连接池的大小
+    std::map<std::string, uint32_t> m_maxReaders;
     std::map<std::string, std::map<std::string, std::string> > m_dbDefines;
 };
 
@@ -253,7 +365,7 @@ int bindX(SQLite3Stmt::ptr stmt, const Args&... args) {
 
 template<typename... Args>
 int SQLite3::execStmt(const char* stmt, Args&&... args) {
-    auto st = SQLite3Stmt::Create(shared_from_this(), stmt);
+    auto st = prepareCached(stmt);
     if(!st) {
         return -1;
     }
@@ -266,7 +378,7 @@ int SQLite3::execStmt(const char* stmt, Args&&... args) {
 
 template<class... Args>
 ISQLData::ptr SQLite3::queryStmt(const char* stmt, const Args&... args) {
-    auto st = SQLite3Stmt::Create(shared_from_this(), stmt);
+    auto st = prepareCached(stmt);
     if(!st) {
         return nullptr;
     }
@@ -0,0 +1,449 @@
+#include "allocator.h"
+#include "sylar/log.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sstream>
+#include <vector>
+
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED 1
+#define MPOL_BIND 2
+#define MPOL_INTERLEAVE 3
+#endif
+
+namespace sylar {
+namespace ds {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static const size_t s_huge_page_size = 2 * 1024 * 1024;
+
+static size_t GetPageSize() {
+    static size_t s_page_size = sysconf(_SC_PAGESIZE);
+    return s_page_size;
+}
+
+MemoryStats::MemoryStats()
+    :bytes(0)
+    ,mapped(0)
+    ,blocks(0)
+    ,allocs(0)
+    ,reallocs(0)
+    ,frees(0)
+    ,huge_fallbacks(0)
+    ,errors(0) {
+}
+
+Allocator::Allocator(const std::string& name)
+    :m_name(name) {
+}
+
+uint64_t Allocator::getResident() {
+    return m_stats.mapped;
+}
+
+std::string Allocator::toString() {
+    std::stringstream ss;
+    ss << "[Allocator name=" << m_name
+       << " bytes=" << m_stats.bytes
+       << " mapped=" << m_stats.mapped
+       << " resident=" << getResident()
+       << " blocks=" << m_stats.blocks
+       << " allocs=" << m_stats.allocs
+       << " reallocs=" << m_stats.reallocs
+       << " frees=" << m_stats.frees
+       << " huge_fallbacks=" << m_stats.huge_fallbacks
+       << " errors=" << m_stats.errors
+       << "]";
+    return ss.str();
+}
+
+Allocator::ptr Allocator::GetDefault() {
+    static Allocator::ptr s_default(new MallocAllocator("default"));
+    return s_default;
+}
+
+void Allocator::onAlloc(size_t size, size_t mapped) {
+    m_stats.bytes += size;
+    m_stats.mapped += mapped;
+    ++m_stats.blocks;
+    ++m_stats.allocs;
+}
+
+void Allocator::onFree(size_t size, size_t mapped) {
+    m_stats.bytes -= size;
+    m_stats.mapped -= mapped;
+    --m_stats.blocks;
+    ++m_stats.frees;
+}
+
+MallocAllocator::MallocAllocator(const std::string& name)
+    :Allocator(name) {
+}
+
+void* MallocAllocator::alloc(size_t size, bool zero) {
+    if(size == 0) {
+        return nullptr;
+    }
+    void* ptr = zero ? calloc(1, size) : malloc(size);
+    if(!ptr) {
+        ++m_stats.errors;
+        return nullptr;
+    }
+    onAlloc(size, size);
+    return ptr;
+}
+
+void* MallocAllocator::realloc(void* ptr, size_t old_size, size_t new_size) {
+    if(!ptr) {
+        return alloc(new_size);
+    }
+    if(new_size == 0) {
+        free(ptr, old_size);
+        return nullptr;
+    }
+    void* rt = ::realloc(ptr, new_size);
+    if(!rt) {
+        ++m_stats.errors;
+        return nullptr;
+    }
+    m_stats.bytes += (int64_t)new_size - (int64_t)old_size;
+    m_stats.mapped += (int64_t)new_size - (int64_t)old_size;
+    ++m_stats.reallocs;
+    return rt;
+}
+
+void MallocAllocator::free(void* ptr, size_t size) {
+    if(!ptr) {
+        return;
+    }
+    ::free(ptr);
+    onFree(size, size);
+}
+
+MmapAllocatorOptions::MmapAllocatorOptions()
+    :huge(HUGE_NONE)
+    ,numa(NUMA_DEFAULT)
+    ,numa_nodes(0)
+    ,populate(false)
+    ,min_mmap_size(64 * 1024) {
+}
+
+std::string MmapAllocatorOptions::toString() const {
+    std::stringstream ss;
+    ss << "[MmapAllocatorOptions huge=" << huge
+       << " numa=" << numa
+       << " numa_nodes=0x" << std::hex << numa_nodes << std::dec
+       << " populate=" << populate
+       << " file_dir=" << file_dir
+       << " min_mmap_size=" << min_mmap_size
+       << "]";
+    return ss.str();
+}
+
+MmapAllocator::MmapAllocator(const std::string& name, const MmapAllocatorOptions& opts)
+    :Allocator(name)
+    ,m_opts(opts) {
+}
+
+MmapAllocator::~MmapAllocator() {
+    MutexType::Lock lock(m_mutex);
+    if(!m_regions.empty()) {
+        SYLAR_LOG_WARN(g_logger) << "MmapAllocator " << m_name << " destroyed with "
+            << m_regions.size() << " live regions";
+    }
+}
+
+size_t MmapAllocator::roundSize(size_t size, bool huge) const {
+    size_t align = huge ? s_huge_page_size : GetPageSize();
+    return (size + align - 1) / align * align;
+}
+
+void MmapAllocator::advise(void* ptr, const Region& region) {
+    if(region.fd < 0 && m_opts.huge != MmapAllocatorOptions::HUGE_NONE
+            && !region.huge && region.mapped >= s_huge_page_size) {
+        if(madvise(ptr, region.mapped, MADV_HUGEPAGE)) {
+            SYLAR_LOG_DEBUG(g_logger) << "madvise(MADV_HUGEPAGE) errno=" << errno
+                << " errstr=" << strerror(errno);
+        }
+    }
+    if(m_opts.numa != MmapAllocatorOptions::NUMA_DEFAULT) {
+        int mode = MPOL_BIND;
+        unsigned long mask = m_opts.numa_nodes;
+        if(m_opts.numa == MmapAllocatorOptions::NUMA_PREFERRED) {
+            mode = MPOL_PREFERRED;
+            mask = mask & (~mask + 1);
+        } else if(m_opts.numa == MmapAllocatorOptions::NUMA_INTERLEAVE) {
+            mode = MPOL_INTERLEAVE;
+        }
+        if(syscall(SYS_mbind, ptr, region.mapped, mode, &mask, sizeof(mask) * 8, 0)) {
+            ++m_stats.errors;
+            SYLAR_LOG_WARN(g_logger) << "mbind(" << m_name << ", mode=" << mode
+                << ", nodes=0x" << std::hex << mask << std::dec << ") errno=" << errno
+                << " errstr=" << strerror(errno);
+        }
+    }
+}
+
+void* MmapAllocator::map(size_t size, Region& region) {
+    region.fd = -1;
+    region.huge = false;
+    region.mapped = 0;
+    void* ptr = MAP_FAILED;
+    if(!m_opts.file_dir.empty()) {
+        std::string path = m_opts.file_dir + "/" + m_name + ".XXXXXX";
+        region.fd = mkstemp(&path[0]);
+        if(region.fd < 0) {
+            SYLAR_LOG_ERROR(g_logger) << "mkstemp(" << path << ") errno=" << errno
+                << " errstr=" << strerror(errno);
+            return nullptr;
+        }
+        unlink(path.c_str());
+        region.mapped = roundSize(size, false);
+        if(ftruncate(region.fd, region.mapped) == 0) {
+            ptr = mmap(nullptr, region.mapped, PROT_READ | PROT_WRITE, MAP_SHARED, region.fd, 0);
+        }
+        if(ptr == MAP_FAILED) {
+            SYLAR_LOG_ERROR(g_logger) << "mmap file " << path << " size=" << region.mapped
+                << " errno=" << errno << " errstr=" << strerror(errno);
+            close(region.fd);
+            return nullptr;
+        }
+        return ptr;
+    }
+
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if(m_opts.huge == MmapAllocatorOptions::HUGE_EXPLICIT) {
+        region.mapped = roundSize(size, true);
+        ptr = mmap(nullptr, region.mapped, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+        if(ptr != MAP_FAILED) {
+            region.huge = true;
+            return ptr;
+        }
+        ++m_stats.huge_fallbacks;
+        SYLAR_LOG_DEBUG(g_logger) << "mmap MAP_HUGETLB size=" << region.mapped
+            << " errno=" << errno << " errstr=" << strerror(errno) << ", fallback to thp";
+    }
+
+    bool align = m_opts.huge != MmapAllocatorOptions::HUGE_NONE && size >= s_huge_page_size;
+    region.mapped = roundSize(size, align);
+    if(!align) {
+        ptr = mmap(nullptr, region.mapped, PROT_READ | PROT_WRITE, flags, -1, 0);
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+    //多映射一个大页再裁掉首尾, 起始地址按2M对齐, 透明大页才能覆盖整个区域
+    size_t len = region.mapped + s_huge_page_size;
+    char* raw = (char*)mmap(nullptr, len, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if(raw == MAP_FAILED) {
+        return nullptr;
+    }
+    char* aligned = (char*)(((uintptr_t)raw + s_huge_page_size - 1) & ~(s_huge_page_size - 1));
+    if(aligned > raw) {
+        munmap(raw, aligned - raw);
+    }
+    size_t tail = (raw + len) - (aligned + region.mapped);
+    if(tail) {
+        munmap(aligned + region.mapped, tail);
+    }
+    return aligned;
+}
+
+void MmapAllocator::unmap(void* ptr, const Region& region) {
+    munmap(ptr, region.mapped);
+    if(region.fd >= 0) {
+        close(region.fd);
+    }
+}
+
+void* MmapAllocator::alloc(size_t size, bool zero) {
+    if(size == 0) {
+        return nullptr;
+    }
+    if(isSmall(size)) {
+        void* ptr = zero ? calloc(1, size) : malloc(size);
+        if(!ptr) {
+            ++m_stats.errors;
+            return nullptr;
+        }
+        onAlloc(size, size);
+        return ptr;
+    }
+    Region region;
+    void* ptr = map(size, region);
+    if(!ptr) {
+        ++m_stats.errors;
+        SYLAR_LOG_ERROR(g_logger) << "MmapAllocator " << m_name << " alloc size=" << size
+            << " failed " << m_opts.toString();
+        return nullptr;
+    }
+    advise(ptr, region);
+    if(m_opts.populate) {
+        //在mbind之后逐页写入, 页面按NUMA策略落到目标节点
+        size_t step = region.huge ? s_huge_page_size : GetPageSize();
+        for(size_t i = 0; i < region.mapped; i += step) {
+            ((volatile char*)ptr)[i] = 0;
+        }
+    }
+    {
+        MutexType::Lock lock(m_mutex);
+        m_regions[ptr] = region;
+    }
+    onAlloc(size, region.mapped);
+    return ptr;
+}
+
+void* MmapAllocator::realloc(void* ptr, size_t old_size, size_t new_size) {
+    if(!ptr) {
+        return alloc(new_size);
+    }
+    if(new_size == 0) {
+        free(ptr, old_size);
+        return nullptr;
+    }
+    if(isSmall(old_size) && isSmall(new_size)) {
+        void* rt = ::realloc(ptr, new_size);
+        if(!rt) {
+            ++m_stats.errors;
+            return nullptr;
+        }
+        m_stats.bytes += (int64_t)new_size - (int64_t)old_size;
+        m_stats.mapped += (int64_t)new_size - (int64_t)old_size;
+        ++m_stats.reallocs;
+        return rt;
+    }
+    if(!isSmall(old_size) && !isSmall(new_size)) {
+        MutexType::Lock lock(m_mutex);
+        auto it = m_regions.find(ptr);
+        if(it == m_regions.end()) {
+            ++m_stats.errors;
+            SYLAR_LOG_ERROR(g_logger) << "MmapAllocator " << m_name << " realloc unknown ptr";
+            return nullptr;
+        }
+        Region region = it->second;
+        //显式大页和按2M对齐的区域不用mremap, 走下面的复制路径保持对齐
+        bool aligned = region.fd < 0 && m_opts.huge != MmapAllocatorOptions::HUGE_NONE
+                        && region.mapped >= s_huge_page_size;
+        size_t mapped = roundSize(new_size, region.huge);
+        if(mapped <= region.mapped) {
+            //在已有映射内伸缩, 缩小时保留映射
+            m_stats.bytes += (int64_t)new_size - (int64_t)old_size;
+            ++m_stats.reallocs;
+            return ptr;
+        }
+        if(!aligned) {
+            if(region.fd >= 0 && ftruncate(region.fd, mapped)) {
+                ++m_stats.errors;
+                return nullptr;
+            }
+            void* rt = mremap(ptr, region.mapped, mapped, MREMAP_MAYMOVE);
+            if(rt == MAP_FAILED) {
+                ++m_stats.errors;
+                SYLAR_LOG_ERROR(g_logger) << "mremap size=" << mapped << " errno=" << errno
+                    << " errstr=" << strerror(errno);
+                return nullptr;
+            }
+            m_regions.erase(it);
+            m_stats.bytes += (int64_t)new_size - (int64_t)old_size;
+            m_stats.mapped += (int64_t)mapped - (int64_t)region.mapped;
+            ++m_stats.reallocs;
+            region.mapped = mapped;
+            m_regions[rt] = region;
+            lock.unlock();
+            advise(rt, region);
+            return rt;
+        }
+    }
+    void* rt = alloc(new_size);
+    if(!rt) {
+        return nullptr;
+    }
+    memcpy(rt, ptr, std::min(old_size, new_size));
+    free(ptr, old_size);
+    //alloc/free各计了一次, 改记为一次realloc
+    --m_stats.allocs;
+    --m_stats.frees;
+    ++m_stats.reallocs;
+    return rt;
+}
+
+void MmapAllocator::free(void* ptr, size_t size) {
+    if(!ptr) {
+        return;
+    }
+    if(isSmall(size)) {
+        ::free(ptr);
+        onFree(size, size);
+        return;
+    }
+    Region region;
+    {
+        MutexType::Lock lock(m_mutex);
+        auto it = m_regions.find(ptr);
+        if(it == m_regions.end()) {
+            ++m_stats.errors;
+            SYLAR_LOG_ERROR(g_logger) << "MmapAllocator " << m_name << " free unknown ptr size=" << size;
+            return;
+        }
+        region = it->second;
+        m_regions.erase(it);
+    }
+    unmap(ptr, region);
+    onFree(size, region.mapped);
+}
+
+uint64_t MmapAllocator::getResident() {
+    size_t page = GetPageSize();
+    uint64_t resident = 0;
+    uint64_t region_mapped = 0;
+    std::vector<unsigned char> vec;
+    MutexType::Lock lock(m_mutex);
+    for(auto& i : m_regions) {
+        region_mapped += i.second.mapped;
+        vec.resize((i.second.mapped + page - 1) / page);
+        if(mincore(i.first, i.second.mapped, &vec[0])) {
+            resident += i.second.mapped;
+            continue;
+        }
+        for(auto& c : vec) {
+            resident += (c & 1) ? page : 0;
+        }
+    }
+    //malloc的小块按映射大小计
+    return resident + (m_stats.mapped - region_mapped);
+}
+
+AllocatorManager::AllocatorManager() {
+}
+
+void AllocatorManager::add(Allocator::ptr allocator) {
+    RWMutexType::WriteLock lock(m_mutex);
+    m_allocators[allocator->getName()] = allocator;
+}
+
+Allocator::ptr AllocatorManager::get(const std::string& name) {
+    RWMutexType::ReadLock lock(m_mutex);
+    auto it = m_allocators.find(name);
+    return it == m_allocators.end() ? Allocator::GetDefault() : it->second;
+}
+
+void AllocatorManager::del(const std::string& name) {
+    RWMutexType::WriteLock lock(m_mutex);
+    m_allocators.erase(name);
+}
+
+std::ostream& AllocatorManager::dump(std::ostream& os) {
+    RWMutexType::ReadLock lock(m_mutex);
+    os << Allocator::GetDefault()->toString() << std::endl;
+    for(auto& i : m_allocators) {
+        os << i.second->toString() << std::endl;
+    }
+    return os;
+}
+
+}
+}
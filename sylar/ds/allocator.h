@@ -0,0 +1,242 @@
+#ifndef __SYLAR_DS_ALLOCATOR_H__
+#define __SYLAR_DS_ALLOCATOR_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <map>
+#include <unordered_map>
+#include <iostream>
+#include "sylar/mutex.h"
+#include "sylar/singleton.h"
+
+namespace sylar {
+namespace ds {
+
+/**
+ * @brief 分配器内存统计
+ */
+struct MemoryStats {
+    MemoryStats();
+    /// 当前分配的字节数(按请求大小)
+    std::atomic<int64_t> bytes;
+    /// 当前映射的字节数(按页/大页对齐后)
+    std::atomic<int64_t> mapped;
+    /// 当前存活的分配块数
+    std::atomic<int64_t> blocks;
+    /// 累计分配/重分配/释放次数
+    std::atomic<uint64_t> allocs;
+    std::atomic<uint64_t> reallocs;
+    std::atomic<uint64_t> frees;
+    /// 显式大页分配失败退化为透明大页的次数
+    std::atomic<uint64_t> huge_fallbacks;
+    /// 失败次数
+    std::atomic<uint64_t> errors;
+};
+
+/**
+ * @brief ds容器的内存分配器
+ * @details free/realloc需要传入分配时的大小, 容器本身都记录了大小, 分配器因此不必维护块表
+ */
+class Allocator {
+public:
+    typedef std::shared_ptr<Allocator> ptr;
+
+    Allocator(const std::string& name);
+    virtual ~Allocator() {}
+
+    /**
+     * @brief 分配内存
+     * @param[in] zero 是否清零
+     * @return 失败返回nullptr
+     */
+    virtual void* alloc(size_t size, bool zero = false) = 0;
+    /**
+     * @brief 重新分配, 保留min(old_size, new_size)的内容, 新增部分不清零
+     */
+    virtual void* realloc(void* ptr, size_t old_size, size_t new_size) = 0;
+    virtual void free(void* ptr, size_t size) = 0;
+    /**
+     * @brief 当前常驻物理内存, 无法统计时返回mapped
+     */
+    virtual uint64_t getResident();
+
+    const std::string& getName() const { return m_name;}
+    const MemoryStats& getStats() const { return m_stats;}
+    std::string toString();
+
+    /**
+     * @brief 默认分配器(malloc), 容器未指定分配器时使用
+     */
+    static Allocator::ptr GetDefault();
+protected:
+    void onAlloc(size_t size, size_t mapped);
+    void onFree(size_t size, size_t mapped);
+protected:
+    std::string m_name;
+    MemoryStats m_stats;
+};
+
+/**
+ * @brief malloc/calloc/realloc, 与容器原有行为一致
+ */
+class MallocAllocator : public Allocator {
+public:
+    typedef std::shared_ptr<MallocAllocator> ptr;
+    MallocAllocator(const std::string& name = "malloc");
+
+    void* alloc(size_t size, bool zero = false) override;
+    void* realloc(void* ptr, size_t old_size, size_t new_size) override;
+    void free(void* ptr, size_t size) override;
+};
+
+/**
+ * @brief mmap分配器选项
+ */
+struct MmapAllocatorOptions {
+    enum HugePage {
+        /// 普通页
+        HUGE_NONE = 0,
+        /// madvise(MADV_HUGEPAGE), 大块按2M对齐
+        HUGE_TRANSPARENT = 1,
+        /// MAP_HUGETLB, 需要预留大页(vm.nr_hugepages), 失败时退化为HUGE_TRANSPARENT
+        HUGE_EXPLICIT = 2
+    };
+    enum NumaPolicy {
+        NUMA_DEFAULT = 0,
+        /// 只在numa_nodes上分配
+        NUMA_BIND = 1,
+        /// 优先在numa_nodes的第一个节点分配
+        NUMA_PREFERRED = 2,
+        /// 在numa_nodes间交错分配
+        NUMA_INTERLEAVE = 3
+    };
+
+    MmapAllocatorOptions();
+
+    HugePage huge;
+    NumaPolicy numa;
+    /// 节点掩码, bit i表示节点i
+    uint64_t numa_nodes;
+    /// 分配时预先建立页表(MAP_POPULATE)
+    bool populate;
+    /// 非空时使用该目录下的临时文件做共享映射(创建后即unlink), 内存可被回写到文件
+    std::string file_dir;
+    /// 小于该值的分配使用malloc, 避免小块占用整页
+    size_t min_mmap_size;
+
+    std::string toString() const;
+};
+
+/**
+ * @brief 基于mmap的分配器, 支持大页、NUMA绑定和文件映射
+ */
+class MmapAllocator : public Allocator {
+public:
+    typedef std::shared_ptr<MmapAllocator> ptr;
+    typedef sylar::Mutex MutexType;
+
+    MmapAllocator(const std::string& name, const MmapAllocatorOptions& opts = MmapAllocatorOptions());
+    ~MmapAllocator();
+
+    void* alloc(size_t size, bool zero = false) override;
+    void* realloc(void* ptr, size_t old_size, size_t new_size) override;
+    void free(void* ptr, size_t size) override;
+    /**
+     * @brief mincore统计映射区域的常驻页
+     */
+    uint64_t getResident() override;
+
+    const MmapAllocatorOptions& getOptions() const { return m_opts;}
+private:
+    struct Region {
+        size_t mapped;
+        int fd;
+        bool huge;
+    };
+
+    void* map(size_t size, Region& region);
+    void unmap(void* ptr, const Region& region);
+    void advise(void* ptr, const Region& region);
+    size_t roundSize(size_t size, bool huge) const;
+    bool isSmall(size_t size) const { return size < m_opts.min_mmap_size;}
+private:
+    MmapAllocatorOptions m_opts;
+    MutexType m_mutex;
+    std::unordered_map<void*, Region> m_regions;
+};
+
+/**
+ * @brief 适配STL容器的分配器, 空指针时使用Allocator::GetDefault()
+ */
+template<class T>
+class StlAllocator {
+public:
+    typedef T value_type;
+
+    StlAllocator(Allocator::ptr allocator = nullptr)
+        :m_allocator(allocator ? allocator : Allocator::GetDefault()) {
+    }
+
+    template<class U>
+    StlAllocator(const StlAllocator<U>& o)
+        :m_allocator(o.getAllocator()) {
+    }
+
+    T* allocate(size_t n) {
+        T* p = (T*)m_allocator->alloc(n * sizeof(T));
+        if(!p && n) {
+            throw std::bad_alloc();
+        }
+        return p;
+    }
+
+    void deallocate(T* p, size_t n) {
+        m_allocator->free(p, n * sizeof(T));
+    }
+
+    const Allocator::ptr& getAllocator() const { return m_allocator;}
+
+    template<class U>
+    bool operator==(const StlAllocator<U>& o) const {
+        return m_allocator == o.getAllocator();
+    }
+
+    template<class U>
+    bool operator!=(const StlAllocator<U>& o) const {
+        return m_allocator != o.getAllocator();
+    }
+private:
+    Allocator::ptr m_allocator;
+};
+
+/**
+ * @brief 命名分配器管理, 用于按用途汇总内存统计
+ */
+class AllocatorManager {
+public:
+    typedef sylar::RWMutex RWMutexType;
+
+    AllocatorManager();
+
+    void add(Allocator::ptr allocator);
+    /**
+     * @brief 按名字获取, 不存在时返回默认分配器
+     */
+    Allocator::ptr get(const std::string& name);
+    void del(const std::string& name);
+
+    std::ostream& dump(std::ostream& os);
+private:
+    RWMutexType m_mutex;
+    std::map<std::string, Allocator::ptr> m_allocators;
+};
+
+typedef sylar::Singleton<AllocatorManager> AllocatorMgr;
+
+}
+}
+
+#endif
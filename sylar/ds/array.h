@@ -5,6 +5,7 @@
 #include <stdint.h>
 #include <iostream>
 #include "sylar/util.h"
+#include "allocator.h"
 
 namespace sylar {
 namespace ds {
@@ -13,28 +14,32 @@ template<class T>
 class Array {
 public:
     typedef std::shared_ptr<Array> ptr;
-    Array(const uint64_t size = 0)
-        :m_size(size) {
-        if(m_size > 0) {
-            m_data = (T*)calloc(m_size, sizeof(T));
-        } else {
-            m_data = nullptr;
-        }
+    /**
+     * @param[in] allocator 内存分配器, 为空时使用Allocator::GetDefault()
+     */
+    Array(const uint64_t size = 0, Allocator::ptr allocator = nullptr)
+        :m_size(size)
+        ,m_allocator(allocator ? allocator : Allocator::GetDefault()) {
+        m_data = (T*)m_allocator->alloc(m_size * sizeof(T), true);
     }
 
-    Array(const T* data, const uint64_t size, bool copy)
+    /**
+     * @param[in] copy 为false时直接引用data, 不负责释放
+     */
+    Array(const T* data, const uint64_t size, bool copy, Allocator::ptr allocator = nullptr)
         :m_size(size) {
         if(!copy) {
-            m_data = data;
+            m_data = (T*)data;
         } else {
-            m_data = (T*)malloc(m_size * sizeof(T));
+            m_allocator = allocator ? allocator : Allocator::GetDefault();
+            m_data = (T*)m_allocator->alloc(m_size * sizeof(T));
             memcpy(m_data, data, size * sizeof(T));
         }
     }
     
     ~Array() {
-        if(m_data) {
-            free(m_data);
+        if(m_data && m_allocator) {
+            m_allocator->free(m_data, m_size * sizeof(T));
         }
     }
 
@@ -88,6 +93,12 @@ public:
 
     uint64_t size() const { return m_size;}
 
+    /**
+     * @brief 数据占用的字节数(不含对象本身)
+     */
+    uint64_t getMemoryUsage() const { return m_allocator ? m_size * sizeof(T) : 0;}
+    const Allocator::ptr& getAllocator() const { return m_allocator;}
+
     bool isSorted() {
         for(uint64_t i = 0; i < m_size; ++i) {
             if(i == (m_size - 1)) {
@@ -158,7 +169,7 @@ public:
     }
 
     bool insert(int64_t idx, const T& v) {
-        m_data = (T*)realloc(m_data, (m_size + 1) * sizeof(T));
+        resizeData(m_size + 1);
         idx = -idx - 1;
         memmove(m_data + (idx + 1)
                 ,m_data + idx
@@ -189,17 +200,21 @@ public:
     }
 
     bool erase(int64_t idx) {
-        m_size -= 1;
+        if(!m_allocator) {
+            //引用外部数据时先复制, 不能改写外部(可能只读)的内存
+            resizeData(m_size);
+        }
         memmove(m_data + idx
                 ,m_data + (idx + 1)
-                ,(m_size - idx) * sizeof(T));
-        m_data = (T*)realloc(m_data, m_size * sizeof(T));
+                ,(m_size - 1 - idx) * sizeof(T));
+        resizeData(m_size - 1);
+        m_size -= 1;
         return true;
     }
 
     void append(const T& v) {
+        resizeData(m_size + 1);
         m_size += 1;
-        m_data = (T*)realloc(m_data, m_size * sizeof(T));
         m_data[m_size - 1] = v;
     }
 
@@ -216,10 +231,12 @@ public:
     bool readFrom(std::istream& is, uint64_t speed = -1) {
         do {
             try {
-                if(!ReadFromStream(is, m_size)) {
+                uint64_t size = 0;
+                if(!ReadFromStream(is, size)) {
                     break;
                 }
-                m_data = (T*)realloc(m_data, m_size * sizeof(T));
+                resizeData(size);
+                m_size = size;
                 if(speed == (uint64_t)-1) {
                     if(!ReadFixFromStream(is, (char*)m_data, m_size * sizeof(T))) {
                         break;
@@ -236,9 +253,22 @@ public:
         } while(0);
         return false;
     }
+private:
+    void resizeData(uint64_t size) {
+        if(!m_allocator) {
+            //引用外部数据时复制一份再修改
+            m_allocator = Allocator::GetDefault();
+            T* data = (T*)m_allocator->alloc(size * sizeof(T));
+            memcpy(data, m_data, std::min(size, m_size) * sizeof(T));
+            m_data = data;
+            return;
+        }
+        m_data = (T*)m_allocator->realloc(m_data, m_size * sizeof(T), size * sizeof(T));
+    }
 private:
     uint64_t m_size;
     T* m_data;
+    Allocator::ptr m_allocator;
 };
 
 }
@@ -1,8 +1,10 @@
 #include "bitmap.h"
+#include "simd.h"
 #include <math.h>
 #include <string.h>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 #include "sylar/log.h"
 #include "sylar/macro.h"
 
@@ -16,6 +18,10 @@ namespace ds {
 Bitmap::base_type Bitmap::POS[sizeof(base_type) * 8];
 Bitmap::base_type Bitmap::NPOS[sizeof(base_type) * 8];
 Bitmap::base_type Bitmap::MASK[sizeof(base_type) * 8];
+uint64_t Bitmap::U64_MASK = 0;
+
+//多路运算每次处理的uint64_t个数, 块常驻L1
+static const uint32_t BLOCK_SIZE = 512;
 
 bool Bitmap::init() {
     for(size_t i = 0; i < (sizeof(base_type) * 8); ++i) {
@@ -23,40 +29,60 @@ bool Bitmap::init() {
         NPOS[i] = ~POS[i];
         MASK[i] = POS[i] - 1;
     }
+    U64_MASK = 0;
+    for(size_t i = 0; i < U64_DIV_BASE; ++i) {
+        U64_MASK |= ((uint64_t)COUNT_MASK) << (i * sizeof(base_type) * 8);
+    }
     return true;
 }
 
 static bool s_init = Bitmap::init();
 
-Bitmap::Bitmap(uint32_t size, uint8_t def)
+Bitmap::Bitmap(uint32_t size, uint8_t def, Allocator::ptr allocator)
     :m_compress(false)
     ,m_size(size)
     ,m_dataSize(ceil(size * 1.0 / VALUE_SIZE))
-    ,m_data(NULL) {
+    ,m_data(NULL)
+    ,m_allocator(allocator ? allocator : Allocator::GetDefault()) {
     if(m_dataSize) {
-        m_data = (base_type*)malloc(m_dataSize * sizeof(base_type));
-        memset(m_data, def, m_dataSize * sizeof(base_type));
+        allocData(m_dataSize, def == 0);
+        if(def) {
+            memset(m_data, def, m_dataSize * sizeof(base_type));
+        }
     }
 }
 
-Bitmap::Bitmap()
+Bitmap::Bitmap(Allocator::ptr allocator)
     :m_compress(true)
     ,m_size(0)
     ,m_dataSize(0)
-    ,m_data(NULL) {
+    ,m_data(NULL)
+    ,m_allocator(allocator) {
 }
 
-Bitmap::Bitmap(const Bitmap& b) {
+Bitmap::Bitmap(const Bitmap& b)
+    :m_data(NULL)
+    ,m_allocator(b.m_allocator) {
     m_compress = b.m_compress;
     m_size = b.m_size;
     m_dataSize = b.m_dataSize;
-    m_data = (base_type*)malloc(m_dataSize * sizeof(base_type));
+    allocData(m_dataSize);
     memcpy(m_data, b.m_data, m_dataSize * sizeof(base_type));
 }
 
 Bitmap::~Bitmap() {
+    freeData();
+}
+
+void Bitmap::allocData(uint32_t size, bool zero) {
+    m_data = (base_type*)m_allocator->alloc(size * sizeof(base_type), zero);
+}
+
+//按当前m_dataSize释放, 调用方需在修改m_dataSize之前调用
+void Bitmap::freeData() {
     if(m_data) {
-        free(m_data);
+        m_allocator->free(m_data, m_dataSize * sizeof(base_type));
+        m_data = NULL;
     }
 }
 
@@ -71,11 +97,9 @@ bool Bitmap::readFrom(sylar::ByteArray::ptr ba) {
     try {
         m_compress = ba->readFuint8();
         m_size = ba->readFuint32();
+        freeData();
         m_dataSize = ba->readFuint32();
-        if(m_data) {
-            free(m_data);
-        }
-        m_data = (base_type*)malloc(m_dataSize * sizeof(base_type));
+        allocData(m_dataSize);
         ba->read((char*)m_data, m_dataSize * sizeof(base_type));
         return true;
     } catch(...) {
@@ -87,13 +111,11 @@ Bitmap& Bitmap::operator=(const Bitmap& b) {
     if(this == &b) {
         return *this;
     }
+    freeData();
     m_compress = b.m_compress;
     m_size = b.m_size;
     m_dataSize = b.m_dataSize;
-    if(m_data) {
-        free(m_data);
-    }
-    m_data = (base_type*)malloc(m_dataSize * sizeof(base_type));
+    allocData(m_dataSize);
     memcpy(m_data, b.m_data, m_dataSize * sizeof(base_type));
     return *this;
 }
@@ -105,9 +127,7 @@ Bitmap& Bitmap::operator&=(const Bitmap& b) {
 
     if(!m_compress && !b.m_compress) {
         uint32_t max_size = m_size / U64_VALUE_SIZE;
-        for(uint32_t i = 0; i < max_size; ++i) {
-            ((uint64_t*)m_data)[i] &= ((uint64_t*)b.m_data)[i];
-        }
+        simd::And((uint64_t*)m_data, (const uint64_t*)b.m_data, max_size);
         for(uint32_t i = max_size * U64_DIV_BASE;
                 i < m_dataSize; ++i) {
             m_data[i] &= b.m_data[i];
@@ -184,9 +204,7 @@ Bitmap& Bitmap::operator|=(const Bitmap& b) {
 
     if(!m_compress && !b.m_compress) {
         uint32_t max_size = m_size / U64_VALUE_SIZE;
-        for(uint32_t i = 0; i < max_size; ++i) {
-            ((uint64_t*)m_data)[i] |= ((uint64_t*)b.m_data)[i];
-        }
+        simd::Or((uint64_t*)m_data, (const uint64_t*)b.m_data, max_size);
         for(uint32_t i = max_size * U64_DIV_BASE;
                 i < m_dataSize; ++i) {
             m_data[i] |= b.m_data[i];
@@ -228,6 +246,37 @@ Bitmap& Bitmap::operator|=(const Bitmap& b) {
     return *this;
 }
 
+void Bitmap::checkOp(const Bitmap& b, const char* op) const {
+    if(m_size != b.m_size) {
+        throw std::logic_error("m_size != b.m_size");
+    }
+    if(m_compress || b.m_compress) {
+        throw std::logic_error(std::string("compress ") + op + " not support");
+    }
+}
+
+Bitmap& Bitmap::operator^=(const Bitmap& b) {
+    checkOp(b, "^=");
+    uint32_t max_size = m_size / U64_VALUE_SIZE;
+    simd::Xor((uint64_t*)m_data, (const uint64_t*)b.m_data, max_size);
+    for(uint32_t i = max_size * U64_DIV_BASE;
+            i < m_dataSize; ++i) {
+        m_data[i] ^= b.m_data[i];
+    }
+    return *this;
+}
+
+Bitmap& Bitmap::andNot(const Bitmap& b) {
+    checkOp(b, "andNot");
+    uint32_t max_size = m_size / U64_VALUE_SIZE;
+    simd::AndNot((uint64_t*)m_data, (const uint64_t*)b.m_data, max_size);
+    for(uint32_t i = max_size * U64_DIV_BASE;
+            i < m_dataSize; ++i) {
+        m_data[i] &= ~b.m_data[i];
+    }
+    return *this;
+}
+
 bool Bitmap::operator== (const Bitmap& b) const {
     if(this == &b) {
         return true;
@@ -263,6 +312,11 @@ Bitmap Bitmap::operator| (const Bitmap& b) {
     return t |= b;
 }
 
+Bitmap Bitmap::operator^ (const Bitmap& b) {
+    Bitmap t(*this);
+    return t ^= b;
+}
+
 std::string Bitmap::toString() const {
     std::stringstream ss;
     ss << "[Bitmap compress=" << m_compress
@@ -383,11 +437,11 @@ Bitmap::ptr Bitmap::compress() const{
         }
     }
 
-    Bitmap::ptr b(new Bitmap);
+    Bitmap::ptr b(new Bitmap(m_allocator));
     b->m_compress = true;
     b->m_size = m_size;
     b->m_dataSize = dst_cur_pos;
-    b->m_data = (base_type*)malloc(dst_cur_pos * sizeof(base_type));
+    b->allocData(dst_cur_pos);
     memcpy(b->m_data, data, dst_cur_pos * sizeof(base_type));
     free(data);
     return b;
@@ -397,7 +451,7 @@ Bitmap::ptr Bitmap::uncompress() const {
     if(!m_compress) {
         return ptr(new Bitmap(*this));
     }
-    Bitmap::ptr b(new Bitmap(m_size));
+    Bitmap::ptr b(new Bitmap(m_size, 0, m_allocator));
     uint32_t cur_pos = 0;
     for(uint32_t i = 0; i < m_dataSize;) {
         base_type cur = m_data[i];
@@ -460,7 +514,7 @@ void Bitmap::resize(uint32_t size, bool v) {
     }
     uint32_t len = ceil(size * 1.0 / VALUE_SIZE);
     if(len > m_dataSize) {
-        base_type* new_data = (base_type*)malloc(len * sizeof(base_type));
+        base_type* new_data = (base_type*)m_allocator->alloc(len * sizeof(base_type));
         memcpy(new_data, m_data, m_dataSize * sizeof(base_type));
         if(v) {
             memset(new_data + m_dataSize, 0xFF, (len - m_dataSize) * sizeof(base_type));
@@ -468,9 +522,7 @@ void Bitmap::resize(uint32_t size, bool v) {
             memset(new_data + m_dataSize, 0, (len - m_dataSize) * sizeof(base_type));
         }
 
-        if(m_data) {
-            free(m_data);
-        }
+        freeData();
         m_data = new_data;
 
         uint32_t left = m_size % VALUE_SIZE;
@@ -485,41 +537,12 @@ void Bitmap::resize(uint32_t size, bool v) {
 }
 
 void Bitmap::foreach(std::function<bool(uint32_t)> cb) {
-    uint32_t max_size = m_size / U64_VALUE_SIZE;
-    uint32_t cur_pos = 0;
-    uint64_t tmp = 0;
-    for(uint32_t i = 0; i < max_size; ++i) {
-        tmp = ((uint64_t*)m_data)[i];
-        if(!tmp) {
-            cur_pos += U64_VALUE_SIZE;
-        } else {
-            for(uint32_t n = 0; n < U64_DIV_BASE; ++n) {
-                tmp = m_data[i * U64_DIV_BASE + n];
-                for(uint32_t x = 0; x < VALUE_SIZE && cur_pos < m_size; ++x, ++cur_pos) {
-                    if(tmp & POS[x]) { //((base_type)1 << x)) {
-                        if(!cb(cur_pos)) {
-                            return;
-                        }
-                    }
-                }
-            }
-        }
-    }
-    for(uint32_t i = max_size * U64_DIV_BASE;
-            i < m_dataSize; ++i) {
-        tmp = m_data[i];
-        if(!tmp) {
-            cur_pos += VALUE_SIZE;
-        } else {
-            for(uint32_t n = 0; n < VALUE_SIZE && cur_pos < m_size; ++n, ++cur_pos) {
-                if(tmp & POS[n]) { //(1UL << n)) {
-                    if(!cb(cur_pos)) {
-                        return;
-                    }
-                }
-            }
+    bool stop = false;
+    foreachChunk([&cb, &stop](const uint64_t* data, uint32_t off, uint32_t len, uint64_t mask) {
+        if(!stop && !ForeachPos(data, off, len, mask, cb)) {
+            stop = true;
         }
-    }
+    });
 }
 
 void Bitmap::rforeach(std::function<bool(uint32_t)> cb) {
@@ -614,38 +637,156 @@ void Bitmap::rforeach(std::function<bool(uint32_t)> cb) {
 }
 
 void Bitmap::listPosAsc(std::vector<uint32_t>& pos) {
+    foreachChunk([&pos](const uint64_t* data, uint32_t off, uint32_t len, uint64_t mask) {
+        ForeachPos(data, off, len, mask, [&pos](uint32_t v) {
+            pos.push_back(v);
+            return true;
+        });
+    });
+}
+
+uint64_t Bitmap::getTailMask() const {
+    uint32_t left_words = m_dataSize - m_size / U64_VALUE_SIZE * U64_DIV_BASE;
+    uint64_t mask = 0;
+    for(uint32_t i = 0; i < left_words; ++i) {
+        base_type m = COUNT_MASK;
+        if(i == left_words - 1 && (m_size % VALUE_SIZE)) {
+            m = MASK[m_size % VALUE_SIZE];
+        }
+        mask |= ((uint64_t)m) << (i * sizeof(base_type) * 8);
+    }
+    return mask;
+}
+
+template<class Cb>
+void Bitmap::foreachChunk(Cb cb) const {
     uint32_t max_size = m_size / U64_VALUE_SIZE;
-    uint32_t cur_pos = 0;
-    uint64_t tmp = 0;
-    for(uint32_t i = 0; i < max_size; ++i) {
-        tmp = ((uint64_t*)m_data)[i];
-        if(!tmp) {
-            cur_pos += U64_VALUE_SIZE;
-        } else {
-            for(size_t x = 0; x < U64_DIV_BASE; ++x) {
-                tmp = m_data[i * U64_DIV_BASE + x];
-                for(uint32_t n = 0; n < VALUE_SIZE && cur_pos < m_size; ++n, ++cur_pos) {
-                    if(tmp & POS[n]) { //(1UL << n)) {
-                        pos.push_back(cur_pos);
-                    }
-                }
+    if(max_size) {
+        cb((const uint64_t*)m_data, 0, max_size, U64_MASK);
+    }
+    uint32_t left_words = m_dataSize - max_size * U64_DIV_BASE;
+    if(left_words) {
+        uint64_t tmp = 0;
+        memcpy(&tmp, m_data + max_size * U64_DIV_BASE, left_words * sizeof(base_type));
+        cb(&tmp, max_size, 1, getTailMask());
+    }
+}
+
+template<class Cb>
+bool Bitmap::ForeachPos(const uint64_t* data, uint32_t off, uint32_t len, uint64_t mask, Cb cb) {
+    static const uint32_t BASE_BITS = sizeof(base_type) * 8;
+    for(uint32_t i = 0; i < len; ++i) {
+        uint64_t tmp = data[i] & mask;
+        uint32_t base = (off + i) * U64_VALUE_SIZE;
+        while(tmp) {
+            uint32_t n = __builtin_ctzll(tmp);
+            if(!cb(base + n / BASE_BITS * VALUE_SIZE + n % BASE_BITS)) {
+                return false;
             }
+            tmp &= tmp - 1;
         }
     }
-    for(uint32_t i = max_size * U64_DIV_BASE; i < m_dataSize; ++i) {
-        tmp = m_data[i];
-        if(!tmp) {
-            cur_pos += VALUE_SIZE;
-        } else {
-            for(uint32_t n = 0; n < VALUE_SIZE && cur_pos < m_size; ++n, ++cur_pos) {
-                if(tmp & POS[n]) { //(1UL << n)) {
-                    pos.push_back(cur_pos);
-                }
+    return true;
+}
+
+template<class Cb>
+void Bitmap::MultiOp(const std::vector<Bitmap::ptr>& bs, bool is_and, Cb cb) {
+    if(bs.empty()) {
+        return;
+    }
+    const Bitmap* first = bs[0].get();
+    for(auto& i : bs) {
+        if(i->m_compress) {
+            throw std::logic_error("compress multi op not support");
+        }
+        if(i->m_size != first->m_size) {
+            throw std::logic_error("m_size != b.m_size");
+        }
+    }
+    auto op = is_and ? simd::And : simd::Or;
+    uint64_t buf[BLOCK_SIZE];
+    uint32_t max_size = first->m_size / U64_VALUE_SIZE;
+    for(uint32_t off = 0; off < max_size; off += BLOCK_SIZE) {
+        uint32_t len = std::min(BLOCK_SIZE, max_size - off);
+        memcpy(buf, (const uint64_t*)first->m_data + off, len * sizeof(uint64_t));
+        bool any = true;
+        for(size_t i = 1; i < bs.size(); ++i) {
+            any = op(buf, (const uint64_t*)bs[i]->m_data + off, len);
+            if(!any && is_and) {
+                break;
             }
         }
+        if(any) {
+            cb(buf, off, len, U64_MASK);
+        }
+    }
+
+    uint32_t left_words = first->m_dataSize - max_size * U64_DIV_BASE;
+    if(left_words) {
+        uint64_t tmp = 0;
+        memcpy(&tmp, first->m_data + max_size * U64_DIV_BASE, left_words * sizeof(base_type));
+        for(size_t i = 1; i < bs.size(); ++i) {
+            uint64_t v = 0;
+            memcpy(&v, bs[i]->m_data + max_size * U64_DIV_BASE, left_words * sizeof(base_type));
+            tmp = is_and ? (tmp & v) : (tmp | v);
+        }
+        cb(&tmp, max_size, 1, first->getTailMask());
     }
 }
 
+Bitmap::ptr Bitmap::And(const std::vector<Bitmap::ptr>& bs) {
+    if(bs.empty()) {
+        return nullptr;
+    }
+    Bitmap::ptr rt(new Bitmap(bs[0]->m_size, 0, bs[0]->m_allocator));
+    uint64_t total = rt->m_dataSize * sizeof(base_type);
+    char* dst = (char*)rt->m_data;
+    MultiOp(bs, true, [dst, total](const uint64_t* data, uint32_t off, uint32_t len, uint64_t mask) {
+        uint64_t from = off * sizeof(uint64_t);
+        memcpy(dst + from, data, std::min(len * sizeof(uint64_t), total - from));
+    });
+    return rt;
+}
+
+Bitmap::ptr Bitmap::Or(const std::vector<Bitmap::ptr>& bs) {
+    if(bs.empty()) {
+        return nullptr;
+    }
+    Bitmap::ptr rt(new Bitmap(bs[0]->m_size, 0, bs[0]->m_allocator));
+    uint64_t total = rt->m_dataSize * sizeof(base_type);
+    char* dst = (char*)rt->m_data;
+    MultiOp(bs, false, [dst, total](const uint64_t* data, uint32_t off, uint32_t len, uint64_t mask) {
+        uint64_t from = off * sizeof(uint64_t);
+        memcpy(dst + from, data, std::min(len * sizeof(uint64_t), total - from));
+    });
+    return rt;
+}
+
+uint32_t Bitmap::AndCount(const std::vector<Bitmap::ptr>& bs) {
+    uint32_t count = 0;
+    MultiOp(bs, true, [&count](const uint64_t* data, uint32_t off, uint32_t len, uint64_t mask) {
+        count += simd::PopCount(data, len, mask);
+    });
+    return count;
+}
+
+uint32_t Bitmap::OrCount(const std::vector<Bitmap::ptr>& bs) {
+    uint32_t count = 0;
+    MultiOp(bs, false, [&count](const uint64_t* data, uint32_t off, uint32_t len, uint64_t mask) {
+        count += simd::PopCount(data, len, mask);
+    });
+    return count;
+}
+
+void Bitmap::AndListPos(const std::vector<Bitmap::ptr>& bs, std::vector<uint32_t>& pos) {
+    MultiOp(bs, true, [&pos](const uint64_t* data, uint32_t off, uint32_t len, uint64_t mask) {
+        ForeachPos(data, off, len, mask, [&pos](uint32_t v) {
+            pos.push_back(v);
+            return true;
+        });
+    });
+}
+
 bool Bitmap::cross(const Bitmap& b) const {
     if(!m_compress && b.m_compress) {
         return compressCross(b);
@@ -870,26 +1011,10 @@ Bitmap::iterator_base::ptr Bitmap::rbegin_new() {
 
 uint32_t Bitmap::getCount() const {
     if(!m_compress) {
-        uint32_t len = m_dataSize / U64_DIV_BASE;// - (m_dataSize % 8 == 0 ? 1 : 0);
         uint32_t count = 0;
-        uint32_t cur_pos = 0;
-        for(uint32_t i = 0; i < len; ++i) {
-            uint64_t tmp = ((uint64_t*)(m_data))[i];
-            count += count_bits(tmp);
-            cur_pos += U64_VALUE_SIZE;
-        }
-        for(uint32_t i = len * U64_DIV_BASE; i < m_dataSize; ++i) {
-            base_type tmp = m_data[i];
-            if(tmp) {
-                for(uint32_t n = 0; n < VALUE_SIZE && cur_pos < m_size; ++n, ++cur_pos) {
-                    if(tmp & POS[n]) { //(1UL << n)) {
-                        ++count;
-                    }
-                }
-            } else {
-                cur_pos += VALUE_SIZE;
-            }
-        }
+        foreachChunk([&count](const uint64_t* data, uint32_t off, uint32_t len, uint64_t mask) {
+            count += simd::PopCount(data, len, mask);
+        });
         return count;
     } else {
         uint32_t count = 0;
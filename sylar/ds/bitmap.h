@@ -7,6 +7,7 @@
 #include <memory>
 #include <functional>
 #include "sylar/bytearray.h"
+#include "allocator.h"
 
 namespace sylar {
 namespace ds {
@@ -33,7 +34,10 @@ public:
     typedef uint64_t base_type;
 #endif
 
-    Bitmap(uint32_t size, uint8_t def = 0);
+    /**
+     * @param[in] allocator 内存分配器, 为空时使用Allocator::GetDefault(); 运算产生的新Bitmap沿用该分配器
+     */
+    Bitmap(uint32_t size, uint8_t def = 0, Allocator::ptr allocator = nullptr);
     Bitmap(const Bitmap& b);
     ~Bitmap();
 
@@ -48,9 +52,14 @@ public:
 
     Bitmap& operator&=(const Bitmap& b);
     Bitmap& operator|=(const Bitmap& b);
+    //仅支持非压缩
+    Bitmap& operator^=(const Bitmap& b);
+    //this & ~b, 仅支持非压缩
+    Bitmap& andNot(const Bitmap& b);
 
     Bitmap operator& (const Bitmap& b);
     Bitmap operator| (const Bitmap& b);
+    Bitmap operator^ (const Bitmap& b);
 
     Bitmap& operator~();
 
@@ -84,6 +93,33 @@ public:
     float getCompressRate() const;
 
     uint32_t getCount() const;
+
+    /**
+     * @brief 数据占用的字节数(不含对象本身)
+     */
+    uint64_t getMemoryUsage() const { return m_data ? (uint64_t)m_dataSize * sizeof(base_type) : 0;}
+    const Allocator::ptr& getAllocator() const { return m_allocator;}
+
+    /**
+     * @brief 多路交集, 按块融合计算, 不产生中间Bitmap(仅支持非压缩, size需一致)
+     */
+    static Bitmap::ptr And(const std::vector<Bitmap::ptr>& bs);
+    /**
+     * @brief 多路并集
+     */
+    static Bitmap::ptr Or(const std::vector<Bitmap::ptr>& bs);
+    /**
+     * @brief 多路交集的元素个数, 不生成结果Bitmap
+     */
+    static uint32_t AndCount(const std::vector<Bitmap::ptr>& bs);
+    /**
+     * @brief 多路并集的元素个数
+     */
+    static uint32_t OrCount(const std::vector<Bitmap::ptr>& bs);
+    /**
+     * @brief 多路交集的位置列表(升序), 不生成结果Bitmap
+     */
+    static void AndListPos(const std::vector<Bitmap::ptr>& bs, std::vector<uint32_t>& pos);
 public:
     class iterator_base {
     public:
@@ -126,12 +162,23 @@ private:
     bool normalCross(const Bitmap& b) const;
     //uncompress to compress
     bool compressCross(const Bitmap& b) const;
-    Bitmap();
+    void checkOp(const Bitmap& b, const char* op) const;
+    template<class Cb>
+    void foreachChunk(Cb cb) const;
+    template<class Cb>
+    static void MultiOp(const std::vector<Bitmap::ptr>& bs, bool is_and, Cb cb);
+    template<class Cb>
+    static bool ForeachPos(const uint64_t* data, uint32_t off, uint32_t len, uint64_t mask, Cb cb);
+    uint64_t getTailMask() const;
+    void allocData(uint32_t size, bool zero = false);
+    void freeData();
+    Bitmap(Allocator::ptr allocator);
 private:
     bool m_compress;
     uint32_t m_size;
     uint32_t m_dataSize;
     base_type* m_data;
+    Allocator::ptr m_allocator;
 private:
     static const uint32_t VALUE_SIZE = sizeof(base_type) * 8 - 2;
     static const base_type COMPRESS_MASK = ((base_type)1 << (sizeof(base_type) * 8 - 1));
@@ -144,6 +191,8 @@ private:
     static base_type POS[sizeof(base_type) * 8];
     static base_type NPOS[sizeof(base_type) * 8];
     static base_type MASK[sizeof(base_type) * 8];
+    //uint64_t中每个base_type的值位掩码(去掉压缩标记位)
+    static uint64_t U64_MASK;
 public:
     static bool init();
 };
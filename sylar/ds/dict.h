@@ -2,6 +2,7 @@
 #define __SYLAR_DS_DICT_H__
 
 #include "sylar/ds/util.h"
+#include "sylar/ds/allocator.h"
 #include "sylar/util.h"
 #include "sylar/mutex.h"
 #include "sylar/log.h"
@@ -23,8 +24,12 @@ public:
     typedef std::shared_ptr<Dict> ptr;
     typedef std::function<bool(const K& k, const V* v, size_t size)> callback;
 
-    Dict(const uint32_t& size = 0)
-        :m_total(0) {
+    /**
+     * @param[in] allocator readFrom加载的value数组使用的分配器, 为空时使用Allocator::GetDefault()
+     */
+    Dict(const uint32_t& size = 0, Allocator::ptr allocator = nullptr)
+        :m_total(0)
+        ,m_values(StlAllocator<V>(allocator)) {
         m_size = basket(size);
         m_datas = new std::vector<Node>[m_size]();
     }
@@ -135,6 +140,24 @@ public:
 
     uint64_t getTotal() const { return m_total;}
 
+    /**
+     * @brief 数据占用的字节数: 桶, 节点和value(遍历统计)
+     */
+    uint64_t getMemoryUsage() {
+        sylar::RWMutex::ReadLock lock(m_mutex);
+        uint64_t rt = m_size * sizeof(std::vector<Node>) + m_values.capacity() * sizeof(V);
+        for(size_t i = 0; i < m_size; ++i) {
+            sylar::RWMutex::ReadLock lock2(s_mutex[i % MAX_MUTEX]);
+            rt += m_datas[i].capacity() * sizeof(Node);
+            for(auto& n : m_datas[i]) {
+                if(!inValues(n.val)) {
+                    rt += n.size * sizeof(V);
+                }
+            }
+        }
+        return rt;
+    }
+
     bool del(const K& k) {
         uint32_t hashvalue = m_posHash(k);
         sylar::RWMutex::ReadLock lock(m_mutex);
@@ -225,7 +248,7 @@ public:
                     break;
                 }
                 //LOG_INFO() << "m_size: " << m_size;
-                std::vector<V>& vs = m_values;
+                auto& vs = m_values;
                 std::vector<Node> ns;
 
                 uint64_t size;
@@ -374,7 +397,7 @@ private:
     sylar::RWMutex m_mutex;
     PosHash m_posHash;
 
-    std::vector<V> m_values;
+    std::vector<V, StlAllocator<V> > m_values;
 
     static const uint32_t MAX_MUTEX = 1024 * 128;
     static sylar::RWMutex s_mutex[MAX_MUTEX];
@@ -453,6 +476,7 @@ public:
     }
 
     uint64_t getTotal() { return m_dict.getTotal();}
+    uint64_t getMemoryUsage() { return m_dict.getMemoryUsage();}
 private:
     Dict<uint64_t, char> m_dict;
 };
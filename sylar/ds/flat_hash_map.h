@@ -0,0 +1,463 @@
+#ifndef __SYLAR_DS_FLAT_HASH_MAP_H__
+#define __SYLAR_DS_FLAT_HASH_MAP_H__
+
+#include "sylar/ds/util.h"
+#include "sylar/mutex.h"
+#include <stdlib.h>
+#include <string.h>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <utility>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace sylar {
+namespace ds {
+
+/**
+ * @brief Swiss table风格的开放寻址哈希表(非线程安全)
+ * @details 每16个槽为一组, 每个槽对应1字节控制字: 空(0x80)/删除(0xFE)/hash低7位(H2).
+ *          查找时用SSE2一次比较一组16个控制字, 只有H2相同的槽才比较key;
+ *          组间按二次探测, 遇到含空槽的组即停止.
+ *          删除时若所在组仍有空槽直接置空, 否则置删除标记; 负载超过7/8时扩容.
+ *          PosHash沿用HashMap的Murmur3Hash(32位), 内部再做一次64位混合
+ */
+template<class K
+        ,class V
+        ,class PosHash = sylar::ds::Murmur3Hash<K>
+        >
+class FlatHashMap {
+template<class, class, class, uint32_t> friend class ConcurrentFlatHashMap;
+public:
+    typedef std::shared_ptr<FlatHashMap> ptr;
+    typedef Pair<K, V> value_type;
+
+    typedef std::function<bool(const K& k, const V& v)> rcallback;
+    typedef std::function<bool(const K& k, V& v)> wcallback;
+
+    FlatHashMap(const uint32_t& size = 0) {
+        if(size) {
+            reserve(size);
+        }
+    }
+
+    ~FlatHashMap() {
+        destroy();
+    }
+
+    FlatHashMap(const FlatHashMap&) = delete;
+    FlatHashMap& operator=(const FlatHashMap&) = delete;
+
+    bool get(const K& k, V& v) {
+        return getHashed(mix(m_posHash(k)), k, v);
+    }
+
+    bool exists(const K& k) {
+        return findHashed(mix(m_posHash(k)), k) != NPOS;
+    }
+
+    /**
+     * @brief 插入或更新
+     * @return 是否新插入
+     */
+    bool set(const K& k, const V& v) {
+        return setHashed(mix(m_posHash(k)), k, v, true);
+    }
+
+    /**
+     * @brief 仅在key不存在时插入
+     * @return 是否插入
+     */
+    bool insert(const K& k, const V& v) {
+        return setHashed(mix(m_posHash(k)), k, v, false);
+    }
+
+    bool del(const K& k) {
+        return delHashed(mix(m_posHash(k)), k);
+    }
+
+    void rforeach(rcallback cb) {
+        for(size_t i = 0; i < m_capacity; ++i) {
+            if(isFull(m_ctrl[i]) && !cb(m_slots[i].first, m_slots[i].second)) {
+                return;
+            }
+        }
+    }
+
+    void wforeach(wcallback cb) {
+        for(size_t i = 0; i < m_capacity; ++i) {
+            if(isFull(m_ctrl[i]) && !cb(m_slots[i].first, m_slots[i].second)) {
+                return;
+            }
+        }
+    }
+
+    uint64_t getTotal() const { return m_total;}
+    uint64_t getCapacity() const { return m_capacity;}
+
+    void clear() {
+        destroy();
+    }
+
+    void swap(FlatHashMap& oth) {
+        std::swap(m_ctrl, oth.m_ctrl);
+        std::swap(m_slots, oth.m_slots);
+        std::swap(m_capacity, oth.m_capacity);
+        std::swap(m_total, oth.m_total);
+        std::swap(m_deleted, oth.m_deleted);
+        std::swap(m_growthLeft, oth.m_growthLeft);
+    }
+
+    void reserve(size_t size) {
+        size_t cap = GROUP;
+        while(cap * 7 / 8 < size) {
+            cap <<= 1;
+        }
+        if(cap > m_capacity) {
+            resize(cap);
+        }
+    }
+
+    std::ostream& dump(std::ostream& os) {
+        os << "[FlatHashMap total=" << m_total
+           << " capacity=" << m_capacity
+           << " deleted=" << m_deleted
+           << " rate=" << (m_capacity ? m_total * 1.0 / m_capacity : 0)
+           << "]" << std::endl;
+        return os;
+    }
+private:
+    static const size_t GROUP = 16;
+    static const size_t NPOS = (size_t)-1;
+    static const int8_t EMPTY = -128;
+    static const int8_t DELETED = -2;
+
+    static bool isFull(int8_t c) { return c >= 0;}
+
+    static uint64_t mix(uint32_t h) {
+        uint64_t x = (uint64_t)h * 0x9E3779B97F4A7C15ULL;
+        return x ^ (x >> 29);
+    }
+
+    static int8_t h2(uint64_t hash) { return hash & 0x7F;}
+
+    /**
+     * @brief 返回一组控制字中等于c的位掩码
+     */
+    static uint32_t match(const int8_t* g, int8_t c) {
+#ifdef __SSE2__
+        __m128i ctrl = _mm_load_si128((const __m128i*)g);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(c)));
+#else
+        uint32_t mask = 0;
+        for(size_t i = 0; i < GROUP; ++i) {
+            mask |= (uint32_t)(g[i] == c) << i;
+        }
+        return mask;
+#endif
+    }
+
+    /**
+     * @brief 返回一组中空槽或已删除槽(最高位为1)的位掩码
+     */
+    static uint32_t matchEmptyOrDeleted(const int8_t* g) {
+#ifdef __SSE2__
+        return _mm_movemask_epi8(_mm_load_si128((const __m128i*)g));
+#else
+        uint32_t mask = 0;
+        for(size_t i = 0; i < GROUP; ++i) {
+            mask |= (uint32_t)(g[i] < 0) << i;
+        }
+        return mask;
+#endif
+    }
+
+    size_t findHashed(uint64_t hash, const K& k) const {
+        if(!m_capacity) {
+            return NPOS;
+        }
+        size_t groups_mask = m_capacity / GROUP - 1;
+        size_t g = (hash >> 7) & groups_mask;
+        int8_t tag = h2(hash);
+        for(size_t step = 1;; ++step) {
+            const int8_t* ctrl = m_ctrl + g * GROUP;
+            uint32_t mask = match(ctrl, tag);
+            while(mask) {
+                size_t idx = g * GROUP + __builtin_ctz(mask);
+                if(m_slots[idx].first == k) {
+                    return idx;
+                }
+                mask &= mask - 1;
+            }
+            if(match(ctrl, EMPTY)) {
+                return NPOS;
+            }
+            g = (g + step) & groups_mask;
+        }
+    }
+
+    /**
+     * @brief 找到第一个可插入(空或已删除)的槽
+     */
+    size_t findInsertSlot(uint64_t hash) const {
+        size_t groups_mask = m_capacity / GROUP - 1;
+        size_t g = (hash >> 7) & groups_mask;
+        for(size_t step = 1;; ++step) {
+            uint32_t mask = matchEmptyOrDeleted(m_ctrl + g * GROUP);
+            if(mask) {
+                return g * GROUP + __builtin_ctz(mask);
+            }
+            g = (g + step) & groups_mask;
+        }
+    }
+
+    bool getHashed(uint64_t hash, const K& k, V& v) const {
+        size_t idx = findHashed(hash, k);
+        if(idx == NPOS) {
+            return false;
+        }
+        v = m_slots[idx].second;
+        return true;
+    }
+
+    bool setHashed(uint64_t hash, const K& k, const V& v, bool overwrite) {
+        size_t idx = findHashed(hash, k);
+        if(idx != NPOS) {
+            if(overwrite) {
+                m_slots[idx].second = v;
+            }
+            return false;
+        }
+        if(m_growthLeft == 0) {
+            //删除标记过多时原容量重建即可
+            resize(m_deleted * 2 > m_total ? m_capacity : std::max(m_capacity * 2, (size_t)GROUP));
+        }
+        idx = findInsertSlot(hash);
+        if(m_ctrl[idx] == DELETED) {
+            --m_deleted;
+        } else {
+            --m_growthLeft;
+        }
+        m_ctrl[idx] = h2(hash);
+        new (&m_slots[idx]) value_type(k, v);
+        ++m_total;
+        return true;
+    }
+
+    bool delHashed(uint64_t hash, const K& k) {
+        size_t idx = findHashed(hash, k);
+        if(idx == NPOS) {
+            return false;
+        }
+        m_slots[idx].~value_type();
+        //组内还有空槽说明探测不会越过这一组, 可以直接置空
+        if(match(m_ctrl + idx / GROUP * GROUP, EMPTY)) {
+            m_ctrl[idx] = EMPTY;
+            ++m_growthLeft;
+        } else {
+            m_ctrl[idx] = DELETED;
+            ++m_deleted;
+        }
+        --m_total;
+        return true;
+    }
+
+    void resize(size_t cap) {
+        int8_t* old_ctrl = m_ctrl;
+        value_type* old_slots = m_slots;
+        size_t old_cap = m_capacity;
+
+        allocate(cap);
+        for(size_t i = 0; i < old_cap; ++i) {
+            if(isFull(old_ctrl[i])) {
+                uint64_t hash = mix(m_posHash(old_slots[i].first));
+                size_t idx = findInsertSlot(hash);
+                m_ctrl[idx] = h2(hash);
+                new (&m_slots[idx]) value_type(std::move(old_slots[i]));
+                old_slots[i].~value_type();
+                --m_growthLeft;
+            }
+        }
+        free(old_ctrl);
+        free(old_slots);
+    }
+
+    void allocate(size_t cap) {
+        void* ctrl = nullptr;
+        if(posix_memalign(&ctrl, GROUP, cap)) {
+            throw std::bad_alloc();
+        }
+        m_ctrl = (int8_t*)ctrl;
+        memset(m_ctrl, EMPTY, cap);
+        m_slots = (value_type*)malloc(cap * sizeof(value_type));
+        if(!m_slots) {
+            throw std::bad_alloc();
+        }
+        m_capacity = cap;
+        m_growthLeft = cap * 7 / 8;
+        m_deleted = 0;
+    }
+
+    void destroy() {
+        for(size_t i = 0; i < m_capacity; ++i) {
+            if(isFull(m_ctrl[i])) {
+                m_slots[i].~value_type();
+            }
+        }
+        free(m_ctrl);
+        free(m_slots);
+        m_ctrl = nullptr;
+        m_slots = nullptr;
+        m_capacity = 0;
+        m_total = 0;
+        m_deleted = 0;
+        m_growthLeft = 0;
+    }
+private:
+    int8_t* m_ctrl = nullptr;
+    value_type* m_slots = nullptr;
+    size_t m_capacity = 0;
+    size_t m_total = 0;
+    size_t m_deleted = 0;
+    size_t m_growthLeft = 0;
+    PosHash m_posHash;
+};
+
+/**
+ * @brief 分片加锁的FlatHashMap, 接口同HashMap
+ * @details 按hash高位选分片, 每个分片(读写锁 + FlatHashMap)按cache line对齐,
+ *          一次操作只加一把锁, 不同分片之间没有伪共享
+ */
+template<class K
+        ,class V
+        ,class PosHash = sylar::ds::Murmur3Hash<K>
+        ,uint32_t SHARDS = 64
+        >
+class ConcurrentFlatHashMap {
+public:
+    typedef std::shared_ptr<ConcurrentFlatHashMap> ptr;
+    typedef FlatHashMap<K, V, PosHash> map_type;
+    typedef typename map_type::rcallback rcallback;
+    typedef typename map_type::wcallback wcallback;
+
+    ConcurrentFlatHashMap(const uint32_t& size = 0) {
+        void* ptr = nullptr;
+        if(posix_memalign(&ptr, 64, sizeof(Shard) * SHARDS)) {
+            throw std::bad_alloc();
+        }
+        m_shards = (Shard*)ptr;
+        for(uint32_t i = 0; i < SHARDS; ++i) {
+            new (&m_shards[i]) Shard();
+            if(size) {
+                m_shards[i].map.reserve(size / SHARDS + 1);
+            }
+        }
+    }
+
+    ~ConcurrentFlatHashMap() {
+        for(uint32_t i = 0; i < SHARDS; ++i) {
+            m_shards[i].~Shard();
+        }
+        free(m_shards);
+    }
+
+    bool get(const K& k, V& v) {
+        uint64_t hash = map_type::mix(m_posHash(k));
+        Shard& s = shard(hash);
+        sylar::RWMutex::ReadLock lock(s.mutex);
+        return s.map.getHashed(hash, k, v);
+    }
+
+    bool exists(const K& k) {
+        uint64_t hash = map_type::mix(m_posHash(k));
+        Shard& s = shard(hash);
+        sylar::RWMutex::ReadLock lock(s.mutex);
+        return s.map.findHashed(hash, k) != map_type::NPOS;
+    }
+
+    bool set(const K& k, const V& v) {
+        uint64_t hash = map_type::mix(m_posHash(k));
+        Shard& s = shard(hash);
+        sylar::RWMutex::WriteLock lock(s.mutex);
+        return s.map.setHashed(hash, k, v, true);
+    }
+
+    bool insert(const K& k, const V& v) {
+        uint64_t hash = map_type::mix(m_posHash(k));
+        Shard& s = shard(hash);
+        sylar::RWMutex::WriteLock lock(s.mutex);
+        return s.map.setHashed(hash, k, v, false);
+    }
+
+    bool del(const K& k) {
+        uint64_t hash = map_type::mix(m_posHash(k));
+        Shard& s = shard(hash);
+        sylar::RWMutex::WriteLock lock(s.mutex);
+        return s.map.delHashed(hash, k);
+    }
+
+    void rforeach(rcallback cb) {
+        bool stop = false;
+        for(uint32_t i = 0; i < SHARDS && !stop; ++i) {
+            sylar::RWMutex::ReadLock lock(m_shards[i].mutex);
+            m_shards[i].map.rforeach([&cb, &stop](const K& k, const V& v) {
+                return !(stop = !cb(k, v));
+            });
+        }
+    }
+
+    void wforeach(wcallback cb) {
+        bool stop = false;
+        for(uint32_t i = 0; i < SHARDS && !stop; ++i) {
+            sylar::RWMutex::WriteLock lock(m_shards[i].mutex);
+            m_shards[i].map.wforeach([&cb, &stop](const K& k, V& v) {
+                return !(stop = !cb(k, v));
+            });
+        }
+    }
+
+    uint64_t getTotal() {
+        uint64_t total = 0;
+        for(uint32_t i = 0; i < SHARDS; ++i) {
+            sylar::RWMutex::ReadLock lock(m_shards[i].mutex);
+            total += m_shards[i].map.getTotal();
+        }
+        return total;
+    }
+
+    void clear() {
+        for(uint32_t i = 0; i < SHARDS; ++i) {
+            sylar::RWMutex::WriteLock lock(m_shards[i].mutex);
+            m_shards[i].map.clear();
+        }
+    }
+
+    std::ostream& dump(std::ostream& os) {
+        os << "[ConcurrentFlatHashMap total=" << getTotal()
+           << " shards=" << SHARDS
+           << "]" << std::endl;
+        return os;
+    }
+private:
+    struct Shard {
+        sylar::RWMutex mutex;
+        map_type map;
+        char pad[64 - (sizeof(sylar::RWMutex) + sizeof(map_type)) % 64];
+    };
+
+    Shard& shard(uint64_t hash) {
+        //高位选分片, 低位用于分片内的组和H2
+        return m_shards[(hash >> 48) % SHARDS];
+    }
+private:
+    Shard* m_shards = nullptr;
+    PosHash m_posHash;
+};
+
+}
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define __SYLAR_DS_HASH_MULTIMAP_H__
 
 #include "sylar/ds/util.h"
+#include "sylar/ds/allocator.h"
 #include "sylar/util.h"
 #include "sylar/mutex.h"
 #include <memory>
@@ -22,9 +23,13 @@ public:
     typedef std::function<bool(const K& k, V* v, int)> wcallback;
 
 
-    HashMultimap(const uint32_t& size = 10)
+    /**
+     * @param[in] allocator readFrom加载的value数组使用的分配器, 为空时使用Allocator::GetDefault()
+     */
+    HashMultimap(const uint32_t& size = 10, Allocator::ptr allocator = nullptr)
         :m_total(0)
-        ,m_elements(0) {
+        ,m_elements(0)
+        ,m_values(StlAllocator<V>(allocator)) {
         m_size = basket(size);
         m_datas = new std::vector<Node>[m_size]();
     }
@@ -346,6 +351,24 @@ public:
     uint64_t getTotal() const { return m_total;}
     uint64_t getElements() const { return m_elements;}
 
+    /**
+     * @brief 数据占用的字节数: 桶, 节点和value(遍历统计)
+     */
+    uint64_t getMemoryUsage() {
+        sylar::RWMutex::ReadLock lock(m_mutex);
+        uint64_t rt = m_size * sizeof(std::vector<Node>) + m_values.capacity() * sizeof(V);
+        for(size_t i = 0; i < m_size; ++i) {
+            sylar::RWMutex::ReadLock lock2(s_mutex[i % MAX_MUTEX]);
+            rt += m_datas[i].capacity() * sizeof(Node);
+            for(auto& n : m_datas[i]) {
+                if(!inValues(n.val)) {
+                    rt += n.size * sizeof(V);
+                }
+            }
+        }
+        return rt;
+    }
+
     std::ostream& dump(std::ostream& os) {
         typename RWMutex::ReadLock lock(m_mutex);
         os << "[HashMultimap total=" << m_total
@@ -408,7 +431,7 @@ public:
                 if(!ReadFromStream(is, m_size)) {
                     break;
                 }
-                std::vector<V>& vs = m_values;
+                auto& vs = m_values;
                 std::vector<Node> ns;
 
                 uint64_t size;
@@ -536,7 +559,7 @@ private:
     sylar::RWMutex m_mutex;
     PosHash m_posHash;
 
-    std::vector<V> m_values;
+    std::vector<V, StlAllocator<V> > m_values;
 
     static const uint32_t MAX_MUTEX = 1024 * 128;
     static sylar::RWMutex s_mutex[MAX_MUTEX];
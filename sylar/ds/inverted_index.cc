@@ -0,0 +1,653 @@
+#include "inverted_index.h"
+#include "mmap_dict.h"
+#include "sylar/endian.h"
+#include "sylar/log.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sstream>
+
+namespace sylar {
+namespace ds {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static const uint32_t s_index_magic = 0x53594949; //SYII
+//v2: posting改为portable格式, 可直接在mmap上创建RoaringBitmapView
+static const uint32_t s_index_version = 2;
+
+IndexQuery::IndexQuery(Type type)
+    :m_type(type) {
+}
+
+IndexQuery::ptr IndexQuery::Term(const std::string& term) {
+    IndexQuery::ptr q(new IndexQuery(TERM));
+    q->m_term = term;
+    return q;
+}
+
+IndexQuery::ptr IndexQuery::And(const std::vector<IndexQuery::ptr>& children) {
+    IndexQuery::ptr q(new IndexQuery(AND));
+    q->m_children = children;
+    return q;
+}
+
+IndexQuery::ptr IndexQuery::Or(const std::vector<IndexQuery::ptr>& children) {
+    IndexQuery::ptr q(new IndexQuery(OR));
+    q->m_children = children;
+    return q;
+}
+
+IndexQuery::ptr IndexQuery::Not(IndexQuery::ptr child) {
+    IndexQuery::ptr q(new IndexQuery(NOT));
+    q->m_children.push_back(child);
+    return q;
+}
+
+std::string IndexQuery::toString() const {
+    if(m_type == TERM) {
+        return m_term;
+    }
+    std::stringstream ss;
+    ss << (m_type == AND ? "AND" : (m_type == OR ? "OR" : "NOT")) << "(";
+    for(size_t i = 0; i < m_children.size(); ++i) {
+        if(i) {
+            ss << ",";
+        }
+        ss << m_children[i]->toString();
+    }
+    ss << ")";
+    return ss.str();
+}
+
+InvertedIndex::Segment::Segment()
+    :all(new RoaringBitmap) {
+}
+
+InvertedIndex::Delta::Delta()
+    :ops(0) {
+}
+
+uint64_t InvertedIndex::Posting::getCount() const {
+    return view ? view->getCount() : bitmap->getCount();
+}
+
+RoaringBitmap::ptr InvertedIndex::Posting::toBitmap() const {
+    return view ? view->toBitmap() : bitmap;
+}
+
+InvertedIndex::InvertedIndex()
+    :m_base(new Segment)
+    ,m_delta(new Delta) {
+}
+
+InvertedIndex::~InvertedIndex() {
+    stopAutoMerge();
+}
+
+void InvertedIndex::addNolock(const std::string& term, uint32_t doc) {
+    auto& p = m_delta->adds[term];
+    if(!p) {
+        p.reset(new RoaringBitmap);
+    }
+    p->set(doc, true);
+    auto it = m_delta->dels.find(term);
+    if(it != m_delta->dels.end()) {
+        it->second->set(doc, false);
+    }
+    m_delta->docs.set(doc, true);
+    ++m_delta->ops;
+}
+
+void InvertedIndex::add(const std::string& term, uint32_t doc) {
+    RWMutexType::WriteLock lock(m_mutex);
+    addNolock(term, doc);
+}
+
+void InvertedIndex::add(const std::string& term, const std::vector<uint32_t>& docs) {
+    RWMutexType::WriteLock lock(m_mutex);
+    for(auto& i : docs) {
+        addNolock(term, i);
+    }
+}
+
+void InvertedIndex::add(uint32_t doc, const std::vector<std::string>& terms) {
+    RWMutexType::WriteLock lock(m_mutex);
+    for(auto& i : terms) {
+        addNolock(i, doc);
+    }
+}
+
+void InvertedIndex::del(const std::string& term, uint32_t doc) {
+    RWMutexType::WriteLock lock(m_mutex);
+    auto it = m_delta->adds.find(term);
+    if(it != m_delta->adds.end()) {
+        it->second->set(doc, false);
+    }
+    auto& p = m_delta->dels[term];
+    if(!p) {
+        p.reset(new RoaringBitmap);
+    }
+    p->set(doc, true);
+    ++m_delta->ops;
+}
+
+void InvertedIndex::delDoc(uint32_t doc) {
+    RWMutexType::WriteLock lock(m_mutex);
+    m_delta->tombs.set(doc, true);
+    m_delta->docs.set(doc, false);
+    for(auto& i : m_delta->adds) {
+        i.second->set(doc, false);
+    }
+    ++m_delta->ops;
+}
+
+RoaringBitmap::ptr InvertedIndex::Apply(RoaringBitmap::ptr p, const Delta& d, const std::string& term) {
+    auto ait = d.adds.find(term);
+    auto dit = d.dels.find(term);
+    bool tomb = p && d.tombs.any() && p->cross(d.tombs);
+    if(!tomb && ait == d.adds.end() && dit == d.dels.end()) {
+        return p;
+    }
+    RoaringBitmap::ptr rt(p ? new RoaringBitmap(*p) : new RoaringBitmap);
+    if(tomb) {
+        *rt -= d.tombs;
+    }
+    if(ait != d.adds.end()) {
+        *rt |= *ait->second;
+    }
+    if(dit != d.dels.end()) {
+        *rt -= *dit->second;
+    }
+    return rt;
+}
+
+RoaringBitmap::ptr InvertedIndex::ApplyAll(RoaringBitmap::ptr p, const Delta& d) {
+    if(!d.tombs.any() && !d.docs.any()) {
+        return p;
+    }
+    RoaringBitmap::ptr rt(new RoaringBitmap(*p));
+    *rt -= d.tombs;
+    *rt |= d.docs;
+    return rt;
+}
+
+bool InvertedIndex::Touched(const RoaringBitmapView& v, const Delta& d, const std::string& term) {
+    return d.adds.count(term) || d.dels.count(term)
+        || (d.tombs.any() && v.cross(d.tombs));
+}
+
+InvertedIndex::Posting InvertedIndex::getNolock(const std::string& term) {
+    Posting rt;
+    auto it = m_base->postings.find(term);
+    if(it != m_base->postings.end()) {
+        rt.bitmap = it->second;
+    } else {
+        auto vit = m_base->views.find(term);
+        if(vit != m_base->views.end()) {
+            if(!(m_merging && Touched(*vit->second, *m_merging, term))
+                    && !Touched(*vit->second, *m_delta, term)) {
+                rt.view = vit->second;
+                return rt;
+            }
+            rt.bitmap = vit->second->toBitmap();
+        }
+    }
+    if(m_merging) {
+        rt.bitmap = Apply(rt.bitmap, *m_merging, term);
+    }
+    rt.bitmap = Apply(rt.bitmap, *m_delta, term);
+    if(!rt.bitmap) {
+        rt.bitmap.reset(new RoaringBitmap);
+    }
+    return rt;
+}
+
+RoaringBitmap::ptr InvertedIndex::get(const std::string& term) {
+    Posting p;
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        p = getNolock(term);
+    }
+    return p.toBitmap();
+}
+
+void InvertedIndex::CollectTerms(IndexQuery::ptr q, std::vector<std::string>& terms) {
+    if(q->getType() == IndexQuery::TERM) {
+        terms.push_back(q->getTerm());
+        return;
+    }
+    for(auto& i : q->getChildren()) {
+        CollectTerms(i, terms);
+    }
+}
+
+void InvertedIndex::resolve(IndexQuery::ptr q, Context& ctx) {
+    std::vector<std::string> terms;
+    CollectTerms(q, terms);
+    RWMutexType::ReadLock lock(m_mutex);
+    for(auto& i : terms) {
+        auto& p = ctx.leaves[i];
+        if(!p.bitmap && !p.view) {
+            p = getNolock(i);
+        }
+    }
+    ctx.all = m_base->all;
+    if(m_merging) {
+        ctx.all = ApplyAll(ctx.all, *m_merging);
+    }
+    ctx.all = ApplyAll(ctx.all, *m_delta);
+}
+
+uint64_t InvertedIndex::estimate(IndexQuery::ptr q, Context& ctx) {
+    switch(q->getType()) {
+        case IndexQuery::TERM:
+            return ctx.leaves[q->getTerm()].getCount();
+        case IndexQuery::AND: {
+                uint64_t v = ctx.all->getCount();
+                for(auto& i : q->getChildren()) {
+                    if(i->getType() != IndexQuery::NOT) {
+                        v = std::min(v, estimate(i, ctx));
+                    }
+                }
+                return v;
+            }
+        case IndexQuery::OR: {
+                uint64_t v = 0;
+                for(auto& i : q->getChildren()) {
+                    v += estimate(i, ctx);
+                }
+                return std::min(v, (uint64_t)ctx.all->getCount());
+            }
+        case IndexQuery::NOT: {
+                uint64_t all = ctx.all->getCount();
+                uint64_t v = estimate(q->getChildren()[0], ctx);
+                return all > v ? all - v : 0;
+            }
+    }
+    return 0;
+}
+
+void InvertedIndex::combine(RoaringBitmap& rt, IndexQuery::ptr q, Context& ctx, IndexQuery::Type op) {
+    //mmap的posting直接参与运算, 不先复制
+    RoaringBitmapView::ptr v;
+    RoaringBitmap::ptr b;
+    if(q->getType() == IndexQuery::TERM) {
+        v = ctx.leaves[q->getTerm()].view;
+    }
+    if(!v) {
+        b = eval(q, ctx);
+    }
+    switch(op) {
+        case IndexQuery::AND:
+            if(v) {
+                rt &= *v;
+            } else {
+                rt &= *b;
+            }
+            break;
+        case IndexQuery::OR:
+            if(v) {
+                rt |= *v;
+            } else {
+                rt |= *b;
+            }
+            break;
+        case IndexQuery::NOT:
+            if(v) {
+                rt -= *v;
+            } else {
+                rt -= *b;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+RoaringBitmap::ptr InvertedIndex::eval(IndexQuery::ptr q, Context& ctx) {
+    switch(q->getType()) {
+        case IndexQuery::TERM:
+            return ctx.leaves[q->getTerm()].toBitmap();
+        case IndexQuery::AND: {
+                std::vector<std::pair<uint64_t, IndexQuery::ptr> > pos;
+                std::vector<IndexQuery::ptr> negs;
+                for(auto& i : q->getChildren()) {
+                    if(i->getType() == IndexQuery::NOT) {
+                        negs.push_back(i->getChildren()[0]);
+                    } else {
+                        pos.push_back(std::make_pair(estimate(i, ctx), i));
+                    }
+                }
+                std::stable_sort(pos.begin(), pos.end(),
+                        [](const std::pair<uint64_t, IndexQuery::ptr>& a
+                           ,const std::pair<uint64_t, IndexQuery::ptr>& b) {
+                    return a.first < b.first;
+                });
+                RoaringBitmap::ptr rt;
+                if(pos.empty()) {
+                    rt.reset(new RoaringBitmap(*ctx.all));
+                } else {
+                    rt.reset(new RoaringBitmap);
+                    combine(*rt, pos[0].second, ctx, IndexQuery::OR);
+                }
+                for(size_t i = 1; i < pos.size() && rt->any(); ++i) {
+                    combine(*rt, pos[i].second, ctx, IndexQuery::AND);
+                }
+                for(size_t i = 0; i < negs.size() && rt->any(); ++i) {
+                    combine(*rt, negs[i], ctx, IndexQuery::NOT);
+                }
+                return rt;
+            }
+        case IndexQuery::OR: {
+                std::vector<RoaringBitmap::ptr> bs;
+                std::vector<RoaringBitmapView::ptr> vs;
+                for(auto& i : q->getChildren()) {
+                    if(i->getType() == IndexQuery::TERM && ctx.leaves[i->getTerm()].view) {
+                        vs.push_back(ctx.leaves[i->getTerm()].view);
+                    } else {
+                        bs.push_back(eval(i, ctx));
+                    }
+                }
+                auto rt = RoaringBitmap::Or(bs);
+                for(auto& i : vs) {
+                    *rt |= *i;
+                }
+                return rt;
+            }
+        case IndexQuery::NOT: {
+                RoaringBitmap::ptr rt(new RoaringBitmap(*ctx.all));
+                combine(*rt, q->getChildren()[0], ctx, IndexQuery::NOT);
+                return rt;
+            }
+    }
+    return RoaringBitmap::ptr(new RoaringBitmap);
+}
+
+RoaringBitmap::ptr InvertedIndex::query(IndexQuery::ptr q) {
+    Context ctx;
+    resolve(q, ctx);
+    return eval(q, ctx);
+}
+
+uint64_t InvertedIndex::count(IndexQuery::ptr q) {
+    Context ctx;
+    resolve(q, ctx);
+    auto& cs = q->getChildren();
+    if(q->getType() == IndexQuery::AND && cs.size() == 2
+            && cs[0]->getType() == IndexQuery::TERM
+            && cs[1]->getType() == IndexQuery::TERM) {
+        auto& a = ctx.leaves[cs[0]->getTerm()];
+        auto& b = ctx.leaves[cs[1]->getTerm()];
+        if(a.view) {
+            return b.view ? a.view->andCount(*b.view) : a.view->andCount(*b.bitmap);
+        }
+        return b.view ? b.view->andCount(*a.bitmap) : a.bitmap->andCount(*b.bitmap);
+    }
+    return eval(q, ctx)->getCount();
+}
+
+uint64_t InvertedIndex::merge() {
+    sylar::Mutex::Lock merge_lock(m_mergeMutex);
+    Segment::ptr base;
+    Delta::ptr d;
+    {
+        RWMutexType::WriteLock lock(m_mutex);
+        if(!m_delta->ops) {
+            return 0;
+        }
+        m_merging = m_delta;
+        m_delta.reset(new Delta);
+        base = m_base;
+        d = m_merging;
+    }
+
+    Segment::ptr seg(new Segment);
+    seg->postings.reserve(base->postings.size() + d->adds.size());
+    for(auto& i : base->postings) {
+        auto p = Apply(i.second, *d, i.first);
+        if(p->any()) {
+            seg->postings[i.first] = p;
+        }
+    }
+    //未修改的mmap posting保留为视图, 修改过的复制后合并
+    for(auto& i : base->views) {
+        if(!Touched(*i.second, *d, i.first)) {
+            seg->views.insert(i);
+            continue;
+        }
+        auto p = Apply(i.second->toBitmap(), *d, i.first);
+        if(p->any()) {
+            seg->postings[i.first] = p;
+        }
+    }
+    if(!seg->views.empty()) {
+        seg->file = base->file;
+    }
+    for(auto& i : d->adds) {
+        if(base->postings.count(i.first) || base->views.count(i.first)) {
+            continue;
+        }
+        auto p = Apply(nullptr, *d, i.first);
+        if(p->any()) {
+            seg->postings[i.first] = p;
+        }
+    }
+    seg->all = ApplyAll(base->all, *d);
+
+    RWMutexType::WriteLock lock(m_mutex);
+    m_base = seg;
+    m_merging.reset();
+    return d->ops;
+}
+
+void InvertedIndex::startAutoMerge(sylar::TimerManager* timer, uint64_t interval_ms, uint64_t min_ops) {
+    stopAutoMerge();
+    AutoMerge::ptr am(new AutoMerge(this));
+    m_autoMerge = am;
+    //回调只持有AutoMerge, 索引停止合并后不再访问
+    m_timer = timer->addTimer(interval_ms, [am, min_ops](){
+        sylar::Mutex::Lock lock(am->mutex);
+        if(am->index && am->index->getDeltaOps() >= min_ops) {
+            am->index->merge();
+        }
+    }, true);
+}
+
+void InvertedIndex::stopAutoMerge() {
+    if(m_timer) {
+        m_timer->cancel();
+        m_timer = nullptr;
+    }
+    if(m_autoMerge) {
+        sylar::Mutex::Lock lock(m_autoMerge->mutex);
+        m_autoMerge->index = nullptr;
+        lock.unlock();
+        m_autoMerge = nullptr;
+    }
+}
+
+static void WritePortable(sylar::ByteArray::ptr ba, const RoaringBitmap& b) {
+    std::vector<iovec> iovs;
+    std::string buffer;
+    uint64_t size = b.writeTo(iovs, buffer);
+    ba->writeFuint32(size);
+    for(auto& i : iovs) {
+        ba->write(i.iov_base, i.iov_len);
+    }
+}
+
+bool InvertedIndex::writeTo(const std::string& path) {
+    merge();
+    Segment::ptr seg;
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        seg = m_base;
+    }
+    sylar::ByteArray::ptr ba(new sylar::ByteArray);
+    ba->writeFuint32(s_index_magic);
+    ba->writeFuint32(s_index_version);
+    ba->writeFuint64(seg->postings.size() + seg->views.size());
+    WritePortable(ba, *seg->all);
+    for(auto& i : seg->postings) {
+        ba->writeStringF32(i.first);
+        WritePortable(ba, *i.second);
+    }
+    for(auto& i : seg->views) {
+        ba->writeStringF32(i.first);
+        WritePortable(ba, *i.second->toBitmap());
+    }
+    ba->setPosition(0);
+
+    //与MmapDictFileWriter一致, 数据落盘后再rename, 避免掉电后得到不完整的快照
+    std::string tmp = path + ".tmp";
+    FILE* file = fopen(tmp.c_str(), "wb");
+    if(!file) {
+        SYLAR_LOG_ERROR(g_logger) << "InvertedIndex open " << tmp
+            << " fail errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    std::vector<iovec> iovs;
+    ba->getReadBuffers(iovs);
+    bool ok = true;
+    for(auto& i : iovs) {
+        if(fwrite(i.iov_base, 1, i.iov_len, file) != i.iov_len) {
+            ok = false;
+            break;
+        }
+    }
+    ok = ok && !fflush(file) && !fsync(fileno(file));
+    ok = !fclose(file) && ok;
+    if(!ok) {
+        SYLAR_LOG_ERROR(g_logger) << "InvertedIndex write " << tmp
+            << " fail errno=" << errno << " errstr=" << strerror(errno);
+        unlink(tmp.c_str());
+        return false;
+    }
+    if(rename(tmp.c_str(), path.c_str())) {
+        SYLAR_LOG_ERROR(g_logger) << "InvertedIndex rename " << tmp << " to " << path
+            << " fail errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+namespace {
+
+//按ByteArray默认的网络字节序读取映射内存
+class MmapReader {
+public:
+    MmapReader(const char* data, uint64_t size)
+        :m_cur(data)
+        ,m_end(data + size) {
+    }
+
+    template<class T>
+    bool readF(T& v) {
+        if((uint64_t)(m_end - m_cur) < sizeof(T)) {
+            return false;
+        }
+        memcpy(&v, m_cur, sizeof(T));
+        v = sylar::byteswapOnLittleEndian(v);
+        m_cur += sizeof(T);
+        return true;
+    }
+
+    bool read(const char*& p, uint64_t size) {
+        if((uint64_t)(m_end - m_cur) < size) {
+            return false;
+        }
+        p = m_cur;
+        m_cur += size;
+        return true;
+    }
+
+    /**
+     * @brief 在映射内存上创建视图, holder保活映射
+     */
+    RoaringBitmapView::ptr readView(std::shared_ptr<void> holder) {
+        uint32_t size = 0;
+        const char* p = nullptr;
+        if(!readF(size) || !read(p, size)) {
+            return nullptr;
+        }
+        auto v = RoaringBitmapView::Create(p, size, holder);
+        return v && v->getSizeInBytes() == size ? v : nullptr;
+    }
+private:
+    const char* m_cur;
+    const char* m_end;
+};
+
+}
+
+bool InvertedIndex::load(const std::string& path) {
+    MmapFile::ptr file(new MmapFile);
+    if(!file->open(path)) {
+        return false;
+    }
+    MmapReader reader(file->getData(), file->getSize());
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    uint64_t count = 0;
+    RoaringBitmapView::ptr all;
+    if(!reader.readF(magic) || magic != s_index_magic
+            || !reader.readF(version) || version != s_index_version
+            || !reader.readF(count)
+            || !(all = reader.readView(file))) {
+        SYLAR_LOG_ERROR(g_logger) << "InvertedIndex load " << path << " invalid header";
+        return false;
+    }
+    //all在合并时需要修改, 复制一份
+    Segment::ptr seg(new Segment);
+    seg->all = all->toBitmap();
+    seg->file = file;
+    seg->views.reserve(count);
+    for(uint64_t i = 0; i < count; ++i) {
+        uint32_t len = 0;
+        const char* term = nullptr;
+        RoaringBitmapView::ptr v;
+        if(!reader.readF(len) || !reader.read(term, len) || !(v = reader.readView(file))) {
+            SYLAR_LOG_ERROR(g_logger) << "InvertedIndex load " << path
+                << " invalid posting idx=" << i;
+            return false;
+        }
+        seg->views[std::string(term, len)] = v;
+    }
+
+    sylar::Mutex::Lock merge_lock(m_mergeMutex);
+    RWMutexType::WriteLock lock(m_mutex);
+    m_base = seg;
+    m_merging.reset();
+    m_delta.reset(new Delta);
+    return true;
+}
+
+uint64_t InvertedIndex::getTermCount() {
+    RWMutexType::ReadLock lock(m_mutex);
+    return m_base->postings.size() + m_base->views.size();
+}
+
+uint64_t InvertedIndex::getDocCount() {
+    Context ctx;
+    resolve(IndexQuery::Or({}), ctx);
+    return ctx.all->getCount();
+}
+
+uint64_t InvertedIndex::getDeltaOps() {
+    RWMutexType::ReadLock lock(m_mutex);
+    return m_delta->ops + (m_merging ? m_merging->ops : 0);
+}
+
+std::string InvertedIndex::toString() {
+    std::stringstream ss;
+    ss << "[InvertedIndex terms=" << getTermCount()
+       << " docs=" << getDocCount()
+       << " delta_ops=" << getDeltaOps()
+       << "]";
+    return ss.str();
+}
+
+}
+}
@@ -0,0 +1,185 @@
+#ifndef __SYLAR_DS_INVERTED_INDEX_H__
+#define __SYLAR_DS_INVERTED_INDEX_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include "roaring_bitmap.h"
+#include "mmap_dict.h"
+#include "sylar/mutex.h"
+#include "sylar/timer.h"
+
+namespace sylar {
+namespace ds {
+
+/**
+ * @brief 布尔查询树
+ */
+class IndexQuery {
+public:
+    typedef std::shared_ptr<IndexQuery> ptr;
+    enum Type {
+        TERM = 1,
+        AND = 2,
+        OR = 3,
+        NOT = 4
+    };
+
+    static IndexQuery::ptr Term(const std::string& term);
+    static IndexQuery::ptr And(const std::vector<IndexQuery::ptr>& children);
+    static IndexQuery::ptr Or(const std::vector<IndexQuery::ptr>& children);
+    static IndexQuery::ptr Not(IndexQuery::ptr child);
+
+    Type getType() const { return m_type;}
+    const std::string& getTerm() const { return m_term;}
+    const std::vector<IndexQuery::ptr>& getChildren() const { return m_children;}
+
+    std::string toString() const;
+private:
+    IndexQuery(Type type);
+private:
+    Type m_type;
+    std::string m_term;
+    std::vector<IndexQuery::ptr> m_children;
+};
+
+/**
+ * @brief 倒排索引, term -> RoaringBitmap(doc id)
+ * @details 基础段不可变, 查询只在解析term时短暂持有读锁;
+ *          增删写入增量段(新增/删除bitmap和删除文档的墓碑), 查询时叠加到基础段上;
+ *          merge在锁外把增量合并成新的基础段后原子替换, 未变化的posting共享不复制.
+ *          AND按估算基数从小到大求交, 结果为空即停止; NOT相对于全部文档取补.
+ *          load的基础段posting是快照mmap上的RoaringBitmapView, 查询直接在映射内存上计算,
+ *          只有被增量修改的posting在查询/合并时复制为RoaringBitmap
+ */
+class InvertedIndex {
+public:
+    typedef std::shared_ptr<InvertedIndex> ptr;
+    typedef sylar::RWMutex RWMutexType;
+    typedef std::unordered_map<std::string, RoaringBitmap::ptr> PostingMap;
+    typedef std::unordered_map<std::string, RoaringBitmapView::ptr> PostingViewMap;
+
+    InvertedIndex();
+    ~InvertedIndex();
+
+    void add(const std::string& term, uint32_t doc);
+    void add(const std::string& term, const std::vector<uint32_t>& docs);
+    void add(uint32_t doc, const std::vector<std::string>& terms);
+    /**
+     * @brief 从term的posting中删除doc
+     */
+    void del(const std::string& term, uint32_t doc);
+    /**
+     * @brief 删除文档(从所有term中删除)
+     */
+    void delDoc(uint32_t doc);
+
+    /**
+     * @brief term当前的posting(只读, 可能与索引共享; mmap加载的posting返回复制)
+     */
+    RoaringBitmap::ptr get(const std::string& term);
+
+    RoaringBitmap::ptr query(IndexQuery::ptr q);
+    uint64_t count(IndexQuery::ptr q);
+
+    /**
+     * @brief 把增量合并到基础段
+     * @return 合并的增量操作数
+     */
+    uint64_t merge();
+
+    /**
+     * @brief 定时后台合并, 增量操作数达到min_ops时执行
+     * @details 析构或stopAutoMerge时取消定时器, 并等待正在执行的合并回调结束
+     */
+    void startAutoMerge(sylar::TimerManager* timer, uint64_t interval_ms, uint64_t min_ops = 1);
+    void stopAutoMerge();
+
+    /**
+     * @brief 合并后写快照(posting为portable格式), 写临时文件fsync后rename
+     */
+    bool writeTo(const std::string& path);
+    /**
+     * @brief mmap加载快照, 替换当前索引内容
+     * @details posting不复制, 映射由基础段持有, 直到所有引用它的段和查询释放
+     */
+    bool load(const std::string& path);
+
+    uint64_t getTermCount();
+    uint64_t getDocCount();
+    uint64_t getDeltaOps();
+    std::string toString();
+private:
+    struct Segment {
+        typedef std::shared_ptr<Segment> ptr;
+        Segment();
+        PostingMap postings;
+        //快照中未被修改的posting, 与postings的term不重复
+        PostingViewMap views;
+        MmapFile::ptr file;
+        RoaringBitmap::ptr all;
+    };
+
+    struct Delta {
+        typedef std::shared_ptr<Delta> ptr;
+        Delta();
+        PostingMap adds;
+        PostingMap dels;
+        RoaringBitmap tombs;
+        RoaringBitmap docs;
+        uint64_t ops;
+    };
+
+    /**
+     * @brief 查询叶子, bitmap和view只有一个非空
+     */
+    struct Posting {
+        RoaringBitmap::ptr bitmap;
+        RoaringBitmapView::ptr view;
+
+        uint64_t getCount() const;
+        RoaringBitmap::ptr toBitmap() const;
+    };
+
+    struct Context {
+        std::unordered_map<std::string, Posting> leaves;
+        RoaringBitmap::ptr all;
+    };
+
+    /**
+     * @brief 定时合并回调与索引之间的共享状态, 索引停止合并后置空
+     */
+    struct AutoMerge {
+        typedef std::shared_ptr<AutoMerge> ptr;
+        AutoMerge(InvertedIndex* i)
+            :index(i) {}
+        sylar::Mutex mutex;
+        InvertedIndex* index;
+    };
+
+    static RoaringBitmap::ptr Apply(RoaringBitmap::ptr p, const Delta& d, const std::string& term);
+    static RoaringBitmap::ptr ApplyAll(RoaringBitmap::ptr p, const Delta& d);
+    static bool Touched(const RoaringBitmapView& v, const Delta& d, const std::string& term);
+    static void CollectTerms(IndexQuery::ptr q, std::vector<std::string>& terms);
+    void resolve(IndexQuery::ptr q, Context& ctx);
+    RoaringBitmap::ptr eval(IndexQuery::ptr q, Context& ctx);
+    void combine(RoaringBitmap& rt, IndexQuery::ptr q, Context& ctx, IndexQuery::Type op);
+    uint64_t estimate(IndexQuery::ptr q, Context& ctx);
+    Posting getNolock(const std::string& term);
+    void addNolock(const std::string& term, uint32_t doc);
+private:
+    RWMutexType m_mutex;
+    sylar::Mutex m_mergeMutex;
+    Segment::ptr m_base;
+    Delta::ptr m_merging;
+    Delta::ptr m_delta;
+    sylar::Timer::ptr m_timer;
+    AutoMerge::ptr m_autoMerge;
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,238 @@
+#include "mmap_dict.h"
+#include "sylar/log.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <zlib.h>
+#include <sstream>
+
+namespace sylar {
+namespace ds {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static const char s_magic[8] = {'S', 'Y', 'D', 'I', 'C', 'T', 0, 0};
+
+uint32_t MmapDictCrc32(uint32_t crc, const void* data, uint64_t size) {
+    const Bytef* ptr = (const Bytef*)data;
+    //zlib的crc32长度参数为uInt, 分段计算
+    while(size > 0) {
+        uInt len = size > (1u << 30) ? (1u << 30) : (uInt)size;
+        crc = crc32(crc, ptr, len);
+        ptr += len;
+        size -= len;
+    }
+    return crc;
+}
+
+void MmapDictHeader::init() {
+    memset(this, 0, sizeof(*this));
+    memcpy(magic, s_magic, sizeof(magic));
+    version = VERSION;
+    create_time = time(0);
+}
+
+uint32_t MmapDictHeader::calcHeaderCrc() const {
+    MmapDictHeader tmp = *this;
+    tmp.header_crc = 0;
+    return MmapDictCrc32(0, &tmp, sizeof(tmp));
+}
+
+bool MmapDictHeader::check(uint32_t t, uint32_t ks, uint32_t vs
+                           ,uint32_t ns, uint64_t fs) const {
+    if(memcmp(magic, s_magic, sizeof(magic))) {
+        SYLAR_LOG_ERROR(g_logger) << "MmapDictHeader invalid magic";
+        return false;
+    }
+    if(version != VERSION) {
+        SYLAR_LOG_ERROR(g_logger) << "MmapDictHeader version=" << version
+            << " not supported, expect " << VERSION;
+        return false;
+    }
+    if(header_crc != calcHeaderCrc()) {
+        SYLAR_LOG_ERROR(g_logger) << "MmapDictHeader header crc error";
+        return false;
+    }
+    bool type_ok = t ? (type == t) : (type == DICT || type == MULTIMAP);
+    if(!type_ok || key_size != ks || value_size != vs || node_size != ns) {
+        SYLAR_LOG_ERROR(g_logger) << "MmapDictHeader layout mismatch " << toString()
+            << " expect type=" << t << " key_size=" << ks
+            << " value_size=" << vs << " node_size=" << ns;
+        return false;
+    }
+    if(file_size != fs || bucket_count == 0
+            || values_offset + elements * value_size > buckets_offset
+            || buckets_offset + (bucket_count + 1) * sizeof(uint64_t) > nodes_offset
+            || nodes_offset + total * node_size > file_size) {
+        SYLAR_LOG_ERROR(g_logger) << "MmapDictHeader section error " << toString()
+            << " real_file_size=" << fs;
+        return false;
+    }
+    return true;
+}
+
+std::string MmapDictHeader::toString() const {
+    std::stringstream ss;
+    ss << "version=" << version
+       << " type=" << type
+       << " key_size=" << key_size
+       << " value_size=" << value_size
+       << " node_size=" << node_size
+       << " bucket_count=" << bucket_count
+       << " total=" << total
+       << " elements=" << elements
+       << " file_size=" << file_size
+       << " create_time=" << sylar::Time2Str(create_time);
+    return ss.str();
+}
+
+MmapFile::MmapFile()
+    :m_data(nullptr)
+    ,m_size(0) {
+}
+
+MmapFile::~MmapFile() {
+    close();
+}
+
+bool MmapFile::open(const std::string& path, bool populate) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        SYLAR_LOG_ERROR(g_logger) << "MmapFile open " << path << " fail errno="
+            << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) || st.st_size == 0) {
+        SYLAR_LOG_ERROR(g_logger) << "MmapFile fstat " << path << " fail errno="
+            << errno << " errstr=" << strerror(errno);
+        ::close(fd);
+        return false;
+    }
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    if(populate) {
+        flags |= MAP_POPULATE;
+    }
+#endif
+    void* data = mmap(nullptr, st.st_size, PROT_READ, flags, fd, 0);
+    ::close(fd);
+    if(data == MAP_FAILED) {
+        SYLAR_LOG_ERROR(g_logger) << "MmapFile mmap " << path << " fail errno="
+            << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    m_path = path;
+    m_data = (const char*)data;
+    m_size = st.st_size;
+    return true;
+}
+
+void MmapFile::close() {
+    if(m_data) {
+        munmap((void*)m_data, m_size);
+        m_data = nullptr;
+        m_size = 0;
+    }
+}
+
+MmapDictFileWriter::MmapDictFileWriter()
+    :m_file(nullptr)
+    ,m_offset(0)
+    ,m_crc(0) {
+}
+
+MmapDictFileWriter::~MmapDictFileWriter() {
+    abort();
+}
+
+bool MmapDictFileWriter::open(const std::string& path) {
+    abort();
+    m_path = path;
+    m_tmpPath = path + ".tmp";
+    m_file = fopen(m_tmpPath.c_str(), "wb");
+    if(!m_file) {
+        SYLAR_LOG_ERROR(g_logger) << "MmapDictFileWriter open " << m_tmpPath
+            << " fail errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    m_offset = 0;
+    m_crc = 0;
+    return true;
+}
+
+bool MmapDictFileWriter::write(const void* data, uint64_t size) {
+    if(!m_file) {
+        return false;
+    }
+    if(size == 0) {
+        return true;
+    }
+    if(fwrite(data, 1, size, m_file) != size) {
+        SYLAR_LOG_ERROR(g_logger) << "MmapDictFileWriter write " << m_tmpPath
+            << " fail errno=" << errno << " errstr=" << strerror(errno);
+        return false;
+    }
+    //header最后写入, 不计入data_crc
+    if(m_offset >= MmapDictHeader::PAGE_SIZE) {
+        m_crc = MmapDictCrc32(m_crc, data, size);
+    }
+    m_offset += size;
+    return true;
+}
+
+bool MmapDictFileWriter::padToPage() {
+    static const char s_zero[MmapDictHeader::PAGE_SIZE] = {0};
+    uint64_t pad = (MmapDictHeader::PAGE_SIZE - m_offset % MmapDictHeader::PAGE_SIZE)
+                    % MmapDictHeader::PAGE_SIZE;
+    if(m_offset == 0) {
+        //预留header页
+        if(fwrite(s_zero, 1, sizeof(s_zero), m_file) != sizeof(s_zero)) {
+            return false;
+        }
+        m_offset = MmapDictHeader::PAGE_SIZE;
+        return true;
+    }
+    return write(s_zero, pad);
+}
+
+bool MmapDictFileWriter::commit(MmapDictHeader& header) {
+    if(!m_file) {
+        return false;
+    }
+    header.file_size = m_offset;
+    header.data_crc = m_crc;
+    header.header_crc = header.calcHeaderCrc();
+    if(fflush(m_file)
+            || pwrite(fileno(m_file), &header, sizeof(header), 0) != sizeof(header)
+            || fsync(fileno(m_file))) {
+        SYLAR_LOG_ERROR(g_logger) << "MmapDictFileWriter commit " << m_tmpPath
+            << " fail errno=" << errno << " errstr=" << strerror(errno);
+        abort();
+        return false;
+    }
+    fclose(m_file);
+    m_file = nullptr;
+    if(rename(m_tmpPath.c_str(), m_path.c_str())) {
+        SYLAR_LOG_ERROR(g_logger) << "MmapDictFileWriter rename " << m_tmpPath
+            << " to " << m_path << " fail errno=" << errno << " errstr=" << strerror(errno);
+        unlink(m_tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void MmapDictFileWriter::abort() {
+    if(m_file) {
+        fclose(m_file);
+        m_file = nullptr;
+        unlink(m_tmpPath.c_str());
+    }
+}
+
+}
+}
@@ -0,0 +1,481 @@
+#ifndef __SYLAR_DS_MMAP_DICT_H__
+#define __SYLAR_DS_MMAP_DICT_H__
+
+#include "sylar/ds/util.h"
+#include "sylar/ds/dict.h"
+#include "sylar/ds/hash_multimap.h"
+#include "sylar/util.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <functional>
+#include <vector>
+
+namespace sylar {
+namespace ds {
+
+/**
+ * @brief mmap字典文件头, 位于文件起始, 占一页
+ * @details 文件布局(各段按页对齐):
+ *          [header][values: V[elements]][buckets: uint64_t[bucket_count + 1]][nodes: Node[total]]
+ *          buckets[i]..buckets[i+1]是第i个桶在nodes中的下标区间, 桶内按key有序;
+ *          Node记录key, 值个数和值在values中的下标.
+ *          data_crc为header之后全部数据的crc32, header_crc为header(header_crc置0)的crc32
+ */
+struct MmapDictHeader {
+    enum Type {
+        DICT = 1,
+        MULTIMAP = 2,
+        STRING_DICT = 3
+    };
+
+    static const uint32_t VERSION = 1;
+    static const uint32_t PAGE_SIZE = 4096;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t type;
+    uint32_t key_size;
+    uint32_t value_size;
+    uint32_t node_size;
+    uint32_t reserved;
+    uint64_t bucket_count;
+    uint64_t total;
+    uint64_t elements;
+    uint64_t values_offset;
+    uint64_t buckets_offset;
+    uint64_t nodes_offset;
+    uint64_t file_size;
+    uint64_t create_time;
+    uint32_t data_crc;
+    uint32_t header_crc;
+
+    void init();
+    bool check(uint32_t type, uint32_t key_size, uint32_t value_size
+               ,uint32_t node_size, uint64_t file_size) const;
+    uint32_t calcHeaderCrc() const;
+    std::string toString() const;
+};
+
+/**
+ * @brief 只读映射的文件
+ */
+class MmapFile {
+public:
+    typedef std::shared_ptr<MmapFile> ptr;
+    MmapFile();
+    ~MmapFile();
+
+    /**
+     * @brief 映射文件
+     * @param[in] populate 是否预读全部页面(MAP_POPULATE)
+     */
+    bool open(const std::string& path, bool populate = false);
+    void close();
+
+    const char* getData() const { return m_data;}
+    uint64_t getSize() const { return m_size;}
+    const std::string& getPath() const { return m_path;}
+private:
+    std::string m_path;
+    const char* m_data;
+    uint64_t m_size;
+};
+
+/**
+ * @brief mmap字典文件写入(流式写入values, 计算crc, 写临时文件后rename原子替换)
+ */
+class MmapDictFileWriter {
+public:
+    MmapDictFileWriter();
+    ~MmapDictFileWriter();
+
+    bool open(const std::string& path);
+    bool write(const void* data, uint64_t size);
+    bool padToPage();
+    uint64_t tell() const { return m_offset;}
+    /**
+     * @brief 写入header, fsync后rename到目标文件
+     */
+    bool commit(MmapDictHeader& header);
+    void abort();
+private:
+    std::string m_path;
+    std::string m_tmpPath;
+    FILE* m_file;
+    uint64_t m_offset;
+    uint32_t m_crc;
+};
+
+uint32_t MmapDictCrc32(uint32_t crc, const void* data, uint64_t size);
+
+/**
+ * @brief 可mmap的只读字典(Dict/HashMultimap的文件格式), 打开后原地查询, 无反序列化
+ * @details K, V必须是POD, PosHash需与写入时一致.
+ *          open只校验header(O(1)), verify=true时再校验全文件crc
+ */
+template<class K
+        ,class V
+        ,class PosHash = sylar::ds::Murmur3Hash<K>
+        >
+class MmapDict {
+public:
+    typedef std::shared_ptr<MmapDict> ptr;
+    typedef std::function<bool(const K& k, const V* v, size_t size)> callback;
+
+    struct Node {
+        K key;
+        uint32_t size;
+        uint64_t offset;
+
+        bool operator<(const Node& o) const {
+            return key < o.key;
+        }
+    };
+
+    /**
+     * @brief 写入构造器, add全部条目后commit
+     */
+    class Builder {
+    public:
+        Builder(uint32_t type = MmapDictHeader::DICT)
+            :m_type(type) {
+        }
+
+        bool open(const std::string& path) {
+            if(!m_writer.open(path)) {
+                return false;
+            }
+            return m_writer.padToPage();
+        }
+
+        /**
+         * @brief 添加一个key, key不能重复; MULTIMAP类型要求值有序
+         */
+        bool add(const K& k, const V* v, uint32_t size) {
+            Node n;
+            memset(&n, 0, sizeof(n));
+            n.key = k;
+            n.size = size;
+            n.offset = m_elements;
+            m_nodes.push_back(n);
+            m_elements += size;
+            return m_writer.write(v, sizeof(V) * size);
+        }
+
+        bool commit() {
+            MmapDictHeader header;
+            header.init();
+            header.type = m_type;
+            header.key_size = sizeof(K);
+            header.value_size = sizeof(V);
+            header.node_size = sizeof(Node);
+            header.total = m_nodes.size();
+            header.elements = m_elements;
+            header.values_offset = MmapDictHeader::PAGE_SIZE;
+
+            uint64_t bucket_count = 1;
+            while(bucket_count < m_nodes.size()) {
+                bucket_count <<= 1;
+            }
+            header.bucket_count = bucket_count;
+
+            std::vector<uint32_t> pos(m_nodes.size());
+            std::vector<uint64_t> buckets(bucket_count + 1, 0);
+            for(size_t i = 0; i < m_nodes.size(); ++i) {
+                pos[i] = m_hash(m_nodes[i].key) % bucket_count;
+                ++buckets[pos[i] + 1];
+            }
+            for(size_t i = 0; i < bucket_count; ++i) {
+                buckets[i + 1] += buckets[i];
+            }
+            std::vector<Node> nodes(m_nodes.size());
+            std::vector<uint64_t> cur(buckets.begin(), buckets.end() - 1);
+            for(size_t i = 0; i < m_nodes.size(); ++i) {
+                nodes[cur[pos[i]]++] = m_nodes[i];
+            }
+            for(size_t i = 0; i < bucket_count; ++i) {
+                std::sort(nodes.begin() + buckets[i], nodes.begin() + buckets[i + 1]);
+            }
+
+            if(!m_writer.padToPage()) {
+                return false;
+            }
+            header.buckets_offset = m_writer.tell();
+            if(!m_writer.write(&buckets[0], buckets.size() * sizeof(uint64_t))
+                    || !m_writer.padToPage()) {
+                return false;
+            }
+            header.nodes_offset = m_writer.tell();
+            if(!nodes.empty() && !m_writer.write(&nodes[0], nodes.size() * sizeof(Node))) {
+                return false;
+            }
+            return m_writer.commit(header);
+        }
+
+        uint64_t getTotal() const { return m_nodes.size();}
+        uint64_t getElements() const { return m_elements;}
+    private:
+        uint32_t m_type;
+        MmapDictFileWriter m_writer;
+        std::vector<Node> m_nodes;
+        uint64_t m_elements = 0;
+        PosHash m_hash;
+    };
+
+    MmapDict() {}
+
+    /**
+     * @brief 打开文件
+     * @param[in] verify 是否校验全文件crc
+     * @param[in] populate 是否预读全部页面
+     * @param[in] type 期望的文件类型, 0表示DICT或MULTIMAP均可
+     */
+    bool open(const std::string& path, bool verify = false, bool populate = false
+              ,uint32_t type = 0) {
+        MmapFile::ptr file(new MmapFile);
+        if(!file->open(path, populate)) {
+            return false;
+        }
+        if(file->getSize() < sizeof(MmapDictHeader)) {
+            return false;
+        }
+        const MmapDictHeader* header = (const MmapDictHeader*)file->getData();
+        if(!header->check(type, sizeof(K), sizeof(V), sizeof(Node), file->getSize())) {
+            return false;
+        }
+        if(verify && MmapDictCrc32(0, file->getData() + MmapDictHeader::PAGE_SIZE
+                        ,file->getSize() - MmapDictHeader::PAGE_SIZE) != header->data_crc) {
+            return false;
+        }
+        m_file = file;
+        m_header = header;
+        m_values = (const V*)(file->getData() + header->values_offset);
+        m_buckets = (const uint64_t*)(file->getData() + header->buckets_offset);
+        m_nodes = (const Node*)(file->getData() + header->nodes_offset);
+        return true;
+    }
+
+    /**
+     * @brief 零拷贝查找, 返回值数组指针(指向映射内存), 不存在返回nullptr
+     */
+    const V* find(const K& k, uint32_t& size) {
+        const Node* n = findNode(k);
+        if(!n) {
+            size = 0;
+            return nullptr;
+        }
+        size = n->size;
+        return m_values + n->offset;
+    }
+
+    SharedArray<V> get(const K& k, bool duplicate = true) {
+        const Node* n = findNode(k);
+        if(!n) {
+            return SharedArray<V>();
+        }
+        V* v = (V*)(m_values + n->offset);
+        if(duplicate) {
+            V* tmp = new V[n->size]();
+            memcpy(tmp, v, sizeof(V) * n->size);
+            return SharedArray<V>(n->size, tmp);
+        }
+        //持有文件引用, 映射在SharedArray释放前不会解除
+        MmapFile::ptr file = m_file;
+        return SharedArray<V>(n->size, v, [file](V*){});
+    }
+
+    bool get(const K& k, std::vector<V>& v) {
+        const Node* n = findNode(k);
+        if(!n) {
+            return false;
+        }
+        v.assign(m_values + n->offset, m_values + n->offset + n->size);
+        return true;
+    }
+
+    bool exists(const K& k) {
+        return findNode(k) != nullptr;
+    }
+
+    /**
+     * @brief MULTIMAP: 值是否存在(值数组有序, 二分查找)
+     */
+    bool exists(const K& k, const V& v) {
+        const Node* n = findNode(k);
+        if(!n) {
+            return false;
+        }
+        const V* begin = m_values + n->offset;
+        const V* end = begin + n->size;
+        return BinarySearch(begin, end, v) != end;
+    }
+
+    void foreach(callback cb) {
+        if(!m_header) {
+            return;
+        }
+        for(uint64_t i = 0; i < m_header->total; ++i) {
+            if(!cb(m_nodes[i].key, m_values + m_nodes[i].offset, m_nodes[i].size)) {
+                break;
+            }
+        }
+    }
+
+    uint64_t getTotal() const { return m_header ? m_header->total : 0;}
+    uint64_t getElements() const { return m_header ? m_header->elements : 0;}
+    const MmapDictHeader* getHeader() const { return m_header;}
+    MmapFile::ptr getFile() const { return m_file;}
+
+    std::ostream& dump(std::ostream& os) {
+        os << "[MmapDict " << (m_header ? m_header->toString() : "(not open)") << "]" << std::endl;
+        return os;
+    }
+
+    /**
+     * @brief 把Dict写成mmap文件
+     */
+    static bool Write(const std::string& path, Dict<K, V, PosHash>& dict) {
+        Builder builder(MmapDictHeader::DICT);
+        if(!builder.open(path)) {
+            return false;
+        }
+        bool ok = true;
+        dict.foreach([&builder, &ok](const K& k, const V* v, size_t size) {
+            ok = builder.add(k, v, size);
+            return ok;
+        });
+        return ok && builder.commit();
+    }
+
+    /**
+     * @brief 把HashMultimap写成mmap文件
+     */
+    static bool Write(const std::string& path, HashMultimap<K, V, PosHash>& dict) {
+        Builder builder(MmapDictHeader::MULTIMAP);
+        if(!builder.open(path)) {
+            return false;
+        }
+        bool ok = true;
+        dict.rforeach([&builder, &ok](const K& k, const V* v, int size) {
+            ok = builder.add(k, v, size);
+            return ok;
+        });
+        return ok && builder.commit();
+    }
+private:
+    const Node* findNode(const K& k) {
+        if(!m_header) {
+            return nullptr;
+        }
+        uint64_t pos = m_hash(k) % m_header->bucket_count;
+        const Node* begin = m_nodes + m_buckets[pos];
+        const Node* end = m_nodes + m_buckets[pos + 1];
+        Node tmp;
+        tmp.key = k;
+        auto it = BinarySearch(begin, end, tmp);
+        return it == end ? nullptr : it;
+    }
+private:
+    MmapFile::ptr m_file;
+    const MmapDictHeader* m_header = nullptr;
+    const V* m_values = nullptr;
+    const uint64_t* m_buckets = nullptr;
+    const Node* m_nodes = nullptr;
+    PosHash m_hash;
+};
+
+template<class K, class V, class PosHash = sylar::ds::Murmur3Hash<K> >
+using MmapMultimap = MmapDict<K, V, PosHash>;
+
+/**
+ * @brief StringDict的mmap版本
+ */
+class MmapStringDict {
+public:
+    typedef std::shared_ptr<MmapStringDict> ptr;
+    typedef MmapDict<uint64_t, char> dict_type;
+
+    bool open(const std::string& path, bool verify = false, bool populate = false) {
+        return m_dict.open(path, verify, populate, MmapDictHeader::STRING_DICT);
+    }
+
+    std::string get(const uint64_t& id) {
+        uint32_t size = 0;
+        const char* v = m_dict.find(id, size);
+        return v ? std::string(v, size) : std::string();
+    }
+
+    const char* find(const uint64_t& id, uint32_t& size) {
+        return m_dict.find(id, size);
+    }
+
+    SharedArray<char> getRaw(const uint64_t& id, bool duplicate = true) {
+        return m_dict.get(id, duplicate);
+    }
+
+    void foreach(std::function<bool(const uint64_t& k, const char* v, size_t size)> cb) {
+        m_dict.foreach(cb);
+    }
+
+    uint64_t getTotal() const { return m_dict.getTotal();}
+
+    std::ostream& dump(std::ostream& os) {
+        return m_dict.dump(os);
+    }
+
+    static bool Write(const std::string& path, StringDict& dict) {
+        dict_type::Builder builder(MmapDictHeader::STRING_DICT);
+        if(!builder.open(path)) {
+            return false;
+        }
+        bool ok = true;
+        dict.foreach([&builder, &ok](const uint64_t& k, const char* v, size_t size) {
+            ok = builder.add(k, v, size);
+            return ok;
+        });
+        return ok && builder.commit();
+    }
+private:
+    dict_type m_dict;
+};
+
+/**
+ * @brief 字典热替换
+ * @details 读者get()得到当前字典的shared_ptr后无锁查询; load()在后台打开新文件,
+ *          成功后原子替换, 旧字典在最后一个读者释放后解除映射. 读者不会被阻塞
+ */
+template<class T>
+class HotSwapDict {
+public:
+    typedef std::shared_ptr<HotSwapDict> ptr;
+    typedef std::shared_ptr<T> dict_ptr;
+
+    dict_ptr get() const {
+        return std::atomic_load(&m_dict);
+    }
+
+    void set(dict_ptr v) {
+        std::atomic_store(&m_dict, v);
+    }
+
+    /**
+     * @brief 打开新文件并替换当前字典, 失败时保留当前字典
+     */
+    bool load(const std::string& path, bool verify = true, bool populate = false) {
+        dict_ptr dict(new T);
+        if(!dict->open(path, verify, populate)) {
+            return false;
+        }
+        set(dict);
+        return true;
+    }
+private:
+    dict_ptr m_dict;
+};
+
+}
+}
+
+#endif
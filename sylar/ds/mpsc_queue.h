@@ -0,0 +1,97 @@
+#ifndef __SYLAR_DS_MPSC_QUEUE_H__
+#define __SYLAR_DS_MPSC_QUEUE_H__
+
+#include <atomic>
+#include <stddef.h>
+
+namespace sylar {
+namespace ds {
+
+/**
+ * @brief 侵入式无锁多生产者单消费者队列(Vyukov)
+ * @details T需要可默认构造, 且包含成员 std::atomic<T*> next.
+ *          push/pushChain可在任意线程调用, 入队只有一次原子交换;
+ *          pop/empty只能在唯一的消费者线程调用. 队列不持有节点的所有权.
+ *          生产者交换尾指针后、链接前一节点前的瞬间, pop返回nullptr但empty()为false,
+ *          消费者需要稍后重试
+ */
+template<class T>
+class MpscQueue {
+public:
+    MpscQueue()
+        :m_head(&m_stub)
+        ,m_tail(&m_stub) {
+        m_stub.next.store(nullptr, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 入队一个节点
+     */
+    void push(T* node) {
+        pushChain(node, node);
+    }
+
+    /**
+     * @brief 入队已经用next串好的一串节点 [first, last]
+     * @details 整串只需要一次原子交换, 且串内节点保持顺序
+     */
+    void pushChain(T* first, T* last) {
+        last->next.store(nullptr, std::memory_order_relaxed);
+        T* prev = m_head.exchange(last, std::memory_order_acq_rel);
+        prev->next.store(first, std::memory_order_release);
+    }
+
+    /**
+     * @brief 出队, 没有可取的节点返回nullptr
+     */
+    T* pop() {
+        T* tail = m_tail;
+        T* next = tail->next.load(std::memory_order_acquire);
+        if(tail == &m_stub) {
+            if(!next) {
+                return nullptr;
+            }
+            m_tail = next;
+            tail = next;
+            next = next->next.load(std::memory_order_acquire);
+        }
+        if(next) {
+            m_tail = next;
+            return tail;
+        }
+        if(tail != m_head.load(std::memory_order_acquire)) {
+            //生产者正在链接
+            return nullptr;
+        }
+        push(&m_stub);
+        next = tail->next.load(std::memory_order_acquire);
+        if(next) {
+            m_tail = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief 队列是否为空, 有生产者尚未完成链接时返回false
+     */
+    bool empty() const {
+        return m_tail == &m_stub
+            && m_head.load(std::memory_order_acquire) == &m_stub;
+    }
+private:
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+private:
+    /// 最后入队的节点, 生产者竞争
+    std::atomic<T*> m_head;
+    char m_pad[64 - sizeof(std::atomic<T*>)];
+    /// 下一个出队的节点, 仅消费者访问
+    T* m_tail;
+    T m_stub;
+};
+
+}
+}
+
+#endif
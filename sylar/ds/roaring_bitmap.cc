@@ -1,8 +1,10 @@
 #include "roaring_bitmap.h"
+#include "mmap_dict.h"
 #include <math.h>
 #include <string.h>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 #include "sylar/log.h"
 #include "sylar/macro.h"
 
@@ -47,6 +49,119 @@ bool RoaringBitmap::readFrom(sylar::ByteArray::ptr ba) {
     return false;
 }
 
+bool RoaringBitmap::readFrom(const char* buf, size_t size) {
+    try {
+        Roaring tmp = Roaring::read(buf, false);
+        if(tmp.getSizeInBytes(false) != size) {
+            return false;
+        }
+        m_bitmap.swap(tmp);
+        return true;
+    } catch(...) {
+    }
+    return false;
+}
+
+size_t RoaringBitmap::getPortableSize() const {
+    return m_bitmap.getSizeInBytes(true);
+}
+
+uint64_t RoaringBitmap::writeTo(std::vector<iovec>& iovs, std::string& buffer) const {
+    //与ra_portable_serialize的格式一致, 头部写入buffer, container数据直接引用
+    const roaring_array_t& ra = m_bitmap.roaring.high_low_container;
+    int32_t size = ra.size;
+    int32_t run_count = 0;
+    for(int32_t i = 0; i < size; ++i) {
+        uint8_t type = ra.typecodes[i];
+        container_unwrap_shared(ra.containers[i], &type);
+        run_count += (type == RUN_CONTAINER_TYPE_CODE);
+    }
+    bool hasrun = run_count > 0;
+    uint32_t run_bytes = (size + 7) / 8;
+    uint32_t header = 0;
+    if(hasrun) {
+        header = 4 + run_bytes + 4 * size + (size >= NO_OFFSET_THRESHOLD ? 4 * size : 0);
+    } else {
+        header = 8 + 8 * size;
+    }
+    buffer.assign(header + 2 * run_count, 0);
+    char* buf = &buffer[0];
+    char* pos = buf;
+    if(hasrun) {
+        uint32_t cookie = SERIAL_COOKIE | ((size - 1) << 16);
+        memcpy(pos, &cookie, 4);
+        pos += 4;
+        for(int32_t i = 0; i < size; ++i) {
+            uint8_t type = ra.typecodes[i];
+            container_unwrap_shared(ra.containers[i], &type);
+            if(type == RUN_CONTAINER_TYPE_CODE) {
+                pos[i / 8] |= (1 << (i % 8));
+            }
+        }
+        pos += run_bytes;
+    } else {
+        uint32_t cookie = SERIAL_COOKIE_NO_RUNCONTAINER;
+        memcpy(pos, &cookie, 4);
+        memcpy(pos + 4, &size, 4);
+        pos += 8;
+    }
+    for(int32_t i = 0; i < size; ++i) {
+        uint16_t card = container_get_cardinality(ra.containers[i], ra.typecodes[i]) - 1;
+        memcpy(pos, &ra.keys[i], 2);
+        memcpy(pos + 2, &card, 2);
+        pos += 4;
+    }
+    uint64_t total = header;
+    if(!hasrun || size >= NO_OFFSET_THRESHOLD) {
+        uint32_t offset = header;
+        for(int32_t i = 0; i < size; ++i) {
+            memcpy(pos, &offset, 4);
+            pos += 4;
+            offset += container_size_in_bytes(ra.containers[i], ra.typecodes[i]);
+        }
+    }
+
+    iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = header;
+    iovs.push_back(iov);
+    char* run_prefix = buf + header;
+    for(int32_t i = 0; i < size; ++i) {
+        uint8_t type = ra.typecodes[i];
+        const void* c = container_unwrap_shared(ra.containers[i], &type);
+        switch(type) {
+            case BITSET_CONTAINER_TYPE_CODE:
+                iov.iov_base = ((const bitset_container_t*)c)->array;
+                iov.iov_len = BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t);
+                break;
+            case ARRAY_CONTAINER_TYPE_CODE:
+                iov.iov_base = ((const array_container_t*)c)->array;
+                iov.iov_len = ((const array_container_t*)c)->cardinality * sizeof(uint16_t);
+                break;
+            case RUN_CONTAINER_TYPE_CODE: {
+                    const run_container_t* run = (const run_container_t*)c;
+                    uint16_t n = run->n_runs;
+                    memcpy(run_prefix, &n, 2);
+                    iov.iov_base = run_prefix;
+                    iov.iov_len = 2;
+                    iovs.push_back(iov);
+                    total += 2;
+                    run_prefix += 2;
+                    iov.iov_base = run->runs;
+                    iov.iov_len = run->n_runs * sizeof(rle16_t);
+                }
+                break;
+            default:
+                continue;
+        }
+        if(iov.iov_len) {
+            iovs.push_back(iov);
+            total += iov.iov_len;
+        }
+    }
+    return total;
+}
+
 RoaringBitmap& RoaringBitmap::operator=(const RoaringBitmap& b) {
     if(this == &b) {
         return *this;
@@ -78,6 +193,21 @@ RoaringBitmap& RoaringBitmap::operator^=(const RoaringBitmap& b) {
     return *this;
 }
 
+RoaringBitmap& RoaringBitmap::operator&=(const RoaringBitmapView& b) {
+    roaring_bitmap_and_inplace(&m_bitmap.roaring, b.m_bitmap);
+    return *this;
+}
+
+RoaringBitmap& RoaringBitmap::operator|=(const RoaringBitmapView& b) {
+    roaring_bitmap_or_inplace(&m_bitmap.roaring, b.m_bitmap);
+    return *this;
+}
+
+RoaringBitmap& RoaringBitmap::operator-=(const RoaringBitmapView& b) {
+    roaring_bitmap_andnot_inplace(&m_bitmap.roaring, b.m_bitmap);
+    return *this;
+}
+
 bool RoaringBitmap::operator== (const RoaringBitmap& b) const {
     if(this == &b) {
         return true;
@@ -187,5 +317,291 @@ uint32_t RoaringBitmap::getCount() const {
     return m_bitmap.cardinality();
 }
 
+uint64_t RoaringBitmap::andCount(const RoaringBitmap& b) const {
+    return m_bitmap.and_cardinality(b.m_bitmap);
+}
+
+RoaringBitmap::ptr RoaringBitmap::And(const std::vector<RoaringBitmap::ptr>& bs) {
+    if(bs.empty()) {
+        return RoaringBitmap::ptr(new RoaringBitmap);
+    }
+    std::vector<std::pair<uint64_t, RoaringBitmap*> > tmp;
+    for(auto& i : bs) {
+        tmp.push_back(std::make_pair(i->m_bitmap.cardinality(), i.get()));
+    }
+    std::sort(tmp.begin(), tmp.end());
+    RoaringBitmap::ptr rt(new RoaringBitmap(*tmp[0].second));
+    for(size_t i = 1; i < tmp.size() && !rt->m_bitmap.isEmpty(); ++i) {
+        rt->m_bitmap &= tmp[i].second->m_bitmap;
+    }
+    return rt;
+}
+
+RoaringBitmap::ptr RoaringBitmap::Or(const std::vector<RoaringBitmap::ptr>& bs) {
+    std::vector<const Roaring*> tmp;
+    for(auto& i : bs) {
+        tmp.push_back(&i->m_bitmap);
+    }
+    if(tmp.empty()) {
+        return RoaringBitmap::ptr(new RoaringBitmap);
+    }
+    return RoaringBitmap::ptr(new RoaringBitmap(Roaring::fastunion(tmp.size(), tmp.data())));
+}
+
+namespace {
+
+template<class T>
+bool CheckAlign(const char* p) {
+#if defined(__x86_64__) || defined(__i386__)
+    return true;
+#else
+    return ((uintptr_t)p % alignof(T)) == 0;
+#endif
+}
+
+//在portable格式数据上构造frozen的roaring_bitmap_t, container指向buf, 与roaring_bitmap_frozen_view相同,
+//描述结构分配在以roaring_bitmap_t开头的一块内存中, roaring_bitmap_free只释放这块内存
+roaring_bitmap_t* PortableView(const char* buf, size_t maxbytes, size_t& readbytes, bool& aligned) {
+    aligned = true;
+    const char* end = buf + maxbytes;
+    const char* p = buf;
+    if(maxbytes < 4) {
+        return nullptr;
+    }
+    uint32_t cookie = 0;
+    memcpy(&cookie, p, 4);
+    p += 4;
+    int32_t size = 0;
+    bool hasrun = false;
+    const uint8_t* runs = nullptr;
+    if((cookie & 0xFFFF) == SERIAL_COOKIE) {
+        hasrun = true;
+        size = (cookie >> 16) + 1;
+        size_t s = (size + 7) / 8;
+        if((size_t)(end - p) < s) {
+            return nullptr;
+        }
+        runs = (const uint8_t*)p;
+        p += s;
+    } else if(cookie == SERIAL_COOKIE_NO_RUNCONTAINER) {
+        if(end - p < 4) {
+            return nullptr;
+        }
+        memcpy(&size, p, 4);
+        p += 4;
+    } else {
+        return nullptr;
+    }
+    if(size < 0 || size > (1 << 16) || (size_t)(end - p) < 4 * (size_t)size) {
+        return nullptr;
+    }
+    const char* keycards = p;
+    p += 4 * size;
+    if(!hasrun || size >= NO_OFFSET_THRESHOLD) {
+        if((size_t)(end - p) < 4 * (size_t)size) {
+            return nullptr;
+        }
+        p += 4 * size;
+    }
+
+    size_t alloc_size = sizeof(roaring_bitmap_t) + size * sizeof(void*)
+                        + size * sizeof(array_container_t)
+                        + size * sizeof(uint16_t) + size;
+    char* arena = (char*)malloc(alloc_size);
+    if(!arena) {
+        return nullptr;
+    }
+    roaring_bitmap_t* rb = (roaring_bitmap_t*)arena;
+    void** containers = (void**)(arena + sizeof(roaring_bitmap_t));
+    char* structs = (char*)(containers + size);
+    uint16_t* keys = (uint16_t*)(structs + size * sizeof(array_container_t));
+    uint8_t* typecodes = (uint8_t*)(keys + size);
+
+    for(int32_t i = 0; i < size; ++i) {
+        uint16_t card_minus_one = 0;
+        memcpy(&keys[i], keycards + 4 * i, 2);
+        memcpy(&card_minus_one, keycards + 4 * i + 2, 2);
+        int32_t card = card_minus_one + 1;
+        void* c = structs + i * sizeof(array_container_t);
+        containers[i] = c;
+        if(hasrun && (runs[i / 8] & (1 << (i % 8)))) {
+            uint16_t n = 0;
+            if(end - p < 2) {
+                free(arena);
+                return nullptr;
+            }
+            memcpy(&n, p, 2);
+            p += 2;
+            if((size_t)(end - p) < n * sizeof(rle16_t)) {
+                free(arena);
+                return nullptr;
+            }
+            aligned = aligned && CheckAlign<rle16_t>(p);
+            run_container_t* run = (run_container_t*)c;
+            run->n_runs = n;
+            run->capacity = n;
+            run->runs = (rle16_t*)p;
+            typecodes[i] = RUN_CONTAINER_TYPE_CODE;
+            p += n * sizeof(rle16_t);
+        } else if(card > DEFAULT_MAX_SIZE) {
+            size_t len = BITSET_CONTAINER_SIZE_IN_WORDS * sizeof(uint64_t);
+            if((size_t)(end - p) < len) {
+                free(arena);
+                return nullptr;
+            }
+            aligned = aligned && CheckAlign<uint64_t>(p);
+            bitset_container_t* bitset = (bitset_container_t*)c;
+            bitset->cardinality = card;
+            bitset->array = (uint64_t*)p;
+            typecodes[i] = BITSET_CONTAINER_TYPE_CODE;
+            p += len;
+        } else {
+            size_t len = card * sizeof(uint16_t);
+            if((size_t)(end - p) < len) {
+                free(arena);
+                return nullptr;
+            }
+            aligned = aligned && CheckAlign<uint16_t>(p);
+            array_container_t* array = (array_container_t*)c;
+            array->cardinality = card;
+            array->capacity = card;
+            array->array = (uint16_t*)p;
+            typecodes[i] = ARRAY_CONTAINER_TYPE_CODE;
+            p += len;
+        }
+    }
+    if(!aligned) {
+        free(arena);
+        return nullptr;
+    }
+    rb->high_low_container.flags = ROARING_FLAG_FROZEN;
+    rb->high_low_container.size = size;
+    rb->high_low_container.allocation_size = size;
+    rb->high_low_container.containers = containers;
+    rb->high_low_container.keys = keys;
+    rb->high_low_container.typecodes = typecodes;
+    readbytes = p - buf;
+    return rb;
+}
+
+bool ViewIterator(uint32_t value, void* param) {
+    return (*(std::function<bool(uint32_t)>*)param)(value);
+}
+
+}
+
+RoaringBitmapView::RoaringBitmapView()
+    :m_bitmap(nullptr)
+    ,m_size(0) {
+}
+
+RoaringBitmapView::~RoaringBitmapView() {
+    if(m_bitmap) {
+        roaring_bitmap_free(m_bitmap);
+    }
+}
+
+RoaringBitmapView::ptr RoaringBitmapView::Create(const char* buf, size_t size
+                                                 ,std::shared_ptr<void> holder) {
+    RoaringBitmapView::ptr rt(new RoaringBitmapView);
+    bool aligned = true;
+    rt->m_bitmap = PortableView(buf, size, rt->m_size, aligned);
+    if(!rt->m_bitmap) {
+        if(aligned) {
+            return nullptr;
+        }
+        roaring_bitmap_t* r = roaring_bitmap_portable_deserialize_safe(buf, size);
+        if(!r) {
+            return nullptr;
+        }
+        rt->m_bitmap = r;
+        rt->m_size = roaring_bitmap_portable_size_in_bytes(r);
+        return rt;
+    }
+    rt->m_holder = holder;
+    return rt;
+}
+
+RoaringBitmapView::ptr RoaringBitmapView::Create(sylar::ByteArray::ptr ba, size_t size) {
+    std::vector<iovec> iovs;
+    size_t position = ba->getPosition();
+    size = std::min(size, (size_t)ba->getReadSize());
+    ba->getReadBuffers(iovs, size);
+    RoaringBitmapView::ptr rt;
+    if(iovs.size() == 1) {
+        rt = Create((const char*)iovs[0].iov_base, iovs[0].iov_len, ba);
+    } else {
+        std::shared_ptr<char> buf((char*)malloc(size), free);
+        ba->read(buf.get(), size);
+        ba->setPosition(position);
+        rt = Create(buf.get(), size, buf);
+    }
+    if(rt) {
+        ba->setPosition(position + rt->m_size);
+    }
+    return rt;
+}
+
+RoaringBitmapView::ptr RoaringBitmapView::Load(const std::string& path) {
+    MmapFile::ptr file(new MmapFile);
+    if(!file->open(path)) {
+        return nullptr;
+    }
+    return Create(file->getData(), file->getSize(), file);
+}
+
+bool RoaringBitmapView::get(uint32_t idx) const {
+    return roaring_bitmap_contains(m_bitmap, idx);
+}
+
+uint32_t RoaringBitmapView::getCount() const {
+    return roaring_bitmap_get_cardinality(m_bitmap);
+}
+
+bool RoaringBitmapView::any() const {
+    return !roaring_bitmap_is_empty(m_bitmap);
+}
+
+void RoaringBitmapView::foreach(std::function<bool(uint32_t)> cb) const {
+    roaring_iterate(m_bitmap, ViewIterator, &cb);
+}
+
+void RoaringBitmapView::listPosAsc(std::vector<uint32_t>& pos) const {
+    size_t size = pos.size();
+    pos.resize(size + getCount());
+    roaring_bitmap_to_uint32_array(m_bitmap, pos.data() + size);
+}
+
+bool RoaringBitmapView::cross(const RoaringBitmap& b) const {
+    return roaring_bitmap_intersect(m_bitmap, &b.m_bitmap.roaring);
+}
+
+uint64_t RoaringBitmapView::andCount(const RoaringBitmap& b) const {
+    return roaring_bitmap_and_cardinality(m_bitmap, &b.m_bitmap.roaring);
+}
+
+uint64_t RoaringBitmapView::andCount(const RoaringBitmapView& b) const {
+    return roaring_bitmap_and_cardinality(m_bitmap, b.m_bitmap);
+}
+
+RoaringBitmap::ptr RoaringBitmapView::toBitmap() const {
+    RoaringBitmap::ptr rt(new RoaringBitmap);
+    *rt |= *this;
+    return rt;
+}
+
+bool RoaringBitmapView::isZeroCopy() const {
+    return m_bitmap && (m_bitmap->high_low_container.flags & ROARING_FLAG_FROZEN);
+}
+
+std::string RoaringBitmapView::toString() const {
+    std::stringstream ss;
+    ss << "[RoaringBitmapView count=" << getCount()
+       << " size=" << m_size
+       << " zero_copy=" << isZeroCopy()
+       << "]";
+    return ss.str();
+}
+
 }
 }
@@ -6,13 +6,17 @@
 #include <vector>
 #include <memory>
 #include <functional>
+#include <sys/uio.h>
 #include "sylar/bytearray.h"
 #include "roaring.hh"
 
 namespace sylar {
 namespace ds {
 
+class RoaringBitmapView;
+
 class RoaringBitmap {
+friend class RoaringBitmapView;
 public:
     typedef std::shared_ptr<RoaringBitmap> ptr;
 
@@ -35,6 +39,10 @@ public:
     RoaringBitmap& operator-=(const RoaringBitmap& b);
     RoaringBitmap& operator^=(const RoaringBitmap& b);
 
+    RoaringBitmap& operator&=(const RoaringBitmapView& b);
+    RoaringBitmap& operator|=(const RoaringBitmapView& b);
+    RoaringBitmap& operator-=(const RoaringBitmapView& b);
+
     RoaringBitmap operator& (const RoaringBitmap& b);
     RoaringBitmap operator| (const RoaringBitmap& b);
     RoaringBitmap operator- (const RoaringBitmap& b);
@@ -57,6 +65,23 @@ public:
 
     void writeTo(sylar::ByteArray::ptr ba) const;
     bool readFrom(sylar::ByteArray::ptr ba);
+    /**
+     * @brief 从内存反序列化writeTo写入的数据(不含长度前缀), 可直接用于mmap的内存
+     */
+    bool readFrom(const char* buf, size_t size);
+
+    /**
+     * @brief portable格式序列化后的大小
+     */
+    size_t getPortableSize() const;
+    /**
+     * @brief 按portable格式输出为iovec, 用于writev, 不复制container数据
+     * @param[out] iovs 追加的iovec, 指向buffer和bitmap内部内存, 发送完成前bitmap不能修改
+     * @param[out] buffer 存放头部等元数据
+     * @return 总字节数
+     * @details iovec个数约为container个数, 超过IOV_MAX时需分批发送
+     */
+    uint64_t writeTo(std::vector<iovec>& iovs, std::string& buffer) const;
 
     //uncompress to compress
     //uncompress to uncompress
@@ -65,6 +90,17 @@ public:
     float getCompressRate() const;
 
     uint32_t getCount() const;
+
+    uint64_t andCount(const RoaringBitmap& b) const;
+
+    /**
+     * @brief 多路交集, 按基数从小到大计算, 结果为空时提前结束
+     */
+    static RoaringBitmap::ptr And(const std::vector<RoaringBitmap::ptr>& bs);
+    /**
+     * @brief 多路并集(roaring_bitmap_or_many)
+     */
+    static RoaringBitmap::ptr Or(const std::vector<RoaringBitmap::ptr>& bs);
 public:
     typedef RoaringSetBitForwardIterator iterator;
     typedef RoaringSetBitReverseIterator reverse_iterator;
@@ -81,6 +117,66 @@ private:
     Roaring m_bitmap;
 };
 
+/**
+ * @brief portable格式RoaringBitmap的只读视图
+ * @details container直接指向输入内存(mmap的文件, 收到的ByteArray等), 不复制数据,
+ *          只为container描述结构分配一块内存. 输入内存在视图释放前必须有效且不被修改,
+ *          holder用于保活. 非x86平台数据未按container对齐时退化为复制反序列化
+ */
+class RoaringBitmapView {
+friend class RoaringBitmap;
+public:
+    typedef std::shared_ptr<RoaringBitmapView> ptr;
+
+    ~RoaringBitmapView();
+
+    /**
+     * @brief 在内存上创建视图
+     * @param[in] size 可读的最大字节数
+     * @return 数据无效时返回nullptr
+     */
+    static RoaringBitmapView::ptr Create(const char* buf, size_t size
+                                         ,std::shared_ptr<void> holder = nullptr);
+    /**
+     * @brief 在ByteArray当前位置创建视图并移动读位置
+     * @details 数据在同一内存块内时零拷贝(视图持有ba), 跨块时复制到连续内存
+     */
+    static RoaringBitmapView::ptr Create(sylar::ByteArray::ptr ba, size_t size);
+    /**
+     * @brief mmap文件(整个文件为一个portable格式bitmap)
+     */
+    static RoaringBitmapView::ptr Load(const std::string& path);
+
+    bool get(uint32_t idx) const;
+    uint32_t getCount() const;
+    bool any() const;
+
+    void foreach(std::function<bool(uint32_t)> cb) const;
+    void listPosAsc(std::vector<uint32_t>& pos) const;
+
+    bool cross(const RoaringBitmap& b) const;
+    uint64_t andCount(const RoaringBitmap& b) const;
+    uint64_t andCount(const RoaringBitmapView& b) const;
+
+    /**
+     * @brief 复制为可修改的RoaringBitmap
+     */
+    RoaringBitmap::ptr toBitmap() const;
+
+    /**
+     * @brief 序列化数据占用的字节数
+     */
+    size_t getSizeInBytes() const { return m_size;}
+    bool isZeroCopy() const;
+    std::string toString() const;
+private:
+    RoaringBitmapView();
+private:
+    const roaring_bitmap_t* m_bitmap;
+    size_t m_size;
+    std::shared_ptr<void> m_holder;
+};
+
 }
 }
 
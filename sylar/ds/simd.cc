@@ -0,0 +1,244 @@
+#include "simd.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SYLAR_DS_SIMD_X86 1
+#endif
+
+namespace sylar {
+namespace ds {
+namespace simd {
+
+namespace {
+
+typedef uint64_t (*binary_func)(uint64_t* dst, const uint64_t* src, size_t n);
+typedef uint64_t (*popcount_func)(const uint64_t* src, size_t n, uint64_t mask);
+
+struct Ops {
+    Level level;
+    binary_func and_;
+    binary_func or_;
+    binary_func xor_;
+    binary_func andnot_;
+    popcount_func popcount;
+};
+
+#define XX(name, expr) \
+    uint64_t name##_scalar(uint64_t* dst, const uint64_t* src, size_t n) { \
+        uint64_t r = 0; \
+        for(size_t i = 0; i < n; ++i) { \
+            uint64_t a = dst[i]; \
+            uint64_t b = src[i]; \
+            dst[i] = expr; \
+            r |= dst[i]; \
+        } \
+        return r; \
+    }
+
+XX(and, a & b);
+XX(or, a | b);
+XX(xor, a ^ b);
+XX(andnot, a & ~b);
+#undef XX
+
+uint64_t popcount_scalar(const uint64_t* src, size_t n, uint64_t mask) {
+    uint64_t r = 0;
+    for(size_t i = 0; i < n; ++i) {
+        r += __builtin_popcountll(src[i] & mask);
+    }
+    return r;
+}
+
+#ifdef SYLAR_DS_SIMD_X86
+
+#define XX(name, expr) \
+    __attribute__((target("avx2"))) \
+    uint64_t name##_avx2(uint64_t* dst, const uint64_t* src, size_t n) { \
+        __m256i acc = _mm256_setzero_si256(); \
+        size_t i = 0; \
+        for(; i + 8 <= n; i += 8) { \
+            __m256i a0 = _mm256_loadu_si256((const __m256i*)(dst + i)); \
+            __m256i b0 = _mm256_loadu_si256((const __m256i*)(src + i)); \
+            __m256i a1 = _mm256_loadu_si256((const __m256i*)(dst + i + 4)); \
+            __m256i b1 = _mm256_loadu_si256((const __m256i*)(src + i + 4)); \
+            __m256i r0 = expr(a0, b0); \
+            __m256i r1 = expr(a1, b1); \
+            _mm256_storeu_si256((__m256i*)(dst + i), r0); \
+            _mm256_storeu_si256((__m256i*)(dst + i + 4), r1); \
+            acc = _mm256_or_si256(acc, _mm256_or_si256(r0, r1)); \
+        } \
+        uint64_t r = !_mm256_testz_si256(acc, acc); \
+        return r | name##_scalar(dst + i, src + i, n - i); \
+    }
+
+#define AVX2_ANDNOT(a, b) _mm256_andnot_si256(b, a)
+XX(and, _mm256_and_si256);
+XX(or, _mm256_or_si256);
+XX(xor, _mm256_xor_si256);
+XX(andnot, AVX2_ANDNOT);
+#undef AVX2_ANDNOT
+#undef XX
+
+//按半字节查表统计(Mula), vpsadbw横向累加到64位
+__attribute__((target("avx2")))
+uint64_t popcount_avx2(const uint64_t* src, size_t n, uint64_t mask) {
+    const __m256i lookup = _mm256_setr_epi8(
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    const __m256i m = _mm256_set1_epi64x(mask);
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(src + i)), m);
+        __m256i lo = _mm256_and_si256(v, low);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+        __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo)
+                                     ,_mm256_shuffle_epi8(lookup, hi));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+    }
+    uint64_t r = (uint64_t)_mm256_extract_epi64(acc, 0)
+               + (uint64_t)_mm256_extract_epi64(acc, 1)
+               + (uint64_t)_mm256_extract_epi64(acc, 2)
+               + (uint64_t)_mm256_extract_epi64(acc, 3);
+    return r + popcount_scalar(src + i, n - i, mask);
+}
+
+#define XX(name, expr) \
+    __attribute__((target("avx512f"))) \
+    uint64_t name##_avx512(uint64_t* dst, const uint64_t* src, size_t n) { \
+        __m512i acc = _mm512_setzero_si512(); \
+        size_t i = 0; \
+        for(; i + 16 <= n; i += 16) { \
+            __m512i a0 = _mm512_loadu_si512((const void*)(dst + i)); \
+            __m512i b0 = _mm512_loadu_si512((const void*)(src + i)); \
+            __m512i a1 = _mm512_loadu_si512((const void*)(dst + i + 8)); \
+            __m512i b1 = _mm512_loadu_si512((const void*)(src + i + 8)); \
+            __m512i r0 = expr(a0, b0); \
+            __m512i r1 = expr(a1, b1); \
+            _mm512_storeu_si512((void*)(dst + i), r0); \
+            _mm512_storeu_si512((void*)(dst + i + 8), r1); \
+            acc = _mm512_or_si512(acc, _mm512_or_si512(r0, r1)); \
+        } \
+        uint64_t r = _mm512_test_epi64_mask(acc, acc) != 0; \
+        return r | name##_avx2(dst + i, src + i, n - i); \
+    }
+
+//gcc12的_mm512_andnot_si512在-O2下会触发未初始化告警, 改用xor取反
+#define AVX512_ANDNOT(a, b) _mm512_and_si512(a, _mm512_xor_si512(b, _mm512_set1_epi64(-1)))
+XX(and, _mm512_and_si512);
+XX(or, _mm512_or_si512);
+XX(xor, _mm512_xor_si512);
+XX(andnot, AVX512_ANDNOT);
+#undef AVX512_ANDNOT
+#undef XX
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+uint64_t popcount_avx512(const uint64_t* src, size_t n, uint64_t mask) {
+    const __m512i m = _mm512_set1_epi64(mask);
+    __m512i acc = _mm512_setzero_si512();
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m512i v = _mm512_and_si512(_mm512_loadu_si512((const void*)(src + i)), m);
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(v));
+    }
+    uint64_t tmp[8];
+    _mm512_storeu_si512((void*)tmp, acc);
+    uint64_t r = 0;
+    for(int x = 0; x < 8; ++x) {
+        r += tmp[x];
+    }
+    return r + popcount_scalar(src + i, n - i, mask);
+}
+
+#endif
+
+const Ops s_ops[] = {
+    {SCALAR, and_scalar, or_scalar, xor_scalar, andnot_scalar, popcount_scalar},
+#ifdef SYLAR_DS_SIMD_X86
+    {AVX2, and_avx2, or_avx2, xor_avx2, andnot_avx2, popcount_avx2},
+    {AVX512, and_avx512, or_avx512, xor_avx512, andnot_avx512, popcount_avx512},
+#endif
+};
+
+Level DetectLevel() {
+#ifdef SYLAR_DS_SIMD_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")
+            && __builtin_cpu_supports("avx512vpopcntdq")) {
+        return AVX512;
+    }
+    if(__builtin_cpu_supports("avx2")) {
+        return AVX2;
+    }
+#endif
+    return SCALAR;
+}
+
+Level MaxLevel() {
+    static Level s_level = DetectLevel();
+    return s_level;
+}
+
+//函数内静态变量保证在其它模块的静态初始化中使用时也已选择好实现
+std::atomic<const Ops*>& CurrentOps() {
+    static std::atomic<const Ops*> s_cur(&s_ops[MaxLevel()]);
+    return s_cur;
+}
+
+inline const Ops* GetOps() {
+    return CurrentOps().load(std::memory_order_relaxed);
+}
+
+}
+
+uint64_t And(uint64_t* dst, const uint64_t* src, size_t n) {
+    return GetOps()->and_(dst, src, n);
+}
+
+uint64_t Or(uint64_t* dst, const uint64_t* src, size_t n) {
+    return GetOps()->or_(dst, src, n);
+}
+
+uint64_t Xor(uint64_t* dst, const uint64_t* src, size_t n) {
+    return GetOps()->xor_(dst, src, n);
+}
+
+uint64_t AndNot(uint64_t* dst, const uint64_t* src, size_t n) {
+    return GetOps()->andnot_(dst, src, n);
+}
+
+uint64_t PopCount(const uint64_t* src, size_t n, uint64_t mask) {
+    return GetOps()->popcount(src, n, mask);
+}
+
+Level GetLevel() {
+    return GetOps()->level;
+}
+
+Level GetMaxLevel() {
+    return MaxLevel();
+}
+
+void SetLevel(Level v) {
+    if(v > MaxLevel()) {
+        v = MaxLevel();
+    }
+    CurrentOps().store(&s_ops[v], std::memory_order_relaxed);
+}
+
+const char* GetLevelName(Level v) {
+    switch(v) {
+        case AVX512:
+            return "avx512";
+        case AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+}
+}
+}
@@ -0,0 +1,69 @@
+#ifndef __SYLAR_DS_SIMD_H__
+#define __SYLAR_DS_SIMD_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+namespace sylar {
+namespace ds {
+
+/**
+ * @brief 位运算批量内核, 运行时按CPU选择AVX-512/AVX2/标量实现
+ * @details 二元运算结果写回dst, 返回值非0表示结果中存在置位(可用于提前结束)
+ */
+namespace simd {
+
+enum Level {
+    SCALAR = 0,
+    AVX2 = 1,
+    AVX512 = 2
+};
+
+/**
+ * @brief dst[i] &= src[i]
+ */
+uint64_t And(uint64_t* dst, const uint64_t* src, size_t n);
+
+/**
+ * @brief dst[i] |= src[i]
+ */
+uint64_t Or(uint64_t* dst, const uint64_t* src, size_t n);
+
+/**
+ * @brief dst[i] ^= src[i]
+ */
+uint64_t Xor(uint64_t* dst, const uint64_t* src, size_t n);
+
+/**
+ * @brief dst[i] &= ~src[i]
+ */
+uint64_t AndNot(uint64_t* dst, const uint64_t* src, size_t n);
+
+/**
+ * @brief 统计(src[i] & mask)的置位数
+ */
+uint64_t PopCount(const uint64_t* src, size_t n, uint64_t mask = ~0ull);
+
+/**
+ * @brief 当前使用的实现
+ */
+Level GetLevel();
+
+/**
+ * @brief CPU支持的最高实现
+ */
+Level GetMaxLevel();
+
+/**
+ * @brief 指定实现(不超过GetMaxLevel), 用于测试与对比
+ */
+void SetLevel(Level v);
+
+const char* GetLevelName(Level v);
+
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,497 @@
+#ifndef __SYLAR_DS_SLAB_LRU_CACHE_H__
+#define __SYLAR_DS_SLAB_LRU_CACHE_H__
+
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "cache_status.h"
+#include "sylar/mutex.h"
+#include "sylar/util.h"
+
+namespace sylar {
+namespace ds {
+
+/**
+ * @brief 基于slab的LRU缓存, 接口与LruCache/TimedLruCache一致
+ * @details 条目存放在定长slab(每块4096个)的连续数组中, LRU链表用uint32下标串联,
+ *          删除的槽位进入空闲链表复用; 查找使用线性探测的开放寻址表,
+ *          表项为(32位hash << 32 | 下标+1), 比较key前先比较hash, 删除使用后移法不留墓碑.
+ *          稳定状态下set/get/del不分配内存.
+ *          容量可以按条目数(max_size)和/或字节数(max_bytes)限制,
+ *          每个条目按 sizeof(Entry) + 哈希表开销 + weigher(k, v) 计费.
+ *          使用带过期时间的set后, 每个条目额外记录过期时间, get时检查,
+ *          checkTimeout顺序扫描slab清理
+ */
+template<class K, class V, class MutexType = sylar::Mutex, class Hash = std::hash<K> >
+class SlabLruCache {
+private:
+    static const uint32_t NIL = 0xFFFFFFFF;
+    static const uint32_t SLAB_SHIFT = 12;
+    static const uint32_t SLAB_SIZE = 1 << SLAB_SHIFT;
+
+    struct Entry {
+        K key;
+        V val;
+        uint32_t prev = NIL;
+        uint32_t next = NIL;
+        uint32_t hash = 0;
+    };
+public:
+    typedef std::shared_ptr<SlabLruCache> ptr;
+    typedef std::function<void(const K&, const V&)> prune_callback;
+    typedef std::function<size_t(const K&, const V&)> weigher_callback;
+
+    SlabLruCache(size_t max_size = 0, size_t max_bytes = 0
+                 ,CacheStatus* status = nullptr)
+        :m_maxSize(max_size)
+        ,m_maxBytes(max_bytes)
+        ,m_status(status) {
+        if(m_status == nullptr) {
+            m_status = new CacheStatus;
+            m_statusOwner = true;
+        }
+        if(m_maxSize) {
+            m_slabs.reserve((m_maxSize + SLAB_SIZE - 1) >> SLAB_SHIFT);
+        }
+        m_table.resize(16, 0);
+    }
+
+    ~SlabLruCache() {
+        if(m_statusOwner && m_status) {
+            delete m_status;
+        }
+    }
+
+    void set(const K& k, const V& v) {
+        m_status->incSet();
+        typename MutexType::Lock lock(m_mutex);
+        setNolock(k, v, 0);
+    }
+
+    /**
+     * @brief 设置带过期时间的条目
+     * @param[in] expired 过期时间(毫秒, 相对当前时间)
+     */
+    void set(const K& k, const V& v, uint64_t expired) {
+        m_status->incSet();
+        typename MutexType::Lock lock(m_mutex);
+        if(!m_timed) {
+            m_timed = true;
+            for(size_t i = m_expires.size(); i < m_slabs.size(); ++i) {
+                m_expires.emplace_back(new uint64_t[SLAB_SIZE]());
+            }
+        }
+        setNolock(k, v, expired + sylar::GetCurrentMS());
+    }
+
+    bool get(const K& k, V& v) {
+        m_status->incGet();
+        typename MutexType::Lock lock(m_mutex);
+        uint32_t idx = findNolock(k);
+        if(idx == NIL) {
+            return false;
+        }
+        if(m_timed && isExpired(idx, sylar::GetCurrentMS())) {
+            removeNolock(idx, true);
+            m_status->incTimeout();
+            return false;
+        }
+        moveToFront(idx);
+        v = entry(idx).val;
+        lock.unlock();
+        m_status->incHit();
+        return true;
+    }
+
+    V get(const K& k) {
+        V v = V();
+        get(k, v);
+        return v;
+    }
+
+    bool del(const K& k) {
+        m_status->incDel();
+        typename MutexType::Lock lock(m_mutex);
+        uint32_t idx = findNolock(k);
+        if(idx == NIL) {
+            return false;
+        }
+        removeNolock(idx, false);
+        return true;
+    }
+
+    bool exists(const K& k) {
+        typename MutexType::Lock lock(m_mutex);
+        return findNolock(k) != NIL;
+    }
+
+    size_t size() {
+        typename MutexType::Lock lock(m_mutex);
+        return m_size;
+    }
+
+    bool empty() {
+        typename MutexType::Lock lock(m_mutex);
+        return m_size == 0;
+    }
+
+    /**
+     * @brief 清空缓存并释放slab
+     */
+    bool clear() {
+        typename MutexType::Lock lock(m_mutex);
+        m_slabs.clear();
+        m_expires.clear();
+        m_table.assign(16, 0);
+        m_head = m_tail = m_free = NIL;
+        m_used = 0;
+        m_size = 0;
+        m_bytes = 0;
+        return true;
+    }
+
+    size_t checkTimeout(const uint64_t& ts = sylar::GetCurrentMS()) {
+        size_t size = 0;
+        typename MutexType::Lock lock(m_mutex);
+        if(!m_timed) {
+            return 0;
+        }
+        for(uint32_t i = 0; i < m_used; ++i) {
+            if(isExpired(i, ts)) {
+                removeNolock(i, true);
+                ++size;
+            }
+        }
+        m_status->incTimeout(size);
+        return size;
+    }
+
+    void setMaxSize(const size_t& v) {
+        typename MutexType::Lock lock(m_mutex);
+        m_maxSize = v;
+        prune();
+    }
+
+    void setMaxBytes(const size_t& v) {
+        typename MutexType::Lock lock(m_mutex);
+        m_maxBytes = v;
+        prune();
+    }
+
+    size_t getMaxSize() const { return m_maxSize;}
+    size_t getMaxBytes() const { return m_maxBytes;}
+
+    /**
+     * @brief 当前计费的字节数(容量限制依据)
+     */
+    size_t getBytes() {
+        typename MutexType::Lock lock(m_mutex);
+        return m_bytes;
+    }
+
+    /**
+     * @brief 实际占用的内存(slab + 过期时间 + 哈希表 + weigher计费的外部数据)
+     */
+    size_t getMemoryUsage() {
+        typename MutexType::Lock lock(m_mutex);
+        return getMemoryUsageNolock();
+    }
+
+    /**
+     * @brief 平均每个条目占用的内存
+     */
+    double getBytesPerEntry() {
+        typename MutexType::Lock lock(m_mutex);
+        return m_size ? getMemoryUsageNolock() * 1.0 / m_size : 0;
+    }
+
+    /**
+     * @brief 设置条目的外部数据大小计算方法(例如string的长度), 计入字节容量
+     */
+    void setWeigher(weigher_callback cb) {
+        typename MutexType::Lock lock(m_mutex);
+        m_weigher = cb;
+        m_bytes = 0;
+        for(uint32_t i = m_head; i != NIL; i = entry(i).next) {
+            m_bytes += charge(entry(i));
+        }
+        prune();
+    }
+
+    /**
+     * @brief 按最近访问到最久未访问的顺序遍历, f(key, val)
+     */
+    template<class F>
+    void foreach(F& f) {
+        typename MutexType::Lock lock(m_mutex);
+        for(uint32_t i = m_head; i != NIL; i = entry(i).next) {
+            f(entry(i).key, entry(i).val);
+        }
+    }
+
+    void setPruneCallback(prune_callback cb) { m_cb = cb;}
+
+    std::string toStatusString() {
+        std::stringstream ss;
+        typename MutexType::Lock lock(m_mutex);
+        ss << (m_status ? m_status->toString() : "(no status)")
+           << " total=" << m_size
+           << " bytes=" << m_bytes
+           << " memory=" << getMemoryUsageNolock()
+           << " bytes_per_entry=" << (m_size ? getMemoryUsageNolock() * 1.0 / m_size : 0);
+        return ss.str();
+    }
+
+    CacheStatus* getStatus() const { return m_status;}
+
+    void setStatus(CacheStatus* v, bool owner = false) {
+        if(m_statusOwner && m_status) {
+            delete m_status;
+        }
+        m_status = v;
+        m_statusOwner = owner;
+
+        if(m_status == nullptr) {
+            m_status = new CacheStatus;
+            m_statusOwner = true;
+        }
+    }
+private:
+    Entry& entry(uint32_t idx) {
+        return m_slabs[idx >> SLAB_SHIFT][idx & (SLAB_SIZE - 1)];
+    }
+
+    uint64_t& expire(uint32_t idx) {
+        return m_expires[idx >> SLAB_SHIFT][idx & (SLAB_SIZE - 1)];
+    }
+
+    bool isExpired(uint32_t idx, uint64_t ts) {
+        uint64_t e = expire(idx);
+        return e && e <= ts;
+    }
+
+    uint32_t hashKey(const K& k) const {
+        uint64_t h = (uint64_t)m_hash(k) * 0x9E3779B97F4A7C15ULL;
+        return (uint32_t)(h >> 32);
+    }
+
+    size_t charge(const Entry& e) const {
+        return sizeof(Entry) + sizeof(uint64_t) * 4 / 3
+            + (m_weigher ? m_weigher(e.key, e.val) : 0);
+    }
+
+    size_t getMemoryUsageNolock() const {
+        size_t weight = m_bytes - m_size * (sizeof(Entry) + sizeof(uint64_t) * 4 / 3);
+        return m_slabs.size() * SLAB_SIZE * sizeof(Entry)
+            + m_expires.size() * SLAB_SIZE * sizeof(uint64_t)
+            + m_table.size() * sizeof(uint64_t)
+            + weight;
+    }
+
+    /**
+     * @brief 查找key, 返回条目下标, 不存在返回NIL
+     */
+    uint32_t findNolock(const K& k) {
+        return findNolock(k, hashKey(k), nullptr);
+    }
+
+    uint32_t findNolock(const K& k, uint32_t hash, size_t* slot) {
+        size_t mask = m_table.size() - 1;
+        for(size_t pos = hash & mask;; pos = (pos + 1) & mask) {
+            uint64_t v = m_table[pos];
+            if(v == 0) {
+                return NIL;
+            }
+            if((uint32_t)(v >> 32) == hash) {
+                uint32_t idx = (uint32_t)v - 1;
+                if(entry(idx).key == k) {
+                    if(slot) {
+                        *slot = pos;
+                    }
+                    return idx;
+                }
+            }
+        }
+    }
+
+    void insertTable(uint32_t hash, uint32_t idx) {
+        size_t mask = m_table.size() - 1;
+        size_t pos = hash & mask;
+        while(m_table[pos]) {
+            pos = (pos + 1) & mask;
+        }
+        m_table[pos] = ((uint64_t)hash << 32) | (idx + 1);
+    }
+
+    void eraseTable(size_t pos) {
+        size_t mask = m_table.size() - 1;
+        size_t i = pos;
+        size_t j = pos;
+        m_table[i] = 0;
+        while(true) {
+            j = (j + 1) & mask;
+            uint64_t v = m_table[j];
+            if(v == 0) {
+                break;
+            }
+            size_t home = (v >> 32) & mask;
+            //home在(i, j]之间的表项不需要移动
+            if(i <= j ? (i < home && home <= j) : (i < home || home <= j)) {
+                continue;
+            }
+            m_table[i] = v;
+            m_table[j] = 0;
+            i = j;
+        }
+    }
+
+    void rehash(size_t size) {
+        std::vector<uint64_t> old(size, 0);
+        old.swap(m_table);
+        for(auto& v : old) {
+            if(v) {
+                insertTable((uint32_t)(v >> 32), (uint32_t)v - 1);
+            }
+        }
+    }
+
+    uint32_t allocIndex() {
+        uint32_t idx = m_free;
+        if(idx != NIL) {
+            m_free = entry(idx).next;
+            return idx;
+        }
+        idx = m_used++;
+        if((idx >> SLAB_SHIFT) >= m_slabs.size()) {
+            m_slabs.emplace_back(new Entry[SLAB_SIZE]);
+            if(m_timed) {
+                m_expires.emplace_back(new uint64_t[SLAB_SIZE]());
+            }
+        }
+        return idx;
+    }
+
+    void linkFront(uint32_t idx) {
+        Entry& e = entry(idx);
+        e.prev = NIL;
+        e.next = m_head;
+        if(m_head != NIL) {
+            entry(m_head).prev = idx;
+        } else {
+            m_tail = idx;
+        }
+        m_head = idx;
+    }
+
+    void unlink(uint32_t idx) {
+        Entry& e = entry(idx);
+        if(e.prev != NIL) {
+            entry(e.prev).next = e.next;
+        } else {
+            m_head = e.next;
+        }
+        if(e.next != NIL) {
+            entry(e.next).prev = e.prev;
+        } else {
+            m_tail = e.prev;
+        }
+    }
+
+    void moveToFront(uint32_t idx) {
+        if(m_head != idx) {
+            unlink(idx);
+            linkFront(idx);
+        }
+    }
+
+    void setNolock(const K& k, const V& v, uint64_t expire_ts) {
+        uint32_t hash = hashKey(k);
+        uint32_t idx = findNolock(k, hash, nullptr);
+        if(idx != NIL) {
+            Entry& e = entry(idx);
+            m_bytes -= charge(e);
+            e.val = v;
+            m_bytes += charge(e);
+            if(m_timed) {
+                expire(idx) = expire_ts;
+            }
+            moveToFront(idx);
+            prune();
+            return;
+        }
+        if((m_size + 1) * 4 > m_table.size() * 3) {
+            rehash(m_table.size() * 2);
+        }
+        idx = allocIndex();
+        Entry& e = entry(idx);
+        e.key = k;
+        e.val = v;
+        e.hash = hash;
+        if(m_timed) {
+            expire(idx) = expire_ts;
+        }
+        linkFront(idx);
+        insertTable(hash, idx);
+        ++m_size;
+        m_bytes += charge(e);
+        prune();
+    }
+
+    void removeNolock(uint32_t idx, bool notify) {
+        Entry& e = entry(idx);
+        if(notify && m_cb) {
+            m_cb(e.key, e.val);
+        }
+        size_t slot = 0;
+        findNolock(e.key, e.hash, &slot);
+        eraseTable(slot);
+        unlink(idx);
+        m_bytes -= charge(e);
+        --m_size;
+        //释放key/val持有的资源, 槽位放入空闲链表
+        e.key = K();
+        e.val = V();
+        if(m_timed) {
+            expire(idx) = 0;
+        }
+        e.next = m_free;
+        m_free = idx;
+    }
+
+    void prune() {
+        size_t count = 0;
+        while(m_tail != NIL && ((m_maxSize && m_size > m_maxSize)
+                    || (m_maxBytes && m_bytes > m_maxBytes && m_size > 1))) {
+            removeNolock(m_tail, true);
+            ++count;
+        }
+        if(count) {
+            m_status->incPrune(count);
+        }
+    }
+private:
+    MutexType m_mutex;
+    std::vector<std::unique_ptr<Entry[]> > m_slabs;
+    std::vector<std::unique_ptr<uint64_t[]> > m_expires;
+    std::vector<uint64_t> m_table;
+    uint32_t m_head = NIL;
+    uint32_t m_tail = NIL;
+    uint32_t m_free = NIL;
+    uint32_t m_used = 0;
+    size_t m_size = 0;
+    size_t m_bytes = 0;
+    size_t m_maxSize;
+    size_t m_maxBytes;
+    bool m_timed = false;
+    Hash m_hash;
+    weigher_callback m_weigher;
+    prune_callback m_cb;
+    CacheStatus* m_status = nullptr;
+    bool m_statusOwner = false;
+};
+
+}
+}
+
+#endif
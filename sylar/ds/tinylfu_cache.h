@@ -0,0 +1,596 @@
+#ifndef __SYLAR_DS_TINYLFU_CACHE_H__
+#define __SYLAR_DS_TINYLFU_CACHE_H__
+
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+#include "cache_status.h"
+#include "sylar/mutex.h"
+
+namespace sylar {
+namespace ds {
+
+/**
+ * @brief 带衰减的Count-Min Sketch, 4bit计数器, 用于估计key的访问频率
+ * @details 每个uint64_t存16个计数器, 4行独立哈希, 计数上限15.
+ *          累计增加次数达到 10 * capacity 时所有计数器减半(老化),
+ *          使频率反映近期的访问情况
+ */
+class FrequencySketch {
+public:
+    FrequencySketch(size_t capacity = 0) {
+        ensureCapacity(capacity);
+    }
+
+    void ensureCapacity(size_t capacity) {
+        capacity = std::max(capacity, (size_t)16);
+        size_t width = 16;
+        while(width < capacity) {
+            width <<= 1;
+        }
+        m_width = width;
+        m_table.assign(width * DEPTH / 16, 0);
+        m_sampleSize = capacity * 10;
+        m_size = 0;
+    }
+
+    void increment(uint64_t hash) {
+        uint64_t h1 = spread(hash);
+        uint64_t h2 = (h1 >> 32) | 1;
+        bool added = false;
+        for(size_t i = 0; i < DEPTH; ++i) {
+            added |= incrementAt(i * m_width + ((h1 + i * h2) & (m_width - 1)));
+        }
+        if(added && ++m_size >= m_sampleSize) {
+            reset();
+        }
+    }
+
+    uint32_t frequency(uint64_t hash) const {
+        uint64_t h1 = spread(hash);
+        uint64_t h2 = (h1 >> 32) | 1;
+        uint32_t freq = 15;
+        for(size_t i = 0; i < DEPTH; ++i) {
+            size_t idx = i * m_width + ((h1 + i * h2) & (m_width - 1));
+            freq = std::min(freq, (uint32_t)((m_table[idx >> 4] >> ((idx & 15) << 2)) & 0xF));
+        }
+        return freq;
+    }
+
+    void reset() {
+        for(auto& i : m_table) {
+            i = (i >> 1) & 0x7777777777777777ULL;
+        }
+        m_size /= 2;
+    }
+
+    void clear() {
+        std::fill(m_table.begin(), m_table.end(), 0);
+        m_size = 0;
+    }
+private:
+    static const size_t DEPTH = 4;
+
+    static uint64_t spread(uint64_t x) {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    bool incrementAt(size_t idx) {
+        uint64_t& word = m_table[idx >> 4];
+        size_t offset = (idx & 15) << 2;
+        uint64_t mask = 0xFULL << offset;
+        if((word & mask) != mask) {
+            word += 1ULL << offset;
+            return true;
+        }
+        return false;
+    }
+private:
+    std::vector<uint64_t> m_table;
+    size_t m_width = 0;
+    size_t m_sampleSize = 0;
+    size_t m_size = 0;
+};
+
+/**
+ * @brief W-TinyLFU缓存, 接口与LruCache一致
+ * @details 1%的窗口LRU接收新数据, 其余为SLRU(probation 20% / protected 80%).
+ *          窗口淘汰出的候选与probation尾部的牺牲者比较Sketch频率, 频率高者留下,
+ *          所以一次性扫描的冷数据进不了主缓存, 热数据不会被冲掉.
+ *          get只持有读锁, 命中的访问记录到按线程分条的有损环形缓冲(满则丢弃),
+ *          由写锁批量回放(调整链表/更新Sketch), 读路径不修改链表
+ */
+template<class K, class V, class RWMutexType = sylar::RWMutex, class Hash = std::hash<K> >
+class TinyLfuCache {
+private:
+    enum Queue {
+        WINDOW = 0,
+        PROBATION = 1,
+        PROTECTED = 2
+    };
+
+    struct Node {
+        Node(const K& k, const V& v, uint64_t h)
+            :key(k), val(v), hash(h) {}
+        K key;
+        V val;
+        uint64_t hash;
+        Node* prev = nullptr;
+        Node* next = nullptr;
+        Queue queue = WINDOW;
+    };
+
+    //侵入式双向链表, head为最近访问
+    struct NodeList {
+        Node* head = nullptr;
+        Node* tail = nullptr;
+        size_t size = 0;
+
+        void pushFront(Node* n) {
+            n->prev = nullptr;
+            n->next = head;
+            if(head) {
+                head->prev = n;
+            } else {
+                tail = n;
+            }
+            head = n;
+            ++size;
+        }
+
+        void remove(Node* n) {
+            if(n->prev) {
+                n->prev->next = n->next;
+            } else {
+                head = n->next;
+            }
+            if(n->next) {
+                n->next->prev = n->prev;
+            } else {
+                tail = n->prev;
+            }
+            n->prev = n->next = nullptr;
+            --size;
+        }
+
+        void moveToFront(Node* n) {
+            if(head != n) {
+                remove(n);
+                pushFront(n);
+            }
+        }
+    };
+
+    static const size_t READ_BUFFERS = 16;
+    static const size_t READ_BUFFER_SIZE = 32;
+
+    struct ReadBuffer {
+        std::atomic<uint32_t> tail;
+        //已回放到的位置, 只在写锁下访问
+        uint32_t head = 0;
+        std::atomic<Node*> slots[READ_BUFFER_SIZE];
+        char pad[64];
+
+        ReadBuffer() {
+            tail = 0;
+            for(auto& i : slots) {
+                i = nullptr;
+            }
+        }
+    };
+public:
+    typedef std::shared_ptr<TinyLfuCache> ptr;
+    typedef std::function<void(const K&, const V&)> prune_callback;
+
+    TinyLfuCache(size_t max_size = 0, CacheStatus* status = nullptr)
+        :m_status(status) {
+        if(m_status == nullptr) {
+            m_status = new CacheStatus;
+            m_statusOwner = true;
+        }
+        m_drainPending = false;
+        resize(max_size);
+    }
+
+    ~TinyLfuCache() {
+        clearNolock();
+        if(m_statusOwner && m_status) {
+            delete m_status;
+        }
+    }
+
+    void set(const K& k, const V& v) {
+        m_status->incSet();
+        typename RWMutexType::WriteLock lock(m_mutex);
+        drainNolock();
+        auto it = m_cache.find(k);
+        if(it != m_cache.end()) {
+            it->second->val = v;
+            onAccess(it->second);
+            return;
+        }
+        Node* n = new Node(k, v, m_hash(k));
+        m_cache.insert(std::make_pair(k, n));
+        m_sketch.increment(n->hash);
+        m_window.pushFront(n);
+        evict();
+    }
+
+    bool get(const K& k, V& v) {
+        m_status->incGet();
+        typename RWMutexType::ReadLock lock(m_mutex);
+        auto it = m_cache.find(k);
+        if(it == m_cache.end()) {
+            return false;
+        }
+        v = it->second->val;
+        bool full = record(it->second);
+        lock.unlock();
+        m_status->incHit();
+        if(full) {
+            tryDrain();
+        }
+        return true;
+    }
+
+    V get(const K& k) {
+        V v = V();
+        get(k, v);
+        return v;
+    }
+
+    bool del(const K& k) {
+        m_status->incDel();
+        typename RWMutexType::WriteLock lock(m_mutex);
+        //先回放缓冲, 保证缓冲里不再引用将要释放的节点
+        drainNolock();
+        auto it = m_cache.find(k);
+        if(it == m_cache.end()) {
+            return false;
+        }
+        Node* n = it->second;
+        getList(n->queue).remove(n);
+        m_cache.erase(it);
+        delete n;
+        return true;
+    }
+
+    bool exists(const K& k) {
+        typename RWMutexType::ReadLock lock(m_mutex);
+        return m_cache.find(k) != m_cache.end();
+    }
+
+    size_t size() {
+        typename RWMutexType::ReadLock lock(m_mutex);
+        return m_cache.size();
+    }
+
+    bool empty() {
+        typename RWMutexType::ReadLock lock(m_mutex);
+        return m_cache.empty();
+    }
+
+    bool clear() {
+        typename RWMutexType::WriteLock lock(m_mutex);
+        drainNolock();
+        clearNolock();
+        m_sketch.clear();
+        return true;
+    }
+
+    /**
+     * @brief 立即回放读缓冲
+     */
+    void cleanUp() {
+        typename RWMutexType::WriteLock lock(m_mutex);
+        drainNolock();
+    }
+
+    void setMaxSize(const size_t& v) {
+        typename RWMutexType::WriteLock lock(m_mutex);
+        drainNolock();
+        resize(v);
+        evict();
+    }
+
+    size_t getMaxSize() const { return m_maxSize;}
+    size_t getWindowMaxSize() const { return m_windowMax;}
+    size_t getProtectedMaxSize() const { return m_protectedMax;}
+
+    template<class F>
+    void foreach(F& f) {
+        typename RWMutexType::ReadLock lock(m_mutex);
+        for(auto& i : m_cache) {
+            f(i.first, i.second->val);
+        }
+    }
+
+    void setPruneCallback(prune_callback cb) { m_cb = cb;}
+
+    std::string toStatusString() {
+        std::stringstream ss;
+        typename RWMutexType::ReadLock lock(m_mutex);
+        ss << (m_status ? m_status->toString() : "(no status)")
+           << " total=" << m_cache.size()
+           << " window=" << m_window.size
+           << " probation=" << m_probation.size
+           << " protected=" << m_protected.size;
+        return ss.str();
+    }
+
+    CacheStatus* getStatus() const { return m_status;}
+
+    void setStatus(CacheStatus* v, bool owner = false) {
+        if(m_statusOwner && m_status) {
+            delete m_status;
+        }
+        m_status = v;
+        m_statusOwner = owner;
+
+        if(m_status == nullptr) {
+            m_status = new CacheStatus;
+            m_statusOwner = true;
+        }
+    }
+private:
+    NodeList& getList(Queue q) {
+        return q == WINDOW ? m_window : (q == PROBATION ? m_probation : m_protected);
+    }
+
+    void resize(size_t max_size) {
+        m_maxSize = max_size;
+        m_windowMax = max_size ? std::max((size_t)1, max_size / 100) : 0;
+        m_protectedMax = (max_size - m_windowMax) * 4 / 5;
+        m_sketch.ensureCapacity(max_size ? max_size : 1024);
+    }
+
+    /**
+     * @brief 记录一次命中, 调用方持有读锁
+     * @return 所在缓冲是否写满一轮, 需要回放
+     */
+    bool record(Node* n) {
+        static std::atomic<uint32_t> s_stripe(0);
+        static thread_local uint32_t t_stripe = s_stripe.fetch_add(1, std::memory_order_relaxed);
+        ReadBuffer& buf = m_buffers[t_stripe % READ_BUFFERS];
+        uint32_t idx = buf.tail.fetch_add(1, std::memory_order_relaxed) % READ_BUFFER_SIZE;
+        Node* expected = nullptr;
+        buf.slots[idx].compare_exchange_strong(expected, n, std::memory_order_release
+                                               ,std::memory_order_relaxed);
+        return idx == READ_BUFFER_SIZE - 1;
+    }
+
+    void tryDrain() {
+        if(m_drainPending.exchange(true)) {
+            return;
+        }
+        typename RWMutexType::WriteLock lock(m_mutex);
+        drainNolock();
+    }
+
+    void drainNolock() {
+        m_drainPending = false;
+        for(auto& buf : m_buffers) {
+            uint32_t tail = buf.tail.load(std::memory_order_relaxed);
+            uint32_t count = std::min(tail - buf.head, (uint32_t)READ_BUFFER_SIZE);
+            for(uint32_t i = tail - count; i != tail; ++i) {
+                Node* n = buf.slots[i % READ_BUFFER_SIZE].exchange(nullptr, std::memory_order_acquire);
+                if(n) {
+                    onAccess(n);
+                }
+            }
+            buf.head = tail;
+        }
+    }
+
+    void onAccess(Node* n) {
+        m_sketch.increment(n->hash);
+        switch(n->queue) {
+            case WINDOW:
+                m_window.moveToFront(n);
+                break;
+            case PROBATION:
+                m_probation.remove(n);
+                n->queue = PROTECTED;
+                m_protected.pushFront(n);
+                while(m_protected.size > m_protectedMax && m_protected.tail) {
+                    Node* d = m_protected.tail;
+                    m_protected.remove(d);
+                    d->queue = PROBATION;
+                    m_probation.pushFront(d);
+                }
+                break;
+            case PROTECTED:
+                m_protected.moveToFront(n);
+                break;
+        }
+    }
+
+    void evict() {
+        if(m_maxSize == 0) {
+            return;
+        }
+        size_t count = 0;
+        size_t main_max = m_maxSize - m_windowMax;
+        while(m_window.size > m_windowMax) {
+            Node* candidate = m_window.tail;
+            m_window.remove(candidate);
+            if(m_probation.size + m_protected.size < main_max) {
+                candidate->queue = PROBATION;
+                m_probation.pushFront(candidate);
+                continue;
+            }
+            Node* victim = m_probation.tail ? m_probation.tail : m_protected.tail;
+            if(victim && m_sketch.frequency(candidate->hash) > m_sketch.frequency(victim->hash)) {
+                getList(victim->queue).remove(victim);
+                candidate->queue = PROBATION;
+                m_probation.pushFront(candidate);
+                candidate = victim;
+            }
+            removeNode(candidate);
+            ++count;
+        }
+        //缩容时主缓存也可能超出
+        while(m_cache.size() > m_maxSize) {
+            Node* victim = m_probation.tail ? m_probation.tail : m_protected.tail;
+            getList(victim->queue).remove(victim);
+            removeNode(victim);
+            ++count;
+        }
+        if(count) {
+            m_status->incPrune(count);
+        }
+    }
+
+    void removeNode(Node* n) {
+        if(m_cb) {
+            m_cb(n->key, n->val);
+        }
+        m_cache.erase(n->key);
+        delete n;
+    }
+
+    void clearNolock() {
+        for(auto& i : m_cache) {
+            delete i.second;
+        }
+        m_cache.clear();
+        m_window = NodeList();
+        m_probation = NodeList();
+        m_protected = NodeList();
+    }
+private:
+    RWMutexType m_mutex;
+    std::unordered_map<K, Node*, Hash> m_cache;
+    NodeList m_window;
+    NodeList m_probation;
+    NodeList m_protected;
+    FrequencySketch m_sketch;
+    ReadBuffer m_buffers[READ_BUFFERS];
+    std::atomic<bool> m_drainPending;
+    size_t m_maxSize = 0;
+    size_t m_windowMax = 0;
+    size_t m_protectedMax = 0;
+    Hash m_hash;
+    prune_callback m_cb;
+    CacheStatus* m_status = nullptr;
+    bool m_statusOwner = false;
+};
+
+template<class K, class V, class RWMutexType = sylar::RWMutex, class Hash = std::hash<K> >
+class HashTinyLfuCache {
+public:
+    typedef std::shared_ptr<HashTinyLfuCache> ptr;
+    typedef TinyLfuCache<K, V, RWMutexType, Hash> cache_type;
+
+    HashTinyLfuCache(size_t bucket, size_t max_size)
+        :m_bucket(bucket) {
+        m_datas.resize(bucket);
+
+        size_t pre_max_size = std::ceil(max_size * 1.0 / bucket);
+        m_maxSize = pre_max_size * bucket;
+
+        for(size_t i = 0; i < bucket; ++i) {
+            m_datas[i] = new cache_type(pre_max_size, &m_status);
+        }
+    }
+
+    ~HashTinyLfuCache() {
+        for(size_t i = 0; i < m_datas.size(); ++i) {
+            delete m_datas[i];
+        }
+    }
+
+    void set(const K& k, const V& v) {
+        m_datas[m_hash(k) % m_bucket]->set(k, v);
+    }
+
+    bool get(const K& k, V& v) {
+        return m_datas[m_hash(k) % m_bucket]->get(k, v);
+    }
+
+    V get(const K& k) {
+        return m_datas[m_hash(k) % m_bucket]->get(k);
+    }
+
+    bool del(const K& k) {
+        return m_datas[m_hash(k) % m_bucket]->del(k);
+    }
+
+    bool exists(const K& k) {
+        return m_datas[m_hash(k) % m_bucket]->exists(k);
+    }
+
+    size_t size() {
+        size_t total = 0;
+        for(auto& i : m_datas) {
+            total += i->size();
+        }
+        return total;
+    }
+
+    bool empty() {
+        for(auto& i : m_datas) {
+            if(!i->empty()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void clear() {
+        for(auto& i : m_datas) {
+            i->clear();
+        }
+    }
+
+    size_t getMaxSize() const { return m_maxSize;}
+    size_t getBucket() const { return m_bucket;}
+
+    void setMaxSize(const size_t& v) {
+        size_t pre_max_size = std::ceil(v * 1.0 / m_bucket);
+        m_maxSize = pre_max_size * m_bucket;
+        for(auto& i : m_datas) {
+            i->setMaxSize(pre_max_size);
+        }
+    }
+
+    template<class F>
+    void foreach(F& f) {
+        for(auto& i : m_datas) {
+            i->foreach(f);
+        }
+    }
+
+    void setPruneCallback(typename cache_type::prune_callback cb) {
+        for(auto& i : m_datas) {
+            i->setPruneCallback(cb);
+        }
+    }
+
+    CacheStatus* getStatus() {
+        return &m_status;
+    }
+
+    std::string toStatusString() {
+        std::stringstream ss;
+        ss << m_status.toString() << " total=" << size();
+        return ss.str();
+    }
+private:
+    std::vector<cache_type*> m_datas;
+    size_t m_maxSize;
+    size_t m_bucket;
+    Hash m_hash;
+    CacheStatus m_status;
+};
+
+}
+}
+
+#endif
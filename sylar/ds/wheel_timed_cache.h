@@ -0,0 +1,695 @@
+#ifndef __SYLAR_DS_WHEEL_TIMED_CACHE_H__
+#define __SYLAR_DS_WHEEL_TIMED_CACHE_H__
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include "cache_status.h"
+#include "sylar/mutex.h"
+#include "sylar/timer.h"
+#include "sylar/util.h"
+
+namespace sylar {
+namespace ds {
+
+/**
+ * @brief 基于时间轮的过期缓存, 接口与TimedCache/TimedLruCache一致
+ * @details 条目按过期时间挂到时间轮(默认4096个槽, 每槽100ms)的双向链表上, set/expired为O(1);
+ *          超出一圈的条目在经过时保留到下一圈.
+ *          key只在节点中存一份, 查找用节点内嵌的拉链哈希表.
+ *          读时惰性过期: 已到期未清理的条目按未命中处理.
+ *          时间取GetCurrentCoarseMS, 避免读路径上的rdtsc阻塞访存并行.
+ *          清理分批进行: checkTimeout每批最多处理BATCH个条目后释放锁,
+ *          set时顺带推进时间轮并最多清理少量条目; 回调在锁外执行.
+ *          Lru为true时按最近访问顺序淘汰超出容量的条目(对应TimedLruCache),
+ *          否则淘汰最早过期的条目(对应TimedCache, 在时间轮上近似查找)
+ */
+template<class K, class V, class RWMutexType, class Hash, bool Lru>
+class WheelTimedCacheBase {
+private:
+    struct Node {
+        Node(const K& k, const V& v, uint64_t t)
+            :key(k), val(v), ts(t) {}
+        K key;
+        V val;
+        uint64_t ts;
+        size_t hash = 0;
+        size_t slot = 0;
+        Node* hnext = nullptr;
+        Node* wprev = nullptr;
+        Node* wnext = nullptr;
+        Node* lprev = nullptr;
+        Node* lnext = nullptr;
+    };
+
+    static const size_t BATCH = 256;
+    static const size_t SET_BUDGET = 8;
+public:
+    typedef std::function<void(const K&, const V&)> prune_callback;
+
+    WheelTimedCacheBase(size_t max_size = 0, size_t elasticity = 0
+                        ,CacheStatus* status = nullptr
+                        ,uint64_t tick_ms = 100, size_t slots = 4096)
+        :m_maxSize(max_size)
+        ,m_elasticity(elasticity)
+        ,m_tickMs(tick_ms ? tick_ms : 1)
+        ,m_status(status) {
+        if(m_status == nullptr) {
+            m_status = new CacheStatus;
+            m_statusOwner = true;
+        }
+        size_t n = 16;
+        while(n < slots) {
+            n <<= 1;
+        }
+        m_slots.resize(n, nullptr);
+        m_buckets.resize(16, nullptr);
+        m_cursor = sylar::GetCurrentCoarseMS() / m_tickMs;
+    }
+
+    ~WheelTimedCacheBase() {
+        stopAutoCheck();
+        for(auto& i : m_buckets) {
+            for(Node* n = i; n;) {
+                Node* next = n->hnext;
+                delete n;
+                n = next;
+            }
+        }
+        if(m_statusOwner && m_status) {
+            delete m_status;
+        }
+    }
+
+    void set(const K& k, const V& v, uint64_t expired) {
+        m_status->incSet();
+        uint64_t now = sylar::GetCurrentCoarseMS();
+        std::vector<Node*> out;
+        typename RWMutexType::WriteLock lock(m_mutex);
+        //同一个tick内只推进一次, 避免每次set都扫描当前槽
+        if(m_behind || now / m_tickMs > m_cursor) {
+            m_behind = !advanceNolock(now, SET_BUDGET, out);
+        }
+        size_t timeout = out.size();
+        size_t hash = m_hash(k);
+        Node* n = findNolock(k, hash);
+        if(n) {
+            n->val = v;
+            unlinkWheel(n);
+            n->ts = expired + now;
+            linkWheel(n);
+            touch(n);
+        } else {
+            n = new Node(k, v, expired + now);
+            n->hash = hash;
+            insertNolock(n);
+        }
+        prune(out);
+        lock.unlock();
+        if(timeout) {
+            m_status->incTimeout(timeout);
+        }
+        release(out);
+    }
+
+    bool get(const K& k, V& v) {
+        m_status->incGet();
+        if(Lru) {
+            typename RWMutexType::WriteLock lock(m_mutex);
+            Node* n = findNolock(k, m_hash(k));
+            if(!n || n->ts <= sylar::GetCurrentCoarseMS()) {
+                return false;
+            }
+            touch(n);
+            v = n->val;
+        } else {
+            typename RWMutexType::ReadLock lock(m_mutex);
+            Node* n = findNolock(k, m_hash(k));
+            if(!n || n->ts <= sylar::GetCurrentCoarseMS()) {
+                return false;
+            }
+            v = n->val;
+        }
+        m_status->incHit();
+        return true;
+    }
+
+    V get(const K& k) {
+        V v = V();
+        get(k, v);
+        return v;
+    }
+
+    bool del(const K& k) {
+        m_status->incDel();
+        typename RWMutexType::WriteLock lock(m_mutex);
+        Node* n = findNolock(k, m_hash(k));
+        if(!n) {
+            return false;
+        }
+        removeNolock(n);
+        lock.unlock();
+        delete n;
+        return true;
+    }
+
+    /**
+     * @brief 重新设置过期时间
+     * @param[in] ts 过期时间(毫秒, 相对当前时间)
+     */
+    bool expired(const K& k, const uint64_t& ts) {
+        typename RWMutexType::WriteLock lock(m_mutex);
+        Node* n = findNolock(k, m_hash(k));
+        if(!n) {
+            return false;
+        }
+        uint64_t tts = ts + sylar::GetCurrentCoarseMS();
+        if(n->ts != tts) {
+            unlinkWheel(n);
+            n->ts = tts;
+            linkWheel(n);
+        }
+        return true;
+    }
+
+    bool exists(const K& k) {
+        typename RWMutexType::ReadLock lock(m_mutex);
+        Node* n = findNolock(k, m_hash(k));
+        return n && n->ts > sylar::GetCurrentCoarseMS();
+    }
+
+    size_t size() {
+        typename RWMutexType::ReadLock lock(m_mutex);
+        return m_size;
+    }
+
+    bool empty() {
+        typename RWMutexType::ReadLock lock(m_mutex);
+        return m_size == 0;
+    }
+
+    bool clear() {
+        std::vector<Node*> out;
+        typename RWMutexType::WriteLock lock(m_mutex);
+        for(auto& i : m_buckets) {
+            for(Node* n = i; n; n = n->hnext) {
+                out.push_back(n);
+            }
+            i = nullptr;
+        }
+        std::fill(m_slots.begin(), m_slots.end(), nullptr);
+        m_lruHead = m_lruTail = nullptr;
+        m_size = 0;
+        lock.unlock();
+        for(auto& i : out) {
+            delete i;
+        }
+        return true;
+    }
+
+    void setMaxSize(const size_t& v) { m_maxSize = v;}
+    void setElasticity(const size_t& v) { m_elasticity = v;}
+
+    size_t getMaxSize() const { return m_maxSize;}
+    size_t getElasticity() const { return m_elasticity;}
+    size_t getMaxAllowedSize() const { return m_maxSize + m_elasticity;}
+    uint64_t getTickMs() const { return m_tickMs;}
+    size_t getSlots() const { return m_slots.size();}
+
+    template<class F>
+    void foreach(F& f) {
+        typename RWMutexType::ReadLock lock(m_mutex);
+        for(auto& i : m_buckets) {
+            for(Node* n = i; n; n = n->hnext) {
+                f(n->key, n->val);
+            }
+        }
+    }
+
+    void setPruneCallback(prune_callback cb) { m_cb = cb;}
+
+    std::string toStatusString() {
+        std::stringstream ss;
+        ss << (m_status ? m_status->toString() : "(no status)")
+           << " total=" << size();
+        return ss.str();
+    }
+
+    CacheStatus* getStatus() const { return m_status;}
+
+    void setStatus(CacheStatus* v, bool owner = false) {
+        if(m_statusOwner && m_status) {
+            delete m_status;
+        }
+        m_status = v;
+        m_statusOwner = owner;
+
+        if(m_status == nullptr) {
+            m_status = new CacheStatus;
+            m_statusOwner = true;
+        }
+    }
+
+    /**
+     * @brief 清理到期条目, 每批最多BATCH个, 批之间释放锁
+     * @return 清理的条目数
+     */
+    size_t checkTimeout(const uint64_t& ts = sylar::GetCurrentCoarseMS()) {
+        size_t size = 0;
+        while(true) {
+            std::vector<Node*> out;
+            typename RWMutexType::WriteLock lock(m_mutex);
+            bool done = advanceNolock(ts, BATCH, out);
+            m_behind = !done;
+            lock.unlock();
+            size += out.size();
+            release(out);
+            if(done) {
+                break;
+            }
+        }
+        if(size) {
+            m_status->incTimeout(size);
+        }
+        return size;
+    }
+
+    /**
+     * @brief 用定时器周期性清理到期条目
+     * @details 定时器回调只持有AutoCheck, 缓存析构或stopAutoCheck时取消定时器,
+     *          并等待正在执行的回调结束, 之后的回调不再访问缓存.
+     *          清理回调中不能调用stopAutoCheck或析构缓存
+     */
+    void startAutoCheck(sylar::TimerManager* timer, uint64_t interval_ms) {
+        stopAutoCheck();
+        std::shared_ptr<AutoCheck> check(new AutoCheck(this));
+        m_check = check;
+        m_timer = timer->addTimer(interval_ms, [check](){
+            sylar::Mutex::Lock lock(check->mutex);
+            if(check->cache) {
+                check->cache->checkTimeout();
+            }
+        }, true);
+    }
+
+    void stopAutoCheck() {
+        if(m_timer) {
+            m_timer->cancel();
+            m_timer = nullptr;
+        }
+        if(m_check) {
+            sylar::Mutex::Lock lock(m_check->mutex);
+            m_check->cache = nullptr;
+            lock.unlock();
+            m_check = nullptr;
+        }
+    }
+private:
+    /**
+     * @brief 定时清理回调与缓存之间的共享状态, 缓存停止清理后置空
+     */
+    struct AutoCheck {
+        AutoCheck(WheelTimedCacheBase* c)
+            :cache(c) {}
+        sylar::Mutex mutex;
+        WheelTimedCacheBase* cache;
+    };
+
+    Node* findNolock(const K& k, size_t hash) {
+        for(Node* n = m_buckets[hash & (m_buckets.size() - 1)]; n; n = n->hnext) {
+            if(n->hash == hash && n->key == k) {
+                return n;
+            }
+        }
+        return nullptr;
+    }
+
+    void insertNolock(Node* n) {
+        if(m_size >= m_buckets.size()) {
+            std::vector<Node*> buckets(m_buckets.size() * 2, nullptr);
+            for(auto& i : m_buckets) {
+                for(Node* p = i; p;) {
+                    Node* next = p->hnext;
+                    Node*& head = buckets[p->hash & (buckets.size() - 1)];
+                    p->hnext = head;
+                    head = p;
+                    p = next;
+                }
+            }
+            m_buckets.swap(buckets);
+        }
+        Node*& head = m_buckets[n->hash & (m_buckets.size() - 1)];
+        n->hnext = head;
+        head = n;
+        ++m_size;
+        linkWheel(n);
+        if(Lru) {
+            linkLru(n);
+        }
+    }
+
+    void removeNolock(Node* n) {
+        Node** p = &m_buckets[n->hash & (m_buckets.size() - 1)];
+        while(*p != n) {
+            p = &(*p)->hnext;
+        }
+        *p = n->hnext;
+        --m_size;
+        unlinkWheel(n);
+        if(Lru) {
+            unlinkLru(n);
+        }
+    }
+
+    size_t slotOf(uint64_t ts) const {
+        //已过的时间落在当前槽, 下次推进时处理
+        uint64_t tick = std::max(ts / m_tickMs, m_cursor);
+        return tick & (m_slots.size() - 1);
+    }
+
+    void linkWheel(Node* n) {
+        n->slot = slotOf(n->ts);
+        Node*& head = m_slots[n->slot];
+        n->wprev = nullptr;
+        n->wnext = head;
+        if(head) {
+            head->wprev = n;
+        }
+        head = n;
+    }
+
+    void unlinkWheel(Node* n) {
+        if(n->wprev) {
+            n->wprev->wnext = n->wnext;
+        } else {
+            m_slots[n->slot] = n->wnext;
+        }
+        if(n->wnext) {
+            n->wnext->wprev = n->wprev;
+        }
+        n->wprev = n->wnext = nullptr;
+    }
+
+    void linkLru(Node* n) {
+        n->lprev = nullptr;
+        n->lnext = m_lruHead;
+        if(m_lruHead) {
+            m_lruHead->lprev = n;
+        } else {
+            m_lruTail = n;
+        }
+        m_lruHead = n;
+    }
+
+    void unlinkLru(Node* n) {
+        if(n->lprev) {
+            n->lprev->lnext = n->lnext;
+        } else {
+            m_lruHead = n->lnext;
+        }
+        if(n->lnext) {
+            n->lnext->lprev = n->lprev;
+        } else {
+            m_lruTail = n->lprev;
+        }
+        n->lprev = n->lnext = nullptr;
+    }
+
+    void touch(Node* n) {
+        if(Lru && m_lruHead != n) {
+            unlinkLru(n);
+            linkLru(n);
+        }
+    }
+
+    /**
+     * @brief 推进时间轮, 摘除到期条目放入out
+     * @return 是否已处理完到期条目(false表示达到budget)
+     */
+    bool advanceNolock(uint64_t now, size_t budget, std::vector<Node*>& out) {
+        uint64_t target = now / m_tickMs;
+        if(target > m_cursor + m_slots.size()) {
+            //超过一圈未推进, 扫描一圈即可覆盖所有槽
+            m_cursor = target - m_slots.size();
+        }
+        while(true) {
+            for(Node* n = m_slots[m_cursor & (m_slots.size() - 1)]; n;) {
+                Node* next = n->wnext;
+                if(n->ts <= now) {
+                    if(out.size() >= budget) {
+                        return false;
+                    }
+                    removeNolock(n);
+                    out.push_back(n);
+                }
+                n = next;
+            }
+            if(m_cursor >= target) {
+                break;
+            }
+            ++m_cursor;
+        }
+        return true;
+    }
+
+    /**
+     * @brief 淘汰count个最早过期的条目(优先当前这一圈内的)
+     * @details 从当前槽开始按时间顺序扫描时间轮, 凑够count个即停止, 每个槽内按过期时间部分排序;
+     *          当前这一圈内不够时(此时已扫描了所有槽)再从超出一圈的条目中选.
+     *          一次淘汰最多扫描一圈, 代价与淘汰个数无关
+     */
+    void evictNolock(size_t count, std::vector<Node*>& out) {
+        std::vector<Node*> cur;
+        std::vector<Node*> later;
+        size_t size = m_slots.size();
+        for(size_t i = 0; i < size && count; ++i) {
+            cur.clear();
+            for(Node* n = m_slots[(m_cursor + i) & (size - 1)]; n; n = n->wnext) {
+                if(n->ts / m_tickMs < m_cursor + size) {
+                    cur.push_back(n);
+                } else {
+                    later.push_back(n);
+                }
+            }
+            count -= evictEarliest(cur, count, out);
+        }
+        if(count) {
+            evictEarliest(later, count, out);
+        }
+    }
+
+    /**
+     * @brief 从nodes中淘汰最多count个过期时间最早的条目
+     * @return 淘汰的条目数
+     */
+    size_t evictEarliest(std::vector<Node*>& nodes, size_t count, std::vector<Node*>& out) {
+        if(nodes.size() > count) {
+            std::nth_element(nodes.begin(), nodes.begin() + count, nodes.end()
+                    ,[](const Node* a, const Node* b) { return a->ts < b->ts;});
+            nodes.resize(count);
+        }
+        for(auto& n : nodes) {
+            removeNolock(n);
+            out.push_back(n);
+        }
+        return nodes.size();
+    }
+
+    void prune(std::vector<Node*>& out) {
+        if(m_maxSize == 0 || m_size < getMaxAllowedSize()) {
+            return;
+        }
+        size_t count = m_size - m_maxSize;
+        if(Lru) {
+            for(size_t i = 0; i < count; ++i) {
+                Node* n = m_lruTail;
+                removeNolock(n);
+                out.push_back(n);
+            }
+        } else {
+            evictNolock(count, out);
+        }
+        m_status->incPrune(count);
+    }
+
+    void release(std::vector<Node*>& out) {
+        for(auto& i : out) {
+            if(m_cb) {
+                m_cb(i->key, i->val);
+            }
+            delete i;
+        }
+    }
+private:
+    RWMutexType m_mutex;
+    std::vector<Node*> m_buckets;
+    std::vector<Node*> m_slots;
+    Node* m_lruHead = nullptr;
+    Node* m_lruTail = nullptr;
+    size_t m_size = 0;
+    size_t m_maxSize;
+    size_t m_elasticity;
+    uint64_t m_tickMs;
+    uint64_t m_cursor;
+    /// 上次推进因budget中断, 还有到期条目未清理
+    bool m_behind = false;
+    Hash m_hash;
+    prune_callback m_cb;
+    CacheStatus* m_status = nullptr;
+    bool m_statusOwner = false;
+    sylar::Timer::ptr m_timer;
+    std::shared_ptr<AutoCheck> m_check;
+};
+
+template<class K, class V, class RWMutexType = sylar::RWMutex, class Hash = std::hash<K> >
+class WheelTimedCache : public WheelTimedCacheBase<K, V, RWMutexType, Hash, false> {
+public:
+    typedef std::shared_ptr<WheelTimedCache> ptr;
+    typedef WheelTimedCacheBase<K, V, RWMutexType, Hash, false> base_type;
+
+    WheelTimedCache(size_t max_size = 0, size_t elasticity = 0
+                    ,CacheStatus* status = nullptr
+                    ,uint64_t tick_ms = 100, size_t slots = 4096)
+        :base_type(max_size, elasticity, status, tick_ms, slots) {
+    }
+};
+
+template<class K, class V, class RWMutexType = sylar::RWMutex, class Hash = std::hash<K> >
+class WheelTimedLruCache : public WheelTimedCacheBase<K, V, RWMutexType, Hash, true> {
+public:
+    typedef std::shared_ptr<WheelTimedLruCache> ptr;
+    typedef WheelTimedCacheBase<K, V, RWMutexType, Hash, true> base_type;
+
+    WheelTimedLruCache(size_t max_size = 0, size_t elasticity = 0
+                       ,CacheStatus* status = nullptr
+                       ,uint64_t tick_ms = 100, size_t slots = 4096)
+        :base_type(max_size, elasticity, status, tick_ms, slots) {
+    }
+};
+
+template<class K, class V, class RWMutexType = sylar::RWMutex, class Hash = std::hash<K> >
+class HashWheelTimedCache {
+public:
+    typedef std::shared_ptr<HashWheelTimedCache> ptr;
+    typedef WheelTimedCache<K, V, RWMutexType, Hash> cache_type;
+
+    HashWheelTimedCache(size_t bucket, size_t max_size, size_t elasticity
+                        ,uint64_t tick_ms = 100, size_t slots = 4096)
+        :m_bucket(bucket) {
+        m_datas.resize(bucket);
+
+        size_t pre_max_size = std::ceil(max_size * 1.0 / bucket);
+        size_t pre_elasiticity = std::ceil(elasticity * 1.0 / bucket);
+        m_maxSize = pre_max_size * bucket;
+        m_elasticity = pre_elasiticity * bucket;
+
+        for(size_t i = 0; i < bucket; ++i) {
+            m_datas[i] = new cache_type(pre_max_size
+                        ,pre_elasiticity, &m_status, tick_ms, slots);
+        }
+    }
+
+    ~HashWheelTimedCache() {
+        for(size_t i = 0; i < m_datas.size(); ++i) {
+            delete m_datas[i];
+        }
+    }
+
+    void set(const K& k, const V& v, uint64_t expired) {
+        m_datas[m_hash(k) % m_bucket]->set(k, v, expired);
+    }
+
+    bool expired(const K& k, const uint64_t& ts) {
+        return m_datas[m_hash(k) % m_bucket]->expired(k, ts);
+    }
+
+    bool get(const K& k, V& v) {
+        return m_datas[m_hash(k) % m_bucket]->get(k, v);
+    }
+
+    V get(const K& k) {
+        return m_datas[m_hash(k) % m_bucket]->get(k);
+    }
+
+    bool del(const K& k) {
+        return m_datas[m_hash(k) % m_bucket]->del(k);
+    }
+
+    bool exists(const K& k) {
+        return m_datas[m_hash(k) % m_bucket]->exists(k);
+    }
+
+    size_t size() {
+        size_t total = 0;
+        for(auto& i : m_datas) {
+            total += i->size();
+        }
+        return total;
+    }
+
+    bool empty() {
+        for(auto& i : m_datas) {
+            if(!i->empty()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void clear() {
+        for(auto& i : m_datas) {
+            i->clear();
+        }
+    }
+
+    size_t getMaxSize() const { return m_maxSize;}
+    size_t getElasticity() const { return m_elasticity;}
+    size_t getMaxAllowedSize() const { return m_maxSize + m_elasticity;}
+    size_t getBucket() const { return m_bucket;}
+
+    template<class F>
+    void foreach(F& f) {
+        for(auto& i : m_datas) {
+            i->foreach(f);
+        }
+    }
+
+    void setPruneCallback(typename cache_type::prune_callback cb) {
+        for(auto& i : m_datas) {
+            i->setPruneCallback(cb);
+        }
+    }
+
+    CacheStatus* getStatus() {
+        return &m_status;
+    }
+
+    std::string toStatusString() {
+        std::stringstream ss;
+        ss << m_status.toString() << " total=" << size();
+        return ss.str();
+    }
+
+    size_t checkTimeout(const uint64_t& ts = sylar::GetCurrentCoarseMS()) {
+        size_t size = 0;
+        for(auto& i : m_datas) {
+            size += i->checkTimeout(ts);
+        }
+        return size;
+    }
+private:
+    std::vector<cache_type*> m_datas;
+    size_t m_maxSize;
+    size_t m_bucket;
+    size_t m_elasticity;
+    Hash m_hash;
+    CacheStatus m_status;
+};
+
+}
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "hook.h"
 #include <dlfcn.h>
+#include <sys/sendfile.h>
 
 #include "config.h"
 #include "log.h"
@@ -33,6 +34,7 @@ static thread_local bool t_hook_enable = false;
     XX(send) \
     XX(sendto) \
     XX(sendmsg) \
+    XX(sendfile) \
     XX(close) \
     XX(fcntl) \
     XX(ioctl) \
@@ -125,6 +127,10 @@ retry:
         }
 
         int rt = iom->addEvent(fd, (sylar::IOManager::Event)(event));
+        if(!rt && sylar::FdMgr::GetInstance()->get(fd) != ctx) {
+            //addEvent与close的cancelAll交错, 事件注册在即将关闭的fd上不会再触发
+            iom->cancelEvent(fd, (sylar::IOManager::Event)(event));
+        }
         if(SYLAR_UNLIKELY(rt)) {
             SYLAR_LOG_ERROR(g_logger) << hook_fun_name << " addEvent("
                 << fd << ", " << event << ")";
@@ -141,6 +147,11 @@ retry:
                 errno = tinfo->cancelled;
                 return -1;
             }
+            //等待期间fd被关闭, 编号可能已经被新的socket复用
+            if(sylar::FdMgr::GetInstance()->get(fd) != ctx) {
+                errno = EBADF;
+                return -1;
+            }
             goto retry;
         }
     }
@@ -331,6 +342,10 @@ ssize_t sendmsg(int s, const struct msghdr *msg, int flags) {
     return do_io(s, sendmsg_f, "sendmsg", sylar::IOManager::WRITE, SO_SNDTIMEO, msg, flags);
 }
 
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+    return do_io(out_fd, sendfile_f, "sendfile", sylar::IOManager::WRITE, SO_SNDTIMEO, in_fd, offset, count);
+}
+
 int close(int fd) {
     if(!sylar::t_hook_enable) {
         return close_f(fd);
@@ -338,11 +353,12 @@ int close(int fd) {
 
     sylar::FdCtx::ptr ctx = sylar::FdMgr::GetInstance()->get(fd);
     if(ctx) {
+        //先从FdMgr删除, cancelAll之后才注册的事件由do_io自行取消
+        sylar::FdMgr::GetInstance()->del(fd);
         auto iom = sylar::IOManager::GetThis();
         if(iom) {
             iom->cancelAll(fd);
         }
-        sylar::FdMgr::GetInstance()->del(fd);
     }
     return close_f(fd);
 }
@@ -103,6 +103,16 @@ void HttpRequest::setCookie(const std::string& key, const std::string& val) {
     m_cookies[key] = val;
 }
 
+std::string HttpRequest::getRouteParam(const std::string& key
+                            ,const std::string& def) const {
+    auto it = m_routeParams.find(key);
+    return it == m_routeParams.end() ? def : it->second;
+}
+
+void HttpRequest::setRouteParam(const std::string& key, const std::string& val) {
+    m_routeParams[key] = val;
+}
+
 void HttpRequest::delHeader(const std::string& key) {
     m_headers.erase(key);
 }
@@ -267,7 +277,8 @@ HttpResponse::HttpResponse(uint8_t version, bool close)
     :m_status(HttpStatus::OK)
     ,m_version(version)
     ,m_close(close)
-    ,m_websocket(false) {
+    ,m_websocket(false)
+    ,m_compressCacheable(false) {
 }
 
 std::string HttpResponse::getHeader(const std::string& key, const std::string& def) const {
@@ -338,7 +349,9 @@ std::ostream& HttpResponse::dump(std::ostream& os) const {
     if(!m_websocket) {
         os << "connection: " << (m_close ? "close" : "keep-alive") << "\r\n";
     }
-    if(!m_body.empty()) {
+    if(m_fileBody) {
+        os << "content-length: " << m_fileBody->length << "\r\n\r\n";
+    } else if(!m_body.empty()) {
         os << "content-length: " << m_body.size() << "\r\n\r\n"
            << m_body;
     } else {
@@ -16,6 +16,7 @@
 #include <iostream>
 #include <sstream>
 #include <boost/lexical_cast.hpp>
+#include "sylar/stream.h"
 
 namespace sylar {
 namespace http {
@@ -289,6 +290,22 @@ public:
      */
     const MapType& getCookies() const { return m_cookies;}
 
+    /**
+     * @brief 返回路由参数匹配捕获的参数MAP
+     */
+    const MapType& getRouteParams() const { return m_routeParams;}
+
+    /**
+     * @brief 返回消息体读取流
+     * @details 只有Servlet::isStreamBody()的Servlet会设置, 此时getBody()为空
+     */
+    Stream::ptr getBodyStream() const { return m_bodyStream;}
+
+    /**
+     * @brief 设置消息体读取流
+     */
+    void setBodyStream(Stream::ptr v) { m_bodyStream = v;}
+
     /**
      * @brief 设置HTTP请求的方法名
      * @param[in] v HTTP请求
@@ -409,6 +426,21 @@ public:
      */
     void setCookie(const std::string& key, const std::string& val);
 
+    /**
+     * @brief 获取路由参数
+     * @param[in] key 参数名(路由中 :id 的 id)
+     * @param[in] def 默认值
+     * @return 如果存在则返回对应值,否则返回默认值
+     */
+    std::string getRouteParam(const std::string& key, const std::string& def = "") const;
+
+    /**
+     * @brief 设置路由参数
+     * @param[in] key 参数名
+     * @param[in] val 值
+     */
+    void setRouteParam(const std::string& key, const std::string& val);
+
     /**
      * @brief 删除HTTP请求的头部参数
      * @param[in] key 关键字
@@ -575,6 +607,38 @@ private:
     MapType m_params;
     /// 请求Cookie MAP
     MapType m_cookies;
+    /// 路由参数MAP
+    MapType m_routeParams;
+    /// 消息体读取流
+    Stream::ptr m_bodyStream;
+};
+
+/**
+ * @brief 引用文件区间的响应消息体
+ * @details 由HttpSession::sendResponse在发送响应头后直接发送,
+ *          data非空时(文件内容已在内存中)用writev发送内存, 否则用sendfile发送fd
+ */
+struct HttpFileBody {
+    /// 智能指针类型定义
+    typedef std::shared_ptr<HttpFileBody> ptr;
+
+    HttpFileBody()
+        :fd(-1)
+        ,offset(0)
+        ,length(0)
+        ,data(nullptr) {
+    }
+
+    /// 文件句柄
+    int fd;
+    /// 发送的起始偏移
+    uint64_t offset;
+    /// 发送的长度
+    uint64_t length;
+    /// 内存中的文件内容起始地址(对应偏移0),可为空
+    const char* data;
+    /// 持有fd/内存的对象,保证发送期间不被关闭
+    std::shared_ptr<void> owner;
 };
 
 /**
@@ -672,6 +736,38 @@ public:
      */
     void setWebsocket(bool v) { m_websocket = v;}
 
+    /**
+     * @brief 返回文件消息体
+     */
+    HttpFileBody::ptr getFileBody() const { return m_fileBody;}
+
+    /**
+     * @brief 设置文件消息体, 设置后忽略body, content-length取文件区间长度
+     * @param[in] v 文件消息体
+     */
+    void setFileBody(HttpFileBody::ptr v) { m_fileBody = v;}
+
+    /**
+     * @brief 压缩结果是否可缓存
+     */
+    bool isCompressCacheable() const { return m_compressCacheable;}
+
+    /**
+     * @brief 设置压缩结果是否可缓存
+     * @details 相同路径且相同消息体的响应复用已压缩的结果(见HttpCompressor)
+     */
+    void setCompressCacheable(bool v) { m_compressCacheable = v;}
+
+    /**
+     * @brief 返回消息体写入流(见HttpChunkedWriter)
+     */
+    Stream::ptr getBodyWriter() const { return m_bodyWriter;}
+
+    /**
+     * @brief 设置消息体写入流, 设置后响应由写入流发送, 不再压缩和sendResponse
+     */
+    void setBodyWriter(Stream::ptr v) { m_bodyWriter = v;}
+
     /**
      * @brief 获取响应头部参数
      * @param[in] key 关键字
@@ -743,8 +839,14 @@ private:
     bool m_close;
     /// 是否为websocket
     bool m_websocket;
+    /// 压缩结果是否可缓存
+    bool m_compressCacheable;
     /// 响应消息体
     std::string m_body;
+    /// 文件消息体
+    HttpFileBody::ptr m_fileBody;
+    /// 消息体写入流
+    Stream::ptr m_bodyWriter;
     /// 响应原因
     std::string m_reason;
     /// 响应头部MAP
@@ -0,0 +1,252 @@
+#include "http_body_stream.h"
+#include "sylar/log.h"
+#include <string.h>
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+/// chunk长度行和trailer行的最大长度
+static const size_t s_max_line_size = 4096;
+
+HttpBodyStream::ptr HttpBodyStream::Create(HttpSession* session, HttpRequest::ptr req) {
+    bool chunked = strcasestr(req->getHeader("Transfer-Encoding").c_str(), "chunked") != nullptr;
+    uint64_t length = chunked ? 0 : req->getHeaderAs<uint64_t>("Content-Length");
+    if(!chunked && length == 0) {
+        return nullptr;
+    }
+    if(strcasecmp(req->getHeader("Expect").c_str(), "100-continue") == 0) {
+        static const char s_continue[] = "HTTP/1.1 100 Continue\r\n\r\n";
+        if(session->writeFixSize(s_continue, sizeof(s_continue) - 1) <= 0) {
+            return nullptr;
+        }
+    }
+    return std::make_shared<HttpBodyStream>(session, length, chunked);
+}
+
+HttpBodyStream::HttpBodyStream(HttpSession* session, uint64_t content_length, bool chunked)
+    :m_session(session)
+    ,m_contentLength(chunked ? 0 : content_length)
+    ,m_left(m_contentLength)
+    ,m_readSize(0)
+    ,m_chunked(chunked)
+    ,m_finished(!chunked && content_length == 0)
+    ,m_needCRLF(false) {
+}
+
+int HttpBodyStream::read(void* buffer, size_t length) {
+    if(m_finished || length == 0) {
+        return 0;
+    }
+    if(m_chunked && m_left == 0) {
+        int rt = readChunkHeader();
+        if(rt <= 0) {
+            return rt;
+        }
+        if(m_finished) {
+            return 0;
+        }
+    }
+    size_t n = std::min((uint64_t)length, m_left);
+    int rt = m_session->read(buffer, n);
+    if(rt <= 0) {
+        return rt;
+    }
+    m_left -= rt;
+    m_readSize += rt;
+    if(m_left == 0) {
+        if(m_chunked) {
+            m_needCRLF = true;
+        } else {
+            m_finished = true;
+        }
+    }
+    return rt;
+}
+
+int HttpBodyStream::read(ByteArray::ptr ba, size_t length) {
+    std::vector<iovec> iovs;
+    ba->getWriteBuffers(iovs, length);
+    int rt = read(iovs[0].iov_base, iovs[0].iov_len);
+    if(rt > 0) {
+        ba->setPosition(ba->getPosition() + rt);
+    }
+    return rt;
+}
+
+int HttpBodyStream::readChunkHeader() {
+    std::string line;
+    int rt = 0;
+    if(m_needCRLF) {
+        rt = readLine(line);
+        if(rt <= 0) {
+            return rt;
+        }
+        if(!line.empty()) {
+            SYLAR_LOG_DEBUG(g_logger) << "invalid chunk end: " << line;
+            return -1;
+        }
+        m_needCRLF = false;
+    }
+    rt = readLine(line);
+    if(rt <= 0) {
+        return rt;
+    }
+    char* end = nullptr;
+    uint64_t size = strtoull(line.c_str(), &end, 16);
+    if(end == line.c_str() || (*end && *end != ';' && *end != ' ' && *end != '\t')) {
+        SYLAR_LOG_DEBUG(g_logger) << "invalid chunk size: " << line;
+        return -1;
+    }
+    if(size == 0) {
+        //last-chunk之后是trailer, 以空行结束
+        do {
+            rt = readLine(line);
+            if(rt <= 0) {
+                return rt;
+            }
+        } while(!line.empty());
+        m_finished = true;
+        return 1;
+    }
+    m_left = size;
+    return 1;
+}
+
+int HttpBodyStream::readLine(std::string& line) {
+    line.clear();
+    char buf[128];
+    do {
+        int rt = m_session->read(buf, sizeof(buf));
+        if(rt <= 0) {
+            return rt;
+        }
+        char* pos = (char*)memchr(buf, '\n', rt);
+        if(pos) {
+            size_t n = pos - buf;
+            line.append(buf, n);
+            m_session->unread(pos + 1, rt - n - 1);
+            if(!line.empty() && line[line.size() - 1] == '\r') {
+                line.resize(line.size() - 1);
+            }
+            return 1;
+        }
+        line.append(buf, rt);
+    } while(line.size() <= s_max_line_size);
+    return -1;
+}
+
+HttpChunkedWriter::ptr HttpChunkedWriter::Create(HttpSession* session, HttpResponse::ptr rsp) {
+    HttpChunkedWriter::ptr writer(new HttpChunkedWriter(session, rsp));
+    rsp->setBodyWriter(writer);
+    return writer;
+}
+
+HttpChunkedWriter::HttpChunkedWriter(HttpSession* session, HttpResponse::ptr rsp)
+    :m_session(session)
+    ,m_response(rsp)
+    ,m_writeSize(0)
+    ,m_chunked(rsp->getVersion() >= 0x11)
+    ,m_headerSent(false)
+    ,m_finished(false) {
+}
+
+int HttpChunkedWriter::flushHeader() {
+    if(m_headerSent) {
+        return 1;
+    }
+    HttpResponse::ptr rsp = m_response.lock();
+    if(!rsp) {
+        return -1;
+    }
+    m_headerSent = true;
+    std::string body = rsp->getBody();
+    rsp->setBody("");
+    rsp->delHeader("Content-Length");
+    if(m_chunked) {
+        rsp->setHeader("Transfer-Encoding", "chunked");
+    } else {
+        rsp->setClose(true);
+    }
+    std::stringstream ss;
+    ss << *rsp;
+    std::string data = ss.str();
+    int rt = m_session->writeFixSize(data.c_str(), data.size());
+    if(rt <= 0) {
+        return rt;
+    }
+    if(!body.empty()) {
+        rt = write(body.c_str(), body.size());
+    }
+    return rt;
+}
+
+int HttpChunkedWriter::write(const void* buffer, size_t length) {
+    if(m_finished) {
+        return -1;
+    }
+    if(!m_headerSent) {
+        int rt = flushHeader();
+        if(rt <= 0) {
+            return rt;
+        }
+    }
+    //长度为0的chunk表示结束, 不能发送
+    if(length == 0) {
+        return 0;
+    }
+    if(!m_chunked) {
+        int rt = m_session->writeFixSize(buffer, length);
+        if(rt > 0) {
+            m_writeSize += length;
+        }
+        return rt;
+    }
+    char header[32];
+    iovec iovs[3];
+    iovs[0].iov_base = header;
+    iovs[0].iov_len = snprintf(header, sizeof(header), "%zx\r\n", length);
+    iovs[1].iov_base = (void*)buffer;
+    iovs[1].iov_len = length;
+    iovs[2].iov_base = (void*)"\r\n";
+    iovs[2].iov_len = 2;
+    int64_t rt = m_session->writevFixSize(iovs, 3);
+    if(rt <= 0) {
+        return rt;
+    }
+    m_writeSize += length;
+    return length;
+}
+
+int HttpChunkedWriter::write(ByteArray::ptr ba, size_t length) {
+    std::vector<iovec> iovs;
+    ba->getReadBuffers(iovs, length);
+    size_t total = 0;
+    for(auto& i : iovs) {
+        int rt = write(i.iov_base, i.iov_len);
+        if(rt <= 0) {
+            return rt;
+        }
+        total += rt;
+    }
+    ba->setPosition(ba->getPosition() + total);
+    return total;
+}
+
+void HttpChunkedWriter::close() {
+    if(m_finished) {
+        return;
+    }
+    if(!m_headerSent && flushHeader() <= 0) {
+        m_finished = true;
+        return;
+    }
+    m_finished = true;
+    if(m_chunked) {
+        m_session->writeFixSize("0\r\n\r\n", 5);
+    }
+}
+
+}
+}
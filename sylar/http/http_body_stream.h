@@ -0,0 +1,181 @@
+/**
+ * @file http_body_stream.h
+ * @brief HTTP消息体流式读写
+ * @author sylar.yin
+ * @email 564628276@qq.com
+ * @date 2019-06-07
+ * @copyright Copyright (c) 2019年 sylar.yin All rights reserved (www.sylar.top)
+ */
+#ifndef __SYLAR_HTTP_BODY_STREAM_H__
+#define __SYLAR_HTTP_BODY_STREAM_H__
+
+#include "sylar/stream.h"
+#include "http_session.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief HTTP请求消息体读取流
+ * @details 按Content-Length或chunked编码从连接中增量读取消息体,
+ *          read返回0表示消息体已读完. 不持有HttpSession, 只在请求处理期间有效
+ */
+class HttpBodyStream : public Stream {
+public:
+    /// 智能指针类型定义
+    typedef std::shared_ptr<HttpBodyStream> ptr;
+
+    /**
+     * @brief 根据请求头创建消息体流
+     * @details 请求带"Expect: 100-continue"时先回复100 Continue
+     * @param[in] session HTTP连接
+     * @param[in] req recvRequestHeader返回的请求
+     * @return 请求没有消息体时返回nullptr
+     */
+    static HttpBodyStream::ptr Create(HttpSession* session, HttpRequest::ptr req);
+
+    /**
+     * @brief 构造函数
+     * @param[in] session HTTP连接
+     * @param[in] content_length 消息体长度(chunked时忽略)
+     * @param[in] chunked 是否chunked编码
+     */
+    HttpBodyStream(HttpSession* session, uint64_t content_length, bool chunked);
+
+    /**
+     * @brief 读取解码后的消息体
+     * @return >0 读取长度, =0 消息体已读完或连接关闭(用isFinished区分), <0 错误
+     */
+    virtual int read(void* buffer, size_t length) override;
+    virtual int read(ByteArray::ptr ba, size_t length) override;
+    virtual int write(const void* buffer, size_t length) override { return -1;}
+    virtual int write(ByteArray::ptr ba, size_t length) override { return -1;}
+
+    /**
+     * @brief 不关闭连接, 未读完的消息体由HttpServer决定是否断开连接
+     */
+    virtual void close() override {}
+
+    /**
+     * @brief 是否chunked编码
+     */
+    bool isChunked() const { return m_chunked;}
+
+    /**
+     * @brief 消息体是否已读完
+     */
+    bool isFinished() const { return m_finished;}
+
+    /**
+     * @brief 返回Content-Length(chunked时为0)
+     */
+    uint64_t getContentLength() const { return m_contentLength;}
+
+    /**
+     * @brief 返回已读取的消息体长度
+     */
+    uint64_t getReadSize() const { return m_readSize;}
+private:
+    /**
+     * @brief 读取下一个chunk的长度行(以及上一个chunk结尾的CRLF和trailer)
+     * @return >0 成功, =0 连接关闭, <0 格式错误
+     */
+    int readChunkHeader();
+
+    /**
+     * @brief 读取一行(不含CRLF), 多读的数据放回连接
+     */
+    int readLine(std::string& line);
+private:
+    /// HTTP连接
+    HttpSession* m_session;
+    /// Content-Length
+    uint64_t m_contentLength;
+    /// 当前(chunk)剩余未读长度
+    uint64_t m_left;
+    /// 已读取长度
+    uint64_t m_readSize;
+    /// 是否chunked编码
+    bool m_chunked;
+    /// 是否已读完
+    bool m_finished;
+    /// 读下一个chunk前是否需要先读上一个chunk结尾的CRLF
+    bool m_needCRLF;
+};
+
+/**
+ * @brief HTTP响应chunked写入流
+ * @details 第一次写入(或close)时发送响应头, 之后每次write发送一个chunk,
+ *          写入阻塞当前协程直到数据进入socket发送缓冲区, 以此实现背压.
+ *          close发送结束chunk, 不关闭连接. HTTP/1.0的请求不使用chunked,
+ *          直接写消息体并在响应后关闭连接
+ */
+class HttpChunkedWriter : public Stream {
+public:
+    /// 智能指针类型定义
+    typedef std::shared_ptr<HttpChunkedWriter> ptr;
+
+    /**
+     * @brief 创建流式响应, 并设置为rsp的消息体写入流
+     * @details HttpServer在Servlet返回后调用close结束响应, 不再调用sendResponse
+     * @param[in] session HTTP连接
+     * @param[in] rsp HTTP响应, rsp中已设置的body作为第一个chunk发送
+     */
+    static HttpChunkedWriter::ptr Create(HttpSession* session, HttpResponse::ptr rsp);
+
+    virtual int read(void* buffer, size_t length) override { return -1;}
+    virtual int read(ByteArray::ptr ba, size_t length) override { return -1;}
+
+    /**
+     * @brief 发送一个chunk
+     * @return >0 发送的数据长度, =0 连接关闭, <0 错误
+     */
+    virtual int write(const void* buffer, size_t length) override;
+    virtual int write(ByteArray::ptr ba, size_t length) override;
+
+    /**
+     * @brief 发送结束chunk(未发送过响应头时先发送响应头)
+     */
+    virtual void close() override;
+
+    /**
+     * @brief 发送响应头
+     * @return >0 成功, <=0 失败
+     */
+    int flushHeader();
+
+    /**
+     * @brief 是否已发送响应头
+     */
+    bool isHeaderSent() const { return m_headerSent;}
+
+    /**
+     * @brief 是否已结束
+     */
+    bool isFinished() const { return m_finished;}
+
+    /**
+     * @brief 返回已发送的消息体长度
+     */
+    uint64_t getWriteSize() const { return m_writeSize;}
+private:
+    HttpChunkedWriter(HttpSession* session, HttpResponse::ptr rsp);
+private:
+    /// HTTP连接
+    HttpSession* m_session;
+    /// HTTP响应(响应持有写入流, 这里不能持有响应)
+    std::weak_ptr<HttpResponse> m_response;
+    /// 已发送的消息体长度
+    uint64_t m_writeSize;
+    /// 是否chunked编码
+    bool m_chunked;
+    /// 是否已发送响应头
+    bool m_headerSent;
+    /// 是否已结束
+    bool m_finished;
+};
+
+}
+}
+
+#endif
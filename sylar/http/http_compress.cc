@@ -0,0 +1,442 @@
+#include "http_compress.h"
+#include "sylar/config.h"
+#include "sylar/log.h"
+#include "sylar/ds/cache_status.h"
+#include <zlib.h>
+#include <string.h>
+#include <time.h>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<bool>::ptr g_http_compress_enable =
+    sylar::Config::Lookup("http.compress.enable"
+                ,false, "http response compress enable");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_compress_min_size =
+    sylar::Config::Lookup("http.compress.min_size"
+                ,(uint64_t)1024, "http response compress min body size");
+
+static sylar::ConfigVar<int32_t>::ptr g_http_compress_level =
+    sylar::Config::Lookup("http.compress.level"
+                ,(int32_t)6, "http response compress level");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_compress_cache_size =
+    sylar::Config::Lookup("http.compress.cache_size"
+                ,(uint64_t)1024, "http precompressed body cache size");
+
+static sylar::ConfigVar<uint64_t>::ptr g_http_compress_cache_bytes =
+    sylar::Config::Lookup("http.compress.cache_bytes"
+                ,(uint64_t)64 * 1024 * 1024, "http precompressed body cache max bytes");
+
+static bool s_http_compress_enable = false;
+static uint64_t s_http_compress_min_size = 0;
+static int32_t s_http_compress_level = 6;
+
+namespace {
+
+/**
+ * @brief 压缩结果缓存, 按条目数和字节数(key+压缩结果)淘汰最久未使用的
+ * @details 分16个桶各自加锁, 每个桶的上限为总上限的1/16,
+ *          超过单桶字节上限的结果不缓存
+ */
+class CompressCache {
+public:
+    typedef std::shared_ptr<std::string> ValuePtr;
+    typedef sylar::Mutex MutexType;
+    static const size_t BUCKET = 16;
+
+    CompressCache(uint64_t max_size, uint64_t max_bytes)
+        :m_buckets(BUCKET) {
+        setLimit(max_size, max_bytes);
+    }
+
+    void setLimit(uint64_t max_size, uint64_t max_bytes) {
+        m_maxSize = (max_size + BUCKET - 1) / BUCKET;
+        m_maxBytes = (max_bytes + BUCKET - 1) / BUCKET;
+    }
+
+    bool get(const std::string& k, ValuePtr& v) {
+        m_status.incGet();
+        Bucket& b = getBucket(k);
+        MutexType::Lock lock(b.mutex);
+        auto it = b.index.find(k);
+        if(it == b.index.end()) {
+            return false;
+        }
+        b.items.splice(b.items.begin(), b.items, it->second);
+        v = it->second->second;
+        lock.unlock();
+        m_status.incHit();
+        return true;
+    }
+
+    void set(const std::string& k, ValuePtr v) {
+        uint64_t bytes = k.size() + v->size();
+        if(bytes > m_maxBytes) {
+            return;
+        }
+        m_status.incSet();
+        Bucket& b = getBucket(k);
+        MutexType::Lock lock(b.mutex);
+        auto it = b.index.find(k);
+        if(it != b.index.end()) {
+            b.bytes -= k.size() + it->second->second->size();
+            b.items.erase(it->second);
+            b.index.erase(it);
+        }
+        b.items.emplace_front(k, v);
+        b.index[k] = b.items.begin();
+        b.bytes += bytes;
+        int64_t count = 0;
+        while(b.items.size() > m_maxSize || b.bytes > m_maxBytes) {
+            auto& back = b.items.back();
+            b.bytes -= back.first.size() + back.second->size();
+            b.index.erase(back.first);
+            b.items.pop_back();
+            ++count;
+        }
+        if(count) {
+            m_status.incPrune(count);
+        }
+    }
+
+    void getInfo(size_t& size, uint64_t& bytes) {
+        size = 0;
+        bytes = 0;
+        for(auto& b : m_buckets) {
+            MutexType::Lock lock(b.mutex);
+            size += b.items.size();
+            bytes += b.bytes;
+        }
+    }
+
+    std::string toStatusString() {
+        size_t size = 0;
+        uint64_t bytes = 0;
+        getInfo(size, bytes);
+        std::stringstream ss;
+        ss << m_status.toString() << " total=" << size << " bytes=" << bytes;
+        return ss.str();
+    }
+private:
+    struct Bucket {
+        MutexType mutex;
+        std::list<std::pair<std::string, ValuePtr> > items;
+        std::unordered_map<std::string
+            ,std::list<std::pair<std::string, ValuePtr> >::iterator> index;
+        uint64_t bytes = 0;
+    };
+
+    Bucket& getBucket(const std::string& k) {
+        return m_buckets[std::hash<std::string>()(k) % BUCKET];
+    }
+private:
+    std::vector<Bucket> m_buckets;
+    uint64_t m_maxSize;
+    uint64_t m_maxBytes;
+    sylar::ds::CacheStatus m_status;
+};
+
+}
+
+static CompressCache* GetCompressCache() {
+    static CompressCache* s_cache = new CompressCache(
+                    g_http_compress_cache_size->getValue()
+                    ,g_http_compress_cache_bytes->getValue());
+    return s_cache;
+}
+
+namespace {
+struct _CompressIniter {
+    _CompressIniter() {
+        s_http_compress_enable = g_http_compress_enable->getValue();
+        s_http_compress_min_size = g_http_compress_min_size->getValue();
+        s_http_compress_level = g_http_compress_level->getValue();
+
+        g_http_compress_enable->addListener(
+                [](const bool& ov, const bool& nv){
+                s_http_compress_enable = nv;
+        });
+
+        g_http_compress_min_size->addListener(
+                [](const uint64_t& ov, const uint64_t& nv){
+                s_http_compress_min_size = nv;
+        });
+
+        g_http_compress_level->addListener(
+                [](const int32_t& ov, const int32_t& nv){
+                s_http_compress_level = nv;
+        });
+
+        g_http_compress_cache_size->addListener(
+                [](const uint64_t& ov, const uint64_t& nv){
+                GetCompressCache()->setLimit(nv, g_http_compress_cache_bytes->getValue());
+        });
+
+        g_http_compress_cache_bytes->addListener(
+                [](const uint64_t& ov, const uint64_t& nv){
+                GetCompressCache()->setLimit(g_http_compress_cache_size->getValue(), nv);
+        });
+    }
+};
+static _CompressIniter _init;
+
+/**
+ * @brief 线程内复用的deflate上下文, 每种编码一个, 用deflateReset重置
+ */
+struct ThreadDeflater {
+    ThreadDeflater() {
+        memset(zs, 0, sizeof(zs));
+        for(int i = 0; i < 2; ++i) {
+            inited[i] = false;
+            levels[i] = 0;
+        }
+    }
+
+    ~ThreadDeflater() {
+        for(int i = 0; i < 2; ++i) {
+            if(inited[i]) {
+                deflateEnd(&zs[i]);
+            }
+        }
+    }
+
+    z_stream* get(HttpCompressor::Encoding e, int level) {
+        int idx = e == HttpCompressor::GZIP ? 0 : 1;
+        if(inited[idx] && levels[idx] != level) {
+            deflateEnd(&zs[idx]);
+            inited[idx] = false;
+        }
+        if(inited[idx]) {
+            deflateReset(&zs[idx]);
+            return &zs[idx];
+        }
+        memset(&zs[idx], 0, sizeof(zs[idx]));
+        //gzip: 15 + 16, deflate(zlib格式): 15
+        int window_bits = e == HttpCompressor::GZIP ? 15 + 16 : 15;
+        if(deflateInit2(&zs[idx], level, Z_DEFLATED, window_bits
+                    ,8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return nullptr;
+        }
+        inited[idx] = true;
+        levels[idx] = level;
+        return &zs[idx];
+    }
+
+    z_stream zs[2];
+    bool inited[2];
+    int levels[2];
+};
+
+static thread_local ThreadDeflater t_deflater;
+
+uint64_t GetThreadCpuUS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000 * 1000ul + ts.tv_nsec / 1000;
+}
+
+}
+
+std::string HttpCompressStatus::toString() const {
+    std::stringstream ss;
+    int64_t saved = m_bytesIn - m_bytesOut;
+    ss << "request=" << m_request
+       << " compressed=" << m_compressed
+       << " bytes_in=" << m_bytesIn
+       << " bytes_out=" << m_bytesOut
+       << " saved=" << saved
+       << " ratio=" << (m_bytesIn ? (m_bytesOut * 100.0 / m_bytesIn) : 0) << "%"
+       << " cpu_us=" << m_cpuUs
+       << " cpu_us_per_mb_saved=" << (saved > 0 ? (m_cpuUs * 1024.0 * 1024 / saved) : 0)
+       << " cache_hit=" << m_cacheHit
+       << " cache_miss=" << m_cacheMiss;
+    return ss.str();
+}
+
+HttpCompressor::Encoding HttpCompressor::Negotiate(const std::string& accept_encoding) {
+    if(accept_encoding.empty()) {
+        return IDENTITY;
+    }
+    double gzip_q = -1;
+    double deflate_q = -1;
+    double any_q = -1;
+    size_t pos = 0;
+    while(pos < accept_encoding.size()) {
+        size_t end = accept_encoding.find(',', pos);
+        if(end == std::string::npos) {
+            end = accept_encoding.size();
+        }
+        std::string item = accept_encoding.substr(pos, end - pos);
+        pos = end + 1;
+
+        double q = 1;
+        size_t semi = item.find(';');
+        std::string name = sylar::StringUtil::Trim(item.substr(0, semi));
+        if(semi != std::string::npos) {
+            size_t qpos = item.find("q=", semi);
+            if(qpos != std::string::npos) {
+                q = atof(item.c_str() + qpos + 2);
+            }
+        }
+        if(strcasecmp(name.c_str(), "gzip") == 0
+                || strcasecmp(name.c_str(), "x-gzip") == 0) {
+            gzip_q = q;
+        } else if(strcasecmp(name.c_str(), "deflate") == 0) {
+            deflate_q = q;
+        } else if(name == "*") {
+            any_q = q;
+        }
+    }
+    if(gzip_q < 0) {
+        gzip_q = any_q;
+    }
+    if(deflate_q < 0) {
+        deflate_q = any_q;
+    }
+    if(gzip_q <= 0 && deflate_q <= 0) {
+        return IDENTITY;
+    }
+    return gzip_q >= deflate_q ? GZIP : DEFLATE;
+}
+
+const char* HttpCompressor::EncodingToString(Encoding e) {
+    switch(e) {
+        case GZIP:
+            return "gzip";
+        case DEFLATE:
+            return "deflate";
+        default:
+            return "identity";
+    }
+}
+
+bool HttpCompressor::Compress(Encoding e, const void* data, size_t size
+                              ,std::string& out, int level) {
+    if(e == IDENTITY || size > UINT32_MAX) {
+        return false;
+    }
+    z_stream* zs = t_deflater.get(e, level);
+    if(!zs) {
+        SYLAR_LOG_ERROR(g_logger) << "deflateInit2 fail, encoding="
+            << EncodingToString(e) << " level=" << level;
+        return false;
+    }
+    out.resize(deflateBound(zs, size));
+    zs->next_in = (Bytef*)data;
+    zs->avail_in = size;
+    zs->next_out = (Bytef*)&out[0];
+    zs->avail_out = out.size();
+    int ret = deflate(zs, Z_FINISH);
+    if(ret != Z_STREAM_END) {
+        SYLAR_LOG_ERROR(g_logger) << "deflate fail, ret=" << ret
+            << " encoding=" << EncodingToString(e) << " size=" << size;
+        out.clear();
+        return false;
+    }
+    out.resize(zs->total_out);
+    return true;
+}
+
+bool HttpCompressor::IsCompressibleType(const std::string& content_type) {
+    if(content_type.empty()) {
+        return false;
+    }
+    const char* ct = content_type.c_str();
+    return strncasecmp(ct, "text/", 5) == 0
+        || strcasestr(ct, "json") != nullptr
+        || strcasestr(ct, "javascript") != nullptr
+        || strcasestr(ct, "xml") != nullptr
+        || strcasestr(ct, "x-www-form-urlencoded") != nullptr;
+}
+
+bool HttpCompressor::CompressResponse(HttpRequest::ptr req, HttpResponse::ptr rsp) {
+    if(!s_http_compress_enable || rsp->isWebsocket()) {
+        return false;
+    }
+    const std::string& body = rsp->getBody();
+    if(body.size() < s_http_compress_min_size
+            || body.empty()
+            || !rsp->getHeader("Content-Encoding").empty()
+            || !IsCompressibleType(rsp->getHeader("Content-Type"))) {
+        return false;
+    }
+    HttpCompressStatus* status = GetStatus();
+    status->incRequest();
+    //追加到servlet已设置的Vary, 不覆盖
+    std::string vary = rsp->getHeader("Vary");
+    if(vary.empty()) {
+        rsp->setHeader("Vary", "Accept-Encoding");
+    } else if(vary != "*" && !strcasestr(vary.c_str(), "Accept-Encoding")) {
+        rsp->setHeader("Vary", vary + ", Accept-Encoding");
+    }
+    Encoding e = Negotiate(req->getHeader("Accept-Encoding"));
+    if(e == IDENTITY) {
+        return false;
+    }
+
+    std::shared_ptr<std::string> out;
+    std::string key;
+    if(rsp->isCompressCacheable()) {
+        uint64_t hash = sylar::murmur3_hash64((const void*)body.c_str(), body.size());
+        key.reserve(req->getPath().size() + 32);
+        key.append(1, (char)('0' + e));
+        key.append(req->getPath());
+        key.append(1, '\0');
+        key.append((const char*)&hash, sizeof(hash));
+        uint64_t size = body.size();
+        key.append((const char*)&size, sizeof(size));
+        if(GetCompressCache()->get(key, out)) {
+            status->incCacheHit();
+        } else {
+            status->incCacheMiss();
+        }
+    }
+
+    if(!out) {
+        out = std::make_shared<std::string>();
+        uint64_t ts = GetThreadCpuUS();
+        if(!Compress(e, body.c_str(), body.size(), *out, s_http_compress_level)) {
+            return false;
+        }
+        status->incCpuUs(GetThreadCpuUS() - ts);
+        if(!key.empty()) {
+            GetCompressCache()->set(key, out);
+        }
+    }
+
+    if(out->size() >= body.size()) {
+        return false;
+    }
+    status->incCompressed();
+    status->incBytesIn(body.size());
+    status->incBytesOut(out->size());
+    rsp->setBody(*out);
+    rsp->setHeader("Content-Encoding", EncodingToString(e));
+    return true;
+}
+
+HttpCompressStatus* HttpCompressor::GetStatus() {
+    static HttpCompressStatus s_status;
+    return &s_status;
+}
+
+void HttpCompressor::GetCacheInfo(size_t& size, uint64_t& bytes) {
+    GetCompressCache()->getInfo(size, bytes);
+}
+
+std::string HttpCompressor::StatusString() {
+    std::stringstream ss;
+    ss << GetStatus()->toString() << std::endl
+       << "cache: " << GetCompressCache()->toStatusString();
+    return ss.str();
+}
+
+}
+}
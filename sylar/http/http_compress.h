@@ -0,0 +1,129 @@
+/**
+ * @file http_compress.h
+ * @brief HTTP响应压缩(gzip/deflate)
+ * @author sylar.yin
+ * @email 564628276@qq.com
+ * @date 2019-06-09
+ * @copyright Copyright (c) 2019年 sylar.yin All rights reserved (www.sylar.top)
+ */
+#ifndef __SYLAR_HTTP_HTTP_COMPRESS_H__
+#define __SYLAR_HTTP_HTTP_COMPRESS_H__
+
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include "http.h"
+#include "sylar/util.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief HTTP压缩统计
+ */
+class HttpCompressStatus {
+public:
+    int64_t incRequest(int64_t v = 1) { return Atomic::addFetch(m_request, v);}
+    int64_t incCompressed(int64_t v = 1) { return Atomic::addFetch(m_compressed, v);}
+    int64_t incBytesIn(int64_t v) { return Atomic::addFetch(m_bytesIn, v);}
+    int64_t incBytesOut(int64_t v) { return Atomic::addFetch(m_bytesOut, v);}
+    int64_t incCpuUs(int64_t v) { return Atomic::addFetch(m_cpuUs, v);}
+    int64_t incCacheHit(int64_t v = 1) { return Atomic::addFetch(m_cacheHit, v);}
+    int64_t incCacheMiss(int64_t v = 1) { return Atomic::addFetch(m_cacheMiss, v);}
+
+    int64_t getRequest() const { return m_request;}
+    int64_t getCompressed() const { return m_compressed;}
+    int64_t getBytesIn() const { return m_bytesIn;}
+    int64_t getBytesOut() const { return m_bytesOut;}
+    int64_t getCpuUs() const { return m_cpuUs;}
+    int64_t getCacheHit() const { return m_cacheHit;}
+    int64_t getCacheMiss() const { return m_cacheMiss;}
+
+    std::string toString() const;
+private:
+    /// 经过压缩判断的响应数
+    int64_t m_request = 0;
+    /// 实际压缩的响应数(含缓存命中)
+    int64_t m_compressed = 0;
+    /// 压缩前字节数
+    int64_t m_bytesIn = 0;
+    /// 压缩后字节数
+    int64_t m_bytesOut = 0;
+    /// 压缩消耗的线程CPU时间(微秒),缓存命中不计
+    int64_t m_cpuUs = 0;
+    /// 预压缩缓存命中
+    int64_t m_cacheHit = 0;
+    /// 预压缩缓存未命中
+    int64_t m_cacheMiss = 0;
+};
+
+/**
+ * @brief HTTP响应压缩
+ * @details 根据请求的Accept-Encoding协商gzip/deflate, 超过最小长度且
+ *          Content-Type可压缩的响应体才会压缩. 每个线程复用一个z_stream,
+ *          HttpResponse::setCompressCacheable(true)的响应会缓存压缩结果,
+ *          缓存按条目数和字节数淘汰
+ *          配置项: http.compress.enable(默认关闭) / min_size / level / cache_size / cache_bytes
+ */
+class HttpCompressor {
+public:
+    /// 内容编码
+    enum Encoding {
+        IDENTITY = 0,
+        GZIP = 1,
+        DEFLATE = 2
+    };
+
+    /**
+     * @brief 根据Accept-Encoding选择编码, 支持q值, 同等q值优先gzip
+     */
+    static Encoding Negotiate(const std::string& accept_encoding);
+
+    /**
+     * @brief 编码名称(gzip/deflate/identity)
+     */
+    static const char* EncodingToString(Encoding e);
+
+    /**
+     * @brief 压缩数据, 使用当前线程复用的z_stream
+     * @param[in] e 编码(GZIP/DEFLATE)
+     * @param[in] data 数据
+     * @param[in] size 数据长度
+     * @param[out] out 压缩结果
+     * @param[in] level 压缩级别
+     * @return 是否成功
+     */
+    static bool Compress(Encoding e, const void* data, size_t size
+                         ,std::string& out, int level);
+
+    /**
+     * @brief 按请求协商结果压缩响应体, 并设置Content-Encoding, 在Vary中追加Accept-Encoding
+     * @return 是否压缩
+     */
+    static bool CompressResponse(HttpRequest::ptr req, HttpResponse::ptr rsp);
+
+    /**
+     * @brief Content-Type是否值得压缩
+     */
+    static bool IsCompressibleType(const std::string& content_type);
+
+    /**
+     * @brief 返回全局统计
+     */
+    static HttpCompressStatus* GetStatus();
+
+    /**
+     * @brief 返回压缩结果缓存的条目数和字节数
+     */
+    static void GetCacheInfo(size_t& size, uint64_t& bytes);
+
+    /**
+     * @brief 返回统计和缓存信息
+     */
+    static std::string StatusString();
+};
+
+}
+}
+
+#endif
@@ -1,5 +1,7 @@
 #include "http_server.h"
 #include "sylar/log.h"
+#include "http_compress.h"
+#include "http_body_stream.h"
 #include "sylar/http/servlets/config_servlet.h"
 #include "sylar/http/servlets/status_servlet.h"
 
@@ -30,7 +32,7 @@ void HttpServer::handleClient(Socket::ptr client) {
     SYLAR_LOG_DEBUG(g_logger) << "handleClient " << *client;
     HttpSession::ptr session(new HttpSession(client));
     do {
-        auto req = session->recvRequest();
+        auto req = session->recvRequestHeader();
         if(!req) {
             SYLAR_LOG_DEBUG(g_logger) << "recv http request fail, errno="
                 << errno << " errstr=" << strerror(errno)
@@ -41,10 +43,46 @@ void HttpServer::handleClient(Socket::ptr client) {
         HttpResponse::ptr rsp(new HttpResponse(req->getVersion()
                             ,req->isClose() || !m_isKeepalive));
         rsp->setHeader("Server", getName());
-        m_dispatch->handle(req, rsp, session);
-        session->sendResponse(rsp);
 
-        if(!m_isKeepalive || req->isClose()) {
+        //先用路由结果决定是否流式读取消息体, 处理时传入同一结果, 不再二次匹配;
+        //仍然经过m_dispatch的虚函数handle, 保证重写了handle的ServletDispatch子类生效
+        Servlet::ptr slt = m_dispatch->route(req);
+        HttpBodyStream::ptr body;
+        if(slt && slt->isStreamBody()) {
+            body = HttpBodyStream::Create(session.get(), req);
+            req->setBodyStream(body);
+        } else {
+            int64_t rt = session->readBody(req);
+            if(rt == -2) {
+                //消息体没有读完, 响应后断开
+                rsp->setStatus(HttpStatus::PAYLOAD_TOO_LARGE);
+                rsp->setClose(true);
+                session->sendResponse(rsp);
+                break;
+            } else if(rt < 0) {
+                SYLAR_LOG_DEBUG(g_logger) << "recv http request body fail, errno="
+                    << errno << " errstr=" << strerror(errno)
+                    << " cliet:" << *client << " path=" << req->getPath();
+                break;
+            }
+        }
+
+        m_dispatch->handle(req, rsp, session, slt);
+        //Servlet没有读完的消息体不再读取, 响应后直接断开
+        if(body && !body->isFinished()) {
+            rsp->setClose(true);
+        }
+        if(rsp->getBodyWriter()) {
+            rsp->getBodyWriter()->close();
+        } else {
+            HttpCompressor::CompressResponse(req, rsp);
+            //发送失败(包括文件在发送中被截断)时连接上的数据已不完整, 直接断开
+            if(session->sendResponse(rsp) <= 0) {
+                break;
+            }
+        }
+
+        if(!m_isKeepalive || req->isClose() || rsp->isClose()) {
             break;
         }
     } while(true);
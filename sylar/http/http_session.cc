@@ -1,5 +1,6 @@
 #include "http_session.h"
 #include "http_parser.h"
+#include "http_body_stream.h"
 
 namespace sylar {
 namespace http {
@@ -9,6 +10,18 @@ HttpSession::HttpSession(Socket::ptr sock, bool owner)
 }
 
 HttpRequest::ptr HttpSession::recvRequest() {
+    HttpRequest::ptr req = recvRequestHeader();
+    if(!req) {
+        return nullptr;
+    }
+    if(readBody(req) < 0) {
+        close();
+        return nullptr;
+    }
+    return req;
+}
+
+HttpRequest::ptr HttpSession::recvRequestHeader() {
     HttpRequestParser::ptr parser(new HttpRequestParser);
     uint64_t buff_size = HttpRequestParser::GetHttpRequestBufferSize();
     //uint64_t buff_size = 100;
@@ -39,38 +52,128 @@ HttpRequest::ptr HttpSession::recvRequest() {
             break;
         }
     } while(true);
-    int64_t length = parser->getContentLength();
-    if(length > 0) {
-        std::string body;
-        body.resize(length);
+    //多读的部分是消息体(或下一个请求), 放回连接
+    if(offset > 0) {
+        unread(data, offset);
+    }
+    parser->getData()->init();
+    return parser->getData();
+}
 
-        int len = 0;
-        if(length >= offset) {
-            memcpy(&body[0], data, offset);
-            len = offset;
-        } else {
-            memcpy(&body[0], data, length);
-            len = length;
+int64_t HttpSession::readBody(HttpRequest::ptr req) {
+    HttpBodyStream::ptr stream = HttpBodyStream::Create(this, req);
+    if(!stream) {
+        return 0;
+    }
+    uint64_t max_size = HttpRequestParser::GetHttpRequestMaxBodySize();
+    std::string body;
+    if(!stream->isChunked()) {
+        uint64_t length = stream->getContentLength();
+        if(max_size && length > max_size) {
+            return -2;
+        }
+        body.resize(length);
+        if(stream->readFixSize(&body[0], length) <= 0) {
+            return -1;
         }
-        length -= offset;
-        if(length > 0) {
-            if(readFixSize(&body[len], length) <= 0) {
-                close();
-                return nullptr;
+    } else {
+        size_t len = 0;
+        while(!stream->isFinished()) {
+            if(body.size() - len < 4096) {
+                body.resize(std::max(body.size() * 2, (size_t)8192));
+            }
+            int rt = stream->read(&body[len], body.size() - len);
+            if(rt < 0 || (rt == 0 && !stream->isFinished())) {
+                return -1;
+            }
+            len += rt;
+            if(max_size && len > max_size) {
+                return -2;
             }
         }
-        parser->getData()->setBody(body);
+        body.resize(len);
     }
+    req->setBody(body);
+    return body.size();
+}
 
-    parser->getData()->init();
-    return parser->getData();
+int HttpSession::read(void* buffer, size_t length) {
+    if(m_pendingOffset < m_pending.size()) {
+        size_t n = std::min(length, m_pending.size() - m_pendingOffset);
+        memcpy(buffer, &m_pending[m_pendingOffset], n);
+        consumePending(n);
+        return n;
+    }
+    return SocketStream::read(buffer, length);
+}
+
+int HttpSession::read(ByteArray::ptr ba, size_t length) {
+    if(m_pendingOffset < m_pending.size()) {
+        size_t n = std::min(length, m_pending.size() - m_pendingOffset);
+        ba->write(&m_pending[m_pendingOffset], n);
+        consumePending(n);
+        return n;
+    }
+    return SocketStream::read(ba, length);
+}
+
+int HttpSession::read(BufferChain& chain, size_t length) {
+    if(m_pendingOffset < m_pending.size()) {
+        size_t n = std::min(length, m_pending.size() - m_pendingOffset);
+        chain.append(&m_pending[m_pendingOffset], n);
+        consumePending(n);
+        return n;
+    }
+    return SocketStream::read(chain, length);
+}
+
+void HttpSession::consumePending(size_t n) {
+    m_pendingOffset += n;
+    if(m_pendingOffset == m_pending.size()) {
+        m_pending.clear();
+        m_pendingOffset = 0;
+    }
+}
+
+void HttpSession::unread(const void* buffer, size_t length) {
+    if(length == 0) {
+        return;
+    }
+    if(m_pendingOffset >= length) {
+        m_pendingOffset -= length;
+        memcpy(&m_pending[m_pendingOffset], buffer, length);
+        return;
+    }
+    std::string tmp((const char*)buffer, length);
+    tmp.append(m_pending, m_pendingOffset, std::string::npos);
+    m_pending.swap(tmp);
+    m_pendingOffset = 0;
 }
 
 int HttpSession::sendResponse(HttpResponse::ptr rsp) {
     std::stringstream ss;
     ss << *rsp;
     std::string data = ss.str();
-    return writeFixSize(data.c_str(), data.size());
+    HttpFileBody::ptr file = rsp->getFileBody();
+    if(!file || file->length == 0) {
+        return writeFixSize(data.c_str(), data.size());
+    }
+    if(!file->data) {
+        int rt = writeFixSize(data.c_str(), data.size());
+        if(rt <= 0) {
+            return rt;
+        }
+        int64_t n = sendFile(file->fd, file->offset, file->length);
+        return n <= 0 ? n : rt;
+    }
+
+    //文件内容已在内存中, 响应头和文件内容一次writev发送
+    iovec iovs[2];
+    iovs[0].iov_base = (void*)data.c_str();
+    iovs[0].iov_len = data.size();
+    iovs[1].iov_base = (void*)(file->data + file->offset);
+    iovs[1].iov_len = file->length;
+    return writevFixSize(iovs, 2);
 }
 
 }
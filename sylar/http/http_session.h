@@ -32,10 +32,44 @@ public:
     HttpSession(Socket::ptr sock, bool owner = true);
 
     /**
-     * @brief 接收HTTP请求
+     * @brief 接收HTTP请求(包括完整的消息体)
      */
     HttpRequest::ptr recvRequest();
 
+    /**
+     * @brief 只接收HTTP请求头, 消息体留在连接中
+     * @details 之后用readBody读取完整消息体, 或用HttpBodyStream流式读取
+     */
+    HttpRequest::ptr recvRequestHeader();
+
+    /**
+     * @brief 读取完整消息体并设置到请求中(支持chunked)
+     * @param[in] req recvRequestHeader返回的请求
+     * @return >=0 消息体长度, -2 超过最大消息体长度, 其他<0 连接错误
+     */
+    int64_t readBody(HttpRequest::ptr req);
+
+    /**
+     * @brief 读数据, 优先返回已缓存(多读)的数据
+     */
+    virtual int read(void* buffer, size_t length) override;
+
+    /**
+     * @brief 读数据到ByteArray, 优先返回已缓存(多读)的数据
+     */
+    virtual int read(ByteArray::ptr ba, size_t length) override;
+
+    /**
+     * @brief 读数据到BufferChain, 优先返回已缓存(多读)的数据
+     * @details websocket握手后按帧读取时走这个接口, 握手请求之后多读的帧数据不能丢
+     */
+    virtual int read(BufferChain& chain, size_t length) override;
+
+    /**
+     * @brief 把多读的数据放回连接, 下次read优先返回
+     */
+    void unread(const void* buffer, size_t length);
+
     /**
      * @brief 发送HTTP响应
      * @param[in] rsp HTTP响应
@@ -44,6 +78,16 @@ public:
      *         <0 Socket异常
      */
     int sendResponse(HttpResponse::ptr rsp);
+private:
+    /**
+     * @brief 标记已消费n个缓存的数据, 全部消费后释放缓存
+     */
+    void consumePending(size_t n);
+private:
+    /// 已从socket读出但未消费的数据
+    std::string m_pending;
+    /// m_pending中已消费的长度
+    size_t m_pendingOffset = 0;
 };
 
 }
@@ -1,9 +1,12 @@
 #include "servlet.h"
+#include "sylar/log.h"
 #include <fnmatch.h>
 
 namespace sylar {
 namespace http {
 
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
 FunctionServlet::FunctionServlet(callback cb)
     :Servlet("FunctionServlet")
     ,m_cb(cb) {
@@ -18,28 +21,83 @@ int32_t FunctionServlet::handle(sylar::http::HttpRequest::ptr request
 
 
 ServletDispatch::ServletDispatch()
-    :Servlet("ServletDispatch") {
+    :Servlet("ServletDispatch")
+    ,m_router(new RouterType)
+    ,m_dirty(false) {
     m_default.reset(new NotFoundServlet("sylar/1.0"));
 }
 
+namespace {
+
+/**
+ * @brief 已经route过的请求, 经过子类重写的handle后由ServletDispatch::handle取用
+ */
+struct RoutedServlet {
+    const ServletDispatch* dispatch = nullptr;
+    const HttpRequest* request = nullptr;
+    Servlet::ptr servlet;
+
+    void reset() {
+        dispatch = nullptr;
+        request = nullptr;
+        servlet = nullptr;
+    }
+};
+
+static thread_local RoutedServlet t_routed;
+
+}
+
 int32_t ServletDispatch::handle(sylar::http::HttpRequest::ptr request
                , sylar::http::HttpResponse::ptr response
                , sylar::http::HttpSession::ptr session) {
-    auto slt = getMatchedServlet(request->getPath());
+    Servlet::ptr slt;
+    //子类的handle中协程切换过时可能取不到, 退回重新route
+    if(t_routed.dispatch == this && t_routed.request == request.get()) {
+        slt.swap(t_routed.servlet);
+        t_routed.reset();
+    } else {
+        slt = route(request);
+    }
     if(slt) {
         slt->handle(request, response, session);
     }
     return 0;
 }
 
+int32_t ServletDispatch::handle(sylar::http::HttpRequest::ptr request
+               , sylar::http::HttpResponse::ptr response
+               , sylar::http::HttpSession::ptr session
+               , Servlet::ptr slt) {
+    t_routed.dispatch = this;
+    t_routed.request = request.get();
+    t_routed.servlet = slt;
+    int32_t rt = handle(request, response, session);
+    if(t_routed.dispatch == this && t_routed.request == request.get()) {
+        t_routed.reset();
+    }
+    return rt;
+}
+
+Servlet::ptr ServletDispatch::route(sylar::http::HttpRequest::ptr request) {
+    RouterType::ParamMap params;
+    auto slt = getMatchedServlet(request->getPath(), &params);
+    for(auto& i : params) {
+        request->setRouteParam(i.first, i.second);
+    }
+    return slt;
+}
+
 void ServletDispatch::addServlet(const std::string& uri, Servlet::ptr slt) {
     RWMutexType::WriteLock lock(m_mutex);
     m_datas[uri] = std::make_shared<HoldServletCreator>(slt);
+    m_dirty = true;
 }
 
 void ServletDispatch::addServletCreator(const std::string& uri, IServletCreator::ptr creator) {
     RWMutexType::WriteLock lock(m_mutex);
     m_datas[uri] = creator;
+    m_dirty = true;
 }
 
 void ServletDispatch::addGlobServletCreator(const std::string& uri, IServletCreator::ptr creator) {
@@ -52,6 +110,18 @@ void ServletDispatch::addGlobServletCreator(const std::string& uri, IServletCrea
         }
     }
     m_globs.push_back(std::make_pair(uri, creator));
+    m_dirty = true;
+}
+
+bool ServletDispatch::addParamServletCreator(const std::string& uri, IServletCreator::ptr creator) {
+    if(!RouterType::IsValidParam(uri)) {
+        SYLAR_LOG_ERROR(g_logger) << "addParamServlet invalid uri=" << uri;
+        return false;
+    }
+    RWMutexType::WriteLock lock(m_mutex);
+    m_params[uri] = creator;
+    m_dirty = true;
+    return true;
 }
 
 void ServletDispatch::addServlet(const std::string& uri
@@ -59,6 +129,7 @@ void ServletDispatch::addServlet(const std::string& uri
     RWMutexType::WriteLock lock(m_mutex);
     m_datas[uri] = std::make_shared<HoldServletCreator>(
                         std::make_shared<FunctionServlet>(cb));
+    m_dirty = true;
 }
 
 void ServletDispatch::addGlobServlet(const std::string& uri
@@ -73,6 +144,7 @@ void ServletDispatch::addGlobServlet(const std::string& uri
     }
     m_globs.push_back(std::make_pair(uri
                 , std::make_shared<HoldServletCreator>(slt)));
+    m_dirty = true;
 }
 
 void ServletDispatch::addGlobServlet(const std::string& uri
@@ -80,9 +152,20 @@ void ServletDispatch::addGlobServlet(const std::string& uri
     return addGlobServlet(uri, std::make_shared<FunctionServlet>(cb));
 }
 
+bool ServletDispatch::addParamServlet(const std::string& uri
+                                     ,Servlet::ptr slt) {
+    return addParamServletCreator(uri, std::make_shared<HoldServletCreator>(slt));
+}
+
+bool ServletDispatch::addParamServlet(const std::string& uri
+                                 ,FunctionServlet::callback cb) {
+    return addParamServlet(uri, std::make_shared<FunctionServlet>(cb));
+}
+
 void ServletDispatch::delServlet(const std::string& uri) {
     RWMutexType::WriteLock lock(m_mutex);
     m_datas.erase(uri);
+    m_dirty = true;
 }
 
 void ServletDispatch::delGlobServlet(const std::string& uri) {
@@ -94,6 +177,13 @@ void ServletDispatch::delGlobServlet(const std::string& uri) {
             break;
         }
     }
+    m_dirty = true;
+}
+
+void ServletDispatch::delParamServlet(const std::string& uri) {
+    RWMutexType::WriteLock lock(m_mutex);
+    m_params.erase(uri);
+    m_dirty = true;
 }
 
 Servlet::ptr ServletDispatch::getServlet(const std::string& uri) {
@@ -113,19 +203,39 @@ Servlet::ptr ServletDispatch::getGlobServlet(const std::string& uri) {
     return nullptr;
 }
 
-Servlet::ptr ServletDispatch::getMatchedServlet(const std::string& uri) {
-    RWMutexType::ReadLock lock(m_mutex);
-    auto mit = m_datas.find(uri);
-    if(mit != m_datas.end()) {
-        return mit->second->get();
+Servlet::ptr ServletDispatch::getMatchedServlet(const std::string& uri
+                                    ,RouterType::ParamMap* params) {
+    RouterType::ptr router = getRouter();
+    IServletCreator::ptr creator;
+    if(router->match(uri, creator, params)) {
+        return creator->get();
     }
-    for(auto it = m_globs.begin();
-            it != m_globs.end(); ++it) {
-        if(!fnmatch(it->first.c_str(), uri.c_str(), 0)) {
-            return it->second->get();
+    return m_default;
+}
+
+ServletDispatch::RouterType::ptr ServletDispatch::getRouter() {
+    if(m_dirty) {
+        RWMutexType::WriteLock lock(m_mutex);
+        if(m_dirty) {
+            rebuildRouter();
         }
     }
-    return m_default;
+    return std::atomic_load(&m_router);
+}
+
+void ServletDispatch::rebuildRouter() {
+    RouterType::ptr router(new RouterType);
+    for(auto& i : m_datas) {
+        router->addExact(i.first, i.second);
+    }
+    for(size_t i = 0; i < m_globs.size(); ++i) {
+        router->addGlob(m_globs[i].first, m_globs[i].second, i);
+    }
+    for(auto& i : m_params) {
+        router->addParam(i.first, i.second);
+    }
+    std::atomic_store(&m_router, router);
+    m_dirty = false;
 }
 
 void ServletDispatch::listAllServletCreator(std::map<std::string, IServletCreator::ptr>& infos) {
@@ -142,6 +252,13 @@ void ServletDispatch::listAllGlobServletCreator(std::map<std::string, IServletCr
     }
 }
 
+void ServletDispatch::listAllParamServletCreator(std::map<std::string, IServletCreator::ptr>& infos) {
+    RWMutexType::ReadLock lock(m_mutex);
+    for(auto& i : m_params) {
+        infos[i.first] = i.second;
+    }
+}
+
 NotFoundServlet::NotFoundServlet(const std::string& name)
     :Servlet("NotFoundServlet")
     ,m_name(name) {
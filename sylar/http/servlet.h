@@ -14,8 +14,10 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <atomic>
 #include "http.h"
 #include "http_session.h"
+#include "servlet_router.h"
 #include "sylar/thread.h"
 #include "sylar/util.h"
 
@@ -35,7 +37,8 @@ public:
      * @param[in] name 名称
      */
     Servlet(const std::string& name)
-        :m_name(name) {}
+        :m_name(name)
+        ,m_streamBody(false) {}
 
     /**
      * @brief 析构函数
@@ -57,9 +60,23 @@ public:
      * @brief 返回Servlet名称
      */
     const std::string& getName() const { return m_name;}
+
+    /**
+     * @brief 是否流式读取请求消息体
+     * @details 为true时HttpServer不预先读取消息体,
+     *          Servlet通过HttpRequest::getBodyStream()增量读取
+     */
+    bool isStreamBody() const { return m_streamBody;}
+
+    /**
+     * @brief 设置是否流式读取请求消息体
+     */
+    void setStreamBody(bool v) { m_streamBody = v;}
 protected:
     /// 名称
     std::string m_name;
+    /// 是否流式读取请求消息体
+    bool m_streamBody;
 };
 
 /**
@@ -133,6 +150,9 @@ public:
 
 /**
  * @brief Servlet分发器
+ * @details 增删servlet时只在写锁内修改注册表并标记路由表过期,
+ *          之后第一次匹配时重新编译一次路由表(RadixRouter)并原子替换,
+ *          批量注册只编译一次; 路由表未过期时getMatchedServlet不加锁
  */
 class ServletDispatch : public Servlet {
 public:
@@ -140,6 +160,8 @@ public:
     typedef std::shared_ptr<ServletDispatch> ptr;
     /// 读写锁类型定义
     typedef RWMutex RWMutexType;
+    /// 路由表类型定义
+    typedef RadixRouter<IServletCreator::ptr> RouterType;
 
     /**
      * @brief 构造函数
@@ -149,6 +171,17 @@ public:
                    , sylar::http::HttpResponse::ptr response
                    , sylar::http::HttpSession::ptr session) override;
 
+    /**
+     * @brief 用已经route过的servlet处理请求, 不再匹配路由表
+     * @param[in] slt route(request)的结果
+     * @details 仍然经过虚函数handle, 子类重写的handle照常生效;
+     *          ServletDispatch::handle在同一线程内取到slt时直接使用, 否则重新route
+     */
+    int32_t handle(sylar::http::HttpRequest::ptr request
+                   , sylar::http::HttpResponse::ptr response
+                   , sylar::http::HttpSession::ptr session
+                   , Servlet::ptr slt);
+
     /**
      * @brief 添加servlet
      * @param[in] uri uri
@@ -177,8 +210,26 @@ public:
      */
     void addGlobServlet(const std::string& uri, FunctionServlet::callback cb);
 
+    /**
+     * @brief 添加参数匹配servlet
+     * @param[in] uri uri 参数匹配 /user/:id/info, 末尾段可用 *name 匹配剩余部分
+     * @param[in] slt servlet
+     * @return uri不合法(*name不在末尾)时返回false, 不添加
+     * @details 捕获的参数通过HttpRequest::getRouteParam获取
+     */
+    bool addParamServlet(const std::string& uri, Servlet::ptr slt);
+
+    /**
+     * @brief 添加参数匹配servlet
+     * @param[in] uri uri 参数匹配 /user/:id/info, 末尾段可用 *name 匹配剩余部分
+     * @param[in] cb FunctionServlet回调函数
+     * @return uri不合法时返回false
+     */
+    bool addParamServlet(const std::string& uri, FunctionServlet::callback cb);
+
     void addServletCreator(const std::string& uri, IServletCreator::ptr creator);
     void addGlobServletCreator(const std::string& uri, IServletCreator::ptr creator);
+    bool addParamServletCreator(const std::string& uri, IServletCreator::ptr creator);
 
     template<class T>
     void addServletCreator(const std::string& uri) {
@@ -202,6 +253,12 @@ public:
      */
     void delGlobServlet(const std::string& uri);
 
+    /**
+     * @brief 删除参数匹配servlet
+     * @param[in] uri uri
+     */
+    void delParamServlet(const std::string& uri);
+
     /**
      * @brief 返回默认servlet
      */
@@ -231,12 +288,31 @@ public:
     /**
      * @brief 通过uri获取servlet
      * @param[in] uri uri
-     * @return 优先精准匹配,其次模糊匹配,最后返回默认
+     * @param[out] params 参数匹配时返回捕获的参数, 可为空
+     * @return 优先精准匹配,其次参数匹配,再次模糊匹配,最后返回默认
+     */
+    Servlet::ptr getMatchedServlet(const std::string& uri
+                                   ,RouterType::ParamMap* params = nullptr);
+
+    /**
+     * @brief 匹配请求对应的servlet, 并把捕获的路由参数设置到请求中
+     * @param[in] request HTTP请求
      */
-    Servlet::ptr getMatchedServlet(const std::string& uri);
+    Servlet::ptr route(sylar::http::HttpRequest::ptr request);
 
     void listAllServletCreator(std::map<std::string, IServletCreator::ptr>& infos);
     void listAllGlobServletCreator(std::map<std::string, IServletCreator::ptr>& infos);
+    void listAllParamServletCreator(std::map<std::string, IServletCreator::ptr>& infos);
+private:
+    /**
+     * @brief 返回当前路由表, 过期时先重新编译
+     */
+    RouterType::ptr getRouter();
+
+    /**
+     * @brief 重新编译路由表并原子替换, 调用方需持有写锁
+     */
+    void rebuildRouter();
 private:
     /// 读写互斥量
     RWMutexType m_mutex;
@@ -246,6 +322,13 @@ private:
     /// 模糊匹配servlet 数组
     /// uri(/sylar/*) -> servlet
     std::vector<std::pair<std::string, IServletCreator::ptr> > m_globs;
+    /// 参数匹配servlet MAP
+    /// uri(/sylar/:id) -> servlet
+    std::map<std::string, IServletCreator::ptr> m_params;
+    /// 编译后的路由表, 通过std::atomic_load/atomic_store访问
+    RouterType::ptr m_router;
+    /// 注册表修改后路由表是否过期
+    std::atomic<bool> m_dirty;
     /// 默认servlet，所有路径都没匹配到时使用
     Servlet::ptr m_default;
 };
@@ -0,0 +1,374 @@
+/**
+ * @file servlet_router.h
+ * @brief 基于Radix树的URI路由表
+ * @author sylar.yin
+ * @email 564628276@qq.com
+ * @date 2019-06-08
+ * @copyright Copyright (c) 2019年 sylar.yin All rights reserved (www.sylar.top)
+ */
+#ifndef __SYLAR_HTTP_SERVLET_ROUTER_H__
+#define __SYLAR_HTTP_SERVLET_ROUTER_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdint.h>
+#include <fnmatch.h>
+#include "sylar/noncopyable.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief 编译后的只读路由表
+ * @details 路由表构建完成后不再修改, 多线程读取无需加锁
+ *          更新时重新构建一份新的路由表, 由使用方原子替换
+ *          匹配优先级: 精准匹配 > 参数匹配 > 模糊匹配(按添加顺序) > 未匹配
+ *          精准/模糊匹配共用一棵按字符压缩的Radix树,
+ *          模糊匹配挂在其字面前缀对应的节点上, 只有前缀命中的模式才会调用fnmatch,
+ *          只在末尾带一个'*'的纯前缀模式(如 /sylar_*)直接命中, 不调用fnmatch
+ *          参数匹配按'/'分段建树, 支持 :name(匹配一段) 和 *name(匹配剩余部分) 两种写法
+ * @tparam T 路由值类型
+ */
+template<class T>
+class RadixRouter : Noncopyable {
+public:
+    /// 智能指针类型定义
+    typedef std::shared_ptr<RadixRouter> ptr;
+    /// 参数MAP
+    typedef std::map<std::string, std::string> ParamMap;
+
+    RadixRouter()
+        :m_root(new Node)
+        ,m_segRoot(new SegNode)
+        ,m_size(0) {
+    }
+
+    ~RadixRouter() {
+        delete m_root;
+        delete m_segRoot;
+    }
+
+    /**
+     * @brief 添加精准匹配路由
+     * @param[in] uri uri
+     * @param[in] v 路由值
+     */
+    void addExact(const std::string& uri, const T& v) {
+        Node* n = insert(uri);
+        if(!n->has_exact) {
+            ++m_size;
+        }
+        n->has_exact = true;
+        n->exact = v;
+    }
+
+    /**
+     * @brief 添加模糊匹配路由(fnmatch语义)
+     * @param[in] pattern 模式 /sylar_*
+     * @param[in] v 路由值
+     * @param[in] order 添加顺序, 多个模式同时命中时取order最小的
+     */
+    void addGlob(const std::string& pattern, const T& v, uint32_t order) {
+        size_t pos = pattern.find_first_of("*?[\\");
+        std::string prefix = pattern.substr(0, pos);
+        Node* n = insert(prefix);
+        GlobItem item;
+        item.pattern = pattern;
+        item.order = order;
+        item.prefix_only = pos != std::string::npos
+                        && pos + 1 == pattern.size()
+                        && pattern[pos] == '*';
+        item.value = v;
+        n->globs.push_back(item);
+        ++m_size;
+    }
+
+    /**
+     * @brief 添加参数匹配路由
+     * @param[in] pattern 模式, :name 匹配一段, *name 匹配剩余全部(只能在末尾)
+     * @param[in] v 路由值
+     * @return 模式是否合法
+     */
+    bool addParam(const std::string& pattern, const T& v) {
+        std::vector<std::string> segs;
+        Split(pattern, segs);
+        if(!CheckParam(segs)) {
+            return false;
+        }
+        SegNode* n = m_segRoot;
+        std::vector<std::string> names;
+        for(size_t i = 0; i < segs.size(); ++i) {
+            const std::string& s = segs[i];
+            if(!s.empty() && s[0] == ':') {
+                if(!n->param) {
+                    n->param = new SegNode;
+                }
+                n = n->param;
+                names.push_back(s.substr(1));
+            } else if(!s.empty() && s[0] == '*') {
+                if(!n->catch_all) {
+                    n->catch_all = new SegNode;
+                }
+                n = n->catch_all;
+                names.push_back(s.size() > 1 ? s.substr(1) : "*");
+            } else {
+                SegNode*& c = n->statics[s];
+                if(!c) {
+                    c = new SegNode;
+                }
+                n = c;
+            }
+        }
+        if(!n->has_value) {
+            ++m_size;
+        }
+        n->has_value = true;
+        n->value = v;
+        n->names.swap(names);
+        return true;
+    }
+
+    /**
+     * @brief 参数匹配模式是否合法(*name只能是最后一段)
+     * @param[in] pattern 模式
+     */
+    static bool IsValidParam(const std::string& pattern) {
+        std::vector<std::string> segs;
+        Split(pattern, segs);
+        return CheckParam(segs);
+    }
+
+    /**
+     * @brief 匹配uri
+     * @param[in] uri uri
+     * @param[out] v 命中的路由值
+     * @param[out] params 参数匹配时返回捕获的参数, 可为空
+     * @return 是否命中
+     */
+    bool match(const std::string& uri, T& v, ParamMap* params = nullptr) const {
+        const GlobItem* glob = nullptr;
+        const Node* n = m_root;
+        size_t pos = 0;
+        while(true) {
+            for(auto& g : n->globs) {
+                if(glob && glob->order < g.order) {
+                    continue;
+                }
+                if(g.prefix_only
+                        || !fnmatch(g.pattern.c_str(), uri.c_str(), 0)) {
+                    glob = &g;
+                }
+            }
+            if(pos == uri.size()) {
+                if(n->has_exact) {
+                    v = n->exact;
+                    return true;
+                }
+                break;
+            }
+            const Node* next = nullptr;
+            char c = uri[pos];
+            for(size_t i = 0; i < n->indices.size(); ++i) {
+                if(n->indices[i] == c) {
+                    next = n->children[i];
+                    break;
+                }
+            }
+            if(!next || uri.compare(pos, next->label.size(), next->label) != 0) {
+                break;
+            }
+            pos += next->label.size();
+            n = next;
+        }
+
+        if(m_segRoot->hasChildren()) {
+            std::vector<std::string> segs;
+            Split(uri, segs);
+            std::vector<std::string> vals;
+            const SegNode* sn = matchSeg(m_segRoot, segs, 0, vals);
+            if(sn) {
+                v = sn->value;
+                if(params) {
+                    for(size_t i = 0; i < sn->names.size() && i < vals.size(); ++i) {
+                        (*params)[sn->names[i]] = vals[i];
+                    }
+                }
+                return true;
+            }
+        }
+
+        if(glob) {
+            v = glob->value;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief 返回路由数量
+     */
+    size_t size() const { return m_size;}
+private:
+    struct GlobItem {
+        std::string pattern;
+        uint32_t order;
+        bool prefix_only;
+        T value;
+    };
+
+    struct Node {
+        Node()
+            :has_exact(false) {
+        }
+        ~Node() {
+            for(auto& i : children) {
+                delete i;
+            }
+        }
+        /// 边上的字符串
+        std::string label;
+        /// 子节点首字符, 与children一一对应
+        std::string indices;
+        std::vector<Node*> children;
+        bool has_exact;
+        T exact;
+        std::vector<GlobItem> globs;
+    };
+
+    struct SegNode {
+        SegNode()
+            :param(nullptr)
+            ,catch_all(nullptr)
+            ,has_value(false) {
+        }
+        ~SegNode() {
+            for(auto& i : statics) {
+                delete i.second;
+            }
+            delete param;
+            delete catch_all;
+        }
+        bool hasChildren() const {
+            return !statics.empty() || param || catch_all;
+        }
+        std::map<std::string, SegNode*> statics;
+        SegNode* param;
+        SegNode* catch_all;
+        bool has_value;
+        T value;
+        /// 参数名, 按出现顺序
+        std::vector<std::string> names;
+    };
+
+    /**
+     * @brief 按'/'切分路径, 保留末尾的空段以区分 /a 和 /a/
+     */
+    static void Split(const std::string& path, std::vector<std::string>& segs) {
+        size_t pos = path.empty() || path[0] != '/' ? 0 : 1;
+        while(true) {
+            size_t next = path.find('/', pos);
+            if(next == std::string::npos) {
+                segs.push_back(path.substr(pos));
+                break;
+            }
+            segs.push_back(path.substr(pos, next - pos));
+            pos = next + 1;
+        }
+    }
+
+    static bool CheckParam(const std::vector<std::string>& segs) {
+        for(size_t i = 0; i + 1 < segs.size(); ++i) {
+            if(!segs[i].empty() && segs[i][0] == '*') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief 分段匹配, 静态段优先于参数段, 参数段优先于通配段, 失败时回溯
+     */
+    static const SegNode* matchSeg(const SegNode* n
+                        ,const std::vector<std::string>& segs, size_t idx
+                        ,std::vector<std::string>& vals) {
+        if(idx == segs.size()) {
+            return n->has_value ? n : nullptr;
+        }
+        auto it = n->statics.find(segs[idx]);
+        if(it != n->statics.end()) {
+            const SegNode* rt = matchSeg(it->second, segs, idx + 1, vals);
+            if(rt) {
+                return rt;
+            }
+        }
+        if(n->param && !segs[idx].empty()) {
+            vals.push_back(segs[idx]);
+            const SegNode* rt = matchSeg(n->param, segs, idx + 1, vals);
+            if(rt) {
+                return rt;
+            }
+            vals.pop_back();
+        }
+        if(n->catch_all && n->catch_all->has_value) {
+            std::string rest = segs[idx];
+            for(size_t i = idx + 1; i < segs.size(); ++i) {
+                rest += "/" + segs[i];
+            }
+            vals.push_back(rest);
+            return n->catch_all;
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief 插入key, 返回恰好结束在key末尾的节点(必要时分裂边)
+     */
+    Node* insert(const std::string& key) {
+        Node* n = m_root;
+        size_t pos = 0;
+        while(pos < key.size()) {
+            char c = key[pos];
+            size_t idx = n->indices.find(c);
+            if(idx == std::string::npos) {
+                Node* child = new Node;
+                child->label = key.substr(pos);
+                n->indices.push_back(c);
+                n->children.push_back(child);
+                return child;
+            }
+            Node* child = n->children[idx];
+            size_t common = 0;
+            size_t max_len = std::min(child->label.size(), key.size() - pos);
+            while(common < max_len && child->label[common] == key[pos + common]) {
+                ++common;
+            }
+            if(common < child->label.size()) {
+                Node* mid = new Node;
+                mid->label = child->label.substr(0, common);
+                child->label = child->label.substr(common);
+                mid->indices.push_back(child->label[0]);
+                mid->children.push_back(child);
+                n->children[idx] = mid;
+                child = mid;
+            }
+            pos += common;
+            n = child;
+        }
+        return n;
+    }
+private:
+    /// Radix树根节点(精准/模糊匹配)
+    Node* m_root;
+    /// 分段树根节点(参数匹配)
+    SegNode* m_segRoot;
+    /// 路由数量
+    size_t m_size;
+};
+
+}
+}
+
+#endif
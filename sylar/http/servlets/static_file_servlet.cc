@@ -0,0 +1,307 @@
+#include "static_file_servlet.h"
+#include "sylar/config.h"
+#include "sylar/log.h"
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<uint64_t>::ptr g_static_file_cache_size =
+    sylar::Config::Lookup("http.static_file.cache_size"
+                ,(uint64_t)1024, "http static file fd cache size");
+
+static sylar::ConfigVar<uint64_t>::ptr g_static_file_cache_timeout =
+    sylar::Config::Lookup("http.static_file.cache_timeout"
+                ,(uint64_t)5000, "http static file stat revalidate interval ms");
+
+static sylar::ConfigVar<uint64_t>::ptr g_static_file_preload_max_size =
+    sylar::Config::Lookup("http.static_file.preload_max_size"
+                ,(uint64_t)(64 * 1024), "http static file read into memory max size");
+
+static std::string FormatHttpTime(time_t ts) {
+    struct tm tm;
+    gmtime_r(&ts, &tm);
+    char buf[64];
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return buf;
+}
+
+static time_t ParseHttpTime(const std::string& str) {
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if(!strptime(str.c_str(), "%a, %d %b %Y %H:%M:%S", &tm)) {
+        return 0;
+    }
+    return timegm(&tm);
+}
+
+int StaticFileServlet::ParseRange(const std::string& range, uint64_t size
+                      ,uint64_t& begin, uint64_t& length) {
+    if(strncasecmp(range.c_str(), "bytes=", 6) != 0
+            || range.find(',') != std::string::npos) {
+        return 0;
+    }
+    std::string spec = sylar::StringUtil::Trim(range.substr(6));
+    size_t pos = spec.find('-');
+    if(pos == std::string::npos) {
+        return 0;
+    }
+    std::string first = spec.substr(0, pos);
+    std::string last = spec.substr(pos + 1);
+    char* end = nullptr;
+    if(first.empty()) {
+        //bytes=-n 最后n个字节
+        uint64_t n = strtoull(last.c_str(), &end, 10);
+        if(last.empty() || *end || n == 0 || size == 0) {
+            return -1;
+        }
+        n = std::min(n, size);
+        begin = size - n;
+        length = n;
+        return 1;
+    }
+    uint64_t b = strtoull(first.c_str(), &end, 10);
+    if(*end || b >= size) {
+        return -1;
+    }
+    uint64_t e = size - 1;
+    if(!last.empty()) {
+        e = strtoull(last.c_str(), &end, 10);
+        if(*end || e < b) {
+            return -1;
+        }
+        e = std::min(e, size - 1);
+    }
+    begin = b;
+    length = e - b + 1;
+    return 1;
+}
+
+StaticFile::StaticFile()
+    :m_fd(-1)
+    ,m_size(0)
+    ,m_mtime(0)
+    ,m_preload(false) {
+}
+
+StaticFile::~StaticFile() {
+    if(m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+StaticFile::ptr StaticFile::Open(const std::string& path, uint64_t preload_max_size) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if(fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return nullptr;
+    }
+    StaticFile::ptr rt(new StaticFile);
+    rt->m_fd = fd;
+    rt->m_size = st.st_size;
+    rt->m_mtime = st.st_mtime;
+    rt->m_path = path;
+    if(rt->m_size > 0 && rt->m_size <= preload_max_size) {
+        rt->m_content.resize(rt->m_size);
+        uint64_t offset = 0;
+        while(offset < rt->m_size) {
+            ssize_t n = pread(fd, &rt->m_content[offset], rt->m_size - offset, offset);
+            if(n < 0 && errno == EINTR) {
+                continue;
+            }
+            if(n <= 0) {
+                break;
+            }
+            offset += n;
+        }
+        if(offset < rt->m_size) {
+            //stat之后文件被截断, 以读到的内容为准
+            SYLAR_LOG_WARN(g_logger) << "read " << path << " size=" << rt->m_size
+                << " got=" << offset << " errno=" << errno << " errstr=" << strerror(errno);
+            rt->m_size = offset;
+            rt->m_content.resize(offset);
+        }
+        rt->m_preload = true;
+        ::close(fd);
+        rt->m_fd = -1;
+    }
+    rt->m_lastModified = FormatHttpTime(st.st_mtime);
+    rt->m_etag = sylar::StringUtil::Format("\"%lx-%lx\"", (unsigned long)st.st_mtime
+                        ,(unsigned long)rt->m_size);
+    rt->m_contentType = StaticFileServlet::GetContentType(path);
+    return rt;
+}
+
+StaticFileServlet::StaticFileServlet(const std::string& root, const std::string& prefix)
+    :Servlet("StaticFileServlet")
+    ,m_root(root)
+    ,m_prefix(prefix)
+    ,m_cache(g_static_file_cache_size->getValue()
+            ,g_static_file_cache_size->getValue() / 10) {
+    while(!m_root.empty() && m_root[m_root.size() - 1] == '/') {
+        m_root.resize(m_root.size() - 1);
+    }
+}
+
+std::string StaticFileServlet::GetContentType(const std::string& path) {
+    static const std::map<std::string, std::string> s_types = {
+        {"html", "text/html; charset=utf-8"},
+        {"htm", "text/html; charset=utf-8"},
+        {"css", "text/css; charset=utf-8"},
+        {"js", "application/javascript; charset=utf-8"},
+        {"json", "application/json; charset=utf-8"},
+        {"txt", "text/plain; charset=utf-8"},
+        {"xml", "text/xml; charset=utf-8"},
+        {"svg", "image/svg+xml"},
+        {"png", "image/png"},
+        {"jpg", "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"gif", "image/gif"},
+        {"ico", "image/x-icon"},
+        {"webp", "image/webp"},
+        {"pdf", "application/pdf"},
+        {"zip", "application/zip"},
+        {"gz", "application/gzip"},
+        {"wasm", "application/wasm"},
+        {"woff", "font/woff"},
+        {"woff2", "font/woff2"},
+        {"ttf", "font/ttf"},
+        {"mp3", "audio/mpeg"},
+        {"mp4", "video/mp4"},
+    };
+    size_t pos = path.rfind('.');
+    if(pos == std::string::npos || path.find('/', pos) != std::string::npos) {
+        return "application/octet-stream";
+    }
+    auto it = s_types.find(sylar::ToLower(path.substr(pos + 1)));
+    return it == s_types.end() ? "application/octet-stream" : it->second;
+}
+
+StaticFile::ptr StaticFileServlet::getFile(const std::string& path) {
+    //先淘汰过期项(重新stat), 正在发送中的文件由HttpFileBody持有, 不会提前关闭
+    m_cache.checkTimeout();
+    StaticFile::ptr file;
+    if(m_cache.get(path, file)) {
+        return file;
+    }
+    file = StaticFile::Open(path, g_static_file_preload_max_size->getValue());
+    if(file) {
+        m_cache.set(path, file, g_static_file_cache_timeout->getValue());
+    }
+    return file;
+}
+
+int32_t StaticFileServlet::handle(sylar::http::HttpRequest::ptr request
+                                  ,sylar::http::HttpResponse::ptr response
+                                  ,sylar::http::HttpSession::ptr session) {
+    if(request->getMethod() != HttpMethod::GET
+            && request->getMethod() != HttpMethod::HEAD) {
+        response->setStatus(HttpStatus::METHOD_NOT_ALLOWED);
+        response->setHeader("Allow", "GET, HEAD");
+        return 0;
+    }
+
+    std::string path = request->getPath();
+    //前缀须是完整的路径段, /static不匹配/staticfoo
+    if(!m_prefix.empty() && path.compare(0, m_prefix.size(), m_prefix) == 0
+            && (path.size() == m_prefix.size() || path[m_prefix.size()] == '/'
+                || m_prefix[m_prefix.size() - 1] == '/')) {
+        path = path.substr(m_prefix.size());
+    }
+    path = sylar::StringUtil::UrlDecode(path, false);
+    if(path.empty() || path[0] != '/') {
+        path = "/" + path;
+    }
+    if(path.find('\0') != std::string::npos
+            || path.find("/../") != std::string::npos
+            || (path.size() >= 3 && path.compare(path.size() - 3, 3, "/..") == 0)) {
+        response->setStatus(HttpStatus::FORBIDDEN);
+        return 0;
+    }
+    if(path[path.size() - 1] == '/') {
+        path += "index.html";
+    }
+
+    StaticFile::ptr file = getFile(m_root + path);
+    if(!file) {
+        response->setStatus(HttpStatus::NOT_FOUND);
+        response->setHeader("Content-Type", "text/html");
+        response->setBody("<html><head><title>404 Not Found</title></head>"
+                "<body><center><h1>404 Not Found</h1></center></body></html>");
+        return 0;
+    }
+
+    response->setHeader("Last-Modified", file->getLastModified());
+    response->setHeader("ETag", file->getETag());
+    response->setHeader("Accept-Ranges", "bytes");
+
+    std::string inm = request->getHeader("If-None-Match");
+    if(!inm.empty()) {
+        if(inm == "*" || inm.find(file->getETag()) != std::string::npos) {
+            response->setStatus(HttpStatus::NOT_MODIFIED);
+            return 0;
+        }
+    } else {
+        std::string ims = request->getHeader("If-Modified-Since");
+        if(!ims.empty()) {
+            time_t t = ParseHttpTime(ims);
+            if(t > 0 && file->getMtime() <= t) {
+                response->setStatus(HttpStatus::NOT_MODIFIED);
+                return 0;
+            }
+        }
+    }
+
+    response->setHeader("Content-Type", file->getContentType());
+    uint64_t begin = 0;
+    uint64_t length = file->getSize();
+    std::string range = request->getHeader("Range");
+    if(!range.empty()) {
+        std::string if_range = request->getHeader("If-Range");
+        if(if_range.empty() || if_range == file->getETag()
+                || if_range == file->getLastModified()) {
+            int rt = ParseRange(range, file->getSize(), begin, length);
+            if(rt < 0) {
+                response->setStatus(HttpStatus::RANGE_NOT_SATISFIABLE);
+                response->setHeader("Content-Range", "bytes */"
+                        + std::to_string(file->getSize()));
+                return 0;
+            } else if(rt > 0) {
+                response->setStatus(HttpStatus::PARTIAL_CONTENT);
+                response->setHeader("Content-Range", "bytes "
+                        + std::to_string(begin) + "-"
+                        + std::to_string(begin + length - 1) + "/"
+                        + std::to_string(file->getSize()));
+            }
+        }
+    }
+
+    if(request->getMethod() == HttpMethod::HEAD) {
+        response->setHeader("Content-Length", std::to_string(length));
+        return 0;
+    }
+
+    HttpFileBody::ptr body(new HttpFileBody);
+    body->fd = file->getFd();
+    body->offset = begin;
+    body->length = length;
+    body->data = file->getData();
+    body->owner = file;
+    response->setFileBody(body);
+    return 0;
+}
+
+std::string StaticFileServlet::toStatusString() {
+    return m_cache.toStatusString();
+}
+
+}
+}
@@ -0,0 +1,103 @@
+#ifndef __SYLAR_HTTP_SERVLETS_STATIC_FILE_SERVLET_H__
+#define __SYLAR_HTTP_SERVLETS_STATIC_FILE_SERVLET_H__
+
+#include "sylar/http/servlet.h"
+#include "sylar/ds/timed_lru_cache.h"
+#include <sys/stat.h>
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief 缓存的静态文件(打开的fd, stat信息, 小文件的内容)
+ */
+class StaticFile {
+public:
+    typedef std::shared_ptr<StaticFile> ptr;
+
+    /**
+     * @brief 打开文件
+     * @param[in] path 文件路径
+     * @param[in] preload_max_size 不超过该大小的文件读入内存
+     * @details 小文件不做mmap: 文件在发送中被截断时访问mmap区域会触发SIGBUS
+     * @return 文件不存在或不是普通文件时返回nullptr
+     */
+    static StaticFile::ptr Open(const std::string& path, uint64_t preload_max_size);
+
+    ~StaticFile();
+
+    int getFd() const { return m_fd;}
+    uint64_t getSize() const { return m_size;}
+    time_t getMtime() const { return m_mtime;}
+    const char* getData() const { return m_preload ? m_content.data() : nullptr;}
+    const std::string& getPath() const { return m_path;}
+    const std::string& getETag() const { return m_etag;}
+    const std::string& getLastModified() const { return m_lastModified;}
+    const std::string& getContentType() const { return m_contentType;}
+private:
+    StaticFile();
+private:
+    int m_fd;
+    uint64_t m_size;
+    time_t m_mtime;
+    bool m_preload;
+    std::string m_content;
+    std::string m_path;
+    std::string m_etag;
+    std::string m_lastModified;
+    std::string m_contentType;
+};
+
+/**
+ * @brief 静态文件Servlet
+ * @details 通过sendfile发送文件, 小文件读入内存后直接writev
+ *          支持Range(单区间), If-Range, If-None-Match/ETag, If-Modified-Since
+ *          打开的fd和stat信息缓存在TimedLruCache中, 超时后重新stat
+ *          用法: 用ServletDispatch::addGlobServlet以"/static"加通配符注册,
+ *                并以StaticFileServlet("/data/www", "/static")去掉请求路径前缀
+ */
+class StaticFileServlet : public Servlet {
+public:
+    typedef std::shared_ptr<StaticFileServlet> ptr;
+    typedef sylar::ds::TimedLruCache<std::string, StaticFile::ptr> CacheType;
+
+    /**
+     * @brief 构造函数
+     * @param[in] root 文件根目录
+     * @param[in] prefix 请求路径中需要去掉的前缀, 只匹配完整的路径段
+     */
+    StaticFileServlet(const std::string& root, const std::string& prefix = "");
+
+    virtual int32_t handle(sylar::http::HttpRequest::ptr request
+                   , sylar::http::HttpResponse::ptr response
+                   , sylar::http::HttpSession::ptr session) override;
+
+    std::string toStatusString();
+
+    /**
+     * @brief 根据文件扩展名返回Content-Type
+     */
+    static std::string GetContentType(const std::string& path);
+
+    /**
+     * @brief 解析单区间Range
+     * @param[in] range Range请求头
+     * @param[in] size 文件大小
+     * @param[out] begin 区间起始偏移
+     * @param[out] length 区间长度
+     * @return 1 合法区间, 0 忽略(非bytes或多区间), -1 区间不可满足
+     */
+    static int ParseRange(const std::string& range, uint64_t size
+                          ,uint64_t& begin, uint64_t& length);
+private:
+    StaticFile::ptr getFile(const std::string& path);
+private:
+    std::string m_root;
+    std::string m_prefix;
+    CacheType m_cache;
+};
+
+}
+}
+
+#endif
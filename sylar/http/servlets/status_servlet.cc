@@ -1,5 +1,9 @@
 #include "status_servlet.h"
 #include "sylar/sylar.h"
+#include "sylar/http/http_compress.h"
+#include "sylar/http/ws_deflate.h"
+#include "sylar/http/ws_session_manager.h"
+#include <algorithm>
 
 namespace sylar {
 namespace http {
@@ -72,6 +76,41 @@ int32_t StatusServlet::handle(sylar::http::HttpRequest::ptr request
     ss << "===================================================" << std::endl;
     ss << "<Woker>" << std::endl;
     sylar::WorkerMgr::GetInstance()->dump(ss) << std::endl;
+    ss << "===================================================" << std::endl;
+    ss << "<HttpCompress>" << std::endl;
+    ss << sylar::http::HttpCompressor::StatusString() << std::endl;
+    ss << "===================================================" << std::endl;
+    ss << "<WSDeflate>" << std::endl;
+    ss << sylar::http::WSDeflater::StatusString() << std::endl;
+    {
+        //按zlib内存从大到小列出开启了压缩的连接
+        static const size_t s_max_deflate_sessions = 100;
+        std::vector<WSSession::ptr> sessions;
+        sylar::http::WSSessionMgr::GetInstance()->listAll(sessions);
+        std::vector<std::pair<int64_t, WSSession::ptr> > deflates;
+        for(auto& i : sessions) {
+            auto d = i->getDeflater();
+            if(d) {
+                deflates.push_back(std::make_pair(d->getMemoryUsage(), i));
+            }
+        }
+        std::sort(deflates.begin(), deflates.end(), [](const std::pair<int64_t, WSSession::ptr>& a
+                    ,const std::pair<int64_t, WSSession::ptr>& b) {
+            return a.first > b.first;
+        });
+        ss << "[Sessions] count=" << deflates.size() << std::endl;
+        for(size_t i = 0; i < deflates.size() && i < s_max_deflate_sessions; ++i) {
+            auto& s = deflates[i].second;
+            ss << std::setw(30) << std::right << ("session." + std::to_string(s->getId())) << ": "
+               << s->getRemoteAddressString() << " " << s->getDeflater()->toString() << std::endl;
+        }
+        if(deflates.size() > s_max_deflate_sessions) {
+            ss << "..." << (deflates.size() - s_max_deflate_sessions) << " more" << std::endl;
+        }
+    }
+    ss << "===================================================" << std::endl;
+    ss << "<WSSession>" << std::endl;
+    ss << sylar::http::WSSessionMgr::GetInstance()->toString() << std::endl;
 
     std::map<std::string, std::vector<TcpServer::ptr> > servers;
     sylar::Application::GetInstance()->listAllServer(servers);
@@ -115,6 +154,14 @@ int32_t StatusServlet::handle(sylar::http::HttpRequest::ptr request
                     }
                     infos.clear();
                 }
+                sd->listAllParamServletCreator(infos);
+                if(!infos.empty()) {
+                    ss << "[Servlets.Params]" << std::endl;
+                    for(auto& i : infos) {
+                        XX2(i.first) << i.second->getName() << std::endl;
+                    }
+                    infos.clear();
+                }
             }
         }
     }
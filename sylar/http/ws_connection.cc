@@ -47,9 +47,12 @@ std::pair<HttpResult::ptr, WSConnection::ptr> WSConnection::Create(Uri::ptr uri
     req->setMethod(HttpMethod::GET);
     bool has_host = false;
     bool has_conn = false;
+    bool has_ext = false;
     for(auto& i : headers) {
         if(strcasecmp(i.first.c_str(), "connection") == 0) {
             has_conn = true;
+        } else if(strcasecmp(i.first.c_str(), "Sec-WebSocket-Extensions") == 0) {
+            has_ext = true;
         } else if(!has_host && strcasecmp(i.first.c_str(), "host") == 0) {
             has_host = !i.second.empty();
         }
@@ -66,6 +69,12 @@ std::pair<HttpResult::ptr, WSConnection::ptr> WSConnection::Create(Uri::ptr uri
     if(!has_host) {
         req->setHeader("Host", uri->getHost());
     }
+    if(!has_ext) {
+        std::string offer = WSDeflater::Offer();
+        if(!offer.empty()) {
+            req->setHeader("Sec-WebSocket-Extensions", offer);
+        }
+    }
 
    int rt = conn->sendRequest(req);
     if(rt == 0) {
@@ -88,28 +97,34 @@ std::pair<HttpResult::ptr, WSConnection::ptr> WSConnection::Create(Uri::ptr uri
         return std::make_pair(std::make_shared<HttpResult>(50
                     , rsp, "not websocket server " + addr->toString()), nullptr);
     }
+    if(!WSDeflater::Confirm(rsp->getHeader("Sec-WebSocket-Extensions"), conn->m_deflater)) {
+        return std::make_pair(std::make_shared<HttpResult>(51
+                    , rsp, "invalid Sec-WebSocket-Extensions: "
+                    + rsp->getHeader("Sec-WebSocket-Extensions")), nullptr);
+    }
     return std::make_pair(std::make_shared<HttpResult>((int)HttpResult::Error::OK
                 , rsp, "ok"), conn);
 }
 
 WSFrameMessage::ptr WSConnection::recvMessage() {
-    return WSRecvMessage(this, true);
+    return WSRecvMessage(this, true, &m_recvBuffer, m_deflater.get());
 }
 
 int32_t WSConnection::sendMessage(WSFrameMessage::ptr msg, bool fin) {
-    return WSSendMessage(this, msg, true, fin);
+    return WSSendMessage(this, msg, true, fin, m_deflater.get());
 }
 
 int32_t WSConnection::sendMessage(const std::string& msg, int32_t opcode, bool fin) {
-    return WSSendMessage(this, std::make_shared<WSFrameMessage>(opcode, msg), true, fin);
+    return WSSendMessage(this, std::make_shared<WSFrameMessage>(opcode, msg), true, fin, m_deflater.get());
 }
 
 int32_t WSConnection::ping() {
-    return WSPing(this);
+    //客户端发出的控制帧也需要掩码
+    return WSSendMessage(this, std::make_shared<WSFrameMessage>(WSFrameHead::PING), true, true);
 }
 
 int32_t WSConnection::pong() {
-    return WSPong(this);
+    return WSSendMessage(this, std::make_shared<WSFrameMessage>(WSFrameHead::PONG), true, true);
 }
 
 }
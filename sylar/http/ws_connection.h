@@ -22,6 +22,16 @@ public:
     int32_t sendMessage(const std::string& msg, int32_t opcode = WSFrameHead::TEXT_FRAME, bool fin = true);
     int32_t ping();
     int32_t pong();
+
+    /**
+     * @brief 握手协商的permessage-deflate上下文, 未协商时为nullptr
+     */
+    WSDeflater::ptr getDeflater() const { return m_deflater;}
+private:
+    /// 接收缓存, 一次读取可能包含多个帧
+    BufferChain m_recvBuffer;
+    /// permessage-deflate上下文
+    WSDeflater::ptr m_deflater;
 };
 
 }
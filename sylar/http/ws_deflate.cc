@@ -0,0 +1,586 @@
+#include "ws_deflate.h"
+#include "sylar/config.h"
+#include "sylar/log.h"
+#include "sylar/mutex.h"
+#include "sylar/util/hash_util.h"
+#include <set>
+#include <sstream>
+#include <string.h>
+#include <time.h>
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static sylar::ConfigVar<bool>::ptr g_ws_deflate_enable =
+    sylar::Config::Lookup("websocket.deflate.enable"
+                ,false, "websocket permessage-deflate enable");
+
+static sylar::ConfigVar<int32_t>::ptr g_ws_deflate_level =
+    sylar::Config::Lookup("websocket.deflate.level"
+                ,(int32_t)6, "websocket permessage-deflate compress level");
+
+static sylar::ConfigVar<int32_t>::ptr g_ws_deflate_mem_level =
+    sylar::Config::Lookup("websocket.deflate.mem_level"
+                ,(int32_t)8, "websocket permessage-deflate zlib memLevel(1~9)");
+
+static sylar::ConfigVar<uint32_t>::ptr g_ws_deflate_min_size =
+    sylar::Config::Lookup("websocket.deflate.min_size"
+                ,(uint32_t)64, "websocket permessage-deflate min message size");
+
+static sylar::ConfigVar<int32_t>::ptr g_ws_deflate_server_max_window_bits =
+    sylar::Config::Lookup("websocket.deflate.server_max_window_bits"
+                ,(int32_t)15, "websocket permessage-deflate server window bits(8~15)");
+
+static sylar::ConfigVar<int32_t>::ptr g_ws_deflate_client_max_window_bits =
+    sylar::Config::Lookup("websocket.deflate.client_max_window_bits"
+                ,(int32_t)15, "websocket permessage-deflate client window bits(8~15)");
+
+static sylar::ConfigVar<bool>::ptr g_ws_deflate_server_no_context_takeover =
+    sylar::Config::Lookup("websocket.deflate.server_no_context_takeover"
+                ,false, "websocket permessage-deflate server reset context per message");
+
+static sylar::ConfigVar<bool>::ptr g_ws_deflate_client_no_context_takeover =
+    sylar::Config::Lookup("websocket.deflate.client_no_context_takeover"
+                ,false, "websocket permessage-deflate client reset context per message");
+
+static sylar::ConfigVar<std::string>::ptr g_ws_deflate_dictionary =
+    sylar::Config::Lookup("websocket.deflate.dictionary"
+                ,std::string(""), "websocket permessage-deflate shared dictionary, both sides must match");
+
+static const char* EXTENSION_NAME = "permessage-deflate";
+static const char* DICTIONARY_PARAM = "x-sylar-dictionary";
+
+static bool s_enable = false;
+static int32_t s_level = 6;
+static int32_t s_mem_level = 8;
+static uint32_t s_min_size = 64;
+static int32_t s_server_max_window_bits = 15;
+static int32_t s_client_max_window_bits = 15;
+static bool s_server_no_context_takeover = false;
+static bool s_client_no_context_takeover = false;
+
+static sylar::RWMutex s_dictionary_mutex;
+static std::shared_ptr<std::string> s_dictionary;
+static std::string s_dictionary_id;
+
+static int32_t ClampWindowBits(int32_t v) {
+    return std::max(8, std::min(15, v));
+}
+
+static void SetDictionary(const std::string& v) {
+    std::shared_ptr<std::string> dict;
+    std::string id;
+    if(!v.empty()) {
+        dict.reset(new std::string(v));
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%08x", sylar::crc32c(v.c_str(), v.size()));
+        id = buf;
+    }
+    sylar::RWMutex::WriteLock lock(s_dictionary_mutex);
+    s_dictionary.swap(dict);
+    s_dictionary_id.swap(id);
+}
+
+static std::shared_ptr<std::string> GetDictionary(const std::string& id) {
+    sylar::RWMutex::ReadLock lock(s_dictionary_mutex);
+    if(id.empty() || id != s_dictionary_id) {
+        return nullptr;
+    }
+    return s_dictionary;
+}
+
+static std::string GetDictionaryId() {
+    sylar::RWMutex::ReadLock lock(s_dictionary_mutex);
+    return s_dictionary_id;
+}
+
+namespace {
+struct _WSDeflateIniter {
+    _WSDeflateIniter() {
+#define XX(var, type, value) \
+        value = var->getValue(); \
+        var->addListener([](const type& ov, const type& nv){ \
+            value = nv; \
+        });
+        XX(g_ws_deflate_enable, bool, s_enable);
+        XX(g_ws_deflate_level, int32_t, s_level);
+        XX(g_ws_deflate_mem_level, int32_t, s_mem_level);
+        XX(g_ws_deflate_min_size, uint32_t, s_min_size);
+        XX(g_ws_deflate_server_max_window_bits, int32_t, s_server_max_window_bits);
+        XX(g_ws_deflate_client_max_window_bits, int32_t, s_client_max_window_bits);
+        XX(g_ws_deflate_server_no_context_takeover, bool, s_server_no_context_takeover);
+        XX(g_ws_deflate_client_no_context_takeover, bool, s_client_no_context_takeover);
+#undef XX
+        SetDictionary(g_ws_deflate_dictionary->getValue());
+        g_ws_deflate_dictionary->addListener([](const std::string& ov, const std::string& nv){
+            SYLAR_LOG_INFO(g_logger) << "websocket.deflate.dictionary changed, size="
+                                     << ov.size() << " -> " << nv.size();
+            SetDictionary(nv);
+        });
+    }
+};
+static _WSDeflateIniter _init;
+
+uint64_t GetThreadCpuUS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000 * 1000ul + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief zlib内存分配, 记录到连接和全局统计
+ */
+const size_t ALLOC_HEAD = 16;
+
+voidpf ZAlloc(voidpf opaque, uInt items, uInt size) {
+    size_t len = (size_t)items * size;
+    char* p = (char*)malloc(len + ALLOC_HEAD);
+    if(!p) {
+        return Z_NULL;
+    }
+    memcpy(p, &len, sizeof(len));
+    Atomic::addFetch(*(int64_t*)opaque, (int64_t)len);
+    WSDeflater::GetStatus()->incMemory(len);
+    return p + ALLOC_HEAD;
+}
+
+void ZFree(voidpf opaque, voidpf address) {
+    if(!address) {
+        return;
+    }
+    char* p = (char*)address - ALLOC_HEAD;
+    size_t len = 0;
+    memcpy(&len, p, sizeof(len));
+    Atomic::subFetch(*(int64_t*)opaque, (int64_t)len);
+    WSDeflater::GetStatus()->incMemory(-(int64_t)len);
+    free(p);
+}
+
+}
+
+std::string WSDeflateParams::toString() const {
+    std::stringstream ss;
+    ss << EXTENSION_NAME;
+    if(server_no_context_takeover) {
+        ss << "; server_no_context_takeover";
+    }
+    if(client_no_context_takeover) {
+        ss << "; client_no_context_takeover";
+    }
+    if(server_max_window_bits < 15) {
+        ss << "; server_max_window_bits=" << server_max_window_bits;
+    }
+    if(client_max_window_bits > 0 && client_max_window_bits < 15) {
+        ss << "; client_max_window_bits=" << client_max_window_bits;
+    }
+    if(!dictionary_id.empty()) {
+        ss << "; " << DICTIONARY_PARAM << "=" << dictionary_id;
+    }
+    return ss.str();
+}
+
+std::string WSDeflateStatus::toString() const {
+    std::stringstream ss;
+    ss << "contexts=" << m_contexts
+       << " memory=" << m_memory
+       << " memory_per_context=" << (m_contexts ? m_memory / m_contexts : 0)
+       << " compressed=" << m_compressed
+       << " skipped=" << m_skipped
+       << " compress_in=" << m_compressIn
+       << " compress_out=" << m_compressOut
+       << " compress_ratio=" << (m_compressIn ? (m_compressOut * 100.0 / m_compressIn) : 0) << "%"
+       << " decompressed=" << m_decompressed
+       << " decompress_in=" << m_decompressIn
+       << " decompress_out=" << m_decompressOut
+       << " decompress_ratio=" << (m_decompressOut ? (m_decompressIn * 100.0 / m_decompressOut) : 0) << "%"
+       << " cpu_us=" << m_cpuUs;
+    return ss.str();
+}
+
+WSDeflateStatus* WSDeflater::GetStatus() {
+    static WSDeflateStatus s_status;
+    return &s_status;
+}
+
+std::string WSDeflater::StatusString() {
+    std::stringstream ss;
+    ss << "enable=" << s_enable
+       << " level=" << s_level
+       << " mem_level=" << s_mem_level
+       << " min_size=" << s_min_size
+       << " server_max_window_bits=" << s_server_max_window_bits
+       << " client_max_window_bits=" << s_client_max_window_bits
+       << " server_no_context_takeover=" << s_server_no_context_takeover
+       << " client_no_context_takeover=" << s_client_no_context_takeover
+       << " dictionary=" << GetDictionaryId() << std::endl;
+    ss << GetStatus()->toString();
+    return ss.str();
+}
+
+bool WSDeflater::Parse(const std::string& header, std::vector<WSDeflateParams>& offers) {
+    bool ok = true;
+    auto items = sylar::split(header, ',');
+    for(auto& item : items) {
+        auto params = sylar::split(item, ';');
+        if(params.empty()
+                || strcasecmp(sylar::StringUtil::Trim(params[0]).c_str(), EXTENSION_NAME)) {
+            continue;
+        }
+        WSDeflateParams p;
+        //offer中未携带client_max_window_bits时为-1, 表示对端不能限制其窗口
+        p.client_max_window_bits = -1;
+        bool valid = true;
+        std::set<std::string> names;
+        for(size_t i = 1; i < params.size() && valid; ++i) {
+            std::string name = params[i];
+            std::string value;
+            bool has_value = false;
+            size_t pos = name.find('=');
+            if(pos != std::string::npos) {
+                value = sylar::StringUtil::Trim(name.substr(pos + 1), " \t\"");
+                name = name.substr(0, pos);
+                has_value = true;
+            }
+            name = sylar::StringUtil::Trim(name);
+            if(!names.insert(name).second) {
+                valid = false;
+            } else if(name == "server_no_context_takeover") {
+                valid = !has_value;
+                p.server_no_context_takeover = true;
+            } else if(name == "client_no_context_takeover") {
+                valid = !has_value;
+                p.client_no_context_takeover = true;
+            } else if(name == "server_max_window_bits"
+                    || name == "client_max_window_bits") {
+                int bits = 15;
+                if(has_value) {
+                    bits = atoi(value.c_str());
+                    valid = value.size() <= 2 && bits >= 8 && bits <= 15;
+                } else {
+                    valid = name == "client_max_window_bits";
+                }
+                if(name == "server_max_window_bits") {
+                    p.server_max_window_bits = bits;
+                } else {
+                    p.client_max_window_bits = bits;
+                }
+            } else if(name == DICTIONARY_PARAM) {
+                valid = has_value && !value.empty();
+                p.dictionary_id = value;
+            } else {
+                valid = false;
+            }
+        }
+        if(valid) {
+            offers.push_back(p);
+        } else {
+            SYLAR_LOG_INFO(g_logger) << "invalid " << EXTENSION_NAME << ": " << item;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+WSDeflater::ptr WSDeflater::Accept(const std::string& offer, std::string& response) {
+    if(!s_enable || offer.empty()) {
+        return nullptr;
+    }
+    std::vector<WSDeflateParams> offers;
+    Parse(offer, offers);
+    std::string dict_id = GetDictionaryId();
+    for(auto& o : offers) {
+        if(!o.dictionary_id.empty() && o.dictionary_id != dict_id) {
+            continue;
+        }
+        WSDeflateParams p;
+        p.dictionary_id = o.dictionary_id;
+        p.server_no_context_takeover = o.server_no_context_takeover
+                                        || s_server_no_context_takeover;
+        p.client_no_context_takeover = o.client_no_context_takeover
+                                        || s_client_no_context_takeover;
+        p.server_max_window_bits = std::min(o.server_max_window_bits
+                                    ,ClampWindowBits(s_server_max_window_bits));
+        if(o.client_max_window_bits < 0) {
+            //客户端不支持限制窗口, 只能按15解压
+            p.client_max_window_bits = 15;
+        } else {
+            p.client_max_window_bits = std::min(o.client_max_window_bits
+                                        ,ClampWindowBits(s_client_max_window_bits));
+        }
+        response = p.toString();
+        return std::make_shared<WSDeflater>(p, false);
+    }
+    return nullptr;
+}
+
+std::string WSDeflater::Offer() {
+    if(!s_enable) {
+        return "";
+    }
+    std::stringstream ss;
+    ss << EXTENSION_NAME;
+    if(s_server_no_context_takeover) {
+        ss << "; server_no_context_takeover";
+    }
+    if(s_client_no_context_takeover) {
+        ss << "; client_no_context_takeover";
+    }
+    int32_t server_bits = ClampWindowBits(s_server_max_window_bits);
+    if(server_bits < 15) {
+        ss << "; server_max_window_bits=" << server_bits;
+    }
+    int32_t client_bits = ClampWindowBits(s_client_max_window_bits);
+    ss << "; client_max_window_bits";
+    if(client_bits < 15) {
+        ss << "=" << client_bits;
+    }
+    std::string base = ss.str();
+    std::string dict_id = GetDictionaryId();
+    if(dict_id.empty()) {
+        return base;
+    }
+    //优先使用字典, 不认识字典参数的服务端会选择第二项
+    return base + "; " + DICTIONARY_PARAM + "=" + dict_id + ", " + base;
+}
+
+bool WSDeflater::Confirm(const std::string& response, WSDeflater::ptr& deflater) {
+    deflater = nullptr;
+    if(sylar::StringUtil::Trim(response).empty()) {
+        return true;
+    }
+    std::vector<WSDeflateParams> offers;
+    if(!Parse(response, offers) || offers.size() != 1
+            || sylar::split(response, ',').size() != 1) {
+        return false;
+    }
+    WSDeflateParams p = offers[0];
+    if(!s_enable) {
+        return false;
+    }
+    if(!p.dictionary_id.empty() && p.dictionary_id != GetDictionaryId()) {
+        return false;
+    }
+    //服务端未限制时按本端配置压缩, 窗口更小总是允许的
+    int32_t client_bits = ClampWindowBits(s_client_max_window_bits);
+    if(p.client_max_window_bits < 0 || p.client_max_window_bits > client_bits) {
+        p.client_max_window_bits = client_bits;
+    }
+    p.client_no_context_takeover = p.client_no_context_takeover
+                                    || s_client_no_context_takeover;
+    if(s_server_no_context_takeover && !p.server_no_context_takeover) {
+        return false;
+    }
+    if(p.server_max_window_bits > ClampWindowBits(s_server_max_window_bits)) {
+        return false;
+    }
+    deflater = std::make_shared<WSDeflater>(p, true);
+    return true;
+}
+
+WSDeflater::WSDeflater(const WSDeflateParams& params, bool client)
+    :m_params(params)
+    ,m_client(client) {
+    int deflate_bits = client ? params.client_max_window_bits : params.server_max_window_bits;
+    int inflate_bits = client ? params.server_max_window_bits : params.client_max_window_bits;
+    //zlib的raw deflate不支持8位窗口, 此时只发送不压缩的消息(协议允许)
+    m_deflateBits = deflate_bits > 8 ? deflate_bits : 0;
+    m_inflateBits = inflate_bits > 0 ? inflate_bits : 15;
+    m_deflateReset = client ? params.client_no_context_takeover
+                            : params.server_no_context_takeover;
+    m_inflateReset = client ? params.server_no_context_takeover
+                            : params.client_no_context_takeover;
+    m_dictionary = GetDictionary(params.dictionary_id);
+    memset(&m_deflate, 0, sizeof(m_deflate));
+    memset(&m_inflate, 0, sizeof(m_inflate));
+    GetStatus()->incContexts();
+}
+
+WSDeflater::~WSDeflater() {
+    if(m_deflateInited) {
+        deflateEnd(&m_deflate);
+    }
+    if(m_inflateInited) {
+        inflateEnd(&m_inflate);
+    }
+    GetStatus()->incContexts(-1);
+}
+
+bool WSDeflater::initDeflate() {
+    if(m_deflateInited) {
+        return true;
+    }
+    if(!m_deflateBits) {
+        return false;
+    }
+    m_deflate.zalloc = ZAlloc;
+    m_deflate.zfree = ZFree;
+    m_deflate.opaque = &m_memory;
+    int mem_level = std::max(1, std::min(9, s_mem_level));
+    int ret = deflateInit2(&m_deflate, s_level, Z_DEFLATED, -m_deflateBits
+                           ,mem_level, Z_DEFAULT_STRATEGY);
+    if(ret != Z_OK) {
+        SYLAR_LOG_ERROR(g_logger) << "deflateInit2 fail, ret=" << ret
+            << " level=" << s_level << " window_bits=" << m_deflateBits
+            << " mem_level=" << mem_level;
+        return false;
+    }
+    m_deflateInited = true;
+    if(m_dictionary) {
+        deflateSetDictionary(&m_deflate, (const Bytef*)m_dictionary->c_str()
+                             ,m_dictionary->size());
+    }
+    return true;
+}
+
+bool WSDeflater::initInflate() {
+    if(m_inflateInited) {
+        return true;
+    }
+    m_inflate.zalloc = ZAlloc;
+    m_inflate.zfree = ZFree;
+    m_inflate.opaque = &m_memory;
+    int ret = inflateInit2(&m_inflate, -m_inflateBits);
+    if(ret != Z_OK) {
+        SYLAR_LOG_ERROR(g_logger) << "inflateInit2 fail, ret=" << ret
+            << " window_bits=" << m_inflateBits;
+        return false;
+    }
+    m_inflateInited = true;
+    if(m_dictionary) {
+        inflateSetDictionary(&m_inflate, (const Bytef*)m_dictionary->c_str()
+                             ,m_dictionary->size());
+    }
+    return true;
+}
+
+bool WSDeflater::shouldCompress(size_t size) const {
+    return m_deflateBits && size >= s_min_size;
+}
+
+bool WSDeflater::compress(const void* data, size_t size, std::string& out) {
+    if(size > UINT32_MAX || !initDeflate()) {
+        return false;
+    }
+    uint64_t ts = GetThreadCpuUS();
+    //sync flush额外输出空的stored块(5字节)
+    out.resize(deflateBound(&m_deflate, size) + 16);
+    m_deflate.next_in = (Bytef*)data;
+    m_deflate.avail_in = size;
+    size_t pos = 0;
+    do {
+        if(pos == out.size()) {
+            out.resize(out.size() * 2);
+        }
+        m_deflate.next_out = (Bytef*)&out[pos];
+        m_deflate.avail_out = out.size() - pos;
+        int ret = deflate(&m_deflate, Z_SYNC_FLUSH);
+        pos = out.size() - m_deflate.avail_out;
+        if(ret != Z_OK && ret != Z_BUF_ERROR) {
+            SYLAR_LOG_ERROR(g_logger) << "deflate fail, ret=" << ret << " size=" << size;
+            out.clear();
+            return false;
+        }
+    } while(m_deflate.avail_out == 0);
+    //RFC 7692 7.2.1: 去掉末尾的00 00 ff ff
+    if(pos >= 4 && memcmp(&out[pos - 4], "\x00\x00\xff\xff", 4) == 0) {
+        pos -= 4;
+    }
+    out.resize(pos);
+    if(m_deflateReset) {
+        deflateReset(&m_deflate);
+        if(m_dictionary) {
+            deflateSetDictionary(&m_deflate, (const Bytef*)m_dictionary->c_str()
+                                 ,m_dictionary->size());
+        }
+    }
+    auto status = GetStatus();
+    status->incCompressed();
+    status->incCompressIn(size);
+    status->incCompressOut(out.size());
+    status->incCpuUs(GetThreadCpuUS() - ts);
+    return true;
+}
+
+bool WSDeflater::decompress(const void* data, size_t size, std::string& out, size_t max_size) {
+    if(size > UINT32_MAX || !initInflate()) {
+        return false;
+    }
+    uint64_t ts = GetThreadCpuUS();
+    auto reset = [this]() {
+        inflateReset(&m_inflate);
+        if(m_dictionary) {
+            inflateSetDictionary(&m_inflate, (const Bytef*)m_dictionary->c_str()
+                                 ,m_dictionary->size());
+        }
+    };
+
+    size_t pos = 0;
+    out.resize(std::min(std::max(size * 4, (size_t)4096), max_size + 1));
+    //先解压数据, 再补上发送方去掉的00 00 ff ff
+    const char* inputs[2] = {(const char*)data, "\x00\x00\xff\xff"};
+    size_t lens[2] = {size, 4};
+    bool ok = true;
+    for(int i = 0; i < 2 && ok; ++i) {
+        m_inflate.next_in = (Bytef*)inputs[i];
+        m_inflate.avail_in = lens[i];
+        do {
+            if(pos == out.size()) {
+                if(out.size() > max_size) {
+                    ok = false;
+                    break;
+                }
+                out.resize(std::min(out.size() * 2, max_size + 1));
+            }
+            m_inflate.next_out = (Bytef*)&out[pos];
+            m_inflate.avail_out = out.size() - pos;
+            int ret = inflate(&m_inflate, Z_SYNC_FLUSH);
+            pos = out.size() - m_inflate.avail_out;
+            if(ret == Z_STREAM_END) {
+                //发送方设置了BFINAL, 后续数据是新的deflate流
+                reset();
+                if(m_inflate.avail_in == 0) {
+                    break;
+                }
+            } else if(ret != Z_OK && ret != Z_BUF_ERROR) {
+                SYLAR_LOG_INFO(g_logger) << "inflate fail, ret=" << ret
+                    << " msg=" << (m_inflate.msg ? m_inflate.msg : "");
+                ok = false;
+                break;
+            }
+        } while(m_inflate.avail_in > 0 || m_inflate.avail_out == 0);
+    }
+    if(!ok || pos > max_size) {
+        SYLAR_LOG_INFO(g_logger) << "websocket inflate fail, size=" << size
+            << " out=" << pos << " max_size=" << max_size;
+        out.clear();
+        //上下文已不可用, 连接需要关闭
+        reset();
+        return false;
+    }
+    out.resize(pos);
+    if(m_inflateReset) {
+        reset();
+    }
+    auto status = GetStatus();
+    status->incDecompressed();
+    status->incDecompressIn(size);
+    status->incDecompressOut(out.size());
+    status->incCpuUs(GetThreadCpuUS() - ts);
+    return true;
+}
+
+std::string WSDeflater::toString() const {
+    std::stringstream ss;
+    ss << "[WSDeflater client=" << m_client
+       << " params=\"" << m_params.toString() << "\""
+       << " deflate_bits=" << m_deflateBits
+       << " inflate_bits=" << m_inflateBits
+       << " memory=" << m_memory
+       << "]";
+    return ss.str();
+}
+
+}
+}
@@ -0,0 +1,199 @@
+/**
+ * @file ws_deflate.h
+ * @brief WebSocket permessage-deflate扩展(RFC 7692)
+ */
+#ifndef __SYLAR_HTTP_WS_DEFLATE_H__
+#define __SYLAR_HTTP_WS_DEFLATE_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <zlib.h>
+#include "sylar/util.h"
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief permessage-deflate协商参数
+ */
+struct WSDeflateParams {
+    /// 服务端每条消息后重置压缩上下文
+    bool server_no_context_takeover = false;
+    /// 客户端每条消息后重置压缩上下文
+    bool client_no_context_takeover = false;
+    /// 服务端压缩窗口(8~15)
+    int server_max_window_bits = 15;
+    /// 客户端压缩窗口(8~15), 解析offer时未携带该参数为-1
+    int client_max_window_bits = 15;
+    /// 共享字典标识(crc32c), 为空时不使用字典, 非标准参数x-sylar-dictionary
+    std::string dictionary_id;
+
+    /**
+     * @brief 输出为Sec-WebSocket-Extensions中的一项
+     */
+    std::string toString() const;
+};
+
+/**
+ * @brief permessage-deflate统计
+ */
+class WSDeflateStatus {
+public:
+    int64_t incContexts(int64_t v = 1) { return Atomic::addFetch(m_contexts, v);}
+    int64_t incMemory(int64_t v) { return Atomic::addFetch(m_memory, v);}
+    int64_t incCompressed(int64_t v = 1) { return Atomic::addFetch(m_compressed, v);}
+    int64_t incSkipped(int64_t v = 1) { return Atomic::addFetch(m_skipped, v);}
+    int64_t incCompressIn(int64_t v) { return Atomic::addFetch(m_compressIn, v);}
+    int64_t incCompressOut(int64_t v) { return Atomic::addFetch(m_compressOut, v);}
+    int64_t incDecompressed(int64_t v = 1) { return Atomic::addFetch(m_decompressed, v);}
+    int64_t incDecompressIn(int64_t v) { return Atomic::addFetch(m_decompressIn, v);}
+    int64_t incDecompressOut(int64_t v) { return Atomic::addFetch(m_decompressOut, v);}
+    int64_t incCpuUs(int64_t v) { return Atomic::addFetch(m_cpuUs, v);}
+
+    int64_t getContexts() const { return m_contexts;}
+    int64_t getMemory() const { return m_memory;}
+    int64_t getCompressed() const { return m_compressed;}
+    int64_t getSkipped() const { return m_skipped;}
+    int64_t getCompressIn() const { return m_compressIn;}
+    int64_t getCompressOut() const { return m_compressOut;}
+    int64_t getDecompressed() const { return m_decompressed;}
+    int64_t getDecompressIn() const { return m_decompressIn;}
+    int64_t getDecompressOut() const { return m_decompressOut;}
+    int64_t getCpuUs() const { return m_cpuUs;}
+
+    std::string toString() const;
+private:
+    /// 存活的连接上下文数
+    int64_t m_contexts = 0;
+    /// 已分配的zlib内存
+    int64_t m_memory = 0;
+    /// 压缩发送的消息数
+    int64_t m_compressed = 0;
+    /// 低于最小长度未压缩的消息数
+    int64_t m_skipped = 0;
+    /// 压缩前字节数
+    int64_t m_compressIn = 0;
+    /// 压缩后字节数
+    int64_t m_compressOut = 0;
+    /// 解压的消息数
+    int64_t m_decompressed = 0;
+    /// 解压前字节数
+    int64_t m_decompressIn = 0;
+    /// 解压后字节数
+    int64_t m_decompressOut = 0;
+    /// 压缩和解压消耗的线程CPU时间(微秒)
+    int64_t m_cpuUs = 0;
+};
+
+/**
+ * @brief 一个连接的permessage-deflate上下文
+ * @details 压缩和解压的z_stream在第一次使用时才分配, 窗口大小按协商结果设置,
+ *          以限制每个连接的内存. 与WSSession一样非线程安全, 需要与发送/接收顺序一致.
+ *          websocket.deflate.enable默认关闭, 开启后才会协商.
+ *          配置项: websocket.deflate.enable / level / mem_level / min_size
+ *          / server_max_window_bits / client_max_window_bits
+ *          / server_no_context_takeover / client_no_context_takeover / dictionary
+ */
+class WSDeflater {
+public:
+    typedef std::shared_ptr<WSDeflater> ptr;
+
+    /**
+     * @brief 构造
+     * @param[in] params 协商结果
+     * @param[in] client 本端是否客户端
+     */
+    WSDeflater(const WSDeflateParams& params, bool client);
+    ~WSDeflater();
+
+    /**
+     * @brief 服务端: 按配置从请求的Sec-WebSocket-Extensions中选择第一个可接受的permessage-deflate
+     * @param[in] offer 请求头Sec-WebSocket-Extensions
+     * @param[out] response 响应头Sec-WebSocket-Extensions的值
+     * @return 不启用时返回nullptr
+     */
+    static WSDeflater::ptr Accept(const std::string& offer, std::string& response);
+
+    /**
+     * @brief 客户端: 按配置生成Sec-WebSocket-Extensions, 未启用时返回空
+     */
+    static std::string Offer();
+
+    /**
+     * @brief 客户端: 解析响应的Sec-WebSocket-Extensions
+     * @param[in] response 响应头
+     * @param[out] deflater 服务端接受时的上下文
+     * @return 响应非法(未请求的扩展或参数)时返回false
+     */
+    static bool Confirm(const std::string& response, WSDeflater::ptr& deflater);
+
+    /**
+     * @brief 解析Sec-WebSocket-Extensions中的permessage-deflate
+     * @param[in] header 头部值, 逗号分隔多项
+     * @param[out] offers 每项permessage-deflate的参数
+     * @return 参数不合法的项会被跳过, 存在被跳过的项时返回false
+     */
+    static bool Parse(const std::string& header, std::vector<WSDeflateParams>& offers);
+
+    /**
+     * @brief 长度为size的消息是否压缩
+     */
+    bool shouldCompress(size_t size) const;
+
+    /**
+     * @brief 压缩一条消息, 结果去掉末尾的00 00 ff ff
+     */
+    bool compress(const void* data, size_t size, std::string& out);
+
+    /**
+     * @brief 解压一条消息
+     * @param[in] max_size 解压后最大长度, 超过时失败
+     */
+    bool decompress(const void* data, size_t size, std::string& out, size_t max_size);
+
+    const WSDeflateParams& getParams() const { return m_params;}
+    bool isClient() const { return m_client;}
+
+    /**
+     * @brief 当前连接已分配的zlib内存
+     */
+    int64_t getMemoryUsage() const { return m_memory;}
+
+    std::string toString() const;
+
+    /**
+     * @brief 返回全局统计
+     */
+    static WSDeflateStatus* GetStatus();
+
+    /**
+     * @brief 返回统计信息
+     */
+    static std::string StatusString();
+private:
+    bool initDeflate();
+    bool initInflate();
+private:
+    WSDeflateParams m_params;
+    bool m_client;
+    /// 压缩窗口, 0表示对端要求的窗口zlib不支持, 只发送不压缩的消息
+    int m_deflateBits;
+    int m_inflateBits;
+    /// 本端每条消息后重置压缩上下文
+    bool m_deflateReset;
+    /// 对端每条消息后重置, 使用字典时解压上下文需要同步重置
+    bool m_inflateReset;
+    bool m_deflateInited = false;
+    bool m_inflateInited = false;
+    z_stream m_deflate;
+    z_stream m_inflate;
+    int64_t m_memory = 0;
+    std::shared_ptr<std::string> m_dictionary;
+};
+
+}
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "ws_server.h"
+#include "ws_session_manager.h"
 #include "sylar/log.h"
 
 namespace sylar {
@@ -26,9 +27,13 @@ void WSServer::handleClient(Socket::ptr client) {
             SYLAR_LOG_DEBUG(g_logger) << "no match WSServlet";
             break;
         }
+        //在连接自己的协程中启动发送队列, 之后直接发送和广播都经过队列
+        session->startSendQueue();
+        WSSessionMgr::GetInstance()->add(session);
         int rt = servlet->onConnect(header, session);
         if(rt) {
             SYLAR_LOG_DEBUG(g_logger) << "onConnect return " << rt;
+            WSSessionMgr::GetInstance()->del(session);
             break;
         }
         while(true) {
@@ -42,6 +47,7 @@ void WSServer::handleClient(Socket::ptr client) {
                 break;
             }
         }
+        WSSessionMgr::GetInstance()->del(session);
         servlet->onClose(header, session);
     } while(0);
     session->close();
@@ -1,7 +1,13 @@
 #include "ws_session.h"
 #include "sylar/log.h"
 #include "sylar/endian.h"
+#include "sylar/util/hash_util.h"
+#include "sylar/streams/socket_stream.h"
 #include <string.h>
+#include <random>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 namespace sylar {
 namespace http {
@@ -12,8 +18,27 @@ sylar::ConfigVar<uint32_t>::ptr g_websocket_message_max_size
     = sylar::Config::Lookup("websocket.message.max_size"
             ,(uint32_t) 1024 * 1024 * 32, "websocket message max size");
 
+static sylar::ConfigVar<uint32_t>::ptr g_websocket_recv_buffer_size
+    = sylar::Config::Lookup("websocket.recv_buffer_size"
+            ,(uint32_t) 16 * 1024, "websocket recv read ahead size");
+
+static sylar::ConfigVar<uint64_t>::ptr g_websocket_send_queue_max_bytes
+    = sylar::Config::Lookup("websocket.send_queue.max_bytes"
+            ,(uint64_t) 4 * 1024 * 1024, "websocket per connection send queue max bytes");
+
+static sylar::ConfigVar<uint32_t>::ptr g_websocket_send_queue_max_frames
+    = sylar::Config::Lookup("websocket.send_queue.max_frames"
+            ,(uint32_t) 4096, "websocket per connection send queue max frames");
+
+static sylar::ConfigVar<std::string>::ptr g_websocket_send_queue_policy
+    = sylar::Config::Lookup("websocket.send_queue.policy"
+            ,std::string("drop"), "websocket send queue full policy for broadcast frames: drop, disconnect, coalesce");
+
 WSSession::WSSession(Socket::ptr sock, bool owner)
     :HttpSession(sock, owner) {
+    m_maxQueueBytes = g_websocket_send_queue_max_bytes->getValue();
+    m_maxQueueFrames = g_websocket_send_queue_max_frames->getValue();
+    m_sendPolicy = SendPolicyFromString(g_websocket_send_queue_policy->getValue());
 }
 
 HttpRequest::ptr WSSession::handleShake() {
@@ -43,7 +68,10 @@ HttpRequest::ptr WSSession::handleShake() {
         }
 
         std::string v = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
-        v = sylar::base64encode(sylar::sha1sum(v));
+        unsigned char digest[20];
+        char accept[28];
+        sylar::sha1sum(v.c_str(), v.size(), digest);
+        v.assign(accept, sylar::base64encode(digest, sizeof(digest), accept));
         req->setWebsocket(true);
 
         auto rsp = req->createResponse();
@@ -54,6 +82,12 @@ HttpRequest::ptr WSSession::handleShake() {
         rsp->setHeader("Connection", "Upgrade");
         rsp->setHeader("Sec-WebSocket-Accept", v);
 
+        std::string ext;
+        m_deflater = WSDeflater::Accept(req->getHeader("Sec-WebSocket-Extensions"), ext);
+        if(m_deflater) {
+            rsp->setHeader("Sec-WebSocket-Extensions", ext);
+        }
+
         sendResponse(rsp);
         SYLAR_LOG_DEBUG(g_logger) << *req;
         SYLAR_LOG_DEBUG(g_logger) << *rsp;
@@ -84,62 +118,441 @@ std::string WSFrameHead::toString() const {
 }
 
 WSFrameMessage::ptr WSSession::recvMessage() {
-    return WSRecvMessage(this, false);
+    if(m_sendQueueStarted) {
+        return WSRecvMessage(this, false, &m_recvBuffer, m_deflater.get()
+                ,[this](WSFrameMessage::ptr msg) {
+                    int32_t rt = sendMessage(msg);
+                    //随后会关闭连接, 先等CLOSE写出
+                    if(rt > 0 && msg->getOpcode() == WSFrameHead::CLOSE) {
+                        waitSendFlush();
+                    }
+                    return rt;
+                });
+    }
+    return WSRecvMessage(this, false, &m_recvBuffer, m_deflater.get());
 }
 
 int32_t WSSession::sendMessage(WSFrameMessage::ptr msg, bool fin) {
-    return WSSendMessage(this, msg, false, fin);
+    if(!m_sendQueueStarted) {
+        return WSSendMessage(this, msg, false, fin, m_deflater.get());
+    }
+    //在持有m_encodeMutex之前等待, 等待时协程让出, 不能占着线程锁
+    waitSendSpace();
+    const std::string& data = msg->getData();
+    MutexType::Lock lock(m_encodeMutex);
+    BufferChain frame;
+    if(!WSEncodeFrame(frame, msg->getOpcode(), data.c_str(), data.size(), fin, m_deflater.get())) {
+        lock.unlock();
+        close();
+        return -1;
+    }
+    //直接发送的消息(包括PONG)不丢弃, 已经等待过队列空间, 并发发送时允许少量超出
+    int32_t size = frame.size();
+    return enqueue(frame, 0, false) == SEND_OK ? size : -1;
 }
 
 int32_t WSSession::sendMessage(const std::string& msg, int32_t opcode, bool fin) {
-    return WSSendMessage(this, std::make_shared<WSFrameMessage>(opcode, msg), false, fin);
+    return sendMessage(std::make_shared<WSFrameMessage>(opcode, msg), fin);
 }
 
 int32_t WSSession::ping() {
+    if(m_sendQueueStarted) {
+        return sendMessage(std::make_shared<WSFrameMessage>(WSFrameHead::PING));
+    }
     return WSPing(this);
 }
 
-WSFrameMessage::ptr WSRecvMessage(Stream* stream, bool client) {
+void WSSession::close() {
+    HttpSession::close();
+    if(m_sendQueueStarted) {
+        m_sendSem.notify();
+        notifySendSpace();
+    }
+}
+
+bool WSSession::startSendQueue(IOManager* iom) {
+    if(!iom) {
+        return false;
+    }
+    bool expected = false;
+    if(!m_sendQueueStarted.compare_exchange_strong(expected, true)) {
+        return false;
+    }
+    iom->schedule(std::bind(&WSSession::doWrite, shared_from_this()));
+    return true;
+}
+
+size_t WSSession::getSendQueueFrames() const {
+    MutexType::Lock lock(m_queueMutex);
+    return m_queue.size();
+}
+
+void WSSession::waitSendSpace() {
+    if(!Scheduler::GetThis()) {
+        return;
+    }
+    while(isConnected()) {
+        {
+            MutexType::Lock lock(m_queueMutex);
+            if(m_queue.empty() || (m_queueBytes < m_maxQueueBytes
+                        && m_queue.size() < m_maxQueueFrames)) {
+                return;
+            }
+            ++m_spaceWaiters;
+        }
+        m_spaceSem.wait();
+    }
+}
+
+void WSSession::waitSendFlush() {
+    if(!Scheduler::GetThis()) {
+        return;
+    }
+    while(isConnected()) {
+        {
+            MutexType::Lock lock(m_queueMutex);
+            if(m_queue.empty() && !m_writing) {
+                return;
+            }
+            ++m_spaceWaiters;
+        }
+        m_spaceSem.wait();
+    }
+}
+
+void WSSession::notifySendSpace() {
+    uint32_t n = 0;
+    {
+        MutexType::Lock lock(m_queueMutex);
+        n = m_spaceWaiters;
+        m_spaceWaiters = 0;
+    }
+    for(uint32_t i = 0; i < n; ++i) {
+        m_spaceSem.notify();
+    }
+}
+
+void WSSession::setSendQueueLimit(uint64_t max_bytes, uint32_t max_frames) {
+    MutexType::Lock lock(m_queueMutex);
+    m_maxQueueBytes = max_bytes;
+    m_maxQueueFrames = max_frames;
+}
+
+WSSession::SendResult WSSession::sendFrame(const BufferChain& frame, uint64_t coalesce_key) {
+    if(!m_sendQueueStarted) {
+        BufferChain tmp(frame);
+        return writeFixSize(tmp, tmp.size()) > 0 ? SEND_OK : SEND_CLOSED;
+    }
+    return enqueue(frame, coalesce_key, true);
+}
+
+WSSession::SendResult WSSession::enqueue(const BufferChain& frame, uint64_t key, bool droppable) {
+    if(!isConnected()) {
+        return SEND_CLOSED;
+    }
+    MutexType::Lock lock(m_queueMutex);
+    if(m_sendPolicy == COALESCE && key) {
+        auto it = m_coalesceIndex.find(key);
+        if(it != m_coalesceIndex.end()) {
+            auto& f = m_queue[it->second];
+            m_queueBytes = m_queueBytes - f.data.size() + frame.size();
+            f.data = frame;
+            ++m_coalesced;
+            return SEND_COALESCED;
+        }
+    }
+    //队列为空时总是接收, 避免单个大帧永远发不出去
+    if(droppable && !m_queue.empty() && (m_queueBytes + frame.size() > m_maxQueueBytes
+                || m_queue.size() >= m_maxQueueFrames)) {
+        if(m_sendPolicy != DISCONNECT) {
+            ++m_dropped;
+            return SEND_DROPPED;
+        }
+        lock.unlock();
+        SYLAR_LOG_INFO(g_logger) << "send queue full, disconnect " << toString();
+        close();
+        return SEND_DISCONNECTED;
+    }
+    bool empty = m_queue.empty();
+    m_queue.push_back(QueuedFrame{frame, key});
+    if(m_sendPolicy == COALESCE && key) {
+        m_coalesceIndex[key] = m_queue.size() - 1;
+    }
+    m_queueBytes += frame.size();
+    lock.unlock();
+    if(empty) {
+        m_sendSem.notify();
+    }
+    return SEND_OK;
+}
+
+void WSSession::doWrite() {
+    while(true) {
+        m_sendSem.wait();
+        std::deque<QueuedFrame> frames;
+        {
+            MutexType::Lock lock(m_queueMutex);
+            m_queue.swap(frames);
+            m_coalesceIndex.clear();
+            m_queueBytes = 0;
+            m_writing = !frames.empty();
+        }
+        notifySendSpace();
+        if(!isConnected()) {
+            break;
+        }
+        //一次取出的帧合并为一次sendmsg
+        BufferChain out;
+        for(auto& i : frames) {
+            out.append(std::move(i.data));
+        }
+        if(!out.empty() && writeFixSize(out, out.size()) <= 0) {
+            close();
+            break;
+        }
+        if(!out.empty()) {
+            {
+                MutexType::Lock lock(m_queueMutex);
+                m_writing = false;
+            }
+            notifySendSpace();
+        }
+    }
+    {
+        MutexType::Lock lock(m_queueMutex);
+        m_writing = false;
+        m_queue.clear();
+        m_coalesceIndex.clear();
+        m_queueBytes = 0;
+    }
+    notifySendSpace();
+}
+
+std::string WSSession::toString() const {
+    std::stringstream ss;
+    ss << "[WSSession id=" << m_id;
+    auto sock = getSocket();
+    if(sock && sock->getRemoteAddress()) {
+        ss << " remote=" << sock->getRemoteAddress()->toString();
+    }
+    {
+        MutexType::Lock lock(m_queueMutex);
+        ss << " send_queue=" << m_sendQueueStarted
+           << " policy=" << SendPolicyToString(m_sendPolicy)
+           << " queue_frames=" << m_queue.size()
+           << " queue_bytes=" << m_queueBytes
+           << " dropped=" << m_dropped
+           << " coalesced=" << m_coalesced;
+    }
+    if(m_deflater) {
+        ss << " deflate_memory=" << m_deflater->getMemoryUsage();
+    }
+    ss << "]";
+    return ss.str();
+}
+
+WSSession::SendPolicy WSSession::SendPolicyFromString(const std::string& v) {
+    if(strcasecmp(v.c_str(), "disconnect") == 0) {
+        return DISCONNECT;
+    } else if(strcasecmp(v.c_str(), "coalesce") == 0) {
+        return COALESCE;
+    }
+    return DROP;
+}
+
+const char* WSSession::SendPolicyToString(SendPolicy v) {
+    switch(v) {
+        case DISCONNECT:
+            return "disconnect";
+        case COALESCE:
+            return "coalesce";
+        default:
+            return "drop";
+    }
+}
+
+namespace {
+
+/**
+ * @brief 帧读取
+ * @details 有缓存时每次至少预读websocket.recv_buffer_size, 小帧一次读取即可解析多个;
+ *          无缓存时只读取需要的长度
+ */
+struct WSFrameReader {
+    WSFrameReader(Stream* s, BufferChain* b)
+        :stream(s)
+        ,buffer(b ? b : &local)
+        ,read_ahead(b != nullptr) {
+    }
+
+    /**
+     * @brief 读取一次, 至少need个字节(无缓存时)或尽量多读(有缓存时)
+     */
+    bool readMore(size_t need) {
+        int rt = 0;
+        if(read_ahead) {
+            size_t len = std::max(need, (size_t)s_recv_buffer_size);
+            rt = stream->read(*buffer, std::min(len, (size_t)MAX_READ_SIZE));
+        } else {
+            rt = stream->readFixSize(*buffer, need);
+        }
+        return rt > 0;
+    }
+
+    /**
+     * @brief 保证缓存中至少有n个字节
+     */
+    bool fill(size_t n) {
+        while(buffer->size() < n) {
+            if(!readMore(n - buffer->size())) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief 读取len个字节到dst, 有掩码时边复制边解码
+     */
+    bool readPayload(char* dst, uint64_t len, const char* mask) {
+        uint64_t pos = 0;
+        std::vector<iovec> iovs;
+        while(pos < len) {
+            if(buffer->empty() && !readMore(len - pos)) {
+                return false;
+            }
+            iovs.clear();
+            uint64_t n = buffer->getReadBuffers(iovs, len - pos);
+            for(auto& i : iovs) {
+                if(mask) {
+                    WSMaskPayload(dst + pos, i.iov_base, i.iov_len, mask, pos);
+                } else {
+                    memcpy(dst + pos, i.iov_base, i.iov_len);
+                }
+                pos += i.iov_len;
+            }
+            buffer->consume(n);
+        }
+        return true;
+    }
+
+    bool skip(uint64_t len) {
+        while(len > 0) {
+            if(buffer->empty() && !readMore(len)) {
+                return false;
+            }
+            uint64_t n = std::min(len, (uint64_t)buffer->size());
+            buffer->consume(n);
+            len -= n;
+        }
+        return true;
+    }
+
+    static const size_t MAX_READ_SIZE = 256 * 1024;
+    static uint32_t s_recv_buffer_size;
+
+    Stream* stream;
+    BufferChain local;
+    BufferChain* buffer;
+    bool read_ahead;
+};
+
+uint32_t WSFrameReader::s_recv_buffer_size = 16 * 1024;
+
+struct _WSSessionIniter {
+    _WSSessionIniter() {
+        WSFrameReader::s_recv_buffer_size = g_websocket_recv_buffer_size->getValue();
+        g_websocket_recv_buffer_size->addListener([](const uint32_t& old_value, const uint32_t& new_value){
+            SYLAR_LOG_INFO(g_logger) << "websocket recv buffer size changed from "
+                                     << old_value << " to " << new_value;
+            WSFrameReader::s_recv_buffer_size = new_value;
+        });
+    }
+};
+
+static _WSSessionIniter s_ws_session_initer;
+
+}
+
+WSFrameMessage::ptr WSRecvMessage(Stream* stream, bool client, BufferChain* buffer
+                                  ,WSDeflater* deflater
+                                  ,std::function<int32_t(WSFrameMessage::ptr)> reply) {
+    WSFrameReader reader(stream, buffer);
     int opcode = 0;
+    bool compressed = false;
     std::string data;
-    int cur_len = 0;
+    uint64_t cur_len = 0;
     do {
-        WSFrameHead ws_head;
-        if(stream->readFixSize(&ws_head, sizeof(ws_head)) <= 0) {
+        if(!reader.fill(sizeof(WSFrameHead))) {
             break;
         }
+        WSFrameHead ws_head;
+        reader.buffer->copyTo(&ws_head, sizeof(ws_head));
         SYLAR_LOG_DEBUG(g_logger) << "WSFrameHead " << ws_head.toString();
+        //RFC 6455 5.1: 客户端发出的帧必须带掩码, 否则以1002(协议错误)关闭
+        if(!client && !ws_head.mask) {
+            SYLAR_LOG_INFO(g_logger) << "unmasked client frame " << ws_head.toString();
+            std::string code("\x03\xea", 2);
+            auto close = std::make_shared<WSFrameMessage>(WSFrameHead::CLOSE, code);
+            reply ? reply(close) : WSSendMessage(stream, close, client, true);
+            break;
+        }
+        //RSV1只在协商了permessage-deflate时用于消息的第一个数据帧
+        if(ws_head.rsv2 || ws_head.rsv3 || (ws_head.rsv1 && (!deflater
+                    || ws_head.opcode == WSFrameHead::CONTINUE || (ws_head.opcode & 0x8)))) {
+            SYLAR_LOG_INFO(g_logger) << "invalid rsv " << ws_head.toString();
+            break;
+        }
 
-        if(ws_head.opcode == WSFrameHead::PING) {
-            SYLAR_LOG_INFO(g_logger) << "PING";
-            if(WSPong(stream) <= 0) {
+        size_t head_len = sizeof(ws_head) + (ws_head.mask ? 4 : 0);
+        if(ws_head.payload == 126) {
+            head_len += 2;
+        } else if(ws_head.payload == 127) {
+            head_len += 8;
+        }
+        if(!reader.fill(head_len)) {
+            break;
+        }
+        uint8_t head[14];
+        reader.buffer->read(head, head_len);
+
+        uint64_t length = 0;
+        if(ws_head.payload == 126) {
+            uint16_t len = 0;
+            memcpy(&len, head + 2, sizeof(len));
+            length = sylar::byteswapOnLittleEndian(len);
+        } else if(ws_head.payload == 127) {
+            uint64_t len = 0;
+            memcpy(&len, head + 2, sizeof(len));
+            length = sylar::byteswapOnLittleEndian(len);
+        } else {
+            length = ws_head.payload;
+        }
+        const char* mask = ws_head.mask ? (const char*)head + head_len - 4 : nullptr;
+
+        if(ws_head.opcode == WSFrameHead::PING
+                || ws_head.opcode == WSFrameHead::PONG
+                || ws_head.opcode == WSFrameHead::CLOSE) {
+            if(length > 125) {
+                SYLAR_LOG_INFO(g_logger) << "control frame payload > 125 " << ws_head.toString();
                 break;
             }
-        } else if(ws_head.opcode == WSFrameHead::PONG) {
-        } else if(ws_head.opcode == WSFrameHead::CONTINUE
-                || ws_head.opcode == WSFrameHead::TEXT_FRAME
-                || ws_head.opcode == WSFrameHead::BIN_FRAME) {
-            if(!client && !ws_head.mask) {
-                SYLAR_LOG_INFO(g_logger) << "WSFrameHead mask != 1";
+            std::string payload(length, '\0');
+            if(!reader.readPayload(&payload[0], length, mask)) {
                 break;
             }
-            uint64_t length = 0;
-            if(ws_head.payload == 126) {
-                uint16_t len = 0;
-                if(stream->readFixSize(&len, sizeof(len)) <= 0) {
-                    break;
-                }
-                length = sylar::byteswapOnLittleEndian(len);
-            } else if(ws_head.payload == 127) {
-                uint64_t len = 0;
-                if(stream->readFixSize(&len, sizeof(len)) <= 0) {
+            if(ws_head.opcode == WSFrameHead::PING) {
+                auto pong = std::make_shared<WSFrameMessage>(WSFrameHead::PONG, payload);
+                if((reply ? reply(pong) : WSSendMessage(stream, pong, client, true)) < 0) {
                     break;
                 }
-                length = sylar::byteswapOnLittleEndian(len);
-            } else {
-                length = ws_head.payload;
+            } else if(ws_head.opcode == WSFrameHead::CLOSE) {
+                SYLAR_LOG_DEBUG(g_logger) << "CLOSE";
+                break;
             }
-
+        } else if(ws_head.opcode == WSFrameHead::CONTINUE
+                || ws_head.opcode == WSFrameHead::TEXT_FRAME
+                || ws_head.opcode == WSFrameHead::BIN_FRAME) {
             if((cur_len + length) >= g_websocket_message_max_size->getValue()) {
                 SYLAR_LOG_WARN(g_logger) << "WSFrameMessage length > "
                     << g_websocket_message_max_size->getValue()
@@ -147,93 +560,250 @@ WSFrameMessage::ptr WSRecvMessage(Stream* stream, bool client) {
                 break;
             }
 
-            char mask[4] = {0};
-            if(ws_head.mask) {
-                if(stream->readFixSize(mask, sizeof(mask)) <= 0) {
-                    break;
-                }
-            }
             data.resize(cur_len + length);
-            if(stream->readFixSize(&data[cur_len], length) <= 0) {
+            if(!reader.readPayload(&data[cur_len], length, mask)) {
                 break;
             }
-            if(ws_head.mask) {
-                for(int i = 0; i < (int)length; ++i) {
-                    data[cur_len + i] ^= mask[i % 4];
-                }
-            }
             cur_len += length;
 
             if(!opcode && ws_head.opcode != WSFrameHead::CONTINUE) {
                 opcode = ws_head.opcode;
+                compressed = ws_head.rsv1;
             }
 
             if(ws_head.fin) {
-                SYLAR_LOG_DEBUG(g_logger) << data;
+                if(compressed) {
+                    std::string raw;
+                    if(!deflater->decompress(data.c_str(), data.size(), raw
+                                , g_websocket_message_max_size->getValue())) {
+                        break;
+                    }
+                    data.swap(raw);
+                }
                 return WSFrameMessage::ptr(new WSFrameMessage(opcode, std::move(data)));
             }
         } else {
             SYLAR_LOG_DEBUG(g_logger) << "invalid opcode=" << ws_head.opcode;
+            if(!reader.skip(length)) {
+                break;
+            }
         }
     } while(true);
     stream->close();
     return nullptr;
 }
 
-int32_t WSSendMessage(Stream* stream, WSFrameMessage::ptr msg, bool client, bool fin) {
+size_t WSEncodeFrameHead(void* buf, int opcode, bool fin, uint64_t length
+                         ,const char* mask, bool rsv1) {
+    uint8_t* p = (uint8_t*)buf;
+    WSFrameHead ws_head;
+    memset(&ws_head, 0, sizeof(ws_head));
+    ws_head.fin = fin;
+    ws_head.rsv1 = rsv1;
+    ws_head.opcode = opcode;
+    ws_head.mask = mask != nullptr;
+    size_t pos = sizeof(ws_head);
+    if(length < 126) {
+        ws_head.payload = length;
+    } else if(length < 65536) {
+        ws_head.payload = 126;
+        uint16_t len = sylar::byteswapOnLittleEndian((uint16_t)length);
+        memcpy(p + pos, &len, sizeof(len));
+        pos += sizeof(len);
+    } else {
+        ws_head.payload = 127;
+        uint64_t len = sylar::byteswapOnLittleEndian(length);
+        memcpy(p + pos, &len, sizeof(len));
+        pos += sizeof(len);
+    }
+    memcpy(p, &ws_head, sizeof(ws_head));
+    if(mask) {
+        memcpy(p + pos, mask, 4);
+        pos += 4;
+    }
+    return pos;
+}
+
+/**
+ * @brief 按需压缩消息
+ * @return -1压缩失败, 0不压缩, 1压缩结果在out中
+ */
+static int CompressMessage(WSDeflater* deflater, int opcode, bool fin
+                           ,const void* data, size_t size, std::string& out) {
+    //分片发送的消息不压缩
+    if(!deflater || !fin || (opcode != WSFrameHead::TEXT_FRAME
+                && opcode != WSFrameHead::BIN_FRAME)) {
+        return 0;
+    }
+    if(!deflater->shouldCompress(size)) {
+        WSDeflater::GetStatus()->incSkipped();
+        return 0;
+    }
+    return deflater->compress(data, size, out) ? 1 : -1;
+}
+
+bool WSEncodeFrame(BufferChain& out, int opcode, const void* data, size_t len
+                   ,bool fin, WSDeflater* deflater) {
+    std::string compressed;
+    int rt = CompressMessage(deflater, opcode, fin, data, len, compressed);
+    if(rt < 0) {
+        return false;
+    }
+    if(rt > 0) {
+        data = compressed.c_str();
+        len = compressed.size();
+    }
+    char head[14];
+    size_t head_len = WSEncodeFrameHead(head, opcode, fin, len, nullptr, rt > 0);
+    out.append(head, head_len);
+    out.append(data, len);
+    return true;
+}
+
+int32_t WSSendMessage(Stream* stream, WSFrameMessage::ptr msg, bool client, bool fin
+                      ,WSDeflater* deflater) {
+    static thread_local std::mt19937 s_rng(std::random_device{}());
     do {
-        WSFrameHead ws_head;
-        memset(&ws_head, 0, sizeof(ws_head));
-        ws_head.fin = fin;
-        ws_head.opcode = msg->getOpcode();
-        ws_head.mask = client;
+        const char* data = msg->getData().c_str();
         uint64_t size = msg->getData().size();
-        if(size < 126) {
-            ws_head.payload = size;
-        } else if(size < 65536) {
-            ws_head.payload = 126;
-        } else {
-            ws_head.payload = 127;
-        }
-        
-        if(stream->writeFixSize(&ws_head, sizeof(ws_head)) <= 0) {
+        std::string compressed;
+        int rt = CompressMessage(deflater, msg->getOpcode(), fin, data, size, compressed);
+        if(rt < 0) {
             break;
         }
-        if(ws_head.payload == 126) {
-            uint16_t len = size;
-            len = sylar::byteswapOnLittleEndian(len);
-            if(stream->writeFixSize(&len, sizeof(len)) <= 0) {
-                break;
-            }
-        } else if(ws_head.payload == 127) {
-            uint64_t len = sylar::byteswapOnLittleEndian(size);
-            if(stream->writeFixSize(&len, sizeof(len)) <= 0) {
-                break;
-            }
+        bool rsv1 = rt > 0;
+        if(rsv1) {
+            data = compressed.c_str();
+            size = compressed.size();
         }
+        char head[14];
+        size_t head_len = 0;
         if(client) {
             char mask[4];
-            uint32_t rand_value = rand();
+            uint32_t rand_value = s_rng();
             memcpy(mask, &rand_value, sizeof(mask));
-            std::string& data = msg->getData();
-            for(size_t i = 0; i < data.size(); ++i) {
-                data[i] ^= mask[i % 4];
-            }
-
-            if(stream->writeFixSize(mask, sizeof(mask)) <= 0) {
+            head_len = WSEncodeFrameHead(head, msg->getOpcode(), fin, size, mask, rsv1);
+            //在副本上做掩码, 帧头和数据一次写出
+            std::string buf(head_len + size, '\0');
+            memcpy(&buf[0], head, head_len);
+            WSMaskPayload(&buf[head_len], data, size, mask);
+            if(stream->writeFixSize(buf.c_str(), buf.size()) <= 0) {
                 break;
             }
+        } else {
+            head_len = WSEncodeFrameHead(head, msg->getOpcode(), fin, size, nullptr, rsv1);
+            SocketStream* ss = dynamic_cast<SocketStream*>(stream);
+            if(ss) {
+                iovec iovs[2];
+                iovs[0].iov_base = head;
+                iovs[0].iov_len = head_len;
+                iovs[1].iov_base = (void*)data;
+                iovs[1].iov_len = size;
+                if(ss->writevFixSize(iovs, size ? 2 : 1) <= 0) {
+                    break;
+                }
+            } else {
+                if(stream->writeFixSize(head, head_len) <= 0) {
+                    break;
+                }
+                if(size && stream->writeFixSize(data, size) <= 0) {
+                    break;
+                }
+            }
         }
-        if(stream->writeFixSize(msg->getData().c_str(), size) <= 0) {
-            break;
-        }
-        return size + sizeof(ws_head);
+        return size + head_len;
     } while(0);
     stream->close();
     return -1;
 }
 
+static void MaskScalar(uint8_t* dst, const uint8_t* src, size_t len, uint32_t mask) {
+    uint64_t m = ((uint64_t)mask << 32) | mask;
+    size_t i = 0;
+    for(; i + 8 <= len; i += 8) {
+        uint64_t v;
+        memcpy(&v, src + i, sizeof(v));
+        v ^= m;
+        memcpy(dst + i, &v, sizeof(v));
+    }
+    const uint8_t* mb = (const uint8_t*)&mask;
+    for(; i < len; ++i) {
+        dst[i] = src[i] ^ mb[i & 3];
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+static size_t MaskSSE2(uint8_t* dst, const uint8_t* src, size_t len, uint32_t mask) {
+    __m128i m = _mm_set1_epi32(mask);
+    size_t i = 0;
+    for(; i + 64 <= len; i += 64) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(src + i + 32));
+        __m128i d = _mm_loadu_si128((const __m128i*)(src + i + 48));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(a, m));
+        _mm_storeu_si128((__m128i*)(dst + i + 16), _mm_xor_si128(b, m));
+        _mm_storeu_si128((__m128i*)(dst + i + 32), _mm_xor_si128(c, m));
+        _mm_storeu_si128((__m128i*)(dst + i + 48), _mm_xor_si128(d, m));
+    }
+    for(; i + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_xor_si128(a, m));
+    }
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t MaskAVX2(uint8_t* dst, const uint8_t* src, size_t len, uint32_t mask) {
+    __m256i m = _mm256_set1_epi32(mask);
+    size_t i = 0;
+    for(; i + 128 <= len; i += 128) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(src + i + 64));
+        __m256i d = _mm256_loadu_si256((const __m256i*)(src + i + 96));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(a, m));
+        _mm256_storeu_si256((__m256i*)(dst + i + 32), _mm256_xor_si256(b, m));
+        _mm256_storeu_si256((__m256i*)(dst + i + 64), _mm256_xor_si256(c, m));
+        _mm256_storeu_si256((__m256i*)(dst + i + 96), _mm256_xor_si256(d, m));
+    }
+    for(; i + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_xor_si256(a, m));
+    }
+    return i;
+}
+#endif
+
+void WSMaskPayload(void* dst, const void* src, size_t len, const char* mask, size_t offset) {
+    //按offset旋转掩码, 使其第0个字节对应dst[0]
+    uint8_t rotated[4];
+    for(int i = 0; i < 4; ++i) {
+        rotated[i] = mask[(offset + i) & 3];
+    }
+    uint32_t m;
+    memcpy(&m, rotated, sizeof(m));
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    size_t done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    if(len >= 16) {
+        codec::Level level = codec::GetLevel();
+        if(level >= codec::AVX2) {
+            done = MaskAVX2(d, s, len, m);
+        } else if(level >= codec::SSE42) {
+            done = MaskSSE2(d, s, len, m);
+        }
+    }
+#endif
+    MaskScalar(d + done, s + done, len - done, m);
+}
+
 int32_t WSSession::pong() {
+    if(m_sendQueueStarted) {
+        return sendMessage(std::make_shared<WSFrameMessage>(WSFrameHead::PONG));
+    }
     return WSPong(this);
 }
 
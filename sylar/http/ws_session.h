@@ -3,6 +3,13 @@
 
 #include "sylar/config.h"
 #include "sylar/http/http_session.h"
+#include "sylar/buffer_chain.h"
+#include "sylar/http/ws_deflate.h"
+#include "sylar/iomanager.h"
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <unordered_map>
 #include <stdint.h>
 
 namespace sylar {
@@ -52,27 +59,199 @@ private:
     std::string m_data;
 };
 
-class WSSession : public HttpSession {
+class WSSession : public HttpSession
+                 ,public std::enable_shared_from_this<WSSession> {
 public:
     typedef std::shared_ptr<WSSession> ptr;
+    typedef sylar::Mutex MutexType;
+
+    /**
+     * @brief 发送队列满时的处理策略
+     */
+    enum SendPolicy {
+        /// 丢弃新的帧
+        DROP = 0,
+        /// 断开连接
+        DISCONNECT = 1,
+        /// 替换队列中coalesce_key相同的帧, 没有可替换的帧时丢弃
+        COALESCE = 2
+    };
+
+    /**
+     * @brief sendFrame的结果
+     */
+    enum SendResult {
+        SEND_OK = 0,
+        /// 替换了队列中尚未发送的同key帧
+        SEND_COALESCED = 1,
+        /// 队列满, 丢弃
+        SEND_DROPPED = 2,
+        /// 队列满, 断开连接
+        SEND_DISCONNECTED = 3,
+        /// 连接已关闭
+        SEND_CLOSED = 4
+    };
+
     WSSession(Socket::ptr sock, bool owner = true);
 
     /// server client
     HttpRequest::ptr handleShake();
 
     WSFrameMessage::ptr recvMessage();
+    /**
+     * @brief 发送消息
+     * @details 发送队列启动后编码(含压缩)后入队, 返回入队的字节数.
+     *          直接发送的消息不按策略丢弃, 队列满时在协程中等待发送协程腾出空间
+     */
     int32_t sendMessage(WSFrameMessage::ptr msg, bool fin = true);
     int32_t sendMessage(const std::string& msg, int32_t opcode = WSFrameHead::TEXT_FRAME, bool fin = true);
     int32_t ping();
     int32_t pong();
+
+    virtual void close() override;
+
+    /**
+     * @brief 握手协商的permessage-deflate上下文, 未协商时为nullptr
+     */
+    WSDeflater::ptr getDeflater() const { return m_deflater;}
+
+    /**
+     * @brief 启动发送队列, 由独立协程按入队顺序合并发送
+     * @details 启动后所有发送(包括自动回复的PONG)都经过队列, 不会与其它协程的写交错.
+     *          队列长度和策略默认取websocket.send_queue.max_bytes / max_frames / policy,
+     *          丢弃/合并策略只作用于sendFrame(广播)发送的帧.
+     *          需在连接自己的协程中, 开始收发之前调用
+     * @param[in] iom 发送协程所在的IOManager
+     */
+    bool startSendQueue(IOManager* iom = IOManager::GetThis());
+    bool isSendQueueStarted() const { return m_sendQueueStarted;}
+
+    /**
+     * @brief 发送已编码的帧(WSEncodeFrame), 多个连接可以共享同一份数据
+     * @param[in] frame 编码后的帧, 只增加引用不复制
+     * @param[in] coalesce_key COALESCE策略下相同key的未发送帧会被替换, 0表示不合并
+     * @return SendResult
+     * @details 未启动发送队列时直接同步写入
+     */
+    SendResult sendFrame(const BufferChain& frame, uint64_t coalesce_key = 0);
+
+    void setSendQueueLimit(uint64_t max_bytes, uint32_t max_frames);
+    void setSendPolicy(SendPolicy v) { m_sendPolicy = v;}
+    SendPolicy getSendPolicy() const { return m_sendPolicy;}
+
+    uint64_t getSendQueueBytes() const { return m_queueBytes;}
+    size_t getSendQueueFrames() const;
+    uint64_t getDroppedFrames() const { return m_dropped;}
+    uint64_t getCoalescedFrames() const { return m_coalesced;}
+
+    /**
+     * @brief 注册到WSSessionManager后分配的id, 未注册为0
+     */
+    uint64_t getId() const { return m_id;}
+    void setId(uint64_t v) { m_id = v;}
+
+    std::string toString() const;
+
+    static SendPolicy SendPolicyFromString(const std::string& v);
+    static const char* SendPolicyToString(SendPolicy v);
 private:
     bool handleServerShake();
     bool handleClientShake();
+    void doWrite();
+    /**
+     * @brief 队列满时等待发送协程取走数据, 不在协程中时直接返回
+     */
+    void waitSendSpace();
+    /**
+     * @brief 等待队列中的帧全部写出(用于关闭连接前发送的CLOSE帧)
+     */
+    void waitSendFlush();
+    void notifySendSpace();
+    SendResult enqueue(const BufferChain& frame, uint64_t key, bool droppable);
+private:
+    struct QueuedFrame {
+        BufferChain data;
+        uint64_t key;
+    };
+    /// 接收缓存, 一次读取可能包含多个帧
+    BufferChain m_recvBuffer;
+    /// permessage-deflate上下文
+    WSDeflater::ptr m_deflater;
+
+    uint64_t m_id = 0;
+    std::atomic<bool> m_sendQueueStarted{false};
+    SendPolicy m_sendPolicy = DROP;
+    uint64_t m_maxQueueBytes = 0;
+    uint32_t m_maxQueueFrames = 0;
+    /// 保证压缩顺序与入队顺序一致
+    MutexType m_encodeMutex;
+    mutable MutexType m_queueMutex;
+    std::deque<QueuedFrame> m_queue;
+    /// coalesce_key -> 在m_queue中的下标, 发送协程取走队列时清空
+    std::unordered_map<uint64_t, size_t> m_coalesceIndex;
+    uint64_t m_queueBytes = 0;
+    /// 发送协程正在写出取走的帧
+    bool m_writing = false;
+    uint64_t m_dropped = 0;
+    uint64_t m_coalesced = 0;
+    /// 等待队列空间或写出完成的发送方数量
+    uint32_t m_spaceWaiters = 0;
+    FiberSemaphore m_sendSem;
+    FiberSemaphore m_spaceSem;
 };
 
 extern sylar::ConfigVar<uint32_t>::ptr g_websocket_message_max_size;
-WSFrameMessage::ptr WSRecvMessage(Stream* stream, bool client);
-int32_t WSSendMessage(Stream* stream, WSFrameMessage::ptr msg, bool client, bool fin);
+
+/**
+ * @brief 接收一个完整的消息(合并分片帧)
+ * @param[in] stream 数据流
+ * @param[in] client 是否客户端(客户端不要求对端掩码)
+ * @param[in] buffer 接收缓存, 非空时每次按websocket.recv_buffer_size预读,
+ *            多读的数据留在buffer中供下次使用; 为空时按帧逐段读取固定长度
+ * @param[in] deflater permessage-deflate上下文, RSV1置位的消息解压后返回
+ * @param[in] reply 发送自动回复的PONG/CLOSE, 为空时直接写stream
+ * @details PING自动回复携带相同数据的PONG, 收到CLOSE或出错时关闭stream;
+ *          服务端收到未掩码的帧时回复1002(协议错误)的CLOSE后关闭(RFC 6455 5.1)
+ * @return 失败返回nullptr
+ */
+WSFrameMessage::ptr WSRecvMessage(Stream* stream, bool client, BufferChain* buffer = nullptr
+                                  ,WSDeflater* deflater = nullptr
+                                  ,std::function<int32_t(WSFrameMessage::ptr)> reply = nullptr);
+
+/**
+ * @brief 发送一个帧
+ * @param[in] deflater permessage-deflate上下文, 不分片且达到最小长度的数据消息压缩后发送
+ * @details 帧头一次写出, 服务端用writev与数据一起发送; 客户端在副本上做掩码, 不修改msg
+ * @return 成功返回写出的字节数, 失败关闭stream并返回-1
+ */
+int32_t WSSendMessage(Stream* stream, WSFrameMessage::ptr msg, bool client, bool fin
+                      ,WSDeflater* deflater = nullptr);
+
+/**
+ * @brief 编码服务端(不带掩码)的完整帧, 结果可以发送给多个连接
+ * @param[out] out 追加编码结果
+ * @param[in] deflater 非空时按WSSendMessage的规则压缩
+ * @return 压缩失败返回false
+ */
+bool WSEncodeFrame(BufferChain& out, int opcode, const void* data, size_t len
+                   ,bool fin = true, WSDeflater* deflater = nullptr);
+
+/**
+ * @brief 编码帧头(含扩展长度和掩码)
+ * @param[out] buf 至少14字节
+ * @param[in] mask 掩码, 为nullptr时不设置掩码
+ * @param[in] rsv1 压缩标记(permessage-deflate)
+ * @return 帧头长度
+ */
+size_t WSEncodeFrameHead(void* buf, int opcode, bool fin, uint64_t length
+                         ,const char* mask = nullptr, bool rsv1 = false);
+
+/**
+ * @brief 掩码运算 dst[i] = src[i] ^ mask[(offset + i) % 4], dst可以与src相同
+ * @details 按codec::GetLevel()选择AVX2/SSE2实现
+ */
+void WSMaskPayload(void* dst, const void* src, size_t len, const char* mask, size_t offset = 0);
+
 int32_t WSPing(Stream* stream);
 int32_t WSPong(Stream* stream);
 
@@ -0,0 +1,238 @@
+#include "ws_session_manager.h"
+#include "sylar/log.h"
+#include <sstream>
+#include <vector>
+
+namespace sylar {
+namespace http {
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_NAME("system");
+
+static WSBroadcastStatus s_broadcast_status;
+
+WSBroadcastStatus* WSSessionManager::GetStatus() {
+    return &s_broadcast_status;
+}
+
+std::string WSBroadcastStatus::toString() const {
+    std::stringstream ss;
+    ss << "broadcasts=" << m_broadcasts
+       << " bytes=" << m_bytes
+       << " queued=" << m_queued
+       << " coalesced=" << m_coalesced
+       << " dropped=" << m_dropped
+       << " disconnected=" << m_disconnected;
+    return ss.str();
+}
+
+namespace {
+
+/**
+ * @brief 一次广播的结果计数, 结束时汇总到全局统计
+ */
+struct BroadcastCounter {
+    int64_t queued = 0;
+    int64_t coalesced = 0;
+    int64_t dropped = 0;
+    int64_t disconnected = 0;
+    /// 未启动发送队列的连接, 写入可能让出协程, 需在释放锁后发送
+    std::vector<WSSession::ptr> sync;
+
+    void send(WSSession* session, const BufferChain& frame, uint64_t key) {
+        //发送队列只由连接自己的协程启动, 这里不能代为启动
+        if(session->isSendQueueStarted()) {
+            add(session->sendFrame(frame, key));
+        } else {
+            sync.push_back(session->shared_from_this());
+        }
+    }
+
+    void add(WSSession::SendResult rt) {
+        switch(rt) {
+            case WSSession::SEND_OK:
+                ++queued;
+                break;
+            case WSSession::SEND_COALESCED:
+                ++coalesced;
+                break;
+            case WSSession::SEND_DROPPED:
+                ++dropped;
+                break;
+            case WSSession::SEND_DISCONNECTED:
+                ++disconnected;
+                break;
+            default:
+                break;
+        }
+    }
+
+    size_t commit(const BufferChain& frame, uint64_t key) {
+        for(auto& i : sync) {
+            add(i->sendFrame(frame, key));
+        }
+        auto s = WSSessionManager::GetStatus();
+        s->incBroadcasts();
+        s->incBytes(frame.size());
+        s->incQueued(queued);
+        s->incCoalesced(coalesced);
+        s->incDropped(dropped);
+        s->incDisconnected(disconnected);
+        return queued + coalesced;
+    }
+};
+
+}
+
+uint64_t WSSessionManager::add(WSSession::ptr session) {
+    RWMutexType::WriteLock lock(m_mutex);
+    if(session->getId()) {
+        auto it = m_sessions.find(session->getId());
+        if(it != m_sessions.end() && it->second == session) {
+            return session->getId();
+        }
+    }
+    uint64_t id = ++m_nextId;
+    session->setId(id);
+    m_sessions[id] = session;
+    return id;
+}
+
+void WSSessionManager::del(WSSession::ptr session) {
+    uint64_t id = session->getId();
+    RWMutexType::WriteLock lock(m_mutex);
+    auto it = m_sessions.find(id);
+    if(it == m_sessions.end() || it->second != session) {
+        return;
+    }
+    auto tit = m_sessionTopics.find(id);
+    if(tit != m_sessionTopics.end()) {
+        for(auto& topic : tit->second) {
+            auto git = m_topics.find(topic);
+            if(git == m_topics.end()) {
+                continue;
+            }
+            git->second.erase(id);
+            if(git->second.empty()) {
+                m_topics.erase(git);
+            }
+        }
+        m_sessionTopics.erase(tit);
+    }
+    m_sessions.erase(it);
+}
+
+WSSession::ptr WSSessionManager::get(uint64_t id) {
+    RWMutexType::ReadLock lock(m_mutex);
+    auto it = m_sessions.find(id);
+    return it == m_sessions.end() ? nullptr : it->second;
+}
+
+size_t WSSessionManager::size() {
+    RWMutexType::ReadLock lock(m_mutex);
+    return m_sessions.size();
+}
+
+bool WSSessionManager::join(const std::string& topic, WSSession::ptr session) {
+    uint64_t id = session->getId();
+    RWMutexType::WriteLock lock(m_mutex);
+    auto it = m_sessions.find(id);
+    if(it == m_sessions.end() || it->second != session) {
+        SYLAR_LOG_WARN(g_logger) << "join topic=" << topic
+            << " with unregistered session " << session->toString();
+        return false;
+    }
+    m_topics[topic][id] = session.get();
+    m_sessionTopics[id].insert(topic);
+    return true;
+}
+
+bool WSSessionManager::leave(const std::string& topic, WSSession::ptr session) {
+    uint64_t id = session->getId();
+    RWMutexType::WriteLock lock(m_mutex);
+    auto it = m_topics.find(topic);
+    if(it == m_topics.end() || !it->second.erase(id)) {
+        return false;
+    }
+    if(it->second.empty()) {
+        m_topics.erase(it);
+    }
+    auto tit = m_sessionTopics.find(id);
+    if(tit != m_sessionTopics.end()) {
+        tit->second.erase(topic);
+        if(tit->second.empty()) {
+            m_sessionTopics.erase(tit);
+        }
+    }
+    return true;
+}
+
+size_t WSSessionManager::getTopicSize(const std::string& topic) {
+    RWMutexType::ReadLock lock(m_mutex);
+    auto it = m_topics.find(topic);
+    return it == m_topics.end() ? 0 : it->second.size();
+}
+
+void WSSessionManager::listTopics(WSSession::ptr session, std::vector<std::string>& topics) {
+    RWMutexType::ReadLock lock(m_mutex);
+    auto it = m_sessionTopics.find(session->getId());
+    if(it != m_sessionTopics.end()) {
+        topics.insert(topics.end(), it->second.begin(), it->second.end());
+    }
+}
+
+size_t WSSessionManager::broadcast(const std::string& topic, const std::string& data
+                                   ,int opcode, uint64_t coalesce_key) {
+    BufferChain frame;
+    WSEncodeFrame(frame, opcode, data.c_str(), data.size());
+    return broadcastFrame(topic, frame, coalesce_key);
+}
+
+size_t WSSessionManager::broadcastFrame(const std::string& topic, const BufferChain& frame
+                                        ,uint64_t coalesce_key) {
+    BroadcastCounter counter;
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        auto it = m_topics.find(topic);
+        if(it != m_topics.end()) {
+            for(auto& i : it->second) {
+                counter.send(i.second, frame, coalesce_key);
+            }
+        }
+    }
+    return counter.commit(frame, coalesce_key);
+}
+
+size_t WSSessionManager::broadcastAll(const std::string& data, int opcode, uint64_t coalesce_key) {
+    BufferChain frame;
+    WSEncodeFrame(frame, opcode, data.c_str(), data.size());
+    BroadcastCounter counter;
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        for(auto& i : m_sessions) {
+            counter.send(i.second.get(), frame, coalesce_key);
+        }
+    }
+    return counter.commit(frame, coalesce_key);
+}
+
+void WSSessionManager::listAll(std::vector<WSSession::ptr>& sessions) {
+    RWMutexType::ReadLock lock(m_mutex);
+    sessions.reserve(sessions.size() + m_sessions.size());
+    for(auto& i : m_sessions) {
+        sessions.push_back(i.second);
+    }
+}
+
+std::string WSSessionManager::toString() {
+    std::stringstream ss;
+    {
+        RWMutexType::ReadLock lock(m_mutex);
+        ss << "sessions=" << m_sessions.size()
+           << " topics=" << m_topics.size();
+    }
+    ss << " " << s_broadcast_status.toString();
+    return ss.str();
+}
+
+}
+}
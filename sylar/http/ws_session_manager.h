@@ -0,0 +1,153 @@
+/**
+ * @file ws_session_manager.h
+ * @brief WebSocket连接注册表与按主题广播
+ */
+#ifndef __SYLAR_HTTP_WS_SESSION_MANAGER_H__
+#define __SYLAR_HTTP_WS_SESSION_MANAGER_H__
+
+#include "sylar/mutex.h"
+#include "sylar/singleton.h"
+#include "ws_session.h"
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace sylar {
+namespace http {
+
+/**
+ * @brief 广播统计
+ */
+class WSBroadcastStatus {
+public:
+    int64_t incBroadcasts(int64_t v = 1) { return Atomic::addFetch(m_broadcasts, v);}
+    int64_t incBytes(int64_t v) { return Atomic::addFetch(m_bytes, v);}
+    int64_t incQueued(int64_t v) { return Atomic::addFetch(m_queued, v);}
+    int64_t incCoalesced(int64_t v) { return Atomic::addFetch(m_coalesced, v);}
+    int64_t incDropped(int64_t v) { return Atomic::addFetch(m_dropped, v);}
+    int64_t incDisconnected(int64_t v) { return Atomic::addFetch(m_disconnected, v);}
+
+    int64_t getBroadcasts() const { return m_broadcasts;}
+    int64_t getBytes() const { return m_bytes;}
+    int64_t getQueued() const { return m_queued;}
+    int64_t getCoalesced() const { return m_coalesced;}
+    int64_t getDropped() const { return m_dropped;}
+    int64_t getDisconnected() const { return m_disconnected;}
+
+    std::string toString() const;
+private:
+    /// 广播次数
+    int64_t m_broadcasts = 0;
+    /// 编码后的帧字节数(每次广播只计一次)
+    int64_t m_bytes = 0;
+    /// 入队的帧数
+    int64_t m_queued = 0;
+    /// 替换了未发送帧的次数
+    int64_t m_coalesced = 0;
+    /// 队列满丢弃的帧数
+    int64_t m_dropped = 0;
+    /// 队列满断开的连接数
+    int64_t m_disconnected = 0;
+};
+
+/**
+ * @brief WebSocket连接管理
+ * @details 连接注册后分配id, 可以加入任意多个主题. 广播时只编码一次,
+ *          各连接的发送队列共享同一份BufferChain, 慢连接按自身的SendPolicy处理,
+ *          不会阻塞广播方. 广播的帧不压缩: permessage-deflate的上下文是每个连接独立的,
+ *          压缩结果无法共享.
+ *          WSServer在连接自己的协程中启动发送队列后再注册,
+ *          直接发送和广播都经过队列, 不会交错写入; 未启动队列的连接
+ *          在释放锁后由广播方同步写入, 需由使用方保证不与连接自身的写入交错
+ */
+class WSSessionManager {
+public:
+    typedef sylar::RWMutex RWMutexType;
+
+    /**
+     * @brief 注册连接并分配id
+     * @details 不启动发送队列, 需要时先在连接自己的协程中调用WSSession::startSendQueue
+     * @return 连接id
+     */
+    uint64_t add(WSSession::ptr session);
+
+    /**
+     * @brief 注销连接并退出所有主题
+     */
+    void del(WSSession::ptr session);
+
+    WSSession::ptr get(uint64_t id);
+
+    /**
+     * @brief 已注册的连接数
+     */
+    size_t size();
+
+    /**
+     * @brief 加入主题, 连接需已注册
+     */
+    bool join(const std::string& topic, WSSession::ptr session);
+
+    /**
+     * @brief 退出主题
+     */
+    bool leave(const std::string& topic, WSSession::ptr session);
+
+    /**
+     * @brief 主题中的连接数
+     */
+    size_t getTopicSize(const std::string& topic);
+
+    /**
+     * @brief 连接加入的所有主题
+     */
+    void listTopics(WSSession::ptr session, std::vector<std::string>& topics);
+
+    /**
+     * @brief 向主题中的所有连接广播一条消息
+     * @param[in] coalesce_key 非0时COALESCE策略的连接替换队列中相同key的未发送帧
+     * @return 入队(含替换)的连接数
+     */
+    size_t broadcast(const std::string& topic, const std::string& data
+                     ,int opcode = WSFrameHead::TEXT_FRAME, uint64_t coalesce_key = 0);
+
+    /**
+     * @brief 向主题广播已编码的帧(WSEncodeFrame)
+     */
+    size_t broadcastFrame(const std::string& topic, const BufferChain& frame
+                          ,uint64_t coalesce_key = 0);
+
+    /**
+     * @brief 向所有已注册的连接广播
+     */
+    size_t broadcastAll(const std::string& data, int opcode = WSFrameHead::TEXT_FRAME
+                        ,uint64_t coalesce_key = 0);
+
+    /**
+     * @brief 列出所有已注册的连接(追加到sessions)
+     */
+    void listAll(std::vector<WSSession::ptr>& sessions);
+
+    std::string toString();
+
+    /**
+     * @brief 返回全局广播统计
+     */
+    static WSBroadcastStatus* GetStatus();
+private:
+    RWMutexType m_mutex;
+    uint64_t m_nextId = 0;
+    /// id -> 连接
+    std::unordered_map<uint64_t, WSSession::ptr> m_sessions;
+    /// 主题 -> (id -> 连接), 连接由m_sessions持有
+    std::unordered_map<std::string, std::unordered_map<uint64_t, WSSession*> > m_topics;
+    /// id -> 加入的主题
+    std::unordered_map<uint64_t, std::set<std::string> > m_sessionTopics;
+};
+
+typedef sylar::Singleton<WSSessionManager> WSSessionMgr;
+
+}
+}
+
+#endif
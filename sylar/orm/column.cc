@@ -250,7 +250,7 @@ std::string Column::getMemberDefine() const {
 std::string Column::getGetFunDefine() const {
     std::stringstream ss;
     ss << "const " << TypeToString(m_dtype) << "& " << GetAsGetFunName(m_name)
-       << "() { return " << GetAsMemberName(m_name) << "; }" << std::endl;
+       << "() const { return " << GetAsMemberName(m_name) << "; }" << std::endl;
     return ss.str();
 }
 
@@ -125,7 +125,7 @@ void Table::gen_inc(const std::string& path) {
 
     ofs << std::endl;
 
-    std::set<std::string> sincs = {"vector", "json/json.h"};
+    std::set<std::string> sincs = {"vector", "functional", "json/json.h"};
     for(auto& i : sincs) {
         ofs << "#include <" << i << ">" << std::endl;
     }
@@ -422,6 +422,9 @@ void Table::gen_dao_inc(std::ofstream& ofs) {
     ofs << "class " << GetAsClassName(class_name_dao) << " {" << std::endl;
     ofs << "public:" << std::endl;
     ofs << "    typedef std::shared_ptr<" << GetAsClassName(class_name_dao) << "> ptr;" << std::endl;
+    ofs << "    /// 流式查询的回调, 每行复用同一个对象, 返回false停止" << std::endl;
+    ofs << "    typedef std::function<bool(const " << GetAsClassName(class_name)
+        << "& info)> each_cb;" << std::endl;
     ofs << "    static int Update(" << GetAsClassName(class_name)
         << "::ptr info, " << m_updateclass << "::ptr conn);" << std::endl;
     ofs << "    static int Insert(" << GetAsClassName(class_name)
@@ -430,6 +433,14 @@ void Table::gen_dao_inc(std::ofstream& ofs) {
         << "::ptr info, " << m_updateclass << "::ptr conn);" << std::endl;
     ofs << "    static int Delete(" << GetAsClassName(class_name)
         << "::ptr info, " << m_updateclass << "::ptr conn);" << std::endl;
+    ofs << "    /// 多行INSERT, 每条语句最多batch_size行(0为参数个数上限允许的最大值)," << std::endl;
+    ofs << "    /// 不回填自增主键; 需要原子性或批量写入性能时由调用方开启事务" << std::endl;
+    ofs << "    static int BatchInsert(const std::vector<" << GetAsClassName(class_name)
+        << "::ptr>& infos, " << m_updateclass << "::ptr conn, size_t batch_size = 0);" << std::endl;
+    ofs << "    /// 批量InsertOrUpdate, 自增主键为0的行多行INSERT并回填主键(连接不保证id连续时逐行Insert)," << std::endl;
+    ofs << "    /// 其余行多行REPLACE" << std::endl;
+    ofs << "    static int BatchUpsert(const std::vector<" << GetAsClassName(class_name)
+        << "::ptr>& infos, " << m_updateclass << "::ptr conn, size_t batch_size = 0);" << std::endl;
     auto vs = getPKs();
     ofs << "    static int Delete(";
     for(auto& i : vs) {
@@ -498,6 +509,24 @@ void Table::gen_dao_inc(std::ofstream& ofs) {
         }
     }
 
+    ofs << "    static int QueryAllEach(each_cb cb, " << m_queryclass << "::ptr conn);" << std::endl;
+    for(auto& i : m_idxs) {
+        if(i->getDType() == Index::TYPE_INDEX) {
+            ofs << "    static int Query";
+            std::string tmp = "by";
+            for(auto& c : i->getCols()) {
+                tmp += "_" + c;
+            }
+            ofs << GetAsClassName(tmp) << "Each(each_cb cb, ";
+            for(auto& c : i->getCols()) {
+                auto d = getCol(c);
+                ofs << " const " << d->getDTypeString() << "& "
+                    << GetAsVariable(d->getName()) << ", ";
+            }
+            ofs << m_queryclass << "::ptr conn);" << std::endl;
+        }
+    }
+
     ofs << "    static int CreateTableSQLite3(" << m_dbclass << "::ptr info);" << std::endl;
     ofs << "    static int CreateTableMySQL(" << m_dbclass << "::ptr info);" << std::endl;
     ofs << "};" << std::endl;
@@ -927,6 +956,9 @@ void Table::gen_dao_src(std::ofstream& ofs) {
         }
     }
 
+    gen_dao_batch_src(ofs);
+    gen_dao_each_src(ofs);
+
     ofs << "int " << GetAsClassName(class_name_dao) << "::CreateTableSQLite3(" << m_dbclass << "::ptr conn) {" << std::endl;
     ofs << "    return conn->execute(\"CREATE TABLE " << m_name << "(\"" << std::endl;
     is_first = true;
@@ -1048,5 +1080,268 @@ void Table::gen_dao_src(std::ofstream& ofs) {
     ofs << "}";
 }
 
+std::string Table::genColumnNames(bool skip_auto_inc) const {
+    std::stringstream ss;
+    bool is_first = true;
+    for(auto& i : m_cols) {
+        if(skip_auto_inc && i->isAutoIncrement()) {
+            continue;
+        }
+        if(!is_first) {
+            ss << ", ";
+        }
+        ss << i->getName();
+        is_first = false;
+    }
+    return ss.str();
+}
+
+std::string Table::genSelectSQL() const {
+    return "select " + genColumnNames(false) + " from " + m_name;
+}
+
+void Table::gen_dao_batch_src(std::ofstream& ofs) {
+    std::string class_name = m_name + m_subfix;
+    std::string class_name_dao = class_name + "_dao";
+    Column::ptr auto_inc;
+    size_t insert_cols = 0;
+    for(auto& i : m_cols) {
+        if(i->isAutoIncrement()) {
+            auto_inc = i;
+        } else {
+            ++insert_cols;
+        }
+    }
+
+    ofs << "typedef void (*" << GetAsVariable(m_name) << "_binder)(sylar::IStmt::ptr stmt, int offset, const "
+        << GetAsClassName(class_name) << "& info);" << std::endl << std::endl;
+
+#define GEN_BINDER(name, skip_auto_inc) \
+    ofs << "static void " name "(sylar::IStmt::ptr stmt, int offset, const " \
+        << GetAsClassName(class_name) << "& info) {" << std::endl; \
+    idx = 1; \
+    for(auto& i : m_cols) { \
+        if(skip_auto_inc && i->isAutoIncrement()) { \
+            continue; \
+        } \
+        ofs << "    stmt->" << i->getBindString() << "(offset + " << idx << ", " \
+            << "info." << GetAsGetFunName(i->getName()) << "());" << std::endl; \
+        ++idx; \
+    } \
+    ofs << "}" << std::endl << std::endl;
+
+    int idx = 1;
+    GEN_BINDER("BindInsertRow", true);
+    GEN_BINDER("BindReplaceRow", false);
+#undef GEN_BINDER
+
+    //SQLite3默认SQLITE_MAX_VARIABLE_NUMBER为999, MySQL为65535, 按较小的算
+    //id_step非0时按IDB::getBatchInsertIdMode的规律回填自增主键
+    ofs << "static int BatchExecute(const std::string& prefix, size_t cols, const "
+        << GetAsClassName(class_name) << "::ptr* infos, size_t count" << std::endl
+        << "        ," << GetAsVariable(m_name) << "_binder binder, "
+        << m_updateclass << "::ptr conn, size_t batch_size" << std::endl
+        << "        ,int64_t id_step = 0, bool id_first = false) {" << std::endl;
+    ofs << "    size_t max_rows = cols ? 999 / cols : 0;" << std::endl;
+    ofs << "    if(max_rows == 0) {" << std::endl;
+    ofs << "        SYLAR_LOG_ERROR(g_logger) << \"stmt=\" << prefix << \"... invalid cols=\" << cols;" << std::endl;
+    ofs << "        return -1;" << std::endl;
+    ofs << "    }" << std::endl;
+    ofs << "    if(batch_size == 0 || batch_size > max_rows) {" << std::endl;
+    ofs << "        batch_size = max_rows;" << std::endl;
+    ofs << "    }" << std::endl;
+    ofs << "    std::string values = \"(?\";" << std::endl;
+    ofs << "    for(size_t i = 1; i < cols; ++i) {" << std::endl;
+    ofs << "        values += \", ?\";" << std::endl;
+    ofs << "    }" << std::endl;
+    ofs << "    values += \")\";" << std::endl;
+    ofs << "    sylar::IStmt::ptr stmt;" << std::endl;
+    ofs << "    size_t stmt_rows = 0;" << std::endl;
+    ofs << "    for(size_t pos = 0; pos < count;) {" << std::endl;
+    ofs << "        size_t n = count - pos;" << std::endl;
+    ofs << "        if(n > batch_size) {" << std::endl;
+    ofs << "            n = batch_size;" << std::endl;
+    ofs << "        }" << std::endl;
+    ofs << "        //行数相同的批次复用同一条预编译语句" << std::endl;
+    ofs << "        if(n != stmt_rows) {" << std::endl;
+    ofs << "            std::string sql = prefix;" << std::endl;
+    ofs << "            sql.reserve(prefix.size() + n * (values.size() + 2));" << std::endl;
+    ofs << "            for(size_t i = 0; i < n; ++i) {" << std::endl;
+    ofs << "                if(i) {" << std::endl;
+    ofs << "                    sql += \", \";" << std::endl;
+    ofs << "                }" << std::endl;
+    ofs << "                sql += values;" << std::endl;
+    ofs << "            }" << std::endl;
+    ofs << "            stmt = conn->prepare(sql);" << std::endl;
+    ofs << "            if(!stmt) {" << std::endl;
+    ofs << "                SYLAR_LOG_ERROR(g_logger) << \"stmt=\" << prefix << \"... rows=\" << n" << std::endl;
+    ofs << "                         << \" errno=\" << conn->getErrno() << \" errstr=\" << conn->getErrStr();" << std::endl;
+    ofs << "                return conn->getErrno();" << std::endl;
+    ofs << "            }" << std::endl;
+    ofs << "            stmt_rows = n;" << std::endl;
+    ofs << "        }" << std::endl;
+    ofs << "        for(size_t i = 0; i < n; ++i) {" << std::endl;
+    ofs << "            binder(stmt, i * cols, *infos[pos + i]);" << std::endl;
+    ofs << "        }" << std::endl;
+    ofs << "        int rt = stmt->execute();" << std::endl;
+    ofs << "        if(rt) {" << std::endl;
+    ofs << "            return rt;" << std::endl;
+    ofs << "        }" << std::endl;
+    if(auto_inc) {
+        ofs << "        if(id_step) {" << std::endl;
+        ofs << "            int64_t id = stmt->getLastInsertId();" << std::endl;
+        ofs << "            if(!id_first) {" << std::endl;
+        ofs << "                id -= (int64_t)(n - 1) * id_step;" << std::endl;
+        ofs << "            }" << std::endl;
+        ofs << "            for(size_t i = 0; i < n; ++i) {" << std::endl;
+        ofs << "                infos[pos + i]->" << GetAsSetFunName(auto_inc->getName())
+            << "(id + (int64_t)i * id_step);" << std::endl;
+        ofs << "            }" << std::endl;
+        ofs << "        }" << std::endl;
+    }
+    ofs << "        pos += n;" << std::endl;
+    ofs << "    }" << std::endl;
+    ofs << "    return 0;" << std::endl;
+    ofs << "}" << std::endl << std::endl;
+
+    ofs << "int " << GetAsClassName(class_name_dao) << "::BatchInsert(const std::vector<"
+        << GetAsClassName(class_name) << "::ptr>& infos, " << m_updateclass
+        << "::ptr conn, size_t batch_size) {" << std::endl;
+    if(insert_cols == 0) {
+        //只有自增列, 没有可以绑定的参数
+        ofs << "    for(auto& i : infos) {" << std::endl;
+        ofs << "        int rt = Insert(i, conn);" << std::endl;
+        ofs << "        if(rt) {" << std::endl;
+        ofs << "            return rt;" << std::endl;
+        ofs << "        }" << std::endl;
+        ofs << "    }" << std::endl;
+        ofs << "    return 0;" << std::endl;
+    } else {
+        ofs << "    if(infos.empty()) {" << std::endl;
+        ofs << "        return 0;" << std::endl;
+        ofs << "    }" << std::endl;
+        ofs << "    return BatchExecute(\"insert into " << m_name << " (" << genColumnNames(true)
+            << ") values \", " << insert_cols << std::endl
+            << "            ,&infos[0], infos.size(), BindInsertRow, conn, batch_size);" << std::endl;
+    }
+    ofs << "}" << std::endl << std::endl;
+
+    ofs << "int " << GetAsClassName(class_name_dao) << "::BatchUpsert(const std::vector<"
+        << GetAsClassName(class_name) << "::ptr>& infos, " << m_updateclass
+        << "::ptr conn, size_t batch_size) {" << std::endl;
+    if(auto_inc) {
+        ofs << "    std::vector<" << GetAsClassName(class_name) << "::ptr> inserts;" << std::endl;
+        ofs << "    std::vector<" << GetAsClassName(class_name) << "::ptr> replaces;" << std::endl;
+        ofs << "    for(auto& i : infos) {" << std::endl;
+        ofs << "        if(i->" << GetAsMemberName(auto_inc->getName()) << " == 0) {" << std::endl;
+        ofs << "            inserts.push_back(i);" << std::endl;
+        ofs << "        } else {" << std::endl;
+        ofs << "            replaces.push_back(i);" << std::endl;
+        ofs << "        }" << std::endl;
+        ofs << "    }" << std::endl;
+        //同InsertOrUpdate回填自增主键, 否则再次调用会重复插入
+        ofs << "    int rt = 0;" << std::endl;
+        if(insert_cols) {
+            ofs << "    int64_t id_step = 0;" << std::endl;
+            ofs << "    bool id_first = false;" << std::endl;
+            ofs << "    if(!inserts.empty() && conn->getBatchInsertIdMode(id_step, id_first)) {" << std::endl;
+            ofs << "        rt = BatchExecute(\"insert into " << m_name << " (" << genColumnNames(true)
+                << ") values \", " << insert_cols << std::endl
+                << "                ,&inserts[0], inserts.size(), BindInsertRow, conn, batch_size"
+                << ", id_step, id_first);" << std::endl;
+            ofs << "    } else {" << std::endl;
+        } else {
+            ofs << "    {" << std::endl;
+        }
+        ofs << "        //id不保证连续时逐行插入" << std::endl;
+        ofs << "        for(auto& i : inserts) {" << std::endl;
+        ofs << "            rt = Insert(i, conn);" << std::endl;
+        ofs << "            if(rt) {" << std::endl;
+        ofs << "                break;" << std::endl;
+        ofs << "            }" << std::endl;
+        ofs << "        }" << std::endl;
+        ofs << "    }" << std::endl;
+        ofs << "    if(rt || replaces.empty()) {" << std::endl;
+        ofs << "        return rt;" << std::endl;
+        ofs << "    }" << std::endl;
+    } else {
+        ofs << "    auto& replaces = infos;" << std::endl;
+        ofs << "    if(replaces.empty()) {" << std::endl;
+        ofs << "        return 0;" << std::endl;
+        ofs << "    }" << std::endl;
+    }
+    ofs << "    return BatchExecute(\"replace into " << m_name << " (" << genColumnNames(false)
+        << ") values \", " << m_cols.size() << std::endl
+        << "            ,&replaces[0], replaces.size(), BindReplaceRow, conn, batch_size);" << std::endl;
+    ofs << "}" << std::endl << std::endl;
+}
+
+void Table::gen_dao_each_src(std::ofstream& ofs) {
+    std::string class_name = m_name + m_subfix;
+    std::string class_name_dao = class_name + "_dao";
+
+#define EACH_ROWS() \
+    ofs << "    auto rt = stmt->query();" << std::endl; \
+    ofs << "    if(!rt) {" << std::endl; \
+    ofs << "        return stmt->getErrno();" << std::endl; \
+    ofs << "    }" << std::endl; \
+    ofs << "    " << GetAsClassName(class_name) << " v;" << std::endl; \
+    ofs << "    while(rt->next()) {" << std::endl; \
+    for(size_t i = 0; i < m_cols.size(); ++i) { \
+        ofs << "        v." << GetAsMemberName(m_cols[i]->getName()) << " = "; \
+        ofs << "rt->" << m_cols[i]->getGetString() << "(" << (i) << ");" << std::endl; \
+    } \
+    ofs << "        if(!cb(v)) {" << std::endl; \
+    ofs << "            break;" << std::endl; \
+    ofs << "        }" << std::endl; \
+    ofs << "    }" << std::endl; \
+    ofs << "    return 0;" << std::endl; \
+    ofs << "}" << std::endl << std::endl;
+
+    ofs << "int " << GetAsClassName(class_name_dao) << "::QueryAllEach(each_cb cb, "
+        << m_queryclass << "::ptr conn) {" << std::endl;
+    ofs << "    std::string sql = \"" << genSelectSQL() << "\";" << std::endl;
+    CHECK_STMT("conn->getErrno()");
+    EACH_ROWS();
+
+    for(auto& i : m_idxs) {
+        if(i->getDType() != Index::TYPE_INDEX) {
+            continue;
+        }
+        ofs << "int " << GetAsClassName(class_name_dao) << "::Query";
+        std::string tmp = "by";
+        for(auto& c : i->getCols()) {
+            tmp += "_" + c;
+        }
+        ofs << GetAsClassName(tmp) << "Each(each_cb cb, ";
+        for(auto& c : i->getCols()) {
+            auto d = getCol(c);
+            ofs << " const " << d->getDTypeString() << "& "
+                << GetAsVariable(d->getName()) << ", ";
+        }
+        ofs << m_queryclass << "::ptr conn) {" << std::endl;
+        ofs << "    std::string sql = \"" << genSelectSQL() << " where";
+        bool is_first = true;
+        for(auto& x : i->getCols()) {
+            if(!is_first) {
+                ofs << " and";
+            }
+            ofs << " " << x << " = ?";
+            is_first = false;
+        }
+        ofs << "\";" << std::endl;
+        CHECK_STMT("conn->getErrno()");
+
+        int idx = 1;
+        for(auto& x : i->getCols()) {
+            ofs << "    stmt->" << getCol(x)->getBindString() << "(" << idx << ", ";
+            ofs << GetAsVariable(x) << ");" << std::endl;
+            ++idx;
+        }
+        EACH_ROWS();
+    }
+#undef EACH_ROWS
+}
+
 }
 }
@@ -38,6 +38,11 @@ private:
 
     void gen_dao_inc(std::ofstream& ofs);
     void gen_dao_src(std::ofstream& ofs);
+    void gen_dao_batch_src(std::ofstream& ofs);
+    void gen_dao_each_src(std::ofstream& ofs);
+
+    std::string genColumnNames(bool skip_auto_inc) const;
+    std::string genSelectSQL() const;
 
     enum DBType {
         TYPE_SQLITE3 = 1,
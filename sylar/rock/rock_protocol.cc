@@ -248,6 +248,8 @@ int32_t RockMessageDecoder::serializeTo(Stream::ptr stream, Message::ptr msg) {
     auto ba = msg->toByteArray();
     ba->setPosition(0);
     header.length = ba->getSize();
+    //压缩结果直接接管zlib的输出缓存, 不再复制到ByteArray
+    BufferChain body;
     if((uint32_t)header.length >= g_rock_protocol_gzip_min_length->getValue()) {
         auto zstream = sylar::ZlibStream::CreateGzip(true);
         if(zstream->write(ba, -1) != Z_OK) {
@@ -259,20 +261,26 @@ int32_t RockMessageDecoder::serializeTo(Stream::ptr stream, Message::ptr msg) {
             return -2;
         }
 
-        ba = zstream->getByteArray();
+        body = zstream->getBufferChain();
         header.flag |= 0x1;
-        header.length = ba->getSize();
+        header.length = body.size();
     }
+    int32_t length = header.length;
     header.length = sylar::byteswapOnLittleEndian(header.length);
     if(stream->writeFixSize(&header, sizeof(header)) <= 0) {
         SYLAR_LOG_ERROR(g_logger) << "RockMessageDecoder serializeTo write header fail";
         return -3;
     }
-    if(stream->writeFixSize(ba, ba->getReadSize()) <= 0) {
+    if(header.flag & 0x1) {
+        if(stream->writeFixSize(body, body.size()) <= 0) {
+            SYLAR_LOG_ERROR(g_logger) << "RockMessageDecoder serializeTo write body fail";
+            return -4;
+        }
+    } else if(stream->writeFixSize(ba, ba->getReadSize()) <= 0) {
         SYLAR_LOG_ERROR(g_logger) << "RockMessageDecoder serializeTo write body fail";
         return -4;
     }
-    return sizeof(header) + ba->getSize();
+    return sizeof(header) + length;
 }
 
 }
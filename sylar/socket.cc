@@ -5,6 +5,8 @@
 #include "macro.h"
 #include "hook.h"
 #include <limits.h>
+#include <sys/sendfile.h>
+#include <algorithm>
 
 namespace sylar {
 
@@ -267,6 +269,13 @@ int Socket::send(const iovec* buffers, size_t length, int flags) {
     return -1;
 }
 
+int Socket::sendFile(int fd, off_t* offset, size_t length) {
+    if(isConnected()) {
+        return ::sendfile(m_sock, fd, offset, length);
+    }
+    return -1;
+}
+
 int Socket::sendTo(const void* buffer, size_t length, const Address::ptr to, int flags) {
     if(isConnected()) {
         return ::sendto(m_sock, buffer, length, flags, to->getAddr(), to->getAddrLen());
@@ -545,6 +554,23 @@ int SSLSocket::send(const iovec* buffers, size_t length, int flags) {
     return total;
 }
 
+int SSLSocket::sendFile(int fd, off_t* offset, size_t length) {
+    if(!m_ssl) {
+        return -1;
+    }
+    //SSL无法使用sendfile, 读出后加密发送
+    char buf[16 * 1024];
+    ssize_t n = pread(fd, buf, std::min(length, sizeof(buf)), *offset);
+    if(n <= 0) {
+        return n;
+    }
+    int rt = SSL_write(m_ssl.get(), buf, n);
+    if(rt > 0) {
+        *offset += rt;
+    }
+    return rt;
+}
+
 int SSLSocket::sendTo(const void* buffer, size_t length, const Address::ptr to, int flags) {
     SYLAR_ASSERT(false);
     return -1;
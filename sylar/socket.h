@@ -238,6 +238,18 @@ public:
      */
     virtual int sendTo(const iovec* buffers, size_t length, const Address::ptr to, int flags = 0);
 
+    /**
+     * @brief 发送文件内容(sendfile)
+     * @param[in] fd 文件句柄
+     * @param[in, out] offset 文件偏移, 成功后前移已发送的长度
+     * @param[in] length 待发送的长度
+     * @return
+     *      @retval >0 发送成功对应大小的数据
+     *      @retval =0 socket被关闭
+     *      @retval <0 socket出错
+     */
+    virtual int sendFile(int fd, off_t* offset, size_t length);
+
     /**
      * @brief 接受数据
      * @param[out] buffer 接收数据的内存
@@ -409,6 +421,7 @@ public:
     virtual int send(const iovec* buffers, size_t length, int flags = 0) override;
     virtual int sendTo(const void* buffer, size_t length, const Address::ptr to, int flags = 0) override;
     virtual int sendTo(const iovec* buffers, size_t length, const Address::ptr to, int flags = 0) override;
+    virtual int sendFile(int fd, off_t* offset, size_t length) override;
     virtual int recv(void* buffer, size_t length, int flags = 0) override;
     virtual int recv(iovec* buffers, size_t length, int flags = 0) override;
     virtual int recvFrom(void* buffer, size_t length, Address::ptr from, int flags = 0) override;
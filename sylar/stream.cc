@@ -1,4 +1,5 @@
 #include "stream.h"
+#include <algorithm>
 
 namespace sylar {
 
@@ -55,4 +56,51 @@ int Stream::writeFixSize(ByteArray::ptr ba, size_t length) {
     return length;
 }
 
+int Stream::read(BufferChain& chain, size_t length) {
+    if(length == 0) {
+        return 0;
+    }
+    std::vector<iovec> iovs;
+    chain.getWriteBuffers(iovs, std::min(length, BufferPool::GetBlockSize()));
+    int rt = read(iovs[0].iov_base, iovs[0].iov_len);
+    chain.commitWrite(rt > 0 ? rt : 0);
+    return rt;
+}
+
+int Stream::readFixSize(BufferChain& chain, size_t length) {
+    int64_t left = length;
+    while(left > 0) {
+        int64_t len = read(chain, left);
+        if(len <= 0) {
+            return len;
+        }
+        left -= len;
+    }
+    return length;
+}
+
+int Stream::write(BufferChain& chain, size_t length) {
+    std::vector<iovec> iovs;
+    if(chain.getReadBuffers(iovs, length) == 0) {
+        return 0;
+    }
+    int rt = write(iovs[0].iov_base, iovs[0].iov_len);
+    if(rt > 0) {
+        chain.consume(rt);
+    }
+    return rt;
+}
+
+int Stream::writeFixSize(BufferChain& chain, size_t length) {
+    int64_t left = length;
+    while(left > 0) {
+        int64_t len = write(chain, left);
+        if(len <= 0) {
+            return len;
+        }
+        left -= len;
+    }
+    return length;
+}
+
 }
@@ -11,6 +11,7 @@
 
 #include <memory>
 #include "bytearray.h"
+#include "buffer_chain.h"
 
 namespace sylar {
 
@@ -113,6 +114,38 @@ public:
      */
     virtual int writeFixSize(ByteArray::ptr ba, size_t length);
 
+    /**
+     * @brief 读数据追加到BufferChain尾部
+     * @details 默认实现读入一块缓存, 支持分散读的流应直接读入多块
+     * @param[out] chain 接收数据的BufferChain
+     * @param[in] length 接收数据的最大长度
+     * @return
+     *      @retval >0 返回接收到的数据的实际大小
+     *      @retval =0 被关闭
+     *      @retval <0 出现流错误
+     */
+    virtual int read(BufferChain& chain, size_t length);
+
+    /**
+     * @brief 读固定长度的数据追加到BufferChain尾部
+     */
+    virtual int readFixSize(BufferChain& chain, size_t length);
+
+    /**
+     * @brief 写出BufferChain头部的数据, 写出的部分从chain中移除
+     * @details 默认实现逐块写出, 支持聚集写的流应一次写出多块
+     * @return
+     *      @retval >0 返回写入到的数据的实际大小
+     *      @retval =0 被关闭
+     *      @retval <0 出现流错误
+     */
+    virtual int write(BufferChain& chain, size_t length);
+
+    /**
+     * @brief 写出BufferChain头部固定长度的数据
+     */
+    virtual int writeFixSize(BufferChain& chain, size_t length);
+
     /**
      * @brief 关闭流
      */
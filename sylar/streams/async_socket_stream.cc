@@ -131,6 +131,9 @@ void AsyncSocketStream::doWrite() {
                     break;
                 }
             }
+            if(isConnected() && !doFlush()) {
+                innerClose();
+            }
         }
     } catch (...) {
         //TODO log
@@ -83,6 +83,11 @@ public:
 protected:
     virtual void doRead();
     virtual void doWrite();
+    /**
+     * @brief 一批SendCtx::doSend之后调用, 子类可以在doSend中只缓存数据, 在这里合并写出
+     * @return 写失败返回false, 连接会被关闭
+     */
+    virtual bool doFlush() { return true;}
     virtual void startRead();
     virtual void startWrite();
     virtual void onTimeOut(Ctx::ptr ctx);
@@ -408,43 +408,37 @@ LoadBalanceItem::ptr SDLoadBalance::createLoadBalanceItem(ILoadBalance::Type typ
     return item;
 }
 
-void SDLoadBalance::onServiceChange(const std::string& domain, const std::string& service
-                            ,const std::unordered_map<uint64_t, ServiceItemInfo::ptr>& old_value
-                            ,const std::unordered_map<uint64_t, ServiceItemInfo::ptr>& new_value) {
-    SYLAR_LOG_INFO(g_logger) << "onServiceChange domain=" << domain
-                             << " service=" << service;
-    auto type = getType(domain, service);
-    auto lb = get(domain, service, true);
-    std::unordered_map<uint64_t, ServiceItemInfo::ptr> add_values;
+void SDLoadBalance::onServiceDelta(const ServiceDelta& delta) {
+    SYLAR_LOG_INFO(g_logger) << "onServiceDelta " << delta.toString();
+    auto type = getType(delta.domain, delta.service);
+    auto lb = get(delta.domain, delta.service, true);
     std::unordered_map<uint64_t, LoadBalanceItem::ptr> del_infos;
-
-    for(auto& i : old_value) {
-        if(new_value.find(i.first) == new_value.end()) {
-            del_infos[i.first];
-        }
-    }
-    for(auto& i : new_value) {
-        if(old_value.find(i.first) == old_value.end()) {
-            add_values.insert(i);
-        }
+    for(auto& i : delta.dels) {
+        del_infos[i];
     }
 
     std::unordered_map<uint64_t, LoadBalanceItem::ptr> add_infos;
-    for(auto& i : add_values) {
-        auto stream = m_cb(i.second);
+    for(auto& i : delta.adds) {
+        auto stream = m_cb(i);
         if(!stream) {
-            SYLAR_LOG_ERROR(g_logger) << "create stream fail, " << i.second->toString();
+            //数据变化的实例创建失败时保留原来的连接
+            SYLAR_LOG_ERROR(g_logger) << "create stream fail, " << i->toString();
             continue;
         }
-        
+        //已存在的实例(数据变化)用新数据重建, update会取出原来的连接, 替换后关闭
+        del_infos[i->getId()];
+
         LoadBalanceItem::ptr lditem = createLoadBalanceItem(type);
-        lditem->setId(i.first);
+        lditem->setId(i->getId());
         lditem->setStream(stream);
         lditem->setWeight(10000);
 
-        add_infos[i.first] = lditem;
+        add_infos[i->getId()] = lditem;
     }
 
+    if(add_infos.empty() && del_infos.empty()) {
+        return;
+    }
     lb->update(add_infos, del_infos);
     for(auto& i : del_infos) {
         if(i.second) {
@@ -454,11 +448,8 @@ void SDLoadBalance::onServiceChange(const std::string& domain, const std::string
 }
 
 void SDLoadBalance::start() {
-    m_sd->setServiceCallback(std::bind(&SDLoadBalance::onServiceChange, this
-                ,std::placeholders::_1
-                ,std::placeholders::_2
-                ,std::placeholders::_3
-                ,std::placeholders::_4));
+    m_sd->setDeltaCallback(std::bind(&SDLoadBalance::onServiceDelta, this
+                ,std::placeholders::_1));
     m_sd->start();
 }
 
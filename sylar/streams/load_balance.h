@@ -205,9 +205,7 @@ public:
 
     std::string statusString();
 private:
-    void onServiceChange(const std::string& domain, const std::string& service
-                ,const std::unordered_map<uint64_t, ServiceItemInfo::ptr>& old_value
-                ,const std::unordered_map<uint64_t, ServiceItemInfo::ptr>& new_value);
+    void onServiceDelta(const ServiceDelta& delta);
 
     ILoadBalance::Type getType(const std::string& domain, const std::string& service);
     LoadBalance::ptr createLoadBalance(ILoadBalance::Type type);
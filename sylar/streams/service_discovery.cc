@@ -38,6 +38,147 @@ std::string ServiceItemInfo::toString() const {
     return ss.str();
 }
 
+std::string ServiceDelta::toString() const {
+    std::stringstream ss;
+    ss << "[ServiceDelta domain=" << domain
+       << " service=" << service
+       << " version=" << version
+       << " adds=[";
+    for(size_t i = 0; i < adds.size(); ++i) {
+        ss << (i ? "," : "") << adds[i]->getIp() << ":" << adds[i]->getPort();
+    }
+    ss << "] dels=" << dels.size() << "]";
+    return ss.str();
+}
+
+ServiceSnapshot::ItemMapPtr ServiceSnapshot::get(const std::string& domain
+                                                 ,const std::string& service) const {
+    auto it = m_datas.find(domain);
+    if(it == m_datas.end()) {
+        return nullptr;
+    }
+    auto iit = it->second.find(service);
+    return iit == it->second.end() ? nullptr : iit->second;
+}
+
+IServiceDiscovery::IServiceDiscovery()
+    :m_snapshot(std::make_shared<ServiceSnapshot>()) {
+}
+
+ServiceSnapshot::ptr IServiceDiscovery::getSnapshot() const {
+    return std::atomic_load(&m_snapshot);
+}
+
+ServiceSnapshot::ItemMapPtr IServiceDiscovery::getServer(const std::string& domain
+                                                         ,const std::string& service) const {
+    return getSnapshot()->get(domain, service);
+}
+
+ServiceDelta IServiceDiscovery::diff(const std::string& domain, const std::string& service
+                                     ,const ServiceSnapshot::ItemMap& items) const {
+    ServiceDelta delta;
+    delta.domain = domain;
+    delta.service = service;
+    auto old_items = getServer(domain, service);
+    for(auto& i : items) {
+        if(old_items) {
+            auto it = old_items->find(i.first);
+            if(it != old_items->end() && it->second->getData() == i.second->getData()) {
+                continue;
+            }
+        }
+        delta.adds.push_back(i.second);
+    }
+    if(old_items) {
+        for(auto& i : *old_items) {
+            if(items.find(i.first) == items.end()) {
+                delta.dels.push_back(i.first);
+            }
+        }
+    }
+    return delta;
+}
+
+bool IServiceDiscovery::updateServer(const std::string& domain, const std::string& service
+                                     ,const ServiceSnapshot::ItemMap& items, ServiceDelta* delta) {
+    sylar::Mutex::Lock lock(m_updateMutex);
+    ServiceDelta tmp = diff(domain, service, items);
+    bool rt = publishNolock(tmp);
+    lock.unlock();
+    if(rt) {
+        dispatch();
+    }
+    if(delta) {
+        std::swap(*delta, tmp);
+    }
+    return rt;
+}
+
+bool IServiceDiscovery::applyDelta(ServiceDelta& delta) {
+    sylar::Mutex::Lock lock(m_updateMutex);
+    bool rt = publishNolock(delta);
+    lock.unlock();
+    if(rt) {
+        dispatch();
+    }
+    return rt;
+}
+
+void IServiceDiscovery::dispatch() {
+    sylar::Mutex::Lock lock(m_updateMutex);
+    if(m_dispatching) {
+        return;
+    }
+    m_dispatching = true;
+    while(!m_pending.empty()) {
+        PendingNotify n = std::move(m_pending.front());
+        m_pending.pop_front();
+        lock.unlock();
+        //回调可能建立连接(让出协程), 不能持有更新锁
+        if(m_deltaCb) {
+            m_deltaCb(n.delta);
+        }
+        if(m_cb) {
+            static const ServiceSnapshot::ItemMap s_empty;
+            m_cb(n.delta.domain, n.delta.service
+                 ,n.old_items ? *n.old_items : s_empty, *n.new_items);
+        }
+        lock.lock();
+    }
+    m_dispatching = false;
+}
+
+bool IServiceDiscovery::publishNolock(ServiceDelta& delta) {
+    ServiceSnapshot::ptr old_snap = getSnapshot();
+    ServiceSnapshot::ItemMapPtr old_items = old_snap->get(delta.domain, delta.service);
+    if(delta.empty() && old_items) {
+        return false;
+    }
+
+    std::shared_ptr<ServiceSnapshot::ItemMap> new_items = old_items
+        ? std::make_shared<ServiceSnapshot::ItemMap>(*old_items)
+        : std::make_shared<ServiceSnapshot::ItemMap>();
+    for(auto& i : delta.dels) {
+        new_items->erase(i);
+    }
+    for(auto& i : delta.adds) {
+        (*new_items)[i->getId()] = i;
+    }
+
+    //只复制服务实例表的指针, 未变化的服务共享原来的实例表
+    std::shared_ptr<ServiceSnapshot> new_snap = std::make_shared<ServiceSnapshot>(*old_snap);
+    new_snap->m_datas[delta.domain][delta.service] = new_items;
+    new_snap->m_version = old_snap->m_version + 1;
+    delta.version = new_snap->m_version;
+    std::atomic_store(&m_snapshot, ServiceSnapshot::ptr(new_snap));
+
+    //入队顺序即版本顺序, 由dispatch在锁外回调
+    if(m_deltaCb || m_cb) {
+        m_pending.push_back(PendingNotify{delta, old_items, new_items});
+    }
+    return true;
+}
+
 void IServiceDiscovery::setQueryServer(const std::unordered_map<std::string, std::unordered_set<std::string> >& v) {
     sylar::RWMutex::WriteLock lock(m_mutex);
     m_queryInfos = v;
@@ -56,8 +197,13 @@ void IServiceDiscovery::queryServer(const std::string& domain, const std::string
 
 void IServiceDiscovery::listServer(std::unordered_map<std::string, std::unordered_map<std::string
                                    ,std::unordered_map<uint64_t, ServiceItemInfo::ptr> > >& infos) {
-    sylar::RWMutex::ReadLock lock(m_mutex);
-    infos = m_datas;
+    ServiceSnapshot::ptr snap = getSnapshot();
+    infos.clear();
+    for(auto& i : snap->getDatas()) {
+        for(auto& n : i.second) {
+            infos[i.first][n.first] = *n.second;
+        }
+    }
 }
 
 void IServiceDiscovery::listRegisterServer(std::unordered_map<std::string, std::unordered_map<std::string
@@ -72,16 +218,20 @@ void IServiceDiscovery::listQueryServer(std::unordered_map<std::string
     infos = m_queryInfos;
 }
 
-ZKServiceDiscovery::ZKServiceDiscovery(const std::string& hosts)
-    :m_hosts(hosts) {
+ZKServiceDiscovery::ZKServiceDiscovery(const std::string& hosts, ZKClient::ptr client)
+    :m_hosts(hosts)
+    ,m_client(client) {
 }
 
 void ZKServiceDiscovery::start() {
-    if(m_client) {
+    if(m_started) {
         return;
     }
+    m_started = true;
     auto self = shared_from_this();
-    m_client.reset(new sylar::ZKClient);
+    if(!m_client) {
+        m_client.reset(new sylar::ZKClient);
+    }
     bool b = m_client->init(m_hosts, 6000, std::bind(&ZKServiceDiscovery::onWatch,
                 self, std::placeholders::_1, std::placeholders::_2,
                 std::placeholders::_3, std::placeholders::_4));
@@ -96,9 +246,12 @@ void ZKServiceDiscovery::start() {
 }
 
 void ZKServiceDiscovery::stop() {
+    if(!m_started) {
+        return;
+    }
+    m_started = false;
     if(m_client) {
         m_client->close();
-        m_client = nullptr;
     }
     if(m_timer) {
         m_timer->cancel();
@@ -290,23 +443,20 @@ bool ZKServiceDiscovery::getChildren(const std::string& path) {
             << zerror(v) << " (" << v << ")";
         return false;
     }
-    std::unordered_map<uint64_t, ServiceItemInfo::ptr> infos;
+    ServiceSnapshot::ItemMap infos;
     for(auto& i : vals) {
         auto info = ServiceItemInfo::Create(i, "");
         if(!info) {
             continue;
         }
         infos[info->getId()] = info;
-        SYLAR_LOG_INFO(g_logger) << "domain=" << domain
-            << " service=" << service << " info=" << info->toString();
     }
 
-    auto new_vals = infos;
-    sylar::RWMutex::WriteLock lock(m_mutex);
-    m_datas[domain][service].swap(infos);
-    lock.unlock();
-
-    m_cb(domain, service, infos, new_vals);
+    //只把变化的实例交给回调, 实例没有变化时(如定时刷新)不发布新快照
+    ServiceDelta delta;
+    if(updateServer(domain, service, infos, &delta)) {
+        SYLAR_LOG_INFO(g_logger) << "service change " << delta.toString();
+    }
     return true;
 }
 
@@ -1,10 +1,12 @@
 #ifndef __SYLAR_STREAMS_SERVICE_DISCOVERY_H__
 #define __SYLAR_STREAMS_SERVICE_DISCOVERY_H__
 
+#include <deque>
 #include <memory>
 #include <unordered_map>
 #include <unordered_set>
 #include <string>
+#include <vector>
 #include "sylar/mutex.h"
 #include "sylar/iomanager.h"
 #include "sylar/zk_client.h"
@@ -29,12 +31,58 @@ private:
     std::string m_data;
 };
 
+/**
+ * @brief 单个服务的增量变化
+ */
+struct ServiceDelta {
+    std::string domain;
+    std::string service;
+    /// 新增(或数据变化)的实例
+    std::vector<ServiceItemInfo::ptr> adds;
+    /// 删除的实例id
+    std::vector<uint64_t> dels;
+    /// 应用后的快照版本
+    uint64_t version = 0;
+
+    bool empty() const { return adds.empty() && dels.empty();}
+    std::string toString() const;
+};
+
+/**
+ * @brief 服务发现结果的不可变快照
+ * @details 每次变化只复制发生变化的服务的实例表, 其他服务共享原来的实例表,
+ *          新快照通过std::atomic_store发布, 读取不加锁
+ */
+class ServiceSnapshot {
+friend class IServiceDiscovery;
+public:
+    typedef std::shared_ptr<const ServiceSnapshot> ptr;
+    typedef std::unordered_map<uint64_t, ServiceItemInfo::ptr> ItemMap;
+    typedef std::shared_ptr<const ItemMap> ItemMapPtr;
+    //domain -> [service -> [id -> ServiceItemInfo] ]
+    typedef std::unordered_map<std::string, std::unordered_map<std::string, ItemMapPtr> > DataMap;
+
+    /**
+     * @brief 返回服务的实例表, 不存在返回nullptr
+     */
+    ItemMapPtr get(const std::string& domain, const std::string& service) const;
+
+    const DataMap& getDatas() const { return m_datas;}
+    uint64_t getVersion() const { return m_version;}
+private:
+    uint64_t m_version = 0;
+    DataMap m_datas;
+};
+
 class IServiceDiscovery {
 public:
     typedef std::shared_ptr<IServiceDiscovery> ptr;
     typedef std::function<void(const std::string& domain, const std::string& service
                 ,const std::unordered_map<uint64_t, ServiceItemInfo::ptr>& old_value
                 ,const std::unordered_map<uint64_t, ServiceItemInfo::ptr>& new_value)> service_callback;
+    typedef std::function<void(const ServiceDelta& delta)> delta_callback;
+
+    IServiceDiscovery();
     virtual ~IServiceDiscovery() { }
 
     void registerServer(const std::string& domain, const std::string& service,
@@ -52,12 +100,75 @@ public:
     service_callback getServiceCallback() const { return m_cb;}
     void setServiceCallback(service_callback v) { m_cb = v;}
 
+    /**
+     * @brief 增量回调, 只在服务实例发生变化时调用
+     */
+    delta_callback getDeltaCallback() const { return m_deltaCb;}
+    void setDeltaCallback(delta_callback v) { m_deltaCb = v;}
+
     void setQueryServer(const std::unordered_map<std::string, std::unordered_set<std::string> >& v);
+
+    /**
+     * @brief 返回当前快照(不加锁)
+     */
+    ServiceSnapshot::ptr getSnapshot() const;
+
+    /**
+     * @brief 返回服务当前的实例表(不加锁), 不存在返回nullptr
+     */
+    ServiceSnapshot::ItemMapPtr getServer(const std::string& domain, const std::string& service) const;
+
+    /**
+     * @brief 用服务的最新实例全集更新, 只把差异作为增量发布
+     * @param[out] delta 返回计算出的增量, 可为空
+     * @return 有变化并发布了新快照返回true
+     * @details 回调规则同applyDelta
+     */
+    bool updateServer(const std::string& domain, const std::string& service
+                      ,const ServiceSnapshot::ItemMap& items, ServiceDelta* delta = nullptr);
+
+    /**
+     * @brief 应用增量, 发布新快照并通知回调
+     * @details 回调在释放更新锁后按版本顺序调用, 回调中可以让出协程或再更新服务发现.
+     *          其他协程正在分发回调时, 本次的回调由该协程依次调用, 返回时可能尚未调用
+     * @return 增量为空且服务已存在时不发布, 返回false
+     */
+    bool applyDelta(ServiceDelta& delta);
 protected:
+    /**
+     * @brief 计算服务的最新实例与当前快照的差异
+     */
+    ServiceDelta diff(const std::string& domain, const std::string& service
+                      ,const ServiceSnapshot::ItemMap& items) const;
+
+    /**
+     * @brief 发布增量并把回调加入分发队列, 调用方需持有m_updateMutex
+     */
+    bool publishNolock(ServiceDelta& delta);
+
+    /**
+     * @brief 不持锁按入队顺序调用回调, 同一时间只有一个协程分发
+     */
+    void dispatch();
+protected:
+    /**
+     * @brief 待分发的一次变化
+     */
+    struct PendingNotify {
+        ServiceDelta delta;
+        ServiceSnapshot::ItemMapPtr old_items;
+        ServiceSnapshot::ItemMapPtr new_items;
+    };
+
     sylar::RWMutex m_mutex;
-    //domain -> [service -> [id -> ServiceItemInfo] ]
-    std::unordered_map<std::string, std::unordered_map<std::string
-        ,std::unordered_map<uint64_t, ServiceItemInfo::ptr> > > m_datas;
+    /// 串行化快照更新, 保护m_pending和m_dispatching, 持锁期间不让出协程
+    sylar::Mutex m_updateMutex;
+    /// 按版本顺序待分发的回调
+    std::deque<PendingNotify> m_pending;
+    /// 是否有协程正在分发回调
+    bool m_dispatching = false;
+    /// 当前快照, 用std::atomic_load/atomic_store访问
+    ServiceSnapshot::ptr m_snapshot;
     //domain -> [service -> [ip_and_port -> data] ]
     std::unordered_map<std::string, std::unordered_map<std::string
         ,std::unordered_map<std::string, std::string> > > m_registerInfos;
@@ -65,13 +176,19 @@ protected:
     std::unordered_map<std::string, std::unordered_set<std::string> > m_queryInfos;
 
     service_callback m_cb;
+    delta_callback m_deltaCb;
 };
 
 class ZKServiceDiscovery : public IServiceDiscovery
                           ,public std::enable_shared_from_this<ZKServiceDiscovery> {
 public:
     typedef std::shared_ptr<ZKServiceDiscovery> ptr;
-    ZKServiceDiscovery(const std::string& hosts);
+    /**
+     * @brief 构造函数
+     * @param[in] hosts zookeeper地址
+     * @param[in] client zookeeper客户端, 为空时使用ZKClient(测试时传入FakeZKClient)
+     */
+    ZKServiceDiscovery(const std::string& hosts, ZKClient::ptr client = nullptr);
     const std::string& getSelfInfo() const { return m_selfInfo;}
     void setSelfInfo(const std::string& v) { m_selfInfo = v;}
     const std::string& getSelfData() const { return m_selfData;}
@@ -101,6 +218,7 @@ private:
     ZKClient::ptr m_client;
     sylar::Timer::ptr m_timer;
     bool m_isOnTimer = false;
+    bool m_started = false;
 };
 
 }
@@ -1,5 +1,7 @@
 #include "socket_stream.h"
 #include "sylar/util.h"
+#include <errno.h>
+#include <limits.h>
 
 namespace sylar {
 
@@ -58,6 +60,81 @@ int SocketStream::write(ByteArray::ptr ba, size_t length) {
     return rt;
 }
 
+int SocketStream::read(BufferChain& chain, size_t length) {
+    if(!isConnected()) {
+        return -1;
+    }
+    if(length == 0) {
+        return 0;
+    }
+    std::vector<iovec> iovs;
+    chain.getWriteBuffers(iovs, length);
+    int rt = m_socket->recv(&iovs[0], std::min(iovs.size(), (size_t)IOV_MAX));
+    chain.commitWrite(rt > 0 ? rt : 0);
+    return rt;
+}
+
+int SocketStream::write(BufferChain& chain, size_t length) {
+    if(!isConnected()) {
+        return -1;
+    }
+    std::vector<iovec> iovs;
+    if(chain.getReadBuffers(iovs, length) == 0) {
+        return 0;
+    }
+    int rt = m_socket->send(&iovs[0], std::min(iovs.size(), (size_t)IOV_MAX));
+    if(rt > 0) {
+        chain.consume(rt);
+    }
+    return rt;
+}
+
+int64_t SocketStream::sendFile(int fd, uint64_t offset, uint64_t length) {
+    if(!isConnected()) {
+        return -1;
+    }
+    off_t off = offset;
+    uint64_t left = length;
+    while(left > 0) {
+        int rt = m_socket->sendFile(fd, &off, left);
+        if(rt < 0) {
+            return rt;
+        }
+        if(rt == 0) {
+            //sendfile返回0表示已到文件末尾, 文件比length短
+            errno = ENODATA;
+            return -1;
+        }
+        left -= rt;
+    }
+    return length;
+}
+
+int64_t SocketStream::writevFixSize(iovec* iovs, size_t count) {
+    if(!isConnected()) {
+        return -1;
+    }
+    int64_t total = 0;
+    while(count > 0) {
+        int rt = m_socket->send(iovs, count);
+        if(rt <= 0) {
+            return rt;
+        }
+        total += rt;
+        size_t n = rt;
+        while(count > 0 && n >= iovs->iov_len) {
+            n -= iovs->iov_len;
+            ++iovs;
+            --count;
+        }
+        if(count > 0) {
+            iovs->iov_base = (char*)iovs->iov_base + n;
+            iovs->iov_len -= n;
+        }
+    }
+    return total;
+}
+
 void SocketStream::close() {
     if(m_socket) {
         m_socket->close();
@@ -80,6 +80,51 @@ public:
      */
     virtual int write(ByteArray::ptr ba, size_t length) override;
 
+    /**
+     * @brief 读数据直接写入BufferChain的内存块(recvmsg)
+     * @param[out] chain 接收数据的BufferChain
+     * @param[in] length 接收数据的最大长度
+     * @return
+     *      @retval >0 返回接收到的数据的实际大小
+     *      @retval =0 socket被远端关闭
+     *      @retval <0 socket错误
+     */
+    virtual int read(BufferChain& chain, size_t length) override;
+
+    /**
+     * @brief 以聚集写(sendmsg)写出BufferChain头部的数据, 写出的部分从chain中移除
+     * @param[in] chain 待发送数据的BufferChain
+     * @param[in] length 待发送数据的长度
+     * @return
+     *      @retval >0 返回实际发送的数据大小
+     *      @retval =0 socket被远端关闭
+     *      @retval <0 socket错误
+     */
+    virtual int write(BufferChain& chain, size_t length) override;
+
+    /**
+     * @brief 发送文件的指定区间(sendfile), 直到全部发送完成
+     * @param[in] fd 文件句柄
+     * @param[in] offset 起始偏移
+     * @param[in] length 待发送长度
+     * @return
+     *      @retval >0 全部发送成功, 返回length
+     *      @retval <0 socket错误, 或文件在发送中被截断(errno为ENODATA),
+     *                 此时已发出的Content-Length无法满足, 调用方需要关闭连接
+     */
+    int64_t sendFile(int fd, uint64_t offset, uint64_t length);
+
+    /**
+     * @brief 用writev发送多段内存, 直到全部发送完成
+     * @param[in, out] iovs 内存段数组, 发送过程中会被修改
+     * @param[in] count 内存段数量
+     * @return
+     *      @retval >0 全部发送成功, 返回发送的总长度
+     *      @retval =0 socket被远端关闭
+     *      @retval <0 socket错误
+     */
+    int64_t writevFixSize(iovec* iovs, size_t count);
+
     /**
      * @brief 关闭socket
      */
@@ -73,6 +73,23 @@ int ZlibStream::write(ByteArray::ptr ba, size_t length) {
     }
 }
 
+int ZlibStream::read(BufferChain& chain, size_t length) {
+    throw std::logic_error("ZlibStream::read is invalid");
+}
+
+int ZlibStream::write(BufferChain& chain, size_t length) {
+    std::vector<iovec> buffers;
+    chain.getReadBuffers(buffers, length);
+    if(buffers.empty()) {
+        return Z_OK;
+    }
+    if(m_encode) {
+        return encode(&buffers[0], buffers.size(), false);
+    } else {
+        return decode(&buffers[0], buffers.size(), false);
+    }
+}
+
 void ZlibStream::close() {
     flush();
 }
@@ -213,4 +230,19 @@ sylar::ByteArray::ptr ZlibStream::getByteArray() {
     return ba;
 }
 
+BufferChain ZlibStream::getBufferChain() {
+    BufferChain chain;
+    if(!m_free) {
+        for(auto& i : m_buffs) {
+            chain.append(i.iov_base, i.iov_len);
+        }
+        return chain;
+    }
+    for(auto& i : m_buffs) {
+        chain.appendExternal(i.iov_base, i.iov_len, free);
+    }
+    m_buffs.clear();
+    return chain;
+}
+
 }
@@ -50,6 +50,15 @@ public:
     virtual int read(ByteArray::ptr ba, size_t length) override;
     virtual int write(const void* buffer, size_t length) override;
     virtual int write(ByteArray::ptr ba, size_t length) override;
+    /**
+     * @brief 不支持读取, 抛出std::logic_error
+     */
+    virtual int read(BufferChain& chain, size_t length) override;
+    /**
+     * @brief 压缩/解压chain中前length个字节
+     * @details 与write(ByteArray::ptr)一致, 返回zlib状态码, 不移除chain中的数据
+     */
+    virtual int write(BufferChain& chain, size_t length) override;
     virtual void close() override;
 
     int flush();
@@ -63,6 +72,11 @@ public:
     std::vector<iovec>& getBuffers() { return m_buffs;}
     std::string getResult() const;
     sylar::ByteArray::ptr getByteArray();
+    /**
+     * @brief 零拷贝接管输出缓存, 接管后getBuffers()为空
+     * @details isFree()为false时缓存不归本对象所有, 复制一份
+     */
+    BufferChain getBufferChain();
 private:
     int init(Type type = DEFLATE, int level = DEFAULT_COMPRESSION
              ,int window_bits = 15, int memlevel = 8, Strategy strategy = DEFAULT);
@@ -11,6 +11,7 @@
 
 #include "address.h"
 #include "application.h"
+#include "buffer_chain.h"
 #include "bytearray.h"
 #include "config.h"
 #include "daemon.h"
@@ -61,9 +62,11 @@
 #include "http/servlet.h"
 #include "http/session_data.h"
 #include "http/ws_connection.h"
+#include "http/ws_deflate.h"
 #include "http/ws_server.h"
 #include "http/ws_servlet.h"
 #include "http/ws_session.h"
+#include "http/ws_session_manager.h"
 
 #include "rock/rock_protocol.h"
 #include "rock/rock_server.h"
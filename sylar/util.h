@@ -66,6 +66,12 @@ uint64_t GetCurrentMS();
  */
 uint64_t GetCurrentUS();
 
+/**
+ * @brief 获取当前时间的毫秒(粗粒度, 精度为内核tick, 通常1~4ms)
+ * @details 读取内核维护的时间, 不执行rdtsc, 适合热路径上的过期判断
+ */
+uint64_t GetCurrentCoarseMS();
+
 std::string ToUpper(const std::string& name);
 
 std::string ToLower(const std::string& name);
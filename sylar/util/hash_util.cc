@@ -4,8 +4,15 @@
 #include <cstdlib>
 #include <stdexcept>
 #include <string.h>
+#include <atomic>
 #include <openssl/md5.h>
 #include <openssl/sha.h>
+#include "sylar/endian.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SYLAR_HASH_UTIL_X86 1
+#endif
 
 namespace sylar {
 
@@ -130,114 +137,628 @@ uint64_t murmur3_hash64(const char * str, const uint32_t & seed, const uint32_t&
     return (((uint64_t)murmur3_hash(str, seed)) << 32 | murmur3_hash(str, seed2));
 }
 
-std::string base64decode(const std::string &src) {
-    std::string result;
-    result.resize(src.size() * 3 / 4);
-    char *writeBuf = &result[0];
+namespace {
 
-    const char* ptr = src.c_str();
-    const char* end = ptr + src.size();
+const char s_base64_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const char s_hex_chars[] = "0123456789abcdef";
+
+struct Base64DecodeTable {
+    Base64DecodeTable() {
+        memset(table, -1, sizeof(table));
+        for(int i = 0; i < 64; ++i) {
+            table[(uint8_t)s_base64_chars[i]] = i;
+        }
+    }
+    int8_t table[256];
+};
+
+//函数内静态变量, 其它模块静态初始化时调用也可用
+const int8_t* GetBase64DecodeTable() {
+    static Base64DecodeTable s_table;
+    return s_table.table;
+}
+
+size_t base64encode_scalar(const unsigned char* in, size_t len, char* out) {
+    char* o = out;
+    size_t i = 0;
+    for(; i + 3 <= len; i += 3) {
+        uint32_t v = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        o[0] = s_base64_chars[v >> 18];
+        o[1] = s_base64_chars[(v >> 12) & 0x3f];
+        o[2] = s_base64_chars[(v >> 6) & 0x3f];
+        o[3] = s_base64_chars[v & 0x3f];
+        o += 4;
+    }
+    if(i < len) {
+        uint32_t v = in[i] << 16;
+        if(i + 1 < len) {
+            v |= in[i + 1] << 8;
+        }
+        o[0] = s_base64_chars[v >> 18];
+        o[1] = s_base64_chars[(v >> 12) & 0x3f];
+        o[2] = (i + 1 < len) ? s_base64_chars[(v >> 6) & 0x3f] : '=';
+        o[3] = '=';
+        o += 4;
+    }
+    return o - out;
+}
 
-    while(ptr < end) {
-        int i = 0;
+int64_t base64decode_scalar(const char* src, size_t len, unsigned char* out) {
+    const int8_t* table = GetBase64DecodeTable();
+    unsigned char* o = out;
+    if(len % 4) {
+        return -1;
+    }
+    for(size_t i = 0; i < len; i += 4) {
+        uint32_t packed = 0;
         int padding = 0;
-        int packed = 0;
-        for(; i < 4 && ptr < end; ++i, ++ptr) {
-            if(*ptr == '=') {
+        for(int k = 0; k < 4; ++k) {
+            char c = src[i + k];
+            if(c == '=') {
                 ++padding;
                 packed <<= 6;
                 continue;
             }
-
             // padding with "=" only
-            if (padding > 0) {
-                return "";
+            int8_t v = table[(uint8_t)c];
+            if(padding > 0 || v < 0) {
+                return -1;
             }
-
-            int val = 0;
-            if(*ptr >= 'A' && *ptr <= 'Z') {
-                val = *ptr - 'A';
-            } else if(*ptr >= 'a' && *ptr <= 'z') {
-                val = *ptr - 'a' + 26;
-            } else if(*ptr >= '0' && *ptr <= '9') {
-                val = *ptr - '0' + 52;
-            } else if(*ptr == '+') {
-                val = 62;
-            } else if(*ptr == '/') {
-                val = 63;
-            } else {
-                return ""; // invalid character
-            }
-
-            packed = (packed << 6) | val;
-        }
-        if (i != 4) {
-            return "";
+            packed = (packed << 6) | v;
         }
-        if (padding > 0 && ptr != end) {
-            return "";
+        if(padding > 0 && i + 4 != len) {
+            return -1;
         }
-        if (padding > 2) {
-            return "";
+        if(padding > 2) {
+            return -1;
         }
-
-        *writeBuf++ = (char)((packed >> 16) & 0xff);
+        *o++ = (unsigned char)(packed >> 16);
         if(padding != 2) {
-            *writeBuf++ = (char)((packed >> 8) & 0xff);
+            *o++ = (unsigned char)(packed >> 8);
         }
         if(padding == 0) {
-            *writeBuf++ = (char)(packed & 0xff);
+            *o++ = (unsigned char)packed;
         }
     }
+    return o - out;
+}
+
+void hexencode_scalar(const unsigned char* in, size_t len, char* out) {
+    for(size_t i = 0; i < len; ++i) {
+        out[i * 2] = s_hex_chars[in[i] >> 4];
+        out[i * 2 + 1] = s_hex_chars[in[i] & 0xf];
+    }
+}
 
-    result.resize(writeBuf - result.c_str());
-    return result;
+//hex解码kernel返回已转换的字符数, 遇到非法字符提前停止, 剩余部分由data_from_hexstring逐字符转换并报错
+size_t hexdecode_scalar(const char* in, size_t len, unsigned char* out) {
+    return 0;
 }
 
-std::string base64encode(const std::string& data) {
-    return base64encode(data.c_str(), data.size());
+struct Crc32cTable {
+    Crc32cTable() {
+        for(uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for(int k = 0; k < 8; ++k) {
+                c = (c & 1) ? (c >> 1) ^ 0x82f63b78 : c >> 1;
+            }
+            table[0][i] = c;
+        }
+        for(uint32_t i = 0; i < 256; ++i) {
+            for(int k = 1; k < 8; ++k) {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+            }
+        }
+    }
+    uint32_t table[8][256];
+};
+
+const Crc32cTable& GetCrc32cTable() {
+    static Crc32cTable s_table;
+    return s_table;
 }
 
-std::string base64encode(const void* data, size_t len) {
-    const char* base64 =
-        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+//slicing-by-8
+uint32_t crc32c_scalar(uint32_t crc, const unsigned char* p, size_t len) {
+    const uint32_t (*t)[256] = GetCrc32cTable().table;
+    crc = ~crc;
+    for(; len && ((uintptr_t)p & 7); --len) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+    }
+    for(; len >= 8; len -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        v ^= crc;
+        crc = t[7][v & 0xff] ^ t[6][(v >> 8) & 0xff]
+            ^ t[5][(v >> 16) & 0xff] ^ t[4][(v >> 24) & 0xff]
+            ^ t[3][(v >> 32) & 0xff] ^ t[2][(v >> 40) & 0xff]
+            ^ t[1][(v >> 48) & 0xff] ^ t[0][v >> 56];
+    }
+    for(; len; --len) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+    }
+    return ~crc;
+}
 
-    std::string ret;
-    ret.reserve(len * 4 / 3 + 2);
+#ifdef SYLAR_HASH_UTIL_X86
 
-    const unsigned char* ptr = (const unsigned char*)data;
-    const unsigned char* end = ptr + len;
+//Muła/Lemire的base64向量算法: 每3字节扩展为4个6bit索引, 再按区间查表加偏移得到字符
+#define BASE64_ENC_LUT(set1, setr, add, subs, cmpgt, shuffle, or_, and_, type) \
+    type result = subs(indices, set1(51)); \
+    type less = cmpgt(set1(26), indices); \
+    result = or_(result, and_(less, set1(13))); \
+    result = add(shuffle(shift_lut, result), indices);
 
-    while(ptr < end) {
-        unsigned int packed = 0;
-        int i = 0;
-        int padding = 0;
-        for(; i < 3 && ptr < end; ++i, ++ptr) {
-            packed = (packed << 8) | *ptr;
+__attribute__((target("sse4.2")))
+size_t base64encode_sse42(const unsigned char* in, size_t len, char* out) {
+    const __m128i shuf = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i shift_lut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52
+            ,'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52
+            ,'+' - 62, '/' - 63, 'A', 0, 0);
+    size_t i = 0;
+    char* o = out;
+    //每次读16字节用12字节
+    for(; i + 16 <= len; i += 12, o += 16) {
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + i)), shuf);
+        __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(t0, t1);
+        BASE64_ENC_LUT(_mm_set1_epi8, _mm_setr_epi8, _mm_add_epi8, _mm_subs_epu8, _mm_cmpgt_epi8
+                       ,_mm_shuffle_epi8, _mm_or_si128, _mm_and_si128, __m128i);
+        _mm_storeu_si128((__m128i*)o, result);
+    }
+    return (o - out) + base64encode_scalar(in + i, len - i, o);
+}
+
+__attribute__((target("avx2")))
+size_t base64encode_avx2(const unsigned char* in, size_t len, char* out) {
+    const __m256i shuf = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1
+                                        ,10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m256i shift_lut = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52
+            ,'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52
+            ,'+' - 62, '/' - 63, 'A', 0, 0
+            ,'a' - 26, '0' - 52, '0' - 52, '0' - 52
+            ,'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52
+            ,'+' - 62, '/' - 63, 'A', 0, 0);
+    size_t i = 0;
+    char* o = out;
+    //两个128位通道各处理12字节, 每次读28字节用24字节
+    for(; i + 28 <= len; i += 24, o += 32) {
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(
+                    _mm_loadu_si128((const __m128i*)(in + i)))
+                ,_mm_loadu_si128((const __m128i*)(in + i + 12)), 1);
+        v = _mm256_shuffle_epi8(v, shuf);
+        __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t0, t1);
+        BASE64_ENC_LUT(_mm256_set1_epi8, _mm256_setr_epi8, _mm256_add_epi8, _mm256_subs_epu8, _mm256_cmpgt_epi8
+                       ,_mm256_shuffle_epi8, _mm256_or_si256, _mm256_and_si256, __m256i);
+        _mm256_storeu_si256((__m256i*)o, result);
+    }
+    return (o - out) + base64encode_sse42(in + i, len - i, o);
+}
+
+#undef BASE64_ENC_LUT
+
+//按高/低半字节查表校验字符并计算偏移, 非法字符时lo&hi非0; 最后一组(可能含'=')交给逐字符实现
+#define BASE64_DEC_LUT(set1, srli, add, and_, cmpeq, shuffle, type) \
+    type hi_nibbles = and_(srli(v, 4), set1(0x2f)); \
+    type lo_nibbles = and_(v, set1(0x2f)); \
+    type lo = shuffle(lut_lo, lo_nibbles); \
+    type hi = shuffle(lut_hi, hi_nibbles); \
+    type eq_2f = cmpeq(v, set1(0x2f)); \
+    type roll = shuffle(lut_roll, add(eq_2f, hi_nibbles));
+
+#define XX(...) __VA_ARGS__, __VA_ARGS__
+#define LUT_LO 0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A
+#define LUT_HI 0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+#define LUT_ROLL 0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+#define DEC_SHUF 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+
+__attribute__((target("sse4.2")))
+int64_t base64decode_sse42(const char* src, size_t len, unsigned char* out) {
+    const __m128i lut_lo = _mm_setr_epi8(LUT_LO);
+    const __m128i lut_hi = _mm_setr_epi8(LUT_HI);
+    const __m128i lut_roll = _mm_setr_epi8(LUT_ROLL);
+    const __m128i shuf = _mm_setr_epi8(DEC_SHUF);
+    size_t i = 0;
+    unsigned char* o = out;
+    for(; i + 16 + 4 <= len; i += 16, o += 12) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+        BASE64_DEC_LUT(_mm_set1_epi8, _mm_srli_epi32, _mm_add_epi8, _mm_and_si128, _mm_cmpeq_epi8
+                       ,_mm_shuffle_epi8, __m128i);
+        if(!_mm_testz_si128(lo, hi)) {
+            break;
         }
-        if(i == 2) {
-            padding = 1;
-        } else if (i == 1) {
-            padding = 2;
+        v = _mm_add_epi8(v, roll);
+        v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+        v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+        v = _mm_shuffle_epi8(v, shuf);
+        _mm_storel_epi64((__m128i*)o, v);
+        uint32_t t = _mm_extract_epi32(v, 2);
+        memcpy(o + 8, &t, 4);
+    }
+    int64_t rt = base64decode_scalar(src + i, len - i, o);
+    return rt < 0 ? rt : (o - out) + rt;
+}
+
+__attribute__((target("avx2")))
+int64_t base64decode_avx2(const char* src, size_t len, unsigned char* out) {
+    const __m256i lut_lo = _mm256_setr_epi8(XX(LUT_LO));
+    const __m256i lut_hi = _mm256_setr_epi8(XX(LUT_HI));
+    const __m256i lut_roll = _mm256_setr_epi8(XX(LUT_ROLL));
+    const __m256i shuf = _mm256_setr_epi8(XX(DEC_SHUF));
+    const __m256i perm = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    size_t i = 0;
+    unsigned char* o = out;
+    for(; i + 32 + 4 <= len; i += 32, o += 24) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+        BASE64_DEC_LUT(_mm256_set1_epi8, _mm256_srli_epi32, _mm256_add_epi8, _mm256_and_si256, _mm256_cmpeq_epi8
+                       ,_mm256_shuffle_epi8, __m256i);
+        if(!_mm256_testz_si256(lo, hi)) {
+            break;
         }
-        for(; i < 3; ++i) {
-            packed <<= 8;
+        v = _mm256_add_epi8(v, roll);
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, shuf), perm);
+        _mm_storeu_si128((__m128i*)o, _mm256_castsi256_si128(v));
+        _mm_storel_epi64((__m128i*)(o + 16), _mm256_extracti128_si256(v, 1));
+    }
+    int64_t rt = base64decode_sse42(src + i, len - i, o);
+    return rt < 0 ? rt : (o - out) + rt;
+}
+
+#undef DEC_SHUF
+#undef LUT_ROLL
+#undef LUT_HI
+#undef LUT_LO
+#undef XX
+#undef BASE64_DEC_LUT
+
+__attribute__((target("sse4.2")))
+void hexencode_sse42(const unsigned char* in, size_t len, char* out) {
+    const __m128i lut = _mm_loadu_si128((const __m128i*)s_hex_chars);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+    for(; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(in + i));
+        __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+        __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, mask));
+        _mm_storeu_si128((__m128i*)(out + i * 2), _mm_unpacklo_epi8(hi, lo));
+        _mm_storeu_si128((__m128i*)(out + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+    }
+    hexencode_scalar(in + i, len - i, out + i * 2);
+}
+
+__attribute__((target("avx2")))
+void hexencode_avx2(const unsigned char* in, size_t len, char* out) {
+    const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)s_hex_chars));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+    for(; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+        __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, mask));
+        //unpack按128位通道交错, 再跨通道重排
+        __m256i a = _mm256_unpacklo_epi8(hi, lo);
+        __m256i b = _mm256_unpackhi_epi8(hi, lo);
+        _mm256_storeu_si256((__m256i*)(out + i * 2), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256((__m256i*)(out + i * 2 + 32), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    hexencode_sse42(in + i, len - i, out + i * 2);
+}
+
+//数字: c-'0'<=9; 字母: (c|0x20)-'a'<=5; 每两个半字节用maddubs合成一个字节
+#define HEX_DEC(type, set1, set1_16, sub, or_, and_, min, cmpeq, add, maddubs) \
+    type d = sub(v, set1('0')); \
+    type l = sub(or_(v, set1(0x20)), set1('a')); \
+    type is_d = cmpeq(min(d, set1(9)), d); \
+    type is_l = cmpeq(min(l, set1(5)), l); \
+    type ok = or_(is_d, is_l); \
+    v = or_(and_(is_d, d), and_(is_l, add(l, set1(10)))); \
+    v = maddubs(v, set1_16(0x0110));
+
+__attribute__((target("sse4.2")))
+size_t hexdecode_sse42(const char* in, size_t len, unsigned char* out) {
+    size_t i = 0;
+    for(; i + 32 <= len; i += 32) {
+        __m128i r[2];
+        bool valid = true;
+        for(int k = 0; k < 2; ++k) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(in + i + k * 16));
+            HEX_DEC(__m128i, _mm_set1_epi8, _mm_set1_epi16, _mm_sub_epi8, _mm_or_si128, _mm_and_si128
+                    ,_mm_min_epu8, _mm_cmpeq_epi8, _mm_add_epi8, _mm_maddubs_epi16);
+            valid = valid && _mm_movemask_epi8(ok) == 0xffff;
+            r[k] = v;
+        }
+        if(!valid) {
+            break;
         }
+        _mm_storeu_si128((__m128i*)(out + i / 2), _mm_packus_epi16(r[0], r[1]));
+    }
+    return i + hexdecode_scalar(in + i, len - i, out + i / 2);
+}
 
-        ret.append(1, base64[packed >> 18]);
-        ret.append(1, base64[(packed >> 12) & 0x3f]);
-        if(padding != 2) {
-            ret.append(1, base64[(packed >> 6) & 0x3f]);
+__attribute__((target("avx2")))
+size_t hexdecode_avx2(const char* in, size_t len, unsigned char* out) {
+    size_t i = 0;
+    for(; i + 64 <= len; i += 64) {
+        __m256i r[2];
+        bool valid = true;
+        for(int k = 0; k < 2; ++k) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(in + i + k * 32));
+            HEX_DEC(__m256i, _mm256_set1_epi8, _mm256_set1_epi16, _mm256_sub_epi8, _mm256_or_si256, _mm256_and_si256
+                    ,_mm256_min_epu8, _mm256_cmpeq_epi8, _mm256_add_epi8, _mm256_maddubs_epi16);
+            valid = valid && (uint32_t)_mm256_movemask_epi8(ok) == 0xffffffff;
+            r[k] = v;
         }
-        if(padding == 0) {
-            ret.append(1, base64[packed & 0x3f]);
+        if(!valid) {
+            break;
         }
-        ret.append(padding, '=');
+        __m256i p = _mm256_permute4x64_epi64(_mm256_packus_epi16(r[0], r[1]), 0xd8);
+        _mm256_storeu_si256((__m256i*)(out + i / 2), p);
     }
+    return i + hexdecode_sse42(in + i, len - i, out + i / 2);
+}
+
+#undef HEX_DEC
 
+//3路交错的crc32指令可以隐藏延迟, 但需要合并用的移位表, 这里按8字节顺序计算
+__attribute__((target("sse4.2")))
+uint32_t crc32c_sse42(uint32_t crc, const unsigned char* p, size_t len) {
+    uint64_t c = ~crc;
+    for(; len >= 8; len -= 8, p += 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+    }
+    uint32_t c32 = (uint32_t)c;
+    for(; len; --len) {
+        c32 = _mm_crc32_u8(c32, *p++);
+    }
+    return ~c32;
+}
+
+#endif
+
+struct CodecOps {
+    codec::Level level;
+    size_t (*base64encode)(const unsigned char* in, size_t len, char* out);
+    int64_t (*base64decode)(const char* src, size_t len, unsigned char* out);
+    void (*hexencode)(const unsigned char* in, size_t len, char* out);
+    size_t (*hexdecode)(const char* in, size_t len, unsigned char* out);
+    uint32_t (*crc32c)(uint32_t crc, const unsigned char* p, size_t len);
+};
+
+const CodecOps s_codec_ops[] = {
+    {codec::SCALAR, base64encode_scalar, base64decode_scalar, hexencode_scalar, hexdecode_scalar, crc32c_scalar},
+#ifdef SYLAR_HASH_UTIL_X86
+    {codec::SSE42, base64encode_sse42, base64decode_sse42, hexencode_sse42, hexdecode_sse42, crc32c_sse42},
+    {codec::AVX2, base64encode_avx2, base64decode_avx2, hexencode_avx2, hexdecode_avx2, crc32c_sse42},
+#endif
+};
+
+codec::Level DetectCodecLevel() {
+#ifdef SYLAR_HASH_UTIL_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("sse4.2")) {
+        return codec::AVX2;
+    }
+    if(__builtin_cpu_supports("sse4.2")) {
+        return codec::SSE42;
+    }
+#endif
+    return codec::SCALAR;
+}
+
+codec::Level MaxCodecLevel() {
+    static codec::Level s_level = DetectCodecLevel();
+    return s_level;
+}
+
+//函数内静态变量保证在其它模块的静态初始化中使用时也已选择好实现
+std::atomic<const CodecOps*>& CurrentCodecOps() {
+    static std::atomic<const CodecOps*> s_cur(&s_codec_ops[MaxCodecLevel()]);
+    return s_cur;
+}
+
+inline const CodecOps* GetCodecOps() {
+    return CurrentCodecOps().load(std::memory_order_relaxed);
+}
+
+}
+
+namespace codec {
+
+Level GetLevel() {
+    return GetCodecOps()->level;
+}
+
+Level GetMaxLevel() {
+    return MaxCodecLevel();
+}
+
+void SetLevel(Level v) {
+    if(v > MaxCodecLevel()) {
+        v = MaxCodecLevel();
+    }
+    CurrentCodecOps().store(&s_codec_ops[v], std::memory_order_relaxed);
+}
+
+const char* GetLevelName(Level v) {
+    switch(v) {
+        case AVX2:
+            return "avx2";
+        case SSE42:
+            return "sse4.2";
+        default:
+            return "scalar";
+    }
+}
+
+}
+
+uint32_t crc32c(const void* data, size_t len, uint32_t crc) {
+    return GetCodecOps()->crc32c(crc, (const unsigned char*)data, len);
+}
+
+#define XXH_ROTL32(x, r) (((x) << (r)) | ((x) >> (32 - (r))))
+#define XXH_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static const uint32_t XXH_P32_1 = 2654435761U;
+static const uint32_t XXH_P32_2 = 2246822519U;
+static const uint32_t XXH_P32_3 = 3266489917U;
+static const uint32_t XXH_P32_4 = 668265263U;
+static const uint32_t XXH_P32_5 = 374761393U;
+
+static const uint64_t XXH_P64_1 = 11400714785074694791ULL;
+static const uint64_t XXH_P64_2 = 14029467366897019727ULL;
+static const uint64_t XXH_P64_3 = 1609587929392839161ULL;
+static const uint64_t XXH_P64_4 = 9650029242287828579ULL;
+static const uint64_t XXH_P64_5 = 2870177450012600261ULL;
+
+template<class T>
+static inline T xxh_read(const unsigned char* p) {
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return byteswapOnBigEndian(v);
+}
+
+static inline uint32_t xxh32_round(uint32_t acc, uint32_t input) {
+    acc += input * XXH_P32_2;
+    acc = XXH_ROTL32(acc, 13);
+    return acc * XXH_P32_1;
+}
+
+static inline uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_P64_2;
+    acc = XXH_ROTL64(acc, 31);
+    return acc * XXH_P64_1;
+}
+
+static inline uint64_t xxh64_merge(uint64_t acc, uint64_t val) {
+    acc ^= xxh64_round(0, val);
+    return acc * XXH_P64_1 + XXH_P64_4;
+}
+
+uint32_t xxhash32(const void* data, size_t len, uint32_t seed) {
+    const unsigned char* p = (const unsigned char*)data;
+    const unsigned char* end = p + len;
+    uint32_t h = 0;
+    if(len >= 16) {
+        uint32_t v1 = seed + XXH_P32_1 + XXH_P32_2;
+        uint32_t v2 = seed + XXH_P32_2;
+        uint32_t v3 = seed;
+        uint32_t v4 = seed - XXH_P32_1;
+        for(; p + 16 <= end; p += 16) {
+            v1 = xxh32_round(v1, xxh_read<uint32_t>(p));
+            v2 = xxh32_round(v2, xxh_read<uint32_t>(p + 4));
+            v3 = xxh32_round(v3, xxh_read<uint32_t>(p + 8));
+            v4 = xxh32_round(v4, xxh_read<uint32_t>(p + 12));
+        }
+        h = XXH_ROTL32(v1, 1) + XXH_ROTL32(v2, 7) + XXH_ROTL32(v3, 12) + XXH_ROTL32(v4, 18);
+    } else {
+        h = seed + XXH_P32_5;
+    }
+    h += (uint32_t)len;
+    for(; p + 4 <= end; p += 4) {
+        h += xxh_read<uint32_t>(p) * XXH_P32_3;
+        h = XXH_ROTL32(h, 17) * XXH_P32_4;
+    }
+    for(; p < end; ++p) {
+        h += (*p) * XXH_P32_5;
+        h = XXH_ROTL32(h, 11) * XXH_P32_1;
+    }
+    h ^= h >> 15;
+    h *= XXH_P32_2;
+    h ^= h >> 13;
+    h *= XXH_P32_3;
+    h ^= h >> 16;
+    return h;
+}
+
+uint64_t xxhash64(const void* data, size_t len, uint64_t seed) {
+    const unsigned char* p = (const unsigned char*)data;
+    const unsigned char* end = p + len;
+    uint64_t h = 0;
+    if(len >= 32) {
+        uint64_t v1 = seed + XXH_P64_1 + XXH_P64_2;
+        uint64_t v2 = seed + XXH_P64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_P64_1;
+        for(; p + 32 <= end; p += 32) {
+            v1 = xxh64_round(v1, xxh_read<uint64_t>(p));
+            v2 = xxh64_round(v2, xxh_read<uint64_t>(p + 8));
+            v3 = xxh64_round(v3, xxh_read<uint64_t>(p + 16));
+            v4 = xxh64_round(v4, xxh_read<uint64_t>(p + 24));
+        }
+        h = XXH_ROTL64(v1, 1) + XXH_ROTL64(v2, 7) + XXH_ROTL64(v3, 12) + XXH_ROTL64(v4, 18);
+        h = xxh64_merge(h, v1);
+        h = xxh64_merge(h, v2);
+        h = xxh64_merge(h, v3);
+        h = xxh64_merge(h, v4);
+    } else {
+        h = seed + XXH_P64_5;
+    }
+    h += (uint64_t)len;
+    for(; p + 8 <= end; p += 8) {
+        h ^= xxh64_round(0, xxh_read<uint64_t>(p));
+        h = XXH_ROTL64(h, 27) * XXH_P64_1 + XXH_P64_4;
+    }
+    if(p + 4 <= end) {
+        h ^= (uint64_t)xxh_read<uint32_t>(p) * XXH_P64_1;
+        h = XXH_ROTL64(h, 23) * XXH_P64_2 + XXH_P64_3;
+        p += 4;
+    }
+    for(; p < end; ++p) {
+        h ^= (*p) * XXH_P64_5;
+        h = XXH_ROTL64(h, 11) * XXH_P64_1;
+    }
+    h ^= h >> 33;
+    h *= XXH_P64_2;
+    h ^= h >> 29;
+    h *= XXH_P64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+#undef XXH_ROTL64
+#undef XXH_ROTL32
+
+std::string base64decode(const std::string &src) {
+    std::string result;
+    result.resize(base64decode_length(src.size()));
+    int64_t len = base64decode(src.c_str(), src.size(), &result[0]);
+    if(len < 0) {
+        return "";
+    }
+    result.resize(len);
+    return result;
+}
+
+int64_t base64decode(const char *src, size_t len, void *output) {
+    return GetCodecOps()->base64decode(src, len, (unsigned char*)output);
+}
+
+std::string base64encode(const std::string& data) {
+    return base64encode(data.c_str(), data.size());
+}
+
+std::string base64encode(const void* data, size_t len) {
+    std::string ret;
+    ret.resize(base64encode_length(len));
+    if(len) {
+        base64encode(data, len, &ret[0]);
+    }
     return ret;
 }
 
+size_t base64encode(const void *data, size_t len, char *output) {
+    return GetCodecOps()->base64encode((const unsigned char*)data, len, output);
+}
+
 std::string md5(const std::string &data) {
     return hexstring_from_data(md5sum(data).c_str(), MD5_DIGEST_LENGTH);
 }
@@ -246,6 +767,32 @@ std::string sha1(const std::string &data) {
     return hexstring_from_data(sha1sum(data).c_str(), SHA_DIGEST_LENGTH);
 }
 
+void md5(const void *data, size_t len, char *output) {
+    unsigned char digest[MD5_DIGEST_LENGTH];
+    md5sum(data, len, digest);
+    hexstring_from_data(digest, MD5_DIGEST_LENGTH, output);
+}
+
+void sha1(const void *data, size_t len, char *output) {
+    unsigned char digest[SHA_DIGEST_LENGTH];
+    sha1sum(data, len, digest);
+    hexstring_from_data(digest, SHA_DIGEST_LENGTH, output);
+}
+
+void md5sum(const void *data, size_t len, void *output) {
+    MD5_CTX ctx;
+    MD5_Init(&ctx);
+    MD5_Update(&ctx, data, len);
+    MD5_Final((unsigned char*)output, &ctx);
+}
+
+void sha1sum(const void *data, size_t len, void *output) {
+    SHA_CTX ctx;
+    SHA1_Init(&ctx);
+    SHA1_Update(&ctx, data, len);
+    SHA1_Final((unsigned char*)output, &ctx);
+}
+
 std::string md5sum(const void *data, size_t len) {
     MD5_CTX ctx;
     MD5_Init(&ctx);
@@ -355,17 +902,7 @@ hmac_sha256(const std::string &text, const std::string &key) {
 
 void
 hexstring_from_data(const void *data, size_t len, char *output) {
-    const unsigned char *buf = (const unsigned char *)data;
-    size_t i, j;
-    for (i = j = 0; i < len; ++i) {
-        char c;
-        c = (buf[i] >> 4) & 0xf;
-        c = (c > 9) ? c + 'a' - 10 : c + '0';
-        output[j++] = c;
-        c = (buf[i] & 0xf);
-        c = (c > 9) ? c + 'a' - 10 : c + '0';
-        output[j++] = c;
-    }
+    GetCodecOps()->hexencode((const unsigned char*)data, len, output);
 }
 
 std::string
@@ -389,7 +926,9 @@ void data_from_hexstring(const char *hexstring, size_t length, void *output) {
     if (length % 2 != 0) {
         throw std::invalid_argument("data_from_hexstring length % 2 != 0");
     }
-    for (size_t i = 0; i < length; ++i) {
+    size_t done = GetCodecOps()->hexdecode(hexstring, length, buf);
+    buf += done / 2;
+    for (size_t i = done; i < length; ++i) {
         switch (hexstring[i]) {
             case 'a':
             case 'b':
@@ -14,10 +14,25 @@ uint64_t murmur3_hash64(const void* str, const uint32_t& size,  const uint32_t &
 uint32_t quick_hash(const char * str);
 uint32_t quick_hash(const void* str, uint32_t size);
 
+/// CRC32C(Castagnoli), 支持SSE4.2时使用crc32指令; crc为上一段的结果, 可分段计算
+uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0);
+/// xxHash32/xxHash64, 与官方实现结果一致
+uint32_t xxhash32(const void* data, size_t len, uint32_t seed = 0);
+uint64_t xxhash64(const void* data, size_t len, uint64_t seed = 0);
+
 std::string base64decode(const std::string &src);
 std::string base64encode(const std::string &data);
 std::string base64encode(const void *data, size_t len);
 
+/// base64编码后的长度(含padding)
+inline size_t base64encode_length(size_t len) { return (len + 2) / 3 * 4;}
+/// base64解码后的最大长度
+inline size_t base64decode_length(size_t len) { return len / 4 * 3;}
+/// Output must be of size base64encode_length(len), returns bytes written
+size_t base64encode(const void *data, size_t len, char *output);
+/// Output must be of size base64decode_length(len), returns bytes written or -1 if invalid
+int64_t base64decode(const char *src, size_t len, void *output);
+
 // Returns result in hex
 std::string md5(const std::string &data);
 std::string sha1(const std::string &data);
@@ -28,6 +43,12 @@ std::string sha0sum(const std::string &data);
 std::string sha0sum(const void *data, size_t len);
 std::string sha1sum(const std::string &data);
 std::string sha1sum(const void *data, size_t len);
+/// Output must be of size MD5_DIGEST_LENGTH(16) / SHA_DIGEST_LENGTH(20)
+void md5sum(const void *data, size_t len, void *output);
+void sha1sum(const void *data, size_t len, void *output);
+/// Output must be of size 32 / 40, and will *not* be null-terminated
+void md5(const void *data, size_t len, char *output);
+void sha1(const void *data, size_t len, char *output);
 std::string hmac_md5(const std::string &text, const std::string &key);
 std::string hmac_sha1(const std::string &text, const std::string &key);
 std::string hmac_sha256(const std::string &text, const std::string &key);
@@ -52,6 +73,26 @@ std::vector<std::string> split(const std::string &str, const char *delims, size_
 
 std::string random_string(size_t len
         ,const std::string& chars = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ");
+
+/**
+ * @brief base64/hex/crc32c的指令集选择, 默认使用CPU支持的最高级别
+ */
+namespace codec {
+enum Level {
+    SCALAR = 0,
+    /// SSSE3/SSE4.1/SSE4.2, 16字节向量
+    SSE42 = 1,
+    /// 32字节向量
+    AVX2 = 2
+};
+
+Level GetLevel();
+Level GetMaxLevel();
+/// 超过CPU支持的级别时取最高支持级别, 用于测试和对比
+void SetLevel(Level v);
+const char* GetLevelName(Level v);
+}
+
 }
 
 #endif
@@ -48,25 +48,25 @@ public:
     typedef void(*log_callback)(const char *message);
 
     ZKClient();
-    ~ZKClient();
+    virtual ~ZKClient();
 
-    bool init(const std::string& hosts, int recv_timeout, watcher_callback cb, log_callback lcb = nullptr);
-    int32_t setServers(const std::string& hosts);
+    virtual bool init(const std::string& hosts, int recv_timeout, watcher_callback cb, log_callback lcb = nullptr);
+    virtual int32_t setServers(const std::string& hosts);
 
-    int32_t create(const std::string& path, const std::string& val, std::string& new_path
+    virtual int32_t create(const std::string& path, const std::string& val, std::string& new_path
                    , const struct ACL_vector* acl = &ZOO_OPEN_ACL_UNSAFE
                    , int flags = 0);
-    int32_t exists(const std::string& path, bool watch, Stat* stat = nullptr);
-    int32_t del(const std::string& path, int version = -1);
-    int32_t get(const std::string& path, std::string& val, bool watch, Stat* stat = nullptr);
+    virtual int32_t exists(const std::string& path, bool watch, Stat* stat = nullptr);
+    virtual int32_t del(const std::string& path, int version = -1);
+    virtual int32_t get(const std::string& path, std::string& val, bool watch, Stat* stat = nullptr);
     int32_t getConfig(std::string& val, bool watch, Stat* stat = nullptr);
-    int32_t set(const std::string& path, const std::string& val, int version = -1, Stat* stat = nullptr);
-    int32_t getChildren(const std::string& path, std::vector<std::string>& val, bool watch, Stat* stat = nullptr);
-    int32_t close();
-    int32_t getState();
-    std::string  getCurrentServer();
+    virtual int32_t set(const std::string& path, const std::string& val, int version = -1, Stat* stat = nullptr);
+    virtual int32_t getChildren(const std::string& path, std::vector<std::string>& val, bool watch, Stat* stat = nullptr);
+    virtual int32_t close();
+    virtual int32_t getState();
+    virtual std::string  getCurrentServer();
 
-    bool reconnect();
+    virtual bool reconnect();
 private:
     static void OnWatcher(zhandle_t *zh, int type, int stat, const char *path,void *watcherCtx);
     typedef std::function<void(int type, int stat, const std::string& path)> watcher_callback2;
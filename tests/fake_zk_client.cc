@@ -0,0 +1,251 @@
+#include "fake_zk_client.h"
+#include <string.h>
+
+namespace sylar {
+
+static std::string GetParentPath(const std::string& path) {
+    auto pos = path.find_last_of('/');
+    if(pos == std::string::npos || pos == 0) {
+        return "/";
+    }
+    return path.substr(0, pos);
+}
+
+static std::string GetNodeName(const std::string& path) {
+    return path.substr(path.find_last_of('/') + 1);
+}
+
+FakeZKClient::FakeZKClient() {
+    m_nodes["/"];
+}
+
+bool FakeZKClient::init(const std::string& hosts, int recv_timeout, watcher_callback cb, log_callback lcb) {
+    MutexType::Lock lock(m_mutex);
+    m_hosts = hosts;
+    m_cb = cb;
+    m_connected = true;
+    lock.unlock();
+    fire({{EventType::SESSION, StateType::CONNECTED, ""}});
+    return true;
+}
+
+int32_t FakeZKClient::setServers(const std::string& hosts) {
+    MutexType::Lock lock(m_mutex);
+    m_hosts = hosts;
+    return ZOK;
+}
+
+int32_t FakeZKClient::create(const std::string& path, const std::string& val, std::string& new_path
+                             ,const struct ACL_vector* acl, int flags) {
+    if(path.empty() || path[0] != '/' || path == "/") {
+        return ZBADARGUMENTS;
+    }
+    std::vector<Event> events;
+    MutexType::Lock lock(m_mutex);
+    std::string real_path = path;
+    if(flags & FlagsType::SEQUENCE) {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "%010d", m_sequence++);
+        real_path += buf;
+    }
+    if(m_nodes.count(real_path)) {
+        return ZNODEEXISTS;
+    }
+    std::string parent = GetParentPath(real_path);
+    auto it = m_nodes.find(parent);
+    if(it == m_nodes.end()) {
+        return ZNONODE;
+    }
+    it->second.children.insert(GetNodeName(real_path));
+    Node& node = m_nodes[real_path];
+    node.data = val;
+    node.ephemeral = (flags & FlagsType::EPHEMERAL) != 0;
+    new_path = real_path;
+
+    if(m_childWatches.erase(parent)) {
+        events.push_back({EventType::CHILD, StateType::CONNECTED, parent});
+    }
+    if(m_dataWatches.erase(real_path)) {
+        events.push_back({EventType::CREATED, StateType::CONNECTED, real_path});
+    }
+    lock.unlock();
+    fire(events);
+    return ZOK;
+}
+
+int32_t FakeZKClient::exists(const std::string& path, bool watch, Stat* stat) {
+    MutexType::Lock lock(m_mutex);
+    if(watch) {
+        m_dataWatches.insert(path);
+    }
+    auto it = m_nodes.find(path);
+    if(it == m_nodes.end()) {
+        return ZNONODE;
+    }
+    fillStat(it->second, stat);
+    return ZOK;
+}
+
+int32_t FakeZKClient::del(const std::string& path, int version) {
+    std::vector<Event> events;
+    MutexType::Lock lock(m_mutex);
+    auto it = m_nodes.find(path);
+    if(it == m_nodes.end() || path == "/") {
+        return ZNONODE;
+    }
+    if(!it->second.children.empty()) {
+        return ZNOTEMPTY;
+    }
+    delNolock(path, events);
+    lock.unlock();
+    fire(events);
+    return ZOK;
+}
+
+int32_t FakeZKClient::get(const std::string& path, std::string& val, bool watch, Stat* stat) {
+    MutexType::Lock lock(m_mutex);
+    auto it = m_nodes.find(path);
+    if(it == m_nodes.end()) {
+        return ZNONODE;
+    }
+    if(watch) {
+        m_dataWatches.insert(path);
+    }
+    val = it->second.data;
+    fillStat(it->second, stat);
+    return ZOK;
+}
+
+int32_t FakeZKClient::set(const std::string& path, const std::string& val, int version, Stat* stat) {
+    std::vector<Event> events;
+    MutexType::Lock lock(m_mutex);
+    auto it = m_nodes.find(path);
+    if(it == m_nodes.end()) {
+        return ZNONODE;
+    }
+    it->second.data = val;
+    fillStat(it->second, stat);
+    if(m_dataWatches.erase(path)) {
+        events.push_back({EventType::CHANGED, StateType::CONNECTED, path});
+    }
+    lock.unlock();
+    fire(events);
+    return ZOK;
+}
+
+int32_t FakeZKClient::getChildren(const std::string& path, std::vector<std::string>& val, bool watch, Stat* stat) {
+    MutexType::Lock lock(m_mutex);
+    auto it = m_nodes.find(path);
+    if(it == m_nodes.end()) {
+        return ZNONODE;
+    }
+    if(watch) {
+        m_childWatches.insert(path);
+    }
+    val.insert(val.end(), it->second.children.begin(), it->second.children.end());
+    fillStat(it->second, stat);
+    return ZOK;
+}
+
+int32_t FakeZKClient::close() {
+    std::vector<Event> events;
+    MutexType::Lock lock(m_mutex);
+    m_cb = nullptr;
+    m_connected = false;
+    std::vector<std::string> ephemerals;
+    for(auto& i : m_nodes) {
+        if(i.second.ephemeral) {
+            ephemerals.push_back(i.first);
+        }
+    }
+    for(auto& i : ephemerals) {
+        delNolock(i, events);
+    }
+    m_childWatches.clear();
+    m_dataWatches.clear();
+    return ZOK;
+}
+
+int32_t FakeZKClient::getState() {
+    MutexType::Lock lock(m_mutex);
+    return m_connected ? StateType::CONNECTED : StateType::NOTCONNECTED;
+}
+
+std::string FakeZKClient::getCurrentServer() {
+    MutexType::Lock lock(m_mutex);
+    return m_hosts;
+}
+
+bool FakeZKClient::reconnect() {
+    MutexType::Lock lock(m_mutex);
+    m_connected = true;
+    lock.unlock();
+    fire({{EventType::SESSION, StateType::CONNECTED, ""}});
+    return true;
+}
+
+void FakeZKClient::expireSession() {
+    std::vector<Event> events;
+    MutexType::Lock lock(m_mutex);
+    std::vector<std::string> ephemerals;
+    for(auto& i : m_nodes) {
+        if(i.second.ephemeral) {
+            ephemerals.push_back(i.first);
+        }
+    }
+    for(auto& i : ephemerals) {
+        delNolock(i, events);
+    }
+    //会话过期后服务端的watch全部失效
+    m_childWatches.clear();
+    m_dataWatches.clear();
+    m_connected = false;
+    events.push_back({EventType::SESSION, StateType::EXPIRED_SESSION, ""});
+    lock.unlock();
+    fire(events);
+}
+
+size_t FakeZKClient::getNodeCount() {
+    MutexType::Lock lock(m_mutex);
+    return m_nodes.size();
+}
+
+void FakeZKClient::delNolock(const std::string& path, std::vector<Event>& events) {
+    m_nodes.erase(path);
+    std::string parent = GetParentPath(path);
+    auto it = m_nodes.find(parent);
+    if(it != m_nodes.end()) {
+        it->second.children.erase(GetNodeName(path));
+    }
+    if(m_childWatches.erase(parent)) {
+        events.push_back({EventType::CHILD, StateType::CONNECTED, parent});
+    }
+    if(m_dataWatches.erase(path)) {
+        events.push_back({EventType::DELETED, StateType::CONNECTED, path});
+    }
+    m_childWatches.erase(path);
+}
+
+void FakeZKClient::fillStat(const Node& node, Stat* stat) {
+    if(!stat) {
+        return;
+    }
+    memset(stat, 0, sizeof(*stat));
+    stat->dataLength = node.data.size();
+    stat->numChildren = node.children.size();
+}
+
+void FakeZKClient::fire(const std::vector<Event>& events) {
+    MutexType::Lock lock(m_mutex);
+    watcher_callback cb = m_cb;
+    lock.unlock();
+    if(!cb) {
+        return;
+    }
+    auto self = shared_from_this();
+    for(auto& i : events) {
+        cb(i.type, i.state, i.path, self);
+    }
+}
+
+}
@@ -0,0 +1,84 @@
+#ifndef __SYLAR_FAKE_ZK_CLIENT_H__
+#define __SYLAR_FAKE_ZK_CLIENT_H__
+
+#include "sylar/zk_client.h"
+#include "sylar/mutex.h"
+#include <map>
+#include <set>
+
+namespace sylar {
+
+/**
+ * @brief 进程内的zookeeper替身, 用于测试服务发现
+ * @details 在内存中维护节点树, 支持临时/顺序节点和一次性watch(CHILD/CHANGED/CREATED/DELETED).
+ *          watch回调在触发变更的线程上同步调用(不持有内部锁),
+ *          init/reconnect时回调SESSION+CONNECTED, expireSession模拟会话过期
+ */
+class FakeZKClient : public ZKClient {
+public:
+    typedef std::shared_ptr<FakeZKClient> ptr;
+    typedef sylar::Mutex MutexType;
+
+    FakeZKClient();
+
+    virtual bool init(const std::string& hosts, int recv_timeout, watcher_callback cb, log_callback lcb = nullptr) override;
+    virtual int32_t setServers(const std::string& hosts) override;
+
+    virtual int32_t create(const std::string& path, const std::string& val, std::string& new_path
+                   , const struct ACL_vector* acl = &ZOO_OPEN_ACL_UNSAFE
+                   , int flags = 0) override;
+    virtual int32_t exists(const std::string& path, bool watch, Stat* stat = nullptr) override;
+    virtual int32_t del(const std::string& path, int version = -1) override;
+    virtual int32_t get(const std::string& path, std::string& val, bool watch, Stat* stat = nullptr) override;
+    virtual int32_t set(const std::string& path, const std::string& val, int version = -1, Stat* stat = nullptr) override;
+    virtual int32_t getChildren(const std::string& path, std::vector<std::string>& val, bool watch, Stat* stat = nullptr) override;
+    virtual int32_t close() override;
+    virtual int32_t getState() override;
+    virtual std::string getCurrentServer() override;
+
+    virtual bool reconnect() override;
+
+    /**
+     * @brief 模拟会话过期: 删除本会话的临时节点并回调SESSION+EXPIRED_SESSION
+     */
+    void expireSession();
+
+    /**
+     * @brief 返回节点数
+     */
+    size_t getNodeCount();
+private:
+    struct Node {
+        std::string data;
+        bool ephemeral = false;
+        std::set<std::string> children;
+    };
+
+    struct Event {
+        int type;
+        int state;
+        std::string path;
+    };
+
+    /**
+     * @brief 删除节点, 调用方持有锁, 触发的watch事件追加到events
+     */
+    void delNolock(const std::string& path, std::vector<Event>& events);
+    void fillStat(const Node& node, Stat* stat);
+    void fire(const std::vector<Event>& events);
+private:
+    MutexType m_mutex;
+    std::map<std::string, Node> m_nodes;
+    /// getChildren注册的watch
+    std::set<std::string> m_childWatches;
+    /// get/exists注册的watch
+    std::set<std::string> m_dataWatches;
+    watcher_callback m_cb;
+    std::string m_hosts;
+    int32_t m_sequence = 0;
+    bool m_connected = false;
+};
+
+}
+
+#endif
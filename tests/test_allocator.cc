@@ -0,0 +1,203 @@
+#include "sylar/ds/allocator.h"
+#include "sylar/ds/array.h"
+#include "sylar/ds/bitmap.h"
+#include "sylar/ds/dict.h"
+#include "sylar/util.h"
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <random>
+#include <vector>
+#include <sys/mman.h>
+
+using namespace sylar::ds;
+
+static std::vector<Allocator::ptr> CreateAllocators() {
+    std::vector<Allocator::ptr> rt;
+    rt.push_back(Allocator::ptr(new MallocAllocator("malloc")));
+    MmapAllocatorOptions opts;
+    opts.min_mmap_size = 4096;
+    rt.push_back(Allocator::ptr(new MmapAllocator("mmap", opts)));
+    opts.huge = MmapAllocatorOptions::HUGE_TRANSPARENT;
+    rt.push_back(Allocator::ptr(new MmapAllocator("thp", opts)));
+    opts.huge = MmapAllocatorOptions::HUGE_EXPLICIT;
+    opts.numa = MmapAllocatorOptions::NUMA_BIND;
+    opts.numa_nodes = 1;
+    opts.populate = true;
+    rt.push_back(Allocator::ptr(new MmapAllocator("hugetlb_node0", opts)));
+    MmapAllocatorOptions fopts;
+    fopts.file_dir = ".";
+    fopts.min_mmap_size = 4096;
+    rt.push_back(Allocator::ptr(new MmapAllocator("file", fopts)));
+    for(auto& i : rt) {
+        AllocatorMgr::GetInstance()->add(i);
+    }
+    return rt;
+}
+
+//各分配器下容器行为一致, 统计与容器占用一致, 释放后归零
+void test_check(const std::vector<Allocator::ptr>& allocs) {
+    for(auto& alloc : allocs) {
+        int fail = 0;
+        std::mt19937 rng(1);
+        {
+            Array<uint64_t> arr(1 << 20, alloc);
+            std::vector<uint64_t> expect(1 << 20);
+            for(size_t i = 0; i < arr.size(); ++i) {
+                fail += arr[i] != 0;
+                arr[i] = expect[i] = rng();
+            }
+            //逐个追加跨越多个页和映射大小
+            for(int i = 0; i < 100000; ++i) {
+                uint64_t v = rng();
+                arr.append(v);
+                expect.push_back(v);
+            }
+            for(int i = 0; i < 1000; ++i) {
+                size_t idx = rng() % arr.size();
+                arr.erase(idx);
+                expect.erase(expect.begin() + idx);
+            }
+            fail += arr.size() != expect.size();
+            fail += memcmp(arr.data(), expect.data(), expect.size() * sizeof(uint64_t)) != 0;
+            fail += alloc->getStats().bytes != (int64_t)arr.getMemoryUsage();
+
+            Array<uint32_t> sorted(0, alloc);
+            for(int i = 0; i < 20000; ++i) {
+                sorted.insert(rng() % 100000);
+            }
+            fail += !sorted.isSorted();
+
+            Bitmap b1(10000000, 0, alloc), b2(10000000, 0, alloc);
+            Bitmap m1(10000000), m2(10000000);
+            for(int i = 0; i < 100000; ++i) {
+                uint32_t x = rng() % 10000000, y = rng() % 10000000;
+                b1.set(x, true);
+                m1.set(x, true);
+                b2.set(y, true);
+                m2.set(y, true);
+            }
+            b1.set(14 * 350000, 14 * 7000, true);
+            m1.set(14 * 350000, 14 * 7000, true);
+            Bitmap b3 = b1 & b2;
+            Bitmap m3 = m1 & m2;
+            fail += b3.getCount() != m3.getCount();
+            fail += (b1 | b2).getCount() != (m1 | m2).getCount();
+            fail += b1.compress()->getCount() != m1.compress()->getCount();
+            fail += b1.compress()->getAllocator() != alloc;
+            //多路运算的结果沿用第一个Bitmap的分配器
+            std::vector<Bitmap::ptr> bs = {Bitmap::ptr(new Bitmap(b1)), Bitmap::ptr(new Bitmap(b2))};
+            fail += Bitmap::And(bs)->getCount() != m3.getCount();
+            fail += Bitmap::And(bs)->getAllocator() != alloc;
+            fail += Bitmap::Or(bs)->getAllocator() != alloc;
+            fail += b1.compress()->uncompress()->getCount() != m1.getCount();
+
+            Dict<uint64_t, uint32_t> dict(0, alloc);
+            std::vector<uint32_t> v(100);
+            for(uint64_t k = 0; k < 10000; ++k) {
+                dict.insert(k, v.data(), k % 100 + 1);
+            }
+            std::stringstream ss;
+            dict.writeTo(ss);
+            Dict<uint64_t, uint32_t> loaded(0, alloc);
+            int64_t before = alloc->getStats().bytes;
+            fail += !loaded.readFrom(ss);
+            fail += loaded.getTotal() != dict.getTotal();
+            fail += alloc->getStats().bytes <= before;
+            fail += loaded.getMemoryUsage() == 0;
+
+            std::cout << "  " << alloc->toString() << std::endl;
+        }
+        fail += alloc->getStats().bytes != 0 || alloc->getStats().blocks != 0;
+        std::cout << "check " << alloc->getName() << (fail ? " FAIL" : " ok") << std::endl;
+    }
+}
+
+//引用外部只读数据的Array修改时先复制, 不改写源数据
+void test_borrowed() {
+    int fail = 0;
+    const size_t n = 4096 / sizeof(uint32_t);
+    uint32_t* buf = (uint32_t*)mmap(NULL, 4096, PROT_READ | PROT_WRITE
+                        ,MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    for(size_t i = 0; i < n; ++i) {
+        buf[i] = i;
+    }
+    mprotect(buf, 4096, PROT_READ);
+    {
+        Array<uint32_t> arr(buf, n, false);
+        fail += arr.getMemoryUsage() != 0;
+        arr.erase(0);
+        arr.erase(10);
+        fail += arr.size() != n - 2;
+        fail += arr[0] != 1 || arr[10] != 12;
+        fail += arr.data() == buf;
+    }
+    for(size_t i = 0; i < n; ++i) {
+        fail += buf[i] != i;
+    }
+    {
+        Array<uint32_t> arr(buf, n, false);
+        arr.insert(-1, 100);
+        arr.append(200);
+        fail += arr.size() != n + 2 || arr[0] != 100 || arr[n + 1] != 200;
+    }
+    for(size_t i = 0; i < n; ++i) {
+        fail += buf[i] != i;
+    }
+    munmap(buf, 4096);
+    std::cout << "check borrowed" << (fail ? " FAIL" : " ok") << std::endl;
+}
+
+static std::string AnonHugePages() {
+    std::ifstream ifs("/proc/self/smaps_rollup");
+    std::string line;
+    while(std::getline(ifs, line)) {
+        if(line.find("AnonHugePages") == 0) {
+            return line.substr(line.find_first_not_of(" ", 14));
+        }
+    }
+    return "unknown";
+}
+
+//随机访问: 数据远大于TLB覆盖范围时大页减少页表遍历
+void test_bench(const std::vector<Allocator::ptr>& allocs) {
+    const uint64_t size = 1ull << 27;
+    std::cout << "bench array<uint64_t> size=" << size << " (" << (size * 8 >> 20) << "MB)" << std::endl;
+    for(auto& alloc : allocs) {
+        if(alloc->getName() == "file") {
+            continue;
+        }
+        uint64_t ts = sylar::GetCurrentUS();
+        Array<uint64_t> arr(size, alloc);
+        for(uint64_t i = 0; i < size; ++i) {
+            arr[i] = i;
+        }
+        uint64_t fill_used = sylar::GetCurrentUS() - ts;
+        std::string huge = AnonHugePages();
+        uint64_t resident = alloc->getResident();
+
+        ts = sylar::GetCurrentUS();
+        uint64_t x = 1, sum = 0;
+        for(int i = 0; i < 20000000; ++i) {
+            x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+            sum += arr[(x >> 20) % size];
+        }
+        uint64_t rand_used = sylar::GetCurrentUS() - ts;
+        std::cout << "  " << alloc->getName() << ": fill=" << fill_used / 1000 << "ms"
+                  << " random_read(20M)=" << rand_used / 1000 << "ms"
+                  << " resident=" << (resident >> 20) << "MB"
+                  << " AnonHugePages=" << huge
+                  << " sum=" << sum << std::endl;
+    }
+    std::stringstream ss;
+    AllocatorMgr::GetInstance()->dump(ss);
+    std::cout << ss.str();
+}
+
+int main(int argc, char** argv) {
+    auto allocs = CreateAllocators();
+    test_check(allocs);
+    test_borrowed();
+    test_bench(allocs);
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include "sylar/ds/bitmap.h"
+#include "sylar/ds/simd.h"
+#include "sylar/util.h"
+#include <iostream>
+#include <random>
+#include <set>
+
+using sylar::ds::Bitmap;
+namespace simd = sylar::ds::simd;
+
+static Bitmap::ptr Random(uint32_t size, uint32_t count, std::mt19937& rng, std::set<uint32_t>& v) {
+    Bitmap::ptr b(new Bitmap(size));
+    for(uint32_t i = 0; i < count; ++i) {
+        uint32_t t = rng() % size;
+        b->set(t, true);
+        v.insert(t);
+    }
+    return b;
+}
+
+static bool Same(Bitmap& b, const std::set<uint32_t>& v) {
+    std::vector<uint32_t> pos;
+    b.listPosAsc(pos);
+    std::vector<uint32_t> pos2;
+    b.foreach([&pos2](uint32_t i) {
+        pos2.push_back(i);
+        return true;
+    });
+    return b.getCount() == v.size()
+        && pos == std::vector<uint32_t>(v.begin(), v.end())
+        && pos2 == pos;
+}
+
+//与std::set结果对比, 覆盖各实现和各种尾部长度
+void test_check() {
+    std::mt19937 rng(1);
+    int fail = 0;
+    for(int level = simd::SCALAR; level <= simd::GetMaxLevel(); ++level) {
+        simd::SetLevel((simd::Level)level);
+        for(int n = 0; n < 300; ++n) {
+            uint32_t size = rng() % 20000 + 1;
+            std::vector<std::set<uint32_t> > sets(4);
+            std::vector<Bitmap::ptr> bs;
+            for(auto& s : sets) {
+                bs.push_back(Random(size, size / 2, rng, s));
+            }
+
+            std::set<uint32_t> and_v = sets[0], or_v, xor_v, andnot_v;
+            for(size_t i = 1; i < sets.size(); ++i) {
+                std::set<uint32_t> tmp;
+                std::set_intersection(and_v.begin(), and_v.end(), sets[i].begin(), sets[i].end()
+                                      ,std::inserter(tmp, tmp.begin()));
+                and_v.swap(tmp);
+            }
+            for(auto& s : sets) {
+                or_v.insert(s.begin(), s.end());
+            }
+            std::set_symmetric_difference(sets[0].begin(), sets[0].end(), sets[1].begin(), sets[1].end()
+                                          ,std::inserter(xor_v, xor_v.begin()));
+            std::set_difference(sets[0].begin(), sets[0].end(), sets[1].begin(), sets[1].end()
+                                ,std::inserter(andnot_v, andnot_v.begin()));
+
+            Bitmap a = *bs[0] & *bs[1];
+            a &= *bs[2];
+            a &= *bs[3];
+            Bitmap x = *bs[0] ^ *bs[1];
+            Bitmap an(*bs[0]);
+            an.andNot(*bs[1]);
+            std::vector<uint32_t> and_pos;
+            Bitmap::AndListPos(bs, and_pos);
+
+            fail += !Same(a, and_v);
+            fail += !Same(*Bitmap::And(bs), and_v);
+            fail += !Same(*Bitmap::Or(bs), or_v);
+            fail += !Same(x, xor_v);
+            fail += !Same(an, andnot_v);
+            fail += Bitmap::AndCount(bs) != and_v.size();
+            fail += Bitmap::OrCount(bs) != or_v.size();
+            fail += and_pos != std::vector<uint32_t>(and_v.begin(), and_v.end());
+
+            //全1初始化时压缩标记位和尾部多余位不计数
+            Bitmap full(size, 0xFF);
+            fail += full.getCount() != size;
+        }
+        std::cout << "check " << simd::GetLevelName((simd::Level)level)
+                  << (fail ? " FAIL" : " ok") << std::endl;
+    }
+    simd::SetLevel(simd::GetMaxLevel());
+}
+
+#define BENCH(name, n, expr) { \
+    uint64_t ts = sylar::GetCurrentUS(); \
+    for(int i = 0; i < n; ++i) { \
+        expr; \
+    } \
+    std::cout << "    " << name << ": " << (sylar::GetCurrentUS() - ts) / 1000.0 / n << "ms" << std::endl; \
+}
+
+void test_bench() {
+    const uint32_t size = 100000000;
+    const int ways = 8;
+    std::mt19937 rng(1);
+    std::vector<Bitmap::ptr> bs;
+    for(int i = 0; i < ways; ++i) {
+        Bitmap::ptr b(new Bitmap(size));
+        //密度依次降低, 多路交集逐步变稀疏
+        for(uint32_t n = 0; n < size / (i + 2); ++n) {
+            b->set(rng() % size, true);
+        }
+        bs.push_back(b);
+    }
+    Bitmap tmp(*bs[0]);
+    uint64_t sum = 0;
+    std::cout << "bench size=" << size << " ways=" << ways << std::endl;
+    for(int level = simd::SCALAR; level <= simd::GetMaxLevel(); ++level) {
+        simd::SetLevel((simd::Level)level);
+        std::cout << "  " << simd::GetLevelName((simd::Level)level) << std::endl;
+        BENCH("and", 20, tmp &= *bs[1]);
+        BENCH("or", 20, tmp |= *bs[1]);
+        BENCH("xor", 20, tmp ^= *bs[1]);
+        BENCH("andnot", 20, tmp.andNot(*bs[1]));
+        BENCH("count", 20, sum += bs[0]->getCount());
+        BENCH("and chain(8)", 5, {
+            Bitmap r = *bs[0] & *bs[1];
+            for(int n = 2; n < ways; ++n) {
+                r = r & *bs[n];
+            }
+            sum += r.getCount();
+        });
+        BENCH("And(8)", 5, sum += Bitmap::And(bs)->getCount());
+        BENCH("AndCount(8)", 5, sum += Bitmap::AndCount(bs));
+        BENCH("OrCount(8)", 5, sum += Bitmap::OrCount(bs));
+    }
+    std::vector<uint32_t> pos;
+    BENCH("listPosAsc", 3, {
+        pos.clear();
+        bs[1]->listPosAsc(pos);
+    });
+    BENCH("iterator", 3, {
+        for(auto it = bs[1]->begin(); !it; it.next()) {
+            sum += *it;
+        }
+    });
+    BENCH("AndListPos(8)", 3, {
+        pos.clear();
+        Bitmap::AndListPos(bs, pos);
+    });
+    std::cout << "sum=" << sum << " pos=" << pos.size() << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_check();
+    test_bench();
+    return 0;
+}
@@ -0,0 +1,265 @@
+#include "sylar/buffer_chain.h"
+#include "sylar/streams/zlib_stream.h"
+#include "sylar/util.h"
+#include <iostream>
+#include <random>
+#include <thread>
+#include <unistd.h>
+
+using sylar::BufferChain;
+using sylar::BufferPool;
+
+static std::string Random(std::mt19937& rng, size_t len) {
+    std::string rt(len, '\0');
+    for(auto& c : rt) {
+        c = rng();
+    }
+    return rt;
+}
+
+static std::string Concat(const std::vector<iovec>& iovs) {
+    std::string rt;
+    for(auto& i : iovs) {
+        rt.append((const char*)i.iov_base, i.iov_len);
+    }
+    return rt;
+}
+
+//随机操作与std::string对比
+void test_check() {
+    int fail = 0;
+    int64_t alive = BufferPool::GetAliveCount();
+    {
+        std::mt19937 rng(1);
+        BufferChain chain;
+        std::string expect;
+        std::vector<std::pair<BufferChain, std::string> > snapshots;
+        for(int n = 0; n < 20000; ++n) {
+            size_t len = rng() % 3 ? rng() % 100 : rng() % 10000;
+            std::string data = Random(rng, len);
+            switch(rng() % 10) {
+                case 0:
+                    chain.prepend(data.c_str(), data.size());
+                    expect = data + expect;
+                    break;
+                case 1: {
+                    size_t offset = expect.empty() ? 0 : rng() % expect.size();
+                    BufferChain s = chain.slice(offset, len);
+                    fail += s.toString() != expect.substr(offset, len);
+                    chain.append(s);
+                    expect += expect.substr(offset, len);
+                    break;
+                }
+                case 2: {
+                    BufferChain head = chain.cut(len);
+                    fail += head.toString() != expect.substr(0, len);
+                    expect = expect.substr(std::min(len, expect.size()));
+                    if(rng() % 2) {
+                        chain.prepend(head);
+                        expect = head.toString() + expect;
+                    }
+                    break;
+                }
+                case 3:
+                    chain.consume(len);
+                    expect = expect.substr(std::min(len, expect.size()));
+                    break;
+                case 4:
+                    if(len < expect.size()) {
+                        chain.truncate(expect.size() - len);
+                        expect.resize(expect.size() - len);
+                    }
+                    break;
+                case 5: {
+                    const char* p = chain.linearize(len);
+                    if(len <= expect.size()) {
+                        fail += !p || memcmp(p, expect.c_str(), len) != 0;
+                    } else {
+                        fail += p != nullptr;
+                    }
+                    break;
+                }
+                case 6: {
+                    //直接写入getWriteBuffers再提交一部分
+                    std::vector<iovec> iovs;
+                    chain.getWriteBuffers(iovs, len);
+                    size_t commit = len ? rng() % (len + 1) : 0;
+                    size_t pos = 0;
+                    for(auto& i : iovs) {
+                        size_t n = std::min(i.iov_len, data.size() - pos);
+                        memcpy(i.iov_base, data.c_str() + pos, n);
+                        pos += n;
+                    }
+                    chain.commitWrite(commit);
+                    expect += data.substr(0, commit);
+                    break;
+                }
+                case 7:
+                    //共享后双方分别追加, 互不影响
+                    if(snapshots.size() < 20) {
+                        snapshots.push_back(std::make_pair(chain, expect));
+                    }
+                    {
+                        auto& snap = snapshots[rng() % snapshots.size()];
+                        snap.first.append(data.c_str(), data.size());
+                        snap.second += data;
+                    }
+                    break;
+                default:
+                    chain.append(data.c_str(), data.size());
+                    expect += data;
+                    break;
+            }
+            if(expect.size() > 1000000) {
+                chain.consume(500000);
+                expect = expect.substr(500000);
+            }
+            fail += chain.size() != expect.size();
+            if(n % 100 == 0) {
+                fail += chain.toString() != expect;
+                std::vector<iovec> iovs;
+                size_t offset = expect.empty() ? 0 : rng() % expect.size();
+                chain.getReadBuffers(iovs, len, offset);
+                fail += Concat(iovs) != expect.substr(offset, len);
+            }
+        }
+        fail += chain.toString() != expect;
+        for(auto& i : snapshots) {
+            fail += i.first.toString() != i.second;
+        }
+
+        //ByteArray适配
+        sylar::ByteArray::ptr ba = chain.toByteArray();
+        fail += ba->toString() != expect;
+        BufferChain c2;
+        ba->setPosition(100);
+        c2.append(ba);
+        fail += c2.toString() != expect.substr(100);
+        fail += ba->getPosition() != 100;
+
+        //zlib输出零拷贝接管
+        auto zc = sylar::ZlibStream::CreateGzip(true);
+        zc->write(chain, chain.size());
+        zc->flush();
+        BufferChain compressed = zc->getBufferChain();
+        fail += !zc->getBuffers().empty();
+        auto zd = sylar::ZlibStream::CreateGzip(false);
+        zd->write(compressed, compressed.size());
+        zd->flush();
+        fail += zd->getBufferChain().toString() != expect;
+    }
+    fail += BufferPool::GetAliveCount() != alive;
+    std::cout << "check" << (fail ? " FAIL" : " ok")
+              << " cached=" << BufferPool::GetLocalCachedCount() << std::endl;
+}
+
+//跨线程: 在一个线程分配, 另一个线程释放
+void test_thread() {
+    int fail = 0;
+    int64_t alive = BufferPool::GetAliveCount();
+    std::vector<BufferChain> chains(100);
+    std::string data(10000, 'x');
+    for(auto& i : chains) {
+        i.append(data.c_str(), data.size());
+    }
+    std::thread t1([&chains]() {
+        for(size_t i = 0; i < chains.size(); i += 2) {
+            chains[i].clear();
+        }
+    });
+    std::thread t2([&chains, &data]() {
+        for(size_t i = 1; i < chains.size(); i += 2) {
+            BufferChain c(chains[i]);
+            c.append(data.c_str(), data.size());
+            chains[i].clear();
+        }
+    });
+    t1.join();
+    t2.join();
+    fail += BufferPool::GetAliveCount() != alive;
+
+    //pipe: readv直接读入块内存
+    int fds[2];
+    if(pipe(fds) == 0) {
+        BufferChain in(data.c_str(), 5000);
+        std::vector<iovec> iovs;
+        in.getReadBuffers(iovs);
+        fail += writev(fds[1], &iovs[0], iovs.size()) != 5000;
+        BufferChain out;
+        iovs.clear();
+        out.getWriteBuffers(iovs, 10000);
+        ssize_t rt = readv(fds[0], &iovs[0], iovs.size());
+        out.commitWrite(rt > 0 ? rt : 0);
+        fail += out.toString() != data.substr(0, 5000);
+        close(fds[0]);
+        close(fds[1]);
+    }
+    std::cout << "thread" << (fail ? " FAIL" : " ok") << std::endl;
+}
+
+//消息在解码->解压->处理间传递: ByteArray每一步复制, BufferChain只增加引用
+void test_bench() {
+    std::mt19937 rng(1);
+    std::string msg = Random(rng, 64 * 1024);
+    const int n = 10000;
+    uint64_t sum = 0;
+
+    uint64_t ts = sylar::GetCurrentUS();
+    for(int i = 0; i < n; ++i) {
+        sylar::ByteArray::ptr ba(new sylar::ByteArray);
+        ba->write(msg.c_str(), msg.size());
+        ba->setPosition(0);
+        for(int stage = 0; stage < 3; ++stage) {
+            sylar::ByteArray::ptr next(new sylar::ByteArray);
+            std::vector<iovec> iovs;
+            ba->getReadBuffers(iovs);
+            for(auto& v : iovs) {
+                next->write(v.iov_base, v.iov_len);
+            }
+            next->setPosition(0);
+            ba = next;
+        }
+        sum += ba->getSize();
+    }
+    uint64_t t1 = sylar::GetCurrentUS();
+    for(int i = 0; i < n; ++i) {
+        BufferChain chain(msg.c_str(), msg.size());
+        for(int stage = 0; stage < 3; ++stage) {
+            BufferChain next;
+            next.append(chain);
+            chain = std::move(next);
+        }
+        sum += chain.size();
+    }
+    uint64_t t2 = sylar::GetCurrentUS();
+    std::cout << "bench 64K message x3 stages: bytearray=" << (t1 - ts) / 1000.0
+              << "ms bufferchain=" << (t2 - t1) / 1000.0 << "ms" << std::endl;
+
+    std::string text;
+    while(text.size() < 4 * 1024 * 1024) {
+        text += "key=" + std::to_string(rng() % 1000) + "&value=" + std::to_string(rng() % 100) + ";";
+    }
+    //只统计取出压缩结果的耗时
+    uint64_t used_ba = 0, used_chain = 0;
+    for(int i = 0; i < 20; ++i) {
+        auto zs = sylar::ZlibStream::CreateGzip(true, 4096);
+        zs->write(text.c_str(), text.size());
+        zs->flush();
+        ts = sylar::GetCurrentUS();
+        sum += zs->getByteArray()->getSize();
+        t1 = sylar::GetCurrentUS();
+        sum += zs->getBufferChain().size();
+        t2 = sylar::GetCurrentUS();
+        used_ba += t1 - ts;
+        used_chain += t2 - t1;
+    }
+    std::cout << "bench gzip 4M: getByteArray=" << used_ba / 1000.0
+              << "ms getBufferChain=" << used_chain / 1000.0 << "ms sum=" << sum << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_check();
+    test_thread();
+    test_bench();
+    return 0;
+}
@@ -84,7 +84,137 @@ void test() {
 #undef XX
 }
 
+//批量接口与逐个接口编码一致, 覆盖跨内存块和各种长度的值
+void test_array() {
+#define XX(type, len, base_len, write_fun, read_fun, write_array, read_array) {\
+    std::vector<type> vec; \
+    for(int i = 0; i < len; ++i) { \
+        int bits = rand() % (sizeof(type) * 8); \
+        type v = (type)(((uint64_t)rand() << 32 | rand()) >> (63 - bits)); \
+        vec.push_back(i % 3 ? v : (type)(rand() % 128)); \
+    } \
+    sylar::ByteArray::ptr ba(new sylar::ByteArray(base_len)); \
+    sylar::ByteArray::ptr ba2(new sylar::ByteArray(base_len)); \
+    for(auto& i : vec) { \
+        ba->write_fun(i); \
+    } \
+    ba2->writeFuint8(0); \
+    ba2->write_array(&vec[0], len / 2); \
+    ba2->write_array(&vec[len / 2], len - len / 2); \
+    SYLAR_ASSERT(ba2->getSize() == ba->getSize() + 1); \
+    ba->setPosition(0); \
+    ba2->setPosition(1); \
+    SYLAR_ASSERT(ba->toString() == ba2->toString()); \
+    std::vector<type> out(len); \
+    ba->read_array(&out[0], len); \
+    SYLAR_ASSERT(out == vec); \
+    SYLAR_ASSERT(ba->getReadSize() == 0); \
+    ba->setPosition(0); \
+    for(int i = 0; i < len; ++i) { \
+        SYLAR_ASSERT(ba->read_fun() == vec[i]); \
+    } \
+    bool thrown = false; \
+    try { \
+        ba2->read_array(&out[0], len + 1); \
+    } catch(std::out_of_range&) { \
+        thrown = true; \
+    } \
+    SYLAR_ASSERT(thrown); \
+    SYLAR_LOG_INFO(g_logger) << #write_array "/" #read_array \
+                    " (" #type " ) len=" << len \
+                    << " base_len=" << base_len \
+                    << " size=" << ba->getSize(); \
+}
+    for(int base_len : {3, 13, 4096}) {
+        XX(uint32_t, 10000, base_len, writeUint32, readUint32, writeUint32Array, readUint32Array);
+        XX(int32_t,  10000, base_len, writeInt32, readInt32, writeInt32Array, readInt32Array);
+        XX(uint64_t, 10000, base_len, writeUint64, readUint64, writeUint64Array, readUint64Array);
+        XX(int64_t,  10000, base_len, writeInt64, readInt64, writeInt64Array, readInt64Array);
+    }
+#undef XX
+}
+
+void test_bench() {
+    const int len = 1000000;
+    std::vector<uint32_t> small, large;
+    std::vector<uint64_t> large64;
+    for(int i = 0; i < len; ++i) {
+        small.push_back(rand() % 128);
+        large.push_back(rand() >> (rand() % 31));
+        large64.push_back(((uint64_t)rand() << 32 | rand()) >> (rand() % 63));
+    }
+    std::vector<uint32_t> out(len);
+    std::vector<uint64_t> out64(len);
+
+#define XX(name, write_expr, read_expr) {\
+    sylar::ByteArray::ptr ba(new sylar::ByteArray); \
+    uint64_t ts = sylar::GetCurrentUS(); \
+    for(int n = 0; n < 10; ++n) { \
+        ba->clear(); \
+        write_expr; \
+    } \
+    uint64_t t1 = sylar::GetCurrentUS(); \
+    for(int n = 0; n < 10; ++n) { \
+        ba->setPosition(0); \
+        read_expr; \
+    } \
+    uint64_t t2 = sylar::GetCurrentUS(); \
+    SYLAR_LOG_INFO(g_logger) << name << " size=" << ba->getSize() \
+        << " write=" << (t1 - ts) / 10000.0 << "ms" \
+        << " read=" << (t2 - t1) / 10000.0 << "ms"; \
+}
+    XX("writeFuint32/readFuint32", for(auto& i : large) { ba->writeFuint32(i);}
+            , for(int i = 0; i < len; ++i) { out[i] = ba->readFuint32();});
+    XX("writeFuint64/readFuint64", for(auto& i : large64) { ba->writeFuint64(i);}
+            , for(int i = 0; i < len; ++i) { out64[i] = ba->readFuint64();});
+    XX("writeUint32/readUint32 small", for(auto& i : small) { ba->writeUint32(i);}
+            , for(int i = 0; i < len; ++i) { out[i] = ba->readUint32();});
+    XX("writeUint32Array/readUint32Array small", ba->writeUint32Array(&small[0], len)
+            , ba->readUint32Array(&out[0], len));
+    XX("writeUint32/readUint32 large", for(auto& i : large) { ba->writeUint32(i);}
+            , for(int i = 0; i < len; ++i) { out[i] = ba->readUint32();});
+    XX("writeUint32Array/readUint32Array large", ba->writeUint32Array(&large[0], len)
+            , ba->readUint32Array(&out[0], len));
+    XX("writeUint64/readUint64 large", for(auto& i : large64) { ba->writeUint64(i);}
+            , for(int i = 0; i < len; ++i) { out64[i] = ba->readUint64();});
+    XX("writeUint64Array/readUint64Array large", ba->writeUint64Array(&large64[0], len)
+            , ba->readUint64Array(&out64[0], len));
+#undef XX
+    SYLAR_ASSERT(out == large);
+    SYLAR_ASSERT(out64 == large64);
+}
+
+//在已有数据中间批量写入, 不能改写写入范围之后的数据
+void test_array_overwrite() {
+#define XX(type, write_array, read_array) { \
+    std::vector<type> vec(16, 1); \
+    vec[0] = 300; \
+    sylar::ByteArray::ptr ba(new sylar::ByteArray(4096)); \
+    std::string data(64, (char)0xab); \
+    ba->write(&data[0], data.size()); \
+    ba->setPosition(8); \
+    ba->write_array(&vec[0], vec.size()); \
+    size_t end = ba->getPosition(); \
+    SYLAR_ASSERT(end == 8 + 17); \
+    SYLAR_ASSERT(ba->getSize() == data.size()); \
+    ba->setPosition(8); \
+    std::vector<type> out(vec.size()); \
+    ba->read_array(&out[0], out.size()); \
+    SYLAR_ASSERT(out == vec); \
+    std::string rest(data.size() - end, '\0'); \
+    ba->read(&rest[0], rest.size()); \
+    SYLAR_ASSERT(rest == data.substr(end)); \
+    SYLAR_LOG_INFO(g_logger) << #write_array " overwrite ok"; \
+}
+    XX(uint32_t, writeUint32Array, readUint32Array);
+    XX(uint64_t, writeUint64Array, readUint64Array);
+#undef XX
+}
+
 int main(int argc, char** argv) {
     test();
+    test_array();
+    test_array_overwrite();
+    test_bench();
     return 0;
 }
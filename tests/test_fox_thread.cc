@@ -0,0 +1,180 @@
+#include "sylar/db/fox_thread.h"
+#include "sylar/ds/mpsc_queue.h"
+#include "sylar/log.h"
+#include "sylar/macro.h"
+#include "sylar/util.h"
+#include <atomic>
+#include <iostream>
+#include <sstream>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+struct Node {
+    std::atomic<Node*> next;
+    int producer = 0;
+    int seq = 0;
+};
+
+//多个生产者并发入队, 单个消费者检查每个生产者的顺序
+void test_mpsc_queue() {
+    const int producers = 4;
+    const int count = 100000;
+    sylar::ds::MpscQueue<Node> queue;
+    std::vector<std::thread> threads;
+    for(int p = 0; p < producers; ++p) {
+        threads.push_back(std::thread([&queue, p]() {
+            for(int i = 0; i < count; i += 2) {
+                Node* a = new Node;
+                a->producer = p;
+                a->seq = i;
+                Node* b = new Node;
+                b->producer = p;
+                b->seq = i + 1;
+                if(i % 4) {
+                    queue.push(a);
+                    queue.push(b);
+                } else {
+                    a->next.store(b, std::memory_order_relaxed);
+                    queue.pushChain(a, b);
+                }
+            }
+        }));
+    }
+
+    std::vector<int> next(producers, 0);
+    int total = 0;
+    bool ordered = true;
+    while(total < producers * count) {
+        Node* n = queue.pop();
+        if(!n) {
+            continue;
+        }
+        if(n->seq != next[n->producer]) {
+            ordered = false;
+        }
+        next[n->producer] = n->seq + 1;
+        ++total;
+        delete n;
+    }
+    for(auto& i : threads) {
+        i.join();
+    }
+    SYLAR_ASSERT(ordered);
+    SYLAR_ASSERT(queue.pop() == nullptr);
+    SYLAR_ASSERT(queue.empty());
+    std::cout << "mpsc queue ok" << std::endl;
+}
+
+void test_fox_thread() {
+    sylar::FoxThread thr("test");
+    thr.start();
+
+    std::atomic<int> sum(0);
+    std::atomic<int> last(-1);
+    bool ordered = true;
+    for(int i = 0; i < 1000; ++i) {
+        thr.dispatch([&sum, &last, &ordered, i]() {
+            if(last.exchange(i) != i - 1) {
+                ordered = false;
+            }
+            sum += i;
+        });
+    }
+    std::vector<sylar::FoxThread::callback> cbs;
+    for(int i = 0; i < 1000; ++i) {
+        cbs.push_back([&sum]() {
+            sum += 1;
+        });
+    }
+    thr.batchDispatch(cbs);
+    thr.dispatch([]() {
+        throw std::logic_error("test exception");
+    });
+    thr.stop();
+    thr.join();
+    SYLAR_ASSERT(ordered);
+    SYLAR_ASSERT(sum == 999 * 1000 / 2 + 1000);
+    SYLAR_ASSERT(thr.getTotal() >= 2001);
+
+    sylar::FoxThreadPool pool(4, "pool");
+    pool.start();
+    std::atomic<int> count(0);
+    for(int i = 0; i < 1000; ++i) {
+        pool.dispatch([&count]() {
+            ++count;
+        });
+    }
+    pool.batchDispatch(cbs);
+    for(int i = 0; i < 100; ++i) {
+        std::atomic<int>* c = &count;
+        pool.dispatch(i, [c]() {
+            ++*c;
+        });
+    }
+    while(count < 1100 || sum < 999 * 1000 / 2 + 2000) {
+        usleep(100);
+    }
+    pool.stop();
+    pool.join();
+    SYLAR_ASSERT(count == 1100);
+    SYLAR_ASSERT(pool.getTotal() == 2100);
+    std::cout << "fox thread ok" << std::endl;
+}
+
+//每个生产者线程向同一个FoxThread投递count个任务
+void bench(int producers, int count, int batch) {
+    sylar::FoxThread thr("bench");
+    thr.start();
+    std::atomic<int> done(0);
+    uint64_t ts = sylar::GetCurrentUS();
+    std::vector<std::thread> threads;
+    for(int p = 0; p < producers; ++p) {
+        threads.push_back(std::thread([&thr, &done, count, batch]() {
+            if(batch <= 1) {
+                for(int i = 0; i < count; ++i) {
+                    thr.dispatch([&done]() {
+                        ++done;
+                    });
+                }
+                return;
+            }
+            std::vector<sylar::FoxThread::callback> cbs;
+            for(int i = 0; i < count; i += batch) {
+                cbs.clear();
+                for(int j = i; j < i + batch && j < count; ++j) {
+                    cbs.push_back([&done]() {
+                        ++done;
+                    });
+                }
+                thr.batchDispatch(cbs);
+            }
+        }));
+    }
+    for(auto& i : threads) {
+        i.join();
+    }
+    while(done < producers * count) {
+        usleep(100);
+    }
+    uint64_t used = sylar::GetCurrentUS() - ts;
+    thr.stop();
+    thr.join();
+    std::cout << "bench producers=" << producers << " batch=" << batch
+              << " tasks=" << producers * count
+              << " used=" << used / 1000.0 << "ms "
+              << (used ? producers * count * 1.0 / used : 0) << " M tasks/s"
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(sylar::LogLevel::FATAL);
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::FATAL);
+    int count = argc > 1 ? atoi(argv[1]) : 200000;
+    test_mpsc_queue();
+    test_fox_thread();
+    for(int producers : {1, 2, 4, 8}) {
+        bench(producers, count, 1);
+    }
+    bench(4, count, 64);
+    return 0;
+}
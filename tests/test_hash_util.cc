@@ -0,0 +1,156 @@
+#include "sylar/util/hash_util.h"
+#include "sylar/util.h"
+#include <iostream>
+#include <random>
+#include <stdexcept>
+
+namespace codec = sylar::codec;
+
+static std::string Random(std::mt19937& rng, size_t len) {
+    std::string rt(len, '\0');
+    for(auto& c : rt) {
+        c = rng();
+    }
+    return rt;
+}
+
+static bool HexThrows(const std::string& s) {
+    try {
+        sylar::data_from_hexstring(s);
+    } catch(std::invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+//已知结果 + 各指令集实现与标量实现对比
+void test_check() {
+    int fail = 0;
+    fail += sylar::base64encode("f") != "Zg==";
+    fail += sylar::base64encode("fo") != "Zm8=";
+    fail += sylar::base64encode("foobar") != "Zm9vYmFy";
+    fail += sylar::base64decode("Zm9vYg==") != "foob";
+    fail += sylar::crc32c("123456789", 9) != 0xe3069283;
+    fail += sylar::xxhash32("", 0) != 0x02cc5d05;
+    fail += sylar::xxhash32("abc", 3) != 0x32d153ff;
+    fail += sylar::xxhash64("", 0) != 0xef46db3751d8e999ULL;
+    fail += sylar::xxhash64("abc", 3) != 0x44bc2cf5ad770999ULL;
+    std::cout << "check known" << (fail ? " FAIL" : " ok") << std::endl;
+
+    std::mt19937 rng(1);
+    std::vector<std::string> datas;
+    for(size_t len = 0; len < 300; ++len) {
+        datas.push_back(Random(rng, len));
+    }
+    datas.push_back(Random(rng, 100000));
+
+    codec::SetLevel(codec::SCALAR);
+    std::vector<std::string> b64, hex;
+    std::vector<uint32_t> crcs;
+    for(auto& d : datas) {
+        b64.push_back(sylar::base64encode(d));
+        hex.push_back(sylar::hexstring_from_data(d));
+        crcs.push_back(sylar::crc32c(d.c_str(), d.size()));
+    }
+    for(int level = codec::SCALAR; level <= codec::GetMaxLevel(); ++level) {
+        codec::SetLevel((codec::Level)level);
+        for(size_t i = 0; i < datas.size(); ++i) {
+            auto& d = datas[i];
+            fail += sylar::base64encode(d) != b64[i];
+            fail += sylar::base64decode(b64[i]) != d;
+            fail += sylar::hexstring_from_data(d) != hex[i];
+            fail += sylar::data_from_hexstring(hex[i]) != d;
+            fail += sylar::crc32c(d.c_str(), d.size()) != crcs[i];
+            //分段计算结果一致
+            size_t half = d.size() / 3;
+            fail += sylar::crc32c(d.c_str() + half, d.size() - half
+                    ,sylar::crc32c(d.c_str(), half)) != crcs[i];
+
+            std::string upper = hex[i];
+            for(auto& c : upper) {
+                c = toupper(c);
+            }
+            fail += sylar::data_from_hexstring(upper) != d;
+
+            //任意位置的非法字符都必须被拒绝
+            if(!d.empty()) {
+                std::string bad = b64[i];
+                size_t pos = rng() % bad.size();
+                const char invalid[] = "!-_*\n =\x80\xff";
+                bad[pos] = invalid[rng() % (sizeof(invalid) - 1)];
+                if(bad[pos] == '=' && pos + 2 >= bad.size()) {
+                    bad[pos] = '-';
+                }
+                fail += !sylar::base64decode(bad).empty();
+
+                bad = hex[i];
+                bad[rng() % bad.size()] = "gG/:@`\x80 "[rng() % 8];
+                fail += !HexThrows(bad);
+            }
+        }
+        //256个字节值在向量块中每个位置上的校验
+        std::string block = b64.back().substr(0, 4000);
+        for(int c = 0; c < 256; ++c) {
+            size_t pos = (c * 37) % 64;
+            std::string bad = block;
+            bad[pos] = (char)c;
+            bool valid = isalnum(c) || c == '+' || c == '/';
+            fail += sylar::base64decode(bad).empty() == valid;
+        }
+        std::cout << "check " << codec::GetLevelName((codec::Level)level)
+                  << (fail ? " FAIL" : " ok") << std::endl;
+    }
+    codec::SetLevel(codec::GetMaxLevel());
+}
+
+#define BENCH(name, bytes, n, expr) { \
+    uint64_t ts = sylar::GetCurrentUS(); \
+    for(int i = 0; i < n; ++i) { \
+        expr; \
+    } \
+    uint64_t used = sylar::GetCurrentUS() - ts; \
+    std::cout << "    " << name << ": " << (double)(bytes) * n / (used ? used : 1) << "MB/s" << std::endl; \
+}
+
+void test_bench() {
+    std::mt19937 rng(1);
+    const size_t size = 1 << 20;
+    std::string data = Random(rng, size);
+    std::string b64 = sylar::base64encode(data);
+    std::string hex = sylar::hexstring_from_data(data);
+    std::string out(size * 2, '\0');
+    std::string key = Random(rng, 20);
+    uint64_t sum = 0;
+
+    std::cout << "bench size=" << size << std::endl;
+    for(int level = codec::SCALAR; level <= codec::GetMaxLevel(); ++level) {
+        codec::SetLevel((codec::Level)level);
+        std::cout << "  " << codec::GetLevelName((codec::Level)level) << std::endl;
+        BENCH("base64encode", size, 200, sum += sylar::base64encode(data.c_str(), size, &out[0]));
+        BENCH("base64decode", b64.size(), 200, sum += sylar::base64decode(b64.c_str(), b64.size(), &out[0]));
+        BENCH("hexencode", size, 200, sylar::hexstring_from_data(data.c_str(), size, &out[0]));
+        BENCH("hexdecode", hex.size(), 200, sylar::data_from_hexstring(hex.c_str(), hex.size(), &out[0]));
+        BENCH("crc32c", size, 200, sum += sylar::crc32c(data.c_str(), size));
+        //ws握手: sha1 20字节 -> base64
+        BENCH("base64encode(20) string", 20, 1000000, sum += sylar::base64encode(key).size());
+        BENCH("base64encode(20) buffer", 20, 1000000, {
+            char buf[28];
+            sum += sylar::base64encode(key.c_str(), key.size(), buf);
+        });
+    }
+    std::cout << "  hash" << std::endl;
+    BENCH("murmur3_hash", size, 200, sum += sylar::murmur3_hash((const void*)data.c_str(), size));
+    BENCH("murmur3_hash64", size, 200, sum += sylar::murmur3_hash64((const void*)data.c_str(), size));
+    BENCH("xxhash32", size, 200, sum += sylar::xxhash32(data.c_str(), size));
+    BENCH("xxhash64", size, 200, sum += sylar::xxhash64(data.c_str(), size));
+    BENCH("murmur3_hash(16)", 16, 10000000, sum += sylar::murmur3_hash((const void*)key.c_str(), 16));
+    BENCH("xxhash64(16)", 16, 10000000, sum += sylar::xxhash64(key.c_str(), 16));
+    BENCH("crc32c(16)", 16, 10000000, sum += sylar::crc32c(key.c_str(), 16));
+    std::cout << "sum=" << sum << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_check();
+    test_bench();
+    return 0;
+}
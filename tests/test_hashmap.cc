@@ -1,5 +1,6 @@
 #include "sylar/sylar.h"
 #include "sylar/ds/hash_map.h"
+#include "sylar/ds/flat_hash_map.h"
 
 static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
 
@@ -42,7 +43,136 @@ void test() {
     }
 }
 
+template<class Map>
+void bench_map(const std::string& name, Map& m, const std::vector<int>& keys) {
+    uint64_t ts = sylar::GetCurrentUS();
+    for(size_t i = 0; i < keys.size(); ++i) {
+        m.set(keys[i], PidVid(i, i));
+    }
+    uint64_t set_used = sylar::GetCurrentUS() - ts;
+
+    PidVid v;
+    size_t hit = 0;
+    ts = sylar::GetCurrentUS();
+    for(size_t i = 0; i < keys.size(); ++i) {
+        hit += m.get(keys[(i * 7919) % keys.size()], v);
+    }
+    uint64_t get_used = sylar::GetCurrentUS() - ts;
+
+    size_t miss = 0;
+    ts = sylar::GetCurrentUS();
+    for(size_t i = 0; i < keys.size(); ++i) {
+        miss += !m.exists(-keys[i] - 1);
+    }
+    uint64_t miss_used = sylar::GetCurrentUS() - ts;
+
+    ts = sylar::GetCurrentUS();
+    for(size_t i = 0; i < keys.size(); i += 2) {
+        m.del(keys[i]);
+    }
+    uint64_t del_used = sylar::GetCurrentUS() - ts;
+
+    SYLAR_LOG_INFO(g_logger) << name << " n=" << keys.size()
+        << " total=" << m.getTotal()
+        << " set=" << set_used / 1000.0 << "ms"
+        << " get=" << get_used / 1000.0 << "ms"
+        << " miss=" << miss_used / 1000.0 << "ms"
+        << " del=" << del_used / 1000.0 << "ms"
+        << " hit=" << hit << " missed=" << miss;
+}
+
+template<class Map>
+void bench_threads(const std::string& name, Map& m, const std::vector<int>& keys, int threads) {
+    std::vector<sylar::Thread::ptr> thrs;
+    uint64_t ts = sylar::GetCurrentUS();
+    for(int t = 0; t < threads; ++t) {
+        thrs.push_back(std::make_shared<sylar::Thread>([&m, &keys, t, threads](){
+            PidVid v;
+            for(size_t i = 0; i < keys.size(); ++i) {
+                size_t idx = (i * 7919 + t) % keys.size();
+                if(i % 10 == 0) {
+                    m.set(keys[idx], PidVid(i, t));
+                } else {
+                    m.get(keys[idx], v);
+                }
+            }
+        }, name + "_" + std::to_string(t)));
+    }
+    for(auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = sylar::GetCurrentUS() - ts;
+    SYLAR_LOG_INFO(g_logger) << name << " threads=" << threads
+        << " ops=" << keys.size() * threads
+        << " used=" << used / 1000.0 << "ms"
+        << " qps=" << (uint64_t)(keys.size() * threads * 1000000.0 / (used ? used : 1));
+}
+
+void test_flat() {
+    sylar::ds::FlatHashMap<std::string, int> m;
+    std::map<std::string, int> ref;
+    int diff = 0;
+    for(int i = 0; i < 200000; ++i) {
+        std::string k = std::to_string(rand() % 20000);
+        int op = rand() % 4;
+        if(op < 2) {
+            diff += (m.set(k, i) != !ref.count(k));
+            ref[k] = i;
+        } else if(op == 2) {
+            diff += (m.del(k) != (ref.erase(k) > 0));
+        } else {
+            int v = -1;
+            bool r = m.get(k, v);
+            auto it = ref.find(k);
+            diff += (r != (it != ref.end())) || (r && v != it->second);
+        }
+    }
+    size_t count = 0;
+    m.rforeach([&count](const std::string& k, const int& v) {
+        ++count;
+        return true;
+    });
+    SYLAR_LOG_INFO(g_logger) << "test_flat diff=" << diff
+        << " total=" << m.getTotal() << "/" << ref.size() << " foreach=" << count
+        << ((diff == 0 && count == ref.size() && m.getTotal() == ref.size()) ? " ok" : " FAIL");
+}
+
+void bench() {
+    std::vector<int> keys;
+    for(int i = 0; i < 2000000; ++i) {
+        keys.push_back(rand());
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    std::random_shuffle(keys.begin(), keys.end());
+    {
+        sylar::ds::HashMap<int, PidVid> m;
+        bench_map("HashMap", m, keys);
+    }
+    {
+        sylar::ds::FlatHashMap<int, PidVid> m;
+        bench_map("FlatHashMap", m, keys);
+    }
+    {
+        sylar::ds::ConcurrentFlatHashMap<int, PidVid> m;
+        bench_map("ConcurrentFlatHashMap", m, keys);
+    }
+    {
+        sylar::ds::HashMap<int, PidVid> m;
+        bench_threads("HashMap", m, keys, 4);
+    }
+    {
+        sylar::ds::ConcurrentFlatHashMap<int, PidVid> m;
+        bench_threads("ConcurrentFlatHashMap", m, keys, 4);
+    }
+}
+
 int main(int argc, char** argv) {
+    test_flat();
+    if(argc > 1 && std::string(argv[1]) == "bench") {
+        bench();
+        return 0;
+    }
     gen();
     test();
     return 0;
@@ -1,6 +1,7 @@
 #include "sylar/hook.h"
 #include "sylar/log.h"
 #include "sylar/iomanager.h"
+#include "sylar/macro.h"
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
@@ -63,7 +64,55 @@ void test_sock() {
     SYLAR_LOG_INFO(g_logger) << buff;
 }
 
+//fd关闭后编号被新socket复用, 阻塞在旧fd上的协程不能读到新连接上去
+void test_fd_reuse() {
+    sylar::IOManager iom(1);
+    iom.schedule([](){
+        int lsock = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        SYLAR_ASSERT(!bind(lsock, (const sockaddr*)&addr, sizeof(addr)));
+        SYLAR_ASSERT(!listen(lsock, 8));
+        SYLAR_ASSERT(!getsockname(lsock, (sockaddr*)&addr, &len));
+
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        SYLAR_ASSERT(!connect(sock, (const sockaddr*)&addr, sizeof(addr)));
+        int peer = accept(lsock, nullptr, nullptr);
+
+        int rt = 0;
+        int err = 0;
+        sylar::IOManager::GetThis()->schedule([sock, &rt, &err](){
+            char c = 0;
+            rt = recv(sock, &c, 1, 0);
+            err = errno;
+        });
+        usleep(10 * 1000);
+
+        //close唤醒读协程, 它恢复执行时fd已经是新的socket
+        close(sock);
+        int sock2 = socket(AF_INET, SOCK_STREAM, 0);
+        SYLAR_ASSERT(sock2 == sock);
+        SYLAR_ASSERT(!connect(sock2, (const sockaddr*)&addr, sizeof(addr)));
+        int peer2 = accept(lsock, nullptr, nullptr);
+        SYLAR_ASSERT(send(peer2, "x", 1, 0) == 1);
+        usleep(10 * 1000);
+        SYLAR_ASSERT(rt == -1 && err == EBADF);
+
+        char c = 0;
+        SYLAR_ASSERT(recv(sock2, &c, 1, 0) == 1 && c == 'x');
+        close(sock2);
+        close(peer2);
+        close(peer);
+        close(lsock);
+        SYLAR_LOG_INFO(g_logger) << "test_fd_reuse ok";
+    });
+}
+
 int main(int argc, char** argv) {
+    test_fd_reuse();
     //test_sleep();
     sylar::IOManager iom;
     iom.schedule(test_sock);
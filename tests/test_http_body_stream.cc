@@ -0,0 +1,203 @@
+#include "sylar/http/http_body_stream.h"
+#include "sylar/http/http_server.h"
+#include "sylar/config.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include "sylar/macro.h"
+#include <atomic>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const char* s_request_body =
+    "5\r\nhello\r\n"
+    "1;ext=1\r\n \r\n"
+    "10\r\n0123456789abcdef\r\n"
+    "0\r\n"
+    "X-Trailer: 1\r\n"
+    "\r\n"
+    "NEXT";
+
+static std::string body_of(const std::string& data) {
+    size_t pos = data.find("\r\n\r\n");
+    return pos == std::string::npos ? "" : data.substr(pos + 4);
+}
+
+void test_body_stream() {
+    auto addr = sylar::Address::LookupAnyIPAddress("127.0.0.1:0");
+    sylar::Socket::ptr server = sylar::Socket::CreateTCP(addr);
+    server->bind(addr);
+    server->listen();
+    auto local = server->getLocalAddress();
+
+    std::string rsp_data;
+    bool done = false;
+    sylar::IOManager::GetThis()->schedule([local, &rsp_data, &done](){
+        sylar::Socket::ptr client = sylar::Socket::CreateTCP(local);
+        client->connect(local);
+        //逐字节发送, 覆盖chunk头被拆开的情况
+        for(const char* p = s_request_body; *p; ++p) {
+            client->send(p, 1);
+        }
+        char buf[1024];
+        int rt = 0;
+        while((rt = client->recv(buf, sizeof(buf))) > 0) {
+            rsp_data.append(buf, rt);
+        }
+        done = true;
+    });
+
+    sylar::Socket::ptr sock = server->accept();
+    sylar::http::HttpSession::ptr session(new sylar::http::HttpSession(sock));
+    sylar::http::HttpBodyStream::ptr body(
+            new sylar::http::HttpBodyStream(session.get(), 0, true));
+    std::string data;
+    char buf[7];
+    int rt = 0;
+    while((rt = body->read(buf, sizeof(buf))) > 0) {
+        data.append(buf, rt);
+    }
+    std::string next(4, '\0');
+    session->readFixSize(&next[0], next.size());
+    SYLAR_ASSERT(data == "hello 0123456789abcdef");
+    SYLAR_ASSERT(body->isFinished());
+    SYLAR_ASSERT(body->getReadSize() == data.size());
+    SYLAR_ASSERT(next == "NEXT");
+
+    sylar::http::HttpResponse::ptr rsp(new sylar::http::HttpResponse);
+    rsp->setBody("first");
+    auto writer = sylar::http::HttpChunkedWriter::Create(session.get(), rsp);
+    for(int i = 0; i < 3; ++i) {
+        std::string chunk = "chunk_" + std::to_string(i);
+        writer->write(chunk.c_str(), chunk.size());
+    }
+    writer->write("0123456789abcdef0", 17);
+    rsp->getBodyWriter()->close();
+    session->close();
+    while(!done) {
+        usleep(1000);
+    }
+
+    std::string head = rsp_data.substr(0, rsp_data.find("\r\n\r\n") + 4);
+    SYLAR_ASSERT(head.compare(0, 17, "HTTP/1.1 200 OK\r\n") == 0);
+    SYLAR_ASSERT(head.find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+    SYLAR_ASSERT(head.find("ontent-length") == std::string::npos);
+    SYLAR_ASSERT(body_of(rsp_data) ==
+            "5\r\nfirst\r\n"
+            "7\r\nchunk_0\r\n"
+            "7\r\nchunk_1\r\n"
+            "7\r\nchunk_2\r\n"
+            "11\r\n0123456789abcdef0\r\n"
+            "0\r\n\r\n");
+    std::cout << "body stream ok" << std::endl;
+}
+
+/**
+ * @brief 重写了handle的分发器, HttpServer必须经过它处理请求
+ */
+class TagDispatch : public sylar::http::ServletDispatch {
+public:
+    virtual int32_t handle(sylar::http::HttpRequest::ptr request
+                   , sylar::http::HttpResponse::ptr response
+                   , sylar::http::HttpSession::ptr session) override {
+        response->setHeader("X-Dispatch", "tag");
+        return ServletDispatch::handle(request, response, session);
+    }
+};
+
+/**
+ * @brief 统计路由匹配次数(每次匹配调用一次get)
+ */
+class CountingCreator : public sylar::http::IServletCreator {
+public:
+    CountingCreator(sylar::http::Servlet::ptr slt)
+        :m_servlet(slt) {
+    }
+    sylar::http::Servlet::ptr get() const override {
+        ++m_count;
+        return m_servlet;
+    }
+    std::string getName() const override {
+        return m_servlet->getName();
+    }
+    int getCount() const { return m_count;}
+private:
+    sylar::http::Servlet::ptr m_servlet;
+    mutable std::atomic<int> m_count{0};
+};
+
+static std::string round_trip(sylar::Address::ptr addr, const std::string& req) {
+    sylar::Socket::ptr client = sylar::Socket::CreateTCP(addr);
+    client->connect(addr);
+    client->send(req.c_str(), req.size());
+    std::string rsp;
+    char buf[1024];
+    int rt = 0;
+    while((rt = client->recv(buf, sizeof(buf))) > 0) {
+        rsp.append(buf, rt);
+    }
+    return rsp;
+}
+
+void test_server() {
+    sylar::http::HttpServer::ptr server(new sylar::http::HttpServer);
+    server->setServletDispatch(std::make_shared<TagDispatch>());
+    server->getServletDispatch()->addServlet("/echo", [](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        rsp->setBody("echo:" + req->getBody());
+        return 0;
+    });
+    auto counting = std::make_shared<CountingCreator>(std::make_shared<sylar::http::FunctionServlet>(
+                [](sylar::http::HttpRequest::ptr req
+                , sylar::http::HttpResponse::ptr rsp
+                , sylar::http::HttpSession::ptr session) {
+        rsp->setBody("count");
+        return 0;
+    }));
+    server->getServletDispatch()->addServletCreator("/count", counting);
+    auto addr = sylar::Address::LookupAnyIPAddress("127.0.0.1:0");
+    SYLAR_ASSERT(server->bind(addr));
+    server->start();
+    auto local = server->getSocks()[0]->getLocalAddress();
+
+    std::string rsp = round_trip(local, "POST /echo HTTP/1.1\r\nContent-Length: 4\r\n"
+            "Connection: close\r\n\r\nabcd");
+    SYLAR_ASSERT(rsp.compare(0, 17, "HTTP/1.1 200 OK\r\n") == 0);
+    SYLAR_ASSERT(rsp.find("X-Dispatch: tag\r\n") != std::string::npos);
+    SYLAR_ASSERT(body_of(rsp) == "echo:abcd");
+
+    //每个请求只匹配一次路由表, 重写的handle仍然生效
+    rsp = round_trip(local, "GET /count HTTP/1.1\r\nConnection: close\r\n\r\n");
+    SYLAR_ASSERT(body_of(rsp) == "count");
+    SYLAR_ASSERT(rsp.find("X-Dispatch: tag\r\n") != std::string::npos);
+    SYLAR_ASSERT(counting->getCount() == 1);
+
+    auto max_body = sylar::Config::Lookup<uint64_t>("http.request.max_body_size");
+    uint64_t old = max_body->getValue();
+    max_body->setValue(16);
+    rsp = round_trip(local, "POST /echo HTTP/1.1\r\nContent-Length: 17\r\n\r\n"
+            "0123456789abcdefg");
+    SYLAR_ASSERT(rsp.compare(0, 12, "HTTP/1.1 413") == 0);
+    SYLAR_ASSERT(rsp.find("connection: close\r\n") != std::string::npos);
+    rsp = round_trip(local, "POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+            "10\r\n0123456789abcdef\r\n1\r\ng\r\n0\r\n\r\n");
+    SYLAR_ASSERT(rsp.compare(0, 12, "HTTP/1.1 413") == 0);
+    max_body->setValue(old);
+    server->stop();
+    std::cout << "server ok" << std::endl;
+}
+
+void run() {
+    test_body_stream();
+    test_server();
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(sylar::LogLevel::WARN);
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::FATAL);
+    {
+        sylar::IOManager iom(1);
+        iom.schedule(run);
+    }
+    return 0;
+}
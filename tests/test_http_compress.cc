@@ -0,0 +1,231 @@
+#include "sylar/http/http_compress.h"
+#include "sylar/config.h"
+#include "sylar/log.h"
+#include "sylar/macro.h"
+#include <zlib.h>
+#include <iostream>
+
+using sylar::http::HttpCompressor;
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::string Inflate(const std::string& data, int window_bits) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    SYLAR_ASSERT(inflateInit2(&zs, window_bits) == Z_OK);
+    std::string out;
+    char buf[4096];
+    zs.next_in = (Bytef*)data.c_str();
+    zs.avail_in = data.size();
+    int rt = Z_OK;
+    while(rt == Z_OK) {
+        zs.next_out = (Bytef*)buf;
+        zs.avail_out = sizeof(buf);
+        rt = inflate(&zs, Z_NO_FLUSH);
+        out.append(buf, sizeof(buf) - zs.avail_out);
+    }
+    inflateEnd(&zs);
+    return rt == Z_STREAM_END ? out : "<error>";
+}
+
+static std::string MakeBody(size_t size, int seed = 0) {
+    std::string body;
+    while(body.size() < size) {
+        body += "{\"id\":" + std::to_string(seed + body.size()) + ",\"name\":\"sylar\"},";
+    }
+    body.resize(size);
+    return body;
+}
+
+static sylar::http::HttpResponse::ptr MakeResponse(sylar::http::HttpRequest::ptr req
+                                ,const std::string& body, const std::string& type = "application/json") {
+    auto rsp = req->createResponse();
+    rsp->setHeader("Content-Type", type);
+    rsp->setBody(body);
+    return rsp;
+}
+
+void test_negotiate() {
+    struct Case {
+        const char* accept;
+        HttpCompressor::Encoding expect;
+    } cases[] = {
+        {"", HttpCompressor::IDENTITY},
+        {"gzip", HttpCompressor::GZIP},
+        {"deflate", HttpCompressor::DEFLATE},
+        {"gzip, deflate, br", HttpCompressor::GZIP},
+        {"deflate, gzip", HttpCompressor::GZIP},
+        {"gzip;q=0.5, deflate;q=0.8", HttpCompressor::DEFLATE},
+        {"gzip; q=0.8, deflate; q=0.5", HttpCompressor::GZIP},
+        {"gzip;q=0, deflate", HttpCompressor::DEFLATE},
+        {"gzip;q=0, deflate;q=0", HttpCompressor::IDENTITY},
+        {"identity;q=0", HttpCompressor::IDENTITY},
+        {"identity;q=0, deflate", HttpCompressor::DEFLATE},
+        {"identity", HttpCompressor::IDENTITY},
+        {"br", HttpCompressor::IDENTITY},
+        {"*", HttpCompressor::GZIP},
+        {"*;q=0", HttpCompressor::IDENTITY},
+        {"gzip;q=0, *", HttpCompressor::DEFLATE},
+        {"*;q=0, deflate", HttpCompressor::DEFLATE},
+        {"X-GZIP", HttpCompressor::GZIP},
+    };
+    for(auto& c : cases) {
+        auto e = HttpCompressor::Negotiate(c.accept);
+        if(e != c.expect) {
+            SYLAR_LOG_ERROR(g_logger) << "accept=" << c.accept
+                << " got=" << HttpCompressor::EncodingToString(e)
+                << " expect=" << HttpCompressor::EncodingToString(c.expect);
+        }
+        SYLAR_ASSERT(e == c.expect);
+    }
+    std::cout << "negotiate ok" << std::endl;
+}
+
+void test_roundtrip() {
+    std::string body = MakeBody(100 * 1024);
+    for(auto e : {HttpCompressor::GZIP, HttpCompressor::DEFLATE}) {
+        for(int level : {1, 6, 9}) {
+            std::string out;
+            SYLAR_ASSERT(HttpCompressor::Compress(e, body.c_str(), body.size(), out, level));
+            SYLAR_ASSERT(out.size() < body.size());
+            //gzip: 15 + 16, deflate(zlib格式): 15
+            SYLAR_ASSERT(Inflate(out, e == HttpCompressor::GZIP ? 15 + 16 : 15) == body);
+        }
+    }
+    std::string out;
+    SYLAR_ASSERT(!HttpCompressor::Compress(HttpCompressor::IDENTITY, body.c_str(), body.size(), out, 6));
+    std::cout << "roundtrip ok" << std::endl;
+}
+
+void test_response() {
+    sylar::http::HttpRequest::ptr req(new sylar::http::HttpRequest);
+    req->setPath("/data");
+    req->setHeader("Accept-Encoding", "gzip, deflate");
+    std::string body = MakeBody(8 * 1024);
+
+    auto rsp = MakeResponse(req, body);
+    SYLAR_ASSERT(HttpCompressor::CompressResponse(req, rsp));
+    SYLAR_ASSERT(rsp->getHeader("Content-Encoding") == "gzip");
+    SYLAR_ASSERT(rsp->getHeader("Vary") == "Accept-Encoding");
+    SYLAR_ASSERT(Inflate(rsp->getBody(), 15 + 16) == body);
+
+    //小于min_size
+    rsp = MakeResponse(req, MakeBody(100));
+    SYLAR_ASSERT(!HttpCompressor::CompressResponse(req, rsp));
+    SYLAR_ASSERT(rsp->getHeader("Content-Encoding").empty());
+
+    //不可压缩的Content-Type
+    rsp = MakeResponse(req, body, "image/png");
+    SYLAR_ASSERT(!HttpCompressor::CompressResponse(req, rsp));
+    SYLAR_ASSERT(rsp->getBody() == body);
+    rsp = MakeResponse(req, body, "");
+    SYLAR_ASSERT(!HttpCompressor::CompressResponse(req, rsp));
+    rsp = MakeResponse(req, body, "text/html; charset=utf-8");
+    SYLAR_ASSERT(HttpCompressor::CompressResponse(req, rsp));
+
+    //已经编码过
+    rsp = MakeResponse(req, body);
+    rsp->setHeader("Content-Encoding", "br");
+    SYLAR_ASSERT(!HttpCompressor::CompressResponse(req, rsp));
+    SYLAR_ASSERT(rsp->getHeader("Content-Encoding") == "br" && rsp->getBody() == body);
+
+    //Vary追加, 不覆盖servlet设置的值
+    rsp = MakeResponse(req, body);
+    rsp->setHeader("Vary", "Origin");
+    SYLAR_ASSERT(HttpCompressor::CompressResponse(req, rsp));
+    SYLAR_ASSERT(rsp->getHeader("Vary") == "Origin, Accept-Encoding");
+    rsp = MakeResponse(req, body);
+    rsp->setHeader("Vary", "accept-encoding, Origin");
+    SYLAR_ASSERT(HttpCompressor::CompressResponse(req, rsp));
+    SYLAR_ASSERT(rsp->getHeader("Vary") == "accept-encoding, Origin");
+
+    //不接受压缩时不压缩, 但仍需Vary
+    sylar::http::HttpRequest::ptr req2(new sylar::http::HttpRequest);
+    req2->setPath("/data");
+    req2->setHeader("Accept-Encoding", "identity");
+    rsp = MakeResponse(req2, body);
+    SYLAR_ASSERT(!HttpCompressor::CompressResponse(req2, rsp));
+    SYLAR_ASSERT(rsp->getHeader("Vary") == "Accept-Encoding" && rsp->getBody() == body);
+    std::cout << "response ok" << std::endl;
+}
+
+void test_cache() {
+    auto status = HttpCompressor::GetStatus();
+    sylar::http::HttpRequest::ptr req(new sylar::http::HttpRequest);
+    req->setHeader("Accept-Encoding", "gzip");
+    std::string body = MakeBody(64 * 1024);
+
+    int64_t hit = status->getCacheHit();
+    int64_t miss = status->getCacheMiss();
+    for(int i = 0; i < 3; ++i) {
+        req->setPath("/cache");
+        auto rsp = MakeResponse(req, body);
+        rsp->setCompressCacheable(true);
+        SYLAR_ASSERT(HttpCompressor::CompressResponse(req, rsp));
+        SYLAR_ASSERT(Inflate(rsp->getBody(), 15 + 16) == body);
+    }
+    SYLAR_ASSERT(status->getCacheMiss() == miss + 1);
+    SYLAR_ASSERT(status->getCacheHit() == hit + 2);
+
+    //内容变化时不命中
+    auto rsp = MakeResponse(req, MakeBody(64 * 1024, 1));
+    rsp->setCompressCacheable(true);
+    SYLAR_ASSERT(HttpCompressor::CompressResponse(req, rsp));
+    SYLAR_ASSERT(status->getCacheMiss() == miss + 2);
+
+    //按字节数淘汰, 总字节数不超过上限
+    uint64_t max_bytes = 256 * 1024;
+    sylar::Config::Lookup<uint64_t>("http.compress.cache_bytes")->setValue(max_bytes);
+    for(int i = 0; i < 200; ++i) {
+        req->setPath("/evict/" + std::to_string(i));
+        rsp = MakeResponse(req, MakeBody(64 * 1024, i));
+        rsp->setCompressCacheable(true);
+        SYLAR_ASSERT(HttpCompressor::CompressResponse(req, rsp));
+    }
+    size_t size = 0;
+    uint64_t bytes = 0;
+    HttpCompressor::GetCacheInfo(size, bytes);
+    SYLAR_ASSERT(size > 0 && size < 200 && bytes <= max_bytes);
+
+    //最早的已被淘汰, 最近的仍命中
+    miss = status->getCacheMiss();
+    hit = status->getCacheHit();
+    req->setPath("/evict/199");
+    rsp = MakeResponse(req, MakeBody(64 * 1024, 199));
+    rsp->setCompressCacheable(true);
+    SYLAR_ASSERT(HttpCompressor::CompressResponse(req, rsp));
+    SYLAR_ASSERT(status->getCacheHit() == hit + 1);
+    req->setPath("/evict/0");
+    rsp = MakeResponse(req, MakeBody(64 * 1024, 0));
+    rsp->setCompressCacheable(true);
+    SYLAR_ASSERT(HttpCompressor::CompressResponse(req, rsp));
+    SYLAR_ASSERT(status->getCacheMiss() == miss + 1);
+
+    //条目数上限
+    sylar::Config::Lookup<uint64_t>("http.compress.cache_size")->setValue(16);
+    sylar::Config::Lookup<uint64_t>("http.compress.cache_bytes")->setValue(64 * 1024 * 1024);
+    for(int i = 0; i < 200; ++i) {
+        req->setPath("/count/" + std::to_string(i));
+        rsp = MakeResponse(req, MakeBody(2048, i));
+        rsp->setCompressCacheable(true);
+        SYLAR_ASSERT(HttpCompressor::CompressResponse(req, rsp));
+    }
+    hit = status->getCacheHit();
+    rsp = MakeResponse(req, MakeBody(2048, 199));
+    rsp->setCompressCacheable(true);
+    SYLAR_ASSERT(HttpCompressor::CompressResponse(req, rsp));
+    SYLAR_ASSERT(status->getCacheHit() == hit + 1);
+    HttpCompressor::GetCacheInfo(size, bytes);
+    SYLAR_ASSERT(size <= 16);
+    std::cout << HttpCompressor::StatusString() << std::endl;
+    std::cout << "cache ok" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    sylar::Config::Lookup<bool>("http.compress.enable")->setValue(true);
+    test_negotiate();
+    test_roundtrip();
+    test_response();
+    test_cache();
+    return 0;
+}
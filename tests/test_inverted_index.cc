@@ -0,0 +1,239 @@
+#include "sylar/ds/inverted_index.h"
+#include "sylar/util.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include <iostream>
+#include <random>
+#include <set>
+#include <map>
+
+using sylar::ds::IndexQuery;
+using sylar::ds::InvertedIndex;
+using sylar::ds::RoaringBitmap;
+
+static IndexQuery::ptr T(const std::string& t) {
+    return IndexQuery::Term(t);
+}
+
+static std::set<uint32_t> ToSet(RoaringBitmap::ptr b) {
+    std::set<uint32_t> rt;
+    b->foreach([&rt](uint32_t v) {
+        rt.insert(v);
+        return true;
+    });
+    return rt;
+}
+
+//与暴力计算的结果对比, 覆盖增量/合并/快照各阶段
+void test_check() {
+    const uint32_t docs = 5000;
+    const int terms = 20;
+    std::mt19937 rng(1);
+    InvertedIndex index;
+    std::map<uint32_t, std::set<std::string> > truth;
+
+    auto check = [&](InvertedIndex& index, const std::string& stage) {
+        int fail = 0;
+        for(int n = 0; n < 50; ++n) {
+            std::string a = "t" + std::to_string(rng() % terms);
+            std::string b = "t" + std::to_string(rng() % terms);
+            std::string c = "t" + std::to_string(rng() % terms);
+            //a AND (b OR NOT c)
+            auto q = IndexQuery::And({T(a), IndexQuery::Or({T(b), IndexQuery::Not(T(c))})});
+            std::set<uint32_t> expect;
+            std::set<uint32_t> expect_and;
+            for(auto& i : truth) {
+                bool ha = i.second.count(a), hb = i.second.count(b), hc = i.second.count(c);
+                if(ha && (hb || !hc)) {
+                    expect.insert(i.first);
+                }
+                if(ha && hb) {
+                    expect_and.insert(i.first);
+                }
+            }
+            fail += ToSet(index.query(q)) != expect;
+            fail += index.count(IndexQuery::And({T(a), T(b)})) != expect_and.size();
+        }
+        fail += index.getDocCount() != truth.size();
+        std::cout << "check " << stage << ": " << index.toString()
+                  << (fail ? " FAIL" : " ok") << std::endl;
+    };
+
+    auto mutate = [&](InvertedIndex& index, int n) {
+        for(int i = 0; i < n; ++i) {
+            uint32_t doc = rng() % docs;
+            std::string t = "t" + std::to_string(rng() % terms);
+            int op = rng() % 10;
+            if(op < 7) {
+                index.add(t, doc);
+                truth[doc].insert(t);
+            } else if(op < 9) {
+                index.del(t, doc);
+                auto it = truth.find(doc);
+                if(it != truth.end()) {
+                    it->second.erase(t);
+                }
+            } else {
+                index.delDoc(doc);
+                truth.erase(doc);
+            }
+        }
+    };
+
+    mutate(index, 30000);
+    check(index, "delta");
+    index.merge();
+    check(index, "merged");
+    mutate(index, 5000);
+    check(index, "base+delta");
+    index.writeTo("./inverted_index.dat");
+    InvertedIndex loaded;
+    bool ok = loaded.load("./inverted_index.dat");
+    check(loaded, "snapshot");
+    std::cout << "load: ok=" << ok << " terms=" << loaded.getTermCount() << "/" << index.getTermCount()
+              << " docs=" << loaded.getDocCount() << "/" << index.getDocCount()
+              << ((ok && loaded.getDocCount() == index.getDocCount()) ? " ok" : " FAIL") << std::endl;
+
+    //mmap加载的posting上叠加增量, 合并后再次快照
+    mutate(loaded, 5000);
+    check(loaded, "snapshot+delta");
+    loaded.merge();
+    check(loaded, "snapshot merged");
+    loaded.writeTo("./inverted_index.dat");
+    InvertedIndex reloaded;
+    ok = reloaded.load("./inverted_index.dat");
+    check(reloaded, "snapshot reload");
+    std::cout << "reload: ok=" << ok << (ok ? " ok" : " FAIL") << std::endl;
+}
+
+//定时合并执行中析构索引, 析构要等合并回调结束
+void test_auto_merge() {
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+    uint64_t docs = 0;
+    {
+        sylar::IOManager iom(2, false);
+        for(int i = 0; i < 100; ++i) {
+            InvertedIndex* index = new InvertedIndex;
+            for(uint32_t d = 0; d < 2000; ++d) {
+                index->add("t" + std::to_string(d % 50), d);
+            }
+            index->startAutoMerge(&iom, 1);
+            usleep(i % 3 * 1000);
+            docs += index->getDocCount();
+            delete index;
+        }
+    }
+    std::cout << "auto merge: docs=" << docs << (docs == 200000 ? " ok" : " FAIL") << std::endl;
+}
+
+#define BENCH(name, n, expr) { \
+    uint64_t ts = sylar::GetCurrentUS(); \
+    uint64_t r = 0; \
+    for(int i = 0; i < n; ++i) { \
+        r += expr; \
+    } \
+    std::cout << "    " << name << ": " << (sylar::GetCurrentUS() - ts) * 1.0 / n << "us result=" << r / n << std::endl; \
+}
+
+void test_bench() {
+    const uint32_t docs = 10000000;
+    std::mt19937 rng(1);
+    InvertedIndex index;
+
+    uint64_t ts = sylar::GetCurrentUS();
+    //各字段: 性别2个值, 年龄段10个值, 城市200个值(热点倾斜), 标签1000个(每文档3个, 热点倾斜)
+    struct Field {
+        std::string name;
+        uint32_t values;
+        int per_doc;
+        bool skew;
+    };
+    std::vector<Field> fields = {
+        {"gender", 2, 1, false},
+        {"age", 10, 1, false},
+        {"city", 200, 1, true},
+        {"tag", 1000, 3, true}
+    };
+    for(auto& f : fields) {
+        std::vector<std::vector<uint32_t> > postings(f.values);
+        for(uint32_t d = 0; d < docs; ++d) {
+            for(int n = 0; n < f.per_doc; ++n) {
+                uint32_t v = rng() % f.values;
+                if(f.skew) {
+                    //近似幂律: 均匀随机数取三次方, 小编号的值更热
+                    double r = (rng() % 1000000) / 1000000.0;
+                    v = (uint32_t)(r * r * r * f.values);
+                }
+                postings[v].push_back(d);
+            }
+        }
+        for(uint32_t v = 0; v < f.values; ++v) {
+            index.add(f.name + ":" + std::to_string(v), postings[v]);
+        }
+    }
+    uint64_t build_used = sylar::GetCurrentUS() - ts;
+    ts = sylar::GetCurrentUS();
+    index.merge();
+    uint64_t merge_used = sylar::GetCurrentUS() - ts;
+    std::cout << "bench: " << index.toString() << " build=" << build_used / 1000 << "ms"
+              << " merge=" << merge_used / 1000 << "ms" << std::endl;
+
+    auto q1 = IndexQuery::And({T("gender:1"), T("city:150")});
+    auto q2 = IndexQuery::And({T("gender:0"), T("age:3"), T("tag:0"), T("city:199")});
+    std::vector<IndexQuery::ptr> tags;
+    for(int i = 0; i < 50; ++i) {
+        tags.push_back(T("tag:" + std::to_string(i * 20)));
+    }
+    auto q3 = IndexQuery::Or(tags);
+    auto q4 = IndexQuery::And({T("age:3"), IndexQuery::Or({T("tag:1"), T("tag:2"), T("tag:500")})
+                              ,IndexQuery::Not(T("city:0"))});
+
+    std::cout << "  query" << std::endl;
+    BENCH("and(gender,city)", 100, index.query(q1)->getCount());
+    BENCH("count and(gender,city)", 100, index.count(q1));
+    BENCH("and4 cost ordered", 100, index.query(q2)->getCount());
+    BENCH("and4 given order", 100, ([&]() {
+        RoaringBitmap r(*index.get("gender:0"));
+        r &= *index.get("age:3");
+        r &= *index.get("tag:0");
+        r &= *index.get("city:199");
+        return r.getCount();
+    })());
+    BENCH("or50(tag)", 20, index.query(q3)->getCount());
+    BENCH("and(age,or(tag),not city)", 20, index.query(q4)->getCount());
+
+    //增量更新后查询, 再后台合并
+    for(uint32_t i = 0; i < 100000; ++i) {
+        index.add("city:150", rng() % docs);
+        if(i % 10 == 0) {
+            index.delDoc(rng() % docs);
+        }
+    }
+    std::cout << "  query with delta ops=" << index.getDeltaOps() << std::endl;
+    BENCH("and(gender,city)", 100, index.query(q1)->getCount());
+    BENCH("and4 cost ordered", 100, index.query(q2)->getCount());
+    ts = sylar::GetCurrentUS();
+    index.merge();
+    std::cout << "  merge delta: " << (sylar::GetCurrentUS() - ts) / 1000.0 << "ms" << std::endl;
+
+    ts = sylar::GetCurrentUS();
+    index.writeTo("./inverted_index_bench.dat");
+    uint64_t write_used = sylar::GetCurrentUS() - ts;
+    ts = sylar::GetCurrentUS();
+    InvertedIndex loaded;
+    loaded.load("./inverted_index_bench.dat");
+    std::cout << "  snapshot write=" << write_used / 1000 << "ms load="
+              << (sylar::GetCurrentUS() - ts) / 1000 << "ms " << loaded.toString() << std::endl;
+    std::cout << "  query mmap" << std::endl;
+    BENCH("and(gender,city)", 100, loaded.query(q1)->getCount());
+    BENCH("count and(gender,city)", 100, loaded.count(q1));
+    BENCH("and4 cost ordered", 100, loaded.query(q2)->getCount());
+    BENCH("or50(tag)", 20, loaded.query(q3)->getCount());
+}
+
+int main(int argc, char** argv) {
+    test_check();
+    test_auto_merge();
+    test_bench();
+    return 0;
+}
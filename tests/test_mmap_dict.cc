@@ -0,0 +1,144 @@
+#include "sylar/ds/mmap_dict.h"
+#include "sylar/util.h"
+#include <iostream>
+#include <fstream>
+#include <random>
+
+void test_dict() {
+    sylar::ds::Dict<uint64_t, uint32_t> dict;
+    std::mt19937_64 rng(1);
+    std::vector<uint64_t> keys;
+    for(int i = 0; i < 500000; ++i) {
+        uint64_t k = rng();
+        std::vector<uint32_t> vs(rng() % 10 + 1);
+        for(auto& v : vs) {
+            v = rng();
+        }
+        dict.insert(k, vs.data(), vs.size());
+        keys.push_back(k);
+    }
+
+    uint64_t ts = sylar::GetCurrentUS();
+    {
+        std::ofstream ofs("./mmap_dict.old");
+        dict.writeTo(ofs);
+    }
+    uint64_t old_write = sylar::GetCurrentUS() - ts;
+    ts = sylar::GetCurrentUS();
+    bool ok = sylar::ds::MmapDict<uint64_t, uint32_t>::Write("./mmap_dict.data", dict);
+    uint64_t mmap_write = sylar::GetCurrentUS() - ts;
+
+    ts = sylar::GetCurrentUS();
+    {
+        std::ifstream ifs("./mmap_dict.old");
+        sylar::ds::Dict<uint64_t, uint32_t> tmp;
+        tmp.readFrom(ifs);
+    }
+    uint64_t old_load = sylar::GetCurrentUS() - ts;
+
+    ts = sylar::GetCurrentUS();
+    sylar::ds::MmapDict<uint64_t, uint32_t> md;
+    ok = ok && md.open("./mmap_dict.data");
+    uint64_t mmap_load = sylar::GetCurrentUS() - ts;
+
+    ts = sylar::GetCurrentUS();
+    sylar::ds::MmapDict<uint64_t, uint32_t> md2;
+    ok = ok && md2.open("./mmap_dict.data", true);
+    uint64_t verify_load = sylar::GetCurrentUS() - ts;
+
+    int diff = 0;
+    std::vector<uint32_t> v1, v2;
+    for(auto& k : keys) {
+        dict.get(k, v1);
+        md.get(k, v2);
+        diff += (v1 != v2);
+    }
+    diff += md.exists(0) + (md.getTotal() != dict.getTotal());
+
+    ts = sylar::GetCurrentUS();
+    uint64_t sum = 0;
+    for(auto& k : keys) {
+        uint32_t size = 0;
+        const uint32_t* v = md.find(k, size);
+        sum += v ? v[0] : 0;
+    }
+    uint64_t mmap_get = sylar::GetCurrentUS() - ts;
+
+    ts = sylar::GetCurrentUS();
+    for(auto& k : keys) {
+        auto v = dict.get(k, false);
+        sum += v ? v.get()[0] : 0;
+    }
+    uint64_t dict_get = sylar::GetCurrentUS() - ts;
+
+    std::cout << "dict: total=" << md.getTotal() << " elements=" << md.getElements()
+              << " diff=" << diff << " sum=" << sum
+              << ((ok && diff == 0) ? " ok" : " FAIL") << std::endl;
+    std::cout << "dict: write old=" << old_write / 1000.0 << "ms mmap=" << mmap_write / 1000.0 << "ms"
+              << " load old=" << old_load / 1000.0 << "ms mmap=" << mmap_load / 1000.0 << "ms"
+              << " mmap_verify=" << verify_load / 1000.0 << "ms"
+              << " get dict=" << dict_get / 1000.0 << "ms mmap=" << mmap_get / 1000.0 << "ms"
+              << std::endl;
+    md.dump(std::cout);
+}
+
+void test_multimap() {
+    sylar::ds::HashMultimap<uint32_t, uint32_t> mm;
+    for(uint32_t i = 0; i < 10000; ++i) {
+        for(uint32_t n = 0; n < i % 7 + 1; ++n) {
+            mm.insert(i, i * 10 + n);
+        }
+    }
+    bool ok = sylar::ds::MmapMultimap<uint32_t, uint32_t>::Write("./mmap_multimap.data", mm);
+    sylar::ds::MmapMultimap<uint32_t, uint32_t> md;
+    ok = ok && md.open("./mmap_multimap.data", true);
+    int diff = 0;
+    for(uint32_t i = 0; i < 10000; ++i) {
+        for(uint32_t n = 0; n < 8; ++n) {
+            diff += (md.exists(i, i * 10 + n) != (n < i % 7 + 1));
+        }
+    }
+    std::cout << "multimap: total=" << md.getTotal() << " elements=" << md.getElements()
+              << " diff=" << diff << ((ok && diff == 0) ? " ok" : " FAIL") << std::endl;
+}
+
+void test_string_dict() {
+    sylar::ds::StringDict sd;
+    std::vector<uint64_t> ids;
+    for(int i = 0; i < 10000; ++i) {
+        ids.push_back(sd.update("str_" + std::to_string(i)));
+    }
+    bool ok = sylar::ds::MmapStringDict::Write("./mmap_string_dict.data", sd);
+
+    sylar::ds::HotSwapDict<sylar::ds::MmapStringDict> hot;
+    ok = ok && hot.load("./mmap_string_dict.data");
+    auto old = hot.get();
+    int diff = 0;
+    for(int i = 0; i < 10000; ++i) {
+        diff += (old->get(ids[i]) != "str_" + std::to_string(i));
+    }
+
+    //热替换: 旧字典在持有者释放前仍可用
+    sd.update("hot_swap");
+    ok = ok && sylar::ds::MmapStringDict::Write("./mmap_string_dict.data", sd);
+    ok = ok && hot.load("./mmap_string_dict.data");
+    diff += (old->get(ids[0]) != "str_0") + (old->getTotal() != 10000);
+    diff += (hot.get()->get(sylar::ds::StringDict::GetID("hot_swap")) != "hot_swap");
+
+    //损坏的文件加载失败, 保留当前字典
+    {
+        std::ofstream ofs("./mmap_string_dict.bad");
+        ofs << "bad data";
+    }
+    bool bad = hot.load("./mmap_string_dict.bad");
+    diff += (hot.get()->getTotal() != 10001);
+    std::cout << "string_dict: diff=" << diff << " bad_load=" << bad
+              << ((ok && !bad && diff == 0) ? " ok" : " FAIL") << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_dict();
+    test_multimap();
+    test_string_dict();
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include "orm_out/test/orm/user_info.h"
+#include "sylar/db/sqlite3.h"
+#include "sylar/log.h"
+#include "sylar/macro.h"
+#include <unistd.h>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+typedef test::orm::UserInfo UserInfo;
+typedef test::orm::UserInfoDao UserInfoDao;
+
+static sylar::IDB::ptr open_db(const std::string& path) {
+    unlink(path.c_str());
+    unlink((path + "-wal").c_str());
+    unlink((path + "-shm").c_str());
+    sylar::IDB::ptr db = sylar::SQLite3::Create(path);
+    SYLAR_ASSERT(UserInfoDao::CreateTableSQLite3(db) == 0);
+    return db;
+}
+
+static std::vector<UserInfo::ptr> make_users(int n) {
+    std::vector<UserInfo::ptr> us;
+    for(int i = 0; i < n; ++i) {
+        UserInfo::ptr u(new UserInfo);
+        u->setName("name_" + std::to_string(i));
+        u->setEmail("mail_" + std::to_string(i) + "@xx.com");
+        u->setPhone("phone_" + std::to_string(i));
+        u->setStatus(i % 10);
+        u->setCreateTime(time(0));
+        us.push_back(u);
+    }
+    return us;
+}
+
+static int count_users(sylar::IDB::ptr db) {
+    auto data = db->query("select count(*) from user");
+    return data && data->next() ? data->getInt32(0) : -1;
+}
+
+#define BENCH(name, n, unit, code) { \
+        uint64_t ts = sylar::GetCurrentUS(); \
+        code; \
+        uint64_t used = sylar::GetCurrentUS() - ts; \
+        std::cout << name << " n=" << n << " " << (n * 1000000.0 / (used ? used : 1)) \
+                  << " " unit "/s" << std::endl; \
+    }
+
+void test_batch(sylar::IDB::ptr db) {
+    auto us = make_users(1000);
+    //1000行分成7批, 最后一批行数不同
+    SYLAR_ASSERT(UserInfoDao::BatchInsert(us, db, 150) == 0);
+    SYLAR_ASSERT(count_users(db) == 1000);
+    SYLAR_ASSERT(UserInfoDao::BatchInsert(make_users(1), db) != 0);
+
+    std::vector<UserInfo::ptr> all;
+    SYLAR_ASSERT(UserInfoDao::QueryAll(all, db) == 0);
+    SYLAR_ASSERT(all.size() == 1000);
+    for(auto& i : all) {
+        i->setPhone("new_" + i->getName());
+    }
+    //自增主键为0的行插入
+    all.push_back(make_users(1001).back());
+    SYLAR_ASSERT(UserInfoDao::BatchUpsert(all, db) == 0);
+    SYLAR_ASSERT(count_users(db) == 1001);
+
+    auto u = UserInfoDao::QueryByName("name_7", db);
+    SYLAR_ASSERT(u && u->getPhone() == "new_name_7");
+    u = UserInfoDao::QueryByName("name_1000", db);
+    SYLAR_ASSERT(u && u->getPhone() == "phone_1000");
+
+    int rows = 0;
+    SYLAR_ASSERT(UserInfoDao::QueryByStatusEach([&rows](const UserInfo& info) {
+        if(info.getStatus() != 3 || info.getPhone() != "new_" + info.getName()) {
+            return false;
+        }
+        ++rows;
+        return true;
+    }, 3, db) == 0);
+    SYLAR_ASSERT(rows == 100);
+
+    rows = 0;
+    SYLAR_ASSERT(UserInfoDao::QueryAllEach([&rows](const UserInfo& info) {
+        return ++rows < 10;
+    }, db) == 0);
+    SYLAR_ASSERT(rows == 10);
+
+    u = UserInfoDao::QueryByName("name_1000", db);
+    //插入的行回填自增主键, 再次BatchUpsert不会重复插入
+    SYLAR_ASSERT(u && u->getId() == all.back()->getId());
+    auto news = make_users(1005);
+    news.erase(news.begin(), news.begin() + 1001);
+    SYLAR_ASSERT(UserInfoDao::BatchUpsert(news, db, 3) == 0);
+    SYLAR_ASSERT(UserInfoDao::BatchUpsert(news, db) == 0);
+    SYLAR_ASSERT(count_users(db) == 1005);
+    for(auto& i : news) {
+        u = UserInfoDao::QueryByName(i->getName(), db);
+        SYLAR_ASSERT(u && u->getId() == i->getId());
+    }
+    std::cout << "orm batch ok" << std::endl;
+}
+
+void bench(sylar::IDB::ptr db, int n) {
+    auto us = make_users(n);
+
+    SYLAR_ASSERT(db->execute("delete from user") == 0);
+    BENCH("insert Insert         ", n, "rows", {
+        auto trans = db->openTransaction(false);
+        trans->begin();
+        for(auto& i : us) {
+            UserInfoDao::Insert(i, db);
+        }
+        trans->commit();
+    });
+    SYLAR_ASSERT(count_users(db) == n);
+
+    for(size_t batch : {16, 64, 0}) {
+        SYLAR_ASSERT(db->execute("delete from user") == 0);
+        BENCH("insert BatchInsert(" + std::to_string(batch) + ")", n, "rows", {
+            auto trans = db->openTransaction(false);
+            trans->begin();
+            UserInfoDao::BatchInsert(us, db, batch);
+            trans->commit();
+        });
+        SYLAR_ASSERT(count_users(db) == n);
+    }
+
+    std::vector<UserInfo::ptr> all;
+    BENCH("upsert InsertOrUpdate ", n, "rows", {
+        UserInfoDao::QueryAll(all, db);
+        auto trans = db->openTransaction(false);
+        trans->begin();
+        for(auto& i : all) {
+            UserInfoDao::InsertOrUpdate(i, db);
+        }
+        trans->commit();
+    });
+    BENCH("upsert BatchUpsert    ", n, "rows", {
+        auto trans = db->openTransaction(false);
+        trans->begin();
+        UserInfoDao::BatchUpsert(all, db);
+        trans->commit();
+    });
+    SYLAR_ASSERT(count_users(db) == n);
+    all.clear();
+
+    int64_t sum = 0;
+    BENCH("scan QueryAll         ", n, "rows", {
+        std::vector<UserInfo::ptr> results;
+        UserInfoDao::QueryAll(results, db);
+        for(auto& i : results) {
+            sum += i->getStatus();
+        }
+    });
+    int64_t sum2 = 0;
+    BENCH("scan QueryAllEach     ", n, "rows", {
+        UserInfoDao::QueryAllEach([&sum2](const UserInfo& info) {
+            sum2 += info.getStatus();
+            return true;
+        }, db);
+    });
+    SYLAR_ASSERT(sum == sum2);
+
+    int q = 50;
+    BENCH("index QueryByStatus   ", q, "queries", {
+        for(int i = 0; i < q; ++i) {
+            std::vector<UserInfo::ptr> results;
+            UserInfoDao::QueryByStatus(results, i % 10, db);
+        }
+    });
+    BENCH("index QueryByStatusEach", q, "queries", {
+        for(int i = 0; i < q; ++i) {
+            UserInfoDao::QueryByStatusEach([](const UserInfo& info) {
+                return true;
+            }, i % 10, db);
+        }
+    });
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(sylar::LogLevel::WARN);
+    int n = argc > 1 ? atoi(argv[1]) : 100000;
+    auto db = open_db("orm_bench.db");
+    test_batch(db);
+    bench(db, n);
+    return 0;
+}
@@ -0,0 +1,306 @@
+#include "sylar/db/redis_client.h"
+#include "sylar/streams/socket_stream.h"
+#include "sylar/tcp_server.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include "sylar/macro.h"
+#include "sylar/util.h"
+#include <atomic>
+#include <iostream>
+
+using sylar::RespReply;
+using sylar::RespParser;
+using sylar::RedisClient;
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/**
+ * @brief 进程内的RESP服务端, 实现测试用到的少量命令
+ */
+class RespStubServer : public sylar::TcpServer {
+public:
+    typedef std::shared_ptr<RespStubServer> ptr;
+
+    RespStubServer(const std::string& passwd)
+        :m_passwd(passwd) {
+    }
+
+    uint64_t getReads() const { return m_reads;}
+    uint64_t getCmds() const { return m_cmds;}
+protected:
+    virtual void handleClient(sylar::Socket::ptr client) override {
+        sylar::SocketStream stream(client);
+        sylar::BufferChain in;
+        RespParser parser;
+        bool resp3 = false;
+        bool authed = m_passwd.empty();
+        while(true) {
+            if(stream.read(in, 64 * 1024) <= 0) {
+                break;
+            }
+            ++m_reads;
+            sylar::BufferChain out;
+            RespReply::ptr req;
+            int rt = 0;
+            while((rt = parser.parse(in, req)) > 0) {
+                ++m_cmds;
+                execute(req, resp3, authed, out);
+            }
+            if(rt < 0 || (!out.empty() && stream.writeFixSize(out, out.size()) <= 0)) {
+                break;
+            }
+        }
+        stream.close();
+    }
+
+    void execute(RespReply::ptr req, bool& resp3, bool& authed, sylar::BufferChain& out) {
+        std::vector<std::string> argv;
+        for(auto& i : req->getElements()) {
+            argv.push_back(i->getString());
+        }
+        std::string cmd = argv.empty() ? "" : sylar::ToUpper(argv[0]);
+        RespReply::ptr rsp;
+        if(cmd == "HELLO") {
+            if(argv.size() >= 5 && sylar::ToUpper(argv[2]) == "AUTH") {
+                authed = argv[4] == m_passwd;
+            }
+            if(!authed) {
+                rsp = RespReply::Error("WRONGPASS invalid password");
+            } else {
+                resp3 = argv.size() > 1 && argv[1] == "3";
+                rsp = RespReply::Aggregate(RespReply::MAP, {RespReply::String("server")
+                        ,RespReply::String("stub"), RespReply::String("proto")
+                        ,RespReply::Integer(resp3 ? 3 : 2)});
+            }
+        } else if(cmd == "AUTH") {
+            authed = argv.size() > 1 && argv.back() == m_passwd;
+            rsp = authed ? RespReply::Status("OK") : RespReply::Error("WRONGPASS invalid password");
+        } else if(!authed) {
+            rsp = RespReply::Error("NOAUTH Authentication required.");
+        } else if(cmd == "PING") {
+            rsp = RespReply::Status("PONG");
+        } else if(cmd == "SELECT") {
+            rsp = RespReply::Status("OK");
+        } else if(cmd == "SET" && argv.size() == 3) {
+            sylar::Mutex::Lock lock(m_mutex);
+            m_datas[argv[1]] = argv[2];
+            rsp = RespReply::Status("OK");
+        } else if(cmd == "GET" && argv.size() == 2) {
+            sylar::Mutex::Lock lock(m_mutex);
+            auto it = m_datas.find(argv[1]);
+            rsp = it == m_datas.end() ? RespReply::Nil() : RespReply::String(it->second);
+        } else if(cmd == "INCR" && argv.size() == 2) {
+            sylar::Mutex::Lock lock(m_mutex);
+            auto& v = m_datas[argv[1]];
+            v = std::to_string(atoll(v.c_str()) + 1);
+            rsp = RespReply::Integer(atoll(v.c_str()));
+        } else if(cmd == "HGETALL") {
+            rsp = RespReply::Aggregate(RespReply::MAP, {RespReply::String("f1")
+                    ,RespReply::String("v1"), RespReply::String("f2"), RespReply::Double(1.5)});
+        } else if(cmd == "SLEEP" && argv.size() == 2) {
+            usleep(atoi(argv[1].c_str()) * 1000);
+            rsp = RespReply::Status("OK");
+        } else if(cmd == "PUSHME") {
+            //推送先于回复到达
+            RespReply::Aggregate(RespReply::PUSH, {RespReply::String("message")
+                    ,RespReply::String("hello")})->encodeTo(out, resp3);
+            rsp = RespReply::Status("OK");
+        } else {
+            rsp = RespReply::Error("ERR unknown command '" + cmd + "'");
+        }
+        rsp->encodeTo(out, resp3);
+    }
+private:
+    std::string m_passwd;
+    sylar::Mutex m_mutex;
+    std::map<std::string, std::string> m_datas;
+    std::atomic<uint64_t> m_reads{0};
+    std::atomic<uint64_t> m_cmds{0};
+};
+
+//逐字节喂入与一次喂入的结果一致, 属性被丢弃
+void test_parser() {
+    std::string data = "*7\r\n$5\r\nhello\r\n:-42\r\n_\r\n%2\r\n+a\r\n,3.25\r\n$0\r\n\r\n#t\r\n"
+        "|1\r\n+ttl\r\n:3600\r\n~2\r\n(12345678901234567890\r\n$-1\r\n"
+        "*2\r\n=8\r\ntxt:some\r\n!5\r\nERR x\r\n"
+        ">2\r\n+message\r\n*0\r\n";
+    std::string expect = "[\"hello\", -42, (nil), {a: 3.25, \"\": true}, [12345678901234567890, (nil)]"
+        ", [\"some\", (error) ERR x], [message, []]]";
+    sylar::BufferChain all(data.c_str(), data.size());
+    RespParser parser;
+    RespReply::ptr r1, r2;
+    SYLAR_ASSERT(parser.parse(all, r1) == 1 && all.size() == 0);
+
+    sylar::BufferChain part;
+    int rt = 0;
+    for(size_t i = 0; i < data.size(); ++i) {
+        part.append(&data[i], 1);
+        rt = parser.parse(part, r2);
+        if(rt) {
+            break;
+        }
+    }
+    SYLAR_ASSERT(rt == 1 && r1->toString() == r2->toString());
+    SYLAR_ASSERT(r1->size() == 7 && r1->at(6)->getType() == RespReply::PUSH);
+    SYLAR_ASSERT(r1->at(3)->getType() == RespReply::MAP && r1->at(3)->size() == 4);
+    SYLAR_ASSERT(r1->toString() == expect);
+
+    //编码后再解析
+    sylar::BufferChain enc;
+    r1->encodeTo(enc, true);
+    RespReply::ptr r3;
+    SYLAR_ASSERT(parser.parse(enc, r3) == 1 && r3->toString() == r1->toString());
+    sylar::BufferChain enc2;
+    r1->encodeTo(enc2, false);
+    SYLAR_ASSERT(parser.parse(enc2, r3) == 1 && r3->size() == 7 && enc2.empty());
+
+    const char* bad[] = {"?1\r\n", "$abc\r\n", ":1\n", "*-2\r\n", "$3\r\nabcde\r\n", "#x\r\n"};
+    for(auto b : bad) {
+        RespParser p;
+        sylar::BufferChain buf(b, strlen(b));
+        SYLAR_ASSERT(p.parse(buf, r3) == -1);
+    }
+    std::cout << "parser ok" << std::endl;
+}
+
+static bool WaitConnected(RedisClient::ptr client) {
+    for(int i = 0; i < 200; ++i) {
+        auto rt = client->cmd({"PING"});
+        if(rt->result == 0 && rt->reply && !rt->reply->isError()) {
+            return true;
+        }
+        usleep(10 * 1000);
+    }
+    return false;
+}
+
+static std::atomic<int> s_pushes(0);
+
+void test_client(const std::string& host) {
+    std::map<std::string, std::string> conf = {{"host", host}, {"passwd", "secret"}
+        ,{"db", "2"}, {"resp", "3"}, {"pool", "2"}, {"timeout", "200"}};
+    RedisClient::ptr client(new RedisClient(conf));
+    SYLAR_ASSERT(client->init());
+    SYLAR_ASSERT(WaitConnected(client));
+
+    auto rt = client->cmd({"SET", "k1", std::string("v\r\n\0x", 5)});
+    SYLAR_ASSERT(rt->result == 0 && rt->reply->getString() == "OK");
+    rt = client->cmd({"GET", "k1"});
+    SYLAR_ASSERT(rt->reply && rt->reply->getType() == RespReply::STRING
+          && rt->reply->getString() == std::string("v\r\n\0x", 5));
+    rt = client->cmd({"GET", "none"});
+    SYLAR_ASSERT(rt->reply && rt->reply->isNil());
+    rt = client->cmd({"INCR", "n"});
+    SYLAR_ASSERT(rt->reply && rt->reply->getInteger() == 1);
+    rt = client->cmd({"HGETALL", "h"});
+    SYLAR_ASSERT(rt->reply && rt->reply->getType() == RespReply::MAP && rt->reply->size() == 4
+          && rt->reply->at(3)->getDouble() == 1.5);
+    rt = client->cmd({"NOPE"});
+    SYLAR_ASSERT(rt->result == 0 && rt->reply && rt->reply->isError());
+
+    //超时后迟到的回复被丢弃, 不影响后续命令
+    rt = client->cmd({"SLEEP", "300"}, 50);
+    SYLAR_ASSERT(rt->result == sylar::AsyncSocketStream::TIMEOUT);
+    for(int i = 0; i < 4; ++i) {
+        rt = client->cmd({"GET", "k1"}, 1000);
+        SYLAR_ASSERT(rt->result == 0 && rt->reply && rt->reply->getString().size() == 5);
+    }
+    client->close();
+
+    //RESP2, 推送
+    conf["resp"] = "2";
+    conf["pool"] = "1";
+    client.reset(new RedisClient(conf));
+    client->init();
+    SYLAR_ASSERT(WaitConnected(client));
+    rt = client->cmd({"HGETALL", "h"});
+    SYLAR_ASSERT(rt->reply && rt->reply->getType() == RespReply::ARRAY && rt->reply->size() == 4);
+    client->close();
+
+    conf["resp"] = "3";
+    sylar::RedisStream::ptr conn(new sylar::RedisStream(nullptr));
+    conn->setPasswd("secret");
+    conn->setResp3(true);
+    conn->setPushHandler([](RespReply::ptr r, sylar::RedisStream::ptr) {
+        s_pushes += r->size() == 2;
+    });
+    SYLAR_ASSERT(conn->connect(sylar::Address::LookupAnyIPAddress(host)) && conn->start());
+    rt = conn->cmd({"PUSHME"}, 1000);
+    SYLAR_ASSERT(rt->reply && rt->reply->getString() == "OK");
+    usleep(10 * 1000);
+    SYLAR_ASSERT(s_pushes == 1);
+    conn->close();
+
+    //密码错误时握手失败断开
+    conf["passwd"] = "wrong";
+    client.reset(new RedisClient(conf));
+    client->init();
+    SYLAR_ASSERT(!WaitConnected(client));
+    client->close();
+    std::cout << "client ok" << std::endl;
+}
+
+static std::atomic<int> s_running(0);
+
+static void BenchFiber(RedisClient::ptr client, int count) {
+    for(int i = 0; i < count; ++i) {
+        auto rt = client->cmd({"GET", "k1"});
+        SYLAR_ASSERT(!rt->result && rt->reply && rt->reply->getString().size() == 5);
+    }
+    --s_running;
+}
+
+//多个协程的命令合并写出
+void bench(const std::string& host, RespStubServer::ptr server, int fibers, int count, int pool) {
+    std::map<std::string, std::string> conf = {{"host", host}, {"passwd", "secret"}
+        ,{"pool", std::to_string(pool)}, {"timeout", "5000"}};
+    RedisClient::ptr client(new RedisClient(conf));
+    client->init();
+    SYLAR_ASSERT(WaitConnected(client));
+
+    for(int n : {1, fibers}) {
+        uint64_t reads = server->getReads();
+        uint64_t cmds = server->getCmds();
+        s_running = n;
+        uint64_t ts = sylar::GetCurrentUS();
+        for(int i = 0; i < n; ++i) {
+            sylar::IOManager::GetThis()->schedule(std::bind(BenchFiber, client, count));
+        }
+        while(s_running) {
+            usleep(1000);
+        }
+        uint64_t used = sylar::GetCurrentUS() - ts;
+        reads = server->getReads() - reads;
+        cmds = server->getCmds() - cmds;
+        std::cout << "bench fibers=" << n << " pool=" << pool << " cmds=" << cmds
+                  << " used=" << used / 1000.0 << "ms "
+                  << (used ? cmds * 1000000.0 / used : 0) << " cmds/s"
+                  << " cmds_per_server_read=" << (reads ? cmds * 1.0 / reads : 0) << std::endl;
+    }
+    std::cout << "  " << client->toString() << std::endl;
+    client->close();
+}
+
+void run(int fibers, int count, int pool) {
+    RespStubServer::ptr server(new RespStubServer("secret"));
+    SYLAR_ASSERT(server->bind(sylar::Address::LookupAnyIPAddress("127.0.0.1:0")));
+    server->start();
+    std::string host = server->getSocks()[0]->getLocalAddress()->toString();
+    test_client(host);
+    bench(host, server, fibers, count, pool);
+    server->stop();
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(sylar::LogLevel::WARN);
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::FATAL);
+    int fibers = argc > 1 ? atoi(argv[1]) : 200;
+    int count = argc > 2 ? atoi(argv[2]) : 1000;
+    int pool = argc > 3 ? atoi(argv[3]) : 2;
+    test_parser();
+    {
+        sylar::IOManager iom(2);
+        iom.schedule(std::bind(run, fibers, count, pool));
+    }
+    return 0;
+}
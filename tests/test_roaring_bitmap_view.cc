@@ -0,0 +1,222 @@
+#include "sylar/ds/roaring_bitmap.h"
+#include "sylar/util.h"
+#include <iostream>
+#include <random>
+#include <set>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+
+using sylar::ds::RoaringBitmap;
+using sylar::ds::RoaringBitmapView;
+
+static std::string Concat(const std::vector<iovec>& iovs) {
+    std::string rt;
+    for(auto& i : iovs) {
+        rt.append((const char*)i.iov_base, i.iov_len);
+    }
+    return rt;
+}
+
+static bool WriteFile(const std::string& path, const RoaringBitmap& b) {
+    std::vector<iovec> iovs;
+    std::string buffer;
+    b.writeTo(iovs, buffer);
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        return false;
+    }
+    bool ok = true;
+    for(size_t i = 0; ok && i < iovs.size(); i += IOV_MAX) {
+        int n = std::min((size_t)IOV_MAX, iovs.size() - i);
+        ssize_t len = 0;
+        for(int x = 0; x < n; ++x) {
+            len += iovs[i + x].iov_len;
+        }
+        ok = writev(fd, &iovs[i], n) == len;
+    }
+    close(fd);
+    return ok;
+}
+
+//随机生成array/bitset/run各类container混合的bitmap
+static RoaringBitmap::ptr Random(std::mt19937& rng, std::set<uint32_t>& v, bool runs) {
+    RoaringBitmap::ptr b(new RoaringBitmap);
+    int containers = rng() % 12;
+    for(int c = 0; c < containers; ++c) {
+        uint32_t base = (rng() % 64) << 16;
+        int type = rng() % 3;
+        int count = type == 0 ? rng() % 4000 + 1 : (type == 1 ? rng() % 30000 + 5000 : rng() % 5 + 1);
+        for(int i = 0; i < count; ++i) {
+            if(type == 2) {
+                uint32_t from = base + rng() % 60000;
+                uint32_t len = rng() % 5000 + 1;
+                b->set(from, len, true);
+                for(uint32_t x = from; x < from + len; ++x) {
+                    v.insert(x);
+                }
+            } else {
+                uint32_t t = base + rng() % 65536;
+                b->set(t, true);
+                v.insert(t);
+            }
+        }
+    }
+    return runs ? b->compress() : b->uncompress();
+}
+
+static bool Same(const RoaringBitmapView& view, const std::set<uint32_t>& v) {
+    std::vector<uint32_t> pos;
+    view.listPosAsc(pos);
+    std::vector<uint32_t> pos2;
+    view.foreach([&pos2](uint32_t i) {
+        pos2.push_back(i);
+        return true;
+    });
+    bool ok = view.getCount() == v.size()
+        && pos == std::vector<uint32_t>(v.begin(), v.end())
+        && pos2 == pos
+        && view.any() == !v.empty();
+    for(auto& i : v) {
+        ok = ok && view.get(i) && !view.get(i + 70000 * 65536u);
+        break;
+    }
+    return ok;
+}
+
+//iovec输出与库的portable序列化逐字节一致, 视图结果与原数据一致
+void test_check() {
+    std::mt19937 rng(1);
+    int fail = 0;
+    int zero_copy = 0;
+    for(int n = 0; n < 200; ++n) {
+        std::set<uint32_t> v;
+        RoaringBitmap::ptr b = Random(rng, v, n % 2);
+        std::vector<iovec> iovs;
+        std::string buffer;
+        uint64_t size = b->writeTo(iovs, buffer);
+        std::string data = Concat(iovs);
+        fail += size != data.size() || size != b->getPortableSize();
+
+        roaring_bitmap_t* r = roaring_bitmap_portable_deserialize_safe(data.c_str(), data.size());
+        if(r) {
+            std::string expect(roaring_bitmap_portable_size_in_bytes(r), '\0');
+            roaring_bitmap_portable_serialize(r, &expect[0]);
+            fail += expect != data;
+            roaring_bitmap_free(r);
+        } else {
+            ++fail;
+        }
+
+        auto view = RoaringBitmapView::Create(data.c_str(), data.size());
+        if(!view) {
+            ++fail;
+            continue;
+        }
+        zero_copy += view->isZeroCopy();
+        fail += !Same(*view, v);
+        fail += view->getSizeInBytes() != size;
+        fail += *view->toBitmap() != *b;
+        fail += view->andCount(*b) != v.size();
+        fail += view->cross(*b) != !v.empty();
+
+        std::set<uint32_t> v2;
+        RoaringBitmap::ptr b2 = Random(rng, v2, n % 3);
+        RoaringBitmap a(*b2), o(*b2), d(*b2);
+        a &= *view;
+        o |= *view;
+        d -= *view;
+        fail += a != (*b2 & *b);
+        fail += o != (*b2 | *b);
+        fail += d != (*b2 - *b);
+
+        //截断的数据必须被拒绝
+        fail += RoaringBitmapView::Create(data.c_str(), data.size() - 1) != nullptr;
+
+        //ByteArray: 小块跨节点时复制, 大块零拷贝
+        for(size_t base : {64, 1024 * 1024}) {
+            sylar::ByteArray::ptr ba(new sylar::ByteArray(base));
+            ba->writeFuint32(size);
+            ba->write(data.c_str(), data.size());
+            ba->writeFuint32(0x12345678);
+            ba->setPosition(0);
+            uint32_t len = ba->readFuint32();
+            auto bv = RoaringBitmapView::Create(ba, len);
+            fail += !bv || !Same(*bv, v);
+            fail += ba->readFuint32() != 0x12345678;
+        }
+    }
+    std::cout << "check zero_copy=" << zero_copy << (fail ? " FAIL" : " ok") << std::endl;
+}
+
+void test_bench() {
+    std::mt19937 rng(1);
+    RoaringBitmap b;
+    //稀疏array, 稠密bitset和连续区间各占一部分
+    for(uint32_t i = 0; i < 2000000; ++i) {
+        b.set(rng() % 200000000, true);
+    }
+    for(uint32_t i = 0; i < 30000000; ++i) {
+        b.set(200000000 + rng() % 60000000, true);
+    }
+    for(uint32_t i = 0; i < 2000; ++i) {
+        b.set(300000000 + i * 100000, 50000, true);
+    }
+    b = *b.compress();
+    std::cout << "bench: count=" << ([&b]() {
+        uint64_t c = 0;
+        b.foreach([&c](uint32_t) { ++c; return true;});
+        return c;
+    })() << " portable=" << b.getPortableSize() << std::endl;
+
+    uint64_t ts = sylar::GetCurrentUS();
+    sylar::ByteArray::ptr ba(new sylar::ByteArray);
+    b.writeTo(ba);
+    uint64_t t1 = sylar::GetCurrentUS();
+    ba->setPosition(0);
+    RoaringBitmap r;
+    r.readFrom(ba);
+    uint64_t t2 = sylar::GetCurrentUS();
+    std::cout << "  bytearray writeTo=" << (t1 - ts) / 1000.0 << "ms readFrom="
+              << (t2 - t1) / 1000.0 << "ms" << (r == b ? " ok" : " FAIL") << std::endl;
+
+    ts = sylar::GetCurrentUS();
+    std::vector<iovec> iovs;
+    std::string buffer;
+    uint64_t size = b.writeTo(iovs, buffer);
+    t1 = sylar::GetCurrentUS();
+    ba.reset(new sylar::ByteArray(size + 4));
+    ba->writeFuint32(size);
+    for(auto& i : iovs) {
+        ba->write(i.iov_base, i.iov_len);
+    }
+    t2 = sylar::GetCurrentUS();
+    ba->setPosition(0);
+    uint32_t len = ba->readFuint32();
+    auto view = RoaringBitmapView::Create(ba, len);
+    uint64_t t3 = sylar::GetCurrentUS();
+    std::cout << "  iovec writeTo=" << (t1 - ts) / 1000.0 << "ms iovs=" << iovs.size()
+              << " to bytearray=" << (t2 - t1) / 1000.0 << "ms view="
+              << (t3 - t2) / 1000.0 << "ms " << view->toString() << std::endl;
+
+    ts = sylar::GetCurrentUS();
+    bool ok = WriteFile("./roaring_view.dat", b);
+    t1 = sylar::GetCurrentUS();
+    view = RoaringBitmapView::Load("./roaring_view.dat");
+    t2 = sylar::GetCurrentUS();
+    uint64_t count = view ? view->getCount() : 0;
+    t3 = sylar::GetCurrentUS();
+    uint64_t ac = view ? view->andCount(b) : 0;
+    uint64_t t4 = sylar::GetCurrentUS();
+    std::cout << "  writev file=" << (t1 - ts) / 1000.0 << "ms mmap view="
+              << (t2 - t1) / 1000.0 << "ms count=" << (t3 - t2) / 1000.0
+              << "ms andCount=" << (t4 - t3) / 1000.0 << "ms"
+              << ((ok && count == ac && view->toBitmap() && *view->toBitmap() == b) ? " ok" : " FAIL")
+              << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_check();
+    test_bench();
+    return 0;
+}
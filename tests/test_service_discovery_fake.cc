@@ -0,0 +1,160 @@
+#include "sylar/streams/service_discovery.h"
+#include "sylar/streams/load_balance.h"
+#include "fake_zk_client.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const std::string s_providers = "/sylar/sylar.top/blog/providers";
+
+static std::string GetProviderPath(int i) {
+    return s_providers + "/10.0." + std::to_string(i / 250) + "."
+        + std::to_string(i % 250 + 1) + ":8080";
+}
+
+void run() {
+    g_logger->setLevel(sylar::LogLevel::INFO);
+    sylar::FakeZKClient::ptr zk(new sylar::FakeZKClient);
+    sylar::ZKServiceDiscovery::ptr sd(new sylar::ZKServiceDiscovery("fake", zk));
+    sd->setSelfInfo("127.0.0.1:2222");
+    sd->registerServer("sylar.top", "blog", "127.0.0.1:8080", "");
+    sd->queryServer("sylar.top", "blog");
+    sd->queryServer("sylar.top", "user");
+
+    int deltas = 0;
+    size_t changed = 0;
+    sd->setDeltaCallback([&deltas, &changed](const sylar::ServiceDelta& delta){
+        ++deltas;
+        changed += delta.adds.size() + delta.dels.size();
+    });
+    std::string new_path;
+    zk->create("/sylar", "", new_path);
+    zk->create("/sylar/sylar.top", "", new_path);
+    zk->create("/sylar/sylar.top/user", "", new_path);
+    zk->create("/sylar/sylar.top/user/providers", "", new_path);
+    sd->start();
+    auto blog = sd->getServer("sylar.top", "blog");
+    SYLAR_LOG_INFO(g_logger) << "start: blog=" << (blog ? blog->size() : 0)
+        << " version=" << sd->getSnapshot()->getVersion() << " deltas=" << deltas;
+
+    const int N = 2000;
+    for(int i = 0; i < N; ++i) {
+        zk->create(GetProviderPath(i), "", new_path, &ZOO_OPEN_ACL_UNSAFE
+                   ,sylar::ZKClient::FlagsType::EPHEMERAL);
+    }
+    zk->create("/sylar/sylar.top/user/providers/10.1.0.1:9090", "", new_path
+               ,&ZOO_OPEN_ACL_UNSAFE, sylar::ZKClient::FlagsType::EPHEMERAL);
+    blog = sd->getServer("sylar.top", "blog");
+    auto user = sd->getServer("sylar.top", "user");
+    SYLAR_LOG_INFO(g_logger) << "add: blog=" << blog->size() << " user=" << user->size()
+        << " deltas=" << deltas << " changed=" << changed
+        << ((blog->size() == N + 1 && changed == N + 2) ? " ok" : " FAIL");
+
+    deltas = 0;
+    changed = 0;
+    uint64_t ts = sylar::GetCurrentUS();
+    zk->del(GetProviderPath(7));
+    uint64_t used = sylar::GetCurrentUS() - ts;
+    auto blog2 = sd->getServer("sylar.top", "blog");
+    SYLAR_LOG_INFO(g_logger) << "del one: blog=" << blog2->size() << " deltas=" << deltas
+        << " changed=" << changed << " used=" << used << "us"
+        << " old_snapshot_blog=" << blog->size()
+        << " user_shared=" << (sd->getServer("sylar.top", "user") == user)
+        << ((blog2->size() == (size_t)N && changed == 1 && blog->size() == N + 1) ? " ok" : " FAIL");
+
+    //实例没有变化时不发布新快照
+    uint64_t version = sd->getSnapshot()->getVersion();
+    deltas = 0;
+    zk->set(s_providers, "touch");
+    std::vector<std::string> children;
+    zk->getChildren(s_providers, children, false);
+    SYLAR_LOG_INFO(g_logger) << "no change: version=" << sd->getSnapshot()->getVersion()
+        << " deltas=" << deltas
+        << ((version == sd->getSnapshot()->getVersion() && deltas == 0) ? " ok" : " FAIL");
+
+    //会话过期: 临时节点被删除, 重连后重新注册自身
+    zk->expireSession();
+    blog = sd->getServer("sylar.top", "blog");
+    SYLAR_LOG_INFO(g_logger) << "expired: blog=" << blog->size()
+        << " self=" << blog->count(sylar::ServiceItemInfo::Create("127.0.0.1:8080", "")->getId())
+        << ((blog->size() == 1) ? " ok" : " FAIL");
+
+    sd->stop();
+}
+
+//实例数据变化时, SDLoadBalance用新数据重建连接
+void test_load_balance() {
+    sylar::FakeZKClient::ptr zk(new sylar::FakeZKClient);
+    sylar::ZKServiceDiscovery::ptr sd(new sylar::ZKServiceDiscovery("fake", zk));
+    sd->setSelfInfo("127.0.0.1:2222");
+    sd->queryServer("sylar.top", "blog");
+    sylar::SDLoadBalance::ptr lb(new sylar::SDLoadBalance(sd));
+    std::map<sylar::SocketStream::ptr, std::string> streams;
+    lb->setCb([&streams](sylar::ServiceItemInfo::ptr info){
+        sylar::SocketStream::ptr stream(new sylar::SocketStream(sylar::Socket::CreateTCPSocket()));
+        streams[stream] = info->getData();
+        return stream;
+    });
+    lb->start();
+
+    auto info = sylar::ServiceItemInfo::Create("10.0.0.1:8080", "v1");
+    sylar::ServiceSnapshot::ItemMap items;
+    items[info->getId()] = info;
+    sd->updateServer("sylar.top", "blog", items);
+    auto item = lb->get("sylar.top", "blog")->getById(info->getId());
+    bool add_ok = item && streams[item->getStream()] == "v1";
+
+    items[info->getId()] = sylar::ServiceItemInfo::Create("10.0.0.1:8080", "v2");
+    sd->updateServer("sylar.top", "blog", items);
+    auto item2 = lb->get("sylar.top", "blog")->getById(info->getId());
+    bool change_ok = item2 && item2 != item && streams[item2->getStream()] == "v2";
+    SYLAR_LOG_INFO(g_logger) << "load balance data change: add=" << add_ok
+        << " change=" << change_ok << ((add_ok && change_ok) ? " ok" : " FAIL");
+    lb->stop();
+}
+
+//回调中让出协程时, 同线程的其他协程更新不会死锁, 回调仍按版本顺序送达
+void test_callback_yield() {
+    sylar::FakeZKClient::ptr zk(new sylar::FakeZKClient);
+    sylar::ZKServiceDiscovery::ptr sd(new sylar::ZKServiceDiscovery("fake", zk));
+    std::vector<uint64_t> versions;
+    bool nested = false;
+    sd->setDeltaCallback([&versions, &nested, sd](const sylar::ServiceDelta& delta){
+        versions.push_back(delta.version);
+        usleep(10 * 1000);
+        //回调中再更新服务发现
+        if(!nested) {
+            nested = true;
+            auto info = sylar::ServiceItemInfo::Create("10.0.2.1:8080", "");
+            sylar::ServiceSnapshot::ItemMap items;
+            items[info->getId()] = info;
+            sd->updateServer("sylar.top", "nested", items);
+        }
+    });
+
+    int done = 0;
+    for(int i = 0; i < 2; ++i) {
+        sylar::IOManager::GetThis()->schedule([sd, i, &done](){
+            auto info = sylar::ServiceItemInfo::Create("10.0.1." + std::to_string(i + 1) + ":8080", "");
+            sylar::ServiceSnapshot::ItemMap items;
+            items[info->getId()] = info;
+            sd->updateServer("sylar.top", "svc" + std::to_string(i), items);
+            ++done;
+        });
+    }
+    for(int i = 0; i < 100 && (done < 2 || versions.size() < 3); ++i) {
+        usleep(10 * 1000);
+    }
+    bool ok = done == 2 && versions == std::vector<uint64_t>{1, 2, 3};
+    SYLAR_LOG_INFO(g_logger) << "callback yield: done=" << done
+        << " deltas=" << versions.size() << (ok ? " ok" : " FAIL");
+}
+
+int main(int argc, char** argv) {
+    sylar::IOManager iom(1);
+    iom.schedule(run);
+    iom.schedule(test_load_balance);
+    iom.schedule(test_callback_yield);
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include "sylar/http/servlet.h"
+#include "sylar/log.h"
+#include "sylar/macro.h"
+#include <fnmatch.h>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+typedef sylar::http::RadixRouter<int> RouterType;
+
+void test_match() {
+    RouterType router;
+    router.addExact("/sylar/xx", 1);
+    router.addGlob("/sylar/*", 2, 0);
+    router.addGlob("/sylar/a?c", 3, 1);
+    router.addGlob("*.html", 4, 2);
+    router.addParam("/user/:id/info", 5);
+    router.addParam("/user/:id/:name", 6);
+    router.addParam("/static/*path", 7);
+
+    struct Case {
+        const char* uri;
+        int expect;
+        RouterType::ParamMap params;
+    } cases[] = {
+        {"/sylar/xx", 1, {}},
+        {"/sylar/xy", 2, {}},
+        {"/sylar/abc", 2, {}},
+        {"/index.html", 4, {}},
+        {"/user/10/info", 5, {{"id", "10"}}},
+        {"/user/10/sylar", 6, {{"id", "10"}, {"name", "sylar"}}},
+        {"/static/js/a.js", 7, {{"path", "js/a.js"}}},
+        {"/none", -1, {}},
+    };
+    for(auto& c : cases) {
+        int v = -1;
+        RouterType::ParamMap params;
+        router.match(c.uri, v, &params);
+        std::stringstream ss;
+        for(auto& i : params) {
+            ss << " " << i.first << "=" << i.second;
+        }
+        SYLAR_LOG_INFO(g_logger) << c.uri << " -> " << v
+            << (v == c.expect ? " ok" : " FAIL") << ss.str();
+        SYLAR_ASSERT(v == c.expect);
+        SYLAR_ASSERT(params == c.params);
+    }
+}
+
+void test_dispatch() {
+    RouterType router;
+    SYLAR_ASSERT(!router.addParam("/static/*path/x", 1));
+    SYLAR_ASSERT(router.size() == 0);
+
+    sylar::http::ServletDispatch::ptr dispatch(new sylar::http::ServletDispatch);
+    auto cb = [](sylar::http::HttpRequest::ptr request
+                , sylar::http::HttpResponse::ptr response
+                , sylar::http::HttpSession::ptr session) {
+        return 0;
+    };
+    SYLAR_ASSERT(!dispatch->addParamServlet("/static/*path/x", cb));
+    SYLAR_ASSERT(dispatch->addParamServlet("/user/:id", cb));
+    for(int i = 0; i < 1000; ++i) {
+        dispatch->addServlet("/api/" + std::to_string(i), cb);
+    }
+    std::map<std::string, sylar::http::IServletCreator::ptr> infos;
+    dispatch->listAllParamServletCreator(infos);
+    SYLAR_ASSERT(infos.size() == 1 && infos.count("/user/:id"));
+
+    RouterType::ParamMap params;
+    SYLAR_ASSERT(dispatch->getMatchedServlet("/api/999") != dispatch->getDefault());
+    SYLAR_ASSERT(dispatch->getMatchedServlet("/user/10", &params) != dispatch->getDefault());
+    SYLAR_ASSERT(params["id"] == "10");
+    SYLAR_ASSERT(dispatch->getMatchedServlet("/static/a/x") == dispatch->getDefault());
+    dispatch->delServlet("/api/999");
+    SYLAR_ASSERT(dispatch->getMatchedServlet("/api/999") == dispatch->getDefault());
+    SYLAR_LOG_INFO(g_logger) << "dispatch ok";
+}
+
+void test_bench() {
+    const int ROUTES = 1000;
+    const int LOOKUPS = 100000;
+
+    std::vector<std::string> globs;
+    RouterType router;
+    for(int i = 0; i < ROUTES; ++i) {
+        std::string g = "/api/v1/service_" + std::to_string(i) + "/*";
+        globs.push_back(g);
+        router.addGlob(g, i, i);
+    }
+
+    std::vector<std::string> uris;
+    for(int i = 0; i < 1024; ++i) {
+        if(i % 4 == 0) {
+            uris.push_back("/unmatched/path/" + std::to_string(i));
+        } else {
+            uris.push_back("/api/v1/service_" + std::to_string(rand() % ROUTES)
+                    + "/method_" + std::to_string(i));
+        }
+    }
+
+    uint64_t ts = sylar::GetCurrentUS();
+    int64_t sum = 0;
+    for(int i = 0; i < LOOKUPS; ++i) {
+        const std::string& uri = uris[i & 1023];
+        for(size_t n = 0; n < globs.size(); ++n) {
+            if(!fnmatch(globs[n].c_str(), uri.c_str(), 0)) {
+                sum += n;
+                break;
+            }
+        }
+    }
+    uint64_t linear = sylar::GetCurrentUS() - ts;
+
+    ts = sylar::GetCurrentUS();
+    int64_t sum2 = 0;
+    for(int i = 0; i < LOOKUPS; ++i) {
+        int v = 0;
+        if(router.match(uris[i & 1023], v)) {
+            sum2 += v;
+        }
+    }
+    uint64_t radix = sylar::GetCurrentUS() - ts;
+
+    SYLAR_LOG_INFO(g_logger) << "routes=" << ROUTES << " lookups=" << LOOKUPS
+        << " fnmatch_linear=" << linear << "us (" << (linear * 1000.0 / LOOKUPS) << "ns/op)"
+        << " radix=" << radix << "us (" << (radix * 1000.0 / LOOKUPS) << "ns/op)"
+        << " check=" << (sum == sum2 ? "ok" : "FAIL");
+}
+
+int main(int argc, char** argv) {
+    test_match();
+    test_dispatch();
+    test_bench();
+    return 0;
+}
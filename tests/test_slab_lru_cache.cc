@@ -0,0 +1,115 @@
+#include "sylar/ds/lru_cache.h"
+#include "sylar/ds/slab_lru_cache.h"
+#include "sylar/util.h"
+#include <iostream>
+#include <malloc.h>
+#include <random>
+
+static size_t GetHeapUsed() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#else
+    return mallinfo().uordblks;
+#endif
+}
+
+//与LruCache对比随机操作的结果
+void test_compare() {
+    sylar::ds::LruCache<int, int> lru(1000, 0);
+    sylar::ds::SlabLruCache<int, int> slab(1000);
+    std::mt19937 rng(1);
+    int diff = 0;
+    for(int i = 0; i < 500000; ++i) {
+        int k = rng() % 3000;
+        int op = rng() % 10;
+        if(op < 5) {
+            int v1 = -1, v2 = -1;
+            bool r1 = lru.get(k, v1);
+            bool r2 = slab.get(k, v2);
+            diff += (r1 != r2 || v1 != v2);
+        } else if(op < 9) {
+            lru.set(k, i);
+            slab.set(k, i);
+        } else {
+            diff += (lru.del(k) != slab.del(k));
+        }
+    }
+    std::cout << "compare: size=" << slab.size() << "/" << lru.size()
+              << " diff=" << diff
+              << ((diff == 0 && slab.size() == lru.size()) ? " ok" : " FAIL") << std::endl;
+    std::cout << slab.toStatusString() << std::endl;
+}
+
+void test_bytes() {
+    sylar::ds::SlabLruCache<int, std::string> cache(0, 64 * 1024);
+    cache.setWeigher([](const int& k, const std::string& v) {
+        return v.capacity();
+    });
+    for(int i = 0; i < 1000; ++i) {
+        cache.set(i, std::string(100 + i % 900, 'x'));
+    }
+    std::cout << "bytes: size=" << cache.size() << " bytes=" << cache.getBytes()
+              << " max_bytes=" << cache.getMaxBytes()
+              << ((cache.getBytes() <= cache.getMaxBytes() && cache.exists(999)) ? " ok" : " FAIL")
+              << std::endl;
+}
+
+void test_timeout() {
+    sylar::ds::SlabLruCache<int, int> cache(100);
+    for(int i = 0; i < 50; ++i) {
+        cache.set(i, i, i < 25 ? 0 : 100000);
+    }
+    usleep(10 * 1000);
+    int v = 0;
+    bool hit = cache.get(0, v);
+    size_t n = cache.checkTimeout();
+    std::cout << "timeout: hit(0)=" << hit << " check=" << n << " size=" << cache.size()
+              << ((!hit && n == 24 && cache.size() == 25) ? " ok" : " FAIL") << std::endl;
+}
+
+template<class Cache>
+static void Bench(const std::string& name, Cache& cache, size_t n) {
+    size_t heap = GetHeapUsed();
+    uint64_t ts = sylar::GetCurrentUS();
+    for(size_t i = 0; i < n; ++i) {
+        cache.set(i, i);
+    }
+    uint64_t set_used = sylar::GetCurrentUS() - ts;
+    size_t used_mem = GetHeapUsed() - heap;
+
+    ts = sylar::GetCurrentUS();
+    uint64_t v = 0, sum = 0;
+    std::mt19937_64 rng(1);
+    for(size_t i = 0; i < n; ++i) {
+        if(cache.get(rng() % n, v)) {
+            sum += v;
+        }
+    }
+    uint64_t get_used = sylar::GetCurrentUS() - ts;
+    std::cout << name << ": n=" << n
+              << " set=" << set_used / 1000.0 << "ms"
+              << " get=" << get_used / 1000.0 << "ms"
+              << " heap_bytes_per_entry=" << used_mem * 1.0 / n
+              << " sum=" << sum << std::endl;
+}
+
+void test_bench() {
+    const size_t n = 2000000;
+    {
+        sylar::ds::LruCache<uint64_t, uint64_t> cache(n, 0);
+        Bench("LruCache", cache, n);
+    }
+    {
+        sylar::ds::SlabLruCache<uint64_t, uint64_t> cache(n);
+        Bench("SlabLruCache", cache, n);
+        std::cout << "SlabLruCache bytes_per_entry=" << cache.getBytesPerEntry() << std::endl;
+    }
+}
+
+int main(int argc, char** argv) {
+    test_compare();
+    test_bytes();
+    test_timeout();
+    test_bench();
+    return 0;
+}
@@ -0,0 +1,375 @@
+#include "sylar/db/sqlite3.h"
+#include "sylar/log.h"
+#include "sylar/macro.h"
+#include "sylar/util.h"
+#include "sylar/iomanager.h"
+#include <atomic>
+#include <thread>
+#include <iostream>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static const char* s_create_sql = "create table if not exists user ("
+        "id integer primary key, name varchar(50) not null default \"\", age int not null default 0)";
+
+static void remove_db(const std::string& path) {
+    unlink(path.c_str());
+    unlink((path + "-wal").c_str());
+    unlink((path + "-shm").c_str());
+}
+
+static int64_t count_rows(sylar::SQLite3::ptr db) {
+    auto data = db->queryStmt("select count(*) from user");
+    if(!data || !data->next()) {
+        return -1;
+    }
+    return data->getInt64(0);
+}
+
+void test_stmt_cache(sylar::SQLite3::ptr db) {
+    db->setStmtCacheSize(4);
+    SYLAR_ASSERT(db->execStmt("insert into user(id, name, age) values(?, ?, ?)", 1, std::string("a"), 10) == SQLITE_OK);
+    SYLAR_ASSERT(db->execStmt("insert into user(id, name, age) values(?, ?, ?)", 2, std::string("b"), 20) == SQLITE_OK);
+
+    //同一条SQL同时使用两次
+    auto d1 = db->queryStmt("select name from user where id = ?", 1);
+    auto d2 = db->queryStmt("select name from user where id = ?", 2);
+    SYLAR_ASSERT(d1 && d1->next() && d1->getString(0) == "a");
+    SYLAR_ASSERT(d2 && d2->next() && d2->getString(0) == "b");
+    d1 = nullptr;
+    d2 = nullptr;
+
+    //放回缓存的语句已清空绑定
+    auto stmt = db->prepareCached("select count(*) from user where id = ?");
+    auto data = stmt->query();
+    SYLAR_ASSERT(data->next() && data->getInt64(0) == 0);
+    data = nullptr;
+    stmt = nullptr;
+
+    for(int i = 0; i < 10; ++i) {
+        auto d = db->queryStmt(("select " + std::to_string(i) + " + ?").c_str(), 1);
+        SYLAR_ASSERT(d && d->next() && d->getInt32(0) == i + 1);
+    }
+    std::cout << "stmt cache " << db->getStmtCacheStatus() << std::endl;
+    SYLAR_ASSERT(db->execute("delete from user") == SQLITE_OK);
+    db->setStmtCacheSize(64);
+    std::cout << "stmt cache ok" << std::endl;
+}
+
+void test_insert_batch(sylar::SQLite3::ptr db) {
+    int n = 10007;
+    int rt = db->insertBatch("user", {"id", "name", "age"}, n
+            ,[](sylar::SQLite3Stmt::ptr stmt, int offset, size_t row) {
+        int rt = stmt->bind(offset + 1, (int64_t)row + 1);
+        rt = rt ? rt : stmt->bind(offset + 2, "batch_" + std::to_string(row));
+        return rt ? rt : stmt->bind(offset + 3, (int32_t)(row % 100));
+    });
+    SYLAR_ASSERT(rt == SQLITE_OK);
+    SYLAR_ASSERT(count_rows(db) == n);
+    auto d = db->queryStmt("select name, age from user where id = ?", 5000);
+    SYLAR_ASSERT(d && d->next() && d->getString(0) == "batch_4999" && d->getInt32(1) == 99);
+
+    //中途失败整批回滚
+    rt = db->insertBatch("user", {"id", "name"}, 1000
+            ,[n](sylar::SQLite3Stmt::ptr stmt, int offset, size_t row) {
+        if(row == 900) {
+            return SQLITE_ABORT;
+        }
+        int rt = stmt->bind(offset + 1, (int64_t)(n + row + 1));
+        return rt ? rt : stmt->bind(offset + 2, "rollback");
+    });
+    SYLAR_ASSERT(rt == SQLITE_ABORT);
+    SYLAR_ASSERT(count_rows(db) == n);
+    SYLAR_ASSERT(sqlite3_get_autocommit(db->getDB()));
+    std::cout << "insert batch ok" << std::endl;
+}
+
+void test_wal_pool(const std::string& path) {
+    remove_db(path);
+    sylar::SQLite3Mgr::GetInstance()->registerSQLite3("wal_test", {{"path", path}
+            ,{"wal", "1"}, {"readers", "4"}, {"sql", s_create_sql}});
+
+    std::atomic<bool> stop(false);
+    std::atomic<int> read_errors(0);
+    std::atomic<int> reads(0);
+    std::vector<std::thread> readers;
+    for(int i = 0; i < 4; ++i) {
+        readers.push_back(std::thread([&]() {
+            while(!stop) {
+                auto data = sylar::SQLite3Mgr::GetInstance()->query("wal_test"
+                        , "select count(*) from user");
+                if(!data || !data->next() || data->getErrno() != SQLITE_OK) {
+                    ++read_errors;
+                }
+                ++reads;
+            }
+        }));
+    }
+
+    std::vector<std::thread> writers;
+    for(int t = 0; t < 2; ++t) {
+        writers.push_back(std::thread([t]() {
+            for(int i = 0; i < 200; ++i) {
+                auto db = sylar::SQLite3Mgr::GetInstance()->getWriter("wal_test");
+                db->execStmt("insert into user(id, name) values(?, ?)"
+                        ,(int64_t)(t * 1000 + i + 1), std::string("wal"));
+            }
+        }));
+    }
+    for(auto& i : writers) {
+        i.join();
+    }
+    stop = true;
+    for(auto& i : readers) {
+        i.join();
+    }
+    auto data = sylar::SQLite3Mgr::GetInstance()->query("wal_test", "select count(*) from user");
+    SYLAR_ASSERT(data && data->next() && data->getInt64(0) == 400);
+    SYLAR_ASSERT(read_errors == 0);
+
+    //协程中等待写连接
+    std::atomic<int> done(0);
+    {
+        sylar::IOManager iom(2, false);
+        for(int i = 0; i < 20; ++i) {
+            iom.schedule([&done, i]() {
+                auto db = sylar::SQLite3Mgr::GetInstance()->getWriter("wal_test");
+                auto trans = db->openTransaction();
+                db->execStmt("insert into user(id, name) values(?, ?)"
+                        ,(int64_t)(10000 + i), std::string("fiber"));
+                //持有写连接时让出
+                usleep(1000);
+                trans->commit();
+                ++done;
+            });
+        }
+    }
+    SYLAR_ASSERT(done == 20);
+    data = sylar::SQLite3Mgr::GetInstance()->query("wal_test", "select count(*) from user");
+    SYLAR_ASSERT(data && data->next() && data->getInt64(0) == 420);
+
+    //持有写连接时再通过管理器写入, 拿到同一个连接而不是等待自己
+    auto mgr = sylar::SQLite3Mgr::GetInstance();
+    {
+        auto db = mgr->getWriter("wal_test");
+        SYLAR_ASSERT(mgr->get("wal_test") == db);
+        SYLAR_ASSERT(mgr->execute("wal_test", "insert into user(id, name) values(20000, 'nested')") == SQLITE_OK);
+    }
+    {
+        sylar::IOManager iom(1, false);
+        iom.schedule([mgr, &done]() {
+            auto db = mgr->getWriter("wal_test");
+            auto trans = mgr->openTransaction("wal_test", false);
+            SYLAR_ASSERT(trans && trans->begin());
+            SYLAR_ASSERT(mgr->execute("wal_test", "insert into user(id, name) values(20001, 'nested')") == SQLITE_OK);
+            SYLAR_ASSERT(trans->commit());
+            ++done;
+        });
+    }
+    SYLAR_ASSERT(done == 21);
+    //全部释放后其他线程可以获取
+    std::thread([mgr]() {
+        SYLAR_ASSERT(mgr->execute("wal_test", "insert into user(id, name) values(20002, 'nested')") == SQLITE_OK);
+    }).join();
+    data = mgr->query("wal_test", "select count(*) from user");
+    SYLAR_ASSERT(data && data->next() && data->getInt64(0) == 423);
+    std::cout << "wal pool ok reads=" << reads << std::endl;
+}
+
+void bench(sylar::SQLite3::ptr db, int n) {
+    SYLAR_ASSERT(db->execute("delete from user") == SQLITE_OK);
+    uint64_t ts = sylar::GetCurrentUS();
+    {
+        sylar::SQLite3Transaction trans(db);
+        trans.begin();
+        for(int i = 0; i < n; ++i) {
+            auto stmt = sylar::SQLite3Stmt::Create(db, "insert into user(id, name, age) values(?, ?, ?)");
+            stmt->bind(1, (int64_t)i + 1);
+            stmt->bind(2, "name_" + std::to_string(i));
+            stmt->bind(3, i % 100);
+            stmt->execute();
+        }
+        trans.commit();
+    }
+    uint64_t used = sylar::GetCurrentUS() - ts;
+    std::cout << "insert prepare_each   n=" << n << " " << (n * 1000000.0 / used) << " rows/s" << std::endl;
+
+    SYLAR_ASSERT(db->execute("delete from user") == SQLITE_OK);
+    ts = sylar::GetCurrentUS();
+    {
+        sylar::SQLite3Transaction trans(db);
+        trans.begin();
+        for(int i = 0; i < n; ++i) {
+            db->execStmt("insert into user(id, name, age) values(?, ?, ?)"
+                    ,(int64_t)i + 1, "name_" + std::to_string(i), i % 100);
+        }
+        trans.commit();
+    }
+    used = sylar::GetCurrentUS() - ts;
+    std::cout << "insert stmt_cache     n=" << n << " " << (n * 1000000.0 / used) << " rows/s" << std::endl;
+
+    SYLAR_ASSERT(db->execute("delete from user") == SQLITE_OK);
+    ts = sylar::GetCurrentUS();
+    db->insertBatch("user", {"id", "name", "age"}, n
+            ,[](sylar::SQLite3Stmt::ptr stmt, int offset, size_t row) {
+        stmt->bind(offset + 1, (int64_t)row + 1);
+        stmt->bind(offset + 2, "name_" + std::to_string(row));
+        return stmt->bind(offset + 3, (int32_t)(row % 100));
+    });
+    used = sylar::GetCurrentUS() - ts;
+    std::cout << "insert insertBatch    n=" << n << " " << (n * 1000000.0 / used) << " rows/s" << std::endl;
+    SYLAR_ASSERT(count_rows(db) == n);
+
+    int64_t sum = 0;
+    ts = sylar::GetCurrentUS();
+    for(int i = 0; i < n; ++i) {
+        auto stmt = sylar::SQLite3Stmt::Create(db, "select age from user where id = ?");
+        stmt->bind(1, (int64_t)(i * 7919 % n) + 1);
+        auto data = stmt->query();
+        if(data->next()) {
+            sum += data->getInt32(0);
+        }
+    }
+    used = sylar::GetCurrentUS() - ts;
+    std::cout << "lookup prepare_each   n=" << n << " " << (n * 1000000.0 / used) << " queries/s" << std::endl;
+
+    int64_t sum2 = 0;
+    ts = sylar::GetCurrentUS();
+    for(int i = 0; i < n; ++i) {
+        auto data = db->queryStmt("select age from user where id = ?", (int64_t)(i * 7919 % n) + 1);
+        if(data->next()) {
+            sum2 += data->getInt32(0);
+        }
+    }
+    used = sylar::GetCurrentUS() - ts;
+    std::cout << "lookup stmt_cache     n=" << n << " " << (n * 1000000.0 / used) << " queries/s" << std::endl;
+    SYLAR_ASSERT(sum == sum2);
+}
+
+//需要表中有id为1..10的行
+void test_fetch_batch(sylar::SQLite3::ptr db) {
+    auto data = db->queryStmt("select id, name, age, age * 1.5 as f, null as z from user"
+            " where id <= ? order by id", 10);
+    sylar::SQLColumnBatch batch;
+    SYLAR_ASSERT(data->fetchBatch(batch, 4) == 4);
+    SYLAR_ASSERT(batch.getRows() == 4 && batch.getColumnCount() == 5);
+    SYLAR_ASSERT(batch.getColumn(0).type == sylar::SQLColumnBatch::INT64);
+    SYLAR_ASSERT(batch.getColumn(1).type == sylar::SQLColumnBatch::STRING);
+    SYLAR_ASSERT(batch.getColumn(3).type == sylar::SQLColumnBatch::DOUBLE);
+    SYLAR_ASSERT(batch.getColumnIndex("f") == 3);
+    SYLAR_ASSERT(batch.getInt64(0, 0) == 1 && batch.getInt64(3, 0) == 4);
+    size_t len = 0;
+    const char* v = batch.getData(1, 1, &len);
+    SYLAR_ASSERT(std::string(v, len) == "name_1");
+    SYLAR_ASSERT(batch.getString(2, 1) == "name_2");
+    SYLAR_ASSERT(batch.getDouble(2, 3) == batch.getInt64(2, 2) * 1.5);
+    SYLAR_ASSERT(batch.isNull(0, 4) && !batch.isNull(0, 1));
+
+    //剩余6行按每批3行流式处理, 行数恰好整除时不会重新执行语句
+    size_t batches = 0;
+    int64_t last = 0;
+    size_t total = data->foreachBatch(3, [&batches, &last](const sylar::SQLColumnBatch& b) {
+        ++batches;
+        last = b.getInt64(b.getRows() - 1, 0);
+        return true;
+    });
+    SYLAR_ASSERT(total == 6 && batches == 2 && last == 10);
+    SYLAR_ASSERT(!data->next());
+    SYLAR_ASSERT(data->fetchBatch(batch, 4) == 0);
+
+    //提前停止
+    data = db->queryStmt("select id from user order by id");
+    total = data->foreachBatch(100, [](const sylar::SQLColumnBatch& b) {
+        return false;
+    });
+    SYLAR_ASSERT(total == 100);
+
+    //表达式列的值类型逐行变宽时提升列类型, 已有的值不截断
+    data = db->queryStmt("select case when id = 1 then 1 when id = 2 then 2.75"
+            " when id = 3 then null else 'x' end as e from user where id <= 4 order by id");
+    SYLAR_ASSERT(data->fetchBatch(batch, 10) == 4);
+    SYLAR_ASSERT(batch.getColumnCount() == 1);
+    SYLAR_ASSERT(batch.getColumn(0).type == sylar::SQLColumnBatch::STRING);
+    SYLAR_ASSERT(batch.getString(0, 0) == "1" && batch.getString(1, 0) == "2.75");
+    SYLAR_ASSERT(batch.getDouble(1, 0) == 2.75 && batch.isNull(2, 0));
+    SYLAR_ASSERT(batch.getString(3, 0) == "x");
+    data = db->queryStmt("select case when id = 1 then 1 else 2.75 end from user"
+            " where id <= 2 order by id");
+    SYLAR_ASSERT(data->fetchBatch(batch, 10) == 2);
+    SYLAR_ASSERT(batch.getColumn(0).type == sylar::SQLColumnBatch::DOUBLE);
+    SYLAR_ASSERT(batch.getDouble(0, 0) == 1 && batch.getDouble(1, 0) == 2.75);
+
+    //同一个batch交替用于多个结果集(结果集释放后地址可能被复用), 每次都按当前结果集重建列定义
+    for(int i = 0; i < 10; ++i) {
+        data = db->queryStmt(i % 2 ? "select name from user where id <= ?"
+                : "select id, age, name from user where id <= ?", 2);
+        SYLAR_ASSERT(data->fetchBatch(batch, 1) == 1);
+        SYLAR_ASSERT(batch.getColumnCount() == (i % 2 ? 1u : 3u));
+        SYLAR_ASSERT(batch.getString(0, i % 2 ? 0 : 2) == "name_0");
+    }
+    auto a = db->queryStmt("select id from user where id <= 2 order by id");
+    auto b = db->queryStmt("select name from user where id <= 2 order by id");
+    SYLAR_ASSERT(a->fetchBatch(batch, 1) == 1 && batch.getInt64(0, 0) == 1);
+    SYLAR_ASSERT(b->fetchBatch(batch, 1) == 1 && batch.getString(0, 0) == "name_0");
+    SYLAR_ASSERT(a->fetchBatch(batch, 1) == 1 && batch.getColumn(0).type == sylar::SQLColumnBatch::INT64);
+    SYLAR_ASSERT(batch.getInt64(0, 0) == 2);
+    std::cout << "fetch batch ok" << std::endl;
+}
+
+void bench_scan(sylar::SQLite3::ptr db, int n) {
+    int64_t sum = 0;
+    size_t bytes = 0;
+    uint64_t ts = sylar::GetCurrentUS();
+    auto data = db->queryStmt("select id, name, age from user");
+    while(data->next()) {
+        sum += data->getInt64(0) + data->getInt32(2);
+        bytes += data->getString(1).size();
+    }
+    uint64_t used = sylar::GetCurrentUS() - ts;
+    std::cout << "scan next/getX       rows=" << n << " " << (n * 1000000.0 / used) << " rows/s" << std::endl;
+
+    int64_t sum2 = 0;
+    size_t bytes2 = 0;
+    ts = sylar::GetCurrentUS();
+    data = db->queryStmt("select id, name, age from user");
+    data->foreachBatch(1024, [&sum2, &bytes2](const sylar::SQLColumnBatch& b) {
+        auto& ids = b.getColumn(0).ints;
+        auto& ages = b.getColumn(2).ints;
+        auto& names = b.getColumn(1);
+        for(size_t i = 0; i < b.getRows(); ++i) {
+            sum2 += ids[i] + ages[i];
+        }
+        bytes2 += names.arena.size();
+        return true;
+    });
+    used = sylar::GetCurrentUS() - ts;
+    std::cout << "scan foreachBatch    rows=" << n << " " << (n * 1000000.0 / used) << " rows/s" << std::endl;
+    SYLAR_ASSERT(sum == sum2 && bytes == bytes2);
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(sylar::LogLevel::WARN);
+    int n = argc > 1 ? atoi(argv[1]) : 100000;
+    const std::string path = "test_sqlite3_bench.db";
+    remove_db(path);
+    auto db = sylar::SQLite3::Create(path);
+    if(!db) {
+        SYLAR_LOG_ERROR(g_logger) << "open " << path << " fail";
+        return 1;
+    }
+    SYLAR_ASSERT(db->execute(s_create_sql) == SQLITE_OK);
+    test_stmt_cache(db);
+    test_insert_batch(db);
+    bench(db, n);
+    test_fetch_batch(db);
+    bench_scan(db, n);
+    db = nullptr;
+    remove_db(path);
+
+    //SQLite3Manager把相对路径当作相对server.work_path
+    char cwd[1024] = {0};
+    std::string wal_path = std::string(getcwd(cwd, sizeof(cwd) - 1)) + "/test_sqlite3_wal.db";
+    test_wal_pool(wal_path);
+    remove_db(wal_path);
+    return 0;
+}
@@ -0,0 +1,217 @@
+#include "sylar/http/servlets/static_file_servlet.h"
+#include "sylar/http/http_session.h"
+#include "sylar/config.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include "sylar/macro.h"
+#include <fstream>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+static std::string s_root;
+
+static void write_file(const std::string& name, const std::string& data) {
+    std::ofstream ofs(s_root + "/" + name, std::ios::binary | std::ios::trunc);
+    ofs << data;
+}
+
+static std::string make_data(size_t size) {
+    std::string data(size, '\0');
+    for(size_t i = 0; i < size; ++i) {
+        data[i] = 'a' + i % 26;
+    }
+    return data;
+}
+
+static sylar::http::HttpResponse::ptr request(sylar::http::StaticFileServlet::ptr servlet
+                    ,const std::string& path
+                    ,const std::map<std::string, std::string>& headers = {}) {
+    sylar::http::HttpRequest::ptr req(new sylar::http::HttpRequest);
+    req->setPath(path);
+    for(auto& i : headers) {
+        req->setHeader(i.first, i.second);
+    }
+    sylar::http::HttpResponse::ptr rsp(new sylar::http::HttpResponse);
+    servlet->handle(req, rsp, nullptr);
+    return rsp;
+}
+
+void test_parse_range() {
+    uint64_t b = 0;
+    uint64_t l = 0;
+    using sylar::http::StaticFileServlet;
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("bytes=0-9", 100, b, l) == 1 && b == 0 && l == 10);
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("bytes=90-", 100, b, l) == 1 && b == 90 && l == 10);
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("bytes=-10", 100, b, l) == 1 && b == 90 && l == 10);
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("bytes=-1000", 100, b, l) == 1 && b == 0 && l == 100);
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("bytes=50-1000", 100, b, l) == 1 && b == 50 && l == 50);
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("BYTES= 1-1 ", 100, b, l) == 1 && b == 1 && l == 1);
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("bytes=100-", 100, b, l) == -1);
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("bytes=9-1", 100, b, l) == -1);
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("bytes=-0", 100, b, l) == -1);
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("bytes=x-1", 100, b, l) == -1);
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("bytes=-1", 0, b, l) == -1);
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("bytes=0-1,3-4", 100, b, l) == 0);
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("items=0-1", 100, b, l) == 0);
+    SYLAR_ASSERT(StaticFileServlet::ParseRange("bytes=5", 100, b, l) == 0);
+    std::cout << "parse range ok" << std::endl;
+}
+
+void test_handle() {
+    sylar::http::StaticFileServlet::ptr servlet(
+            new sylar::http::StaticFileServlet(s_root, "/static"));
+    auto rsp = request(servlet, "/static/small.txt");
+    SYLAR_ASSERT(rsp->getStatus() == sylar::http::HttpStatus::OK);
+    SYLAR_ASSERT(rsp->getHeader("Content-Type") == "text/plain; charset=utf-8");
+    SYLAR_ASSERT(rsp->getFileBody() && rsp->getFileBody()->data
+            && rsp->getFileBody()->length == 100);
+    std::string etag = rsp->getHeader("ETag");
+    std::string last_modified = rsp->getHeader("Last-Modified");
+    SYLAR_ASSERT(!etag.empty() && !last_modified.empty());
+
+    rsp = request(servlet, "/static/small.txt", {{"If-None-Match", etag}});
+    SYLAR_ASSERT(rsp->getStatus() == sylar::http::HttpStatus::NOT_MODIFIED && !rsp->getFileBody());
+    rsp = request(servlet, "/static/small.txt", {{"If-Modified-Since", last_modified}});
+    SYLAR_ASSERT(rsp->getStatus() == sylar::http::HttpStatus::NOT_MODIFIED);
+    rsp = request(servlet, "/static/small.txt", {{"If-None-Match", "\"other\""}
+                ,{"If-Modified-Since", last_modified}});
+    SYLAR_ASSERT(rsp->getStatus() == sylar::http::HttpStatus::OK);
+
+    rsp = request(servlet, "/static/small.txt", {{"Range", "bytes=10-19"}});
+    SYLAR_ASSERT(rsp->getStatus() == sylar::http::HttpStatus::PARTIAL_CONTENT);
+    SYLAR_ASSERT(rsp->getHeader("Content-Range") == "bytes 10-19/100");
+    SYLAR_ASSERT(rsp->getFileBody() && rsp->getFileBody()->offset == 10
+            && rsp->getFileBody()->length == 10);
+    rsp = request(servlet, "/static/small.txt", {{"Range", "bytes=100-"}});
+    SYLAR_ASSERT(rsp->getStatus() == sylar::http::HttpStatus::RANGE_NOT_SATISFIABLE);
+    SYLAR_ASSERT(rsp->getHeader("Content-Range") == "bytes */100");
+    SYLAR_ASSERT(!rsp->getFileBody());
+    //If-Range不匹配时忽略Range
+    rsp = request(servlet, "/static/small.txt", {{"Range", "bytes=100-"}
+                ,{"If-Range", "\"other\""}});
+    SYLAR_ASSERT(rsp->getStatus() == sylar::http::HttpStatus::OK);
+
+    SYLAR_ASSERT(request(servlet, "/static/../secret.txt")->getStatus()
+            == sylar::http::HttpStatus::FORBIDDEN);
+    SYLAR_ASSERT(request(servlet, "/static/%2e%2e/secret.txt")->getStatus()
+            == sylar::http::HttpStatus::FORBIDDEN);
+    SYLAR_ASSERT(request(servlet, "/static/sub/..")->getStatus()
+            == sylar::http::HttpStatus::FORBIDDEN);
+    SYLAR_ASSERT(request(servlet, "/static/none.txt")->getStatus()
+            == sylar::http::HttpStatus::NOT_FOUND);
+    SYLAR_ASSERT(request(servlet, "/static/sub")->getStatus()
+            == sylar::http::HttpStatus::NOT_FOUND);
+    //前缀只匹配完整的路径段
+    SYLAR_ASSERT(request(servlet, "/staticsmall.txt")->getStatus()
+            == sylar::http::HttpStatus::NOT_FOUND);
+    sylar::http::StaticFileServlet::ptr slash(
+            new sylar::http::StaticFileServlet(s_root, "/static/"));
+    SYLAR_ASSERT(request(slash, "/static/small.txt")->getStatus()
+            == sylar::http::HttpStatus::OK);
+
+    rsp = request(servlet, "/static/big.bin");
+    SYLAR_ASSERT(rsp->getStatus() == sylar::http::HttpStatus::OK);
+    SYLAR_ASSERT(rsp->getFileBody() && !rsp->getFileBody()->data
+            && rsp->getFileBody()->fd >= 0);
+    std::cout << "handle ok" << std::endl;
+}
+
+/**
+ * @brief 通过真实连接发送响应, 返回sendResponse的返回值, 对端收到的数据放到out
+ */
+static int send_response(sylar::http::HttpResponse::ptr rsp, std::string& out) {
+    auto addr = sylar::Address::LookupAnyIPAddress("127.0.0.1:0");
+    sylar::Socket::ptr server = sylar::Socket::CreateTCP(addr);
+    server->bind(addr);
+    server->listen();
+    auto local = server->getLocalAddress();
+
+    bool done = false;
+    out.clear();
+    sylar::IOManager::GetThis()->schedule([local, &out, &done](){
+        sylar::Socket::ptr client = sylar::Socket::CreateTCP(local);
+        client->connect(local);
+        char buf[4096];
+        int rt = 0;
+        while((rt = client->recv(buf, sizeof(buf))) > 0) {
+            out.append(buf, rt);
+        }
+        done = true;
+    });
+
+    sylar::Socket::ptr sock = server->accept();
+    sylar::http::HttpSession::ptr session(new sylar::http::HttpSession(sock));
+    int rt = session->sendResponse(rsp);
+    session->close();
+    while(!done) {
+        usleep(1000);
+    }
+    return rt;
+}
+
+static std::string body_of(const std::string& data) {
+    size_t pos = data.find("\r\n\r\n");
+    return pos == std::string::npos ? "" : data.substr(pos + 4);
+}
+
+void test_send() {
+    sylar::http::StaticFileServlet::ptr servlet(
+            new sylar::http::StaticFileServlet(s_root, "/static"));
+    std::string out;
+    //小文件: 响应头和内存中的内容一起writev
+    auto rsp = request(servlet, "/static/small.txt", {{"Range", "bytes=-30"}});
+    SYLAR_ASSERT(send_response(rsp, out) > 0);
+    SYLAR_ASSERT(out.find("content-length: 30\r\n") != std::string::npos);
+    SYLAR_ASSERT(body_of(out) == make_data(100).substr(70));
+
+    //大文件: 响应头之后sendfile
+    rsp = request(servlet, "/static/big.bin");
+    SYLAR_ASSERT(send_response(rsp, out) > 0);
+    SYLAR_ASSERT(body_of(out) == make_data(1024 * 1024));
+    rsp = request(servlet, "/static/big.bin", {{"Range", "bytes=1000-200999"}});
+    SYLAR_ASSERT(send_response(rsp, out) > 0);
+    SYLAR_ASSERT(body_of(out) == make_data(1024 * 1024).substr(1000, 200000));
+
+    //打开后文件被截断: sendfile读到文件末尾, 不能当作发送成功
+    rsp = request(servlet, "/static/big.bin");
+    SYLAR_ASSERT(truncate((s_root + "/big.bin").c_str(), 1000) == 0);
+    SYLAR_ASSERT(send_response(rsp, out) < 0);
+    SYLAR_ASSERT(body_of(out).size() == 1000);
+
+    //小文件内容在打开时读入内存, 之后被截断也能完整发送当时的内容
+    write_file("shrink.txt", make_data(2000));
+    rsp = request(servlet, "/static/shrink.txt");
+    SYLAR_ASSERT(truncate((s_root + "/shrink.txt").c_str(), 0) == 0);
+    SYLAR_ASSERT(send_response(rsp, out) > 0);
+    SYLAR_ASSERT(body_of(out) == make_data(2000));
+    std::cout << "send ok" << std::endl;
+}
+
+void run() {
+    test_parse_range();
+    test_handle();
+    test_send();
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(sylar::LogLevel::WARN);
+    char tmpl[] = "/tmp/static_file_servlet_XXXXXX";
+    s_root = mkdtemp(tmpl);
+    SYLAR_ASSERT(mkdir((s_root + "/sub").c_str(), 0755) == 0);
+    write_file("small.txt", make_data(100));
+    write_file("big.bin", make_data(1024 * 1024));
+    sylar::Config::Lookup<uint64_t>("http.static_file.preload_max_size")->setValue(64 * 1024);
+    {
+        sylar::IOManager iom(1);
+        iom.schedule(run);
+    }
+    for(auto& i : {"small.txt", "big.bin", "shrink.txt"}) {
+        unlink((s_root + "/" + i).c_str());
+    }
+    rmdir((s_root + "/sub").c_str());
+    rmdir(s_root.c_str());
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "sylar/ds/lru_cache.h"
+#include "sylar/ds/tinylfu_cache.h"
+#include "sylar/thread.h"
+#include "sylar/util.h"
+#include <cmath>
+#include <iostream>
+#include <random>
+
+static const uint64_t s_keys = 100000;
+static const size_t s_cacheSize = 2000;
+static const size_t s_traceSize = 1000000;
+
+//Zipf分布, 预先计算CDF后二分查找
+static std::vector<uint64_t> GenZipf(size_t n, uint64_t keys, double s, uint32_t seed) {
+    std::vector<double> cdf(keys);
+    double sum = 0;
+    for(uint64_t i = 0; i < keys; ++i) {
+        sum += 1.0 / std::pow(i + 1, s);
+        cdf[i] = sum;
+    }
+    std::mt19937_64 rng(seed);
+    std::uniform_real_distribution<double> dist(0, sum);
+    std::vector<uint64_t> trace;
+    trace.reserve(n);
+    for(size_t i = 0; i < n; ++i) {
+        trace.push_back(std::lower_bound(cdf.begin(), cdf.end(), dist(rng)) - cdf.begin());
+    }
+    return trace;
+}
+
+//每20000次热点访问后插入一次5000个冷key的顺序扫描
+static std::vector<uint64_t> GenScan(size_t n, uint64_t keys, uint32_t seed) {
+    std::vector<uint64_t> zipf = GenZipf(n, keys, 0.9, seed);
+    std::vector<uint64_t> trace;
+    trace.reserve(n * 2);
+    uint64_t cold = keys;
+    for(size_t i = 0; i < zipf.size(); ++i) {
+        trace.push_back(zipf[i]);
+        if(i % 20000 == 19999) {
+            for(int j = 0; j < 5000; ++j) {
+                trace.push_back(cold++);
+            }
+        }
+    }
+    return trace;
+}
+
+template<class Cache>
+static void Replay(Cache& cache, const std::vector<uint64_t>& trace) {
+    uint64_t v;
+    for(auto& k : trace) {
+        if(!cache.get(k, v)) {
+            cache.set(k, k);
+        }
+    }
+}
+
+template<class Cache>
+static void Bench(const std::string& name, Cache& cache, const std::vector<uint64_t>& trace) {
+    uint64_t ts = sylar::GetCurrentUS();
+    Replay(cache, trace);
+    uint64_t used = sylar::GetCurrentUS() - ts;
+    std::cout << name << ": hit_rate=" << cache.getStatus()->getHitRate() * 100 << "%"
+              << " ops=" << trace.size() << " used=" << used / 1000.0 << "ms"
+              << " qps=" << (uint64_t)(trace.size() * 1000000.0 / (used ? used : 1))
+              << std::endl;
+}
+
+template<class Cache>
+static void BenchThreads(const std::string& name, Cache& cache
+                         ,const std::vector<std::vector<uint64_t> >& traces) {
+    std::vector<sylar::Thread::ptr> thrs;
+    uint64_t ts = sylar::GetCurrentUS();
+    size_t total = 0;
+    for(size_t i = 0; i < traces.size(); ++i) {
+        total += traces[i].size();
+        thrs.push_back(std::make_shared<sylar::Thread>([&cache, &traces, i](){
+            Replay(cache, traces[i]);
+        }, name + "_" + std::to_string(i)));
+    }
+    for(auto& i : thrs) {
+        i->join();
+    }
+    uint64_t used = sylar::GetCurrentUS() - ts;
+    std::cout << name << " threads=" << traces.size()
+              << ": hit_rate=" << cache.getStatus()->getHitRate() * 100 << "%"
+              << " used=" << used / 1000.0 << "ms"
+              << " qps=" << (uint64_t)(total * 1000000.0 / (used ? used : 1))
+              << std::endl;
+}
+
+void test_trace(const std::string& name, const std::vector<uint64_t>& trace) {
+    std::cout << "==== " << name << " trace=" << trace.size()
+              << " cache_size=" << s_cacheSize << " ====" << std::endl;
+    sylar::ds::LruCache<uint64_t, uint64_t> lru(s_cacheSize, 0);
+    Bench("LruCache", lru, trace);
+    sylar::ds::TinyLfuCache<uint64_t, uint64_t> lfu(s_cacheSize);
+    Bench("TinyLfuCache", lfu, trace);
+    std::cout << lfu.toStatusString() << std::endl;
+}
+
+void test_threads() {
+    const int N = 4;
+    std::vector<std::vector<uint64_t> > traces;
+    for(int i = 0; i < N; ++i) {
+        traces.push_back(GenZipf(s_traceSize, s_keys, 0.9, i + 100));
+    }
+    std::cout << "==== zipf multi thread ====" << std::endl;
+    sylar::ds::HashLruCache<uint64_t, uint64_t> lru(16, s_cacheSize * 4, 0);
+    BenchThreads("HashLruCache", lru, traces);
+    sylar::ds::HashTinyLfuCache<uint64_t, uint64_t> lfu(16, s_cacheSize * 4);
+    BenchThreads("HashTinyLfuCache", lfu, traces);
+}
+
+void test_basic() {
+    sylar::ds::TinyLfuCache<int, int> cache(100);
+    int pruned = 0;
+    cache.setPruneCallback([&pruned](const int& k, const int& v) {
+        ++pruned;
+    });
+    //热点key访问多次, 之后的扫描不应把它们挤出
+    for(int r = 0; r < 10; ++r) {
+        for(int i = 0; i < 50; ++i) {
+            int v;
+            if(!cache.get(i, v)) {
+                cache.set(i, i * 100);
+            }
+        }
+    }
+    for(int i = 1000; i < 11000; ++i) {
+        cache.set(i, i);
+    }
+    cache.cleanUp();
+    int hot = 0;
+    for(int i = 0; i < 50; ++i) {
+        hot += cache.exists(i);
+    }
+    cache.del(1);
+    std::cout << "basic: size=" << cache.size() << " hot=" << hot
+              << " pruned=" << pruned << " get(2)=" << cache.get(2)
+              << " exists(1)=" << cache.exists(1)
+              << ((hot >= 49 && cache.size() <= 100) ? " ok" : " FAIL")
+              << std::endl;
+    std::cout << cache.toStatusString() << std::endl;
+}
+
+int main(int argc, char** argv) {
+    test_basic();
+    test_trace("zipf(0.9)", GenZipf(s_traceSize, s_keys, 0.9, 1));
+    test_trace("scan", GenScan(s_traceSize, s_keys, 2));
+    test_threads();
+    return 0;
+}
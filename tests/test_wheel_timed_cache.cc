@@ -0,0 +1,149 @@
+#include "sylar/ds/timed_cache.h"
+#include "sylar/ds/wheel_timed_cache.h"
+#include "sylar/util.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+void test_wheel_timed_cache() {
+    sylar::ds::WheelTimedCache<int, int> cache(30, 10, nullptr, 10, 64);
+    int pruned = 0;
+    cache.setPruneCallback([&pruned](const int& k, const int& v) {
+        ++pruned;
+    });
+    for(int i = 0; i < 105; ++i) {
+        cache.set(i, i * 100, 1000 + i);
+    }
+    //容量淘汰最早过期的
+    std::cout << "prune: size=" << cache.size() << " pruned=" << pruned
+              << " exists(0)=" << cache.exists(0) << " exists(104)=" << cache.exists(104)
+              << ((!cache.exists(0) && cache.exists(104)) ? " ok" : " FAIL") << std::endl;
+
+    cache.set(1000, 11, 20);
+    cache.expired(104, 20);
+    usleep(50 * 1000);
+    //惰性过期: 未清理前读取也不命中
+    int v = 0;
+    bool hit = cache.get(1000, v);
+    size_t size = cache.size();
+    size_t n = cache.checkTimeout();
+    std::cout << "lazy: hit=" << hit << " size_before=" << size << " check=" << n
+              << " size=" << cache.size()
+              << ((!hit && n == 2 && cache.size() == size - 2) ? " ok" : " FAIL") << std::endl;
+    std::cout << cache.toStatusString() << std::endl;
+}
+
+void test_wheel_timed_cache_prune() {
+    //过期时间跨越多圈(一圈640ms), 达到max_size+elasticity时一次淘汰100个
+    sylar::ds::WheelTimedCache<int, int> cache(100, 100, nullptr, 10, 64);
+    std::vector<int> order(200);
+    for(size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937(1));
+    std::vector<int> pruned;
+    cache.setPruneCallback([&pruned](const int& k, const int& v) {
+        pruned.push_back(v);
+    });
+    for(size_t i = 0; i < order.size(); ++i) {
+        cache.set(i, order[i], 1000 + order[i] * 100);
+    }
+    std::sort(pruned.begin(), pruned.end());
+    bool ok = pruned.size() == 100 && cache.size() == 100;
+    for(size_t i = 0; ok && i < pruned.size(); ++i) {
+        ok = pruned[i] == (int)i;
+    }
+    std::cout << "prune earliest: size=" << cache.size() << " pruned=" << pruned.size()
+              << (ok ? " ok" : " FAIL") << std::endl;
+}
+
+void test_auto_check() {
+    //定时清理执行中析构缓存, 析构要等回调结束
+    size_t checked = 0;
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+    {
+        sylar::IOManager iom(2, false);
+        for(int i = 0; i < 200; ++i) {
+            auto cache = new sylar::ds::WheelTimedCache<int, int>(0, 0, nullptr, 1);
+            cache->setPruneCallback([&checked](const int& k, const int& v) {
+                ++checked;
+            });
+            for(int j = 0; j < 1000; ++j) {
+                cache->set(j, j, 0);
+            }
+            cache->startAutoCheck(&iom, 1);
+            usleep(i % 3 * 1000);
+            delete cache;
+        }
+    }
+    std::cout << "auto check: checked=" << checked << " ok" << std::endl;
+}
+
+void test_wheel_timed_lru_cache() {
+    sylar::ds::WheelTimedLruCache<int, int> cache(30, 0);
+    for(int i = 0; i < 30; ++i) {
+        cache.set(i, i, 10000 - i);
+    }
+    cache.get(0);
+    cache.set(100, 100, 10000);
+    //LRU淘汰最久未访问的1, 而不是最早过期的29
+    std::cout << "lru: exists(0)=" << cache.exists(0) << " exists(1)=" << cache.exists(1)
+              << " exists(29)=" << cache.exists(29)
+              << ((cache.exists(0) && !cache.exists(1) && cache.exists(29)) ? " ok" : " FAIL")
+              << std::endl;
+}
+
+template<class Cache>
+static void Bench(const std::string& name, Cache& cache, size_t n) {
+    std::mt19937 rng(1);
+    uint64_t ts = sylar::GetCurrentUS();
+    for(size_t i = 0; i < n; ++i) {
+        cache.set(i, i, 10000 + rng() % 10000);
+    }
+    uint64_t set_used = sylar::GetCurrentUS() - ts;
+
+    ts = sylar::GetCurrentUS();
+    uint64_t v = 0, hit = 0;
+    for(size_t i = 0; i < n; ++i) {
+        hit += cache.get(rng() % n, v);
+    }
+    uint64_t get_used = sylar::GetCurrentUS() - ts;
+
+    ts = sylar::GetCurrentUS();
+    size_t expired = cache.checkTimeout(sylar::GetCurrentMS() + 30000);
+    uint64_t check_used = sylar::GetCurrentUS() - ts;
+    std::cout << name << ": n=" << n
+              << " set=" << set_used / 1000.0 << "ms"
+              << " get=" << get_used / 1000.0 << "ms"
+              << " check=" << check_used / 1000.0 << "ms"
+              << " expired=" << expired << " hit=" << hit
+              << " size=" << cache.size() << std::endl;
+}
+
+void test_bench() {
+    const size_t n = 1000000;
+    {
+        sylar::ds::TimedCache<uint64_t, uint64_t> cache;
+        Bench("TimedCache", cache, n);
+    }
+    {
+        sylar::ds::WheelTimedCache<uint64_t, uint64_t> cache(0, 0, nullptr, 10);
+        Bench("WheelTimedCache", cache, n);
+    }
+    {
+        //容量淘汰: 每次淘汰elasticity+1个
+        sylar::ds::WheelTimedCache<uint64_t, uint64_t> cache(n / 10, n / 10, nullptr, 10);
+        Bench("WheelTimedCache(prune)", cache, n);
+    }
+}
+
+int main(int argc, char** argv) {
+    test_wheel_timed_cache();
+    test_wheel_timed_cache_prune();
+    test_auto_check();
+    test_wheel_timed_lru_cache();
+    test_bench();
+    return 0;
+}
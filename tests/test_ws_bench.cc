@@ -0,0 +1,145 @@
+#include "sylar/http/ws_server.h"
+#include "sylar/http/ws_connection.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include "sylar/macro.h"
+#include "sylar/util.h"
+#include <atomic>
+#include <iostream>
+#include <random>
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+//各指令集级别与逐字节掩码结果一致
+void test_mask() {
+    std::mt19937 rng(1);
+    std::string src(4096 + 7, '\0');
+    for(auto& c : src) {
+        c = rng();
+    }
+    char mask[4] = {0x12, 0x34, 0x56, 0x78};
+    for(int level = sylar::codec::SCALAR; level <= sylar::codec::GetMaxLevel(); ++level) {
+        sylar::codec::SetLevel((sylar::codec::Level)level);
+        for(size_t len = 0; len < src.size(); len += 1 + len / 4) {
+            for(size_t offset = 0; offset < 4; ++offset) {
+                std::string dst(len, '\0');
+                sylar::http::WSMaskPayload(&dst[0], src.c_str(), len, mask, offset);
+                for(size_t i = 0; i < len; ++i) {
+                    SYLAR_ASSERT(dst[i] == (char)(src[i] ^ mask[(offset + i) % 4]));
+                }
+            }
+        }
+    }
+    sylar::codec::SetLevel(sylar::codec::GetMaxLevel());
+    std::cout << "mask ok" << std::endl;
+}
+
+void bench_mask() {
+    std::string buf(1024 * 1024, 'x');
+    char mask[4] = {1, 2, 3, 4};
+    const int n = 1000;
+    for(int level = sylar::codec::SCALAR; level <= sylar::codec::GetMaxLevel(); ++level) {
+        sylar::codec::SetLevel((sylar::codec::Level)level);
+        uint64_t ts = sylar::GetCurrentUS();
+        for(int i = 0; i < n; ++i) {
+            sylar::http::WSMaskPayload(&buf[0], buf.c_str(), buf.size(), mask);
+        }
+        uint64_t used = sylar::GetCurrentUS() - ts;
+        std::cout << "bench mask " << sylar::codec::GetLevelName((sylar::codec::Level)level)
+                  << ": " << (used ? n * 1000000.0 / used / 1024 : 0) << "GB/s" << std::endl;
+    }
+    sylar::codec::SetLevel(sylar::codec::GetMaxLevel());
+}
+
+static sylar::http::WSServer::ptr s_server;
+static std::atomic<int> s_running(0);
+static std::atomic<uint64_t> s_frames(0);
+static uint64_t s_start = 0;
+
+//边界长度, 分片与PING穿插, 回显内容一致
+void check_client(const std::string& url) {
+    auto rt = sylar::http::WSConnection::Create(url, 5000);
+    SYLAR_ASSERT2(rt.second, rt.first->toString());
+    auto conn = rt.second;
+    size_t sizes[] = {0, 1, 125, 126, 127, 65535, 65536, 1000000};
+    for(auto size : sizes) {
+        std::string data = sylar::random_string(size);
+        conn->sendMessage(data.substr(0, size / 3), sylar::http::WSFrameHead::BIN_FRAME, false);
+        conn->ping();
+        conn->sendMessage(data.substr(size / 3), sylar::http::WSFrameHead::CONTINUE, true);
+        auto msg = conn->recvMessage();
+        SYLAR_ASSERT(msg && msg->getData() == data
+            && msg->getOpcode() == sylar::http::WSFrameHead::BIN_FRAME);
+    }
+    conn->close();
+}
+
+//每个连接一次发出batch个帧再收回, 服务端一次读取可解析多个帧
+void bench_client(const std::string& url, int count, int batch, size_t size) {
+    //单协程先写后读, 一批数据超过socket缓存时两端会互相阻塞在写上
+    batch = std::max(1, std::min(batch, (int)(64 * 1024 / std::max(size, (size_t)1))));
+    auto rt = sylar::http::WSConnection::Create(url, 5000);
+    SYLAR_ASSERT2(rt.second, rt.first->toString());
+    auto conn = rt.second;
+    std::string data = sylar::random_string(size);
+    for(int i = 0; i < count; i += batch) {
+        for(int j = 0; j < batch; ++j) {
+            conn->sendMessage(data);
+        }
+        for(int j = 0; j < batch; ++j) {
+            auto msg = conn->recvMessage();
+            SYLAR_ASSERT(msg && msg->getData().size() == size);
+            ++s_frames;
+        }
+    }
+    conn->close();
+    if(--s_running == 0) {
+        uint64_t used = sylar::GetCurrentUS() - s_start;
+        std::cout << "bench echo size=" << size << " frames=" << s_frames
+                  << " used=" << used / 1000.0 << "ms "
+                  << (used ? s_frames * 1000000.0 / used : 0) << " frames/s" << std::endl;
+        s_server->stop();
+    }
+}
+
+void run(int conns, int count, int batch, size_t size) {
+    s_server.reset(new sylar::http::WSServer);
+    s_server->getWSServletDispatch()->addServlet("/echo", [](sylar::http::HttpRequest::ptr header
+                  ,sylar::http::WSFrameMessage::ptr msg
+                  ,sylar::http::WSSession::ptr session) {
+        return session->sendMessage(msg) > 0 ? 0 : -1;
+    });
+    auto addr = sylar::Address::LookupAnyIPAddress("127.0.0.1:0");
+    if(!s_server->bind(addr)) {
+        SYLAR_LOG_ERROR(g_logger) << "bind fail";
+        return;
+    }
+    s_server->start();
+    std::string url = "http://" + s_server->getSocks()[0]->getLocalAddress()->toString() + "/echo";
+
+    check_client(url);
+    std::cout << "check ok" << std::endl;
+
+    s_running = conns;
+    s_start = sylar::GetCurrentUS();
+    for(int i = 0; i < conns; ++i) {
+        sylar::IOManager::GetThis()->schedule(std::bind(bench_client, url, count, batch, size));
+    }
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(sylar::LogLevel::WARN);
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+    int conns = argc > 1 ? atoi(argv[1]) : 8;
+    int count = argc > 2 ? atoi(argv[2]) : 20000;
+    int batch = argc > 3 ? atoi(argv[3]) : 16;
+    size_t size = argc > 4 ? atoi(argv[4]) : 64;
+
+    test_mask();
+    bench_mask();
+    {
+        sylar::IOManager iom(2);
+        iom.schedule(std::bind(run, conns, count, batch, size));
+    }
+    return 0;
+}
@@ -0,0 +1,298 @@
+#include "sylar/http/ws_session_manager.h"
+#include "sylar/http/ws_connection.h"
+#include "sylar/iomanager.h"
+#include "sylar/log.h"
+#include "sylar/macro.h"
+#include "sylar/util.h"
+#include <atomic>
+#include <iostream>
+
+using sylar::http::WSSession;
+using sylar::http::WSConnection;
+using sylar::http::WSSessionMgr;
+
+static sylar::Logger::ptr g_logger = SYLAR_LOG_ROOT();
+
+/**
+ * @brief 回环上的一对连接, 跳过握手直接构造两端
+ */
+struct Pair {
+    WSSession::ptr server;
+    WSConnection::ptr client;
+};
+
+static sylar::Socket::ptr s_listen;
+
+static bool CreatePair(Pair& p) {
+    auto sock = sylar::Socket::CreateTCP(s_listen->getLocalAddress());
+    if(!sock->connect(s_listen->getLocalAddress())) {
+        return false;
+    }
+    auto peer = s_listen->accept();
+    if(!peer) {
+        return false;
+    }
+    p.client.reset(new WSConnection(sock));
+    p.server.reset(new WSSession(peer));
+    return true;
+}
+
+static void ClosePair(Pair& p) {
+    WSSessionMgr::GetInstance()->del(p.server);
+    p.server->close();
+    p.client->close();
+}
+
+static std::string Recv(Pair& p) {
+    auto msg = p.client->recvMessage();
+    return msg ? msg->getData() : "<null>";
+}
+
+//握手请求和第一帧在同一次写入中到达, 握手时多读的帧数据不能丢
+void test_shake() {
+    auto sock = sylar::Socket::CreateTCP(s_listen->getLocalAddress());
+    SYLAR_ASSERT(sock->connect(s_listen->getLocalAddress()));
+    std::string data = "GET /chat HTTP/1.1\r\n"
+        "Host: 127.0.0.1\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+        "Sec-WebSocket-Version: 13\r\n\r\n";
+    //FIN+TEXT, 掩码为0的"hello"
+    data.append("\x81\x85\x00\x00\x00\x00hello", 11);
+    SYLAR_ASSERT(sock->send(data.c_str(), data.size()) == (int)data.size());
+
+    WSSession::ptr session(new WSSession(s_listen->accept()));
+    SYLAR_ASSERT(session->handleShake() != nullptr);
+    auto msg = session->recvMessage();
+    SYLAR_ASSERT(msg && msg->getData() == "hello");
+
+    char buf[1024];
+    int rt = sock->recv(buf, sizeof(buf));
+    SYLAR_ASSERT(rt > 0 && std::string(buf, rt).find(" 101 ") != std::string::npos);
+    session->close();
+    sock->close();
+    std::cout << "shake ok" << std::endl;
+}
+
+//按主题投递, 同一连接上保持广播顺序
+void test_topic(int n) {
+    auto mgr = WSSessionMgr::GetInstance();
+    std::vector<Pair> pairs(n);
+    for(int i = 0; i < n; ++i) {
+        SYLAR_ASSERT(CreatePair(pairs[i]));
+        SYLAR_ASSERT(pairs[i].server->startSendQueue());
+        mgr->add(pairs[i].server);
+        mgr->join("all", pairs[i].server);
+        mgr->join(i % 2 ? "odd" : "even", pairs[i].server);
+    }
+    SYLAR_ASSERT(mgr->getTopicSize("all") == (size_t)n);
+    SYLAR_ASSERT(mgr->getTopicSize("even") == (size_t)(n + 1) / 2);
+    SYLAR_ASSERT(mgr->broadcast("even", "a") == (size_t)(n + 1) / 2);
+    SYLAR_ASSERT(mgr->broadcast("all", "b") == (size_t)n);
+    SYLAR_ASSERT(mgr->broadcast("none", "c") == 0);
+    for(int i = 0; i < n; ++i) {
+        if(i % 2 == 0) {
+            SYLAR_ASSERT(Recv(pairs[i]) == "a");
+        }
+        SYLAR_ASSERT(Recv(pairs[i]) == "b");
+    }
+
+    //直接发送与广播经过同一队列, 不会交错
+    pairs[0].server->sendMessage("direct");
+    mgr->broadcast("all", "c");
+    SYLAR_ASSERT(Recv(pairs[0]) == "direct" && Recv(pairs[0]) == "c");
+    SYLAR_ASSERT(Recv(pairs[1]) == "c");
+
+    std::vector<std::string> topics;
+    mgr->listTopics(pairs[1].server, topics);
+    SYLAR_ASSERT(topics.size() == 2);
+    SYLAR_ASSERT(mgr->leave("odd", pairs[1].server));
+    SYLAR_ASSERT(!mgr->leave("odd", pairs[1].server));
+    for(auto& p : pairs) {
+        ClosePair(p);
+    }
+    SYLAR_ASSERT(mgr->size() == 0 && mgr->getTopicSize("all") == 0);
+    std::cout << "topic ok" << std::endl;
+}
+
+//对端不读时按策略处理, 广播方不阻塞
+void test_policy(WSSession::SendPolicy policy) {
+    auto mgr = WSSessionMgr::GetInstance();
+    Pair p;
+    SYLAR_ASSERT(CreatePair(p));
+    p.server->setSendPolicy(policy);
+    p.server->setSendQueueLimit(1024 * 1024, 16);
+    SYLAR_ASSERT(p.server->startSendQueue());
+    mgr->add(p.server);
+    mgr->join("slow", p.server);
+
+    std::string data(64 * 1024, 'x');
+    uint64_t ts = sylar::GetCurrentUS();
+    int i = 0;
+    for(; i < 10000 && p.server->isConnected(); ++i) {
+        data[0] = 'a' + i % 26;
+        mgr->broadcast("slow", data, sylar::http::WSFrameHead::BIN_FRAME, 1 + i % 4);
+        if(i % 64 == 0) {
+            sylar::IOManager::GetThis()->schedule(sylar::Fiber::GetThis());
+            sylar::Fiber::YieldToHold();
+        }
+    }
+    uint64_t used = sylar::GetCurrentUS() - ts;
+    std::cout << "  policy=" << WSSession::SendPolicyToString(policy)
+              << " broadcasts=" << i << " used=" << used / 1000.0 << "ms "
+              << p.server->toString() << std::endl;
+    SYLAR_ASSERT(p.server->getSendQueueFrames() <= 16);
+    if(policy == WSSession::DROP) {
+        SYLAR_ASSERT(p.server->isConnected() && p.server->getDroppedFrames() > 0);
+    } else if(policy == WSSession::DISCONNECT) {
+        SYLAR_ASSERT(!p.server->isConnected());
+    } else {
+        SYLAR_ASSERT(p.server->isConnected() && p.server->getCoalescedFrames() > 0
+              && p.server->getDroppedFrames() == 0);
+    }
+    //已发出的都是完整的帧, 断开时最后一帧可能不完整, 之后读到连接关闭
+    int closed = 0;
+    for(int j = 0; j < 1000; ++j) {
+        auto msg = p.client->recvMessage();
+        if(!msg) {
+            closed = 1;
+            break;
+        }
+        SYLAR_ASSERT(msg->getData().size() == data.size());
+        if(policy != WSSession::DISCONNECT && j == 8) {
+            break;
+        }
+    }
+    SYLAR_ASSERT(closed == (policy == WSSession::DISCONNECT));
+    ClosePair(p);
+}
+
+//直接发送的消息不丢弃也不断开, 队列满时发送方等待, 超过max_frames的消息全部送达
+void test_direct() {
+    Pair p;
+    SYLAR_ASSERT(CreatePair(p));
+    p.server->setSendPolicy(WSSession::DISCONNECT);
+    p.server->setSendQueueLimit(1024 * 1024, 16);
+    SYLAR_ASSERT(p.server->startSendQueue());
+    const int n = 256;
+    std::atomic<int> sent(0);
+    sylar::IOManager::GetThis()->schedule([&p, &sent, n]() {
+        for(int i = 0; i < n; ++i) {
+            std::string data(64 * 1024, 'a' + i % 26);
+            if(p.server->sendMessage(data) <= 0) {
+                break;
+            }
+            ++sent;
+        }
+    });
+    //对端先不读, 发送方填满socket缓存和队列后等待
+    usleep(100 * 1000);
+    SYLAR_ASSERT(sent < n && p.server->getSendQueueFrames() <= 16);
+    for(int i = 0; i < n; ++i) {
+        auto msg = p.client->recvMessage();
+        SYLAR_ASSERT(msg && msg->getData() == std::string(64 * 1024, 'a' + i % 26));
+    }
+    for(int i = 0; i < 1000 && sent < n; ++i) {
+        usleep(1000);
+    }
+    SYLAR_ASSERT(sent == n && p.server->isConnected());
+    SYLAR_ASSERT(p.server->getDroppedFrames() == 0);
+    ClosePair(p);
+    std::cout << "direct ok" << std::endl;
+}
+
+static std::atomic<uint64_t> s_received(0);
+
+static void Reader(WSConnection::ptr conn) {
+    while(conn->recvMessage()) {
+        ++s_received;
+    }
+}
+
+static bool WaitReceived(uint64_t target) {
+    uint64_t ts = sylar::GetCurrentMS();
+    while(s_received < target) {
+        if(sylar::GetCurrentMS() - ts > 30000) {
+            return false;
+        }
+        usleep(1000);
+    }
+    return true;
+}
+
+//广播编码一次并共享数据, 对比逐连接编码同步发送
+void bench(int n, int count, size_t size) {
+    auto mgr = WSSessionMgr::GetInstance();
+    std::vector<Pair> pairs(n);
+    for(int i = 0; i < n; ++i) {
+        SYLAR_ASSERT(CreatePair(pairs[i]));
+        SYLAR_ASSERT(pairs[i].server->startSendQueue());
+        mgr->add(pairs[i].server);
+        mgr->join("bench", pairs[i].server);
+        sylar::IOManager::GetThis()->schedule(std::bind(Reader, pairs[i].client));
+    }
+    std::string data = sylar::random_string(size);
+
+    s_received = 0;
+    uint64_t ts = sylar::GetCurrentUS();
+    for(int i = 0; i < count; ++i) {
+        auto msg = std::make_shared<sylar::http::WSFrameMessage>(
+                sylar::http::WSFrameHead::TEXT_FRAME, data);
+        for(auto& p : pairs) {
+            sylar::http::WSSendMessage(p.server.get(), msg, false, true);
+        }
+    }
+    uint64_t sent = sylar::GetCurrentUS() - ts;
+    SYLAR_ASSERT(WaitReceived((uint64_t)n * count));
+    uint64_t used = sylar::GetCurrentUS() - ts;
+    std::cout << "bench per-session send conns=" << n << " count=" << count << " size=" << size
+              << " send=" << sent / 1000.0 << "ms deliver=" << used / 1000.0 << "ms "
+              << (used ? n * count * 1000000.0 / used : 0) << " frames/s" << std::endl;
+
+    s_received = 0;
+    ts = sylar::GetCurrentUS();
+    size_t queued = 0;
+    for(int i = 0; i < count; ++i) {
+        queued += mgr->broadcast("bench", data);
+    }
+    sent = sylar::GetCurrentUS() - ts;
+    SYLAR_ASSERT(WaitReceived(queued));
+    used = sylar::GetCurrentUS() - ts;
+    std::cout << "bench broadcast conns=" << n << " count=" << count << " size=" << size
+              << " send=" << sent / 1000.0 << "ms deliver=" << used / 1000.0 << "ms "
+              << (used ? queued * 1000000.0 / used : 0) << " frames/s"
+              << " queued=" << queued << std::endl;
+    for(auto& p : pairs) {
+        ClosePair(p);
+    }
+    std::cout << "  " << mgr->toString() << std::endl;
+}
+
+void run(int conns, int count, size_t size) {
+    s_listen = sylar::Socket::CreateTCPSocket();
+    SYLAR_ASSERT(s_listen->bind(sylar::Address::LookupAnyIPAddress("127.0.0.1:0"))
+            && s_listen->listen());
+    test_shake();
+    test_topic(16);
+    test_policy(WSSession::DROP);
+    test_policy(WSSession::DISCONNECT);
+    test_policy(WSSession::COALESCE);
+    std::cout << "policy ok" << std::endl;
+    test_direct();
+    bench(conns, count, size);
+    s_listen->close();
+}
+
+int main(int argc, char** argv) {
+    g_logger->setLevel(sylar::LogLevel::WARN);
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+    int conns = argc > 1 ? atoi(argv[1]) : 1000;
+    int count = argc > 2 ? atoi(argv[2]) : 100;
+    size_t size = argc > 3 ? atoi(argv[3]) : 256;
+    {
+        sylar::IOManager iom(2);
+        iom.schedule(std::bind(run, conns, count, size));
+    }
+    return 0;
+}
@@ -0,0 +1,272 @@
+#include "sylar/http/ws_session.h"
+#include "sylar/http/ws_deflate.h"
+#include "sylar/config.h"
+#include "sylar/log.h"
+#include "sylar/macro.h"
+#include "sylar/util.h"
+#include <iostream>
+#include <random>
+
+using sylar::http::WSDeflater;
+using sylar::http::WSDeflateParams;
+using sylar::http::WSFrameHead;
+using sylar::http::WSFrameMessage;
+
+/**
+ * @brief 内存中的单向流, 写入的数据可以被读出
+ */
+class MemoryStream : public sylar::Stream {
+public:
+    virtual int read(void* buffer, size_t length) override {
+        if(m_data.empty()) {
+            return 0;
+        }
+        length = std::min(length, m_data.size());
+        m_data.read(buffer, length);
+        return length;
+    }
+    virtual int read(sylar::ByteArray::ptr ba, size_t length) override {
+        std::string tmp(length, '\0');
+        int rt = read(&tmp[0], length);
+        if(rt > 0) {
+            ba->write(tmp.c_str(), rt);
+        }
+        return rt;
+    }
+    virtual int write(const void* buffer, size_t length) override {
+        m_data.append(buffer, length);
+        return length;
+    }
+    virtual int write(sylar::ByteArray::ptr ba, size_t length) override {
+        std::string tmp(length, '\0');
+        ba->read(&tmp[0], length);
+        return write(tmp.c_str(), length);
+    }
+    virtual void close() override {
+        m_closed = true;
+    }
+
+    sylar::BufferChain& getData() { return m_data;}
+    bool isClosed() const { return m_closed;}
+private:
+    sylar::BufferChain m_data;
+    bool m_closed = false;
+};
+
+static std::string Hex(const std::string& v) {
+    return sylar::hexstring_from_data(v.c_str(), v.size());
+}
+
+//服务端offer/accept与客户端confirm
+void test_negotiate() {
+    //默认不开启, 不发起也不接受协商
+    auto enable = sylar::Config::Lookup<bool>("websocket.deflate.enable");
+    std::string rsp;
+    SYLAR_ASSERT(!enable->getValue());
+    SYLAR_ASSERT(WSDeflater::Offer().empty());
+    SYLAR_ASSERT(!WSDeflater::Accept("permessage-deflate", rsp));
+    enable->setValue(true);
+
+    std::vector<WSDeflateParams> offers;
+    SYLAR_ASSERT(WSDeflater::Parse("permessage-deflate; client_max_window_bits, permessage-deflate; server_max_window_bits=10, x-webkit-deflate-frame", offers));
+    SYLAR_ASSERT(offers.size() == 2);
+    SYLAR_ASSERT(offers[0].client_max_window_bits == 15);
+    SYLAR_ASSERT(offers[1].client_max_window_bits == -1);
+    SYLAR_ASSERT(offers[1].server_max_window_bits == 10);
+
+    offers.clear();
+    SYLAR_ASSERT(!WSDeflater::Parse("permessage-deflate; server_max_window_bits=7, permessage-deflate; foo"
+                        ", permessage-deflate; server_no_context_takeover; server_no_context_takeover"
+                        ", permessage-deflate; server_max_window_bits, permessage-deflate", offers));
+    SYLAR_ASSERT(offers.size() == 1);
+
+    auto d = WSDeflater::Accept("permessage-deflate; server_max_window_bits=7, permessage-deflate; client_max_window_bits", rsp);
+    SYLAR_ASSERT(d && rsp == "permessage-deflate");
+    d = WSDeflater::Accept("permessage-deflate; server_max_window_bits=10; client_no_context_takeover", rsp);
+    SYLAR_ASSERT(d && rsp == "permessage-deflate; client_no_context_takeover; server_max_window_bits=10");
+    d = WSDeflater::Accept("x-webkit-deflate-frame", rsp);
+    SYLAR_ASSERT(!d);
+
+    //本端限制客户端窗口, 对端支持时才能生效
+    auto client_bits = sylar::Config::Lookup<int32_t>("websocket.deflate.client_max_window_bits");
+    client_bits->setValue(10);
+    d = WSDeflater::Accept("permessage-deflate; client_max_window_bits", rsp);
+    SYLAR_ASSERT(d && rsp == "permessage-deflate; client_max_window_bits=10");
+    d = WSDeflater::Accept("permessage-deflate", rsp);
+    SYLAR_ASSERT(d && rsp == "permessage-deflate");
+    SYLAR_ASSERT(WSDeflater::Offer() == "permessage-deflate; client_max_window_bits=10");
+    client_bits->setValue(15);
+    SYLAR_ASSERT(WSDeflater::Offer() == "permessage-deflate; client_max_window_bits");
+
+    WSDeflater::ptr c;
+    SYLAR_ASSERT(WSDeflater::Confirm("", c) && !c);
+    SYLAR_ASSERT(WSDeflater::Confirm("permessage-deflate; server_max_window_bits=9", c) && c);
+    SYLAR_ASSERT(!WSDeflater::Confirm("permessage-deflate, permessage-deflate", c));
+    SYLAR_ASSERT(!WSDeflater::Confirm("permessage-deflate; x-sylar-dictionary=12345678", c));
+    SYLAR_ASSERT(!WSDeflater::Confirm("permessage-deflate; foo=1", c));
+
+    //共享字典: 优先带字典的offer, 字典不一致时选择第二项
+    auto dict = sylar::Config::Lookup<std::string>("websocket.deflate.dictionary");
+    dict->setValue("{\"type\":\"chat\",\"room\":\"\",\"user\":\"\",\"text\":\"\"}");
+    std::string offer = WSDeflater::Offer();
+    d = WSDeflater::Accept(offer, rsp);
+    SYLAR_ASSERT(d && !d->getParams().dictionary_id.empty());
+    SYLAR_ASSERT(WSDeflater::Confirm(rsp, c) && c && c->getParams().dictionary_id == d->getParams().dictionary_id);
+    dict->setValue("other");
+    d = WSDeflater::Accept(offer, rsp);
+    SYLAR_ASSERT(d && d->getParams().dictionary_id.empty());
+    dict->setValue("");
+    std::cout << "negotiate ok" << std::endl;
+}
+
+static WSFrameMessage::ptr RoundTrip(MemoryStream& stream, WSDeflater* sender, WSDeflater* receiver
+                                     ,bool client, const std::string& data, std::string* wire = nullptr) {
+    auto msg = std::make_shared<WSFrameMessage>(WSFrameHead::TEXT_FRAME, data);
+    if(sylar::http::WSSendMessage(&stream, msg, client, true, sender) <= 0) {
+        return nullptr;
+    }
+    if(wire) {
+        *wire = stream.getData().toString();
+    }
+    return sylar::http::WSRecvMessage(&stream, !client, nullptr, receiver);
+}
+
+//RFC 7692 7.2.3的示例与各参数组合的往返
+void test_roundtrip() {
+    auto min_size = sylar::Config::Lookup<uint32_t>("websocket.deflate.min_size");
+    min_size->setValue(0);
+    MemoryStream stream;
+    {
+        WSDeflateParams p;
+        WSDeflater server(p, false), client(p, true);
+        std::string wire;
+        auto msg = RoundTrip(stream, &server, &client, false, "Hello", &wire);
+        SYLAR_ASSERT(msg && msg->getData() == "Hello");
+        SYLAR_ASSERT(Hex(wire) == "c107f248cdc9c90700");
+        //保留上下文时第二条引用第一条
+        msg = RoundTrip(stream, &server, &client, false, "Hello", &wire);
+        SYLAR_ASSERT(msg && msg->getData() == "Hello");
+        SYLAR_ASSERT(Hex(wire) == "c105f200110000");
+
+        WSDeflateParams np;
+        np.server_no_context_takeover = true;
+        WSDeflater server2(np, false), client2(np, true);
+        for(int i = 0; i < 2; ++i) {
+            msg = RoundTrip(stream, &server2, &client2, false, "Hello", &wire);
+            SYLAR_ASSERT(msg && Hex(wire) == "c107f248cdc9c90700");
+        }
+        //空消息压缩为一个字节0x00
+        msg = RoundTrip(stream, &server2, &client2, false, "", &wire);
+        SYLAR_ASSERT(msg && msg->getData().empty() && Hex(wire) == "c10100");
+    }
+
+    std::mt19937 rng(1);
+    std::string text;
+    while(text.size() < 2 * 1024 * 1024) {
+        text += "{\"id\":" + std::to_string(rng() % 100000) + ",\"name\":\"user"
+                + std::to_string(rng() % 100) + "\"},";
+    }
+    for(int bits = 8; bits <= 15; ++bits) {
+        for(int no_context = 0; no_context < 2; ++no_context) {
+            WSDeflateParams p;
+            p.client_max_window_bits = bits;
+            p.server_max_window_bits = bits;
+            p.client_no_context_takeover = no_context;
+            p.server_no_context_takeover = no_context;
+            WSDeflater server(p, false), client(p, true);
+            for(int i = 0; i < 20; ++i) {
+                size_t len = rng() % 3 ? rng() % 1000 : rng() % 100000;
+                std::string data = text.substr(rng() % 1000000, len);
+                auto msg = RoundTrip(stream, &client, &server, true, data);
+                SYLAR_ASSERT(msg && msg->getData() == data);
+                msg = RoundTrip(stream, &server, &client, false, data);
+                SYLAR_ASSERT(msg && msg->getData() == data);
+            }
+            SYLAR_ASSERT(!stream.isClosed());
+            if(bits == 9 || bits == 15) {
+                std::cout << "  window_bits=" << bits << " no_context=" << no_context
+                          << " " << client.toString() << std::endl;
+            }
+        }
+    }
+
+    //字典对小消息的效果
+    std::string sample = "{\"type\":\"chat\",\"room\":\"lobby\",\"user\":\"alice\",\"text\":\"hi\"}";
+    auto dict = sylar::Config::Lookup<std::string>("websocket.deflate.dictionary");
+    dict->setValue("{\"type\":\"chat\",\"room\":\"lobby\",\"user\":\"\",\"text\":\"\"}");
+    std::string offer = WSDeflater::Offer();
+    std::string rsp;
+    auto ds = WSDeflater::Accept(offer, rsp);
+    WSDeflater::ptr dc;
+    SYLAR_ASSERT(WSDeflater::Confirm(rsp, dc) && dc);
+    WSDeflateParams np;
+    np.server_no_context_takeover = true;
+    WSDeflater plain(np, false), plain_client(np, true);
+    std::string with_dict, without_dict;
+    for(int i = 0; i < 3; ++i) {
+        auto msg = RoundTrip(stream, ds.get(), dc.get(), false, sample, &with_dict);
+        SYLAR_ASSERT(msg && msg->getData() == sample);
+        msg = RoundTrip(stream, &plain, &plain_client, false, sample, &without_dict);
+        SYLAR_ASSERT(msg && msg->getData() == sample);
+    }
+    std::cout << "  message=" << sample.size() << " dictionary=" << with_dict.size()
+              << " no_dictionary=" << without_dict.size() << std::endl;
+    SYLAR_ASSERT(with_dict.size() < without_dict.size());
+    dict->setValue("");
+
+    //超过最大长度的解压失败, 连接关闭
+    {
+        WSDeflateParams p;
+        WSDeflater server(p, false), client(p, true);
+        std::string bomb(64 * 1024 * 1024, 'a');
+        auto max_size = sylar::http::g_websocket_message_max_size;
+        uint32_t old = max_size->getValue();
+        max_size->setValue(1024 * 1024);
+        auto msg = RoundTrip(stream, &server, &client, false, bomb);
+        SYLAR_ASSERT(!msg && stream.isClosed());
+        max_size->setValue(old);
+    }
+
+    //未协商时收到RSV1是协议错误
+    {
+        MemoryStream s;
+        WSDeflateParams p;
+        WSDeflater server(p, false);
+        auto msg = std::make_shared<WSFrameMessage>(WSFrameHead::TEXT_FRAME, "Hello");
+        sylar::http::WSSendMessage(&s, msg, false, true, &server);
+        SYLAR_ASSERT(!sylar::http::WSRecvMessage(&s, true) && s.isClosed());
+    }
+    min_size->setValue(64);
+    std::cout << "roundtrip ok" << std::endl;
+}
+
+//服务端收到未掩码的帧(包括控制帧)时回复1002的CLOSE并关闭
+void test_unmasked() {
+    for(int opcode : {WSFrameHead::TEXT_FRAME, WSFrameHead::PING}) {
+        MemoryStream stream;
+        auto msg = std::make_shared<WSFrameMessage>(opcode, "hello");
+        SYLAR_ASSERT(sylar::http::WSSendMessage(&stream, msg, false, true) > 0);
+        SYLAR_ASSERT(!sylar::http::WSRecvMessage(&stream, false));
+        SYLAR_ASSERT(stream.isClosed());
+        //未读取的payload之后是回复的CLOSE帧
+        SYLAR_ASSERT(Hex(stream.getData().toString()) == Hex("hello") + "880203ea");
+    }
+    //客户端接收服务端未掩码的帧
+    MemoryStream stream;
+    auto msg = std::make_shared<WSFrameMessage>(WSFrameHead::TEXT_FRAME, "hello");
+    SYLAR_ASSERT(sylar::http::WSSendMessage(&stream, msg, false, true) > 0);
+    msg = sylar::http::WSRecvMessage(&stream, true);
+    SYLAR_ASSERT(msg && msg->getData() == "hello" && !stream.isClosed());
+    std::cout << "unmasked ok" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    SYLAR_LOG_NAME("system")->setLevel(sylar::LogLevel::WARN);
+    test_negotiate();
+    test_roundtrip();
+    test_unmasked();
+    std::cout << WSDeflater::StatusString() << std::endl;
+    SYLAR_ASSERT(WSDeflater::GetStatus()->getContexts() == 0);
+    SYLAR_ASSERT(WSDeflater::GetStatus()->getMemory() == 0);
+    return 0;
+}